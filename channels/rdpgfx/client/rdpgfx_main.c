@@ -46,6 +46,9 @@
 
 #define TAG CHANNELS_TAG("rdpgfx.client")
 
+/* Upper limit of the on-disk store, entries are 64x64 tiles of 16KiB most of the time */
+#define RDPGFX_PERSISTENT_CACHE_STORE_SIZE (128ull * 1024ull * 1024ull)
+
 static BOOL delete_surface(const void* key, void* value, void* arg)
 {
 	const UINT16 id = (UINT16)(uintptr_t)(key);
@@ -617,6 +620,9 @@ static UINT rdpgfx_recv_evict_cache_entry_pdu(GENERIC_CHANNEL_CALLBACK* callback
 	WLog_Print(gfx->log, WLOG_DEBUG, "RecvEvictCacheEntryPdu: cacheSlot: %" PRIu16 "",
 	           pdu.cacheSlot);
 
+	if ((pdu.cacheSlot > 0) && (pdu.cacheSlot <= gfx->MaxCacheSlots))
+		gfx->PendingImports[pdu.cacheSlot - 1] = 0;
+
 	if (context)
 	{
 		IFCALLRET(context->EvictCacheEntry, error, context, &pdu);
@@ -630,84 +636,75 @@ static UINT rdpgfx_recv_evict_cache_entry_pdu(GENERIC_CHANNEL_CALLBACK* callback
 }
 
 /**
- * Load cache import offer from file (offline replay)
+ * Open the persistent cache store on first use
  *
- * @return 0 on success, otherwise a Win32 error code
+ * The store lives next to the bitmap cache file, entries are paged in from it when the server
+ * first references an imported cache slot.
  */
-static UINT rdpgfx_load_cache_import_offer(RDPGFX_PLUGIN* gfx, RDPGFX_CACHE_IMPORT_OFFER_PDU* offer)
+static rdpPersistentCacheStore* rdpgfx_get_persistent_store(RDPGFX_PLUGIN* gfx)
 {
-	int count = 0;
-	UINT error = CHANNEL_RC_OK;
-	PERSISTENT_CACHE_ENTRY entry;
-	rdpPersistentCache* persistent = NULL;
 	WINPR_ASSERT(gfx);
 	WINPR_ASSERT(gfx->rdpcontext);
 	rdpSettings* settings = gfx->rdpcontext->settings;
 
-	WINPR_ASSERT(offer);
-	WINPR_ASSERT(settings);
-
-	offer->cacheEntriesCount = 0;
+	if (gfx->store)
+		return gfx->store;
 
 	if (!freerdp_settings_get_bool(settings, FreeRDP_BitmapCachePersistEnabled))
-		return CHANNEL_RC_OK;
+		return NULL;
 
 	const char* BitmapCachePersistFile =
 	    freerdp_settings_get_string(settings, FreeRDP_BitmapCachePersistFile);
 	if (!BitmapCachePersistFile)
-		return CHANNEL_RC_OK;
-
-	persistent = persistent_cache_new();
+		return NULL;
 
-	if (!persistent)
-		return CHANNEL_RC_NO_MEMORY;
+	const size_t length = strlen(BitmapCachePersistFile) + 5;
+	char* filename = (char*)calloc(length, sizeof(char));
+	if (!filename)
+		return NULL;
 
-	if (persistent_cache_open(persistent, BitmapCachePersistFile, FALSE, 3) < 1)
-	{
-		error = CHANNEL_RC_INITIALIZATION_ERROR;
-		goto fail;
-	}
+	(void)_snprintf(filename, length, "%s.gfx", BitmapCachePersistFile);
+	gfx->store = persistent_cache_store_new(filename, RDPGFX_PERSISTENT_CACHE_STORE_SIZE);
+	if (!gfx->store)
+		WLog_Print(gfx->log, WLOG_WARN, "failed to open persistent cache store %s", filename);
 
-	if (persistent_cache_get_version(persistent) != 3)
-	{
-		error = ERROR_INVALID_DATA;
-		goto fail;
-	}
+	free(filename);
+	return gfx->store;
+}
 
-	count = persistent_cache_get_count(persistent);
+/**
+ * Import an entry offered from the persistent cache when its slot is used for the first time
+ *
+ * @return 0 on success, otherwise a Win32 error code
+ */
+static UINT rdpgfx_load_pending_import(RDPGFX_PLUGIN* gfx, UINT16 cacheSlot)
+{
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
 
-	if (count < 1)
-	{
-		error = ERROR_INVALID_DATA;
-		goto fail;
-	}
+	WINPR_ASSERT(gfx);
+	RdpgfxClientContext* context = gfx->context;
 
-	if (count >= RDPGFX_CACHE_ENTRY_MAX_COUNT)
-		count = RDPGFX_CACHE_ENTRY_MAX_COUNT - 1;
+	if ((cacheSlot == 0) || (cacheSlot > gfx->MaxCacheSlots))
+		return CHANNEL_RC_OK;
 
-	if (count > gfx->MaxCacheSlots)
-		count = gfx->MaxCacheSlots;
+	const UINT16 offer = gfx->PendingImports[cacheSlot - 1];
+	if (offer == 0)
+		return CHANNEL_RC_OK;
 
-	offer->cacheEntriesCount = (UINT16)count;
+	gfx->PendingImports[cacheSlot - 1] = 0;
+	if (!context || !context->ImportCacheEntry)
+		return CHANNEL_RC_OK;
 
-	for (int idx = 0; idx < count; idx++)
+	const UINT64 cacheKey = gfx->OfferedKeys[offer - 1];
+	if (!gfx->store || !persistent_cache_store_get(gfx->store, cacheKey, &entry))
 	{
-		if (persistent_cache_read_entry(persistent, &entry) < 1)
-		{
-			error = ERROR_INVALID_DATA;
-			goto fail;
-		}
-
-		offer->cacheEntries[idx].cacheKey = entry.key64;
-		offer->cacheEntries[idx].bitmapLength = entry.size;
+		WLog_Print(gfx->log, WLOG_WARN,
+		           "cache entry 0x%016" PRIX64 " for slot %" PRIu16 " is no longer available",
+		           cacheKey, cacheSlot);
+		return CHANNEL_RC_OK;
 	}
 
-	persistent_cache_free(persistent);
-
-	return error;
-fail:
-	persistent_cache_free(persistent);
-	return error;
+	return context->ImportCacheEntry(context, cacheSlot, &entry);
 }
 
 /**
@@ -717,58 +714,49 @@ fail:
  */
 static UINT rdpgfx_save_persistent_cache(RDPGFX_PLUGIN* gfx)
 {
-	UINT error = CHANNEL_RC_OK;
-	PERSISTENT_CACHE_ENTRY cacheEntry;
-	rdpPersistentCache* persistent = NULL;
+	PERSISTENT_CACHE_ENTRY cacheEntry = { 0 };
 	WINPR_ASSERT(gfx);
-	WINPR_ASSERT(gfx->rdpcontext);
-	rdpSettings* settings = gfx->rdpcontext->settings;
 	RdpgfxClientContext* context = gfx->context;
 
 	WINPR_ASSERT(context);
-	WINPR_ASSERT(settings);
 
-	if (!freerdp_settings_get_bool(settings, FreeRDP_BitmapCachePersistEnabled))
-		return CHANNEL_RC_OK;
-
-	const char* BitmapCachePersistFile =
-	    freerdp_settings_get_string(settings, FreeRDP_BitmapCachePersistFile);
-	if (!BitmapCachePersistFile)
+	rdpPersistentCacheStore* store = rdpgfx_get_persistent_store(gfx);
+	if (!store)
 		return CHANNEL_RC_OK;
 
 	if (!context->ExportCacheEntry)
 		return CHANNEL_RC_INITIALIZATION_ERROR;
 
-	persistent = persistent_cache_new();
-
-	if (!persistent)
-		return CHANNEL_RC_NO_MEMORY;
-
-	if (persistent_cache_open(persistent, BitmapCachePersistFile, TRUE, 3) < 1)
-	{
-		error = CHANNEL_RC_INITIALIZATION_ERROR;
-		goto fail;
-	}
-
 	for (UINT16 idx = 0; idx < gfx->MaxCacheSlots; idx++)
 	{
-		if (gfx->CacheSlots[idx])
+		const UINT16 cacheSlot = idx + 1;
+		const UINT16 offer = gfx->PendingImports[idx];
+
+		/* imported but never used in this session, it is still in the store */
+		if (offer != 0)
 		{
-			UINT16 cacheSlot = idx;
+			(void)persistent_cache_store_touch(store, gfx->OfferedKeys[offer - 1]);
+			continue;
+		}
 
-			if (context->ExportCacheEntry(context, cacheSlot, &cacheEntry) != CHANNEL_RC_OK)
-				continue;
+		if (!gfx->CacheSlots[idx])
+			continue;
 
-			persistent_cache_write_entry(persistent, &cacheEntry);
-		}
+		if (context->ExportCacheEntry(context, cacheSlot, &cacheEntry) != CHANNEL_RC_OK)
+			continue;
+
+		if (!cacheEntry.data || (cacheEntry.size == 0))
+			continue;
+
+		if (!persistent_cache_store_put(store, &cacheEntry))
+			WLog_Print(gfx->log, WLOG_WARN,
+			           "failed to store cache entry 0x%016" PRIX64 "", cacheEntry.key64);
 	}
 
-	persistent_cache_free(persistent);
+	if (!persistent_cache_store_commit(store))
+		return ERROR_WRITE_FAULT;
 
-	return error;
-fail:
-	persistent_cache_free(persistent);
-	return error;
+	return CHANNEL_RC_OK;
 }
 
 /**
@@ -845,78 +833,47 @@ fail:
  */
 static UINT rdpgfx_send_cache_offer(RDPGFX_PLUGIN* gfx)
 {
-	int count = 0;
+	size_t count = 0;
 	UINT error = CHANNEL_RC_OK;
-	PERSISTENT_CACHE_ENTRY entry;
+	PERSISTENT_CACHE_ENTRY* entries = NULL;
 	RDPGFX_CACHE_IMPORT_OFFER_PDU* offer = NULL;
-	rdpPersistentCache* persistent = NULL;
 
 	WINPR_ASSERT(gfx);
-	WINPR_ASSERT(gfx->rdpcontext);
 
 	RdpgfxClientContext* context = gfx->context;
-	rdpSettings* settings = gfx->rdpcontext->settings;
 
-	if (!freerdp_settings_get_bool(settings, FreeRDP_BitmapCachePersistEnabled))
-		return CHANNEL_RC_OK;
+	gfx->OfferedKeysCount = 0;
+	memset(gfx->PendingImports, 0, sizeof(gfx->PendingImports));
 
-	const char* BitmapCachePersistFile =
-	    freerdp_settings_get_string(settings, FreeRDP_BitmapCachePersistFile);
-	if (!BitmapCachePersistFile)
+	rdpPersistentCacheStore* store = rdpgfx_get_persistent_store(gfx);
+	if (!store)
 		return CHANNEL_RC_OK;
 
-	persistent = persistent_cache_new();
-
-	if (!persistent)
-		return CHANNEL_RC_NO_MEMORY;
-
-	if (persistent_cache_open(persistent, BitmapCachePersistFile, FALSE, 3) < 1)
-	{
-		error = CHANNEL_RC_INITIALIZATION_ERROR;
-		goto fail;
-	}
-
-	if (persistent_cache_get_version(persistent) != 3)
-	{
-		error = ERROR_INVALID_DATA;
-		goto fail;
-	}
-
-	count = persistent_cache_get_count(persistent);
-	if (count < 0)
-	{
-		error = ERROR_INVALID_DATA;
-		goto fail;
-	}
-
-	if (count >= RDPGFX_CACHE_ENTRY_MAX_COUNT)
-		count = RDPGFX_CACHE_ENTRY_MAX_COUNT - 1;
-
+	count = RDPGFX_CACHE_ENTRY_MAX_COUNT - 1;
 	if (count > gfx->MaxCacheSlots)
 		count = gfx->MaxCacheSlots;
 
+	entries = (PERSISTENT_CACHE_ENTRY*)calloc(count, sizeof(PERSISTENT_CACHE_ENTRY));
 	offer = (RDPGFX_CACHE_IMPORT_OFFER_PDU*)calloc(1, sizeof(RDPGFX_CACHE_IMPORT_OFFER_PDU));
-	if (!offer)
+	if (!entries || !offer)
 	{
 		error = CHANNEL_RC_NO_MEMORY;
 		goto fail;
 	}
 
+	/* Only the index is read here, the data of the entries stays on disk until it is used */
+	count = persistent_cache_store_get_entries(store, entries, count);
+
 	WINPR_ASSERT(count <= UINT16_MAX);
 	offer->cacheEntriesCount = (UINT16)count;
 
-	WLog_DBG(TAG, "Sending Cache Import Offer: %d", count);
+	WLog_DBG(TAG, "Sending Cache Import Offer: %" PRIuz, count);
 
-	for (int idx = 0; idx < count; idx++)
+	for (size_t idx = 0; idx < count; idx++)
 	{
-		if (persistent_cache_read_entry(persistent, &entry) < 1)
-		{
-			error = ERROR_INVALID_DATA;
-			goto fail;
-		}
-
-		offer->cacheEntries[idx].cacheKey = entry.key64;
-		offer->cacheEntries[idx].bitmapLength = entry.size;
+		offer->cacheEntries[idx].cacheKey = entries[idx].key64;
+		offer->cacheEntries[idx].bitmapLength = entries[idx].size;
+		gfx->OfferedKeys[idx] = entries[idx].key64;
 	}
 
 	if (offer->cacheEntriesCount > 0)
@@ -927,10 +884,12 @@ static UINT rdpgfx_send_cache_offer(RDPGFX_PLUGIN* gfx)
 			WLog_Print(gfx->log, WLOG_ERROR, "Failed to send cache import offer PDU");
 			goto fail;
 		}
+
+		gfx->OfferedKeysCount = offer->cacheEntriesCount;
 	}
 
 fail:
-	persistent_cache_free(persistent);
+	free(entries);
 	free(offer);
 	return error;
 }
@@ -943,67 +902,26 @@ fail:
 static UINT rdpgfx_load_cache_import_reply(RDPGFX_PLUGIN* gfx,
                                            const RDPGFX_CACHE_IMPORT_REPLY_PDU* reply)
 {
-	int count = 0;
-	UINT error = CHANNEL_RC_OK;
-	rdpPersistentCache* persistent = NULL;
 	WINPR_ASSERT(gfx);
-	WINPR_ASSERT(gfx->rdpcontext);
-	rdpSettings* settings = gfx->rdpcontext->settings;
-	RdpgfxClientContext* context = gfx->context;
-
-	WINPR_ASSERT(settings);
 	WINPR_ASSERT(reply);
-	if (!freerdp_settings_get_bool(settings, FreeRDP_BitmapCachePersistEnabled))
-		return CHANNEL_RC_OK;
-
-	const char* BitmapCachePersistFile =
-	    freerdp_settings_get_string(settings, FreeRDP_BitmapCachePersistFile);
-	if (!BitmapCachePersistFile)
-		return CHANNEL_RC_OK;
-
-	persistent = persistent_cache_new();
-
-	if (!persistent)
-		return CHANNEL_RC_NO_MEMORY;
-
-	if (persistent_cache_open(persistent, BitmapCachePersistFile, FALSE, 3) < 1)
-	{
-		error = CHANNEL_RC_INITIALIZATION_ERROR;
-		goto fail;
-	}
-
-	if (persistent_cache_get_version(persistent) != 3)
-	{
-		error = ERROR_INVALID_DATA;
-		goto fail;
-	}
 
-	count = persistent_cache_get_count(persistent);
+	UINT16 count = gfx->OfferedKeysCount;
+	if (count > reply->importedEntriesCount)
+		count = reply->importedEntriesCount;
 
-	count = (count < reply->importedEntriesCount) ? count : reply->importedEntriesCount;
+	WLog_DBG(TAG, "Receiving Cache Import Reply: %" PRIu16, count);
 
-	WLog_DBG(TAG, "Receiving Cache Import Reply: %d", count);
-
-	for (int idx = 0; idx < count; idx++)
+	/* The entries are loaded by the first CacheToSurface referencing their slot */
+	for (UINT16 idx = 0; idx < count; idx++)
 	{
-		PERSISTENT_CACHE_ENTRY entry = { 0 };
-		if (persistent_cache_read_entry(persistent, &entry) < 1)
-		{
-			error = ERROR_INVALID_DATA;
-			goto fail;
-		}
-
 		const UINT16 cacheSlot = reply->cacheSlots[idx];
-		if (context && context->ImportCacheEntry)
-			context->ImportCacheEntry(context, cacheSlot, &entry);
-	}
+		if ((cacheSlot == 0) || (cacheSlot > gfx->MaxCacheSlots))
+			continue;
 
-	persistent_cache_free(persistent);
+		gfx->PendingImports[cacheSlot - 1] = idx + 1;
+	}
 
-	return error;
-fail:
-	persistent_cache_free(persistent);
-	return error;
+	return CHANNEL_RC_OK;
 }
 
 /**
@@ -1651,6 +1569,9 @@ static UINT rdpgfx_recv_surface_to_cache_pdu(GENERIC_CHANNEL_CALLBACK* callback,
 	             pdu.surfaceId, pdu.cacheKey, pdu.cacheSlot, pdu.rectSrc.left, pdu.rectSrc.top,
 	             pdu.rectSrc.right, pdu.rectSrc.bottom);
 
+	if ((pdu.cacheSlot > 0) && (pdu.cacheSlot <= gfx->MaxCacheSlots))
+		gfx->PendingImports[pdu.cacheSlot - 1] = 0;
+
 	if (context)
 	{
 		IFCALLRET(context->SurfaceToCache, error, context, &pdu);
@@ -1715,6 +1636,14 @@ static UINT rdpgfx_recv_cache_to_surface_pdu(GENERIC_CHANNEL_CALLBACK* callback,
 	             " destPtsCount: %" PRIu16 "",
 	             pdu.cacheSlot, pdu.surfaceId, pdu.destPtsCount);
 
+	if ((error = rdpgfx_load_pending_import(gfx, pdu.cacheSlot)))
+	{
+		WLog_Print(gfx->log, WLOG_ERROR,
+		           "rdpgfx_load_pending_import failed with error %" PRIu32 "", error);
+		free(pdu.destPts);
+		return error;
+	}
+
 	if (context)
 	{
 		IFCALLRET(context->CacheToSurface, error, context, &pdu);
@@ -2197,6 +2126,7 @@ static UINT rdpgfx_on_close(IWTSVirtualChannelCallback* pChannelCallback)
 
 	free_surfaces(context, gfx->SurfaceTable);
 	evict_cache_slots(context, gfx->MaxCacheSlots, gfx->CacheSlots);
+	memset(gfx->PendingImports, 0, sizeof(gfx->PendingImports));
 
 	free(callback);
 	gfx->UnacknowledgedFrames = 0;
@@ -2417,6 +2347,9 @@ void rdpgfx_client_context_free(RdpgfxClientContext* context)
 		gfx->zgfx = NULL;
 	}
 
+	persistent_cache_store_free(gfx->store);
+	gfx->store = NULL;
+
 	HashTable_Free(gfx->SurfaceTable);
 	free(context);
 }
@@ -49,7 +49,11 @@ typedef struct
 
 	UINT16 MaxCacheSlots;
 	void* CacheSlots[25600];
-	rdpPersistentCache* persistent;
+
+	rdpPersistentCacheStore* store;
+	UINT16 OfferedKeysCount;
+	UINT64 OfferedKeys[RDPGFX_CACHE_ENTRY_MAX_COUNT];
+	UINT16 PendingImports[25600]; /* offer index + 1 of imported entries not loaded yet */
 
 	rdpContext* rdpcontext;
 
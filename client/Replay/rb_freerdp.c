@@ -0,0 +1,496 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Stream Dump Replay Benchmark
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/gdi/gfx.h>
+#include <freerdp/streamdump.h>
+#include <freerdp/client/cmdline.h>
+#include <freerdp/client/channels.h>
+#include <freerdp/log.h>
+
+#include "rb_freerdp.h"
+
+#define TAG CLIENT_TAG("replay")
+
+/* Replays a recorded session (/dump:record) through the complete client stack without delays,
+ * network or display and reports where the time went. */
+
+static int rb_read_pdu(rdpTransport* transport, wStream* s)
+{
+	rbContext* rb = (rbContext*)transport_get_context(transport);
+
+	WINPR_ASSERT(rb);
+	WINPR_ASSERT(rb->ReadPdu);
+
+	const rbStage previous = rb_stats_enter(&rb->stats, RB_STAGE_READ);
+	const int rc = rb->ReadPdu(transport, s);
+	rb_stats_leave(&rb->stats, previous);
+
+	/* replaying fails when all PDUs of the dump have been read */
+	if (rc < 0)
+		rb->endOfDump = TRUE;
+	else
+	{
+		rb->stats.pdus++;
+		rb->stats.bytes += Stream_Length(s);
+	}
+	return rc;
+}
+
+static BOOL rb_hook_transport(rbContext* rb)
+{
+	WINPR_ASSERT(rb);
+
+	const rdpTransportIo* dfl = freerdp_get_io_callbacks(&rb->common.context);
+	if (!dfl)
+		return FALSE;
+
+	rdpTransportIo io = *dfl;
+	rb->ReadPdu = io.ReadPdu;
+	io.ReadPdu = rb_read_pdu;
+	return freerdp_set_io_callbacks(&rb->common.context, &io);
+}
+
+/* Times a callback of rdpUpdate or one of its order tables */
+#define RB_UPDATE_HOOK(table, name, stage, argtype)                   \
+	static BOOL rb_##table##_##name(rdpContext* context, argtype arg) \
+	{                                                                 \
+		rbContext* rb = (rbContext*)context;                          \
+		WINPR_ASSERT(rb);                                             \
+		const rbStage previous = rb_stats_enter(&rb->stats, stage);   \
+		const BOOL rc = rb->table.name(context, arg);                 \
+		rb_stats_leave(&rb->stats, previous);                         \
+		return rc;                                                    \
+	}
+
+#define RB_UPDATE_INSTALL(rb, table, dst, name) \
+	do                                          \
+	{                                           \
+		if ((rb)->table.name)                   \
+			(dst)->name = rb_##table##_##name;  \
+	} while (0)
+
+RB_UPDATE_HOOK(update, BitmapUpdate, RB_STAGE_BITMAP, const BITMAP_UPDATE*)
+RB_UPDATE_HOOK(update, SurfaceBits, RB_STAGE_SURFACE_BITS, const SURFACE_BITS_COMMAND*)
+
+RB_UPDATE_HOOK(primary, DstBlt, RB_STAGE_PRIMARY, const DSTBLT_ORDER*)
+RB_UPDATE_HOOK(primary, PatBlt, RB_STAGE_PRIMARY, PATBLT_ORDER*)
+RB_UPDATE_HOOK(primary, ScrBlt, RB_STAGE_PRIMARY, const SCRBLT_ORDER*)
+RB_UPDATE_HOOK(primary, OpaqueRect, RB_STAGE_PRIMARY, const OPAQUE_RECT_ORDER*)
+RB_UPDATE_HOOK(primary, DrawNineGrid, RB_STAGE_PRIMARY, const DRAW_NINE_GRID_ORDER*)
+RB_UPDATE_HOOK(primary, MultiDstBlt, RB_STAGE_PRIMARY, const MULTI_DSTBLT_ORDER*)
+RB_UPDATE_HOOK(primary, MultiPatBlt, RB_STAGE_PRIMARY, const MULTI_PATBLT_ORDER*)
+RB_UPDATE_HOOK(primary, MultiScrBlt, RB_STAGE_PRIMARY, const MULTI_SCRBLT_ORDER*)
+RB_UPDATE_HOOK(primary, MultiOpaqueRect, RB_STAGE_PRIMARY, const MULTI_OPAQUE_RECT_ORDER*)
+RB_UPDATE_HOOK(primary, MultiDrawNineGrid, RB_STAGE_PRIMARY, const MULTI_DRAW_NINE_GRID_ORDER*)
+RB_UPDATE_HOOK(primary, LineTo, RB_STAGE_PRIMARY, const LINE_TO_ORDER*)
+RB_UPDATE_HOOK(primary, Polyline, RB_STAGE_PRIMARY, const POLYLINE_ORDER*)
+RB_UPDATE_HOOK(primary, MemBlt, RB_STAGE_PRIMARY, MEMBLT_ORDER*)
+RB_UPDATE_HOOK(primary, Mem3Blt, RB_STAGE_PRIMARY, MEM3BLT_ORDER*)
+RB_UPDATE_HOOK(primary, SaveBitmap, RB_STAGE_PRIMARY, const SAVE_BITMAP_ORDER*)
+RB_UPDATE_HOOK(primary, GlyphIndex, RB_STAGE_PRIMARY, GLYPH_INDEX_ORDER*)
+RB_UPDATE_HOOK(primary, FastIndex, RB_STAGE_PRIMARY, const FAST_INDEX_ORDER*)
+RB_UPDATE_HOOK(primary, FastGlyph, RB_STAGE_PRIMARY, const FAST_GLYPH_ORDER*)
+RB_UPDATE_HOOK(primary, PolygonSC, RB_STAGE_PRIMARY, const POLYGON_SC_ORDER*)
+RB_UPDATE_HOOK(primary, PolygonCB, RB_STAGE_PRIMARY, POLYGON_CB_ORDER*)
+RB_UPDATE_HOOK(primary, EllipseSC, RB_STAGE_PRIMARY, const ELLIPSE_SC_ORDER*)
+RB_UPDATE_HOOK(primary, EllipseCB, RB_STAGE_PRIMARY, const ELLIPSE_CB_ORDER*)
+
+RB_UPDATE_HOOK(secondary, CacheBitmap, RB_STAGE_SECONDARY, const CACHE_BITMAP_ORDER*)
+RB_UPDATE_HOOK(secondary, CacheBitmapV2, RB_STAGE_SECONDARY, CACHE_BITMAP_V2_ORDER*)
+RB_UPDATE_HOOK(secondary, CacheBitmapV3, RB_STAGE_SECONDARY, CACHE_BITMAP_V3_ORDER*)
+RB_UPDATE_HOOK(secondary, CacheColorTable, RB_STAGE_SECONDARY, const CACHE_COLOR_TABLE_ORDER*)
+RB_UPDATE_HOOK(secondary, CacheGlyph, RB_STAGE_SECONDARY, const CACHE_GLYPH_ORDER*)
+RB_UPDATE_HOOK(secondary, CacheGlyphV2, RB_STAGE_SECONDARY, const CACHE_GLYPH_V2_ORDER*)
+RB_UPDATE_HOOK(secondary, CacheBrush, RB_STAGE_SECONDARY, const CACHE_BRUSH_ORDER*)
+
+static BOOL rb_hook_update(rbContext* rb)
+{
+	WINPR_ASSERT(rb);
+
+	rdpUpdate* update = rb->common.context.update;
+	WINPR_ASSERT(update);
+	WINPR_ASSERT(update->primary);
+	WINPR_ASSERT(update->secondary);
+
+	rb->update = *update;
+	rb->primary = *update->primary;
+	rb->secondary = *update->secondary;
+
+	RB_UPDATE_INSTALL(rb, update, update, BitmapUpdate);
+	RB_UPDATE_INSTALL(rb, update, update, SurfaceBits);
+
+	rdpPrimaryUpdate* primary = update->primary;
+	RB_UPDATE_INSTALL(rb, primary, primary, DstBlt);
+	RB_UPDATE_INSTALL(rb, primary, primary, PatBlt);
+	RB_UPDATE_INSTALL(rb, primary, primary, ScrBlt);
+	RB_UPDATE_INSTALL(rb, primary, primary, OpaqueRect);
+	RB_UPDATE_INSTALL(rb, primary, primary, DrawNineGrid);
+	RB_UPDATE_INSTALL(rb, primary, primary, MultiDstBlt);
+	RB_UPDATE_INSTALL(rb, primary, primary, MultiPatBlt);
+	RB_UPDATE_INSTALL(rb, primary, primary, MultiScrBlt);
+	RB_UPDATE_INSTALL(rb, primary, primary, MultiOpaqueRect);
+	RB_UPDATE_INSTALL(rb, primary, primary, MultiDrawNineGrid);
+	RB_UPDATE_INSTALL(rb, primary, primary, LineTo);
+	RB_UPDATE_INSTALL(rb, primary, primary, Polyline);
+	RB_UPDATE_INSTALL(rb, primary, primary, MemBlt);
+	RB_UPDATE_INSTALL(rb, primary, primary, Mem3Blt);
+	RB_UPDATE_INSTALL(rb, primary, primary, SaveBitmap);
+	RB_UPDATE_INSTALL(rb, primary, primary, GlyphIndex);
+	RB_UPDATE_INSTALL(rb, primary, primary, FastIndex);
+	RB_UPDATE_INSTALL(rb, primary, primary, FastGlyph);
+	RB_UPDATE_INSTALL(rb, primary, primary, PolygonSC);
+	RB_UPDATE_INSTALL(rb, primary, primary, PolygonCB);
+	RB_UPDATE_INSTALL(rb, primary, primary, EllipseSC);
+	RB_UPDATE_INSTALL(rb, primary, primary, EllipseCB);
+
+	rdpSecondaryUpdate* secondary = update->secondary;
+	RB_UPDATE_INSTALL(rb, secondary, secondary, CacheBitmap);
+	RB_UPDATE_INSTALL(rb, secondary, secondary, CacheBitmapV2);
+	RB_UPDATE_INSTALL(rb, secondary, secondary, CacheBitmapV3);
+	RB_UPDATE_INSTALL(rb, secondary, secondary, CacheColorTable);
+	RB_UPDATE_INSTALL(rb, secondary, secondary, CacheGlyph);
+	RB_UPDATE_INSTALL(rb, secondary, secondary, CacheGlyphV2);
+	RB_UPDATE_INSTALL(rb, secondary, secondary, CacheBrush);
+	return TRUE;
+}
+
+static rbContext* rb_gfx_context(RdpgfxClientContext* gfx)
+{
+	WINPR_ASSERT(gfx);
+
+	rdpGdi* gdi = (rdpGdi*)gfx->custom;
+	WINPR_ASSERT(gdi);
+	return (rbContext*)gdi->context;
+}
+
+/* Times a callback of the graphics pipeline */
+#define RB_GFX_HOOK(name, stage, argtype)                            \
+	static UINT rb_gfx_##name(RdpgfxClientContext* gfx, argtype arg) \
+	{                                                                \
+		rbContext* rb = rb_gfx_context(gfx);                         \
+		WINPR_ASSERT(rb);                                            \
+		const rbStage previous = rb_stats_enter(&rb->stats, stage);  \
+		const UINT rc = rb->gfx.name(gfx, arg);                      \
+		rb_stats_leave(&rb->stats, previous);                        \
+		return rc;                                                   \
+	}
+
+RB_GFX_HOOK(SurfaceCommand, RB_STAGE_GFX_COMMAND, const RDPGFX_SURFACE_COMMAND*)
+RB_GFX_HOOK(SolidFill, RB_STAGE_GFX_BLIT, const RDPGFX_SOLID_FILL_PDU*)
+RB_GFX_HOOK(SurfaceToSurface, RB_STAGE_GFX_BLIT, const RDPGFX_SURFACE_TO_SURFACE_PDU*)
+RB_GFX_HOOK(SurfaceToCache, RB_STAGE_GFX_BLIT, const RDPGFX_SURFACE_TO_CACHE_PDU*)
+RB_GFX_HOOK(CacheToSurface, RB_STAGE_GFX_BLIT, const RDPGFX_CACHE_TO_SURFACE_PDU*)
+
+static UINT rb_gfx_EndFrame(RdpgfxClientContext* gfx, const RDPGFX_END_FRAME_PDU* endFrame)
+{
+	rbContext* rb = rb_gfx_context(gfx);
+	WINPR_ASSERT(rb);
+
+	rb->stats.gfxFrames++;
+	return rb->gfx.EndFrame(gfx, endFrame);
+}
+
+static UINT rb_gfx_UpdateSurfaces(RdpgfxClientContext* gfx)
+{
+	rbContext* rb = rb_gfx_context(gfx);
+	WINPR_ASSERT(rb);
+
+	const rbStage previous = rb_stats_enter(&rb->stats, RB_STAGE_GFX_OUTPUT);
+	const UINT rc = rb->gfx.UpdateSurfaces(gfx);
+	rb_stats_leave(&rb->stats, previous);
+	return rc;
+}
+
+#define RB_GFX_INSTALL(rb, gfx, name)    \
+	do                                   \
+	{                                    \
+		if ((rb)->gfx.name)              \
+			(gfx)->name = rb_gfx_##name; \
+	} while (0)
+
+static void rb_hook_gfx(rbContext* rb, RdpgfxClientContext* gfx)
+{
+	WINPR_ASSERT(rb);
+	WINPR_ASSERT(gfx);
+
+	rb->gfx = *gfx;
+	RB_GFX_INSTALL(rb, gfx, SurfaceCommand);
+	RB_GFX_INSTALL(rb, gfx, SolidFill);
+	RB_GFX_INSTALL(rb, gfx, SurfaceToSurface);
+	RB_GFX_INSTALL(rb, gfx, SurfaceToCache);
+	RB_GFX_INSTALL(rb, gfx, CacheToSurface);
+	RB_GFX_INSTALL(rb, gfx, EndFrame);
+	RB_GFX_INSTALL(rb, gfx, UpdateSurfaces);
+}
+
+static void rb_OnChannelConnectedEventHandler(void* context, const ChannelConnectedEventArgs* e)
+{
+	rbContext* rb = (rbContext*)context;
+
+	WINPR_ASSERT(rb);
+	WINPR_ASSERT(e);
+
+	freerdp_client_OnChannelConnectedEventHandler(&rb->common, e);
+	if (strcmp(e->name, RDPGFX_DVC_CHANNEL_NAME) == 0)
+		rb_hook_gfx(rb, (RdpgfxClientContext*)e->pInterface);
+}
+
+static void rb_OnChannelDisconnectedEventHandler(void* context,
+                                                 const ChannelDisconnectedEventArgs* e)
+{
+	rbContext* rb = (rbContext*)context;
+
+	WINPR_ASSERT(rb);
+	freerdp_client_OnChannelDisconnectedEventHandler(&rb->common, e);
+}
+
+static BOOL rb_begin_paint(rdpContext* context)
+{
+	WINPR_ASSERT(context);
+
+	rdpGdi* gdi = context->gdi;
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(gdi->primary);
+	WINPR_ASSERT(gdi->primary->hdc);
+	WINPR_ASSERT(gdi->primary->hdc->hwnd);
+	WINPR_ASSERT(gdi->primary->hdc->hwnd->invalid);
+	gdi->primary->hdc->hwnd->invalid->null = TRUE;
+	return TRUE;
+}
+
+/* A frame is complete, a real client would present the invalid region now */
+static BOOL rb_end_paint(rdpContext* context)
+{
+	rbContext* rb = (rbContext*)context;
+
+	WINPR_ASSERT(rb);
+
+	const rbStage previous = rb_stats_enter(&rb->stats, RB_STAGE_PAINT);
+	rdpGdi* gdi = context->gdi;
+	WINPR_ASSERT(gdi);
+	WINPR_ASSERT(gdi->primary);
+	WINPR_ASSERT(gdi->primary->hdc);
+	WINPR_ASSERT(gdi->primary->hdc->hwnd);
+	WINPR_ASSERT(gdi->primary->hdc->hwnd->invalid);
+
+	if (!gdi->primary->hdc->hwnd->invalid->null)
+		rb->stats.frames++;
+	rb_stats_leave(&rb->stats, previous);
+	return TRUE;
+}
+
+static BOOL rb_desktop_resize(rdpContext* context)
+{
+	WINPR_ASSERT(context);
+
+	const rdpSettings* settings = context->settings;
+	WINPR_ASSERT(settings);
+
+	return gdi_resize(context->gdi, freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
+	                  freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight));
+}
+
+static BOOL rb_pre_connect(freerdp* instance)
+{
+	WINPR_ASSERT(instance);
+	WINPR_ASSERT(instance->context);
+
+	rdpSettings* settings = instance->context->settings;
+	WINPR_ASSERT(settings);
+
+	if (!freerdp_settings_set_uint32(settings, FreeRDP_OsMajorType, OSMAJORTYPE_UNIX))
+		return FALSE;
+	if (!freerdp_settings_set_uint32(settings, FreeRDP_OsMinorType, OSMINORTYPE_NATIVE_XSERVER))
+		return FALSE;
+
+	PubSub_SubscribeChannelConnected(instance->context->pubSub, rb_OnChannelConnectedEventHandler);
+	PubSub_SubscribeChannelDisconnected(instance->context->pubSub,
+	                                    rb_OnChannelDisconnectedEventHandler);
+	return TRUE;
+}
+
+static BOOL rb_post_connect(freerdp* instance)
+{
+	WINPR_ASSERT(instance);
+
+	if (!gdi_init(instance, PIXEL_FORMAT_BGRX32))
+		return FALSE;
+
+	rbContext* rb = (rbContext*)instance->context;
+	WINPR_ASSERT(rb);
+
+	rdpUpdate* update = rb->common.context.update;
+	WINPR_ASSERT(update);
+
+	update->BeginPaint = rb_begin_paint;
+	update->EndPaint = rb_end_paint;
+	update->DesktopResize = rb_desktop_resize;
+	if (!rb_hook_update(rb))
+		return FALSE;
+
+	rb_stats_connected(&rb->stats);
+	return TRUE;
+}
+
+static void rb_post_disconnect(freerdp* instance)
+{
+	if (!instance || !instance->context)
+		return;
+
+	PubSub_UnsubscribeChannelConnected(instance->context->pubSub,
+	                                   rb_OnChannelConnectedEventHandler);
+	PubSub_UnsubscribeChannelDisconnected(instance->context->pubSub,
+	                                      rb_OnChannelDisconnectedEventHandler);
+	gdi_free(instance);
+}
+
+static BOOL rb_client_new(freerdp* instance, rdpContext* context)
+{
+	if (!instance || !context)
+		return FALSE;
+
+	instance->PreConnect = rb_pre_connect;
+	instance->PostConnect = rb_post_connect;
+	instance->PostDisconnect = rb_post_disconnect;
+	return TRUE;
+}
+
+static int RdpClientEntry(RDP_CLIENT_ENTRY_POINTS* pEntryPoints)
+{
+	WINPR_ASSERT(pEntryPoints);
+
+	ZeroMemory(pEntryPoints, sizeof(RDP_CLIENT_ENTRY_POINTS));
+	pEntryPoints->Version = RDP_CLIENT_INTERFACE_VERSION;
+	pEntryPoints->Size = sizeof(RDP_CLIENT_ENTRY_POINTS_V1);
+	pEntryPoints->ContextSize = sizeof(rbContext);
+	pEntryPoints->ClientNew = rb_client_new;
+	return 0;
+}
+
+static BOOL rb_configure(rdpSettings* settings, const char* dump)
+{
+	WINPR_ASSERT(settings);
+	WINPR_ASSERT(dump);
+
+	if (!freerdp_settings_set_string(settings, FreeRDP_TransportDumpFile, dump) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_TransportDump, FALSE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_TransportDumpReplay, TRUE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_TransportDumpReplayNodelay, TRUE))
+		return FALSE;
+
+	/* the connection is not made, but a target is required */
+	if (!freerdp_settings_get_string(settings, FreeRDP_ServerHostname))
+		return freerdp_settings_set_string(settings, FreeRDP_ServerHostname, "replay");
+	return TRUE;
+}
+
+/* Processes the session until the dump is exhausted */
+static BOOL rb_replay(rbContext* rb)
+{
+	WINPR_ASSERT(rb);
+
+	rdpContext* context = &rb->common.context;
+	freerdp* instance = context->instance;
+
+	rb_stats_start(&rb->stats);
+	BOOL rc = freerdp_connect(instance);
+	while (rc && !freerdp_shall_disconnect_context(context))
+	{
+		if (!freerdp_check_event_handles(context))
+			break;
+	}
+	rb_stats_stop(&rb->stats);
+
+	/* a dump that ends before the session is active measured nothing */
+	if (!rc || !rb->endOfDump || (rb->stats.pdus == 0))
+	{
+		WLog_ERR(TAG, "replay failed after %" PRIu64 " PDUs, %s", rb->stats.pdus,
+		         freerdp_get_last_error_string(freerdp_get_last_error(context)));
+		rc = FALSE;
+	}
+
+	freerdp_disconnect(instance);
+	return rc;
+}
+
+int main(int argc, char* argv[])
+{
+	int rc = -1;
+	RDP_CLIENT_ENTRY_POINTS clientEntryPoints = { 0 };
+
+	if (argc < 2)
+	{
+		(void)fprintf(stderr, "Usage: %s <dump file> [client options used for recording]\n",
+		              argv[0]);
+		return -1;
+	}
+
+	RdpClientEntry(&clientEntryPoints);
+	rdpContext* context = freerdp_client_context_new(&clientEntryPoints);
+	if (!context)
+		goto fail;
+
+	const char* dump = argv[1];
+
+	/* the dump file replaces the first argument */
+	if (argc > 2)
+	{
+		argv[1] = argv[0];
+		const int status = freerdp_client_settings_parse_command_line(context->settings, argc - 1,
+		                                                              &argv[1], FALSE);
+		if (status)
+		{
+			rc = freerdp_client_settings_command_line_status_print(context->settings, status,
+			                                                       argc - 1, &argv[1]);
+			goto fail;
+		}
+	}
+
+	rbContext* rb = (rbContext*)context;
+	if (!rb_configure(context->settings, dump))
+		goto fail;
+
+	if (!stream_dump_register_handlers(context, CONNECTION_STATE_MCS_CREATE_REQUEST, FALSE) ||
+	    !rb_hook_transport(rb))
+		goto fail;
+
+	if (freerdp_client_start(context) != 0)
+		goto fail;
+
+	if (rb_replay(rb))
+	{
+		rb_stats_print(&rb->stats, stdout);
+		rc = 0;
+	}
+
+	if (freerdp_client_stop(context) != 0)
+		rc = -1;
+
+fail:
+	freerdp_client_context_free(context);
+	return rc;
+}
@@ -0,0 +1,42 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Stream Dump Replay Benchmark
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CLIENT_REPLAY_H
+#define FREERDP_CLIENT_REPLAY_H
+
+#include <freerdp/freerdp.h>
+#include <freerdp/transport_io.h>
+#include <freerdp/client/rdpgfx.h>
+
+#include "rb_stats.h"
+
+typedef struct
+{
+	rdpClientContext common;
+
+	rbStats stats;
+	BOOL endOfDump;
+
+	/* the callbacks of the library, called by the timing wrappers */
+	pTransportRWFkt ReadPdu;
+	rdpUpdate update;
+	rdpPrimaryUpdate primary;
+	rdpSecondaryUpdate secondary;
+	RdpgfxClientContext gfx;
+} rbContext;
+
+#endif /* FREERDP_CLIENT_REPLAY_H */
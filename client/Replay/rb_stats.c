@@ -0,0 +1,258 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Stream Dump Replay Benchmark Statistics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <winpr/assert.h>
+#include <winpr/sysinfo.h>
+
+#include "rb_stats.h"
+
+/* glibc exports its allocator, so the benchmark can count allocations of all libraries by
+ * defining the allocation functions itself. Sanitizers replace them already. */
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || \
+    __has_feature(memory_sanitizer)
+#define RB_NO_ALLOC_HOOKS
+#endif
+#endif
+#if !defined(RB_NO_ALLOC_HOOKS)
+#define RB_ALLOC_HOOKS
+#endif
+#endif
+
+#if defined(RB_ALLOC_HOOKS)
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* ptr);
+
+static rbAllocCounts rb_allocs = { 0 };
+
+/* the libraries must resolve to these, the build hides symbols by default */
+#define RB_EXPORT __attribute__((visibility("default")))
+
+#define rb_alloc_count(field) (void)__atomic_fetch_add(&rb_allocs.field, 1, __ATOMIC_RELAXED)
+
+RB_EXPORT void* malloc(size_t size)
+{
+	rb_alloc_count(mallocs);
+	return __libc_malloc(size);
+}
+
+RB_EXPORT void* calloc(size_t nmemb, size_t size)
+{
+	rb_alloc_count(callocs);
+	return __libc_calloc(nmemb, size);
+}
+
+RB_EXPORT void* realloc(void* ptr, size_t size)
+{
+	rb_alloc_count(reallocs);
+	return __libc_realloc(ptr, size);
+}
+
+RB_EXPORT void* aligned_alloc(size_t alignment, size_t size)
+{
+	rb_alloc_count(mallocs);
+	return __libc_memalign(alignment, size);
+}
+
+RB_EXPORT int posix_memalign(void** memptr, size_t alignment, size_t size)
+{
+	if (((alignment % sizeof(void*)) != 0) || ((alignment & (alignment - 1)) != 0))
+		return EINVAL;
+
+	rb_alloc_count(mallocs);
+	*memptr = __libc_memalign(alignment, size);
+	return *memptr ? 0 : ENOMEM;
+}
+
+RB_EXPORT void free(void* ptr)
+{
+	if (ptr)
+		rb_alloc_count(frees);
+	__libc_free(ptr);
+}
+
+BOOL rb_alloc_get_counts(rbAllocCounts* counts)
+{
+	WINPR_ASSERT(counts);
+
+	counts->mallocs = __atomic_load_n(&rb_allocs.mallocs, __ATOMIC_RELAXED);
+	counts->callocs = __atomic_load_n(&rb_allocs.callocs, __ATOMIC_RELAXED);
+	counts->reallocs = __atomic_load_n(&rb_allocs.reallocs, __ATOMIC_RELAXED);
+	counts->frees = __atomic_load_n(&rb_allocs.frees, __ATOMIC_RELAXED);
+	return TRUE;
+}
+
+#else
+
+BOOL rb_alloc_get_counts(rbAllocCounts* counts)
+{
+	WINPR_ASSERT(counts);
+
+	const rbAllocCounts empty = { 0 };
+	*counts = empty;
+	return FALSE;
+}
+
+#endif
+
+static const char* rb_stage_name(rbStage stage)
+{
+	switch (stage)
+	{
+		case RB_STAGE_PROTOCOL:
+			return "protocol";
+		case RB_STAGE_READ:
+			return "dump read";
+		case RB_STAGE_BITMAP:
+			return "bitmap update";
+		case RB_STAGE_SURFACE_BITS:
+			return "surface bits";
+		case RB_STAGE_PRIMARY:
+			return "primary orders";
+		case RB_STAGE_SECONDARY:
+			return "secondary orders";
+		case RB_STAGE_GFX_COMMAND:
+			return "gfx surface command";
+		case RB_STAGE_GFX_BLIT:
+			return "gfx fill/copy/cache";
+		case RB_STAGE_GFX_OUTPUT:
+			return "gfx output";
+		case RB_STAGE_PAINT:
+			return "end paint";
+		case RB_STAGE_COUNT:
+		default:
+			return "unknown";
+	}
+}
+
+static void rb_stats_charge(rbStats* stats, UINT64 now)
+{
+	WINPR_ASSERT(stats);
+	WINPR_ASSERT(stats->current < RB_STAGE_COUNT);
+
+	stats->ns[stats->current] += now - stats->since;
+	stats->since = now;
+}
+
+void rb_stats_start(rbStats* stats)
+{
+	WINPR_ASSERT(stats);
+
+	const rbStats empty = { 0 };
+	*stats = empty;
+
+	stats->haveAllocs = rb_alloc_get_counts(&stats->allocs);
+	stats->start = winpr_GetTickCount64NS();
+	stats->since = stats->start;
+	stats->current = RB_STAGE_PROTOCOL;
+}
+
+void rb_stats_connected(rbStats* stats)
+{
+	WINPR_ASSERT(stats);
+	stats->connected = winpr_GetTickCount64NS();
+}
+
+void rb_stats_stop(rbStats* stats)
+{
+	WINPR_ASSERT(stats);
+
+	stats->end = winpr_GetTickCount64NS();
+	rb_stats_charge(stats, stats->end);
+	if (!stats->connected)
+		stats->connected = stats->end;
+
+	rbAllocCounts counts = { 0 };
+	if (stats->haveAllocs && rb_alloc_get_counts(&counts))
+	{
+		stats->allocs.mallocs = counts.mallocs - stats->allocs.mallocs;
+		stats->allocs.callocs = counts.callocs - stats->allocs.callocs;
+		stats->allocs.reallocs = counts.reallocs - stats->allocs.reallocs;
+		stats->allocs.frees = counts.frees - stats->allocs.frees;
+	}
+}
+
+rbStage rb_stats_enter(rbStats* stats, rbStage stage)
+{
+	WINPR_ASSERT(stats);
+	WINPR_ASSERT(stage < RB_STAGE_COUNT);
+
+	const rbStage previous = stats->current;
+	rb_stats_charge(stats, winpr_GetTickCount64NS());
+	stats->calls[stage]++;
+	stats->current = stage;
+	return previous;
+}
+
+void rb_stats_leave(rbStats* stats, rbStage previous)
+{
+	WINPR_ASSERT(stats);
+
+	rb_stats_charge(stats, winpr_GetTickCount64NS());
+	stats->current = previous;
+}
+
+void rb_stats_print(const rbStats* stats, FILE* fp)
+{
+	WINPR_ASSERT(stats);
+	WINPR_ASSERT(fp);
+
+	const double total = (double)(stats->end - stats->start) / 1000000000.0;
+	const double connect = (double)(stats->connected - stats->start) / 1000000000.0;
+	const double session = total - connect;
+
+	(void)fprintf(fp, "replayed %" PRIu64 " PDUs, %" PRIu64 " bytes in %.3f s (connect %.3f s)\n",
+	              stats->pdus, stats->bytes, total, connect);
+	(void)fprintf(fp, "frames %" PRIu64 " (%.1f fps), gfx frames %" PRIu64 " (%.1f fps)\n",
+	              stats->frames, (session > 0.0) ? (double)stats->frames / session : 0.0,
+	              stats->gfxFrames, (session > 0.0) ? (double)stats->gfxFrames / session : 0.0);
+
+	(void)fprintf(fp, "%-20s %12s %12s %10s %7s\n", "stage", "calls", "time [ms]", "avg [us]",
+	              "share");
+	for (size_t x = 0; x < RB_STAGE_COUNT; x++)
+	{
+		const double ms = (double)stats->ns[x] / 1000000.0;
+		const double avg = stats->calls[x] ? ms * 1000.0 / (double)stats->calls[x] : 0.0;
+		const double share = (total > 0.0) ? ms / 10.0 / total : 0.0;
+
+		(void)fprintf(fp, "%-20s %12" PRIu64 " %12.3f %10.3f %6.1f%%\n",
+		              rb_stage_name((rbStage)x), stats->calls[x], ms, avg, share);
+	}
+
+	if (stats->haveAllocs)
+		(void)fprintf(fp,
+		              "allocations: malloc %" PRIu64 ", calloc %" PRIu64 ", realloc %" PRIu64
+		              ", free %" PRIu64 " (%.1f per frame)\n",
+		              stats->allocs.mallocs, stats->allocs.callocs, stats->allocs.reallocs,
+		              stats->allocs.frees,
+		              stats->frames ? (double)(stats->allocs.mallocs + stats->allocs.callocs +
+		                                       stats->allocs.reallocs) /
+		                                  (double)stats->frames
+		                            : 0.0);
+	else
+		(void)fprintf(fp, "allocations: not available with this C library\n");
+}
@@ -0,0 +1,82 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Stream Dump Replay Benchmark Statistics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CLIENT_REPLAY_STATS_H
+#define FREERDP_CLIENT_REPLAY_STATS_H
+
+#include <stdio.h>
+
+#include <winpr/wtypes.h>
+
+typedef enum
+{
+	RB_STAGE_PROTOCOL, /* everything not covered by another stage, mostly parsing */
+	RB_STAGE_READ,
+	RB_STAGE_BITMAP,
+	RB_STAGE_SURFACE_BITS,
+	RB_STAGE_PRIMARY,
+	RB_STAGE_SECONDARY,
+	RB_STAGE_GFX_COMMAND,
+	RB_STAGE_GFX_BLIT,
+	RB_STAGE_GFX_OUTPUT,
+	RB_STAGE_PAINT,
+	RB_STAGE_COUNT
+} rbStage;
+
+typedef struct
+{
+	UINT64 mallocs;
+	UINT64 callocs;
+	UINT64 reallocs;
+	UINT64 frees;
+} rbAllocCounts;
+
+/* Timing is exclusive, a stage entered from another one pauses it. All stages run on the
+ * thread processing the session, replayed dynamic channels are synchronous. */
+typedef struct
+{
+	UINT64 calls[RB_STAGE_COUNT];
+	UINT64 ns[RB_STAGE_COUNT];
+	rbStage current;
+	UINT64 since;
+
+	UINT64 start;
+	UINT64 connected;
+	UINT64 end;
+
+	UINT64 pdus;
+	UINT64 bytes;
+	UINT64 frames;
+	UINT64 gfxFrames;
+
+	BOOL haveAllocs;
+	rbAllocCounts allocs;
+} rbStats;
+
+void rb_stats_start(rbStats* stats);
+void rb_stats_connected(rbStats* stats);
+void rb_stats_stop(rbStats* stats);
+
+rbStage rb_stats_enter(rbStats* stats, rbStage stage);
+void rb_stats_leave(rbStats* stats, rbStage previous);
+
+void rb_stats_print(const rbStats* stats, FILE* fp);
+
+/* Returns FALSE if allocations can not be counted with this C library */
+BOOL rb_alloc_get_counts(rbAllocCounts* counts);
+
+#endif /* FREERDP_CLIENT_REPLAY_STATS_H */
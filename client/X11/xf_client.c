@@ -101,6 +101,7 @@
 #include "xf_monitor.h"
 #include "xf_graphics.h"
 #include "xf_keyboard.h"
+#include "xf_shm.h"
 #include "xf_channels.h"
 #include "xf_client.h"
 #include "xfreerdp.h"
@@ -422,14 +423,24 @@ static BOOL xf_paint(xfContext* xfc, const GDI_RGN* region)
 	}
 	else
 	{
-		XPutImage(xfc->display, xfc->primary, xfc->gc, xfc->image, region->x, region->y, region->x,
-		          region->y, WINPR_ASSERTING_INT_CAST(UINT16, region->w),
-		          WINPR_ASSERTING_INT_CAST(UINT16, region->h));
+		xf_shm_put_image(xfc, xfc->shmImage, xfc->image, xfc->primary, xfc->gc, region->x,
+		                 region->y, region->x, region->y,
+		                 WINPR_ASSERTING_INT_CAST(UINT16, region->w),
+		                 WINPR_ASSERTING_INT_CAST(UINT16, region->h));
 		xf_draw_screen(xfc, region->x, region->y, region->w, region->h);
 	}
 	return TRUE;
 }
 
+static BOOL xf_begin_paint(rdpContext* context)
+{
+	xfContext* xfc = (xfContext*)context;
+
+	/* the X server might still read the shared primary buffer */
+	xf_shm_wait(xfc);
+	return TRUE;
+}
+
 static BOOL xf_end_paint(rdpContext* context)
 {
 	xfContext* xfc = (xfContext*)context;
@@ -476,38 +487,80 @@ static BOOL xf_end_paint(rdpContext* context)
 	return TRUE;
 }
 
+static void xf_free_image(xfContext* xfc)
+{
+	if (xfc->shmImage)
+	{
+		xf_shm_image_free(xfc, xfc->shmImage);
+		xfc->shmImage = NULL;
+	}
+	else if (xfc->image)
+	{
+		xfc->image->data = NULL;
+		XDestroyImage(xfc->image);
+	}
+	xfc->image = NULL;
+}
+
 static BOOL xf_sw_desktop_resize(rdpContext* context)
 {
 	rdpGdi* gdi = context->gdi;
 	xfContext* xfc = (xfContext*)context;
 	rdpSettings* settings = context->settings;
 	BOOL ret = FALSE;
+	xfShmImage* shmImage = NULL;
+	const UINT32 width = freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth);
+	const UINT32 height = freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight);
+	const BOOL keep =
+	    xfc->shmImage && (gdi->width == (INT32)width) && (gdi->height == (INT32)height);
+
+	if (!keep)
+		shmImage = xf_shm_image_new(xfc, width, height);
 
-	if (!gdi_resize(gdi, freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
-	                freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight)))
+	if (shmImage)
+	{
+		const XImage* image = shmImage->image;
+
+		/* the X server might still read the old primary buffer */
+		xf_shm_wait(xfc);
+		if (!gdi_resize_ex(gdi, width, height,
+		                   WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), gdi->dstFormat,
+		                   (BYTE*)image->data, NULL))
+		{
+			xf_shm_image_free(xfc, shmImage);
+			return FALSE;
+		}
+	}
+	else if (!keep && !gdi_resize(gdi, width, height))
 		return FALSE;
 
 	/* Do not lock during gdi_resize, there might still be drawing operations in progress.
 	 * locking will deadlock. */
 	xf_lock_x11(xfc);
-	if (xfc->image)
+	if (!keep)
 	{
-		xfc->image->data = NULL;
-		XDestroyImage(xfc->image);
+		xf_free_image(xfc);
+		xfc->shmImage = shmImage;
 	}
 
-	WINPR_ASSERT(xfc->depth != 0);
-	if (!(xfc->image = XCreateImage(
-	          xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth), ZPixmap, 0,
-	          (char*)gdi->primary_buffer, WINPR_ASSERTING_INT_CAST(uint32_t, gdi->width),
-	          WINPR_ASSERTING_INT_CAST(uint32_t, gdi->height), xfc->scanline_pad,
-	          WINPR_ASSERTING_INT_CAST(int, gdi->stride))))
+	if (xfc->shmImage)
+		xfc->image = xfc->shmImage->image;
+	else
 	{
-		goto out;
-	}
+		WINPR_ASSERT(xfc->depth != 0);
+		if (!(xfc->image = XCreateImage(
+		          xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth),
+		          ZPixmap, 0, (char*)gdi->primary_buffer,
+		          WINPR_ASSERTING_INT_CAST(uint32_t, gdi->width),
+		          WINPR_ASSERTING_INT_CAST(uint32_t, gdi->height), xfc->scanline_pad,
+		          WINPR_ASSERTING_INT_CAST(int, gdi->stride))))
+		{
+			goto out;
+		}
 
-	xfc->image->byte_order = LSBFirst;
-	xfc->image->bitmap_bit_order = LSBFirst;
+		xfc->image->byte_order = LSBFirst;
+		xfc->image->bitmap_bit_order = LSBFirst;
+	}
 	ret = xf_desktop_resize(context);
 out:
 	xf_unlock_x11(xfc);
@@ -530,7 +583,10 @@ static BOOL xf_process_x_events(freerdp* instance)
 			XEvent xevent = { 0 };
 
 			XNextEvent(xfc->display, &xevent);
-			status = xf_event_process(instance, &xevent);
+
+			/* XShmPutImage completions are frequent, skip the generic event handling */
+			if (!xf_shm_handle_xevent(xfc, &xevent))
+				status = xf_event_process(instance, &xevent);
 		}
 		xf_unlock_x11(xfc);
 		if (!status)
@@ -720,6 +776,9 @@ BOOL xf_create_window(xfContext* xfc)
 BOOL xf_create_image(xfContext* xfc)
 {
 	WINPR_ASSERT(xfc);
+	if (!xfc->image && xfc->shmImage)
+		xfc->image = xfc->shmImage->image;
+
 	if (!xfc->image)
 	{
 		const rdpSettings* settings = xfc->common.context.settings;
@@ -755,12 +814,7 @@ static void xf_window_free(xfContext* xfc)
 	}
 #endif
 
-	if (xfc->image)
-	{
-		xfc->image->data = NULL;
-		XDestroyImage(xfc->image);
-		xfc->image = NULL;
-	}
+	xf_free_image(xfc);
 
 	if (xfc->bitmap_mono)
 	{
@@ -1399,7 +1453,21 @@ static BOOL xf_post_connect(freerdp* instance)
 	if (!xf_get_pixmap_info(xfc))
 		return FALSE;
 
-	if (!gdi_init(instance, xf_get_local_color_format(xfc, TRUE)))
+	/* The primary buffer is shared with the X server if possible */
+	xfc->xfShm = xf_shm_new(xfc);
+	xfc->shmImage =
+	    xf_shm_image_new(xfc, freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
+	                     freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight));
+
+	if (xfc->shmImage)
+	{
+		const XImage* image = xfc->shmImage->image;
+		if (!gdi_init_ex(instance, xf_get_local_color_format(xfc, TRUE),
+		                 WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line),
+		                 (BYTE*)image->data, NULL))
+			return FALSE;
+	}
+	else if (!gdi_init(instance, xf_get_local_color_format(xfc, TRUE)))
 		return FALSE;
 
 	if (!xf_create_image(xfc))
@@ -1435,6 +1503,7 @@ static BOOL xf_post_connect(freerdp* instance)
 	}
 
 	update->DesktopResize = xf_sw_desktop_resize;
+	update->BeginPaint = xf_begin_paint;
 	update->EndPaint = xf_end_paint;
 	update->PlaySound = xf_play_sound;
 	update->SetKeyboardIndicators = xf_keyboard_set_indicators;
@@ -1506,6 +1575,8 @@ static void xf_post_disconnect(freerdp* instance)
 		xf_DestroyDummyWindow(xfc, xfc->drawable);
 
 	xf_window_free(xfc);
+	xf_shm_free(xfc->xfShm);
+	xfc->xfShm = NULL;
 }
 
 static void xf_post_final_disconnect(freerdp* instance)
@@ -1561,6 +1632,7 @@ static DWORD WINAPI xf_client_thread(LPVOID param)
 	DWORD waitStatus = 0;
 	HANDLE inputEvent = NULL;
 	HANDLE timer = NULL;
+	WINPR_WAIT_SET* waitSet = NULL;
 	LARGE_INTEGER due = { 0 };
 	TimerEventArgs timerEvent = { 0 };
 
@@ -1624,6 +1696,14 @@ static DWORD WINAPI xf_client_thread(LPVOID param)
 	}
 	inputEvent = xfc->x11event;
 
+	/* the handles rarely change between iterations, keep them registered */
+	waitSet = winpr_WaitSet_New();
+	if (!waitSet)
+	{
+		WLog_ERR(TAG, "failed to create wait set");
+		goto disconnect;
+	}
+
 	while (!freerdp_shall_disconnect_context(instance->context))
 	{
 		HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
@@ -1658,7 +1738,10 @@ static DWORD WINAPI xf_client_thread(LPVOID param)
 		if (xfc->window)
 			xf_floatbar_hide_and_show(xfc->window->floatbar);
 
-		waitStatus = WaitForMultipleObjects(nCount, handles, FALSE, INFINITE);
+		if (!winpr_WaitSet_Update(waitSet, nCount, handles))
+			break;
+
+		waitStatus = winpr_WaitSet_Wait(waitSet, INFINITE);
 
 		if (waitStatus == WAIT_FAILED)
 			break;
@@ -1713,6 +1796,8 @@ static DWORD WINAPI xf_client_thread(LPVOID param)
 
 disconnect:
 
+	winpr_WaitSet_Free(waitSet);
+
 	if (timer)
 		(void)CloseHandle(timer);
 
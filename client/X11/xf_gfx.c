@@ -29,6 +29,7 @@
 #include <freerdp/log.h>
 #include "xf_gfx.h"
 #include "xf_rail.h"
+#include "xf_shm.h"
 
 #include <X11/Xutil.h>
 
@@ -94,10 +95,11 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 
 		if (xfc->remote_app)
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image,
-			          WINPR_ASSERTING_INT_CAST(int, nXSrc), WINPR_ASSERTING_INT_CAST(int, nYSrc),
-			          WINPR_ASSERTING_INT_CAST(int, nXDst), WINPR_ASSERTING_INT_CAST(int, nYDst),
-			          dwidth, dheight);
+			xf_shm_put_image(xfc, surface->shm, surface->image, xfc->primary, xfc->gc,
+			                 WINPR_ASSERTING_INT_CAST(int, nXSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nYSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nXDst),
+			                 WINPR_ASSERTING_INT_CAST(int, nYDst), dwidth, dheight);
 			xf_lock_x11(xfc);
 			xf_rail_paint_surface(xfc, surface->gdi.windowId, rect);
 			xf_unlock_x11(xfc);
@@ -107,10 +109,11 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 		    if (freerdp_settings_get_bool(settings, FreeRDP_SmartSizing) ||
 		        freerdp_settings_get_bool(settings, FreeRDP_MultiTouchGestures))
 		{
-			XPutImage(xfc->display, xfc->primary, xfc->gc, surface->image,
-			          WINPR_ASSERTING_INT_CAST(int, nXSrc), WINPR_ASSERTING_INT_CAST(int, nYSrc),
-			          WINPR_ASSERTING_INT_CAST(int, nXDst), WINPR_ASSERTING_INT_CAST(int, nYDst),
-			          dwidth, dheight);
+			xf_shm_put_image(xfc, surface->shm, surface->image, xfc->primary, xfc->gc,
+			                 WINPR_ASSERTING_INT_CAST(int, nXSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nYSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nXDst),
+			                 WINPR_ASSERTING_INT_CAST(int, nYDst), dwidth, dheight);
 			xf_draw_screen(xfc, WINPR_ASSERTING_INT_CAST(int32_t, nXDst),
 			               WINPR_ASSERTING_INT_CAST(int32_t, nYDst),
 			               WINPR_ASSERTING_INT_CAST(int32_t, dwidth),
@@ -119,10 +122,11 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 		else
 #endif
 		{
-			XPutImage(xfc->display, xfc->drawable, xfc->gc, surface->image,
-			          WINPR_ASSERTING_INT_CAST(int, nXSrc), WINPR_ASSERTING_INT_CAST(int, nYSrc),
-			          WINPR_ASSERTING_INT_CAST(int, nXDst), WINPR_ASSERTING_INT_CAST(int, nYDst),
-			          dwidth, dheight);
+			xf_shm_put_image(xfc, surface->shm, surface->image, xfc->drawable, xfc->gc,
+			                 WINPR_ASSERTING_INT_CAST(int, nXSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nYSrc),
+			                 WINPR_ASSERTING_INT_CAST(int, nXDst),
+			                 WINPR_ASSERTING_INT_CAST(int, nYDst), dwidth, dheight);
 		}
 	}
 
@@ -130,7 +134,13 @@ static UINT xf_OutputUpdate(xfContext* xfc, xfGfxSurface* surface)
 fail:
 	region16_clear(&surface->gdi.invalidRegion);
 	XSetClipMask(xfc->display, xfc->gc, None);
-	XSync(xfc->display, False);
+
+	/* Decoders write to the surface without a paint notification, the X server must be done
+	 * with the shared pixels before this returns */
+	if (surface->shm)
+		xf_shm_wait(xfc);
+	else
+		XSync(xfc->display, False);
 	return rc;
 }
 
@@ -273,6 +283,39 @@ static UINT32 x11_pad_scanline(UINT32 scanline, UINT32 inPad)
 	return scanline;
 }
 
+/* Shares the pixels with the X server if the segment has the layout the surface needs */
+static xfShmImage* xf_gfx_shm_image_new(xfContext* xfc, const xfGfxSurface* surface,
+                                        UINT32 scanline)
+{
+	xfShmImage* shm = xf_shm_image_new(xfc, surface->gdi.width, surface->gdi.height);
+
+	if (shm && (WINPR_ASSERTING_INT_CAST(UINT32, shm->image->bytes_per_line) != scanline))
+	{
+		xf_shm_image_free(xfc, shm);
+		return NULL;
+	}
+	return shm;
+}
+
+static void xf_gfx_surface_free_buffers(xfContext* xfc, xfGfxSurface* surface)
+{
+	const BYTE* shared = NULL;
+
+	if (surface->shm)
+		shared = (const BYTE*)surface->shm->image->data;
+	else if (surface->image)
+	{
+		surface->image->data = NULL;
+		XDestroyImage(surface->image);
+	}
+
+	if (surface->gdi.data != shared)
+		winpr_aligned_free(surface->gdi.data);
+	if (surface->stage != shared)
+		winpr_aligned_free(surface->stage);
+	xf_shm_image_free(xfc, surface->shm);
+}
+
 /**
  * Function description
  *
@@ -326,18 +369,33 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 	surface->gdi.scanline = surface->gdi.width * FreeRDPGetBytesPerPixel(surface->gdi.format);
 	surface->gdi.scanline = x11_pad_scanline(surface->gdi.scanline,
 	                                         WINPR_ASSERTING_INT_CAST(uint32_t, xfc->scanline_pad));
-	size = 1ull * surface->gdi.scanline * surface->gdi.height;
-	surface->gdi.data = (BYTE*)winpr_aligned_malloc(size, 16);
 
-	if (!surface->gdi.data)
+	if (FreeRDPAreColorFormatsEqualNoAlpha(gdi->dstFormat, surface->gdi.format))
 	{
-		WLog_ERR(TAG, "unable to allocate GDI data");
-		goto out_free;
+		/* the X server reads the decoded surface directly */
+		surface->shm = xf_gfx_shm_image_new(xfc, surface, surface->gdi.scanline);
+		if (surface->shm)
+		{
+			surface->image = surface->shm->image;
+			surface->gdi.data = (BYTE*)surface->image->data;
+		}
 	}
 
-	ZeroMemory(surface->gdi.data, size);
+	if (!surface->gdi.data)
+	{
+		size = 1ull * surface->gdi.scanline * surface->gdi.height;
+		surface->gdi.data = (BYTE*)winpr_aligned_malloc(size, 16);
+
+		if (!surface->gdi.data)
+		{
+			WLog_ERR(TAG, "unable to allocate GDI data");
+			goto out_free;
+		}
 
-	if (FreeRDPAreColorFormatsEqualNoAlpha(gdi->dstFormat, surface->gdi.format))
+		ZeroMemory(surface->gdi.data, size);
+	}
+
+	if (!surface->image && FreeRDPAreColorFormatsEqualNoAlpha(gdi->dstFormat, surface->gdi.format))
 	{
 		WINPR_ASSERT(xfc->depth != 0);
 		surface->image = XCreateImage(
@@ -345,34 +403,45 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 		    (char*)surface->gdi.data, surface->gdi.mappedWidth, surface->gdi.mappedHeight,
 		    xfc->scanline_pad, WINPR_ASSERTING_INT_CAST(int, surface->gdi.scanline));
 	}
-	else
+	else if (!surface->image)
 	{
 		UINT32 width = surface->gdi.width;
 		UINT32 bytes = FreeRDPGetBytesPerPixel(gdi->dstFormat);
 		surface->stageScanline = width * bytes;
 		surface->stageScanline = x11_pad_scanline(
 		    surface->stageScanline, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->scanline_pad));
-		size = 1ull * surface->stageScanline * surface->gdi.height;
-		surface->stage = (BYTE*)winpr_aligned_malloc(size, 16);
 
-		if (!surface->stage)
+		surface->shm = xf_gfx_shm_image_new(xfc, surface, surface->stageScanline);
+		if (surface->shm)
 		{
-			WLog_ERR(TAG, "unable to allocate stage buffer");
-			goto out_free_gdidata;
+			surface->image = surface->shm->image;
+			surface->stage = (BYTE*)surface->image->data;
+		}
+		else
+		{
+			size = 1ull * surface->stageScanline * surface->gdi.height;
+			surface->stage = (BYTE*)winpr_aligned_malloc(size, 16);
+
+			if (!surface->stage)
+			{
+				WLog_ERR(TAG, "unable to allocate stage buffer");
+				goto out_free;
+			}
+
+			ZeroMemory(surface->stage, size);
+			WINPR_ASSERT(xfc->depth != 0);
+			surface->image = XCreateImage(
+			    xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth),
+			    ZPixmap, 0, (char*)surface->stage, surface->gdi.mappedWidth,
+			    surface->gdi.mappedHeight, xfc->scanline_pad,
+			    WINPR_ASSERTING_INT_CAST(int, surface->stageScanline));
 		}
-
-		ZeroMemory(surface->stage, size);
-		WINPR_ASSERT(xfc->depth != 0);
-		surface->image = XCreateImage(
-		    xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth), ZPixmap, 0,
-		    (char*)surface->stage, surface->gdi.mappedWidth, surface->gdi.mappedHeight,
-		    xfc->scanline_pad, WINPR_ASSERTING_INT_CAST(int, surface->stageScanline));
 	}
 
 	if (!surface->image)
 	{
 		WLog_ERR(TAG, "an error occurred when creating the XImage");
-		goto error_surface_image;
+		goto out_free;
 	}
 
 	surface->image->byte_order = LSBFirst;
@@ -383,18 +452,13 @@ static UINT xf_CreateSurface(RdpgfxClientContext* context,
 	if (context->SetSurfaceData(context, surface->gdi.surfaceId, (void*)surface) != CHANNEL_RC_OK)
 	{
 		WLog_ERR(TAG, "an error occurred during SetSurfaceData");
-		goto error_set_surface_data;
+		region16_uninit(&surface->gdi.invalidRegion);
+		goto out_free;
 	}
 
 	return CHANNEL_RC_OK;
-error_set_surface_data:
-	surface->image->data = NULL;
-	XDestroyImage(surface->image);
-error_surface_image:
-	winpr_aligned_free(surface->stage);
-out_free_gdidata:
-	winpr_aligned_free(surface->gdi.data);
 out_free:
+	xf_gfx_surface_free_buffers(xfc, surface);
 	free(surface);
 	return ret;
 }
@@ -410,6 +474,8 @@ static UINT xf_DeleteSurface(RdpgfxClientContext* context,
 	rdpCodecs* codecs = NULL;
 	xfGfxSurface* surface = NULL;
 	UINT status = 0;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
+	xfContext* xfc = (xfContext*)gdi->context;
 	EnterCriticalSection(&context->mux);
 	surface = (xfGfxSurface*)context->GetSurfaceData(context, deleteSurface->surfaceId);
 
@@ -421,10 +487,7 @@ static UINT xf_DeleteSurface(RdpgfxClientContext* context,
 #ifdef WITH_GFX_H264
 		h264_context_free(surface->gdi.h264);
 #endif
-		surface->image->data = NULL;
-		XDestroyImage(surface->image);
-		winpr_aligned_free(surface->gdi.data);
-		winpr_aligned_free(surface->stage);
+		xf_gfx_surface_free_buffers(xfc, surface);
 		region16_uninit(&surface->gdi.invalidRegion);
 		codecs = surface->gdi.codecs;
 		free(surface);
@@ -33,6 +33,7 @@ struct xf_gfx_surface
 	BYTE* stage;
 	UINT32 stageScanline;
 	XImage* image;
+	xfShmImage* shm;
 };
 typedef struct xf_gfx_surface xfGfxSurface;
 
@@ -0,0 +1,344 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 MIT-SHM image presentation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/cast.h>
+
+#include "xf_shm.h"
+
+#if defined(WITH_XSHM)
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
+#include <freerdp/log.h>
+#define TAG CLIENT_TAG("x11shm")
+
+struct s_xfShmContext
+{
+	xfContext* xfc;
+	int majorOpcode;
+	int eventBase;
+
+	/* Serial of the last XShmPutImage request and of the last one the server completed */
+	unsigned long putSerial;
+	unsigned long doneSerial;
+};
+
+#if defined(WITH_XSHM)
+
+static int xf_shm_trapped_opcode = 0;
+static BOOL xf_shm_trapped_error = FALSE;
+static int (*xf_shm_previous_handler)(Display*, XErrorEvent*) = NULL;
+
+/* XShmAttach fails asynchronously, e.g. if the server is not on this host */
+static int xf_shm_error_handler(Display* display, XErrorEvent* event)
+{
+	if (event->request_code == xf_shm_trapped_opcode)
+	{
+		xf_shm_trapped_error = TRUE;
+		return 0;
+	}
+
+	if (xf_shm_previous_handler)
+		return xf_shm_previous_handler(display, event);
+	return 0;
+}
+
+static BOOL xf_shm_attach(xfShmContext* shm, xfShmImage* image)
+{
+	Display* display = shm->xfc->display;
+
+	xf_shm_trapped_opcode = shm->majorOpcode;
+	xf_shm_trapped_error = FALSE;
+	xf_shm_previous_handler = XSetErrorHandler(xf_shm_error_handler);
+
+	if (XShmAttach(display, &image->info))
+		image->attached = TRUE;
+	XSync(display, False);
+
+	(void)XSetErrorHandler(xf_shm_previous_handler);
+	xf_shm_previous_handler = NULL;
+
+	if (xf_shm_trapped_error)
+		image->attached = FALSE;
+	return image->attached;
+}
+
+static BOOL xf_shm_pending(const xfShmContext* shm)
+{
+	/* serials wrap around */
+	return (long)(shm->putSerial - shm->doneSerial) > 0;
+}
+
+static void xf_shm_completed(xfShmContext* shm, const XEvent* event)
+{
+	const XShmCompletionEvent* completion = (const XShmCompletionEvent*)event;
+
+	if ((long)(completion->serial - shm->doneSerial) > 0)
+		shm->doneSerial = completion->serial;
+}
+
+static Bool xf_shm_is_completion(Display* display, XEvent* event, XPointer arg)
+{
+	const xfShmContext* shm = (const xfShmContext*)arg;
+
+	WINPR_UNUSED(display);
+	return event->type == shm->eventBase + ShmCompletion;
+}
+
+static xfShmImage* xf_shm_image_create(xfShmContext* shm, UINT32 width, UINT32 height)
+{
+	xfContext* xfc = shm->xfc;
+	xfShmImage* image = calloc(1, sizeof(xfShmImage));
+
+	if (!image)
+		return NULL;
+
+	image->info.shmid = -1;
+	image->info.shmaddr = (char*)-1;
+
+	WINPR_ASSERT(xfc->depth != 0);
+	xf_lock_x11(xfc);
+	image->image =
+	    XShmCreateImage(xfc->display, xfc->visual, WINPR_ASSERTING_INT_CAST(uint32_t, xfc->depth),
+	                    ZPixmap, NULL, &image->info, width, height);
+	if (!image->image)
+		goto fail;
+
+	image->image->byte_order = LSBFirst;
+	image->image->bitmap_bit_order = LSBFirst;
+
+	const size_t size = 1ull * WINPR_ASSERTING_INT_CAST(size_t, image->image->bytes_per_line) *
+	                    WINPR_ASSERTING_INT_CAST(size_t, image->image->height);
+	image->info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+	if (image->info.shmid < 0)
+		goto fail;
+
+	image->info.shmaddr = shmat(image->info.shmid, NULL, 0);
+	if (image->info.shmaddr == (char*)-1)
+		goto fail;
+
+	image->image->data = image->info.shmaddr;
+	image->info.readOnly = True;
+	if (!xf_shm_attach(shm, image))
+		goto fail;
+
+	/* both sides are attached, the segment goes away with the last detach */
+	(void)shmctl(image->info.shmid, IPC_RMID, NULL);
+	image->info.shmid = -1;
+	xf_unlock_x11(xfc);
+
+	memset(image->image->data, 0, size);
+	return image;
+
+fail:
+	xf_unlock_x11(xfc);
+	xf_shm_image_free(xfc, image);
+	return NULL;
+}
+
+xfShmContext* xf_shm_new(xfContext* xfc)
+{
+	int major = 0;
+	int minor = 0;
+	int firstEvent = 0;
+	int firstError = 0;
+	Bool pixmaps = False;
+	xfShmContext* shm = NULL;
+
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(xfc->display);
+
+	if (!XShmQueryExtension(xfc->display) ||
+	    !XShmQueryVersion(xfc->display, &major, &minor, &pixmaps))
+		goto fail;
+
+	shm = calloc(1, sizeof(xfShmContext));
+	if (!shm)
+		goto fail;
+
+	shm->xfc = xfc;
+	if (!XQueryExtension(xfc->display, "MIT-SHM", &shm->majorOpcode, &firstEvent, &firstError))
+		goto fail;
+	shm->eventBase = XShmGetEventBase(xfc->display);
+
+	/* XShmQueryExtension succeeds for remote servers too, attaching a segment does not */
+	xfShmImage* probe = xf_shm_image_create(shm, 1, 1);
+	if (!probe)
+		goto fail;
+	xf_shm_image_free(xfc, probe);
+
+	WLog_DBG(TAG, "using MIT-SHM %d.%d", major, minor);
+	return shm;
+
+fail:
+	WLog_INFO(TAG, "MIT-SHM not available, using XPutImage");
+	free(shm);
+	return NULL;
+}
+
+void xf_shm_free(xfShmContext* shm)
+{
+	free(shm);
+}
+
+xfShmImage* xf_shm_image_new(xfContext* xfc, UINT32 width, UINT32 height)
+{
+	WINPR_ASSERT(xfc);
+
+	if (!xfc->xfShm)
+		return NULL;
+	return xf_shm_image_create(xfc->xfShm, width, height);
+}
+
+void xf_shm_image_free(xfContext* xfc, xfShmImage* image)
+{
+	WINPR_ASSERT(xfc);
+
+	if (!image)
+		return;
+
+	xf_lock_x11(xfc);
+	if (image->attached)
+	{
+		xf_shm_wait(xfc);
+		XShmDetach(xfc->display, &image->info);
+	}
+
+	if (image->image)
+	{
+		image->image->data = NULL;
+		XDestroyImage(image->image);
+	}
+	xf_unlock_x11(xfc);
+
+	if (image->info.shmaddr != (char*)-1)
+		(void)shmdt(image->info.shmaddr);
+	if (image->info.shmid >= 0)
+		(void)shmctl(image->info.shmid, IPC_RMID, NULL);
+	free(image);
+}
+
+void xf_shm_put_image(xfContext* xfc, const xfShmImage* shm, XImage* image, Drawable d, GC gc,
+                      int src_x, int src_y, int dst_x, int dst_y, unsigned int width,
+                      unsigned int height)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(image);
+
+	if (!xfc->xfShm || !shm || (shm->image != image))
+	{
+		XPutImage(xfc->display, d, gc, image, src_x, src_y, dst_x, dst_y, width, height);
+		return;
+	}
+
+	xf_lock_x11(xfc);
+	xfc->xfShm->putSerial = NextRequest(xfc->display);
+	XShmPutImage(xfc->display, d, gc, image, src_x, src_y, dst_x, dst_y, width, height, True);
+	xf_unlock_x11(xfc);
+}
+
+void xf_shm_wait(xfContext* xfc)
+{
+	XEvent event = { 0 };
+
+	WINPR_ASSERT(xfc);
+
+	xfShmContext* shm = xfc->xfShm;
+	if (!shm)
+		return;
+
+	/* the serials are updated by whoever holds the display lock */
+	xf_lock_x11(xfc);
+	while (xf_shm_pending(shm) &&
+	       XCheckIfEvent(xfc->display, &event, xf_shm_is_completion, (XPointer)shm))
+		xf_shm_completed(shm, &event);
+
+	if (xf_shm_pending(shm))
+	{
+		/* requests are processed in order, after a round trip no segment is read anymore */
+		XSync(xfc->display, False);
+		shm->doneSerial = shm->putSerial;
+	}
+	xf_unlock_x11(xfc);
+}
+
+BOOL xf_shm_handle_xevent(xfContext* xfc, const XEvent* event)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_ASSERT(event);
+
+	xfShmContext* shm = xfc->xfShm;
+	if (!shm || (event->type != shm->eventBase + ShmCompletion))
+		return FALSE;
+
+	xf_shm_completed(shm, event);
+	return TRUE;
+}
+
+#else
+
+xfShmContext* xf_shm_new(xfContext* xfc)
+{
+	WINPR_UNUSED(xfc);
+	return NULL;
+}
+
+void xf_shm_free(xfShmContext* shm)
+{
+	free(shm);
+}
+
+xfShmImage* xf_shm_image_new(xfContext* xfc, UINT32 width, UINT32 height)
+{
+	WINPR_UNUSED(xfc);
+	WINPR_UNUSED(width);
+	WINPR_UNUSED(height);
+	return NULL;
+}
+
+void xf_shm_image_free(xfContext* xfc, xfShmImage* image)
+{
+	WINPR_UNUSED(xfc);
+	free(image);
+}
+
+void xf_shm_put_image(xfContext* xfc, const xfShmImage* shm, XImage* image, Drawable d, GC gc,
+                      int src_x, int src_y, int dst_x, int dst_y, unsigned int width,
+                      unsigned int height)
+{
+	WINPR_ASSERT(xfc);
+	WINPR_UNUSED(shm);
+	XPutImage(xfc->display, d, gc, image, src_x, src_y, dst_x, dst_y, width, height);
+}
+
+void xf_shm_wait(xfContext* xfc)
+{
+	WINPR_UNUSED(xfc);
+}
+
+BOOL xf_shm_handle_xevent(xfContext* xfc, const XEvent* event)
+{
+	WINPR_UNUSED(xfc);
+	WINPR_UNUSED(event);
+	return FALSE;
+}
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * X11 MIT-SHM image presentation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef FREERDP_CLIENT_X11_SHM_H
+#define FREERDP_CLIENT_X11_SHM_H
+
+#include <freerdp/config.h>
+#include <freerdp/types.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#if defined(WITH_XSHM)
+#include <X11/extensions/XShm.h>
+#endif
+
+#include "xf_client.h"
+#include "xfreerdp.h"
+
+/* An XImage whose pixels live in a shared memory segment attached by the X server */
+struct s_xfShmImage
+{
+	XImage* image;
+#if defined(WITH_XSHM)
+	XShmSegmentInfo info;
+	BOOL attached;
+#endif
+};
+
+void xf_shm_free(xfShmContext* shm);
+
+/* Returns NULL if the X server can not use shared memory (remote display, no MIT-SHM) */
+WINPR_ATTR_MALLOC(xf_shm_free, 1)
+xfShmContext* xf_shm_new(xfContext* xfc);
+
+void xf_shm_image_free(xfContext* xfc, xfShmImage* image);
+
+/* Returns NULL if shared memory is not available, callers fall back to XPutImage */
+WINPR_ATTR_MALLOC(xf_shm_image_free, 2)
+xfShmImage* xf_shm_image_new(xfContext* xfc, UINT32 width, UINT32 height);
+
+/* Copies a rectangle of image to d. The pixels are sent with XShmPutImage if image is the
+ * XImage of shm and with XPutImage otherwise */
+void xf_shm_put_image(xfContext* xfc, const xfShmImage* shm, XImage* image, Drawable d, GC gc,
+                      int src_x, int src_y, int dst_x, int dst_y, unsigned int width,
+                      unsigned int height);
+
+/* Blocks until the X server has read all segments passed to xf_shm_put_image.
+ * Call before writing to the pixels of a segment */
+void xf_shm_wait(xfContext* xfc);
+
+BOOL xf_shm_handle_xevent(xfContext* xfc, const XEvent* event);
+
+#endif /* FREERDP_CLIENT_X11_SHM_H */
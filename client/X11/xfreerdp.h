@@ -110,6 +110,8 @@ typedef struct xf_glyph xfGlyph;
 
 typedef struct xf_clipboard xfClipboard;
 typedef struct s_xfDispContext xfDispContext;
+typedef struct s_xfShmContext xfShmContext;
+typedef struct s_xfShmImage xfShmImage;
 typedef struct s_xfVideoContext xfVideoContext;
 typedef struct xf_rail_icon_cache xfRailIconCache;
 
@@ -285,6 +287,8 @@ struct xf_context
 	CliprdrClientContext* cliprdr;
 	xfVideoContext* xfVideo;
 	xfDispContext* xfDisp;
+	xfShmContext* xfShm;
+	xfShmImage* shmImage;
 
 	RailClientContext* rail;
 	wHashTable* railWindows;
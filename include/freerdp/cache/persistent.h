@@ -93,6 +93,68 @@ extern "C"
 	WINPR_ATTR_MALLOC(persistent_cache_free, 1)
 	FREERDP_API rdpPersistentCache* persistent_cache_new(void);
 
+	/** @brief A memory mapped store of cache entries keyed by their 64 bit cache key
+	 *
+	 *  Entries are kept across sessions up to a size limit, the least recently used ones are
+	 *  dropped first. Only changes committed with persistent_cache_store_commit (or when the
+	 *  store is freed) survive a crash, an interrupted commit never exposes partial data.
+	 *
+	 *  @since version 3.11.0
+	 */
+	typedef struct rdp_persistent_cache_store rdpPersistentCacheStore;
+
+	/** @since version 3.11.0 */
+	FREERDP_API void persistent_cache_store_free(rdpPersistentCacheStore* store);
+
+	/** @brief open or create the store \b filename with a total size of at most \b maxSize
+	 *
+	 *  A file that is damaged or was created with a different size is reset.
+	 *
+	 *  @since version 3.11.0
+	 */
+	WINPR_ATTR_MALLOC(persistent_cache_store_free, 1)
+	FREERDP_API rdpPersistentCacheStore* persistent_cache_store_new(const char* filename,
+	                                                                size_t maxSize);
+
+	/** @brief get up to \b count entries, the most recently used first
+	 *
+	 *  The data of the entries is not touched, it is paged in when read.
+	 *
+	 *  @return the number of entries returned
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API size_t persistent_cache_store_get_entries(rdpPersistentCacheStore* store,
+	                                                      PERSISTENT_CACHE_ENTRY* entries,
+	                                                      size_t count);
+
+	/** @brief look up \b key and mark the entry as used
+	 *
+	 *  \b entry->data points into the store and is valid until the store is modified.
+	 *
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API BOOL persistent_cache_store_get(rdpPersistentCacheStore* store, UINT64 key,
+	                                            PERSISTENT_CACHE_ENTRY* entry);
+
+	/** @brief mark the entry \b key as used, @return \b FALSE if it is not stored
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API BOOL persistent_cache_store_touch(rdpPersistentCacheStore* store, UINT64 key);
+
+	/** @brief add an entry, evicting the least recently used ones if the store is full
+	 *
+	 *  An entry with the same key is only marked as used, cache keys identify the content.
+	 *
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API BOOL persistent_cache_store_put(rdpPersistentCacheStore* store,
+	                                            const PERSISTENT_CACHE_ENTRY* entry);
+
+	/** @brief write all changes to disk
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API BOOL persistent_cache_store_commit(rdpPersistentCacheStore* store);
+
 #ifdef __cplusplus
 }
 #endif
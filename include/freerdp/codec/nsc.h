@@ -39,7 +39,8 @@ extern "C"
 		NSC_COLOR_LOSS_LEVEL,
 		NSC_ALLOW_SUBSAMPLING,
 		NSC_DYNAMIC_COLOR_FIDELITY,
-		NSC_COLOR_FORMAT
+		NSC_COLOR_FORMAT,
+		NSC_THREADING_FLAGS /** @since version 3.11.0 */
 	} NSC_PARAMETER;
 
 	typedef struct S_NSC_CONTEXT NSC_CONTEXT;
@@ -0,0 +1,69 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shared TLS contexts and session resumption
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_CRYPTO_TLS_CACHE_H
+#define FREERDP_CRYPTO_TLS_CACHE_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+#include <freerdp/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** @brief A TLS context shared by many connections.
+	 *
+	 * All connections using the same cache share one SSL_CTX, so certificates and keys are
+	 * loaded once. Accepted connections can resume sessions with session tickets or session
+	 * IDs, outgoing connections keep the last session of each host and offer it on the next
+	 * connect.
+	 *
+	 * The cache is reference counted and thread safe, every listener has one for the peers
+	 * it accepts.
+	 *
+	 * @since version 3.11.0
+	 */
+	typedef struct rdp_tls_session_cache rdpTlsSessionCache;
+
+	/** @brief Releases a reference to a cache
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API void freerdp_tls_session_cache_free(rdpTlsSessionCache* cache);
+
+	/** @brief Creates a cache for accepted (server) or outgoing (client) connections
+	 *  @since version 3.11.0
+	 */
+	WINPR_ATTR_MALLOC(freerdp_tls_session_cache_free, 1)
+	FREERDP_API rdpTlsSessionCache* freerdp_tls_session_cache_new(BOOL server);
+
+	/** @brief Use the cache for the TLS connections of a context.
+	 *
+	 * Must be called before connecting, the context keeps its own reference.
+	 * NULL detaches the current cache.
+	 *
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API BOOL freerdp_set_tls_session_cache(rdpContext* context, rdpTlsSessionCache* cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_CRYPTO_TLS_CACHE_H */
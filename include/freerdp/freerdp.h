@@ -656,6 +656,50 @@ owned by rdpRdp */
 
 	FREERDP_API ULONG freerdp_get_transport_sent(rdpContext* context, BOOL resetCount);
 
+	/** @brief Statistics of the outbound write queue of a transport
+	 *  @since version 3.11.0
+	 */
+	typedef struct
+	{
+		size_t limit;     /**< queue limit in bytes, \b 0 if the queue is disabled */
+		size_t depth;     /**< bytes queued and not yet handed to the socket */
+		size_t maxDepth;  /**< the highest depth seen */
+		UINT64 queued;    /**< number of PDUs queued */
+		UINT64 writes;    /**< number of (coalesced) writes to the socket */
+		UINT64 stalls;    /**< number of writes that waited for the queue to drain */
+		UINT64 stallTime; /**< total time spent waiting in nanoseconds */
+	} FreeRDP_WriteQueueStats;
+
+	/** @brief Enables a bounded queue for outbound PDUs of a non-blocking transport
+	 *
+	 *  With the queue enabled writes only wait for the socket while more than \b limit bytes
+	 *  are pending. Small PDUs are coalesced into larger socket writes. The queue is drained
+	 *  by writers and the event loop (freerdp_check_event_handles, the peer
+	 *  \b CheckFileDescriptor and \b DrainOutputBuffer callbacks).
+	 *
+	 *  @param context The RDP context
+	 *  @param limit The queue limit in bytes, \b 0 disables the queue
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API BOOL freerdp_set_write_queue_limit(rdpContext* context, size_t limit);
+
+	/** @brief Fills \b stats with the current statistics of the outbound write queue
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API BOOL freerdp_get_write_queue_stats(rdpContext* context,
+	                                               FreeRDP_WriteQueueStats* stats);
+
+	/** @brief Checks if the outbound write queue is over its limit
+	 *
+	 *  Producers that can drop or merge work (e.g. skip a frame) should do so instead of
+	 *  writing while the queue is full, a write would wait for the queue to drain.
+	 *
+	 *  @return \b TRUE if the queue is enabled and full
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API BOOL freerdp_is_write_queue_full(rdpContext* context);
+
 	FREERDP_API BOOL freerdp_nla_impersonate(rdpContext* context);
 	FREERDP_API BOOL freerdp_nla_revert_to_self(rdpContext* context);
 
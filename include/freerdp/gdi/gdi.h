@@ -480,16 +480,23 @@ extern "C"
 	};
 	typedef struct gdi_bitmap gdiBitmap;
 
+	/** @since version 3.11.0 */
+	typedef struct gdi_glyph_atlas gdiGlyphAtlas;
+
 	struct gdi_glyph
 	{
 		rdpBitmap _p;
 
 		HGDI_DC hdc;
-		HGDI_BITMAP bitmap;
+		HGDI_BITMAP bitmap; /* one mask byte per pixel, stored in the atlas */
 		HGDI_BITMAP org_bitmap;
+		gdiGlyphAtlas* atlas; /** @since version 3.11.0 */
 	};
 	typedef struct gdi_glyph gdiGlyph;
 
+	/** @since version 3.11.0 */
+	typedef struct gdi_gfx_cache_pool gdiGfxCachePool;
+
 	struct rdp_gdi
 	{
 		rdpContext* context;
@@ -521,6 +528,8 @@ extern "C"
 		GeometryClientContext* geometry;
 
 		wLog* log;
+		gdiGfxCachePool* gfxCachePool; /** @since version 3.11.0 */
+		gdiGlyphAtlas* glyphAtlas;     /** @since version 3.11.0 */
 	};
 	typedef struct rdp_gdi rdpGdi;
 
@@ -37,9 +37,111 @@ extern "C"
 	};
 	typedef struct rdp_metrics rdpMetrics;
 
+	/** @brief Processing stages with a latency histogram in rdpMetrics
+	 *
+	 *  Stages nest, the time of a PDU is included in FREERDP_METRICS_PDU_PROCESS and again in
+	 *  the stages it passes through.
+	 *
+	 *  @since version 3.11.0
+	 */
+	typedef enum
+	{
+		FREERDP_METRICS_TRANSPORT_READ,  /**< reading a complete PDU from the transport */
+		FREERDP_METRICS_PDU_PROCESS,     /**< processing a received PDU */
+		FREERDP_METRICS_BULK_DECOMPRESS, /**< bulk decompression of a PDU */
+		FREERDP_METRICS_FASTPATH_UPDATE, /**< parsing and dispatching a fastpath update */
+		FREERDP_METRICS_ORDERS,          /**< parsing and drawing an orders update */
+		FREERDP_METRICS_DECODE_INTERLEAVED,
+		FREERDP_METRICS_DECODE_PLANAR,
+		FREERDP_METRICS_DECODE_REMOTEFX,
+		FREERDP_METRICS_DECODE_NSCODEC,
+		FREERDP_METRICS_DECODE_CLEARCODEC,
+		FREERDP_METRICS_DECODE_PROGRESSIVE,
+		FREERDP_METRICS_DECODE_AVC,
+		FREERDP_METRICS_DECODE_UNCOMPRESSED, /**< uncompressed and alpha codec surface commands */
+		FREERDP_METRICS_GDI_OUTPUT, /**< composing GFX surfaces into the primary surface */
+		FREERDP_METRICS_END_PAINT,  /**< the EndPaint callback presenting an update */
+		FREERDP_METRICS_STAGE_COUNT
+	} FreeRDP_MetricsStage;
+
+	/** @brief A snapshot of the latency histogram of a stage, all times in nanoseconds.
+	 *
+	 *  Percentiles are the upper bound of the histogram bucket they fall in, which is at most
+	 *  1/8th above the exact value.
+	 *
+	 *  @since version 3.11.0
+	 */
+	typedef struct
+	{
+		UINT64 count;
+		UINT64 total;
+		UINT64 max;
+		UINT64 p50;
+		UINT64 p90;
+		UINT64 p99;
+	} FreeRDP_MetricsSummary;
+
 	FREERDP_API double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes,
 	                                       UINT32 CompressedBytes);
 
+	/** @brief Returns a printable name of a metrics stage
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API const char* metrics_stage_name(FreeRDP_MetricsStage stage);
+
+	/** @brief Returns the start time of a measurement for metrics_stage_end
+	 *
+	 *  @param metrics The metrics to record to, may be \b NULL
+	 *  @return A timestamp or \b 0 if \b metrics is \b NULL
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API UINT64 metrics_stage_begin(const rdpMetrics* metrics);
+
+	/** @brief Records the time since \b begin in the histogram of \b stage
+	 *
+	 *  Recording is lock free and may be done from any thread.
+	 *
+	 *  @param metrics The metrics to record to, may be \b NULL
+	 *  @param stage The stage measured
+	 *  @param begin The value returned by metrics_stage_begin, \b 0 is ignored
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API void metrics_stage_end(rdpMetrics* metrics, FreeRDP_MetricsStage stage,
+	                                   UINT64 begin);
+
+	/** @brief Records a duration in the histogram of \b stage
+	 *
+	 *  @param metrics The metrics to record to
+	 *  @param stage The stage measured
+	 *  @param ns The duration in nanoseconds
+	 *  @return \b TRUE for success, \b FALSE for invalid arguments
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API BOOL metrics_record(rdpMetrics* metrics, FreeRDP_MetricsStage stage, UINT64 ns);
+
+	/** @brief Fills \b summary with a snapshot of the histogram of \b stage
+	 *
+	 *  @return \b TRUE for success, \b FALSE for invalid arguments
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API BOOL metrics_get_summary(const rdpMetrics* metrics, FreeRDP_MetricsStage stage,
+	                                     FreeRDP_MetricsSummary* summary);
+
+	/** @brief Clears the histograms of all stages
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API void metrics_reset(rdpMetrics* metrics);
+
+	/** @brief Returns the histogram summaries and compression totals as a JSON object
+	 *
+	 *  @param metrics The metrics to dump
+	 *  @param plength Optional, receives the length of the string
+	 *  @return A string to be freed with free() or \b NULL on failure
+	 *  @since version 3.11.0
+	 */
+	WINPR_ATTR_MALLOC(free, 1)
+	FREERDP_API char* metrics_to_json(const rdpMetrics* metrics, size_t* plength);
+
 	FREERDP_API void metrics_free(rdpMetrics* metrics);
 
 	WINPR_ATTR_MALLOC(metrics_free, 1)
@@ -27,6 +27,7 @@
 #include <freerdp/update.h>
 #include <freerdp/autodetect.h>
 #include <freerdp/redirection.h>
+#include <freerdp/crypto/tls_cache.h>
 
 #include <winpr/sspi.h>
 #include <winpr/ntlm.h>
@@ -193,6 +194,13 @@ extern "C"
 		 * and supplementary creds (NTLM).
 		 */
 		ALIGN64 psPeerRemoteCredentials RemoteCredentials;
+		/**
+		 * @brief TlsSessionCache shared TLS context of the peer, set by the listener that
+		 * accepted it. The peer owns a reference that is released by \b freerdp_peer_free.
+		 *
+		 * @since version 3.11.0
+		 */
+		ALIGN64 rdpTlsSessionCache* TlsSessionCache;
 	};
 
 	FREERDP_API void freerdp_peer_context_free(freerdp_peer* client);
@@ -203,6 +203,23 @@ typedef pstatus_t (*__andC_32u_t)(const UINT32* WINPR_RESTRICT pSrc, UINT32 val,
 	                              UINT32* WINPR_RESTRICT pDst, INT32 len);
 typedef pstatus_t (*__orC_32u_t)(const UINT32* WINPR_RESTRICT pSrc, UINT32 val,
 	                             UINT32* WINPR_RESTRICT pDst, INT32 len);
+typedef pstatus_t (*__compare_tiles_t)(const BYTE* WINPR_RESTRICT pSrc1, UINT32 src1Step,
+                                       const BYTE* WINPR_RESTRICT pSrc2, UINT32 src2Step,
+                                       UINT32 width, UINT32 height, UINT32 bpp, UINT32 tileSize,
+                                       BYTE* WINPR_RESTRICT pMask, UINT32 maskStep);
+typedef pstatus_t (*__planar_split_t)(const BYTE* WINPR_RESTRICT pSrc, UINT32 SrcFormat,
+                                      INT32 srcStep, BYTE* WINPR_RESTRICT pDst[4],
+                                      UINT32 dstStep, UINT32 width, UINT32 height);
+typedef pstatus_t (*__planar_merge_t)(const BYTE* WINPR_RESTRICT pSrc[4], UINT32 srcStep,
+                                      BYTE* WINPR_RESTRICT pDst, UINT32 DstFormat, INT32 dstStep,
+                                      UINT32 width, UINT32 height);
+typedef pstatus_t (*__planar_delta_encode_t)(const BYTE* WINPR_RESTRICT pSrc,
+                                             const BYTE* WINPR_RESTRICT pPrev,
+                                             BYTE* WINPR_RESTRICT pDst, UINT32 len);
+typedef pstatus_t (*__planar_delta_decode_t)(const BYTE* WINPR_RESTRICT pPrev,
+                                             BYTE* WINPR_RESTRICT pSrcDst, UINT32 len);
+typedef void (*__planar_rle_scan_t)(const BYTE* WINPR_RESTRICT pSrc, UINT32 len, BYTE symbol,
+                                    UINT32* WINPR_RESTRICT pRaw, UINT32* WINPR_RESTRICT pRun);
 typedef pstatus_t (*primitives_uninit_t)(void);
 
 typedef struct
@@ -256,6 +273,41 @@ typedef struct
 	__add_16s_inplace_t add_16s_inplace;         /** @since version 3.6.0 */
 	__lShiftC_16s_inplace_t lShiftC_16s_inplace; /** @since version 3.6.0 */
 	__copy_no_overlap_t copy_no_overlap;         /** @since version 3.6.0 */
+
+	/** \brief Compare two images of \b width x \b height pixels of \b bpp bytes tile by tile.
+	 *
+	 *  Tiles are \b tileSize x \b tileSize pixels, clipped at the right and bottom border.
+	 *  Bit (x % 8) of pMask[y * maskStep + x / 8] is set if tile (x, y) differs and cleared
+	 *  otherwise.
+	 */
+	__compare_tiles_t compare_tiles; /** @since version 3.11.0 */
+
+	/** \brief Split \b width x \b height pixels of \b SrcFormat into the alpha, red, green and
+	 *  blue planes pDst[0] to pDst[3], in the order of the planar codec.
+	 *
+	 *  \b srcStep may be negative to read a bottom-up image. Formats without alpha give 0xFF.
+	 */
+	__planar_split_t planar_split; /** @since version 3.11.0 */
+
+	/** \brief Inverse of planar_split, pSrc[0] (alpha) may be \b NULL for opaque pixels. */
+	__planar_merge_t planar_merge; /** @since version 3.11.0 */
+
+	/** \brief Delta code a scanline against the previous one as used by the planar codec:
+	 *  the difference pSrc - pPrev as a signed byte d is written as 2d for d >= 0 and as
+	 *  -2d - 1 otherwise.
+	 */
+	__planar_delta_encode_t planar_delta_encode; /** @since version 3.11.0 */
+
+	/** \brief Inverse of planar_delta_encode, pSrcDst is replaced by the decoded scanline. */
+	__planar_delta_decode_t planar_delta_decode; /** @since version 3.11.0 */
+
+	/** \brief Find the next planar RLE segment of a scanline.
+	 *
+	 *  A run is a sequence of at least three bytes equal to their predecessor, the predecessor
+	 *  of pSrc[0] is \b symbol. pRaw receives the number of bytes before the first run and
+	 *  pRun its length, or \b len and 0 if there is none.
+	 */
+	__planar_rle_scan_t planar_rle_scan; /** @since version 3.11.0 */
 } primitives_t;
 
 typedef enum
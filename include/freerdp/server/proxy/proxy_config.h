@@ -117,6 +117,10 @@ extern "C"
 
 		/* target continued */
 		UINT32 TargetTlsSecLevel; /** @since version 3.2.0 */
+
+		/* server continued */
+		UINT32 IOThreads;              /** @since version 3.11.0, 0 for a thread per peer */
+		UINT32 XCrushCompressionLevel; /** @since version 3.11.0 */
 	};
 
 	/**
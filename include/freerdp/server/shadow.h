@@ -59,6 +59,7 @@ extern "C"
 	typedef struct rdp_shadow_capture rdpShadowCapture;
 	typedef struct rdp_shadow_subsystem rdpShadowSubsystem;
 	typedef struct rdp_shadow_multiclient_event rdpShadowMultiClientEvent;
+	typedef struct rdp_shadow_shared_encoder rdpShadowSharedEncoder;
 
 	typedef struct S_RDP_SHADOW_ENTRY_POINTS RDP_SHADOW_ENTRY_POINTS;
 	typedef int (*pfnShadowSubsystemEntry)(RDP_SHADOW_ENTRY_POINTS* pEntryPoints);
@@ -174,6 +175,7 @@ extern "C"
 		freerdp_listener* listener;
 
 		size_t maxClientsConnected;
+		rdpShadowSharedEncoder* sharedEncoder; /** @since version 3.11.0 */
 	};
 
 	struct rdp_shadow_surface
@@ -375,6 +377,31 @@ extern "C"
 	                                                   UINT32 format2, UINT32 nStep2,
 	                                                   RECTANGLE_16* WINPR_RESTRICT rect);
 
+	/** @brief Compare two framebuffer images of possibly different formats tile by tile
+	 *
+	 *  Every changed 16x16 tile is added to \b region, adjacent changed tiles of a tile row
+	 *  are merged to a single rectangle. The region is not cleared before.
+	 *
+	 *  @param pData1  A pointer to the data of image 1
+	 *  @param format1 The format of image 1
+	 *  @param nStep1  The line width in bytes of image 1
+	 *  @param nWidth  The line width in pixels of image 1
+	 *  @param nHeight The height of image 1
+	 *  @param pData2  A pointer to the data of image 2
+	 *  @param format2 The format of image 2
+	 *  @param nStep2  The line width in bytes of image 2
+	 *  @param region A pointer to the region receiving the changed tiles
+	 *
+	 *  @return \b 0 if equal, \b >0 if not equal and \b <0 for any error
+	 *
+	 *  @since version 3.11.0
+	 */
+	FREERDP_API int shadow_capture_compare_region(const BYTE* WINPR_RESTRICT pData1,
+	                                              UINT32 format1, UINT32 nStep1, UINT32 nWidth,
+	                                              UINT32 nHeight, const BYTE* WINPR_RESTRICT pData2,
+	                                              UINT32 format2, UINT32 nStep2,
+	                                              REGION16* WINPR_RESTRICT region);
+
 	FREERDP_API void shadow_subsystem_frame_update(rdpShadowSubsystem* subsystem);
 
 	FREERDP_API BOOL shadow_client_post_msg(rdpShadowClient* client, void* context, UINT32 type,
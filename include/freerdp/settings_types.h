@@ -325,6 +325,11 @@ extern "C"
 #define PACKET_COMPR_TYPE_RDP61 0x03
 #define PACKET_COMPR_TYPE_RDP8 0x04
 
+/* XCrush (RDP 6.1 bulk compression) effort levels */
+#define XCRUSH_LEVEL_FAST 0    /* shortest chunk chains, no inner MPPC pass */
+#define XCRUSH_LEVEL_DEFAULT 1 /* balanced, the output of the original encoder */
+#define XCRUSH_LEVEL_BEST 2    /* longest chunk chains */
+
 /* Desktop Rotation Flags */
 #define ORIENTATION_LANDSCAPE 0
 #define ORIENTATION_PORTRAIT 90
@@ -186,25 +186,28 @@ struct rdp_settings
 	UINT64 padding0704[704 - 642];                            /* 642 */
 
 	/* Client Info Flags */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL AutoLogonEnabled);       /* 704 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL CompressionEnabled);     /* 705 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL DisableCtrlAltDel);      /* 706 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL EnableWindowsKey);       /* 707 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL MaximizeShell);          /* 708 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL LogonNotify);            /* 709 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL LogonErrors);            /* 710 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL MouseAttached);          /* 711 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL MouseHasWheel);          /* 712 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL RemoteConsoleAudio);     /* 713 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL AudioPlayback);          /* 714 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL AudioCapture);           /* 715 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL VideoDisable);           /* 716 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL PasswordIsSmartcardPin); /* 717 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL UsingSavedCredentials);  /* 718 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL ForceEncryptedCsPdu);    /* 719 */
-	SETTINGS_DEPRECATED(ALIGN64 BOOL HiDefRemoteApp);         /* 720 */
-	SETTINGS_DEPRECATED(ALIGN64 UINT32 CompressionLevel);     /* 721 */
-	UINT64 padding0768[768 - 722];                            /* 722 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL AutoLogonEnabled);         /* 704 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL CompressionEnabled);       /* 705 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL DisableCtrlAltDel);        /* 706 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL EnableWindowsKey);         /* 707 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL MaximizeShell);            /* 708 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL LogonNotify);              /* 709 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL LogonErrors);              /* 710 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL MouseAttached);            /* 711 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL MouseHasWheel);            /* 712 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL RemoteConsoleAudio);       /* 713 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL AudioPlayback);            /* 714 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL AudioCapture);             /* 715 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL VideoDisable);             /* 716 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL PasswordIsSmartcardPin);   /* 717 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL UsingSavedCredentials);    /* 718 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL ForceEncryptedCsPdu);      /* 719 */
+	SETTINGS_DEPRECATED(ALIGN64 BOOL HiDefRemoteApp);           /* 720 */
+	SETTINGS_DEPRECATED(ALIGN64 UINT32 CompressionLevel);       /* 721 */
+	SETTINGS_DEPRECATED(ALIGN64 UINT32 XCrushCompressionLevel); /** 722
+		                                                       * @since version 3.11.0
+		                                                       */
+	UINT64 padding0768[768 - 723];                              /* 723 */
 
 	/* Client Info (Extra) */
 	SETTINGS_DEPRECATED(ALIGN64 BOOL IPv6Enabled);       /* 768 */
@@ -0,0 +1,771 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Persistent Cache Store
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <stddef.h>
+
+#include <winpr/crt.h>
+#include <winpr/assert.h>
+#include <winpr/collections.h>
+
+#include <freerdp/log.h>
+#include <freerdp/cache/persistent.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define TAG FREERDP_TAG("cache.persistent")
+
+/**
+ * File layout
+ *
+ * | header (one page) | index of STORE_RECORDS records | data |
+ *
+ * The file is mapped as a whole. Every record describes one entry in the data area and carries
+ * a checksum and the generation it was written in. A record is only valid if its generation
+ * is not newer than the last committed generation in the header. A commit first syncs the
+ * whole mapping and only then increments the committed generation in the header, so after a
+ * crash records written since the last commit are discarded.
+ *
+ * Data of a committed entry might still be referenced by the on-disk index after a crash, so
+ * space freed by evicting a committed entry is only reused after the next commit.
+ */
+
+#define STORE_VERSION 1
+#define STORE_PAGE_SIZE 4096ull
+#define STORE_RECORDS 5462 /* RDPGFX_CACHE_ENTRY_MAX_COUNT */
+/* every record has one extent, and one more of its previous entry until the next commit */
+#define STORE_EXTENTS (2 * STORE_RECORDS)
+#define STORE_DATA_ALIGNMENT 256ull
+#define STORE_RECORD_VALID 0x564C4944 /* VLID */
+
+static const BYTE store_magic[8] = { 'F', 'R', 'D', 'P', 'S', 'T', 'O', 'R' };
+
+typedef struct
+{
+	BYTE magic[8];
+	UINT32 version;
+	UINT32 records;
+	UINT64 dataOffset;
+	UINT64 dataSize;
+	UINT64 committed;
+	UINT64 clock;
+	UINT32 reserved;
+	UINT32 crc;
+} STORE_HEADER;
+
+/* 64 bytes, a record never crosses a page */
+typedef struct
+{
+	UINT64 key;
+	UINT64 lastUse;
+	UINT64 offset;
+	UINT64 generation;
+	UINT32 size;
+	UINT16 width;
+	UINT16 height;
+	UINT32 state;
+	UINT32 reserved[4];
+	UINT32 crc;
+} STORE_RECORD;
+
+typedef struct
+{
+	UINT64 offset;
+	UINT64 size;
+	UINT32 record;
+	BOOL pending; /* freed since the last commit */
+} STORE_EXTENT;
+
+struct rdp_persistent_cache_store
+{
+#if defined(_WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+	BYTE* map;
+	size_t mapSize;
+
+	STORE_HEADER* header;
+	STORE_RECORD* records;
+	BYTE* data;
+
+	UINT64 clock;
+	BOOL dirty;
+	wHashTable* keys; /* key -> record index + 1 */
+
+	STORE_EXTENT* extents; /* sorted by offset */
+	size_t extentCount;
+	UINT64 pendingBytes;
+};
+
+static UINT32 store_crc(const void* data, size_t length)
+{
+	const BYTE* bytes = (const BYTE*)data;
+	UINT32 crc = 0xFFFFFFFF;
+
+	for (size_t x = 0; x < length; x++)
+	{
+		crc ^= bytes[x];
+		for (int j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (0xEDB88320 & (~(crc & 1) + 1));
+	}
+	return ~crc;
+}
+
+static UINT32 store_key_hash(const void* key)
+{
+	const UINT64* v = (const UINT64*)key;
+	return (UINT32)(*v ^ (*v >> 32));
+}
+
+static BOOL store_key_equals(const void* a, const void* b)
+{
+	const UINT64* ka = (const UINT64*)a;
+	const UINT64* kb = (const UINT64*)b;
+	return *ka == *kb;
+}
+
+static void store_header_seal(STORE_HEADER* header)
+{
+	header->crc = store_crc(header, offsetof(STORE_HEADER, crc));
+}
+
+static void store_record_seal(STORE_RECORD* record)
+{
+	record->crc = store_crc(record, offsetof(STORE_RECORD, crc));
+}
+
+static BOOL store_record_valid(const rdpPersistentCacheStore* store, const STORE_RECORD* record)
+{
+	if (record->state != STORE_RECORD_VALID)
+		return FALSE;
+	if (record->crc != store_crc(record, offsetof(STORE_RECORD, crc)))
+		return FALSE;
+	if (record->generation > store->header->committed)
+		return FALSE;
+	if ((record->size == 0) || ((record->offset % STORE_DATA_ALIGNMENT) != 0))
+		return FALSE;
+	if ((record->offset > store->header->dataSize) ||
+	    (record->size > store->header->dataSize - record->offset))
+		return FALSE;
+	return TRUE;
+}
+
+static UINT64 store_aligned_size(UINT64 size)
+{
+	return (size + STORE_DATA_ALIGNMENT - 1) & ~(STORE_DATA_ALIGNMENT - 1);
+}
+
+static BOOL store_sync(rdpPersistentCacheStore* store, size_t length)
+{
+#if defined(_WIN32)
+	if (!FlushViewOfFile(store->map, length))
+		return FALSE;
+	return FlushFileBuffers(store->file);
+#else
+	return msync(store->map, length, MS_SYNC) == 0;
+#endif
+}
+
+static BOOL store_map(rdpPersistentCacheStore* store, const char* filename, BOOL* resized)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER size = { 0 };
+	LARGE_INTEGER mapSize = { 0 };
+
+	mapSize.QuadPart = (LONGLONG)store->mapSize;
+	store->file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS,
+	                          FILE_ATTRIBUTE_NORMAL, NULL);
+	if (store->file == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	if (!GetFileSizeEx(store->file, &size))
+		return FALSE;
+
+	if (size.QuadPart != mapSize.QuadPart)
+	{
+		if (!SetFilePointerEx(store->file, mapSize, NULL, FILE_BEGIN) ||
+		    !SetEndOfFile(store->file))
+			return FALSE;
+		*resized = TRUE;
+	}
+
+	store->mapping = CreateFileMappingA(store->file, NULL, PAGE_READWRITE,
+	                                    (DWORD)(mapSize.QuadPart >> 32),
+	                                    (DWORD)(mapSize.QuadPart & 0xFFFFFFFF), NULL);
+	if (!store->mapping)
+		return FALSE;
+
+	store->map = MapViewOfFile(store->mapping, FILE_MAP_ALL_ACCESS, 0, 0, store->mapSize);
+	return store->map != NULL;
+#else
+	struct stat st = { 0 };
+
+	store->fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (store->fd < 0)
+		return FALSE;
+
+	if (fstat(store->fd, &st) != 0)
+		return FALSE;
+
+	if ((st.st_size < 0) || ((size_t)st.st_size != store->mapSize))
+	{
+		if (ftruncate(store->fd, (off_t)store->mapSize) != 0)
+			return FALSE;
+		*resized = TRUE;
+	}
+
+	void* map = mmap(NULL, store->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+	if (map == MAP_FAILED)
+		return FALSE;
+
+	store->map = map;
+	return TRUE;
+#endif
+}
+
+static void store_unmap(rdpPersistentCacheStore* store)
+{
+#if defined(_WIN32)
+	if (store->map)
+		UnmapViewOfFile(store->map);
+	if (store->mapping)
+		(void)CloseHandle(store->mapping);
+	if (store->file != INVALID_HANDLE_VALUE)
+		(void)CloseHandle(store->file);
+#else
+	if (store->map)
+		munmap(store->map, store->mapSize);
+	if (store->fd >= 0)
+		close(store->fd);
+#endif
+	store->map = NULL;
+}
+
+static BOOL store_reset(rdpPersistentCacheStore* store, UINT64 dataOffset, UINT64 dataSize)
+{
+	STORE_HEADER* header = store->header;
+
+	WLog_DBG(TAG, "initializing persistent cache store");
+	memset(store->map, 0, dataOffset);
+	memcpy(header->magic, store_magic, sizeof(header->magic));
+	header->version = STORE_VERSION;
+	header->records = STORE_RECORDS;
+	header->dataOffset = dataOffset;
+	header->dataSize = dataSize;
+	header->committed = 0;
+	header->clock = 0;
+	store_header_seal(header);
+	return store_sync(store, store->mapSize);
+}
+
+static BOOL store_header_valid(const rdpPersistentCacheStore* store, UINT64 dataOffset,
+                               UINT64 dataSize)
+{
+	const STORE_HEADER* header = store->header;
+
+	if (memcmp(header->magic, store_magic, sizeof(header->magic)) != 0)
+		return FALSE;
+	if ((header->version != STORE_VERSION) || (header->records != STORE_RECORDS))
+		return FALSE;
+	if ((header->dataOffset != dataOffset) || (header->dataSize != dataSize))
+		return FALSE;
+	return header->crc == store_crc(header, offsetof(STORE_HEADER, crc));
+}
+
+static int store_extent_compare(const void* pa, const void* pb)
+{
+	const STORE_EXTENT* a = (const STORE_EXTENT*)pa;
+	const STORE_EXTENT* b = (const STORE_EXTENT*)pb;
+
+	if (a->offset < b->offset)
+		return -1;
+	if (a->offset > b->offset)
+		return 1;
+	return 0;
+}
+
+static BOOL store_extent_insert(rdpPersistentCacheStore* store, UINT64 offset, UINT64 size,
+                                UINT32 record)
+{
+	size_t pos = 0;
+
+	if (store->extentCount >= STORE_EXTENTS)
+		return FALSE;
+
+	while ((pos < store->extentCount) && (store->extents[pos].offset < offset))
+		pos++;
+
+	memmove(&store->extents[pos + 1], &store->extents[pos],
+	        (store->extentCount - pos) * sizeof(STORE_EXTENT));
+	store->extents[pos].offset = offset;
+	store->extents[pos].size = size;
+	store->extents[pos].record = record;
+	store->extents[pos].pending = FALSE;
+	store->extentCount++;
+	return TRUE;
+}
+
+static void store_extent_remove(rdpPersistentCacheStore* store, size_t pos)
+{
+	WINPR_ASSERT(pos < store->extentCount);
+
+	memmove(&store->extents[pos], &store->extents[pos + 1],
+	        (store->extentCount - pos - 1) * sizeof(STORE_EXTENT));
+	store->extentCount--;
+}
+
+static BOOL store_find_gap(const rdpPersistentCacheStore* store, UINT64 size, UINT64* offset)
+{
+	UINT64 end = 0;
+
+	for (size_t x = 0; x < store->extentCount; x++)
+	{
+		const STORE_EXTENT* extent = &store->extents[x];
+		if (extent->offset - end >= size)
+		{
+			*offset = end;
+			return TRUE;
+		}
+		end = extent->offset + extent->size;
+	}
+
+	if (store->header->dataSize - end >= size)
+	{
+		*offset = end;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static BOOL store_load(rdpPersistentCacheStore* store)
+{
+	size_t count = 0;
+
+	store->clock = store->header->clock;
+	for (UINT32 x = 0; x < STORE_RECORDS; x++)
+	{
+		STORE_RECORD* record = &store->records[x];
+
+		if (!store_record_valid(store, record))
+		{
+			/* never committed or damaged, make sure a later commit does not revive it */
+			if (record->state != 0)
+				memset(record, 0, sizeof(STORE_RECORD));
+			continue;
+		}
+
+		STORE_EXTENT* extent = &store->extents[count++];
+		extent->offset = record->offset;
+		extent->size = store_aligned_size(record->size);
+		extent->record = x;
+		extent->pending = FALSE;
+	}
+
+	qsort(store->extents, count, sizeof(STORE_EXTENT), store_extent_compare);
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const STORE_EXTENT* extent = &store->extents[x];
+		STORE_RECORD* record = &store->records[extent->record];
+
+		/* Overlapping entries can only be the result of a damaged file, drop them */
+		if ((store->extentCount > 0) &&
+		    (store->extents[store->extentCount - 1].offset +
+		         store->extents[store->extentCount - 1].size >
+		     extent->offset))
+		{
+			memset(record, 0, sizeof(STORE_RECORD));
+			continue;
+		}
+
+		if (!HashTable_Insert(store->keys, &record->key, (void*)(UINT_PTR)(extent->record + 1)))
+			return FALSE;
+
+		if (record->lastUse > store->clock)
+			store->clock = record->lastUse;
+		store->extents[store->extentCount++] = *extent;
+	}
+
+	return TRUE;
+}
+
+static size_t store_lookup(rdpPersistentCacheStore* store, UINT64 key)
+{
+	return (size_t)(UINT_PTR)HashTable_GetItemValue(store->keys, &key);
+}
+
+static void store_record_free(rdpPersistentCacheStore* store, UINT32 index)
+{
+	STORE_RECORD* record = &store->records[index];
+	const BOOL committed = record->generation <= store->header->committed;
+
+	if (record->state != STORE_RECORD_VALID)
+		return;
+
+	if (store_lookup(store, record->key) == index + 1ull)
+		HashTable_Remove(store->keys, &record->key);
+
+	for (size_t x = 0; x < store->extentCount; x++)
+	{
+		STORE_EXTENT* extent = &store->extents[x];
+		/* a pending extent belongs to an earlier entry of this record */
+		if (extent->pending || (extent->record != index))
+			continue;
+
+		if (committed)
+		{
+			extent->pending = TRUE;
+			store->pendingBytes += extent->size;
+		}
+		else
+			store_extent_remove(store, x);
+		break;
+	}
+
+	memset(record, 0, sizeof(STORE_RECORD));
+	store->dirty = TRUE;
+}
+
+static BOOL store_evict_lru(rdpPersistentCacheStore* store, UINT32 skip)
+{
+	UINT32 lru = STORE_RECORDS;
+
+	for (UINT32 x = 0; x < STORE_RECORDS; x++)
+	{
+		const STORE_RECORD* record = &store->records[x];
+		if ((x == skip) || (record->state != STORE_RECORD_VALID))
+			continue;
+		if ((lru == STORE_RECORDS) || (record->lastUse < store->records[lru].lastUse))
+			lru = x;
+	}
+
+	if (lru == STORE_RECORDS)
+		return FALSE;
+
+	store_record_free(store, lru);
+	return TRUE;
+}
+
+static void store_touch(rdpPersistentCacheStore* store, STORE_RECORD* record)
+{
+	record->lastUse = ++store->clock;
+	store_record_seal(record);
+	store->dirty = TRUE;
+}
+
+rdpPersistentCacheStore* persistent_cache_store_new(const char* filename, size_t maxSize)
+{
+	BOOL resized = FALSE;
+	const UINT64 indexSize =
+	    (STORE_RECORDS * sizeof(STORE_RECORD) + STORE_PAGE_SIZE - 1) & ~(STORE_PAGE_SIZE - 1);
+	const UINT64 dataOffset = STORE_PAGE_SIZE + indexSize;
+
+	WINPR_ASSERT(filename);
+	WINPR_ASSERT(sizeof(STORE_RECORD) == 64);
+
+	if (maxSize <= dataOffset + STORE_PAGE_SIZE)
+		return NULL;
+
+	const UINT64 dataSize = (maxSize - dataOffset) & ~(STORE_PAGE_SIZE - 1);
+
+	rdpPersistentCacheStore* store =
+	    (rdpPersistentCacheStore*)calloc(1, sizeof(rdpPersistentCacheStore));
+	if (!store)
+		return NULL;
+
+#if defined(_WIN32)
+	store->file = INVALID_HANDLE_VALUE;
+#else
+	store->fd = -1;
+#endif
+	store->mapSize = (size_t)(dataOffset + dataSize);
+	store->extents = (STORE_EXTENT*)calloc(STORE_EXTENTS, sizeof(STORE_EXTENT));
+	store->keys = HashTable_New(FALSE);
+	if (!store->extents || !store->keys)
+		goto fail;
+
+	if (!HashTable_SetHashFunction(store->keys, store_key_hash))
+		goto fail;
+
+	{
+		wObject* obj = HashTable_KeyObject(store->keys);
+		WINPR_ASSERT(obj);
+		obj->fnObjectEquals = store_key_equals;
+	}
+
+	if (!store_map(store, filename, &resized))
+	{
+		WLog_WARN(TAG, "failed to map persistent cache store %s", filename);
+		goto fail;
+	}
+
+	store->header = (STORE_HEADER*)store->map;
+	store->records = (STORE_RECORD*)&store->map[STORE_PAGE_SIZE];
+	store->data = &store->map[dataOffset];
+
+	if (resized || !store_header_valid(store, dataOffset, dataSize))
+	{
+		if (!store_reset(store, dataOffset, dataSize))
+			goto fail;
+	}
+
+	if (!store_load(store))
+		goto fail;
+
+	return store;
+
+fail:
+	WINPR_PRAGMA_DIAG_PUSH
+	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
+	persistent_cache_store_free(store);
+	WINPR_PRAGMA_DIAG_POP
+	return NULL;
+}
+
+void persistent_cache_store_free(rdpPersistentCacheStore* store)
+{
+	if (!store)
+		return;
+
+	if (store->map)
+	{
+		if (!persistent_cache_store_commit(store))
+			WLog_WARN(TAG, "failed to commit persistent cache store");
+	}
+
+	store_unmap(store);
+	HashTable_Free(store->keys);
+	free(store->extents);
+	free(store);
+}
+
+BOOL persistent_cache_store_commit(rdpPersistentCacheStore* store)
+{
+	WINPR_ASSERT(store);
+
+	if (!store->dirty)
+		return TRUE;
+
+	/* Everything written in this generation must be on disk before the header validates it */
+	if (!store_sync(store, store->mapSize))
+		return FALSE;
+
+	store->header->committed++;
+	store->header->clock = store->clock;
+	store_header_seal(store->header);
+	if (!store_sync(store, sizeof(STORE_HEADER)))
+		return FALSE;
+
+	for (size_t x = 0; x < store->extentCount;)
+	{
+		if (store->extents[x].pending)
+			store_extent_remove(store, x);
+		else
+			x++;
+	}
+
+	store->pendingBytes = 0;
+	store->dirty = FALSE;
+	return TRUE;
+}
+
+typedef struct
+{
+	UINT64 lastUse;
+	UINT32 index;
+} STORE_LRU_ITEM;
+
+static int store_lru_compare(const void* pa, const void* pb)
+{
+	const STORE_LRU_ITEM* a = (const STORE_LRU_ITEM*)pa;
+	const STORE_LRU_ITEM* b = (const STORE_LRU_ITEM*)pb;
+
+	if (a->lastUse > b->lastUse)
+		return -1;
+	if (a->lastUse < b->lastUse)
+		return 1;
+	return 0;
+}
+
+size_t persistent_cache_store_get_entries(rdpPersistentCacheStore* store,
+                                          PERSISTENT_CACHE_ENTRY* entries, size_t count)
+{
+	size_t used = 0;
+	STORE_LRU_ITEM* items = NULL;
+
+	WINPR_ASSERT(store);
+	WINPR_ASSERT(entries || (count == 0));
+
+	items = (STORE_LRU_ITEM*)calloc(STORE_RECORDS, sizeof(STORE_LRU_ITEM));
+	if (!items)
+		return 0;
+
+	for (UINT32 x = 0; x < STORE_RECORDS; x++)
+	{
+		const STORE_RECORD* record = &store->records[x];
+		if (record->state != STORE_RECORD_VALID)
+			continue;
+
+		items[used].lastUse = record->lastUse;
+		items[used].index = x;
+		used++;
+	}
+
+	qsort(items, used, sizeof(STORE_LRU_ITEM), store_lru_compare);
+
+	if (used > count)
+		used = count;
+
+	for (size_t x = 0; x < used; x++)
+	{
+		const STORE_RECORD* record = &store->records[items[x].index];
+		PERSISTENT_CACHE_ENTRY* entry = &entries[x];
+
+		entry->key64 = record->key;
+		entry->width = record->width;
+		entry->height = record->height;
+		entry->size = record->size;
+		entry->flags = 0;
+		entry->data = &store->data[record->offset];
+	}
+
+	free(items);
+	return used;
+}
+
+BOOL persistent_cache_store_get(rdpPersistentCacheStore* store, UINT64 key,
+                                PERSISTENT_CACHE_ENTRY* entry)
+{
+	WINPR_ASSERT(store);
+	WINPR_ASSERT(entry);
+
+	const size_t index = store_lookup(store, key);
+	if (index == 0)
+		return FALSE;
+
+	STORE_RECORD* record = &store->records[index - 1];
+	store_touch(store, record);
+
+	entry->key64 = record->key;
+	entry->width = record->width;
+	entry->height = record->height;
+	entry->size = record->size;
+	entry->flags = 0;
+	entry->data = &store->data[record->offset];
+	return TRUE;
+}
+
+BOOL persistent_cache_store_touch(rdpPersistentCacheStore* store, UINT64 key)
+{
+	WINPR_ASSERT(store);
+
+	const size_t index = store_lookup(store, key);
+	if (index == 0)
+		return FALSE;
+
+	store_touch(store, &store->records[index - 1]);
+	return TRUE;
+}
+
+BOOL persistent_cache_store_put(rdpPersistentCacheStore* store, const PERSISTENT_CACHE_ENTRY* entry)
+{
+	UINT32 index = STORE_RECORDS;
+	UINT64 offset = 0;
+
+	WINPR_ASSERT(store);
+	WINPR_ASSERT(entry);
+
+	if (!entry->data || (entry->size == 0) || (entry->size > store->header->dataSize))
+		return FALSE;
+
+	if (persistent_cache_store_touch(store, entry->key64))
+		return TRUE;
+
+	const UINT64 size = store_aligned_size(entry->size);
+
+	for (UINT32 x = 0; x < STORE_RECORDS; x++)
+	{
+		if (store->records[x].state != STORE_RECORD_VALID)
+		{
+			index = x;
+			break;
+		}
+	}
+
+	if (index == STORE_RECORDS)
+	{
+		if (!store_evict_lru(store, STORE_RECORDS))
+			return FALSE;
+		return persistent_cache_store_put(store, entry);
+	}
+
+	while (!store_find_gap(store, size, &offset))
+	{
+		/* Space of evicted entries becomes available with the next commit */
+		if (store->pendingBytes >= size)
+		{
+			if (!persistent_cache_store_commit(store))
+				return FALSE;
+		}
+		else if (!store_evict_lru(store, index))
+		{
+			if ((store->pendingBytes == 0) || !persistent_cache_store_commit(store))
+				return FALSE;
+		}
+	}
+
+	memcpy(&store->data[offset], entry->data, entry->size);
+
+	STORE_RECORD* record = &store->records[index];
+	memset(record, 0, sizeof(STORE_RECORD));
+	record->key = entry->key64;
+	record->lastUse = ++store->clock;
+	record->offset = offset;
+	record->generation = store->header->committed + 1;
+	record->size = entry->size;
+	record->width = entry->width;
+	record->height = entry->height;
+	record->state = STORE_RECORD_VALID;
+	store_record_seal(record);
+
+	if (!store_extent_insert(store, offset, size, index))
+	{
+		memset(record, 0, sizeof(STORE_RECORD));
+		return FALSE;
+	}
+
+	if (!HashTable_Insert(store->keys, &record->key, (void*)(UINT_PTR)(index + 1ull)))
+	{
+		store_record_free(store, index);
+		return FALSE;
+	}
+
+	store->dirty = TRUE;
+	return TRUE;
+}
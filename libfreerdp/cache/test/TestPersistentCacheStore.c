@@ -0,0 +1,287 @@
+#include <stdio.h>
+
+#include <winpr/path.h>
+#include <winpr/file.h>
+#include <winpr/crypto.h>
+
+#include <freerdp/cache/persistent.h>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#define TEST_ENTRY_SIZE (64 * 64 * 4)
+
+/* header page and the index of 5462 records, followed by room for 4 entries */
+#define TEST_STORE_SIZE (4096 + 352256 + 4 * TEST_ENTRY_SIZE)
+
+/* room for every record twice, with small entries the record table runs full first */
+#define TEST_RECORDS 5462
+#define TEST_SMALL_SIZE 256
+#define TEST_SMALL_STORE_SIZE (4096 + 352256 + 2 * TEST_RECORDS * TEST_SMALL_SIZE + 4096)
+
+static BYTE test_data[8][TEST_ENTRY_SIZE];
+
+static BOOL test_put(rdpPersistentCacheStore* store, UINT64 key)
+{
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+
+	entry.key64 = key;
+	entry.width = 64;
+	entry.height = 64;
+	entry.size = TEST_ENTRY_SIZE;
+	entry.data = test_data[key];
+	return persistent_cache_store_put(store, &entry);
+}
+
+static BOOL test_get(rdpPersistentCacheStore* store, UINT64 key)
+{
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+
+	if (!persistent_cache_store_get(store, key, &entry))
+		return FALSE;
+	if ((entry.key64 != key) || (entry.width != 64) || (entry.height != 64) ||
+	    (entry.size != TEST_ENTRY_SIZE))
+		return FALSE;
+	return memcmp(entry.data, test_data[key], TEST_ENTRY_SIZE) == 0;
+}
+
+static BOOL test_order(rdpPersistentCacheStore* store, const UINT64* keys, size_t count)
+{
+	PERSISTENT_CACHE_ENTRY entries[8] = { 0 };
+
+	const size_t rc = persistent_cache_store_get_entries(store, entries, ARRAYSIZE(entries));
+	if (rc != count)
+	{
+		printf("expected %" PRIuz " entries, got %" PRIuz "\n", count, rc);
+		return FALSE;
+	}
+
+	for (size_t x = 0; x < count; x++)
+	{
+		if (entries[x].key64 != keys[x])
+		{
+			printf("entry %" PRIuz ": expected key %" PRIu64 ", got %" PRIu64 "\n", x, keys[x],
+			       entries[x].key64);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static BOOL test_put_small(rdpPersistentCacheStore* store, UINT64 key)
+{
+	BYTE data[TEST_SMALL_SIZE] = { 0 };
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+
+	memset(data, (int)(key & 0xFF), sizeof(data));
+	entry.key64 = key;
+	entry.width = 8;
+	entry.height = 8;
+	entry.size = sizeof(data);
+	entry.data = data;
+	return persistent_cache_store_put(store, &entry);
+}
+
+static BOOL test_get_small(rdpPersistentCacheStore* store, UINT64 key)
+{
+	PERSISTENT_CACHE_ENTRY entry = { 0 };
+	const BYTE* data = NULL;
+
+	if (!persistent_cache_store_get(store, key, &entry))
+		return FALSE;
+	if ((entry.key64 != key) || (entry.size != TEST_SMALL_SIZE))
+		return FALSE;
+
+	data = entry.data;
+	for (size_t x = 0; x < TEST_SMALL_SIZE; x++)
+	{
+		if (data[x] != (key & 0xFF))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+#if !defined(_WIN32)
+/* Write an entry and terminate without committing it */
+static BOOL test_crash(const char* name)
+{
+	const pid_t pid = fork();
+	if (pid < 0)
+		return FALSE;
+
+	if (pid == 0)
+	{
+		rdpPersistentCacheStore* store = persistent_cache_store_new(name, TEST_STORE_SIZE);
+		if (!store || !test_put(store, 4))
+			_exit(1);
+		_exit(0);
+	}
+
+	int status = 0;
+	if (waitpid(pid, &status, 0) != pid)
+		return FALSE;
+	return WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+}
+#endif
+
+static BOOL test_store(const char* name)
+{
+	BOOL rc = FALSE;
+	rdpPersistentCacheStore* store = persistent_cache_store_new(name, TEST_STORE_SIZE);
+
+	if (!store)
+		goto fail;
+
+	for (UINT64 key = 1; key <= 3; key++)
+	{
+		if (!test_put(store, key))
+			goto fail;
+	}
+
+	/* equal keys are not stored twice */
+	if (!test_put(store, 2))
+		goto fail;
+	if (!persistent_cache_store_commit(store))
+		goto fail;
+
+	persistent_cache_store_free(store);
+	store = NULL;
+
+#if !defined(_WIN32)
+	if (!test_crash(name))
+		goto fail;
+#endif
+
+	store = persistent_cache_store_new(name, TEST_STORE_SIZE);
+	if (!store)
+		goto fail;
+
+	{
+		const UINT64 keys[] = { 2, 3, 1 };
+		if (!test_order(store, keys, ARRAYSIZE(keys)))
+			goto fail;
+	}
+
+	if (!test_get(store, 1) || !test_get(store, 2) || !test_get(store, 3))
+		goto fail;
+
+	/* the store is full with 4 entries, the least recently used ones are evicted */
+	if (!test_put(store, 5) || !test_put(store, 6) || !test_put(store, 7))
+		goto fail;
+
+	{
+		const UINT64 keys[] = { 7, 6, 5, 3 };
+		if (!test_order(store, keys, ARRAYSIZE(keys)))
+			goto fail;
+	}
+
+	if (test_get(store, 1) || test_get(store, 2))
+		goto fail;
+
+	persistent_cache_store_free(store);
+	store = NULL;
+
+	store = persistent_cache_store_new(name, TEST_STORE_SIZE);
+	if (!store)
+		goto fail;
+
+	if (!test_get(store, 3) || !test_get(store, 5) || !test_get(store, 6) || !test_get(store, 7))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	persistent_cache_store_free(store);
+	return rc;
+}
+
+/* Replacing committed entries keeps their old data reserved until the next commit */
+static BOOL test_store_full(const char* name)
+{
+	BOOL rc = FALSE;
+	UINT64 key = 0;
+	rdpPersistentCacheStore* store = persistent_cache_store_new(name, TEST_SMALL_STORE_SIZE);
+
+	if (!store)
+		goto fail;
+
+	for (; key < TEST_RECORDS; key++)
+	{
+		if (!test_put_small(store, key))
+			goto fail;
+	}
+
+	if (!persistent_cache_store_commit(store))
+		goto fail;
+
+	/* every put evicts a committed entry and reuses its record */
+	for (size_t round = 0; round < 3; round++)
+	{
+		for (size_t x = 0; x < 100; x++, key++)
+		{
+			if (!test_put_small(store, key))
+				goto fail;
+		}
+
+		/* a record reused in this generation is replaced again */
+		for (size_t x = 0; x < 100; x++, key++)
+		{
+			if (!test_put_small(store, key))
+				goto fail;
+		}
+
+		if (!persistent_cache_store_commit(store))
+			goto fail;
+	}
+
+	persistent_cache_store_free(store);
+	store = persistent_cache_store_new(name, TEST_SMALL_STORE_SIZE);
+	if (!store)
+		goto fail;
+
+	for (UINT64 x = 0; x < key; x++)
+	{
+		const BOOL expected = (x >= key - TEST_RECORDS);
+		if (test_get_small(store, x) != expected)
+		{
+			printf("entry %" PRIu64 ": expected %s\n", x, expected ? "present" : "evicted");
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	persistent_cache_store_free(store);
+	return rc;
+}
+
+int TestPersistentCacheStore(int argc, char* argv[])
+{
+	int rc = -1;
+	BYTE tmp[16] = { 0 };
+	char tmp2[64] = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	winpr_RAND(test_data, sizeof(test_data));
+	winpr_RAND(tmp, sizeof(tmp));
+	for (size_t x = 0; x < sizeof(tmp); x++)
+		(void)_snprintf(&tmp2[x * 2], sizeof(tmp2) - 2 * x, "%02" PRIx8, tmp[x]);
+
+	char* name = GetKnownSubPath(KNOWN_PATH_TEMP, tmp2);
+	if (!name)
+		return -1;
+
+	if (test_store(name))
+	{
+		(void)winpr_DeleteFile(name);
+		if (test_store_full(name))
+			rc = 0;
+	}
+
+	(void)winpr_DeleteFile(name);
+	free(name);
+	return rc;
+}
@@ -167,6 +167,7 @@ int bulk_decompress(rdpBulk* WINPR_RESTRICT bulk, const BYTE* WINPR_RESTRICT pSr
 
 	if (flags & BULK_COMPRESSION_FLAGS_MASK)
 	{
+		const UINT64 begin = metrics_stage_begin(metrics);
 		switch (type)
 		{
 			case PACKET_COMPR_TYPE_8K:
@@ -201,6 +202,7 @@ int bulk_decompress(rdpBulk* WINPR_RESTRICT bulk, const BYTE* WINPR_RESTRICT pSr
 				status = -1;
 				break;
 		}
+		metrics_stage_end(metrics, FREERDP_METRICS_BULK_DECOMPRESS, begin);
 	}
 	else
 	{
@@ -276,9 +278,19 @@ int bulk_compress(rdpBulk* WINPR_RESTRICT bulk, const BYTE* WINPR_RESTRICT pSrcD
 			                         ppDstData, pDstSize, pFlags);
 			break;
 		case PACKET_COMPR_TYPE_RDP61:
+		{
+			const UINT32 level = freerdp_settings_get_uint32(bulk->context->settings,
+			                                                 FreeRDP_XCrushCompressionLevel);
+			if (!xcrush_set_compression_level(bulk->xcrushSend, level))
+			{
+				WLog_ERR(TAG, "Invalid xcrush compression level %" PRIu32, level);
+				status = -1;
+				break;
+			}
 			status = xcrush_compress(bulk->xcrushSend, pSrcData, SrcSize, bulk->OutputBuffer,
 			                         ppDstData, pDstSize, pFlags);
-			break;
+		}
+		break;
 		case PACKET_COMPR_TYPE_RDP8:
 			WLog_ERR(TAG, "Unsupported bulk compression type %08" PRIx32, bulk->CompressionLevel);
 			status = -1;
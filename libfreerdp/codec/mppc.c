@@ -22,6 +22,8 @@
 
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/intrin.h>
+#include <winpr/endian.h>
 #include <winpr/stream.h>
 #include <winpr/bitstream.h>
 
@@ -48,6 +50,7 @@ struct s_MPPC_CONTEXT
 	ALIGN64 BYTE HistoryBuffer[65536];
 	ALIGN64 UINT16 MatchBuffer[32768];
 	ALIGN64 UINT32 CompressionLevel;
+	ALIGN64 BOOL FastDecoder;
 };
 
 static const UINT32 MPPC_MATCH_TABLE[256] = {
@@ -85,6 +88,214 @@ static const UINT32 MPPC_MATCH_TABLE[256] = {
 	0x97E91668, 0x9885E5FB, 0x9922B58E, 0x99BF8521, 0x9A5C54B4, 0x9AF92447, 0x9B95F3DA, 0x9C32C36D
 };
 
+/**
+ * Bit reader for the fast decoder. The next bits of the stream are kept MSB first in a 64 bit
+ * window, refilled from whole 64 bit words as long as the input has 8 more bytes. Past the end
+ * the window is zero padded like wBitStream does.
+ */
+typedef struct
+{
+	const BYTE* ptr;
+	const BYTE* end;
+	UINT64 window;
+	UINT32 avail;
+} MPPC_BIT_READER;
+
+static INLINE void mppc_reader_refill(MPPC_BIT_READER* WINPR_RESTRICT reader)
+{
+	if (reader->avail >= 32)
+		return;
+
+	if ((reader->end - reader->ptr) >= 8)
+	{
+		reader->window |= winpr_Data_Get_UINT64_BE(reader->ptr) >> reader->avail;
+		reader->ptr += (63 - reader->avail) / 8;
+		reader->avail |= 56;
+		return;
+	}
+
+	while ((reader->avail <= 56) && (reader->ptr < reader->end))
+	{
+		reader->window |= (UINT64)*reader->ptr++ << (56 - reader->avail);
+		reader->avail += 8;
+	}
+
+	/* only zero bits follow */
+	if (reader->ptr >= reader->end)
+		reader->avail = 64;
+}
+
+static INLINE UINT32 mppc_reader_peek(MPPC_BIT_READER* WINPR_RESTRICT reader)
+{
+	mppc_reader_refill(reader);
+	return (UINT32)(reader->window >> 32);
+}
+
+static INLINE void mppc_reader_skip(MPPC_BIT_READER* WINPR_RESTRICT reader, UINT32 nbits)
+{
+	reader->window <<= nbits;
+	reader->avail -= nbits;
+}
+
+/* Same result as a forward byte by byte copy, which repeats the pattern if the areas overlap */
+static INLINE void mppc_copy_match(BYTE* dst, const BYTE* src, size_t length)
+{
+	if ((length >= 8) && ((src > dst) || (src + 8 <= dst)))
+	{
+		do
+		{
+			UINT64 word = 0;
+			memcpy(&word, src, sizeof(word));
+			memcpy(dst, &word, sizeof(word));
+			src += 8;
+			dst += 8;
+			length -= 8;
+		} while (length >= 8);
+	}
+
+	while (length--)
+		*dst++ = *src++;
+}
+
+static int mppc_decompress_fast(MPPC_CONTEXT* WINPR_RESTRICT mppc,
+                                const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+                                const BYTE** WINPR_RESTRICT ppDstData,
+                                UINT32* WINPR_RESTRICT pDstSize)
+{
+	UINT32 position = 0;
+	UINT32 CopyOffset = 0;
+	UINT32 LengthOfMatch = 0;
+	MPPC_BIT_READER reader = { pSrcData, &pSrcData[SrcSize], 0, 0 };
+
+	WINPR_ASSERT(mppc);
+
+	BYTE* HistoryBuffer = mppc->HistoryBuffer;
+	const BYTE* HistoryBufferEnd = &HistoryBuffer[mppc->HistoryBufferSize - 1];
+	const UINT32 CompressionLevel = mppc->CompressionLevel;
+	const UINT32 length = SrcSize * 8;
+	BYTE* HistoryPtr = mppc->HistoryPtr;
+
+	/* unsigned like wBitStream, a symbol running past the end keeps decoding zero bits */
+	while ((length - position) >= 8)
+	{
+		UINT32 accumulator = mppc_reader_peek(&reader);
+		UINT32 nbits = 0;
+
+		if (HistoryPtr > HistoryBufferEnd)
+		{
+			WLog_ERR(TAG, "history buffer index out of range");
+			return -1004;
+		}
+
+		if ((accumulator & 0x80000000) == 0x00000000)
+		{
+			*HistoryPtr++ = (BYTE)(accumulator >> 24);
+			mppc_reader_skip(&reader, 8);
+			position += 8;
+			continue;
+		}
+		else if ((accumulator & 0xC0000000) == 0x80000000)
+		{
+			*HistoryPtr++ = (BYTE)(((accumulator >> 23) & 0x7F) + 0x80);
+			mppc_reader_skip(&reader, 9);
+			position += 9;
+			continue;
+		}
+
+		if (CompressionLevel) /* RDP5 */
+		{
+			if ((accumulator & 0xF8000000) == 0xF8000000)
+			{
+				CopyOffset = ((accumulator >> 21) & 0x3F);
+				nbits = 11;
+			}
+			else if ((accumulator & 0xF8000000) == 0xF0000000)
+			{
+				CopyOffset = ((accumulator >> 19) & 0xFF) + 64;
+				nbits = 13;
+			}
+			else if ((accumulator & 0xF0000000) == 0xE0000000)
+			{
+				CopyOffset = ((accumulator >> 17) & 0x7FF) + 320;
+				nbits = 15;
+			}
+			else
+			{
+				CopyOffset = ((accumulator >> 13) & 0xFFFF) + 2368;
+				nbits = 19;
+			}
+		}
+		else /* RDP4 */
+		{
+			if ((accumulator & 0xF0000000) == 0xF0000000)
+			{
+				CopyOffset = ((accumulator >> 22) & 0x3F);
+				nbits = 10;
+			}
+			else if ((accumulator & 0xF0000000) == 0xE0000000)
+			{
+				CopyOffset = ((accumulator >> 20) & 0xFF) + 64;
+				nbits = 12;
+			}
+			else
+			{
+				CopyOffset = ((accumulator >> 16) & 0x1FFF) + 320;
+				nbits = 16;
+			}
+		}
+
+		mppc_reader_skip(&reader, nbits);
+		position += nbits;
+
+		/**
+		 * LengthOfMatch is a prefix of n one bits and a zero bit followed by n + 1 bits, the
+		 * length is 2^(n + 1) plus these bits. n = 0 encodes 3.
+		 */
+		accumulator = mppc_reader_peek(&reader);
+		const UINT32 ones = (~accumulator != 0) ? __lzcnt(~accumulator) : 32;
+
+		if (ones == 0)
+		{
+			LengthOfMatch = 3;
+			nbits = 1;
+		}
+		else if (ones <= (CompressionLevel ? 14u : 11u))
+		{
+			const UINT32 bits = ones + 1;
+			LengthOfMatch = (1u << bits) + ((accumulator << bits) >> (32 - bits));
+			nbits = 2 * bits;
+		}
+		else
+		{
+			/* Invalid LengthOfMatch Encoding */
+			return -1003;
+		}
+
+		mppc_reader_skip(&reader, nbits);
+		position += nbits;
+
+#if defined(DEBUG_MPPC)
+		WLog_DBG(TAG, "<%" PRIu32 ",%" PRIu32 ">", CopyOffset, LengthOfMatch);
+#endif
+
+		if ((HistoryPtr + LengthOfMatch - 1) > HistoryBufferEnd)
+		{
+			WLog_ERR(TAG, "history buffer overflow");
+			return -1005;
+		}
+
+		const BYTE* SrcPtr = &HistoryBuffer[(HistoryPtr - HistoryBuffer - CopyOffset) &
+		                                    (CompressionLevel ? 0xFFFF : 0x1FFF)];
+		mppc_copy_match(HistoryPtr, SrcPtr, LengthOfMatch);
+		HistoryPtr += LengthOfMatch;
+	}
+
+	*pDstSize = (UINT32)(HistoryPtr - mppc->HistoryPtr);
+	*ppDstData = mppc->HistoryPtr;
+	mppc->HistoryPtr = HistoryPtr;
+	return 1;
+}
+
 int mppc_decompress(MPPC_CONTEXT* mppc, const BYTE* pSrcData, UINT32 SrcSize,
                     const BYTE** ppDstData, UINT32* pDstSize, UINT32 flags)
 {
@@ -139,6 +350,9 @@ int mppc_decompress(MPPC_CONTEXT* mppc, const BYTE* pSrcData, UINT32 SrcSize,
 		return 1;
 	}
 
+	if (mppc->FastDecoder)
+		return mppc_decompress_fast(mppc, pSrcData, SrcSize, ppDstData, pDstSize);
+
 	while ((bs->length - bs->position) >= 8)
 	{
 		accumulator = bs->accumulator;
@@ -781,6 +995,12 @@ int mppc_compress(MPPC_CONTEXT* mppc, const BYTE* pSrcData, UINT32 SrcSize, BYTE
 	return 1;
 }
 
+void mppc_set_fast_decoder(MPPC_CONTEXT* mppc, BOOL enable)
+{
+	WINPR_ASSERT(mppc);
+	mppc->FastDecoder = enable;
+}
+
 void mppc_set_compression_level(MPPC_CONTEXT* mppc, DWORD CompressionLevel)
 {
 	WINPR_ASSERT(mppc);
@@ -824,6 +1044,7 @@ MPPC_CONTEXT* mppc_context_new(DWORD CompressionLevel, BOOL Compressor)
 		goto fail;
 
 	mppc->Compressor = Compressor;
+	mppc->FastDecoder = TRUE;
 
 	if (CompressionLevel < 1)
 	{
@@ -42,6 +42,10 @@ extern "C"
 
 	FREERDP_LOCAL void mppc_set_compression_level(MPPC_CONTEXT* mppc, DWORD CompressionLevel);
 
+	/* The fast decoder (default) reads the bitstream through 64 bit windows and copies matches
+	 * a word at a time. Its output, including errors, is identical to the bit by bit decoder. */
+	FREERDP_LOCAL void mppc_set_fast_decoder(MPPC_CONTEXT* mppc, BOOL enable);
+
 	FREERDP_LOCAL void mppc_context_reset(MPPC_CONTEXT* mppc, BOOL flush);
 
 	FREERDP_LOCAL MPPC_CONTEXT* mppc_context_new(DWORD CompressionLevel, BOOL Compressor);
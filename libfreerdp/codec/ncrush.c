@@ -25,6 +25,7 @@
 #include <winpr/cast.h>
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/endian.h>
 #include <winpr/bitstream.h>
 
 #include <freerdp/log.h>
@@ -48,6 +49,7 @@ struct s_NCRUSH_CONTEXT
 	ALIGN64 UINT16 MatchTable[65536];
 	ALIGN64 BYTE HuffTableCopyOffset[1024];
 	ALIGN64 BYTE HuffTableLOM[4096];
+	ALIGN64 BOOL FastDecoder;
 };
 
 static const UINT16 HuffTableLEC[8192] = {
@@ -1940,7 +1942,7 @@ static INLINE UINT32 get_dword(const BYTE* data)
 }
 
 static INLINE BOOL NCrushFetchBits(const BYTE** SrcPtr, const BYTE** SrcEnd, INT32* nbits,
-                                   UINT32* bits)
+                                   UINT64* bits, BOOL wide)
 {
 	WINPR_ASSERT(SrcPtr);
 	WINPR_ASSERT(SrcEnd);
@@ -1949,7 +1951,16 @@ static INLINE BOOL NCrushFetchBits(const BYTE** SrcPtr, const BYTE** SrcEnd, INT
 
 	if (*nbits < 16)
 	{
-		if ((*SrcPtr + 1) >= *SrcEnd)
+		if (wide && ((*SrcEnd - *SrcPtr) >= 8))
+		{
+			/* no symbol reads more than 15 bits, so 0 < nbits < 16 and 6 or 7 whole bytes fit */
+			const INT32 count = (63 - *nbits) / 8;
+			*bits |= winpr_Data_Get_UINT64(*SrcPtr) << *nbits;
+			*nbits += 8 * count;
+			*bits &= (1ull << *nbits) - 1ull;
+			*SrcPtr += count;
+		}
+		else if ((*SrcPtr + 1) >= *SrcEnd)
 		{
 			if (*SrcPtr >= *SrcEnd)
 			{
@@ -1976,6 +1987,26 @@ static INLINE BOOL NCrushFetchBits(const BYTE** SrcPtr, const BYTE** SrcEnd, INT
 	return TRUE;
 }
 
+/* Same result as a forward byte by byte copy, which repeats the pattern if the areas overlap */
+static INLINE void ncrush_copy_match(BYTE* dst, const BYTE* src, size_t length)
+{
+	if ((length >= 8) && (src + 8 <= dst))
+	{
+		do
+		{
+			UINT64 word = 0;
+			memcpy(&word, src, sizeof(word));
+			memcpy(dst, &word, sizeof(word));
+			src += 8;
+			dst += 8;
+			length -= 8;
+		} while (length >= 8);
+	}
+
+	while (length--)
+		*dst++ = *src++;
+}
+
 static INLINE void NCrushWriteStart(UINT32* bits, UINT32* offset, UINT32* accumulator)
 {
 	WINPR_ASSERT(bits);
@@ -2080,13 +2111,14 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 	const BYTE* SrcPtr = pSrcData + 4;
 
 	INT32 nbits = 32;
-	UINT32 bits = get_dword(pSrcData);
+	UINT64 bits = get_dword(pSrcData);
+	const BOOL wide = ncrush->FastDecoder;
 	while (1)
 	{
 		while (1)
 		{
 			const UINT16 Mask = get_word(&HuffTableMask[29]);
-			const UINT32 MaskedBits = bits & Mask;
+			const UINT32 MaskedBits = (UINT32)(bits & Mask);
 			if (MaskedBits >= ARRAYSIZE(HuffTableLEC))
 				return -1;
 			IndexLEC = HuffTableLEC[MaskedBits] & 0xFFF;
@@ -2094,7 +2126,7 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 			bits >>= BitLength;
 			nbits -= WINPR_ASSERTING_INT_CAST(int32_t, BitLength);
 
-			if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
+			if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits, wide))
 				return -1;
 
 			if (IndexLEC >= 256)
@@ -2126,7 +2158,7 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 			{
 				CopyOffset = ncrush->OffsetCache[OffsetCacheIndex];
 				const UINT16 Mask = get_word(&HuffTableMask[21]);
-				const UINT32 MaskedBits = bits & Mask;
+				const UINT32 MaskedBits = (UINT32)(bits & Mask);
 				if (MaskedBits >= ARRAYSIZE(HuffTableLOM))
 					return -1;
 				LengthOfMatch = HuffTableLOM[MaskedBits] & 0xFFF;
@@ -2135,7 +2167,7 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 				nbits -= WINPR_ASSERTING_INT_CAST(int32_t, BitLength);
 			}
 
-			if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
+			if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits, wide))
 				return -1;
 
 			if (LengthOfMatch >= ARRAYSIZE(LOMBitsLUT))
@@ -2154,12 +2186,12 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 					return -1;
 
 				const UINT16 Mask = get_word(&HuffTableMask[idx]);
-				const UINT32 MaskedBits = bits & Mask;
+				const UINT32 MaskedBits = (UINT32)(bits & Mask);
 				bits >>= LengthOfMatchBits;
 				nbits -= WINPR_ASSERTING_INT_CAST(int32_t, LengthOfMatchBits);
 				LengthOfMatchBase += MaskedBits;
 
-				if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
+				if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits, wide))
 					return -1;
 			}
 
@@ -2187,7 +2219,7 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 
 				{
 					const UINT16 Mask = get_word(&HuffTableMask[idx]);
-					const UINT32 MaskedBits = bits & Mask;
+					const UINT32 MaskedBits = (UINT32)(bits & Mask);
 					const UINT32 tmp = CopyOffsetBase + MaskedBits;
 					if (tmp < 1)
 						return -1;
@@ -2196,12 +2228,12 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 				bits >>= CopyOffsetBits;
 				nbits -= WINPR_ASSERTING_INT_CAST(int32_t, CopyOffsetBits);
 
-				if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
+				if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits, wide))
 					return -1;
 			}
 			{
 				const UINT16 Mask = get_word(&HuffTableMask[21]);
-				const UINT32 MaskedBits = bits & Mask;
+				const UINT32 MaskedBits = (UINT32)(bits & Mask);
 				if (MaskedBits >= ARRAYSIZE(HuffTableLOM))
 					return -1;
 
@@ -2210,7 +2242,7 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 				bits >>= BitLength;
 				nbits -= WINPR_ASSERTING_INT_CAST(int32_t, BitLength);
 			}
-			if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
+			if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits, wide))
 				return -1;
 
 			if (LengthOfMatch >= ARRAYSIZE(LOMBitsLUT))
@@ -2229,12 +2261,12 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 					return -1;
 
 				const UINT16 Mask = get_word(&HuffTableMask[idx]);
-				const UINT32 MaskedBits = bits & Mask;
+				const UINT32 MaskedBits = (UINT32)(bits & Mask);
 				bits >>= LengthOfMatchBits;
 				nbits -= WINPR_ASSERTING_INT_CAST(int32_t, LengthOfMatchBits);
 				LengthOfMatchBase += MaskedBits;
 
-				if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits))
+				if (!NCrushFetchBits(&SrcPtr, &SrcEnd, &nbits, &bits, wide))
 					return -1;
 			}
 
@@ -2258,7 +2290,12 @@ int ncrush_decompress(NCRUSH_CONTEXT* ncrush, const BYTE* pSrcData, UINT32 SrcSi
 		index = 0;
 		CopyLength = (LengthOfMatch > CopyOffset) ? CopyOffset : LengthOfMatch;
 
-		if (CopyOffsetPtr >= HistoryBuffer)
+		if (wide && (CopyOffset > 0) && (CopyOffsetPtr >= HistoryBuffer))
+		{
+			ncrush_copy_match(HistoryPtr, CopyOffsetPtr, LengthOfMatch);
+			HistoryPtr += LengthOfMatch;
+		}
+		else if (CopyOffsetPtr >= HistoryBuffer)
 		{
 			while (CopyLength > 0)
 			{
@@ -3007,6 +3044,12 @@ void ncrush_context_reset(NCRUSH_CONTEXT* ncrush, BOOL flush)
 	ncrush->HistoryPtr = &(ncrush->HistoryBuffer[ncrush->HistoryOffset]);
 }
 
+void ncrush_set_fast_decoder(NCRUSH_CONTEXT* ncrush, BOOL enable)
+{
+	WINPR_ASSERT(ncrush);
+	ncrush->FastDecoder = enable;
+}
+
 NCRUSH_CONTEXT* ncrush_context_new(BOOL Compressor)
 {
 	NCRUSH_CONTEXT* ncrush = (NCRUSH_CONTEXT*)calloc(1, sizeof(NCRUSH_CONTEXT));
@@ -3015,6 +3058,7 @@ NCRUSH_CONTEXT* ncrush_context_new(BOOL Compressor)
 		goto fail;
 
 	ncrush->Compressor = Compressor;
+	ncrush->FastDecoder = TRUE;
 	ncrush->HistoryBufferSize = 65536;
 	ncrush->HistoryEndOffset = ncrush->HistoryBufferSize - 1;
 	ncrush->HistoryBufferFence = 0xABABABAB;
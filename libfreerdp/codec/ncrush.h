@@ -43,6 +43,10 @@ extern "C"
 
 	FREERDP_LOCAL void ncrush_context_reset(NCRUSH_CONTEXT* ncrush, BOOL flush);
 
+	/* The fast decoder (default) refills its bit buffer from 64 bit words and copies matches a
+	 * word at a time. Its output, including errors, is identical to the byte wise decoder. */
+	FREERDP_LOCAL void ncrush_set_fast_decoder(NCRUSH_CONTEXT* ncrush, BOOL enable);
+
 	FREERDP_LOCAL NCRUSH_CONTEXT* ncrush_context_new(BOOL Compressor);
 	FREERDP_LOCAL void ncrush_context_free(NCRUSH_CONTEXT* ncrush);
 
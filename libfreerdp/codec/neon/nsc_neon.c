@@ -1,6 +1,6 @@
 /**
  * FreeRDP: A Remote Desktop Protocol Implementation
- * NSCodec Library - SSE2 Optimizations
+ * NSCodec Library - NEON Optimizations
  *
  * Copyright 2024 Armin Novak <anovak@thincast.com>
  * Copyright 2024 Thincast Technologies GmbH
@@ -21,15 +21,117 @@
 #include <winpr/platform.h>
 #include <winpr/sysinfo.h>
 #include <freerdp/config.h>
-#include <freerdp/log.h>
+#include <freerdp/codec/color.h>
 
 #include "../nsc_types.h"
+#include "../nsc_encode.h"
 #include "nsc_neon.h"
 
 #include "../../core/simd.h"
 
 #if defined(NEON_INTRINSICS_ENABLED)
-#define TAG FREERDP_TAG("codec.nsc.neon")
+#include <arm_neon.h>
+
+static void nsc_encode_row_neon(const NSC_CONTEXT* WINPR_RESTRICT context,
+                                const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT yplane,
+                                BYTE* WINPR_RESTRICT coplane, BYTE* WINPR_RESTRICT cgplane,
+                                BYTE* WINPR_RESTRICT aplane, UINT32 width)
+{
+	size_t r = 0;
+	size_t g = 1;
+	size_t b = 0;
+	BOOL alpha = FALSE;
+
+	switch (context->format)
+	{
+		case PIXEL_FORMAT_BGRA32:
+			r = 2;
+			alpha = TRUE;
+			break;
+
+		case PIXEL_FORMAT_BGRX32:
+			r = 2;
+			break;
+
+		case PIXEL_FORMAT_RGBA32:
+			b = 2;
+			alpha = TRUE;
+			break;
+
+		case PIXEL_FORMAT_RGBX32:
+			b = 2;
+			break;
+
+		default:
+			nsc_encode_row(context, src, yplane, coplane, cgplane, aplane, width);
+			return;
+	}
+
+	/* a negative shift count shifts right, arithmetic for signed lanes */
+	const int16x8_t ccl = vdupq_n_s16((int16_t)-(INT32)context->ColorLossLevel);
+	UINT32 x = 0;
+
+	for (; x + 16 <= width; x += 16)
+	{
+		const uint8x16x4_t px = vld4q_u8(&src[4ull * x]);
+		uint8x8_t yv[2];
+		int8x8_t cov[2];
+		int8x8_t cgv[2];
+
+		for (size_t i = 0; i < 2; i++)
+		{
+			const uint8x8_t r8 = i ? vget_high_u8(px.val[r]) : vget_low_u8(px.val[r]);
+			const uint8x8_t g8 = i ? vget_high_u8(px.val[g]) : vget_low_u8(px.val[g]);
+			const uint8x8_t b8 = i ? vget_high_u8(px.val[b]) : vget_low_u8(px.val[b]);
+			const int16x8_t r16 = vreinterpretq_s16_u16(vmovl_u8(r8));
+			const int16x8_t g16 = vreinterpretq_s16_u16(vmovl_u8(g8));
+			const int16x8_t b16 = vreinterpretq_s16_u16(vmovl_u8(b8));
+			const int16x8_t y16 =
+			    vaddq_s16(vaddq_s16(vshrq_n_s16(r16, 2), vshrq_n_s16(g16, 1)), vshrq_n_s16(b16, 2));
+			const int16x8_t co16 = vshlq_s16(vsubq_s16(r16, b16), ccl);
+			const int16x8_t cg16 = vshlq_s16(
+			    vsubq_s16(vsubq_s16(g16, vshrq_n_s16(r16, 1)), vshrq_n_s16(b16, 1)), ccl);
+
+			/* the narrowing keeps the low bytes, like a cast to BYTE */
+			yv[i] = vmovn_u16(vreinterpretq_u16_s16(y16));
+			cov[i] = vmovn_s16(co16);
+			cgv[i] = vmovn_s16(cg16);
+		}
+
+		vst1q_u8(&yplane[x], vcombine_u8(yv[0], yv[1]));
+		vst1q_u8(&coplane[x], vreinterpretq_u8_s8(vcombine_s8(cov[0], cov[1])));
+		vst1q_u8(&cgplane[x], vreinterpretq_u8_s8(vcombine_s8(cgv[0], cgv[1])));
+		vst1q_u8(&aplane[x], alpha ? px.val[3] : vdupq_n_u8(0xFF));
+	}
+
+	nsc_encode_row(context, &src[4ull * x], &yplane[x], &coplane[x], &cgplane[x], &aplane[x],
+	               width - x);
+}
+
+static void nsc_subsample_row_neon(const BYTE* WINPR_RESTRICT src0,
+                                   const BYTE* WINPR_RESTRICT src1, BYTE* WINPR_RESTRICT dst,
+                                   UINT32 width)
+{
+	UINT32 x = 0;
+
+	for (; x + 16 <= width; x += 16)
+	{
+		/* val[0] holds the even, val[1] the odd samples */
+		const int8x16x2_t a = vld2q_s8((const int8_t*)&src0[2ull * x]);
+		const int8x16x2_t b = vld2q_s8((const int8_t*)&src1[2ull * x]);
+		const int16x8_t lo =
+		    vaddq_s16(vaddl_s8(vget_low_s8(a.val[0]), vget_low_s8(a.val[1])),
+		              vaddl_s8(vget_low_s8(b.val[0]), vget_low_s8(b.val[1])));
+		const int16x8_t hi =
+		    vaddq_s16(vaddl_s8(vget_high_s8(a.val[0]), vget_high_s8(a.val[1])),
+		              vaddl_s8(vget_high_s8(b.val[0]), vget_high_s8(b.val[1])));
+		const int8x16_t avg =
+		    vcombine_s8(vmovn_s16(vshrq_n_s16(lo, 2)), vmovn_s16(vshrq_n_s16(hi, 2)));
+		vst1q_u8(&dst[x], vreinterpretq_u8_s8(avg));
+	}
+
+	nsc_subsample_row(&src0[2ull * x], &src1[2ull * x], &dst[x], width - x);
+}
 #endif
 
 void nsc_init_neon(NSC_CONTEXT* context)
@@ -38,6 +140,10 @@ void nsc_init_neon(NSC_CONTEXT* context)
 	if (!IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
 		return;
 
-	WLog_WARN(TAG, "TODO: Implement neon optimized version of this function");
+	PROFILER_RENAME(context->priv->prof_nsc_encode, "nsc_encode_neon")
+	context->encode_row = nsc_encode_row_neon;
+	context->subsample_row = nsc_subsample_row_neon;
+#else
+	WINPR_UNUSED(context);
 #endif
 }
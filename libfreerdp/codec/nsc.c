@@ -355,6 +355,8 @@ NSC_CONTEXT* nsc_context_new(void)
 	context->BitmapData = NULL;
 	context->decode = nsc_decode;
 	context->encode = nsc_encode;
+	context->encode_row = nsc_encode_row;
+	context->subsample_row = nsc_subsample_row;
 
 	PROFILER_CREATE(context->priv->prof_nsc_rle_decompress_data, "nsc_rle_decompress_data")
 	PROFILER_CREATE(context->priv->prof_nsc_decode, "nsc_decode")
@@ -382,9 +384,17 @@ void nsc_context_free(NSC_CONTEXT* context)
 
 	if (context->priv)
 	{
+		winpr_CloseThreadpoolBatch(context->priv->EncodeBatch);
+		winpr_CloseThreadpoolBatch(context->priv->RleBatch);
+
 		for (size_t i = 0; i < 5; i++)
 			winpr_aligned_free(context->priv->PlaneBuffers[i]);
 
+		for (size_t i = 0; i < 4; i++)
+			winpr_aligned_free(context->priv->RleBuffers[i]);
+
+		winpr_aligned_free(context->priv->RowBuffers);
+
 		nsc_profiler_print(context->priv);
 		PROFILER_FREE(context->priv->prof_nsc_rle_decompress_data)
 		PROFILER_FREE(context->priv->prof_nsc_decode)
@@ -424,6 +434,9 @@ BOOL nsc_context_set_parameters(NSC_CONTEXT* WINPR_RESTRICT context, NSC_PARAMET
 		case NSC_COLOR_FORMAT:
 			context->format = value;
 			break;
+		case NSC_THREADING_FLAGS:
+			context->priv->ThreadingFlags = value;
+			break;
 		default:
 			return FALSE;
 	}
@@ -29,6 +29,7 @@
 #include <winpr/cast.h>
 #include <winpr/crt.h>
 
+#include <freerdp/settings.h>
 #include <freerdp/codec/nsc.h>
 #include <freerdp/codec/color.h>
 
@@ -56,37 +57,90 @@ typedef struct
 	UINT8 ChromaSubsamplingLevel;
 } NSC_MESSAGE;
 
+/* Rows converted by one job, a band always holds whole row pairs for the subsampling */
+#define NSC_BAND_HEIGHT 32
+
 static BOOL nsc_write_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RESTRICT s,
                               const NSC_MESSAGE* WINPR_RESTRICT message);
 
+static void CALLBACK nsc_encode_band_work_callback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                                   UINT32 index);
+static void CALLBACK nsc_rle_compress_plane_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                          void* context, UINT32 index);
+
+static INLINE UINT32 nsc_encode_band_count(const NSC_CONTEXT* WINPR_RESTRICT context)
+{
+	return (context->height + NSC_BAND_HEIGHT - 1) / NSC_BAND_HEIGHT;
+}
+
+static INLINE BOOL nsc_encode_use_threads(const NSC_CONTEXT* WINPR_RESTRICT context)
+{
+	const NSC_CONTEXT_PRIV* priv = context->priv;
+
+	if ((priv->ThreadingFlags & THREADING_FLAGS_DISABLE_THREADS) != 0)
+		return FALSE;
+
+	/* a single band is not worth dispatching */
+	return priv->EncodeBatch && priv->RleBatch && (nsc_encode_band_count(context) > 1);
+}
+
+static BOOL nsc_encode_grow_buffer(BYTE** pbuffer, size_t length)
+{
+	BYTE* tmp = (BYTE*)winpr_aligned_recalloc(*pbuffer, length, sizeof(BYTE), 32);
+
+	if (!tmp)
+		return FALSE;
+
+	*pbuffer = tmp;
+	return TRUE;
+}
+
 static BOOL nsc_context_initialize_encode(NSC_CONTEXT* WINPR_RESTRICT context)
 {
-	UINT32 length = 0;
-	UINT32 tempWidth = 0;
-	UINT32 tempHeight = 0;
-	tempWidth = ROUND_UP_TO(context->width, 8);
-	tempHeight = ROUND_UP_TO(context->height, 2);
+	NSC_CONTEXT_PRIV* priv = context->priv;
+	const UINT32 tempWidth = ROUND_UP_TO(context->width, 8);
+	const UINT32 tempHeight = ROUND_UP_TO(context->height, 2);
 	/* The maximum length a decoded plane can reach in all cases */
-	length = tempWidth * tempHeight + 16;
+	const size_t length = 1ull * tempWidth * tempHeight + 16;
 
-	if (length > context->priv->PlaneBuffersLength)
+	if (length > UINT32_MAX)
+		return FALSE;
+
+	/* the buffers only grow, a failed allocation keeps the old length for a retry */
+	if (length > priv->PlaneBuffersLength)
 	{
-		for (int i = 0; i < 5; i++)
+		for (size_t i = 0; i < 4; i++)
 		{
-			BYTE* tmp = (BYTE*)winpr_aligned_recalloc(context->priv->PlaneBuffers[i], length,
-			                                          sizeof(BYTE), 32);
+			if (!nsc_encode_grow_buffer(&priv->PlaneBuffers[i], length))
+				return FALSE;
+		}
 
-			if (!tmp)
-				goto fail;
+		priv->PlaneBuffersLength = (UINT32)length;
+	}
 
-			context->priv->PlaneBuffers[i] = tmp;
+	if (length > priv->RleBuffersLength)
+	{
+		for (size_t i = 0; i < 4; i++)
+		{
+			if (!nsc_encode_grow_buffer(&priv->RleBuffers[i], length))
+				return FALSE;
 		}
 
-		context->priv->PlaneBuffersLength = length;
+		priv->RleBuffersLength = (UINT32)length;
 	}
 
 	if (context->ChromaSubsamplingLevel)
 	{
+		const size_t rows = 4ull * tempWidth * nsc_encode_band_count(context);
+
+		if (rows > priv->RowBuffersLength)
+		{
+			if (!nsc_encode_grow_buffer(&priv->RowBuffers, rows))
+				return FALSE;
+
+			priv->RowBuffersLength = rows;
+		}
+
 		context->OrgByteCount[0] = tempWidth * context->height;
 		context->OrgByteCount[1] = tempWidth * tempHeight / 4;
 		context->OrgByteCount[2] = tempWidth * tempHeight / 4;
@@ -100,235 +154,266 @@ static BOOL nsc_context_initialize_encode(NSC_CONTEXT* WINPR_RESTRICT context)
 		context->OrgByteCount[3] = context->width * context->height;
 	}
 
-	return TRUE;
-fail:
-
-	if (length > context->priv->PlaneBuffersLength)
+	/* The batches run on the default pool and are only created for encoding, decoder contexts
+	 * (e.g. inside ClearCodec) do not need them. */
+	if ((priv->ThreadingFlags & THREADING_FLAGS_DISABLE_THREADS) == 0)
 	{
-		for (int i = 0; i < 5; i++)
-			winpr_aligned_free(context->priv->PlaneBuffers[i]);
+		if (!priv->EncodeBatch)
+			priv->EncodeBatch =
+			    winpr_CreateThreadpoolBatch(nsc_encode_band_work_callback, context, NULL);
+
+		if (!priv->RleBatch)
+			priv->RleBatch =
+			    winpr_CreateThreadpoolBatch(nsc_rle_compress_plane_work_callback, context, NULL);
+
+		if (!priv->EncodeBatch || !priv->RleBatch)
+			return FALSE;
 	}
 
-	return FALSE;
+	return TRUE;
 }
 
-static BOOL nsc_encode_argb_to_aycocg(NSC_CONTEXT* WINPR_RESTRICT context,
-                                      const BYTE* WINPR_RESTRICT data, UINT32 scanline)
+void nsc_encode_row(const NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT src,
+                    BYTE* WINPR_RESTRICT yplane, BYTE* WINPR_RESTRICT coplane,
+                    BYTE* WINPR_RESTRICT cgplane, BYTE* WINPR_RESTRICT aplane, UINT32 width)
 {
-	size_t y = 0;
-	const BYTE* src = NULL;
-	BYTE* yplane = NULL;
-	BYTE* coplane = NULL;
-	BYTE* cgplane = NULL;
-	BYTE* aplane = NULL;
 	INT16 r_val = 0;
 	INT16 g_val = 0;
 	INT16 b_val = 0;
 	BYTE a_val = 0;
 
-	UINT16 tempWidth = ROUND_UP_TO(context->width, 8);
-	const UINT16 rw = (context->ChromaSubsamplingLevel ? tempWidth : context->width);
+	WINPR_ASSERT(context);
 	const BYTE ccl = WINPR_ASSERTING_INT_CAST(BYTE, context->ColorLossLevel);
 
-	for (; y < context->height; y++)
+	for (UINT32 x = 0; x < width; x++)
 	{
-		src = data + (context->height - 1 - y) * scanline;
-		yplane = context->priv->PlaneBuffers[0] + y * rw;
-		coplane = context->priv->PlaneBuffers[1] + y * rw;
-		cgplane = context->priv->PlaneBuffers[2] + y * rw;
-		aplane = context->priv->PlaneBuffers[3] + y * context->width;
-
-		UINT16 x = 0;
-		for (; x < context->width; x++)
+		switch (context->format)
 		{
-			switch (context->format)
+			case PIXEL_FORMAT_BGRX32:
+				b_val = *src++;
+				g_val = *src++;
+				r_val = *src++;
+				src++;
+				a_val = 0xFF;
+				break;
+
+			case PIXEL_FORMAT_BGRA32:
+				b_val = *src++;
+				g_val = *src++;
+				r_val = *src++;
+				a_val = *src++;
+				break;
+
+			case PIXEL_FORMAT_RGBX32:
+				r_val = *src++;
+				g_val = *src++;
+				b_val = *src++;
+				src++;
+				a_val = 0xFF;
+				break;
+
+			case PIXEL_FORMAT_RGBA32:
+				r_val = *src++;
+				g_val = *src++;
+				b_val = *src++;
+				a_val = *src++;
+				break;
+
+			case PIXEL_FORMAT_BGR24:
+				b_val = *src++;
+				g_val = *src++;
+				r_val = *src++;
+				a_val = 0xFF;
+				break;
+
+			case PIXEL_FORMAT_RGB24:
+				r_val = *src++;
+				g_val = *src++;
+				b_val = *src++;
+				a_val = 0xFF;
+				break;
+
+			case PIXEL_FORMAT_BGR16:
+				b_val = (INT16)(((*(src + 1)) & 0xF8) | ((*(src + 1)) >> 5));
+				g_val = (INT16)((((*(src + 1)) & 0x07) << 5) | (((*src) & 0xE0) >> 3));
+				r_val = (INT16)((((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07));
+				a_val = 0xFF;
+				src += 2;
+				break;
+
+			case PIXEL_FORMAT_RGB16:
+				r_val = (INT16)(((*(src + 1)) & 0xF8) | ((*(src + 1)) >> 5));
+				g_val = (INT16)((((*(src + 1)) & 0x07) << 5) | (((*src) & 0xE0) >> 3));
+				b_val = (INT16)((((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07));
+				a_val = 0xFF;
+				src += 2;
+				break;
+
+			case PIXEL_FORMAT_A4:
 			{
-				case PIXEL_FORMAT_BGRX32:
-					b_val = *src++;
-					g_val = *src++;
-					r_val = *src++;
-					src++;
-					a_val = 0xFF;
-					break;
-
-				case PIXEL_FORMAT_BGRA32:
-					b_val = *src++;
-					g_val = *src++;
-					r_val = *src++;
-					a_val = *src++;
-					break;
-
-				case PIXEL_FORMAT_RGBX32:
-					r_val = *src++;
-					g_val = *src++;
-					b_val = *src++;
-					src++;
-					a_val = 0xFF;
-					break;
-
-				case PIXEL_FORMAT_RGBA32:
-					r_val = *src++;
-					g_val = *src++;
-					b_val = *src++;
-					a_val = *src++;
-					break;
-
-				case PIXEL_FORMAT_BGR24:
-					b_val = *src++;
-					g_val = *src++;
-					r_val = *src++;
-					a_val = 0xFF;
-					break;
-
-				case PIXEL_FORMAT_RGB24:
-					r_val = *src++;
-					g_val = *src++;
-					b_val = *src++;
-					a_val = 0xFF;
-					break;
-
-				case PIXEL_FORMAT_BGR16:
-					b_val = (INT16)(((*(src + 1)) & 0xF8) | ((*(src + 1)) >> 5));
-					g_val = (INT16)((((*(src + 1)) & 0x07) << 5) | (((*src) & 0xE0) >> 3));
-					r_val = (INT16)((((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07));
-					a_val = 0xFF;
-					src += 2;
-					break;
-
-				case PIXEL_FORMAT_RGB16:
-					r_val = (INT16)(((*(src + 1)) & 0xF8) | ((*(src + 1)) >> 5));
-					g_val = (INT16)((((*(src + 1)) & 0x07) << 5) | (((*src) & 0xE0) >> 3));
-					b_val = (INT16)((((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07));
-					a_val = 0xFF;
-					src += 2;
-					break;
-
-				case PIXEL_FORMAT_A4:
-				{
-					int shift = 0;
-					BYTE idx = 0;
-					shift = (7 - (x % 8));
-					idx = ((*src) >> shift) & 1;
-					idx |= (((*(src + 1)) >> shift) & 1) << 1;
-					idx |= (((*(src + 2)) >> shift) & 1) << 2;
-					idx |= (((*(src + 3)) >> shift) & 1) << 3;
-					idx *= 3;
-					r_val = (INT16)context->palette[idx];
-					g_val = (INT16)context->palette[idx + 1];
-					b_val = (INT16)context->palette[idx + 2];
-
-					if (shift == 0)
-						src += 4;
-				}
-
-					a_val = 0xFF;
-					break;
-
-				case PIXEL_FORMAT_RGB8:
-				{
-					int idx = (*src) * 3;
-					r_val = (INT16)context->palette[idx];
-					g_val = (INT16)context->palette[idx + 1];
-					b_val = (INT16)context->palette[idx + 2];
-					src++;
-				}
-
-					a_val = 0xFF;
-					break;
-
-				default:
-					r_val = g_val = b_val = a_val = 0;
-					break;
+				int shift = 0;
+				BYTE idx = 0;
+				shift = (7 - (x % 8));
+				idx = ((*src) >> shift) & 1;
+				idx |= (((*(src + 1)) >> shift) & 1) << 1;
+				idx |= (((*(src + 2)) >> shift) & 1) << 2;
+				idx |= (((*(src + 3)) >> shift) & 1) << 3;
+				idx *= 3;
+				r_val = (INT16)context->palette[idx];
+				g_val = (INT16)context->palette[idx + 1];
+				b_val = (INT16)context->palette[idx + 2];
+
+				if (shift == 0)
+					src += 4;
 			}
 
-			*yplane++ = (BYTE)((r_val >> 2) + (g_val >> 1) + (b_val >> 2));
-			/* Perform color loss reduction here */
-			*coplane++ = (BYTE)((r_val - b_val) >> ccl);
-			*cgplane++ = (BYTE)((-(r_val >> 1) + g_val - (b_val >> 1)) >> ccl);
-			*aplane++ = a_val;
-		}
+				a_val = 0xFF;
+				break;
 
-		if (context->ChromaSubsamplingLevel && (x % 2) == 1)
-		{
-			*yplane = *(yplane - 1);
-			*coplane = *(coplane - 1);
-			*cgplane = *(cgplane - 1);
+			case PIXEL_FORMAT_RGB8:
+			{
+				int idx = (*src) * 3;
+				r_val = (INT16)context->palette[idx];
+				g_val = (INT16)context->palette[idx + 1];
+				b_val = (INT16)context->palette[idx + 2];
+				src++;
+			}
+
+				a_val = 0xFF;
+				break;
+
+			default:
+				r_val = g_val = b_val = a_val = 0;
+				break;
 		}
+
+		*yplane++ = (BYTE)((r_val >> 2) + (g_val >> 1) + (b_val >> 2));
+		/* Perform color loss reduction here */
+		*coplane++ = (BYTE)((r_val - b_val) >> ccl);
+		*cgplane++ = (BYTE)((-(r_val >> 1) + g_val - (b_val >> 1)) >> ccl);
+		*aplane++ = a_val;
 	}
+}
 
-	if (context->ChromaSubsamplingLevel && (y % 2) == 1)
+void nsc_subsample_row(const BYTE* WINPR_RESTRICT src0, const BYTE* WINPR_RESTRICT src1,
+                       BYTE* WINPR_RESTRICT dst, UINT32 width)
+{
+	for (UINT32 x = 0; x < width; x++)
 	{
-		yplane = context->priv->PlaneBuffers[0] + y * rw;
-		coplane = context->priv->PlaneBuffers[1] + y * rw;
-		cgplane = context->priv->PlaneBuffers[2] + y * rw;
-		CopyMemory(yplane, yplane - rw, rw);
-		CopyMemory(coplane, coplane - rw, rw);
-		CopyMemory(cgplane, cgplane - rw, rw);
+		const INT16 sum = (INT16)((INT8)src0[2 * x] + (INT8)src0[2 * x + 1] + (INT8)src1[2 * x] +
+		                          (INT8)src1[2 * x + 1]);
+		dst[x] = (BYTE)(sum >> 2);
 	}
+}
 
-	return TRUE;
+static INLINE const BYTE* nsc_encode_src_row(const NSC_CONTEXT* WINPR_RESTRICT context, UINT32 y)
+{
+	/* the bitmap is bottom up */
+	return &context->priv->EncodeData[1ull * (context->height - 1 - y) *
+	                                  context->priv->EncodeStride];
 }
 
-static BOOL nsc_encode_subsampling(NSC_CONTEXT* WINPR_RESTRICT context)
+/* The columns up to the next multiple of 8 repeat the last pixel. The decoder averages the
+ * first of them into the last chroma sample of odd widths, the others compress well. */
+static INLINE void nsc_encode_pad_row(BYTE* WINPR_RESTRICT row, UINT32 width, UINT32 tempWidth)
 {
-	UINT32 tempWidth = 0;
-	UINT32 tempHeight = 0;
+	if (width < tempWidth)
+		memset(&row[width], row[width - 1], tempWidth - width);
+}
 
-	if (!context)
-		return FALSE;
+static void nsc_encode_band(NSC_CONTEXT* WINPR_RESTRICT context, UINT32 band)
+{
+	NSC_CONTEXT_PRIV* priv = context->priv;
+	const UINT32 width = context->width;
+	const UINT32 height = context->height;
+	const UINT32 first = band * NSC_BAND_HEIGHT;
+	const UINT32 last = MIN(first + NSC_BAND_HEIGHT, height);
 
-	tempWidth = ROUND_UP_TO(context->width, 8);
-	tempHeight = ROUND_UP_TO(context->height, 2);
+	if (!context->ChromaSubsamplingLevel)
+	{
+		for (UINT32 y = first; y < last; y++)
+		{
+			const size_t offset = 1ull * y * width;
+			context->encode_row(context, nsc_encode_src_row(context, y),
+			                    &priv->PlaneBuffers[0][offset], &priv->PlaneBuffers[1][offset],
+			                    &priv->PlaneBuffers[2][offset], &priv->PlaneBuffers[3][offset],
+			                    width);
+		}
 
-	if (tempHeight == 0)
-		return FALSE;
+		return;
+	}
 
-	if (tempWidth > context->priv->PlaneBuffersLength / tempHeight)
-		return FALSE;
+	/* the full resolution chroma of a row pair only lives in the band's row buffers */
+	const UINT32 tempWidth = ROUND_UP_TO(width, 8);
+	BYTE* co[2] = { &priv->RowBuffers[4ull * tempWidth * band],
+		            &priv->RowBuffers[4ull * tempWidth * band + tempWidth] };
+	BYTE* cg[2] = { &priv->RowBuffers[4ull * tempWidth * band + 2ull * tempWidth],
+		            &priv->RowBuffers[4ull * tempWidth * band + 3ull * tempWidth] };
 
-	for (size_t y = 0; y < tempHeight >> 1; y++)
+	for (UINT32 y = first; y < last; y += 2)
 	{
-		BYTE* co_dst = context->priv->PlaneBuffers[1] + y * (tempWidth >> 1);
-		BYTE* cg_dst = context->priv->PlaneBuffers[2] + y * (tempWidth >> 1);
-		const INT8* co_src0 = (INT8*)context->priv->PlaneBuffers[1] + (y << 1) * tempWidth;
-		const INT8* co_src1 = co_src0 + tempWidth;
-		const INT8* cg_src0 = (INT8*)context->priv->PlaneBuffers[2] + (y << 1) * tempWidth;
-		const INT8* cg_src1 = cg_src0 + tempWidth;
-
-		for (UINT32 x = 0; x < tempWidth >> 1; x++)
+		/* an odd last row is subsampled with itself */
+		const UINT32 rows = MIN(2, height - y);
+
+		for (UINT32 r = 0; r < rows; r++)
 		{
-			*co_dst++ = (BYTE)(((INT16)*co_src0 + (INT16) * (co_src0 + 1) + (INT16)*co_src1 +
-			                    (INT16) * (co_src1 + 1)) >>
-			                   2);
-			*cg_dst++ = (BYTE)(((INT16)*cg_src0 + (INT16) * (cg_src0 + 1) + (INT16)*cg_src1 +
-			                    (INT16) * (cg_src1 + 1)) >>
-			                   2);
-			co_src0 += 2;
-			co_src1 += 2;
-			cg_src0 += 2;
-			cg_src1 += 2;
+			BYTE* yplane = &priv->PlaneBuffers[0][1ull * (y + r) * tempWidth];
+			context->encode_row(context, nsc_encode_src_row(context, y + r), yplane, co[r],
+			                    cg[r], &priv->PlaneBuffers[3][1ull * (y + r) * width], width);
+			nsc_encode_pad_row(yplane, width, tempWidth);
+			nsc_encode_pad_row(co[r], width, tempWidth);
+			nsc_encode_pad_row(cg[r], width, tempWidth);
 		}
+
+		const size_t offset = 1ull * (y / 2) * (tempWidth / 2);
+		context->subsample_row(co[0], co[rows - 1], &priv->PlaneBuffers[1][offset],
+		                       tempWidth / 2);
+		context->subsample_row(cg[0], cg[rows - 1], &priv->PlaneBuffers[2][offset],
+		                       tempWidth / 2);
 	}
+}
 
-	return TRUE;
+static void CALLBACK nsc_encode_band_work_callback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                                   UINT32 index)
+{
+	NSC_CONTEXT* nsc = (NSC_CONTEXT*)context;
+	WINPR_UNUSED(instance);
+	WINPR_ASSERT(nsc);
+	WINPR_ASSERT(index < nsc_encode_band_count(nsc));
+
+	nsc_encode_band(nsc, index);
 }
 
 BOOL nsc_encode(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT bmpdata,
                 UINT32 rowstride)
 {
+	BOOL rc = TRUE;
+
 	if (!context || !bmpdata || (rowstride == 0))
 		return FALSE;
 
-	if (!nsc_encode_argb_to_aycocg(context, bmpdata, rowstride))
-		return FALSE;
+	NSC_CONTEXT_PRIV* priv = context->priv;
+	const UINT32 bands = nsc_encode_band_count(context);
 
-	if (context->ChromaSubsamplingLevel)
+	priv->EncodeData = bmpdata;
+	priv->EncodeStride = rowstride;
+
+	/* ARGB to AYCoCg conversion, chroma subsampling and colorloss reduction, band by band */
+	if (nsc_encode_use_threads(context))
 	{
-		if (!nsc_encode_subsampling(context))
-			return FALSE;
+		if (!winpr_SubmitThreadpoolBatch(priv->EncodeBatch, bands))
+			rc = FALSE;
+		else
+			winpr_WaitForThreadpoolBatchCallbacks(priv->EncodeBatch);
+	}
+	else
+	{
+		for (UINT32 band = 0; band < bands; band++)
+			nsc_encode_band(context, band);
 	}
 
-	return TRUE;
+	priv->EncodeData = NULL;
+	return rc;
 }
 
 static UINT32 nsc_rle_encode(const BYTE* WINPR_RESTRICT in, BYTE* WINPR_RESTRICT out,
@@ -387,33 +472,51 @@ static UINT32 nsc_rle_encode(const BYTE* WINPR_RESTRICT in, BYTE* WINPR_RESTRICT
 	return planeSize;
 }
 
-static void nsc_rle_compress_data(NSC_CONTEXT* WINPR_RESTRICT context)
+static void nsc_rle_compress_plane(NSC_CONTEXT* WINPR_RESTRICT context, UINT32 plane)
 {
 	UINT32 planeSize = 0;
-	UINT32 originalSize = 0;
+	const UINT32 originalSize = context->OrgByteCount[plane];
 
-	for (UINT16 i = 0; i < 4; i++)
+	if (originalSize > 0)
 	{
-		originalSize = context->OrgByteCount[i];
+		planeSize = nsc_rle_encode(context->priv->PlaneBuffers[plane],
+		                           context->priv->RleBuffers[plane], originalSize);
 
-		if (originalSize == 0)
-		{
-			planeSize = 0;
-		}
-		else
-		{
-			planeSize = nsc_rle_encode(context->priv->PlaneBuffers[i],
-			                           context->priv->PlaneBuffers[4], originalSize);
-
-			if (planeSize < originalSize)
-				CopyMemory(context->priv->PlaneBuffers[i], context->priv->PlaneBuffers[4],
-				           planeSize);
-			else
-				planeSize = originalSize;
-		}
+		/* a plane that does not compress is sent as it is */
+		if (planeSize >= originalSize)
+			planeSize = originalSize;
+	}
+
+	context->PlaneByteCount[plane] = planeSize;
+}
 
-		context->PlaneByteCount[i] = planeSize;
+static void CALLBACK nsc_rle_compress_plane_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                          void* context, UINT32 index)
+{
+	NSC_CONTEXT* nsc = (NSC_CONTEXT*)context;
+	WINPR_UNUSED(instance);
+	WINPR_ASSERT(nsc);
+	WINPR_ASSERT(index < 4);
+
+	nsc_rle_compress_plane(nsc, index);
+}
+
+static BOOL nsc_rle_compress_data(NSC_CONTEXT* WINPR_RESTRICT context)
+{
+	/* every plane is a single RLE stream, the planes are compressed in parallel */
+	if (nsc_encode_use_threads(context))
+	{
+		if (!winpr_SubmitThreadpoolBatch(context->priv->RleBatch, 4))
+			return FALSE;
+
+		winpr_WaitForThreadpoolBatchCallbacks(context->priv->RleBatch);
+		return TRUE;
 	}
+
+	for (UINT32 i = 0; i < 4; i++)
+		nsc_rle_compress_plane(context, i);
+
+	return TRUE;
 }
 
 static UINT32 nsc_compute_byte_count(NSC_CONTEXT* WINPR_RESTRICT context,
@@ -497,7 +600,6 @@ BOOL nsc_compose_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RES
 	if (!nsc_context_initialize_encode(context))
 		return FALSE;
 
-	/* ARGB to AYCoCg conversion, chroma subsampling and colorloss reduction */
 	PROFILER_ENTER(context->priv->prof_nsc_encode)
 	rc = context->encode(context, data, scanline);
 	PROFILER_EXIT(context->priv->prof_nsc_encode)
@@ -506,12 +608,19 @@ BOOL nsc_compose_message(NSC_CONTEXT* WINPR_RESTRICT context, wStream* WINPR_RES
 
 	/* RLE encode */
 	PROFILER_ENTER(context->priv->prof_nsc_rle_compress_data)
-	nsc_rle_compress_data(context);
+	rc = nsc_rle_compress_data(context);
 	PROFILER_EXIT(context->priv->prof_nsc_rle_compress_data)
-	message.PlaneBuffers[0] = context->priv->PlaneBuffers[0];
-	message.PlaneBuffers[1] = context->priv->PlaneBuffers[1];
-	message.PlaneBuffers[2] = context->priv->PlaneBuffers[2];
-	message.PlaneBuffers[3] = context->priv->PlaneBuffers[3];
+	if (!rc)
+		return FALSE;
+
+	for (size_t i = 0; i < 4; i++)
+	{
+		if (context->PlaneByteCount[i] < context->OrgByteCount[i])
+			message.PlaneBuffers[i] = context->priv->RleBuffers[i];
+		else
+			message.PlaneBuffers[i] = context->priv->PlaneBuffers[i];
+	}
+
 	message.LumaPlaneByteCount = context->PlaneByteCount[0];
 	message.OrangeChromaPlaneByteCount = context->PlaneByteCount[1];
 	message.GreenChromaPlaneByteCount = context->PlaneByteCount[2];
@@ -23,8 +23,17 @@
 #define FREERDP_LIB_CODEC_NSC_ENCODE_H
 
 #include <freerdp/api.h>
+#include <freerdp/codec/nsc.h>
 
 FREERDP_LOCAL BOOL nsc_encode(NSC_CONTEXT* WINPR_RESTRICT context,
                               const BYTE* WINPR_RESTRICT bmpdata, UINT32 rowstride);
 
+FREERDP_LOCAL void nsc_encode_row(const NSC_CONTEXT* WINPR_RESTRICT context,
+                                  const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT yplane,
+                                  BYTE* WINPR_RESTRICT coplane, BYTE* WINPR_RESTRICT cgplane,
+                                  BYTE* WINPR_RESTRICT aplane, UINT32 width);
+FREERDP_LOCAL void nsc_subsample_row(const BYTE* WINPR_RESTRICT src0,
+                                     const BYTE* WINPR_RESTRICT src1, BYTE* WINPR_RESTRICT dst,
+                                     UINT32 width);
+
 #endif /* FREERDP_LIB_CODEC_NSC_ENCODE_H */
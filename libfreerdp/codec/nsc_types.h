@@ -28,6 +28,7 @@
 #include <winpr/crt.h>
 #include <winpr/wlog.h>
 #include <winpr/collections.h>
+#include <winpr/pool.h>
 
 #include <freerdp/utils/profiler.h>
 #include <freerdp/codec/nsc.h>
@@ -45,6 +46,17 @@ typedef struct
 	BYTE* PlaneBuffers[5];     /* Decompressed Plane Buffers in the respective order */
 	UINT32 PlaneBuffersLength; /* Lengths of each plane buffer */
 
+	/* encoder */
+	BYTE* RleBuffers[4];       /* RLE encoded planes, each plane is compressed separately */
+	UINT32 RleBuffersLength;   /* Lengths of each RLE buffer */
+	BYTE* RowBuffers;          /* Full resolution chroma rows of each band for subsampling */
+	size_t RowBuffersLength;
+	UINT32 ThreadingFlags;
+	PTP_BATCH EncodeBatch; /* converts one band of rows per job */
+	PTP_BATCH RleBatch;    /* compresses one plane per job */
+	const BYTE* EncodeData;
+	UINT32 EncodeStride;
+
 	/* profilers */
 	PROFILER_DEFINE(prof_nsc_rle_decompress_data)
 	PROFILER_DEFINE(prof_nsc_decode)
@@ -75,6 +87,13 @@ struct S_NSC_CONTEXT
 	BOOL(*encode)
 	(NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT BitmapData, UINT32 rowstride);
 
+	/* AYCoCg conversion of width pixels and 2x2 chroma subsampling of one row pair */
+	void (*encode_row)(const NSC_CONTEXT* WINPR_RESTRICT context, const BYTE* WINPR_RESTRICT src,
+	                   BYTE* WINPR_RESTRICT yplane, BYTE* WINPR_RESTRICT coplane,
+	                   BYTE* WINPR_RESTRICT cgplane, BYTE* WINPR_RESTRICT aplane, UINT32 width);
+	void (*subsample_row)(const BYTE* WINPR_RESTRICT src0, const BYTE* WINPR_RESTRICT src1,
+	                      BYTE* WINPR_RESTRICT dst, UINT32 width);
+
 	NSC_CONTEXT_PRIV* priv;
 };
 
@@ -92,6 +92,9 @@ struct S_BITMAP_PLANAR_CONTEXT
 	BYTE* pTempData;
 	UINT32 nTempStep;
 
+	BYTE* rowsBuffer;
+	size_t rowsBufferSize;
+
 	BOOL bgr;
 	BOOL topdown;
 };
@@ -227,389 +230,180 @@ static INLINE INT32 planar_skip_plane_rle(const BYTE* WINPR_RESTRICT pSrcData, U
 	return (INT32)used;
 }
 
-static inline UINT8 clamp(INT16 val)
-{
-	return (UINT8)val;
-}
-
-static INLINE INT32 planar_decompress_plane_rle_only(const BYTE* WINPR_RESTRICT pSrcData,
-                                                     UINT32 SrcSize, BYTE* WINPR_RESTRICT pDstData,
-                                                     UINT32 nWidth, UINT32 nHeight)
+/* Expand the control bytes of a scanline. A run repeats the last byte before it, which may be
+ * from an earlier segment of the scanline, and 0 at the start of the scanline. */
+static INLINE BOOL planar_rle_expand_line(const BYTE** WINPR_RESTRICT ppSrc,
+                                          const BYTE* WINPR_RESTRICT pEnd,
+                                          BYTE* WINPR_RESTRICT pDst, UINT32 nWidth)
 {
-	BYTE* previousScanline = NULL;
-	const BYTE* srcp = pSrcData;
+	const BYTE* srcp = *ppSrc;
+	BYTE value = 0;
 
-	WINPR_ASSERT(nHeight <= INT32_MAX);
-	WINPR_ASSERT(nWidth <= INT32_MAX);
-
-	for (UINT32 y = 0; y < nHeight; y++)
+	for (UINT32 x = 0; x < nWidth;)
 	{
-		BYTE* dstp = &pDstData[1ULL * (y)*nWidth];
-		BYTE pixel = 0;
-		BYTE* currentScanline = dstp;
-
-		for (UINT32 x = 0; x < nWidth;)
+		if (srcp >= pEnd)
 		{
-			BYTE controlByte = *srcp;
-			srcp++;
-
-			if ((srcp - pSrcData) > SrcSize * 1ll)
-			{
-				WLog_ERR(TAG, "error reading input buffer");
-				return -1;
-			}
+			WLog_ERR(TAG, "error reading input buffer");
+			return FALSE;
+		}
 
-			UINT32 nRunLength = PLANAR_CONTROL_BYTE_RUN_LENGTH(controlByte);
-			UINT32 cRawBytes = PLANAR_CONTROL_BYTE_RAW_BYTES(controlByte);
+		const BYTE controlByte = *srcp++;
+		UINT32 nRunLength = PLANAR_CONTROL_BYTE_RUN_LENGTH(controlByte);
+		UINT32 cRawBytes = PLANAR_CONTROL_BYTE_RAW_BYTES(controlByte);
 
-			if (nRunLength == 1)
-			{
-				nRunLength = cRawBytes + 16;
-				cRawBytes = 0;
-			}
-			else if (nRunLength == 2)
-			{
-				nRunLength = cRawBytes + 32;
-				cRawBytes = 0;
-			}
+		if (nRunLength == 1)
+		{
+			nRunLength = cRawBytes + 16;
+			cRawBytes = 0;
+		}
+		else if (nRunLength == 2)
+		{
+			nRunLength = cRawBytes + 32;
+			cRawBytes = 0;
+		}
 
-			if (((dstp + (cRawBytes + nRunLength)) - currentScanline) > nWidth * 1ll)
-			{
-				WLog_ERR(TAG, "too many pixels in scanline");
-				return -1;
-			}
+		if (cRawBytes + nRunLength > nWidth - x)
+		{
+			WLog_ERR(TAG, "too many pixels in scanline");
+			return FALSE;
+		}
 
-			if (!previousScanline)
+		if (cRawBytes > 0)
+		{
+			if (cRawBytes > (size_t)(pEnd - srcp))
 			{
-				/* first scanline, absolute values */
-				while (cRawBytes > 0)
-				{
-					pixel = *srcp;
-					srcp++;
-					*dstp = pixel;
-					dstp++;
-					x++;
-					cRawBytes--;
-				}
-
-				while (nRunLength > 0)
-				{
-					*dstp = pixel;
-					dstp++;
-					x++;
-					nRunLength--;
-				}
+				WLog_ERR(TAG, "error reading input buffer");
+				return FALSE;
 			}
-			else
-			{
-				/* delta values relative to previous scanline */
-				INT16 p = 0;
-				while (cRawBytes > 0)
-				{
-					UINT8 deltaValue = *srcp;
-					srcp++;
-
-					if (deltaValue & 1)
-					{
-						deltaValue = deltaValue >> 1;
-						deltaValue = deltaValue + 1;
-						p = WINPR_ASSERTING_INT_CAST(int16_t, -1 * (int16_t)deltaValue);
-					}
-					else
-					{
-						deltaValue = deltaValue >> 1;
-						p = WINPR_ASSERTING_INT_CAST(INT16, deltaValue);
-					}
-
-					const INT16 delta = WINPR_ASSERTING_INT_CAST(int16_t, previousScanline[x] + p);
-					*dstp = clamp(delta);
-					dstp++;
-					x++;
-					cRawBytes--;
-				}
 
-				while (nRunLength > 0)
-				{
-					const INT16 deltaValue =
-					    WINPR_ASSERTING_INT_CAST(int16_t, previousScanline[x] + p);
-					*dstp = clamp(deltaValue);
-					dstp++;
-					x++;
-					nRunLength--;
-				}
-			}
+			memcpy(&pDst[x], srcp, cRawBytes);
+			srcp += cRawBytes;
+			x += cRawBytes;
+			value = pDst[x - 1];
 		}
 
-		previousScanline = currentScanline;
+		memset(&pDst[x], value, nRunLength);
+		x += nRunLength;
 	}
 
-	return (INT32)(srcp - pSrcData);
+	*ppSrc = srcp;
+	return TRUE;
 }
 
-static INLINE INT32 planar_decompress_plane_rle(const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
-                                                BYTE* WINPR_RESTRICT pDstData, UINT32 nDstStep,
-                                                UINT32 nXDst, UINT32 nYDst, UINT32 nWidth,
-                                                UINT32 nHeight, UINT32 nChannel, BOOL vFlip)
+static INLINE INT32 planar_decompress_plane_rle_only(const primitives_t* WINPR_RESTRICT prims,
+                                                     const BYTE* WINPR_RESTRICT pSrcData,
+                                                     UINT32 SrcSize, BYTE* WINPR_RESTRICT pDstData,
+                                                     UINT32 nWidth, UINT32 nHeight)
 {
-	INT32 beg = 0;
-	INT32 end = 0;
-	INT32 inc = 0;
-	BYTE* previousScanline = NULL;
 	const BYTE* srcp = pSrcData;
 
+	WINPR_ASSERT(prims);
 	WINPR_ASSERT(nHeight <= INT32_MAX);
 	WINPR_ASSERT(nWidth <= INT32_MAX);
-	WINPR_ASSERT(nDstStep <= INT32_MAX);
-
-	previousScanline = NULL;
 
-	if (vFlip)
-	{
-		beg = (INT32)nHeight - 1;
-		end = -1;
-		inc = -1;
-	}
-	else
-	{
-		beg = 0;
-		end = (INT32)nHeight;
-		inc = 1;
-	}
-
-	for (INT32 y = beg; y != end; y += inc)
+	for (UINT32 y = 0; y < nHeight; y++)
 	{
-		const intptr_t off = ((1LL * nYDst + y) * nDstStep) + (4LL * nXDst) + nChannel * 1LL;
-		BYTE* dstp = &pDstData[off];
-		BYTE* currentScanline = dstp;
-		INT16 pixel = 0;
+		BYTE* currentScanline = &pDstData[1ULL * y * nWidth];
 
-		for (INT32 x = 0; x < (INT32)nWidth;)
-		{
-			const BYTE controlByte = *srcp;
-			srcp++;
-
-			if ((srcp - pSrcData) > SrcSize * 1ll)
-			{
-				WLog_ERR(TAG, "error reading input buffer");
-				return -1;
-			}
-
-			UINT32 nRunLength = PLANAR_CONTROL_BYTE_RUN_LENGTH(controlByte);
-			UINT32 cRawBytes = PLANAR_CONTROL_BYTE_RAW_BYTES(controlByte);
-
-			if (nRunLength == 1)
-			{
-				nRunLength = cRawBytes + 16;
-				cRawBytes = 0;
-			}
-			else if (nRunLength == 2)
-			{
-				nRunLength = cRawBytes + 32;
-				cRawBytes = 0;
-			}
+		if (!planar_rle_expand_line(&srcp, &pSrcData[SrcSize], currentScanline, nWidth))
+			return -1;
 
-			if (((dstp + (cRawBytes + nRunLength)) - currentScanline) > nWidth * 4ll)
-			{
-				WLog_ERR(TAG, "too many pixels in scanline");
-				return -1;
-			}
+		/* the first scanline holds absolute values, the others deltas to the previous one */
+		if (y > 0)
+			prims->planar_delta_decode(currentScanline - nWidth, currentScanline, nWidth);
+	}
 
-			if (!previousScanline)
-			{
-				/* first scanline, absolute values */
-				while (cRawBytes > 0)
-				{
-					pixel = *srcp;
-					srcp++;
-					*dstp = WINPR_ASSERTING_INT_CAST(BYTE, pixel);
-					dstp += 4;
-					x++;
-					cRawBytes--;
-				}
+	return (INT32)(srcp - pSrcData);
+}
 
-				while (nRunLength > 0)
-				{
-					*dstp = WINPR_ASSERTING_INT_CAST(BYTE, pixel);
-					dstp += 4;
-					x++;
-					nRunLength--;
-				}
-			}
-			else
-			{
-				/* delta values relative to previous scanline */
-				while (cRawBytes > 0)
-				{
-					BYTE deltaValue = *srcp;
-					srcp++;
-
-					if (deltaValue & 1)
-					{
-						deltaValue = deltaValue >> 1;
-						deltaValue = deltaValue + 1;
-						pixel = WINPR_ASSERTING_INT_CAST(int16_t, -deltaValue);
-					}
-					else
-					{
-						deltaValue = deltaValue >> 1;
-						pixel = deltaValue;
-					}
-
-					const INT16 delta =
-					    WINPR_ASSERTING_INT_CAST(int16_t, previousScanline[4LL * x] + pixel);
-					*dstp = clamp(delta);
-					dstp += 4;
-					x++;
-					cRawBytes--;
-				}
+static BOOL planar_ensure_rows_buffer(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar, UINT32 nWidth)
+{
+	const size_t size = 8ull * nWidth;
 
-				while (nRunLength > 0)
-				{
-					const INT16 deltaValue =
-					    WINPR_ASSERTING_INT_CAST(int16_t, pixel + previousScanline[4LL * x]);
-					*dstp = clamp(deltaValue);
-					dstp += 4;
-					x++;
-					nRunLength--;
-				}
-			}
-		}
+	if (planar->rowsBufferSize >= size)
+		return TRUE;
 
-		previousScanline = currentScanline;
-	}
+	BYTE* tmp = winpr_aligned_recalloc(planar->rowsBuffer, size, 1, 32);
+	if (!tmp)
+		return FALSE;
 
-	return (INT32)(srcp - pSrcData);
+	planar->rowsBuffer = tmp;
+	planar->rowsBufferSize = size;
+	return TRUE;
 }
 
-static INLINE INT32 planar_set_plane(BYTE bValue, BYTE* pDstData, UINT32 nDstStep, UINT32 nXDst,
-                                     UINT32 nYDst, UINT32 nWidth, UINT32 nHeight, UINT32 nChannel,
-                                     BOOL vFlip)
+/* The RLE planes are decoded in lockstep, one scanline of each plane at a time, and merged into
+ * 32bpp pixels with red, green and blue at byte 2, 1 and 0. */
+static BOOL planar_decompress_planes_rle(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
+                                         const primitives_t* WINPR_RESTRICT prims,
+                                         const BYTE* WINPR_RESTRICT planes[4],
+                                         const INT32 rleSizes[4], BOOL useAlpha,
+                                         BYTE* WINPR_RESTRICT pDstData, UINT32 nDstStep,
+                                         UINT32 nXDst, UINT32 nYDst, UINT32 nWidth,
+                                         UINT32 nHeight, BOOL vFlip)
 {
-	INT32 beg = 0;
-	INT32 end = 0;
-	INT32 inc = 0;
-
+	WINPR_ASSERT(planar);
+	WINPR_ASSERT(prims);
 	WINPR_ASSERT(nHeight <= INT32_MAX);
 	WINPR_ASSERT(nWidth <= INT32_MAX);
 	WINPR_ASSERT(nDstStep <= INT32_MAX);
 
-	if (vFlip)
-	{
-		beg = (INT32)nHeight - 1;
-		end = -1;
-		inc = -1;
-	}
-	else
-	{
-		beg = 0;
-		end = (INT32)nHeight;
-		inc = 1;
-	}
+	if (!planar_ensure_rows_buffer(planar, nWidth))
+		return FALSE;
 
-	for (INT32 y = beg; y != end; y += inc)
-	{
-		const intptr_t off = ((1LL * nYDst + y) * nDstStep) + (4LL * nXDst) + nChannel * 1LL;
-		BYTE* dstp = &pDstData[off];
+	/* planes are red, green, blue and alpha, the scanlines alpha, red, green and blue */
+	const size_t order[4] = { 3, 0, 1, 2 };
+	const UINT32 format = useAlpha ? PIXEL_FORMAT_BGRA32 : PIXEL_FORMAT_BGRX32;
+	const size_t first = useAlpha ? 0 : 1;
+	const BYTE* srcp[4] = { 0 };
+	const BYTE* end[4] = { 0 };
+	BYTE* current[4] = { 0 };
+	BYTE* previous[4] = { 0 };
 
-		for (INT32 x = 0; x < (INT32)nWidth; ++x)
-		{
-			*dstp = bValue;
-			dstp += 4;
-		}
+	for (size_t c = first; c < 4; c++)
+	{
+		srcp[c] = planes[order[c]];
+		end[c] = srcp[c] + rleSizes[order[c]];
+		current[c] = &planar->rowsBuffer[2ull * c * nWidth];
+		previous[c] = current[c] + nWidth;
 	}
 
-	return 0;
-}
-
-static INLINE BOOL writeLine(BYTE** WINPR_RESTRICT ppRgba, UINT32 DstFormat, UINT32 width,
-                             const BYTE** WINPR_RESTRICT ppR, const BYTE** WINPR_RESTRICT ppG,
-                             const BYTE** WINPR_RESTRICT ppB, const BYTE** WINPR_RESTRICT ppA)
-{
-	WINPR_ASSERT(ppRgba);
-	WINPR_ASSERT(ppR);
-	WINPR_ASSERT(ppG);
-	WINPR_ASSERT(ppB);
-
-	switch (DstFormat)
+	for (UINT32 y = 0; y < nHeight; y++)
 	{
-		case PIXEL_FORMAT_BGRA32:
-			for (UINT32 x = 0; x < width; x++)
-			{
-				*(*ppRgba)++ = *(*ppB)++;
-				*(*ppRgba)++ = *(*ppG)++;
-				*(*ppRgba)++ = *(*ppR)++;
-				*(*ppRgba)++ = *(*ppA)++;
-			}
-
-			return TRUE;
-
-		case PIXEL_FORMAT_BGRX32:
-			for (UINT32 x = 0; x < width; x++)
-			{
-				*(*ppRgba)++ = *(*ppB)++;
-				*(*ppRgba)++ = *(*ppG)++;
-				*(*ppRgba)++ = *(*ppR)++;
-				*(*ppRgba)++ = 0xFF;
-			}
+		const UINT32 line = vFlip ? nHeight - 1 - y : y;
+		BYTE* dst = &pDstData[(1ULL * nYDst + line) * nDstStep + 4ULL * nXDst];
 
-			return TRUE;
+		for (size_t c = first; c < 4; c++)
+		{
+			BYTE* tmp = previous[c];
+			previous[c] = current[c];
+			current[c] = tmp;
 
-		default:
-			if (ppA)
-			{
-				for (UINT32 x = 0; x < width; x++)
-				{
-					BYTE alpha = *(*ppA)++;
-					UINT32 color =
-					    FreeRDPGetColor(DstFormat, *(*ppR)++, *(*ppG)++, *(*ppB)++, alpha);
-					FreeRDPWriteColor(*ppRgba, DstFormat, color);
-					*ppRgba += FreeRDPGetBytesPerPixel(DstFormat);
-				}
-			}
-			else
-			{
-				const BYTE alpha = 0xFF;
+			if (!planar_rle_expand_line(&srcp[c], end[c], current[c], nWidth))
+				return FALSE;
 
-				for (UINT32 x = 0; x < width; x++)
-				{
-					UINT32 color =
-					    FreeRDPGetColor(DstFormat, *(*ppR)++, *(*ppG)++, *(*ppB)++, alpha);
-					FreeRDPWriteColor(*ppRgba, DstFormat, color);
-					*ppRgba += FreeRDPGetBytesPerPixel(DstFormat);
-				}
-			}
+			if (y > 0)
+				prims->planar_delta_decode(previous[c], current[c], nWidth);
+		}
 
-			return TRUE;
+		const BYTE* rows[4] = { current[0], current[1], current[2], current[3] };
+		if (prims->planar_merge(rows, nWidth, dst, format, 0, nWidth, 1) != PRIMITIVES_SUCCESS)
+			return FALSE;
 	}
+
+	return TRUE;
 }
 
-static INLINE BOOL planar_decompress_planes_raw(const BYTE* WINPR_RESTRICT pSrcData[4],
+static INLINE BOOL planar_decompress_planes_raw(const primitives_t* WINPR_RESTRICT prims,
+                                                const BYTE* WINPR_RESTRICT pSrcData[4],
                                                 BYTE* WINPR_RESTRICT pDstData, UINT32 DstFormat,
                                                 UINT32 nDstStep, UINT32 nXDst, UINT32 nYDst,
                                                 UINT32 nWidth, UINT32 nHeight, BOOL vFlip,
                                                 UINT32 totalHeight)
 {
-	INT32 beg = 0;
-	INT32 end = 0;
-	INT32 inc = 0;
-	const BYTE* pR = pSrcData[0];
-	const BYTE* pG = pSrcData[1];
-	const BYTE* pB = pSrcData[2];
-	const BYTE* pA = pSrcData[3];
 	const UINT32 bpp = FreeRDPGetBytesPerPixel(DstFormat);
 
-	if (vFlip)
-	{
-		beg = WINPR_ASSERTING_INT_CAST(int32_t, nHeight - 1);
-		end = -1;
-		inc = -1;
-	}
-	else
-	{
-		beg = 0;
-		end = WINPR_ASSERTING_INT_CAST(int32_t, nHeight);
-		inc = 1;
-	}
+	WINPR_ASSERT(prims);
 
 	if (nYDst + nHeight > totalHeight)
 	{
@@ -629,25 +423,18 @@ static INLINE BOOL planar_decompress_planes_raw(const BYTE* WINPR_RESTRICT pSrcD
 		return FALSE;
 	}
 
-	for (INT32 y = beg; y != end; y += inc)
-	{
-		BYTE* pRGB = NULL;
+	if (nHeight == 0)
+		return TRUE;
 
-		if (y > WINPR_ASSERTING_INT_CAST(INT64, nHeight))
-		{
-			WLog_ERR(TAG, "planar plane destination Y %" PRId32 " exceeds height %" PRIu32, y,
-			         nHeight);
-			return FALSE;
-		}
+	/* BGRX32 is always opaque, alpha planes present in the stream are ignored */
+	const BYTE* planes[4] = { (DstFormat == PIXEL_FORMAT_BGRX32) ? NULL : pSrcData[3],
+		                      pSrcData[0], pSrcData[1], pSrcData[2] };
+	const UINT32 line = vFlip ? nYDst + nHeight - 1 : nYDst;
+	BYTE* pDst = &pDstData[1ULL * line * nDstStep + 1ULL * nXDst * bpp];
+	const INT32 dstStep = vFlip ? -(INT32)nDstStep : (INT32)nDstStep;
 
-		const intptr_t off = ((1LL * nYDst + y) * nDstStep) + (1LL * nXDst * bpp);
-		pRGB = &pDstData[off];
-
-		if (!writeLine(&pRGB, DstFormat, nWidth, &pR, &pG, &pB, &pA))
-			return FALSE;
-	}
-
-	return TRUE;
+	return prims->planar_merge(planes, nWidth, pDst, DstFormat, dstStep, nWidth, nHeight) ==
+	       PRIMITIVES_SUCCESS;
 }
 
 static BOOL planar_subsample_expand(const BYTE* WINPR_RESTRICT plane, size_t planeLength,
@@ -914,8 +701,9 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 
 		if (!rle) /* RAW */
 		{
-			if (!planar_decompress_planes_raw(planes, pTempData, TempFormat, nTempStep, nXDst,
-			                                  nYDst, nSrcWidth, nSrcHeight, vFlip, nTotalHeight))
+			if (!planar_decompress_planes_raw(prims, planes, pTempData, TempFormat, nTempStep,
+			                                  nXDst, nYDst, nSrcWidth, nSrcHeight, vFlip,
+			                                  nTotalHeight))
 				return FALSE;
 
 			if (alpha)
@@ -928,42 +716,13 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 		}
 		else /* RLE */
 		{
-			status = planar_decompress_plane_rle(
-			    planes[0], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[0]), pTempData, nTempStep,
-			    nXDst, nYDst, nSrcWidth, nSrcHeight, 2, vFlip); /* RedPlane */
-
-			if (status < 0)
-				return FALSE;
-
-			status = planar_decompress_plane_rle(
-			    planes[1], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[1]), pTempData, nTempStep,
-			    nXDst, nYDst, nSrcWidth, nSrcHeight, 1, vFlip); /* GreenPlane */
-
-			if (status < 0)
-				return FALSE;
-
-			status = planar_decompress_plane_rle(
-			    planes[2], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[2]), pTempData, nTempStep,
-			    nXDst, nYDst, nSrcWidth, nSrcHeight, 0, vFlip); /* BluePlane */
-
-			if (status < 0)
+			if (!planar_decompress_planes_rle(planar, prims, planes, rleSizes, useAlpha, pTempData,
+			                                  nTempStep, nXDst, nYDst, nSrcWidth, nSrcHeight,
+			                                  vFlip))
 				return FALSE;
 
 			srcp += rleSizes[0] + rleSizes[1] + rleSizes[2];
 
-			if (useAlpha)
-			{
-				status = planar_decompress_plane_rle(
-				    planes[3], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[3]), pTempData,
-				    nTempStep, nXDst, nYDst, nSrcWidth, nSrcHeight, 3, vFlip); /* AlphaPlane */
-			}
-			else
-				status = planar_set_plane(0xFF, pTempData, nTempStep, nXDst, nYDst, nSrcWidth,
-				                          nSrcHeight, 3, vFlip);
-
-			if (status < 0)
-				return FALSE;
-
 			if (alpha)
 				srcp += rleSizes[3];
 		}
@@ -1009,7 +768,7 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 			if (useAlpha)
 			{
 				status = planar_decompress_plane_rle_only(
-				    planes[3], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[3]), rleBuffer[3],
+				    prims, planes[3], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[3]), rleBuffer[3],
 				    rawWidths[3], rawHeights[3]); /* AlphaPlane */
 
 				if (status < 0)
@@ -1020,21 +779,21 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 				srcp += rleSizes[3];
 
 			status = planar_decompress_plane_rle_only(
-			    planes[0], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[0]), rleBuffer[0],
+			    prims, planes[0], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[0]), rleBuffer[0],
 			    rawWidths[0], rawHeights[0]); /* LumaPlane */
 
 			if (status < 0)
 				return FALSE;
 
 			status = planar_decompress_plane_rle_only(
-			    planes[1], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[1]), rleBuffer[1],
+			    prims, planes[1], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[1]), rleBuffer[1],
 			    rawWidths[1], rawHeights[1]); /* OrangeChromaPlane */
 
 			if (status < 0)
 				return FALSE;
 
 			status = planar_decompress_plane_rle_only(
-			    planes[2], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[2]), rleBuffer[2],
+			    prims, planes[2], WINPR_ASSERTING_INT_CAST(uint32_t, rleSizes[2]), rleBuffer[2],
 			    rawWidths[2], rawHeights[2]); /* GreenChromaPlane */
 
 			if (status < 0)
@@ -1071,8 +830,9 @@ BOOL planar_decompress(BITMAP_PLANAR_CONTEXT* WINPR_RESTRICT planar,
 				rawHeights[2] = nSrcHeight;
 			}
 
-			if (!planar_decompress_planes_raw(planes, pTempData, TempFormat, nTempStep, nXDst,
-			                                  nYDst, nSrcWidth, nSrcHeight, vFlip, nTotalHeight))
+			if (!planar_decompress_planes_raw(prims, planes, pTempData, TempFormat, nTempStep,
+			                                  nXDst, nYDst, nSrcWidth, nSrcHeight, vFlip,
+			                                  nTotalHeight))
 				return FALSE;
 
 			if (alpha)
@@ -1112,42 +872,24 @@ static INLINE BOOL freerdp_split_color_planes(BITMAP_PLANAR_CONTEXT* WINPR_RESTR
 	if (scanline == 0)
 		scanline = width * FreeRDPGetBytesPerPixel(format);
 
-	if (planar->topdown)
-	{
-		UINT32 k = 0;
-		for (UINT32 i = 0; i < height; i++)
-		{
-			const BYTE* pixel = &data[1ULL * scanline * i];
+	if (height == 0)
+		return TRUE;
 
-			for (UINT32 j = 0; j < width; j++)
-			{
-				const UINT32 color = FreeRDPReadColor(pixel, format);
-				pixel += FreeRDPGetBytesPerPixel(format);
-				FreeRDPSplitColor(color, format, &planes[1][k], &planes[2][k], &planes[3][k],
-				                  &planes[0][k], NULL);
-				k++;
-			}
-		}
-	}
-	else
-	{
-		UINT32 k = 0;
+	const primitives_t* prims = primitives_get();
+	const BYTE* first = data;
+	INT32 step = (INT32)scanline;
 
-		for (INT64 i = (INT64)height - 1; i >= 0; i--)
-		{
-			const BYTE* pixel = &data[1ULL * scanline * (UINT32)i];
+	WINPR_ASSERT(prims);
 
-			for (UINT32 j = 0; j < width; j++)
-			{
-				const UINT32 color = FreeRDPReadColor(pixel, format);
-				pixel += FreeRDPGetBytesPerPixel(format);
-				FreeRDPSplitColor(color, format, &planes[1][k], &planes[2][k], &planes[3][k],
-				                  &planes[0][k], NULL);
-				k++;
-			}
-		}
+	/* the planes are stored bottom up unless the image already is */
+	if (!planar->topdown)
+	{
+		first = &data[1ULL * scanline * (height - 1)];
+		step = -step;
 	}
-	return TRUE;
+
+	return prims->planar_split(first, format, step, planes, width, width, height) ==
+	       PRIMITIVES_SUCCESS;
 }
 
 static INLINE UINT32 freerdp_bitmap_planar_write_rle_bytes(const BYTE* WINPR_RESTRICT pInBuffer,
@@ -1268,83 +1010,36 @@ static INLINE UINT32 freerdp_bitmap_planar_write_rle_bytes(const BYTE* WINPR_RES
 	return (UINT32)diff;
 }
 
-static INLINE UINT32 freerdp_bitmap_planar_encode_rle_bytes(const BYTE* WINPR_RESTRICT pInBuffer,
-                                                            UINT32 inBufferSize,
-                                                            BYTE* WINPR_RESTRICT pOutBuffer,
-                                                            UINT32 outBufferSize)
+static INLINE UINT32
+freerdp_bitmap_planar_encode_rle_bytes(const primitives_t* WINPR_RESTRICT prims,
+                                       const BYTE* WINPR_RESTRICT pInBuffer, UINT32 inBufferSize,
+                                       BYTE* WINPR_RESTRICT pOutBuffer, UINT32 outBufferSize)
 {
 	BYTE symbol = 0;
-	const BYTE* pInput = NULL;
-	BYTE* pOutput = NULL;
-	const BYTE* pBytes = NULL;
-	UINT32 cRawBytes = 0;
-	UINT32 nRunLength = 0;
-	UINT32 bSymbolMatch = 0;
-	UINT32 nBytesWritten = 0;
 	UINT32 nTotalBytesWritten = 0;
-	symbol = 0;
-	cRawBytes = 0;
-	nRunLength = 0;
-	pInput = pInBuffer;
-	pOutput = pOutBuffer;
-	nTotalBytesWritten = 0;
 
 	if (!outBufferSize)
 		return 0;
 
-	do
+	for (UINT32 x = 0; x < inBufferSize;)
 	{
-		if (!inBufferSize)
-			break;
+		UINT32 cRawBytes = 0;
+		UINT32 nRunLength = 0;
 
-		bSymbolMatch = (symbol == *pInput) ? TRUE : FALSE;
-		symbol = *pInput;
-		pInput++;
-		inBufferSize--;
+		prims->planar_rle_scan(&pInBuffer[x], inBufferSize - x, symbol, &cRawBytes, &nRunLength);
 
-		if (nRunLength && !bSymbolMatch)
-		{
-			if (nRunLength < 3)
-			{
-				cRawBytes += nRunLength;
-				nRunLength = 0;
-			}
-			else
-			{
-				pBytes = pInput - (cRawBytes + nRunLength + 1);
-				nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(pBytes, cRawBytes, nRunLength,
-				                                                      pOutput, outBufferSize);
-				nRunLength = 0;
-
-				if (!nBytesWritten || (nBytesWritten > outBufferSize))
-					return nRunLength;
-
-				nTotalBytesWritten += nBytesWritten;
-				outBufferSize -= nBytesWritten;
-				pOutput += nBytesWritten;
-				cRawBytes = 0;
-			}
-		}
-
-		nRunLength += bSymbolMatch;
-		cRawBytes += (!bSymbolMatch) ? TRUE : FALSE;
-	} while (outBufferSize);
-
-	if (cRawBytes || nRunLength)
-	{
-		pBytes = pInput - (cRawBytes + nRunLength);
-		nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(pBytes, cRawBytes, nRunLength,
-		                                                      pOutput, outBufferSize);
+		const UINT32 nBytesWritten = freerdp_bitmap_planar_write_rle_bytes(
+		    &pInBuffer[x], cRawBytes, nRunLength, &pOutBuffer[nTotalBytesWritten],
+		    outBufferSize - nTotalBytesWritten);
 
 		if (!nBytesWritten)
 			return 0;
 
 		nTotalBytesWritten += nBytesWritten;
+		x += cRawBytes + nRunLength;
+		symbol = pInBuffer[x - 1];
 	}
 
-	if (inBufferSize)
-		return 0;
-
 	return nTotalBytesWritten;
 }
 
@@ -1362,6 +1057,9 @@ BOOL freerdp_bitmap_planar_compress_plane_rle(const BYTE* WINPR_RESTRICT inPlane
 	if (!outPlane)
 		return FALSE;
 
+	const primitives_t* prims = primitives_get();
+	WINPR_ASSERT(prims);
+
 	index = 0;
 	pInput = inPlane;
 	pOutput = outPlane;
@@ -1371,7 +1069,7 @@ BOOL freerdp_bitmap_planar_compress_plane_rle(const BYTE* WINPR_RESTRICT inPlane
 	while (outBufferSize)
 	{
 		nBytesWritten =
-		    freerdp_bitmap_planar_encode_rle_bytes(pInput, width, pOutput, outBufferSize);
+		    freerdp_bitmap_planar_encode_rle_bytes(prims, pInput, width, pOutput, outBufferSize);
 
 		if ((!nBytesWritten) || (nBytesWritten > outBufferSize))
 			return FALSE;
@@ -1446,9 +1144,9 @@ static INLINE BOOL freerdp_bitmap_planar_compress_planes_rle(BYTE* WINPR_RESTRIC
 BYTE* freerdp_bitmap_planar_delta_encode_plane(const BYTE* WINPR_RESTRICT inPlane, UINT32 width,
                                                UINT32 height, BYTE* WINPR_RESTRICT outPlane)
 {
-	BYTE* outPtr = NULL;
-	const BYTE* srcPtr = NULL;
-	const BYTE* prevLinePtr = NULL;
+	const primitives_t* prims = primitives_get();
+
+	WINPR_ASSERT(prims);
 
 	if (!outPlane)
 	{
@@ -1461,22 +1159,12 @@ BYTE* freerdp_bitmap_planar_delta_encode_plane(const BYTE* WINPR_RESTRICT inPlan
 
 	// first line is copied as is
 	CopyMemory(outPlane, inPlane, width);
-	outPtr = outPlane + width;
-	srcPtr = inPlane + width;
-	prevLinePtr = inPlane;
 
 	for (UINT32 y = 1; y < height; y++)
 	{
-		for (UINT32 x = 0; x < width; x++, outPtr++, srcPtr++, prevLinePtr++)
-		{
-			INT32 delta = *srcPtr - *prevLinePtr;
-			BYTE s2c = WINPR_ASSERTING_INT_CAST(
-			    BYTE, (delta >= 0) ? delta : (~((BYTE)(-delta)) + 1) & 0xFF);
-			s2c = WINPR_ASSERTING_INT_CAST(
-			    BYTE,
-			    (s2c >= 0) ? (s2c << 1) & 0xFF : (((UINT32)(~((BYTE)s2c) + 1) << 1) - 1) & 0xFF);
-			*outPtr = s2c;
-		}
+		const size_t offset = 1ULL * y * width;
+		prims->planar_delta_encode(&inPlane[offset], &inPlane[offset - width], &outPlane[offset],
+		                           width);
 	}
 
 	return outPlane;
@@ -1781,6 +1469,7 @@ void freerdp_bitmap_planar_context_free(BITMAP_PLANAR_CONTEXT* context)
 	winpr_aligned_free(context->planesBuffer);
 	winpr_aligned_free(context->deltaPlanesBuffer);
 	winpr_aligned_free(context->rlePlanesBuffer);
+	winpr_aligned_free(context->rowsBuffer);
 	winpr_aligned_free(context);
 }
 
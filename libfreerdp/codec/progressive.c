@@ -1181,56 +1181,57 @@ static INLINE int progressive_rfx_upgrade_block(RFX_PROGRESSIVE_UPGRADE_STATE* W
                                                 INT16* WINPR_RESTRICT sign, UINT32 length,
                                                 UINT32 shift, UINT32 bitPos, UINT32 numBits)
 {
-	INT16 input = 0;
+	INT16 input[1023];
 	wBitStream* raw = NULL;
+	const primitives_t* prims = primitives_get();
 
 	if (!numBits)
 		return 1;
 
+	WINPR_ASSERT(length <= ARRAYSIZE(input));
 	raw = state->raw;
+	raw->mask = ((1 << numBits) - 1);
 
+	/* The bit streams are read sequentially, the decoded values are then shifted and added to
+	 * the coefficients with the (vectorized) primitives. */
 	if (!state->nonLL)
 	{
 		for (UINT32 index = 0; index < length; index++)
 		{
-			raw->mask = ((1 << numBits) - 1);
-			input = (INT16)((raw->accumulator >> (32 - numBits)) & raw->mask);
+			input[index] = (INT16)((raw->accumulator >> (32 - numBits)) & raw->mask);
 			BitStream_Shift(raw, numBits);
-			buffer[index] +=
-			    WINPR_ASSERTING_INT_CAST(INT16, (INT16)(((UINT32)input << shift) & 0xFFFF));
 		}
-
-		return 1;
 	}
-
-	for (UINT32 index = 0; index < length; index++)
+	else
 	{
-		if (sign[index] > 0)
-		{
-			/* sign > 0, read from raw */
-			raw->mask = ((1 << numBits) - 1);
-			input = (INT16)((raw->accumulator >> (32 - numBits)) & raw->mask);
-			BitStream_Shift(raw, numBits);
-		}
-		else if (sign[index] < 0)
-		{
-			/* sign < 0, read from raw */
-			raw->mask = ((1 << numBits) - 1);
-			input = (INT16)((raw->accumulator >> (32 - numBits)) & raw->mask);
-			BitStream_Shift(raw, numBits);
-			input *= -1;
-		}
-		else
+		for (UINT32 index = 0; index < length; index++)
 		{
-			/* sign == 0, read from srl */
-			input = progressive_rfx_srl_read(state, numBits);
-			sign[index] = input;
+			if (sign[index] > 0)
+			{
+				/* sign > 0, read from raw */
+				input[index] = (INT16)((raw->accumulator >> (32 - numBits)) & raw->mask);
+				BitStream_Shift(raw, numBits);
+			}
+			else if (sign[index] < 0)
+			{
+				/* sign < 0, read from raw */
+				const INT16 value = (INT16)((raw->accumulator >> (32 - numBits)) & raw->mask);
+				BitStream_Shift(raw, numBits);
+				input[index] = (INT16)(-1 * value);
+			}
+			else
+			{
+				/* sign == 0, read from srl */
+				input[index] = progressive_rfx_srl_read(state, numBits);
+				sign[index] = input[index];
+			}
 		}
-
-		const int32_t val = input << shift;
-		buffer[index] += WINPR_ASSERTING_INT_CAST(INT16, val);
 	}
 
+	if (prims->lShiftC_16s_inplace(input, shift, length) != PRIMITIVES_SUCCESS)
+		return -1;
+	if (prims->add_16s_inplace(buffer, input, length) != PRIMITIVES_SUCCESS)
+		return -1;
 	return 1;
 }
 
@@ -1650,13 +1651,9 @@ static INLINE BOOL progressive_tile_read(PROGRESSIVE_CONTEXT* WINPR_RESTRICT pro
 	return progressive_surface_tile_replace(surface, region, &tile, FALSE);
 }
 
-static void CALLBACK progressive_process_tiles_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
-                                                                  void* context, PTP_WORK work)
+static void progressive_process_tile(PROGRESSIVE_TILE_PROCESS_WORK_PARAM* WINPR_RESTRICT param)
 {
-	PROGRESSIVE_TILE_PROCESS_WORK_PARAM* param = (PROGRESSIVE_TILE_PROCESS_WORK_PARAM*)context;
-
-	WINPR_UNUSED(instance);
-	WINPR_UNUSED(work);
+	WINPR_ASSERT(param);
 
 	switch (param->tile->blockType)
 	{
@@ -1678,6 +1675,18 @@ static void CALLBACK progressive_process_tiles_tile_work_callback(PTP_CALLBACK_I
 	}
 }
 
+static void CALLBACK progressive_process_tiles_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                                  void* context, UINT32 index)
+{
+	PROGRESSIVE_CONTEXT* progressive = (PROGRESSIVE_CONTEXT*)context;
+
+	WINPR_UNUSED(instance);
+	WINPR_ASSERT(progressive);
+	WINPR_ASSERT(index < ARRAYSIZE(progressive->params));
+
+	progressive_process_tile(&progressive->params[index]);
+}
+
 static INLINE SSIZE_T progressive_process_tiles(
     PROGRESSIVE_CONTEXT* WINPR_RESTRICT progressive, wStream* WINPR_RESTRICT s,
     PROGRESSIVE_BLOCK_REGION* WINPR_RESTRICT region,
@@ -1690,7 +1699,6 @@ static INLINE SSIZE_T progressive_process_tiles(
 	UINT16 blockType = 0;
 	UINT32 blockLen = 0;
 	UINT32 count = 0;
-	UINT16 close_cnt = 0;
 
 	WINPR_ASSERT(progressive);
 	WINPR_ASSERT(region);
@@ -1781,43 +1789,21 @@ static INLINE SSIZE_T progressive_process_tiles(
 		param->context = context;
 		param->tile = tile;
 
-		if (progressive->rfx_context->priv->UseThreads)
-		{
-			progressive->work_objects[idx] =
-			    CreateThreadpoolWork(progressive_process_tiles_tile_work_callback, (void*)param,
-			                         &progressive->rfx_context->priv->ThreadPoolEnv);
-			if (!progressive->work_objects[idx])
-			{
-				WLog_Print(progressive->log, WLOG_ERROR,
-				           "Failed to create ThreadpoolWork for tile %" PRIu32, idx);
-				status = -1;
-				break;
-			}
-
-			SubmitThreadpoolWork(progressive->work_objects[idx]);
-
-			close_cnt = WINPR_ASSERTING_INT_CAST(UINT16, idx + 1);
-		}
-		else
-		{
-			progressive_process_tiles_tile_work_callback(0, param, 0);
-		}
-
-		if (status < 0)
-		{
-			WLog_Print(progressive->log, WLOG_ERROR, "Failed to decompress %s at %" PRIu16,
-			           rfx_get_progressive_block_type_string(tile->blockType), idx);
-			goto fail;
-		}
+		if (!progressive->batch)
+			progressive_process_tile(param);
 	}
 
-	if (progressive->rfx_context->priv->UseThreads)
+	if (progressive->batch)
 	{
-		for (UINT32 idx = 0; idx < close_cnt; idx++)
+		if (!winpr_SubmitThreadpoolBatch(progressive->batch, region->numTiles))
 		{
-			WaitForThreadpoolWorkCallbacks(progressive->work_objects[idx], FALSE);
-			CloseThreadpoolWork(progressive->work_objects[idx]);
+			WLog_Print(progressive->log, WLOG_ERROR, "Failed to submit %" PRIu16 " tiles",
+			           region->numTiles);
+			status = -1;
+			goto fail;
 		}
+
+		winpr_WaitForThreadpoolBatchCallbacks(progressive->batch);
 	}
 
 fail:
@@ -2636,6 +2622,14 @@ PROGRESSIVE_CONTEXT* progressive_context_new_ex(BOOL Compressor, UINT32 Threadin
 	progressive->rfx_context = rfx_context_new_ex(Compressor, ThreadingFlags);
 	if (!progressive->rfx_context)
 		goto fail;
+	if (progressive->rfx_context->priv->UseThreads)
+	{
+		progressive->batch =
+		    winpr_CreateThreadpoolBatch(progressive_process_tiles_tile_work_callback, progressive,
+		                                &progressive->rfx_context->priv->ThreadPoolEnv);
+		if (!progressive->batch)
+			goto fail;
+	}
 	progressive->buffer = Stream_New(NULL, 1024);
 	if (!progressive->buffer)
 		goto fail;
@@ -2670,6 +2664,7 @@ void progressive_context_free(PROGRESSIVE_CONTEXT* progressive)
 
 	Stream_Free(progressive->buffer, TRUE);
 	Stream_Free(progressive->rects, TRUE);
+	winpr_CloseThreadpoolBatch(progressive->batch);
 	rfx_context_free(progressive->rfx_context);
 
 	BufferPool_Free(progressive->bufferPool);
@@ -229,7 +229,7 @@ struct S_PROGRESSIVE_CONTEXT
 	wStream* rects;
 	RFX_CONTEXT* rfx_context;
 	PROGRESSIVE_TILE_PROCESS_WORK_PARAM params[0x10000];
-	PTP_WORK work_objects[0x10000];
+	PTP_BATCH batch;
 };
 
 #endif /* INTERNAL_CODEC_PROGRESSIVE_H */
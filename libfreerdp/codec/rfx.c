@@ -49,6 +49,7 @@
 #include "rfx_rlgr.h"
 
 #include "sse/rfx_sse2.h"
+#include "sse/rfx_avx2.h"
 #include "neon/rfx_neon.h"
 
 #define TAG FREERDP_TAG("codec")
@@ -198,6 +199,11 @@ static INLINE void rfx_encoder_tile_free(void* obj)
 	winpr_aligned_free(obj);
 }
 
+static void CALLBACK rfx_process_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                            void* context, UINT32 index);
+static void CALLBACK rfx_compose_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                            void* context, UINT32 index);
+
 RFX_CONTEXT* rfx_context_new(BOOL encoder)
 {
 	return rfx_context_new_ex(encoder, 0);
@@ -318,6 +324,16 @@ RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags)
 
 		if (priv->MaxThreadCount)
 			SetThreadpoolThreadMaximum(priv->ThreadPool, priv->MaxThreadCount);
+
+		priv->DecodeBatch = winpr_CreateThreadpoolBatch(rfx_process_message_tile_work_callback,
+		                                                context, &priv->ThreadPoolEnv);
+		if (!priv->DecodeBatch)
+			goto fail;
+
+		priv->EncodeBatch = winpr_CreateThreadpoolBatch(rfx_compose_message_tile_work_callback,
+		                                                context, &priv->ThreadPoolEnv);
+		if (!priv->EncodeBatch)
+			goto fail;
 	}
 
 	/* initialize the default pixel format */
@@ -330,9 +346,12 @@ RFX_CONTEXT* rfx_context_new_ex(BOOL encoder, UINT32 ThreadingFlags)
 	context->dwt_2d_decode = rfx_dwt_2d_decode;
 	context->dwt_2d_extrapolate_decode = rfx_dwt_2d_extrapolate_decode;
 	context->dwt_2d_encode = rfx_dwt_2d_encode;
-	context->rlgr_decode = rfx_rlgr_decode;
-	context->rlgr_encode = rfx_rlgr_encode;
+	context->rlgr_decode = rfx_rlgr_decode_fast;
+	context->rlgr_encode = rfx_rlgr_encode_fast;
 	rfx_init_sse2(context);
+#if defined(WITH_AVX2)
+	rfx_init_avx2(context);
+#endif
 	rfx_init_neon(context);
 	context->state = RFX_STATE_SEND_HEADERS;
 	context->expectedDataBlockType = WBT_FRAME_BEGIN;
@@ -370,10 +389,11 @@ void rfx_context_free(RFX_CONTEXT* context)
 		ObjectPool_Free(priv->TilePool);
 		if (priv->UseThreads)
 		{
+			winpr_CloseThreadpoolBatch(priv->DecodeBatch);
+			winpr_CloseThreadpoolBatch(priv->EncodeBatch);
 			if (priv->ThreadPool)
 				CloseThreadpool(priv->ThreadPool);
 			DestroyThreadpoolEnvironment(&priv->ThreadPoolEnv);
-			winpr_aligned_free((void*)priv->workObjects);
 			winpr_aligned_free(priv->tileWorkParams);
 #ifdef WITH_PROFILER
 			WLog_VRB(
@@ -796,17 +816,45 @@ static INLINE BOOL rfx_process_message_region(RFX_CONTEXT* WINPR_RESTRICT contex
 	return TRUE;
 }
 
-typedef struct
+struct S_RFX_TILE_COMPOSE_WORK_PARAM
 {
 	RFX_TILE* tile;
 	RFX_CONTEXT* context;
-} RFX_TILE_PROCESS_WORK_PARAM;
+};
+
+static INLINE BOOL setupWorkers(RFX_CONTEXT* WINPR_RESTRICT context, size_t nbTiles)
+{
+	WINPR_ASSERT(context);
+
+	RFX_CONTEXT_PRIV* priv = context->priv;
+	WINPR_ASSERT(priv);
+
+	void* pmem = NULL;
+
+	if (!context->priv->UseThreads)
+		return TRUE;
+
+	/* The parameters are reused between frames, only grow them */
+	if (nbTiles <= priv->tileWorkParamsCount)
+		return TRUE;
+
+	if (!(pmem = winpr_aligned_recalloc(priv->tileWorkParams, nbTiles,
+	                                    sizeof(RFX_TILE_COMPOSE_WORK_PARAM), 32)))
+		return FALSE;
 
-static INLINE void CALLBACK rfx_process_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
-                                                                   void* context, PTP_WORK work)
+	priv->tileWorkParams = (RFX_TILE_COMPOSE_WORK_PARAM*)pmem;
+	priv->tileWorkParamsCount = nbTiles;
+	return TRUE;
+}
+
+static void CALLBACK rfx_process_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                            void* context, UINT32 index)
 {
-	RFX_TILE_PROCESS_WORK_PARAM* param = (RFX_TILE_PROCESS_WORK_PARAM*)context;
-	WINPR_ASSERT(param);
+	RFX_CONTEXT* rfx = (RFX_CONTEXT*)context;
+	WINPR_ASSERT(rfx);
+	WINPR_ASSERT(index < rfx->priv->tileWorkParamsCount);
+
+	RFX_TILE_COMPOSE_WORK_PARAM* param = &rfx->priv->tileWorkParams[index];
 	rfx_decode_rgb(param->context, param->tile, param->tile->data, 64 * 4);
 }
 
@@ -838,7 +886,6 @@ static INLINE BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
                                                UINT16* WINPR_RESTRICT pExpectedBlockType)
 {
 	BOOL rc = 0;
-	size_t close_cnt = 0;
 	BYTE quant = 0;
 	RFX_TILE* tile = NULL;
 	UINT32* quants = NULL;
@@ -847,8 +894,7 @@ static INLINE BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
 	UINT32 blockLen = 0;
 	UINT32 blockType = 0;
 	UINT32 tilesDataSize = 0;
-	PTP_WORK* work_objects = NULL;
-	RFX_TILE_PROCESS_WORK_PARAM* params = NULL;
+	RFX_TILE_COMPOSE_WORK_PARAM* params = NULL;
 	void* pmem = NULL;
 
 	WINPR_ASSERT(context);
@@ -941,27 +987,12 @@ static INLINE BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
 	if (!rfx_allocate_tiles(message, numTiles, FALSE))
 		return FALSE;
 
-	if (context->priv->UseThreads)
-	{
-		work_objects = (PTP_WORK*)winpr_aligned_calloc(message->numTiles, sizeof(PTP_WORK), 32);
-		params = (RFX_TILE_PROCESS_WORK_PARAM*)winpr_aligned_recalloc(
-		    NULL, message->numTiles, sizeof(RFX_TILE_PROCESS_WORK_PARAM), 32);
-
-		if (!work_objects)
-		{
-			winpr_aligned_free(params);
-			return FALSE;
-		}
+	if (!setupWorkers(context, message->numTiles))
+		return FALSE;
 
-		if (!params)
-		{
-			winpr_aligned_free((void*)work_objects);
-			return FALSE;
-		}
-	}
+	params = context->priv->tileWorkParams;
 
 	/* tiles */
-	close_cnt = 0;
 	rc = FALSE;
 
 	if (Stream_GetRemainingLength(s) >= tilesDataSize)
@@ -1078,26 +1109,8 @@ static INLINE BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
 
 			if (context->priv->UseThreads)
 			{
-				if (!params)
-				{
-					rc = FALSE;
-					break;
-				}
-
 				params[i].context = context;
 				params[i].tile = message->tiles[i];
-
-				if (!(work_objects[i] =
-				          CreateThreadpoolWork(rfx_process_message_tile_work_callback,
-				                               (void*)&params[i], &context->priv->ThreadPoolEnv)))
-				{
-					WLog_Print(context->priv->log, WLOG_ERROR, "CreateThreadpoolWork failed.");
-					rc = FALSE;
-					break;
-				}
-
-				SubmitThreadpoolWork(work_objects[i]);
-				close_cnt = i + 1;
 			}
 			else
 			{
@@ -1106,18 +1119,15 @@ static INLINE BOOL rfx_process_message_tileset(RFX_CONTEXT* WINPR_RESTRICT conte
 		}
 	}
 
-	if (context->priv->UseThreads)
+	/* All tiles are parsed, decode them on the thread pool */
+	if (rc && context->priv->UseThreads)
 	{
-		for (size_t i = 0; i < close_cnt; i++)
-		{
-			WaitForThreadpoolWorkCallbacks(work_objects[i], FALSE);
-			CloseThreadpoolWork(work_objects[i]);
-		}
+		if (!winpr_SubmitThreadpoolBatch(context->priv->DecodeBatch, message->numTiles))
+			rc = FALSE;
+		else
+			winpr_WaitForThreadpoolBatchCallbacks(context->priv->DecodeBatch);
 	}
 
-	winpr_aligned_free((void*)work_objects);
-	winpr_aligned_free(params);
-
 	for (size_t i = 0; i < message->numTiles; i++)
 	{
 		if (!(tile = message->tiles[i]))
@@ -1571,17 +1581,14 @@ static INLINE BOOL rfx_write_tile(wStream* WINPR_RESTRICT s, const RFX_TILE* WIN
 	return TRUE;
 }
 
-struct S_RFX_TILE_COMPOSE_WORK_PARAM
+static void CALLBACK rfx_compose_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
+                                                            void* context, UINT32 index)
 {
-	RFX_TILE* tile;
-	RFX_CONTEXT* context;
-};
+	RFX_CONTEXT* rfx = (RFX_CONTEXT*)context;
+	WINPR_ASSERT(rfx);
+	WINPR_ASSERT(index < rfx->priv->tileWorkParamsCount);
 
-static INLINE void CALLBACK rfx_compose_message_tile_work_callback(PTP_CALLBACK_INSTANCE instance,
-                                                                   void* context, PTP_WORK work)
-{
-	RFX_TILE_COMPOSE_WORK_PARAM* param = (RFX_TILE_COMPOSE_WORK_PARAM*)context;
-	WINPR_ASSERT(param);
+	RFX_TILE_COMPOSE_WORK_PARAM* param = &rfx->priv->tileWorkParams[index];
 	rfx_encode_rgb(param->context, param->tile);
 }
 
@@ -1610,31 +1617,6 @@ static INLINE BOOL computeRegion(const RFX_RECT* WINPR_RESTRICT rects, size_t nu
 
 #define TILE_NO(v) ((v) / 64)
 
-static INLINE BOOL setupWorkers(RFX_CONTEXT* WINPR_RESTRICT context, size_t nbTiles)
-{
-	WINPR_ASSERT(context);
-
-	RFX_CONTEXT_PRIV* priv = context->priv;
-	WINPR_ASSERT(priv);
-
-	void* pmem = NULL;
-
-	if (!context->priv->UseThreads)
-		return TRUE;
-
-	if (!(pmem = winpr_aligned_recalloc((void*)priv->workObjects, nbTiles, sizeof(PTP_WORK), 32)))
-		return FALSE;
-
-	priv->workObjects = (PTP_WORK*)pmem;
-
-	if (!(pmem = winpr_aligned_recalloc(priv->tileWorkParams, nbTiles,
-	                                    sizeof(RFX_TILE_COMPOSE_WORK_PARAM), 32)))
-		return FALSE;
-
-	priv->tileWorkParams = (RFX_TILE_COMPOSE_WORK_PARAM*)pmem;
-	return TRUE;
-}
-
 static INLINE BOOL rfx_ensure_tiles(RFX_MESSAGE* WINPR_RESTRICT message, size_t count)
 {
 	WINPR_ASSERT(message);
@@ -1654,7 +1636,6 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 	const UINT32 height = h;
 	const UINT32 scanline = (UINT32)s;
 	RFX_MESSAGE* message = NULL;
-	PTP_WORK* workObject = NULL;
 	RFX_TILE_COMPOSE_WORK_PARAM* workParam = NULL;
 	BOOL success = FALSE;
 	REGION16 rectsRegion = { 0 };
@@ -1716,10 +1697,7 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 		goto skip_encoding_loop;
 
 	if (context->priv->UseThreads)
-	{
-		workObject = context->priv->workObjects;
 		workParam = context->priv->tileWorkParams;
-	}
 
 	UINT32 regionNbRects = 0;
 	regionRect = region16_rects(&rectsRegion, &regionNbRects);
@@ -1816,18 +1794,9 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 
 				if (context->priv->UseThreads)
 				{
+					WINPR_ASSERT(message->numTiles <= context->priv->tileWorkParamsCount);
 					workParam->context = context;
 					workParam->tile = tile;
-
-					if (!(*workObject = CreateThreadpoolWork(rfx_compose_message_tile_work_callback,
-					                                         (void*)workParam,
-					                                         &context->priv->ThreadPoolEnv)))
-					{
-						goto skip_encoding_loop;
-					}
-
-					SubmitThreadpoolWork(*workObject);
-					workObject++;
 					workParam++;
 				}
 				else
@@ -1841,28 +1810,24 @@ RFX_MESSAGE* rfx_encode_message(RFX_CONTEXT* WINPR_RESTRICT context,
 		}     /* yIdx */
 	}         /* rects */
 
+	/* when using threads encode all collected tiles in one batch */
+	if (context->priv->UseThreads)
+	{
+		if (!winpr_SubmitThreadpoolBatch(context->priv->EncodeBatch, message->numTiles))
+			goto skip_encoding_loop;
+
+		winpr_WaitForThreadpoolBatchCallbacks(context->priv->EncodeBatch);
+	}
+
 	success = TRUE;
 skip_encoding_loop:
 
-	/* when using threads ensure all computations are done */
 	if (success)
 	{
 		message->tilesDataSize = 0;
-		workObject = context->priv->workObjects;
 
 		for (UINT32 i = 0; i < message->numTiles; i++)
 		{
-			if (context->priv->UseThreads)
-			{
-				if (*workObject)
-				{
-					WaitForThreadpoolWorkCallbacks(*workObject, FALSE);
-					CloseThreadpoolWork(*workObject);
-				}
-
-				workObject++;
-			}
-
 			const RFX_TILE* tile = message->tiles[i];
 			message->tilesDataSize += rfx_tile_length(tile);
 		}
@@ -789,3 +789,546 @@ int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 dat
 
 	return WINPR_ASSERTING_INT_CAST(int, processed_size);
 }
+
+/**
+ * Word at a time RLGR coder
+ *
+ * RLGR is adaptive, every symbol depends on the parameters updated by the one before, so the
+ * coder is inherently sequential. Instead of shifting single bits through a 32 bit window the
+ * coders below keep up to 64 bits in a register, count runs of equal bits with a single
+ * leading zero count, apply the run length parameter updates in one step and scan for runs
+ * of zero coefficients four at a time.
+ *
+ * The output is bit exact with rfx_rlgr_decode and rfx_rlgr_encode.
+ */
+
+typedef struct
+{
+	const BYTE* data;
+	size_t length;
+	size_t pos;       /* next byte to load */
+	UINT64 acc;       /* unconsumed bits, MSB first */
+	UINT32 bits;      /* number of bits loaded into acc */
+	size_t remaining; /* number of unconsumed bits of the input */
+} RLGR_READER;
+
+typedef struct
+{
+	BYTE* buffer;
+	size_t length;
+	size_t pos;  /* next byte to write, may exceed length */
+	UINT64 acc;  /* pending bits in the least significant bits */
+	UINT32 bits; /* number of pending bits */
+} RLGR_WRITER;
+
+static INLINE UINT32 rlgr_clz64(UINT64 x)
+{
+	WINPR_ASSERT(x != 0);
+#if defined(__GNUC__) || defined(__clang__)
+	return (UINT32)__builtin_clzll(x);
+#else
+	const UINT32 hi = (UINT32)(x >> 32);
+	if (hi)
+		return lzcnt_s(hi);
+	return 32 + lzcnt_s((UINT32)x);
+#endif
+}
+
+static INLINE UINT64 rlgr_load_be64(const BYTE* p)
+{
+	return ((UINT64)p[0] << 56) | ((UINT64)p[1] << 48) | ((UINT64)p[2] << 40) |
+	       ((UINT64)p[3] << 32) | ((UINT64)p[4] << 24) | ((UINT64)p[5] << 16) |
+	       ((UINT64)p[6] << 8) | ((UINT64)p[7]);
+}
+
+/* Ensure at least 32 bits are loaded, bits past the end of the input read as 0 */
+static INLINE void rlgr_refill(RLGR_READER* r)
+{
+	if (r->bits >= 32)
+		return;
+
+	if (r->pos + 8 <= r->length)
+	{
+		/* bits loaded beyond r->bits are correct, a later refill ORs the same values */
+		const UINT32 n = (63 - r->bits) >> 3;
+		r->acc |= rlgr_load_be64(&r->data[r->pos]) >> r->bits;
+		r->pos += n;
+		r->bits += n * 8;
+	}
+	else
+	{
+		while (r->bits <= 56)
+		{
+			const UINT64 b = (r->pos < r->length) ? r->data[r->pos] : 0;
+			r->acc |= b << (56 - r->bits);
+			r->pos++;
+			r->bits += 8;
+		}
+	}
+}
+
+static INLINE UINT32 rlgr_peek(const RLGR_READER* r, UINT32 nbits)
+{
+	WINPR_ASSERT((nbits > 0) && (nbits <= 32));
+	return (UINT32)(r->acc >> (64 - nbits));
+}
+
+static INLINE void rlgr_consume(RLGR_READER* r, UINT32 nbits)
+{
+	WINPR_ASSERT(nbits <= r->bits);
+	WINPR_ASSERT(nbits <= r->remaining);
+	r->acc <<= nbits;
+	r->bits -= nbits;
+	r->remaining -= nbits;
+}
+
+/* Consume a run of zero (or one) bits, the run ends at the end of the input */
+static INLINE UINT32 rlgr_read_run(RLGR_READER* r, BOOL ones)
+{
+	size_t count = 0;
+
+	for (;;)
+	{
+		rlgr_refill(r);
+
+		const UINT32 avail = (r->remaining < r->bits) ? (UINT32)r->remaining : r->bits;
+		if (avail == 0)
+			break;
+
+		const UINT64 v = ones ? ~r->acc : r->acc;
+		const UINT32 n = v ? rlgr_clz64(v) : 64;
+		if (n < avail)
+		{
+			rlgr_consume(r, n);
+			count += n;
+			break;
+		}
+
+		rlgr_consume(r, avail);
+		count += avail;
+	}
+
+	return (UINT32)count;
+}
+
+/* Read a Golomb-Rice code and update kr, krp. Returns FALSE if the input ends early */
+static INLINE BOOL rlgr_read_gr(RLGR_READER* r, UINT32* kr, UINT32* krp, UINT16* code)
+{
+	const UINT32 vk = rlgr_read_run(r, TRUE);
+
+	if (r->remaining < 1)
+		return FALSE;
+	rlgr_consume(r, 1);
+
+	rlgr_refill(r);
+	if (r->remaining < *kr)
+		return FALSE;
+
+	UINT32 rem = 0;
+	if (*kr > 0)
+	{
+		rem = rlgr_peek(r, *kr);
+		rlgr_consume(r, *kr);
+	}
+
+	*code = (UINT16)(rem | (vk << *kr));
+
+	if (!vk)
+	{
+		*krp = (*krp > 2) ? *krp - 2 : 0;
+		*kr = *krp >> LSGR;
+	}
+	else if (vk != 1)
+	{
+		*krp += vk;
+		if (*krp > KPMAX)
+			*krp = KPMAX;
+		*kr = *krp >> LSGR;
+	}
+
+	return TRUE;
+}
+
+/* inverse of Get2MagSign, code = 2 * mag - sign */
+static INLINE INT16 rlgr_mag_sign(UINT32 code)
+{
+	const UINT32 mag = (code >> 1) + (code & 1);
+	return (INT16)((code & 1) ? (0u - mag) : mag);
+}
+
+int rfx_rlgr_decode_fast(RLGR_MODE mode, const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+                         INT16* WINPR_RESTRICT pDstData, UINT32 DstSize)
+{
+	UINT32 k = 1;
+	UINT32 kp = k << LSGR;
+	UINT32 kr = 1;
+	UINT32 krp = kr << LSGR;
+	size_t offset = 0;
+	RLGR_READER r = { 0 };
+
+	InitOnceExecuteOnce(&rfx_rlgr_init_once, rfx_rlgr_init, NULL, NULL);
+
+	if ((mode != RLGR1) && (mode != RLGR3))
+		mode = RLGR1;
+
+	if (!pSrcData || !SrcSize)
+		return -1;
+
+	if (!pDstData || !DstSize)
+		return -1;
+
+	r.data = pSrcData;
+	r.length = SrcSize;
+	r.remaining = 8ull * SrcSize;
+
+	while ((r.remaining > 0) && (offset < DstSize))
+	{
+		UINT16 code = 0;
+
+		if (k)
+		{
+			/* Run-Length (RL) Mode */
+			size_t run = 0;
+			UINT32 vk = rlgr_read_run(&r, FALSE);
+
+			if (r.remaining < 1)
+				break;
+			rlgr_consume(&r, 1);
+
+			/* every zero bit adds (1 << k) to the run length and increases kp */
+			for (; vk > 0; vk--)
+			{
+				run += (1ull << k);
+				kp += UP_GR;
+
+				if (kp >= KPMAX)
+				{
+					kp = KPMAX;
+					k = kp >> LSGR;
+					run += (size_t)(vk - 1) << k;
+					break;
+				}
+
+				k = kp >> LSGR;
+			}
+
+			rlgr_refill(&r);
+			if (r.remaining < k)
+				break;
+
+			if (k > 0)
+			{
+				run += rlgr_peek(&r, k);
+				rlgr_consume(&r, k);
+			}
+
+			if (r.remaining < 1)
+				break;
+
+			const BOOL sign = rlgr_peek(&r, 1) ? TRUE : FALSE;
+			rlgr_consume(&r, 1);
+
+			if (!rlgr_read_gr(&r, &kr, &krp, &code))
+				break;
+
+			kp = (kp > DN_GR) ? kp - DN_GR : 0;
+			k = kp >> LSGR;
+
+			size_t size = run;
+			if (size > DstSize - offset)
+				size = DstSize - offset;
+
+			memset(&pDstData[offset], 0, size * sizeof(INT16));
+			offset += size;
+
+			if (offset < DstSize)
+			{
+				const UINT32 mag = code + 1u;
+				pDstData[offset++] = (INT16)(sign ? (0u - mag) : mag);
+			}
+		}
+		else
+		{
+			/* Golomb-Rice (GR) Mode */
+			if (!rlgr_read_gr(&r, &kr, &krp, &code))
+				break;
+
+			if (mode == RLGR1)
+			{
+				INT16 mag = 0;
+
+				if (!code)
+				{
+					kp += UQ_GR;
+					if (kp > KPMAX)
+						kp = KPMAX;
+				}
+				else
+				{
+					kp = (kp > DQ_GR) ? kp - DQ_GR : 0;
+					mag = rlgr_mag_sign(code);
+				}
+
+				k = kp >> LSGR;
+				pDstData[offset++] = mag;
+			}
+			else
+			{
+				const UINT32 nIdx = code ? 32 - lzcnt_s(code) : 0;
+				UINT32 val1 = 0;
+
+				rlgr_refill(&r);
+				if (r.remaining < nIdx)
+					break;
+
+				if (nIdx > 0)
+				{
+					val1 = rlgr_peek(&r, nIdx);
+					rlgr_consume(&r, nIdx);
+				}
+
+				const UINT32 val2 = code - val1;
+
+				if (val1 && val2)
+				{
+					kp = (kp > 2 * DQ_GR) ? kp - 2 * DQ_GR : 0;
+					k = kp >> LSGR;
+				}
+				else if (!val1 && !val2)
+				{
+					kp += 2 * UQ_GR;
+					if (kp > KPMAX)
+						kp = KPMAX;
+					k = kp >> LSGR;
+				}
+
+				pDstData[offset++] = rlgr_mag_sign(val1);
+				if (offset < DstSize)
+					pDstData[offset++] = rlgr_mag_sign(val2);
+			}
+		}
+	}
+
+	if (offset < DstSize)
+		memset(&pDstData[offset], 0, (DstSize - offset) * sizeof(INT16));
+
+	return 1;
+}
+
+static INLINE void rlgr_write_word(RLGR_WRITER* w, UINT32 word)
+{
+	if (w->pos + 4 <= w->length)
+	{
+		w->buffer[w->pos] |= (BYTE)(word >> 24);
+		w->buffer[w->pos + 1] |= (BYTE)(word >> 16);
+		w->buffer[w->pos + 2] |= (BYTE)(word >> 8);
+		w->buffer[w->pos + 3] |= (BYTE)word;
+	}
+	else
+	{
+		for (size_t x = 0; x < 4; x++)
+		{
+			if (w->pos + x < w->length)
+				w->buffer[w->pos + x] |= (BYTE)(word >> (24 - 8 * x));
+		}
+	}
+	w->pos += 4;
+}
+
+/* Append the nbits least significant bits of value, bits past the end of the buffer are lost */
+static INLINE void rlgr_put(RLGR_WRITER* w, UINT32 value, UINT32 nbits)
+{
+	WINPR_ASSERT(nbits <= 32);
+
+	if (nbits == 0)
+		return;
+
+	w->acc = (w->acc << nbits) | (value & ((1ull << nbits) - 1ull));
+	w->bits += nbits;
+
+	if (w->bits >= 32)
+	{
+		w->bits -= 32;
+		rlgr_write_word(w, (UINT32)(w->acc >> w->bits));
+	}
+}
+
+static INLINE void rlgr_put_repeat(RLGR_WRITER* w, UINT32 count, BOOL bit)
+{
+	const UINT32 pattern = bit ? UINT32_MAX : 0;
+
+	for (; count >= 32; count -= 32)
+		rlgr_put(w, pattern, 32);
+	rlgr_put(w, pattern, count);
+}
+
+/* Write the pending bits padded to a full byte, returns the number of bytes written */
+static INLINE size_t rlgr_flush(RLGR_WRITER* w)
+{
+	/* rfx_bitstream_flush pads with as many zero bits as the last byte already holds, which
+	 * adds a zero byte if that is more than half full. Keep the encoded size identical. */
+	rlgr_put(w, 0, w->bits % 8);
+
+	while (w->bits > 0)
+	{
+		const UINT32 n = (w->bits < 8) ? w->bits : 8;
+		const BYTE b = (BYTE)((w->acc >> (w->bits - n)) << (8 - n));
+
+		if (w->pos < w->length)
+			w->buffer[w->pos] |= b;
+		w->pos++;
+		w->bits -= n;
+	}
+
+	return (w->pos < w->length) ? w->pos : w->length;
+}
+
+static INLINE void rlgr_put_gr(RLGR_WRITER* w, UINT32* krp, UINT32 val)
+{
+	const UINT32 kr = *krp >> LSGR;
+
+	/* unary part of GR code */
+	const UINT32 vk = val >> kr;
+	rlgr_put_repeat(w, vk, TRUE);
+	rlgr_put(w, 0, 1);
+
+	/* remainder part of GR code, if needed */
+	rlgr_put(w, val, kr);
+
+	if (vk == 0)
+		*krp = (*krp > 2) ? *krp - 2 : 0;
+	else if (vk > 1)
+	{
+		*krp += vk;
+		if (*krp > KPMAX)
+			*krp = KPMAX;
+	}
+}
+
+/* Index of the first nonzero coefficient in [index, size) or size */
+static INLINE size_t rlgr_skip_zeros(const INT16* WINPR_RESTRICT data, size_t index, size_t size)
+{
+	while (index + 4 <= size)
+	{
+		UINT64 v = 0;
+		memcpy(&v, &data[index], sizeof(v));
+		if (v)
+			break;
+		index += 4;
+	}
+
+	while ((index < size) && (data[index] == 0))
+		index++;
+
+	return index;
+}
+
+int rfx_rlgr_encode_fast(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 data_size,
+                         BYTE* WINPR_RESTRICT buffer, UINT32 buffer_size)
+{
+	UINT32 k = 1;
+	UINT32 kp = 1 << LSGR;
+	UINT32 krp = 1 << LSGR;
+	size_t index = 0;
+	RLGR_WRITER w = { 0 };
+
+	InitOnceExecuteOnce(&rfx_rlgr_init_once, rfx_rlgr_init, NULL, NULL);
+
+	w.buffer = buffer;
+	w.length = buffer_size;
+
+	/* process all the input coefficients, coefficients past the end read as 0 */
+	while (index < data_size)
+	{
+		if (k)
+		{
+			/* RUN-LENGTH MODE */
+			INT32 input = 0;
+			const size_t next = rlgr_skip_zeros(data, index, data_size);
+			size_t numZeros = next - index;
+
+			if (next < data_size)
+			{
+				input = data[next];
+				index = next + 1;
+			}
+			else
+			{
+				/* a trailing run of zeros is terminated by its last zero */
+				numZeros--;
+				index = data_size;
+			}
+
+			/* emit output zeros */
+			size_t runmax = 1ull << k;
+			while (numZeros >= runmax)
+			{
+				rlgr_put(&w, 0, 1);
+				numZeros -= runmax;
+				kp += UP_GR;
+				if (kp > KPMAX)
+					kp = KPMAX;
+				k = kp >> LSGR;
+				runmax = 1ull << k;
+			}
+
+			/* output a 1 to terminate runs */
+			rlgr_put(&w, 1, 1);
+
+			/* output the remaining run length using k bits */
+			rlgr_put(&w, (UINT32)numZeros, k);
+
+			/* encode the nonzero value using GR coding */
+			const UINT32 mag = (UINT32)(input < 0 ? -input : input);
+			rlgr_put(&w, input < 0 ? 1 : 0, 1);
+			rlgr_put_gr(&w, &krp, mag ? mag - 1 : 0);
+
+			kp = (kp > DN_GR) ? kp - DN_GR : 0;
+			k = kp >> LSGR;
+		}
+		else if (mode == RLGR1)
+		{
+			/* GOLOMB-RICE MODE, RLGR1 variant */
+			const UINT32 twoMs = Get2MagSign(data[index++]);
+
+			rlgr_put_gr(&w, &krp, twoMs);
+
+			if (twoMs)
+				kp = (kp > DQ_GR) ? kp - DQ_GR : 0;
+			else
+			{
+				kp += UQ_GR;
+				if (kp > KPMAX)
+					kp = KPMAX;
+			}
+			k = kp >> LSGR;
+		}
+		else
+		{
+			/* GOLOMB-RICE MODE, RLGR3 variant */
+			const UINT32 twoMs1 = Get2MagSign(data[index++]);
+			const UINT32 twoMs2 = (index < data_size) ? Get2MagSign(data[index++]) : 0;
+			const UINT32 sum2Ms = twoMs1 + twoMs2;
+
+			rlgr_put_gr(&w, &krp, sum2Ms);
+
+			/* encode binary representation of the first input (twoMs1) */
+			rlgr_put(&w, twoMs1, sum2Ms ? 32 - lzcnt_s(sum2Ms) : 0);
+
+			if (twoMs1 && twoMs2)
+			{
+				kp = (kp > 2 * DQ_GR) ? kp - 2 * DQ_GR : 0;
+				k = kp >> LSGR;
+			}
+			else if (!twoMs1 && !twoMs2)
+			{
+				kp += 2 * UQ_GR;
+				if (kp > KPMAX)
+					kp = KPMAX;
+				k = kp >> LSGR;
+			}
+		}
+	}
+
+	return WINPR_ASSERTING_INT_CAST(int, rlgr_flush(&w));
+}
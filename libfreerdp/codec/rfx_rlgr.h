@@ -30,4 +30,13 @@ FREERDP_LOCAL int rfx_rlgr_encode(RLGR_MODE mode, const INT16* WINPR_RESTRICT da
 FREERDP_LOCAL int rfx_rlgr_decode(RLGR_MODE mode, const BYTE* WINPR_RESTRICT pSrcData,
                                   UINT32 SrcSize, INT16* WINPR_RESTRICT pDstData, UINT32 rDstSize);
 
+/* Word at a time variants, bit exact with the bit by bit reference coder above */
+FREERDP_LOCAL int rfx_rlgr_encode_fast(RLGR_MODE mode, const INT16* WINPR_RESTRICT data,
+                                       UINT32 data_size, BYTE* WINPR_RESTRICT buffer,
+                                       UINT32 buffer_size);
+
+FREERDP_LOCAL int rfx_rlgr_decode_fast(RLGR_MODE mode, const BYTE* WINPR_RESTRICT pSrcData,
+                                       UINT32 SrcSize, INT16* WINPR_RESTRICT pDstData,
+                                       UINT32 DstSize);
+
 #endif /* FREERDP_LIB_CODEC_RFX_RLGR_H */
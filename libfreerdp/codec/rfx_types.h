@@ -66,8 +66,10 @@ struct S_RFX_CONTEXT_PRIV
 	wObjectPool* TilePool;
 
 	BOOL UseThreads;
-	PTP_WORK* workObjects;
+	PTP_BATCH DecodeBatch;
+	PTP_BATCH EncodeBatch;
 	RFX_TILE_COMPOSE_WORK_PARAM* tileWorkParams;
+	size_t tileWorkParamsCount;
 
 	DWORD MinThreadCount;
 	DWORD MaxThreadCount;
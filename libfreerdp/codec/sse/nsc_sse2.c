@@ -23,395 +23,151 @@
 #include <freerdp/config.h>
 
 #include "../nsc_types.h"
+#include "../nsc_encode.h"
 #include "nsc_sse2.h"
 
 #include "../../core/simd.h"
 
 #if defined(SSE_AVX_INTRINSICS_ENABLED)
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
 #include <xmmintrin.h>
 #include <emmintrin.h>
 
 #include <freerdp/codec/color.h>
-#include <winpr/crt.h>
 #include <winpr/sysinfo.h>
 
-static BOOL nsc_encode_argb_to_aycocg_sse2(NSC_CONTEXT* context, const BYTE* data, UINT32 scanline)
+/* one channel of 16 pixels as two vectors of 16 bit values */
+static INLINE void nsc_channel_sse2(const __m128i px[4], size_t offset, __m128i* lo, __m128i* hi)
 {
-	size_t y = 0;
-
-	if (!context || !data || (scanline == 0))
-		return FALSE;
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i shift = _mm_cvtsi32_si128((int)(8 * offset));
+	const __m128i c0 = _mm_and_si128(_mm_srl_epi32(px[0], shift), mask);
+	const __m128i c1 = _mm_and_si128(_mm_srl_epi32(px[1], shift), mask);
+	const __m128i c2 = _mm_and_si128(_mm_srl_epi32(px[2], shift), mask);
+	const __m128i c3 = _mm_and_si128(_mm_srl_epi32(px[3], shift), mask);
+	*lo = _mm_packs_epi32(c0, c1);
+	*hi = _mm_packs_epi32(c2, c3);
+}
 
-	const UINT16 tempWidth = ROUND_UP_TO(context->width, 8);
-	const UINT16 rw = (context->ChromaSubsamplingLevel > 0 ? tempWidth : context->width);
+/* the low bytes of two vectors of 16 bit values, truncating like a cast to BYTE */
+static INLINE __m128i nsc_pack_sse2(__m128i lo, __m128i hi)
+{
+	const __m128i mask = _mm_set1_epi16(0xFF);
+	return _mm_packus_epi16(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+}
 
-	const BYTE ccl = WINPR_ASSERTING_INT_CAST(BYTE, context->ColorLossLevel);
+static void nsc_encode_row_sse2(const NSC_CONTEXT* WINPR_RESTRICT context,
+                                const BYTE* WINPR_RESTRICT src, BYTE* WINPR_RESTRICT yplane,
+                                BYTE* WINPR_RESTRICT coplane, BYTE* WINPR_RESTRICT cgplane,
+                                BYTE* WINPR_RESTRICT aplane, UINT32 width)
+{
+	size_t r = 0;
+	size_t g = 1;
+	size_t b = 0;
+	BOOL alpha = FALSE;
 
-	for (; y < context->height; y++)
+	switch (context->format)
 	{
-		const BYTE* src = data + (context->height - 1 - y) * scanline;
-		BYTE* yplane = context->priv->PlaneBuffers[0] + y * rw;
-		BYTE* coplane = context->priv->PlaneBuffers[1] + y * rw;
-		BYTE* cgplane = context->priv->PlaneBuffers[2] + y * rw;
-		BYTE* aplane = context->priv->PlaneBuffers[3] + y * context->width;
-
-		for (UINT16 x = 0; x < context->width; x += 8)
-		{
-			__m128i r_val = { 0 };
-			__m128i g_val = { 0 };
-			__m128i b_val = { 0 };
-			__m128i a_val = { 0 };
-
-			switch (context->format)
-			{
-				case PIXEL_FORMAT_BGRX32:
-					b_val = _mm_set_epi16(*(src + 28), *(src + 24), *(src + 20), *(src + 16),
-					                      *(src + 12), *(src + 8), *(src + 4), *src);
-					g_val = _mm_set_epi16(*(src + 29), *(src + 25), *(src + 21), *(src + 17),
-					                      *(src + 13), *(src + 9), *(src + 5), *(src + 1));
-					r_val = _mm_set_epi16(*(src + 30), *(src + 26), *(src + 22), *(src + 18),
-					                      *(src + 14), *(src + 10), *(src + 6), *(src + 2));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 32;
-					break;
-
-				case PIXEL_FORMAT_BGRA32:
-					b_val = _mm_set_epi16(*(src + 28), *(src + 24), *(src + 20), *(src + 16),
-					                      *(src + 12), *(src + 8), *(src + 4), *src);
-					g_val = _mm_set_epi16(*(src + 29), *(src + 25), *(src + 21), *(src + 17),
-					                      *(src + 13), *(src + 9), *(src + 5), *(src + 1));
-					r_val = _mm_set_epi16(*(src + 30), *(src + 26), *(src + 22), *(src + 18),
-					                      *(src + 14), *(src + 10), *(src + 6), *(src + 2));
-					a_val = _mm_set_epi16(*(src + 31), *(src + 27), *(src + 23), *(src + 19),
-					                      *(src + 15), *(src + 11), *(src + 7), *(src + 3));
-					src += 32;
-					break;
-
-				case PIXEL_FORMAT_RGBX32:
-					r_val = _mm_set_epi16(*(src + 28), *(src + 24), *(src + 20), *(src + 16),
-					                      *(src + 12), *(src + 8), *(src + 4), *src);
-					g_val = _mm_set_epi16(*(src + 29), *(src + 25), *(src + 21), *(src + 17),
-					                      *(src + 13), *(src + 9), *(src + 5), *(src + 1));
-					b_val = _mm_set_epi16(*(src + 30), *(src + 26), *(src + 22), *(src + 18),
-					                      *(src + 14), *(src + 10), *(src + 6), *(src + 2));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 32;
-					break;
-
-				case PIXEL_FORMAT_RGBA32:
-					r_val = _mm_set_epi16(*(src + 28), *(src + 24), *(src + 20), *(src + 16),
-					                      *(src + 12), *(src + 8), *(src + 4), *src);
-					g_val = _mm_set_epi16(*(src + 29), *(src + 25), *(src + 21), *(src + 17),
-					                      *(src + 13), *(src + 9), *(src + 5), *(src + 1));
-					b_val = _mm_set_epi16(*(src + 30), *(src + 26), *(src + 22), *(src + 18),
-					                      *(src + 14), *(src + 10), *(src + 6), *(src + 2));
-					a_val = _mm_set_epi16(*(src + 31), *(src + 27), *(src + 23), *(src + 19),
-					                      *(src + 15), *(src + 11), *(src + 7), *(src + 3));
-					src += 32;
-					break;
-
-				case PIXEL_FORMAT_BGR24:
-					b_val = _mm_set_epi16(*(src + 21), *(src + 18), *(src + 15), *(src + 12),
-					                      *(src + 9), *(src + 6), *(src + 3), *src);
-					g_val = _mm_set_epi16(*(src + 22), *(src + 19), *(src + 16), *(src + 13),
-					                      *(src + 10), *(src + 7), *(src + 4), *(src + 1));
-					r_val = _mm_set_epi16(*(src + 23), *(src + 20), *(src + 17), *(src + 14),
-					                      *(src + 11), *(src + 8), *(src + 5), *(src + 2));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 24;
-					break;
-
-				case PIXEL_FORMAT_RGB24:
-					r_val = _mm_set_epi16(*(src + 21), *(src + 18), *(src + 15), *(src + 12),
-					                      *(src + 9), *(src + 6), *(src + 3), *src);
-					g_val = _mm_set_epi16(*(src + 22), *(src + 19), *(src + 16), *(src + 13),
-					                      *(src + 10), *(src + 7), *(src + 4), *(src + 1));
-					b_val = _mm_set_epi16(*(src + 23), *(src + 20), *(src + 17), *(src + 14),
-					                      *(src + 11), *(src + 8), *(src + 5), *(src + 2));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 24;
-					break;
-				case PIXEL_FORMAT_BGR16:
-					b_val = _mm_set_epi16(WINPR_ASSERTING_INT_CAST(INT16, ((*(src + 15)) & 0xF8) |
-					                                                          ((*(src + 15)) >> 5)),
-					                      WINPR_ASSERTING_INT_CAST(INT16, ((*(src + 13)) & 0xF8) |
-					                                                          ((*(src + 13)) >> 5)),
-					                      WINPR_ASSERTING_INT_CAST(INT16, ((*(src + 11)) & 0xF8) |
-					                                                          ((*(src + 11)) >> 5)),
-					                      WINPR_ASSERTING_INT_CAST(INT16, ((*(src + 9)) & 0xF8) |
-					                                                          ((*(src + 9)) >> 5)),
-					                      WINPR_ASSERTING_INT_CAST(INT16, ((*(src + 7)) & 0xF8) |
-					                                                          ((*(src + 7)) >> 5)),
-					                      WINPR_ASSERTING_INT_CAST(INT16, ((*(src + 5)) & 0xF8) |
-					                                                          ((*(src + 5)) >> 5)),
-					                      WINPR_ASSERTING_INT_CAST(INT16, ((*(src + 3)) & 0xF8) |
-					                                                          ((*(src + 3)) >> 5)),
-					                      WINPR_ASSERTING_INT_CAST(INT16, ((*(src + 1)) & 0xF8) |
-					                                                          ((*(src + 1)) >> 5)));
-					g_val = _mm_set_epi16(
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 15)) & 0x07) << 5) |
-					                                        (((*(src + 14)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 13)) & 0x07) << 5) |
-					                                        (((*(src + 12)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 11)) & 0x07) << 5) |
-					                                        (((*(src + 10)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 9)) & 0x07) << 5) |
-					                                        (((*(src + 8)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 7)) & 0x07) << 5) |
-					                                        (((*(src + 6)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 5)) & 0x07) << 5) |
-					                                        (((*(src + 4)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 3)) & 0x07) << 5) |
-					                                        (((*(src + 2)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 1)) & 0x07) << 5) |
-					                                        (((*src) & 0xE0) >> 3)));
-					r_val = _mm_set_epi16(
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 14)) & 0x1F) << 3) |
-					                                        (((*(src + 14)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 12)) & 0x1F) << 3) |
-					                                        (((*(src + 12)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 10)) & 0x1F) << 3) |
-					                                        (((*(src + 10)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 8)) & 0x1F) << 3) |
-					                                        (((*(src + 8)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 6)) & 0x1F) << 3) |
-					                                        (((*(src + 6)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 4)) & 0x1F) << 3) |
-					                                        (((*(src + 4)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 2)) & 0x1F) << 3) |
-					                                        (((*(src + 2)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16,
-					                             (((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07)));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 16;
-					break;
-
-				case PIXEL_FORMAT_RGB16:
-					r_val = _mm_set_epi16(
-					    WINPR_ASSERTING_INT_CAST(INT16, ((src[15] & 0xF8) | (src[15] >> 5))),
-					    WINPR_ASSERTING_INT_CAST(INT16, ((src[13] & 0xF8) | (src[13] >> 5))),
-					    WINPR_ASSERTING_INT_CAST(INT16, ((src[11] & 0xF8) | (src[11] >> 5))),
-					    WINPR_ASSERTING_INT_CAST(INT16, ((src[9] & 0xF8) | (src[9] >> 5))),
-					    WINPR_ASSERTING_INT_CAST(INT16, ((src[7] & 0xF8) | (src[7] >> 5))),
-					    WINPR_ASSERTING_INT_CAST(INT16, ((src[5] & 0xF8) | (src[5] >> 5))),
-					    WINPR_ASSERTING_INT_CAST(INT16, ((src[3] & 0xF8) | (src[3] >> 5))),
-					    WINPR_ASSERTING_INT_CAST(INT16, ((src[1] & 0xF8) | (src[1] >> 5))));
-					g_val = _mm_set_epi16(
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 15)) & 0x07) << 5) |
-					                                        (((*(src + 14)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 13)) & 0x07) << 5) |
-					                                        (((*(src + 12)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 11)) & 0x07) << 5) |
-					                                        (((*(src + 10)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 9)) & 0x07) << 5) |
-					                                        (((*(src + 8)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 7)) & 0x07) << 5) |
-					                                        (((*(src + 6)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 5)) & 0x07) << 5) |
-					                                        (((*(src + 4)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 3)) & 0x07) << 5) |
-					                                        (((*(src + 2)) & 0xE0) >> 3)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 1)) & 0x07) << 5) |
-					                                        (((*src) & 0xE0) >> 3)));
-					b_val = _mm_set_epi16(
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 14)) & 0x1F) << 3) |
-					                                        (((*(src + 14)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 12)) & 0x1F) << 3) |
-					                                        (((*(src + 12)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 10)) & 0x1F) << 3) |
-					                                        (((*(src + 10)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 8)) & 0x1F) << 3) |
-					                                        (((*(src + 8)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 6)) & 0x1F) << 3) |
-					                                        (((*(src + 6)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 4)) & 0x1F) << 3) |
-					                                        (((*(src + 4)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16, (((*(src + 2)) & 0x1F) << 3) |
-					                                        (((*(src + 2)) >> 2) & 0x07)),
-					    WINPR_ASSERTING_INT_CAST(INT16,
-					                             (((*src) & 0x1F) << 3) | (((*src) >> 2) & 0x07)));
-					a_val = _mm_set1_epi16(0xFF);
-					src += 16;
-					break;
-
-				case PIXEL_FORMAT_A4:
-				{
-					BYTE idx[8] = { 0 };
-
-					for (int shift = 7; shift >= 0; shift--)
-					{
-						idx[shift] = ((*src) >> shift) & 1;
-						idx[shift] |= (((*(src + 1)) >> shift) & 1) << 1;
-						idx[shift] |= (((*(src + 2)) >> shift) & 1) << 2;
-						idx[shift] |= (((*(src + 3)) >> shift) & 1) << 3;
-						idx[shift] *= 3;
-					}
-
-					r_val = _mm_set_epi16(context->palette[idx[0]], context->palette[idx[1]],
-					                      context->palette[idx[2]], context->palette[idx[3]],
-					                      context->palette[idx[4]], context->palette[idx[5]],
-					                      context->palette[idx[6]], context->palette[idx[7]]);
-					g_val =
-					    _mm_set_epi16(context->palette[idx[0] + 1], context->palette[idx[1] + 1],
-					                  context->palette[idx[2] + 1], context->palette[idx[3] + 1],
-					                  context->palette[idx[4] + 1], context->palette[idx[5] + 1],
-					                  context->palette[idx[6] + 1], context->palette[idx[7] + 1]);
-					b_val =
-					    _mm_set_epi16(context->palette[idx[0] + 2], context->palette[idx[1] + 2],
-					                  context->palette[idx[2] + 2], context->palette[idx[3] + 2],
-					                  context->palette[idx[4] + 2], context->palette[idx[5] + 2],
-					                  context->palette[idx[6] + 2], context->palette[idx[7] + 2]);
-					src += 4;
-				}
-
-					a_val = _mm_set1_epi16(0xFF);
-					break;
-
-				case PIXEL_FORMAT_RGB8:
-				{
-					r_val = _mm_set_epi16(context->palette[(*(src + 7ULL)) * 3ULL],
-					                      context->palette[(*(src + 6ULL)) * 3ULL],
-					                      context->palette[(*(src + 5ULL)) * 3ULL],
-					                      context->palette[(*(src + 4ULL)) * 3ULL],
-					                      context->palette[(*(src + 3ULL)) * 3ULL],
-					                      context->palette[(*(src + 2ULL)) * 3ULL],
-					                      context->palette[(*(src + 1ULL)) * 3ULL],
-					                      context->palette[(*src) * 3ULL]);
-					g_val = _mm_set_epi16(context->palette[(*(src + 7ULL)) * 3ULL + 1ULL],
-					                      context->palette[(*(src + 6ULL)) * 3ULL + 1ULL],
-					                      context->palette[(*(src + 5ULL)) * 3ULL + 1ULL],
-					                      context->palette[(*(src + 4ULL)) * 3ULL + 1ULL],
-					                      context->palette[(*(src + 3ULL)) * 3ULL + 1ULL],
-					                      context->palette[(*(src + 2ULL)) * 3ULL + 1ULL],
-					                      context->palette[(*(src + 1ULL)) * 3ULL + 1ULL],
-					                      context->palette[(*src) * 3ULL + 1ULL]);
-					b_val = _mm_set_epi16(context->palette[(*(src + 7ULL)) * 3ULL + 2ULL],
-					                      context->palette[(*(src + 6ULL)) * 3ULL + 2ULL],
-					                      context->palette[(*(src + 5ULL)) * 3ULL + 2ULL],
-					                      context->palette[(*(src + 4ULL)) * 3ULL + 2ULL],
-					                      context->palette[(*(src + 3ULL)) * 3ULL + 2ULL],
-					                      context->palette[(*(src + 2ULL)) * 3ULL + 2ULL],
-					                      context->palette[(*(src + 1ULL)) * 3ULL + 2ULL],
-					                      context->palette[(*src) * 3ULL + 2ULL]);
-					src += 8;
-				}
-
-					a_val = _mm_set1_epi16(0xFF);
-					break;
+		case PIXEL_FORMAT_BGRA32:
+			r = 2;
+			alpha = TRUE;
+			break;
+
+		case PIXEL_FORMAT_BGRX32:
+			r = 2;
+			break;
+
+		case PIXEL_FORMAT_RGBA32:
+			b = 2;
+			alpha = TRUE;
+			break;
+
+		case PIXEL_FORMAT_RGBX32:
+			b = 2;
+			break;
+
+		default:
+			nsc_encode_row(context, src, yplane, coplane, cgplane, aplane, width);
+			return;
+	}
 
-				default:
-					r_val = g_val = b_val = a_val = _mm_set1_epi16(0);
-					break;
-			}
+	const __m128i ccl = _mm_cvtsi32_si128((int)context->ColorLossLevel);
+	UINT32 x = 0;
 
-			__m128i y_val = _mm_srai_epi16(r_val, 2);
-			y_val = _mm_add_epi16(y_val, _mm_srai_epi16(g_val, 1));
-			y_val = _mm_add_epi16(y_val, _mm_srai_epi16(b_val, 2));
-			__m128i co_val = _mm_sub_epi16(r_val, b_val);
-			co_val = _mm_srai_epi16(co_val, ccl);
-			__m128i cg_val = _mm_sub_epi16(g_val, _mm_srai_epi16(r_val, 1));
-			cg_val = _mm_sub_epi16(cg_val, _mm_srai_epi16(b_val, 1));
-			cg_val = _mm_srai_epi16(cg_val, ccl);
-			y_val = _mm_packus_epi16(y_val, y_val);
-			_mm_storeu_si128((__m128i*)yplane, y_val);
-			co_val = _mm_packs_epi16(co_val, co_val);
-			_mm_storeu_si128((__m128i*)coplane, co_val);
-			cg_val = _mm_packs_epi16(cg_val, cg_val);
-			_mm_storeu_si128((__m128i*)cgplane, cg_val);
-			a_val = _mm_packus_epi16(a_val, a_val);
-			_mm_storeu_si128((__m128i*)aplane, a_val);
-			yplane += 8;
-			coplane += 8;
-			cgplane += 8;
-			aplane += 8;
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i px[4] = { _mm_loadu_si128((const __m128i*)&src[4ull * x]),
+			                    _mm_loadu_si128((const __m128i*)&src[4ull * x + 16]),
+			                    _mm_loadu_si128((const __m128i*)&src[4ull * x + 32]),
+			                    _mm_loadu_si128((const __m128i*)&src[4ull * x + 48]) };
+		__m128i rv[2];
+		__m128i gv[2];
+		__m128i bv[2];
+		__m128i yv[2];
+		__m128i cov[2];
+		__m128i cgv[2];
+
+		nsc_channel_sse2(px, r, &rv[0], &rv[1]);
+		nsc_channel_sse2(px, g, &gv[0], &gv[1]);
+		nsc_channel_sse2(px, b, &bv[0], &bv[1]);
+
+		for (size_t i = 0; i < 2; i++)
+		{
+			const __m128i r2 = _mm_srli_epi16(rv[i], 2);
+			const __m128i b2 = _mm_srli_epi16(bv[i], 2);
+			yv[i] = _mm_add_epi16(_mm_add_epi16(r2, _mm_srli_epi16(gv[i], 1)), b2);
+			cov[i] = _mm_sra_epi16(_mm_sub_epi16(rv[i], bv[i]), ccl);
+			cgv[i] = _mm_sub_epi16(gv[i], _mm_srli_epi16(rv[i], 1));
+			cgv[i] = _mm_sra_epi16(_mm_sub_epi16(cgv[i], _mm_srli_epi16(bv[i], 1)), ccl);
 		}
 
-		if (context->ChromaSubsamplingLevel > 0 && (context->width % 2) == 1)
+		_mm_storeu_si128((__m128i*)&yplane[x], _mm_packus_epi16(yv[0], yv[1]));
+		_mm_storeu_si128((__m128i*)&coplane[x], nsc_pack_sse2(cov[0], cov[1]));
+		_mm_storeu_si128((__m128i*)&cgplane[x], nsc_pack_sse2(cgv[0], cgv[1]));
+
+		if (alpha)
 		{
-			context->priv->PlaneBuffers[0][y * rw + context->width] =
-			    context->priv->PlaneBuffers[0][y * rw + context->width - 1];
-			context->priv->PlaneBuffers[1][y * rw + context->width] =
-			    context->priv->PlaneBuffers[1][y * rw + context->width - 1];
-			context->priv->PlaneBuffers[2][y * rw + context->width] =
-			    context->priv->PlaneBuffers[2][y * rw + context->width - 1];
+			__m128i av[2];
+			nsc_channel_sse2(px, 3, &av[0], &av[1]);
+			_mm_storeu_si128((__m128i*)&aplane[x], _mm_packus_epi16(av[0], av[1]));
 		}
+		else
+			_mm_storeu_si128((__m128i*)&aplane[x], _mm_set1_epi8((char)0xFF));
 	}
 
-	if (context->ChromaSubsamplingLevel > 0 && (y % 2) == 1)
-	{
-		BYTE* yplane = context->priv->PlaneBuffers[0] + y * rw;
-		BYTE* coplane = context->priv->PlaneBuffers[1] + y * rw;
-		BYTE* cgplane = context->priv->PlaneBuffers[2] + y * rw;
-		CopyMemory(yplane, yplane - rw, rw);
-		CopyMemory(coplane, coplane - rw, rw);
-		CopyMemory(cgplane, cgplane - rw, rw);
-	}
+	nsc_encode_row(context, &src[4ull * x], &yplane[x], &coplane[x], &cgplane[x], &aplane[x],
+	               width - x);
+}
 
-	return TRUE;
+/* the signed bytes at even and odd positions as 16 bit values */
+static INLINE __m128i nsc_pair_sum_sse2(__m128i v)
+{
+	const __m128i even = _mm_srai_epi16(_mm_slli_epi16(v, 8), 8);
+	const __m128i odd = _mm_srai_epi16(v, 8);
+	return _mm_add_epi16(even, odd);
 }
 
-static void nsc_encode_subsampling_sse2(NSC_CONTEXT* context)
+static void nsc_subsample_row_sse2(const BYTE* WINPR_RESTRICT src0,
+                                   const BYTE* WINPR_RESTRICT src1, BYTE* WINPR_RESTRICT dst,
+                                   UINT32 width)
 {
-	BYTE* co_dst = NULL;
-	BYTE* cg_dst = NULL;
-	INT8* co_src0 = NULL;
-	INT8* co_src1 = NULL;
-	INT8* cg_src0 = NULL;
-	INT8* cg_src1 = NULL;
-	UINT32 tempWidth = 0;
-	UINT32 tempHeight = 0;
-	__m128i t;
-	__m128i val;
-	__m128i mask = _mm_set1_epi16(0xFF);
-	tempWidth = ROUND_UP_TO(context->width, 8);
-	tempHeight = ROUND_UP_TO(context->height, 2);
+	UINT32 x = 0;
 
-	for (size_t y = 0; y < tempHeight >> 1; y++)
+	for (; x + 16 <= width; x += 16)
 	{
-		co_dst = context->priv->PlaneBuffers[1] + y * (tempWidth >> 1);
-		cg_dst = context->priv->PlaneBuffers[2] + y * (tempWidth >> 1);
-		co_src0 = (INT8*)context->priv->PlaneBuffers[1] + (y << 1) * tempWidth;
-		co_src1 = co_src0 + tempWidth;
-		cg_src0 = (INT8*)context->priv->PlaneBuffers[2] + (y << 1) * tempWidth;
-		cg_src1 = cg_src0 + tempWidth;
+		__m128i sum[2];
 
-		for (UINT32 x = 0; x < tempWidth >> 1; x += 8)
+		for (size_t i = 0; i < 2; i++)
 		{
-			t = _mm_loadu_si128((__m128i*)co_src0);
-			t = _mm_avg_epu8(t, _mm_loadu_si128((__m128i*)co_src1));
-			val = _mm_and_si128(_mm_srli_si128(t, 1), mask);
-			val = _mm_avg_epu16(val, _mm_and_si128(t, mask));
-			val = _mm_packus_epi16(val, val);
-			_mm_storeu_si128((__m128i*)co_dst, val);
-			co_dst += 8;
-			co_src0 += 16;
-			co_src1 += 16;
-			t = _mm_loadu_si128((__m128i*)cg_src0);
-			t = _mm_avg_epu8(t, _mm_loadu_si128((__m128i*)cg_src1));
-			val = _mm_and_si128(_mm_srli_si128(t, 1), mask);
-			val = _mm_avg_epu16(val, _mm_and_si128(t, mask));
-			val = _mm_packus_epi16(val, val);
-			_mm_storeu_si128((__m128i*)cg_dst, val);
-			cg_dst += 8;
-			cg_src0 += 16;
-			cg_src1 += 16;
+			const __m128i a = _mm_loadu_si128((const __m128i*)&src0[2ull * x + 16 * i]);
+			const __m128i b = _mm_loadu_si128((const __m128i*)&src1[2ull * x + 16 * i]);
+			sum[i] = _mm_add_epi16(nsc_pair_sum_sse2(a), nsc_pair_sum_sse2(b));
+			sum[i] = _mm_srai_epi16(sum[i], 2);
 		}
-	}
-}
-
-static BOOL nsc_encode_sse2(NSC_CONTEXT* context, const BYTE* data, UINT32 scanline)
-{
-	if (!nsc_encode_argb_to_aycocg_sse2(context, data, scanline))
-		return FALSE;
 
-	if (context->ChromaSubsamplingLevel > 0)
-		nsc_encode_subsampling_sse2(context);
+		_mm_storeu_si128((__m128i*)&dst[x], nsc_pack_sse2(sum[0], sum[1]));
+	}
 
-	return TRUE;
+	nsc_subsample_row(&src0[2ull * x], &src1[2ull * x], &dst[x], width - x);
 }
 #endif
 
@@ -422,7 +178,8 @@ void nsc_init_sse2(NSC_CONTEXT* context)
 		return;
 
 	PROFILER_RENAME(context->priv->prof_nsc_encode, "nsc_encode_sse2")
-	context->encode = nsc_encode_sse2;
+	context->encode_row = nsc_encode_row_sse2;
+	context->subsample_row = nsc_subsample_row_sse2;
 #else
 	WINPR_UNUSED(context);
 #endif
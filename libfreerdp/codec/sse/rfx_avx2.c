@@ -0,0 +1,289 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * RemoteFX Codec Library - AVX2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "../rfx_types.h"
+#include "rfx_avx2.h"
+
+#include "../../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <winpr/sysinfo.h>
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define __attribute__(...)
+#endif
+
+#ifndef __clang__
+#define ATTRIBUTES __gnu_inline__, __always_inline__, __artificial__
+#else
+#define ATTRIBUTES __gnu_inline__, __always_inline__
+#endif
+
+/* (a + b) / 2 rounded towards zero like the reference decoder, without 16 bit overflow */
+static __inline __m256i __attribute__((ATTRIBUTES)) mm256_idwt_avg_epi16(__m256i a, __m256i b)
+{
+	const __m256i x = _mm256_xor_si256(a, b);
+	const __m256i avg = _mm256_add_epi16(_mm256_and_si256(a, b), _mm256_srai_epi16(x, 1));
+	const __m256i odd = _mm256_and_si256(x, _mm256_set1_epi16(1));
+	return _mm256_add_epi16(avg, _mm256_and_si256(odd, _mm256_srli_epi16(avg, 15)));
+}
+
+static __inline __m256i __attribute__((ATTRIBUTES)) mm256_idwt_half_epi16(__m256i a)
+{
+	return _mm256_srai_epi16(_mm256_add_epi16(a, _mm256_srli_epi16(a, 15)), 1);
+}
+
+/* 8 samples of two rows, one per 128 bit lane */
+static __inline __m256i __attribute__((ATTRIBUTES))
+mm256_idwt_load_rows(const INT16* WINPR_RESTRICT lo, const INT16* WINPR_RESTRICT hi)
+{
+	const __m256i v = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)lo));
+	return _mm256_inserti128_si256(v, _mm_loadu_si128((const __m128i*)hi), 1);
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+mm256_idwt_store_rows(INT16* WINPR_RESTRICT lo, INT16* WINPR_RESTRICT hi, __m256i v)
+{
+	_mm_storeu_si128((__m128i*)lo, _mm256_castsi256_si128(v));
+	_mm_storeu_si128((__m128i*)hi, _mm256_extracti128_si256(v, 1));
+}
+
+/* The last two to four samples of a row, X2 is the last even sample written by the vector loop */
+static __inline void __attribute__((ATTRIBUTES))
+rfx_idwt_extrapolate_horiz_tail_avx2(const INT16* WINPR_RESTRICT pL, INT16 H0, INT16 X2,
+                                     INT16* WINPR_RESTRICT pX, size_t nLowCount,
+                                     size_t nHighCount)
+{
+	if (nLowCount <= (nHighCount + 1))
+	{
+		if (nLowCount <= nHighCount)
+		{
+			pX[0] = X2;
+			pX[1] = (INT16)(X2 + (2 * H0));
+		}
+		else
+		{
+			const INT16 X0 = (INT16)(pL[0] - H0);
+			pX[0] = X2;
+			pX[1] = (INT16)(((X0 + X2) / 2) + (2 * H0));
+			pX[2] = X0;
+		}
+	}
+	else
+	{
+		const INT16 X0 = (INT16)(pL[0] - (H0 / 2));
+		pX[0] = X2;
+		pX[1] = (INT16)(((X0 + X2) / 2) + (2 * H0));
+		pX[2] = X0;
+		pX[3] = (INT16)((X0 + pL[1]) / 2);
+	}
+}
+
+/* The rows are at most 31 high band samples long, so two rows are processed at once instead of
+ * 16 samples of one row. */
+static __inline void __attribute__((ATTRIBUTES))
+rfx_idwt_extrapolate_horiz_avx2(const INT16* WINPR_RESTRICT pLowBand, size_t nLowStep,
+                                const INT16* WINPR_RESTRICT pHighBand, size_t nHighStep,
+                                INT16* WINPR_RESTRICT pDstBand, size_t nDstStep, size_t nLowCount,
+                                size_t nHighCount, size_t nDstCount)
+{
+	INT16 even[2][40] = { { 0 } };
+
+	WINPR_ASSERT(nHighCount >= 8);
+	WINPR_ASSERT(nHighCount < ARRAYSIZE(even[0]));
+	WINPR_ASSERT(nDstCount >= 2);
+
+	/* a single last row is done together with the previous one */
+	for (size_t i = 0; i < nDstCount; i += 2)
+	{
+		const size_t r = MIN(i, nDstCount - 2);
+		const INT16* pL[2] = { &pLowBand[r * nLowStep], &pLowBand[(r + 1) * nLowStep] };
+		const INT16* pH[2] = { &pHighBand[r * nHighStep], &pHighBand[(r + 1) * nHighStep] };
+		INT16* pX[2] = { &pDstBand[r * nDstStep], &pDstBand[(r + 1) * nDstStep] };
+
+		/* even[n] = L[n] - (H[n - 1] + H[n]) / 2, the first one uses H[0] as left neighbour.
+		 * A partial last batch is moved back to overlap the previous one. */
+		for (size_t n = 0; n < nHighCount; n += 8)
+		{
+			const size_t k = MIN(n, nHighCount - 8);
+			const __m256i l = mm256_idwt_load_rows(&pL[0][k], &pL[1][k]);
+			const __m256i h = mm256_idwt_load_rows(&pH[0][k], &pH[1][k]);
+			__m256i hp;
+
+			if (k == 0)
+			{
+				hp = _mm256_insert_epi16(_mm256_slli_si256(h, 2), pH[0][0], 0);
+				hp = _mm256_insert_epi16(hp, pH[1][0], 8);
+			}
+			else
+				hp = mm256_idwt_load_rows(&pH[0][k - 1], &pH[1][k - 1]);
+
+			mm256_idwt_store_rows(&even[0][k], &even[1][k],
+			                      _mm256_sub_epi16(l, mm256_idwt_avg_epi16(hp, h)));
+		}
+
+		/* odd[n] = (even[n] + even[n + 1]) / 2 + 2 * H[n], the last pair is done by the tail */
+		for (size_t n = 0; n < nHighCount; n += 8)
+		{
+			const size_t k = MIN(n, nHighCount - 8);
+			const __m256i e0 = mm256_idwt_load_rows(&even[0][k], &even[1][k]);
+			const __m256i e1 = mm256_idwt_load_rows(&even[0][k + 1], &even[1][k + 1]);
+			const __m256i h = mm256_idwt_load_rows(&pH[0][k], &pH[1][k]);
+			const __m256i o =
+			    _mm256_add_epi16(mm256_idwt_avg_epi16(e0, e1), _mm256_slli_epi16(h, 1));
+			mm256_idwt_store_rows(&pX[0][2 * k], &pX[1][2 * k], _mm256_unpacklo_epi16(e0, o));
+			mm256_idwt_store_rows(&pX[0][2 * k + 8], &pX[1][2 * k + 8],
+			                      _mm256_unpackhi_epi16(e0, o));
+		}
+
+		for (size_t y = 0; y < 2; y++)
+			rfx_idwt_extrapolate_horiz_tail_avx2(&pL[y][nHighCount], pH[y][nHighCount - 1],
+			                                     even[y][nHighCount - 1],
+			                                     &pX[y][2 * (nHighCount - 1)], nLowCount,
+			                                     nHighCount);
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_idwt_extrapolate_vert_avx2(const INT16* WINPR_RESTRICT pLowBand, size_t nLowStep,
+                               const INT16* WINPR_RESTRICT pHighBand, size_t nHighStep,
+                               INT16* WINPR_RESTRICT pDstBand, size_t nDstStep, size_t nLowCount,
+                               size_t nHighCount, size_t nDstCount)
+{
+	WINPR_ASSERT(nDstCount >= 16);
+
+	/* 16 columns at once, a partial last batch is moved back to overlap the previous one */
+	for (size_t i = 0; i < nDstCount; i += 16)
+	{
+		const size_t k = MIN(i, nDstCount - 16);
+		const INT16* pL = &pLowBand[k];
+		const INT16* pH = &pHighBand[k];
+		INT16* pX = &pDstBand[k];
+		__m256i h0 = _mm256_loadu_si256((const __m256i*)pH);
+		__m256i x0 = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)pL), h0);
+		__m256i x2 = x0;
+
+		for (size_t n = 1; n < nHighCount; n++)
+		{
+			pL += nLowStep;
+			pH += nHighStep;
+			const __m256i h1 = _mm256_loadu_si256((const __m256i*)pH);
+			x2 = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)pL),
+			                      mm256_idwt_avg_epi16(h0, h1));
+			const __m256i x1 =
+			    _mm256_add_epi16(mm256_idwt_avg_epi16(x0, x2), _mm256_slli_epi16(h0, 1));
+			_mm256_storeu_si256((__m256i*)pX, x0);
+			pX += nDstStep;
+			_mm256_storeu_si256((__m256i*)pX, x1);
+			pX += nDstStep;
+			x0 = x2;
+			h0 = h1;
+		}
+
+		pL += nLowStep;
+
+		if (nLowCount <= (nHighCount + 1))
+		{
+			if (nLowCount <= nHighCount)
+			{
+				_mm256_storeu_si256((__m256i*)pX, x2);
+				pX += nDstStep;
+				_mm256_storeu_si256((__m256i*)pX, _mm256_add_epi16(x2, _mm256_slli_epi16(h0, 1)));
+			}
+			else
+			{
+				x0 = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)pL), h0);
+				_mm256_storeu_si256((__m256i*)pX, x2);
+				pX += nDstStep;
+				_mm256_storeu_si256((__m256i*)pX, _mm256_add_epi16(mm256_idwt_avg_epi16(x0, x2),
+				                                                   _mm256_slli_epi16(h0, 1)));
+				pX += nDstStep;
+				_mm256_storeu_si256((__m256i*)pX, x0);
+			}
+		}
+		else
+		{
+			x0 = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)pL),
+			                      mm256_idwt_half_epi16(h0));
+			pL += nLowStep;
+			_mm256_storeu_si256((__m256i*)pX, x2);
+			pX += nDstStep;
+			_mm256_storeu_si256((__m256i*)pX, _mm256_add_epi16(mm256_idwt_avg_epi16(x0, x2),
+			                                                   _mm256_slli_epi16(h0, 1)));
+			pX += nDstStep;
+			_mm256_storeu_si256((__m256i*)pX, x0);
+			pX += nDstStep;
+			_mm256_storeu_si256((__m256i*)pX,
+			                    mm256_idwt_avg_epi16(x0, _mm256_loadu_si256((const __m256i*)pL)));
+		}
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_extrapolate_decode_block_avx2(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RESTRICT temp,
+                                         size_t level)
+{
+	const size_t nBandL = (64 >> level) + 1;
+	const size_t nBandH = (level == 1) ? 31 : ((64 + (1 << (level - 1))) >> level);
+	const size_t nDstStep = nBandL + nBandH;
+	const INT16* HL = &buffer[0];
+	const INT16* LH = &HL[nBandH * nBandL];
+	const INT16* HH = &LH[nBandL * nBandH];
+	const INT16* LL = &HH[nBandH * nBandH];
+	INT16* L = &temp[0];
+	INT16* H = &temp[nBandL * nDstStep];
+
+	/* horizontal (LL + HL -> L) */
+	rfx_idwt_extrapolate_horiz_avx2(LL, nBandL, HL, nBandH, L, nDstStep, nBandL, nBandH, nBandL);
+
+	/* horizontal (LH + HH -> H) */
+	rfx_idwt_extrapolate_horiz_avx2(LH, nBandL, HH, nBandH, H, nDstStep, nBandL, nBandH, nBandH);
+
+	/* vertical (L + H -> LL) */
+	rfx_idwt_extrapolate_vert_avx2(L, nDstStep, H, nDstStep, buffer, nDstStep, nBandL, nBandH,
+	                               nBandL + nBandH);
+}
+
+static void rfx_dwt_2d_extrapolate_decode_avx2(INT16* WINPR_RESTRICT buffer,
+                                               INT16* WINPR_RESTRICT temp)
+{
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(temp);
+
+	rfx_dwt_2d_extrapolate_decode_block_avx2(&buffer[3807], temp, 3);
+	rfx_dwt_2d_extrapolate_decode_block_avx2(&buffer[3007], temp, 2);
+	rfx_dwt_2d_extrapolate_decode_block_avx2(&buffer[0], temp, 1);
+}
+#endif
+
+void rfx_init_avx2(RFX_CONTEXT* context)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	if (!IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	context->dwt_2d_extrapolate_decode = rfx_dwt_2d_extrapolate_decode_avx2;
+#else
+	WINPR_UNUSED(context);
+#endif
+}
@@ -448,6 +448,208 @@ static void rfx_dwt_2d_encode_sse2(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RE
 	rfx_dwt_2d_encode_block_sse2(buffer + 3072, dwt_buffer, 16);
 	rfx_dwt_2d_encode_block_sse2(buffer + 3840, dwt_buffer, 8);
 }
+
+/* The reduce-extrapolate DWT of the progressive codec rounds like the C integer division of the
+ * reference decoder (towards zero), the averages must not overflow 16 bit either. */
+static __inline __m128i __attribute__((ATTRIBUTES)) mm_idwt_avg_epi16(__m128i a, __m128i b)
+{
+	const __m128i x = _mm_xor_si128(a, b);
+	const __m128i avg = _mm_add_epi16(_mm_and_si128(a, b), _mm_srai_epi16(x, 1));
+	const __m128i odd = _mm_and_si128(x, _mm_set1_epi16(1));
+	return _mm_add_epi16(avg, _mm_and_si128(odd, _mm_srli_epi16(avg, 15)));
+}
+
+static __inline __m128i __attribute__((ATTRIBUTES)) mm_idwt_half_epi16(__m128i a)
+{
+	return _mm_srai_epi16(_mm_add_epi16(a, _mm_srli_epi16(a, 15)), 1);
+}
+
+/* The last two to four samples of a row, X2 is the last even sample written by the vector loop */
+static __inline void __attribute__((ATTRIBUTES))
+rfx_idwt_extrapolate_horiz_tail_sse2(const INT16* WINPR_RESTRICT pL, INT16 H0, INT16 X2,
+                                     INT16* WINPR_RESTRICT pX, size_t nLowCount,
+                                     size_t nHighCount)
+{
+	if (nLowCount <= (nHighCount + 1))
+	{
+		if (nLowCount <= nHighCount)
+		{
+			pX[0] = X2;
+			pX[1] = (INT16)(X2 + (2 * H0));
+		}
+		else
+		{
+			const INT16 X0 = (INT16)(pL[0] - H0);
+			pX[0] = X2;
+			pX[1] = (INT16)(((X0 + X2) / 2) + (2 * H0));
+			pX[2] = X0;
+		}
+	}
+	else
+	{
+		const INT16 X0 = (INT16)(pL[0] - (H0 / 2));
+		pX[0] = X2;
+		pX[1] = (INT16)(((X0 + X2) / 2) + (2 * H0));
+		pX[2] = X0;
+		pX[3] = (INT16)((X0 + pL[1]) / 2);
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_idwt_extrapolate_horiz_sse2(const INT16* WINPR_RESTRICT pLowBand, size_t nLowStep,
+                                const INT16* WINPR_RESTRICT pHighBand, size_t nHighStep,
+                                INT16* WINPR_RESTRICT pDstBand, size_t nDstStep, size_t nLowCount,
+                                size_t nHighCount, size_t nDstCount)
+{
+	INT16 even[40] = { 0 };
+
+	WINPR_ASSERT(nHighCount >= 8);
+	WINPR_ASSERT(nHighCount < ARRAYSIZE(even));
+
+	for (size_t i = 0; i < nDstCount; i++)
+	{
+		const INT16* pL = &pLowBand[i * nLowStep];
+		const INT16* pH = &pHighBand[i * nHighStep];
+		INT16* pX = &pDstBand[i * nDstStep];
+
+		/* even[n] = L[n] - (H[n - 1] + H[n]) / 2, the first one uses H[0] as left neighbour.
+		 * A partial last batch is moved back to overlap the previous one. */
+		for (size_t n = 0; n < nHighCount; n += 8)
+		{
+			const size_t k = MIN(n, nHighCount - 8);
+			const __m128i l = _mm_loadu_si128((const __m128i*)&pL[k]);
+			const __m128i h = _mm_loadu_si128((const __m128i*)&pH[k]);
+			const __m128i hp = (k == 0) ? _mm_insert_epi16(_mm_slli_si128(h, 2), pH[0], 0)
+			                            : _mm_loadu_si128((const __m128i*)&pH[k - 1]);
+			_mm_storeu_si128((__m128i*)&even[k], _mm_sub_epi16(l, mm_idwt_avg_epi16(hp, h)));
+		}
+
+		/* odd[n] = (even[n] + even[n + 1]) / 2 + 2 * H[n], the last pair is done by the tail */
+		for (size_t n = 0; n < nHighCount; n += 8)
+		{
+			const size_t k = MIN(n, nHighCount - 8);
+			const __m128i e0 = _mm_loadu_si128((const __m128i*)&even[k]);
+			const __m128i e1 = _mm_loadu_si128((const __m128i*)&even[k + 1]);
+			const __m128i h = _mm_loadu_si128((const __m128i*)&pH[k]);
+			const __m128i o = _mm_add_epi16(mm_idwt_avg_epi16(e0, e1), _mm_slli_epi16(h, 1));
+			_mm_storeu_si128((__m128i*)&pX[2 * k], _mm_unpacklo_epi16(e0, o));
+			_mm_storeu_si128((__m128i*)&pX[2 * k + 8], _mm_unpackhi_epi16(e0, o));
+		}
+
+		rfx_idwt_extrapolate_horiz_tail_sse2(&pL[nHighCount], pH[nHighCount - 1],
+		                                     even[nHighCount - 1], &pX[2 * (nHighCount - 1)],
+		                                     nLowCount, nHighCount);
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_idwt_extrapolate_vert_sse2(const INT16* WINPR_RESTRICT pLowBand, size_t nLowStep,
+                               const INT16* WINPR_RESTRICT pHighBand, size_t nHighStep,
+                               INT16* WINPR_RESTRICT pDstBand, size_t nDstStep, size_t nLowCount,
+                               size_t nHighCount, size_t nDstCount)
+{
+	WINPR_ASSERT(nDstCount >= 8);
+
+	/* 8 columns at once, a partial last batch is moved back to overlap the previous one */
+	for (size_t i = 0; i < nDstCount; i += 8)
+	{
+		const size_t k = MIN(i, nDstCount - 8);
+		const INT16* pL = &pLowBand[k];
+		const INT16* pH = &pHighBand[k];
+		INT16* pX = &pDstBand[k];
+		__m128i h0 = _mm_loadu_si128((const __m128i*)pH);
+		__m128i x0 = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)pL), h0);
+		__m128i x2 = x0;
+
+		for (size_t n = 1; n < nHighCount; n++)
+		{
+			pL += nLowStep;
+			pH += nHighStep;
+			const __m128i h1 = _mm_loadu_si128((const __m128i*)pH);
+			x2 = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)pL), mm_idwt_avg_epi16(h0, h1));
+			const __m128i x1 = _mm_add_epi16(mm_idwt_avg_epi16(x0, x2), _mm_slli_epi16(h0, 1));
+			_mm_storeu_si128((__m128i*)pX, x0);
+			pX += nDstStep;
+			_mm_storeu_si128((__m128i*)pX, x1);
+			pX += nDstStep;
+			x0 = x2;
+			h0 = h1;
+		}
+
+		pL += nLowStep;
+
+		if (nLowCount <= (nHighCount + 1))
+		{
+			if (nLowCount <= nHighCount)
+			{
+				_mm_storeu_si128((__m128i*)pX, x2);
+				pX += nDstStep;
+				_mm_storeu_si128((__m128i*)pX, _mm_add_epi16(x2, _mm_slli_epi16(h0, 1)));
+			}
+			else
+			{
+				x0 = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)pL), h0);
+				_mm_storeu_si128((__m128i*)pX, x2);
+				pX += nDstStep;
+				_mm_storeu_si128((__m128i*)pX, _mm_add_epi16(mm_idwt_avg_epi16(x0, x2),
+				                                             _mm_slli_epi16(h0, 1)));
+				pX += nDstStep;
+				_mm_storeu_si128((__m128i*)pX, x0);
+			}
+		}
+		else
+		{
+			x0 = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)pL), mm_idwt_half_epi16(h0));
+			pL += nLowStep;
+			_mm_storeu_si128((__m128i*)pX, x2);
+			pX += nDstStep;
+			_mm_storeu_si128((__m128i*)pX,
+			                 _mm_add_epi16(mm_idwt_avg_epi16(x0, x2), _mm_slli_epi16(h0, 1)));
+			pX += nDstStep;
+			_mm_storeu_si128((__m128i*)pX, x0);
+			pX += nDstStep;
+			_mm_storeu_si128((__m128i*)pX,
+			                 mm_idwt_avg_epi16(x0, _mm_loadu_si128((const __m128i*)pL)));
+		}
+	}
+}
+
+static __inline void __attribute__((ATTRIBUTES))
+rfx_dwt_2d_extrapolate_decode_block_sse2(INT16* WINPR_RESTRICT buffer, INT16* WINPR_RESTRICT temp,
+                                         size_t level)
+{
+	const size_t nBandL = (64 >> level) + 1;
+	const size_t nBandH = (level == 1) ? 31 : ((64 + (1 << (level - 1))) >> level);
+	const size_t nDstStep = nBandL + nBandH;
+	const INT16* HL = &buffer[0];
+	const INT16* LH = &HL[nBandH * nBandL];
+	const INT16* HH = &LH[nBandL * nBandH];
+	const INT16* LL = &HH[nBandH * nBandH];
+	INT16* L = &temp[0];
+	INT16* H = &temp[nBandL * nDstStep];
+
+	/* horizontal (LL + HL -> L) */
+	rfx_idwt_extrapolate_horiz_sse2(LL, nBandL, HL, nBandH, L, nDstStep, nBandL, nBandH, nBandL);
+
+	/* horizontal (LH + HH -> H) */
+	rfx_idwt_extrapolate_horiz_sse2(LH, nBandL, HH, nBandH, H, nDstStep, nBandL, nBandH, nBandH);
+
+	/* vertical (L + H -> LL) */
+	rfx_idwt_extrapolate_vert_sse2(L, nDstStep, H, nDstStep, buffer, nDstStep, nBandL, nBandH,
+	                               nBandL + nBandH);
+}
+
+static void rfx_dwt_2d_extrapolate_decode_sse2(INT16* WINPR_RESTRICT buffer,
+                                               INT16* WINPR_RESTRICT temp)
+{
+	WINPR_ASSERT(buffer);
+	WINPR_ASSERT(temp);
+
+	mm_prefetch_buffer((char*)buffer, 4096 * sizeof(INT16));
+	rfx_dwt_2d_extrapolate_decode_block_sse2(&buffer[3807], temp, 3);
+	rfx_dwt_2d_extrapolate_decode_block_sse2(&buffer[3007], temp, 2);
+	rfx_dwt_2d_extrapolate_decode_block_sse2(&buffer[0], temp, 1);
+}
 #endif
 
 void rfx_init_sse2(RFX_CONTEXT* context)
@@ -464,6 +666,7 @@ void rfx_init_sse2(RFX_CONTEXT* context)
 	context->quantization_encode = rfx_quantization_encode_sse2;
 	context->dwt_2d_decode = rfx_dwt_2d_decode_sse2;
 	context->dwt_2d_encode = rfx_dwt_2d_encode_sse2;
+	context->dwt_2d_extrapolate_decode = rfx_dwt_2d_extrapolate_decode_sse2;
 #else
 	WINPR_UNUSED(context);
 #endif
@@ -0,0 +1,161 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * XCrush (RDP6.1) Bulk Data Compression - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "xcrush_sse2.h"
+
+#include "../../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <winpr/sysinfo.h>
+
+#include <emmintrin.h>
+
+/**
+ * The chunking hash of XCrush is a rolling XOR of the last 32 bytes, byte p rotated left by its
+ * distance to the window end. A boundary is where the low 7 bits of the hash are zero. Those
+ * bits only depend on the 7 newest bytes (shifted left) and the 7 oldest bytes (rotated in from
+ * the top, shifted right), so every position can be tested on its own instead of rolling the
+ * hash byte by byte.
+ */
+static INLINE UINT32 xcrush_boundary_bits(const BYTE* WINPR_RESTRICT window)
+{
+	UINT32 bits = 0;
+
+	for (UINT32 s = 0; s < 7; s++)
+		bits ^= (UINT32)window[32 - s] << s;
+	for (UINT32 k = 1; k < 8; k++)
+		bits ^= (UINT32)window[k] >> k;
+	return bits & 0x7F;
+}
+
+/* Masking first keeps the 16 bit shifts from moving bits between neighbouring bytes */
+#define XCRUSH_NEWEST(acc, window, s)                                           \
+	do                                                                          \
+	{                                                                           \
+		const __m128i v = _mm_loadu_si128((const __m128i*)&(window)[32 - (s)]); \
+		const __m128i m = _mm_and_si128(v, _mm_set1_epi8((char)(0x7F >> (s)))); \
+		(acc) = _mm_xor_si128((acc), _mm_slli_epi16(m, (s)));                   \
+	} while (0)
+
+#define XCRUSH_OLDEST(acc, window, k)                                                    \
+	do                                                                                   \
+	{                                                                                    \
+		const __m128i v = _mm_loadu_si128((const __m128i*)&(window)[k]);                 \
+		const __m128i m = _mm_and_si128(v, _mm_set1_epi8((char)((0xFF << (k)) & 0xFF))); \
+		(acc) = _mm_xor_si128((acc), _mm_srli_epi16(m, (k)));                            \
+	} while (0)
+
+static UINT32 xcrush_find_boundaries_sse2(const BYTE* WINPR_RESTRICT data, UINT32 count,
+                                          UINT32* WINPR_RESTRICT boundaries)
+{
+	UINT32 found = 0;
+	UINT32 i = 0;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i low = _mm_set1_epi8(0x7F);
+
+	WINPR_ASSERT(data);
+	WINPR_ASSERT(boundaries);
+
+	for (; i + 16 <= count; i += 16)
+	{
+		const BYTE* window = &data[i];
+		__m128i acc = zero;
+
+		XCRUSH_NEWEST(acc, window, 0);
+		XCRUSH_NEWEST(acc, window, 1);
+		XCRUSH_NEWEST(acc, window, 2);
+		XCRUSH_NEWEST(acc, window, 3);
+		XCRUSH_NEWEST(acc, window, 4);
+		XCRUSH_NEWEST(acc, window, 5);
+		XCRUSH_NEWEST(acc, window, 6);
+		XCRUSH_OLDEST(acc, window, 1);
+		XCRUSH_OLDEST(acc, window, 2);
+		XCRUSH_OLDEST(acc, window, 3);
+		XCRUSH_OLDEST(acc, window, 4);
+		XCRUSH_OLDEST(acc, window, 5);
+		XCRUSH_OLDEST(acc, window, 6);
+		XCRUSH_OLDEST(acc, window, 7);
+
+		UINT32 mask = (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(acc, low), zero));
+
+		/* boundaries are rare, one position in 128 on random data */
+		for (UINT32 bit = 0; mask; bit++, mask >>= 1)
+		{
+			if (mask & 1)
+				boundaries[found++] = i + bit + 32;
+		}
+	}
+
+	for (; i < count; i++)
+	{
+		if (xcrush_boundary_bits(&data[i]) == 0)
+			boundaries[found++] = i + 32;
+	}
+
+	return found;
+}
+
+static UINT32 xcrush_match_length_sse2(const BYTE* a, const BYTE* b, UINT32 limit)
+{
+	UINT32 length = 0;
+
+	WINPR_ASSERT(a);
+	WINPR_ASSERT(b);
+
+	while (length + 16 <= limit)
+	{
+		const __m128i va = _mm_loadu_si128((const __m128i*)&a[length]);
+		const __m128i vb = _mm_loadu_si128((const __m128i*)&b[length]);
+		UINT32 mask = (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+
+		if (mask != 0xFFFF)
+		{
+			while (mask & 1)
+			{
+				mask >>= 1;
+				length++;
+			}
+			return length;
+		}
+
+		length += 16;
+	}
+
+	while ((length < limit) && (a[length] == b[length]))
+		length++;
+
+	return length;
+}
+#endif
+
+void xcrush_init_sse2(pXCrushFindBoundaries* findBoundaries, pXCrushMatchLength* matchLength)
+{
+	WINPR_ASSERT(findBoundaries);
+	WINPR_ASSERT(matchLength);
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	if (!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	*findBoundaries = xcrush_find_boundaries_sse2;
+	*matchLength = xcrush_match_length_sse2;
+#endif
+}
@@ -1,5 +1,6 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/crypto.h>
 #include <winpr/bitstream.h>
 
 #include <freerdp/freerdp.h>
@@ -1063,6 +1064,117 @@ fail:
 	return rc;
 }
 
+/* Random data with copies of earlier parts, short distances give runs */
+static void test_fill_matches(BYTE* data, size_t size)
+{
+	winpr_RAND(data, size);
+
+	for (size_t x = 0; x < size / 16; x++)
+	{
+		UINT32 r[3] = { 0 };
+		winpr_RAND(r, sizeof(r));
+
+		const size_t dst = 1 + r[0] % (size - 1);
+		const size_t len = MIN(size - dst, r[1] % 300);
+		const size_t distance = 1 + ((r[2] & 1) ? (r[2] >> 1) % 8 : (r[2] >> 1) % dst);
+
+		for (size_t y = 0; (y < len) && (distance <= dst); y++)
+			data[dst + y] = data[dst + y - distance];
+	}
+}
+
+static BOOL test_decompress_equal(MPPC_CONTEXT* fast, MPPC_CONTEXT* reference,
+                                  const BYTE* pSrcData, UINT32 SrcSize, UINT32 Flags)
+{
+	UINT32 FastSize = 0;
+	UINT32 ReferenceSize = 0;
+	const BYTE* pFastData = NULL;
+	const BYTE* pReferenceData = NULL;
+
+	const int fstatus = mppc_decompress(fast, pSrcData, SrcSize, &pFastData, &FastSize, Flags);
+	const int rstatus =
+	    mppc_decompress(reference, pSrcData, SrcSize, &pReferenceData, &ReferenceSize, Flags);
+
+	if (fstatus != rstatus)
+	{
+		printf("MppcDecompressFuzz: status mismatch: fast %d, reference %d\n", fstatus, rstatus);
+		return FALSE;
+	}
+
+	if (fstatus < 0)
+		return TRUE;
+
+	if ((FastSize != ReferenceSize) || (memcmp(pFastData, pReferenceData, FastSize) != 0))
+	{
+		printf("MppcDecompressFuzz: output mismatch: fast %" PRIu32 ", reference %" PRIu32 "\n",
+		       FastSize, ReferenceSize);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* The fast decoder must produce the same output and errors as the bit stream decoder */
+static int test_MppcDecompressFuzz(DWORD level)
+{
+	int rc = -1;
+	BYTE data[8192] = { 0 };
+	BYTE packet[8192 + 64] = { 0 };
+	BYTE OutputBuffer[8192 + 64] = { 0 };
+	MPPC_CONTEXT* encoder = mppc_context_new(level, TRUE);
+	MPPC_CONTEXT* fast = mppc_context_new(level, FALSE);
+	MPPC_CONTEXT* reference = mppc_context_new(level, FALSE);
+
+	if (!encoder || !fast || !reference)
+		goto fail;
+
+	mppc_set_fast_decoder(reference, FALSE);
+
+	for (size_t x = 0; x < 2000; x++)
+	{
+		UINT32 Flags = 0;
+		UINT32 r[3] = { 0 };
+		const BYTE* pDstData = NULL;
+		UINT32 DstSize = sizeof(OutputBuffer);
+
+		winpr_RAND(r, sizeof(r));
+
+		const UINT32 SrcSize = 1 + r[0] % ((level ? sizeof(data) : 4096) - 1);
+		test_fill_matches(data, SrcSize);
+
+		if (mppc_compress(encoder, data, SrcSize, OutputBuffer, &pDstData, &DstSize, &Flags) < 0)
+			goto fail;
+
+		memcpy(packet, pDstData, DstSize);
+
+		switch (DstSize ? r[1] % 4 : 3)
+		{
+			case 0: /* flip a bit */
+				packet[r[2] % DstSize] ^= (BYTE)(1 << (r[2] % 8));
+				break;
+			case 1: /* truncate */
+				DstSize = r[2] % DstSize;
+				break;
+			case 2: /* garbage */
+				winpr_RAND(packet, DstSize);
+				Flags |= PACKET_COMPRESSED;
+				break;
+			default:
+				break;
+		}
+
+		if (!test_decompress_equal(fast, reference, packet, DstSize, Flags))
+			goto fail;
+	}
+
+	rc = 0;
+fail:
+	mppc_context_free(encoder);
+	mppc_context_free(fast);
+	mppc_context_free(reference);
+	return rc;
+}
+
 int TestFreeRDPCodecMppc(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -1089,5 +1201,11 @@ int TestFreeRDPCodecMppc(int argc, char* argv[])
 	if (test_MppcDecompressBufferRdp5() < 0)
 		return -1;
 
+	if (test_MppcDecompressFuzz(0) < 0)
+		return -1;
+
+	if (test_MppcDecompressFuzz(1) < 0)
+		return -1;
+
 	return 0;
 }
@@ -1,5 +1,6 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/crypto.h>
 
 #include "../ncrush.h"
 
@@ -107,6 +108,118 @@ fail:
 	return rc;
 }
 
+/* Random data with copies of earlier parts, short distances give runs */
+static void test_fill_matches(BYTE* data, size_t size)
+{
+	winpr_RAND(data, size);
+
+	for (size_t x = 0; x < size / 16; x++)
+	{
+		UINT32 r[3] = { 0 };
+		winpr_RAND(r, sizeof(r));
+
+		const size_t dst = 1 + r[0] % (size - 1);
+		const size_t len = MIN(size - dst, r[1] % 300);
+		const size_t distance = 1 + ((r[2] & 1) ? (r[2] >> 1) % 8 : (r[2] >> 1) % dst);
+
+		for (size_t y = 0; (y < len) && (distance <= dst); y++)
+			data[dst + y] = data[dst + y - distance];
+	}
+}
+
+static BOOL test_decompress_equal(NCRUSH_CONTEXT* fast, NCRUSH_CONTEXT* reference,
+                                  const BYTE* pSrcData, UINT32 SrcSize, UINT32 Flags)
+{
+	UINT32 FastSize = 0;
+	UINT32 ReferenceSize = 0;
+	const BYTE* pFastData = NULL;
+	const BYTE* pReferenceData = NULL;
+
+	const int fstatus = ncrush_decompress(fast, pSrcData, SrcSize, &pFastData, &FastSize, Flags);
+	const int rstatus =
+	    ncrush_decompress(reference, pSrcData, SrcSize, &pReferenceData, &ReferenceSize, Flags);
+
+	if (fstatus != rstatus)
+	{
+		printf("NCrushDecompressFuzz: status mismatch: fast %d, reference %d\n", fstatus, rstatus);
+		return FALSE;
+	}
+
+	if (fstatus < 0)
+		return TRUE;
+
+	if ((FastSize != ReferenceSize) || (memcmp(pFastData, pReferenceData, FastSize) != 0))
+	{
+		printf("NCrushDecompressFuzz: output mismatch: fast %" PRIu32 ", reference %" PRIu32 "\n",
+		       FastSize, ReferenceSize);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* The fast decoder must produce the same output and errors as the byte wise decoder */
+static BOOL test_NCrushDecompressFuzz(void)
+{
+	BOOL rc = FALSE;
+	BYTE data[16384] = { 0 };
+	BYTE packet[16384 + 64] = { 0 };
+	BYTE OutputBuffer[65536] = { 0 };
+	NCRUSH_CONTEXT* encoder = ncrush_context_new(TRUE);
+	NCRUSH_CONTEXT* fast = ncrush_context_new(FALSE);
+	NCRUSH_CONTEXT* reference = ncrush_context_new(FALSE);
+
+	if (!encoder || !fast || !reference)
+		goto fail;
+
+	ncrush_set_fast_decoder(reference, FALSE);
+
+	for (size_t x = 0; x < 2000; x++)
+	{
+		UINT32 Flags = 0;
+		UINT32 r[3] = { 0 };
+		const BYTE* pDstData = NULL;
+		UINT32 DstSize = sizeof(OutputBuffer);
+
+		winpr_RAND(r, sizeof(r));
+
+		const UINT32 SrcSize = 1 + r[0] % (sizeof(data) - 1);
+		test_fill_matches(data, SrcSize);
+
+		if (ncrush_compress(encoder, data, SrcSize, OutputBuffer, &pDstData, &DstSize, &Flags) < 0)
+			goto fail;
+
+		DstSize = MIN(DstSize, (UINT32)sizeof(packet));
+		memcpy(packet, pDstData, DstSize);
+
+		switch (DstSize ? r[1] % 4 : 3)
+		{
+			case 0: /* flip a bit */
+				packet[r[2] % DstSize] ^= (BYTE)(1 << (r[2] % 8));
+				break;
+			case 1: /* truncate */
+				DstSize = r[2] % DstSize;
+				break;
+			case 2: /* garbage */
+				winpr_RAND(packet, DstSize);
+				Flags |= PACKET_COMPRESSED;
+				break;
+			default:
+				break;
+		}
+
+		if (!test_decompress_equal(fast, reference, packet, DstSize, Flags))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	ncrush_context_free(encoder);
+	ncrush_context_free(fast);
+	ncrush_context_free(reference);
+	return rc;
+}
+
 int TestFreeRDPCodecNCrush(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -118,5 +231,8 @@ int TestFreeRDPCodecNCrush(int argc, char* argv[])
 	if (!test_NCrushDecompressBells())
 		return -1;
 
+	if (!test_NCrushDecompressFuzz())
+		return -1;
+
 	return 0;
 }
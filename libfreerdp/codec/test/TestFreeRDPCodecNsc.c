@@ -0,0 +1,364 @@
+#include <winpr/crt.h>
+#include <winpr/print.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/nsc.h>
+
+static const UINT32 formats[] = { PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_RGBX32,
+	                              PIXEL_FORMAT_RGBA32, PIXEL_FORMAT_BGR24,  PIXEL_FORMAT_RGB24,
+	                              PIXEL_FORMAT_BGR16,  PIXEL_FORMAT_RGB16 };
+
+static void reference_read_pixel(const BYTE* src, UINT32 format, INT16* r, INT16* g, INT16* b,
+                                 BYTE* a)
+{
+	BYTE cr = 0;
+	BYTE cg = 0;
+	BYTE cb = 0;
+	BYTE ca = 0xFF;
+
+	switch (format)
+	{
+		/* NSCodec expands 16bpp colors its own way */
+		case PIXEL_FORMAT_RGB16:
+		case PIXEL_FORMAT_BGR16:
+		{
+			const UINT16 color = (UINT16)(src[0] | (src[1] << 8));
+			const BYTE hi = (BYTE)(((color >> 11) << 3) | ((color >> 11) >> 2));
+			const BYTE lo = (BYTE)(((color & 0x1F) << 3) | ((color & 0x1F) >> 2));
+			cg = (BYTE)(((color >> 5) & 0x3F) << 2);
+			cr = (format == PIXEL_FORMAT_RGB16) ? hi : lo;
+			cb = (format == PIXEL_FORMAT_RGB16) ? lo : hi;
+		}
+		break;
+
+		default:
+			FreeRDPSplitColor(FreeRDPReadColor(src, format), format, &cr, &cg, &cb, &ca, NULL);
+			if (!FreeRDPColorHasAlpha(format))
+				ca = 0xFF;
+			break;
+	}
+
+	*r = cr;
+	*g = cg;
+	*b = cb;
+	*a = ca;
+}
+
+/* The RLE of [MS-RDPNSC] 2.2.2.1 as the encoder always produced it */
+static UINT32 reference_rle(const BYTE* in, BYTE* out, UINT32 size)
+{
+	UINT32 runlength = 1;
+	UINT32 planeSize = 0;
+
+	for (UINT32 left = size; (left > 4) && (planeSize < size - 4); left--, in++)
+	{
+		if ((left > 5) && (in[0] == in[1]))
+			runlength++;
+		else if (runlength == 1)
+			out[planeSize++] = in[0];
+		else
+		{
+			out[planeSize++] = in[0];
+			out[planeSize++] = in[0];
+
+			if (runlength < 256)
+				out[planeSize++] = (BYTE)(runlength - 2);
+			else
+			{
+				out[planeSize++] = 0xFF;
+				for (size_t x = 0; x < 4; x++)
+					out[planeSize++] = (BYTE)(runlength >> (8 * x));
+			}
+
+			runlength = 1;
+		}
+	}
+
+	if (planeSize < size - 4)
+		memcpy(&out[planeSize], in, 4);
+
+	return planeSize + 4;
+}
+
+/* A straightforward scalar encoder producing the complete NSCodec bitmap stream */
+static BOOL reference_encode(wStream* s, const BYTE* data, UINT32 format, UINT32 width,
+                             UINT32 height, UINT32 stride, UINT32 cll, BOOL subsampling)
+{
+	BOOL rc = FALSE;
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(format);
+	const UINT32 tempWidth = (width + 7) & ~7u;
+	const UINT32 tempHeight = (height + 1) & ~1u;
+	const UINT32 rw = subsampling ? tempWidth : width;
+	const size_t length = 1ull * tempWidth * tempHeight + 16;
+	BYTE* planes[4] = { calloc(length, 1), calloc(length, 1), calloc(length, 1),
+		                calloc(length, 1) };
+	BYTE* rle = calloc(length, 1);
+	UINT32 sizes[4] = { width * height, width * height, width * height, width * height };
+
+	if (!planes[0] || !planes[1] || !planes[2] || !planes[3] || !rle)
+		goto fail;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* src = &data[1ull * (height - 1 - y) * stride];
+
+		for (UINT32 x = 0; x < width; x++)
+		{
+			INT16 r = 0;
+			INT16 g = 0;
+			INT16 b = 0;
+			BYTE a = 0;
+
+			reference_read_pixel(&src[1ull * x * bpp], format, &r, &g, &b, &a);
+			planes[0][1ull * y * rw + x] = (BYTE)((r >> 2) + (g >> 1) + (b >> 2));
+			planes[1][1ull * y * rw + x] = (BYTE)((r - b) >> cll);
+			planes[2][1ull * y * rw + x] = (BYTE)((g - (r >> 1) - (b >> 1)) >> cll);
+			planes[3][1ull * y * width + x] = a;
+		}
+
+		/* the padding repeats the last pixel */
+		for (UINT32 x = width; x < rw; x++)
+		{
+			for (size_t p = 0; p < 3; p++)
+				planes[p][1ull * y * rw + x] = planes[p][1ull * y * rw + width - 1];
+		}
+	}
+
+	if (subsampling)
+	{
+		/* an odd last row is subsampled with itself */
+		if (height % 2)
+		{
+			for (size_t p = 1; p < 3; p++)
+				memcpy(&planes[p][1ull * height * rw], &planes[p][1ull * (height - 1) * rw], rw);
+		}
+
+		for (UINT32 y = 0; y < tempHeight / 2; y++)
+		{
+			for (UINT32 x = 0; x < tempWidth / 2; x++)
+			{
+				for (size_t p = 1; p < 3; p++)
+				{
+					const INT8* src0 = (const INT8*)&planes[p][2ull * y * rw + 2ull * x];
+					const INT8* src1 = src0 + rw;
+					planes[p][1ull * y * (tempWidth / 2) + x] =
+					    (BYTE)((src0[0] + src0[1] + src1[0] + src1[1]) >> 2);
+				}
+			}
+		}
+
+		sizes[0] = tempWidth * height;
+		sizes[1] = tempWidth * tempHeight / 4;
+		sizes[2] = tempWidth * tempHeight / 4;
+	}
+
+	for (size_t p = 0; p < 4; p++)
+	{
+		const UINT32 size = (sizes[p] > 0) ? reference_rle(planes[p], rle, sizes[p]) : 0;
+
+		if (size < sizes[p])
+		{
+			memcpy(planes[p], rle, size);
+			sizes[p] = size;
+		}
+	}
+
+	if (!Stream_EnsureRemainingCapacity(s, 20ull + sizes[0] + sizes[1] + sizes[2] + sizes[3]))
+		goto fail;
+
+	for (size_t p = 0; p < 4; p++)
+		Stream_Write_UINT32(s, sizes[p]);
+	Stream_Write_UINT8(s, (BYTE)cll);
+	Stream_Write_UINT8(s, subsampling ? 1 : 0);
+	Stream_Write_UINT16(s, 0);
+	for (size_t p = 0; p < 4; p++)
+		Stream_Write(s, planes[p], sizes[p]);
+
+	rc = TRUE;
+fail:
+	for (size_t p = 0; p < 4; p++)
+		free(planes[p]);
+	free(rle);
+	return rc;
+}
+
+/* noise with flat rectangles, so RLE runs and raw bytes alternate */
+static BYTE* test_image(UINT32 width, UINT32 height, UINT32 stride)
+{
+	BYTE* data = calloc(height, stride);
+
+	if (!data)
+		return NULL;
+
+	winpr_RAND(data, 1ull * height * stride);
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < stride; x++)
+		{
+			if (((x / 24) + (y / 8)) % 3 == 0)
+				data[1ull * y * stride + x] = (BYTE)(x % 4 * 0x40 + y / 8);
+		}
+	}
+
+	return data;
+}
+
+static BOOL test_nsc_encode(NSC_CONTEXT* context, UINT32 format, UINT32 width, UINT32 height,
+                            UINT32 cll, BOOL subsampling)
+{
+	BOOL rc = FALSE;
+	const UINT32 stride = width * FreeRDPGetBytesPerPixel(format) + 7;
+	BYTE* data = test_image(width, height, stride);
+	wStream* s = Stream_New(NULL, 1024);
+	wStream* ref = Stream_New(NULL, 1024);
+
+	if (!data || !s || !ref)
+		goto fail;
+
+	if (!nsc_context_set_parameters(context, NSC_COLOR_FORMAT, format) ||
+	    !nsc_context_set_parameters(context, NSC_COLOR_LOSS_LEVEL, cll) ||
+	    !nsc_context_set_parameters(context, NSC_ALLOW_SUBSAMPLING, subsampling ? 1 : 0))
+		goto fail;
+
+	if (!nsc_compose_message(context, s, data, width, height, stride))
+		goto fail;
+
+	if (!reference_encode(ref, data, format, width, height, stride, cll, subsampling))
+		goto fail;
+
+	if ((Stream_GetPosition(s) != Stream_GetPosition(ref)) ||
+	    (memcmp(Stream_Buffer(s), Stream_Buffer(ref), Stream_GetPosition(s)) != 0))
+	{
+		printf("nsc encode %s %" PRIu32 "x%" PRIu32 " cll=%" PRIu32 " subsampling=%d: "
+		       "%" PRIuz " bytes, expected %" PRIuz "\n",
+		       FreeRDPGetColorFormatName(format), width, height, cll, subsampling,
+		       Stream_GetPosition(s), Stream_GetPosition(ref));
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(data);
+	Stream_Free(s, TRUE);
+	Stream_Free(ref, TRUE);
+	return rc;
+}
+
+static BOOL test_nsc(UINT32 ThreadingFlags)
+{
+	BOOL rc = FALSE;
+	const UINT32 sizes[][2] = { { 1, 1 },   { 3, 5 },   { 16, 16 }, { 17, 9 },
+		                        { 67, 65 }, { 130, 97 }, { 9, 130 } };
+	const UINT32 levels[] = { 1, 3, 7 };
+	/* one context for everything, the buffers must not leak state between frames */
+	NSC_CONTEXT* context = nsc_context_new();
+
+	if (!context || !nsc_context_set_parameters(context, NSC_THREADING_FLAGS, ThreadingFlags))
+		goto fail;
+
+	for (size_t f = 0; f < ARRAYSIZE(formats); f++)
+	{
+		for (size_t x = 0; x < ARRAYSIZE(sizes); x++)
+		{
+			for (size_t l = 0; l < ARRAYSIZE(levels); l++)
+			{
+				for (BOOL subsampling = FALSE; subsampling <= TRUE; subsampling++)
+				{
+					if (!test_nsc_encode(context, formats[f], sizes[x][0], sizes[x][1],
+					                     levels[l], subsampling))
+						goto fail;
+				}
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	nsc_context_free(context);
+	return rc;
+}
+
+static BOOL encode_frames(NSC_CONTEXT* context, wStream* s, const BYTE* data, UINT32 width,
+                          UINT32 height, size_t count, UINT64* elapsed)
+{
+	const UINT64 start = winpr_GetTickCount64NS();
+
+	for (size_t x = 0; x < count; x++)
+	{
+		Stream_SetPosition(s, 0);
+		if (!nsc_compose_message(context, s, data, width, height, width * 4))
+			return FALSE;
+	}
+
+	*elapsed = winpr_GetTickCount64NS() - start;
+	return TRUE;
+}
+
+/* Encode a full frame on the thread pool and single threaded, check both produce the same
+ * stream and print the encode rate. */
+static BOOL test_nsc_encode_speed(UINT32 width, UINT32 height, size_t count)
+{
+	BOOL rc = FALSE;
+	UINT64 threaded = 0;
+	UINT64 single = 0;
+	BYTE* data = test_image(width, height, width * 4);
+	NSC_CONTEXT* context1 = nsc_context_new();
+	NSC_CONTEXT* context2 = nsc_context_new();
+	wStream* s1 = Stream_New(NULL, 1024);
+	wStream* s2 = Stream_New(NULL, 1024);
+
+	if (!data || !context1 || !context2 || !s1 || !s2)
+		goto fail;
+
+	if (!nsc_context_set_parameters(context1, NSC_COLOR_FORMAT, PIXEL_FORMAT_BGRX32) ||
+	    !nsc_context_set_parameters(context2, NSC_COLOR_FORMAT, PIXEL_FORMAT_BGRX32) ||
+	    !nsc_context_set_parameters(context2, NSC_THREADING_FLAGS,
+	                                THREADING_FLAGS_DISABLE_THREADS))
+		goto fail;
+
+	if (!encode_frames(context1, s1, data, width, height, count, &threaded))
+		goto fail;
+	if (!encode_frames(context2, s2, data, width, height, count, &single))
+		goto fail;
+
+	if ((Stream_GetPosition(s1) != Stream_GetPosition(s2)) ||
+	    (memcmp(Stream_Buffer(s1), Stream_Buffer(s2), Stream_GetPosition(s1)) != 0))
+	{
+		printf("nsc encode %" PRIu32 "x%" PRIu32 ": threaded and single threaded differ\n",
+		       width, height);
+		goto fail;
+	}
+
+	printf("nsc encode %" PRIu32 "x%" PRIu32 ": threaded %.1f fps, single threaded %.1f fps\n",
+	       width, height, 1000000000.0 * (double)count / (double)(threaded ? threaded : 1),
+	       1000000000.0 * (double)count / (double)(single ? single : 1));
+	rc = TRUE;
+fail:
+	free(data);
+	nsc_context_free(context1);
+	nsc_context_free(context2);
+	Stream_Free(s1, TRUE);
+	Stream_Free(s2, TRUE);
+	return rc;
+}
+
+int TestFreeRDPCodecNsc(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_nsc(0))
+		return -1;
+
+	if (!test_nsc(THREADING_FLAGS_DISABLE_THREADS))
+		return -2;
+
+	if (!test_nsc_encode_speed(1920, 1080, 10))
+		return -3;
+
+	return 0;
+}
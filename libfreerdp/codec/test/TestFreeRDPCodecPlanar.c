@@ -4,6 +4,7 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/color.h>
@@ -5461,6 +5462,11 @@ static BOOL CompareBitmap(const BYTE* srcA, UINT32 srcAFormat, const BYTE* srcB,
 			maxDiff = 0.0;
 	}
 
+	/* planar carries 8 bit per channel, the 6 bit green of 16bpp does not survive
+	 * FreeRDPSplitColor and FreeRDPGetColor unchanged */
+	if ((srcABits == 16) && (srcBBits == 16))
+		maxDiff = 2 * 2.0;
+
 	for (size_t y = 0; y < height; y++)
 	{
 		const BYTE* lineA = &srcA[y * width * FreeRDPGetBytesPerPixel(srcAFormat)];
@@ -5513,9 +5519,6 @@ static BOOL RunTestPlanar(BITMAP_PLANAR_CONTEXT* planar, const BYTE* srcBitmap,
 	(void)printf("%s [%s] --> [%s]: ", __func__, FreeRDPGetColorFormatName(srcFormat),
 	             FreeRDPGetColorFormatName(dstFormat));
 	(void)fflush(stdout);
-	printf("TODO: Skipping unfinished test!");
-	rc = TRUE;
-	goto fail;
 
 	if (!compressedBitmap || !decompressedBitmap)
 		goto fail;
@@ -5628,6 +5631,9 @@ static BOOL TestPlanar(const UINT32 format)
 	if (!planar)
 		goto fail;
 
+	/* the test bitmaps are top down, as the shadow server delivers them */
+	freerdp_planar_topdown_image(planar, TRUE);
+
 	if (!RunTestPlanar(planar, TEST_RLE_BITMAP_EXPERIMENTAL_01, PIXEL_FORMAT_RGBX32, format, 64,
 	                   64))
 		goto fail;
@@ -5769,6 +5775,82 @@ fail:
 	return rc;
 }
 
+static void test_print_speed(const char* what, UINT64 diff, size_t pixels)
+{
+	const double seconds = (diff > 0) ? (double)diff / 1000000000.0 : 1e-9;
+
+	printf("%-6s: %" PRIu64 "ms, %.1f Mpixels/sec\n", what, diff / 1000000ull,
+	       (double)pixels / seconds / 1000000.0);
+}
+
+/* encode and decode a 1080p frame with flat areas, gradients and noise, as a desktop has */
+static BOOL TestPlanarSpeed(void)
+{
+	const UINT32 width = 1920;
+	const UINT32 height = 1080;
+	const UINT32 format = PIXEL_FORMAT_BGRA32;
+	const size_t iterations = 5;
+	const size_t stride = 4ull * width;
+	BOOL rc = FALSE;
+	UINT32 compressedSize = 0;
+	BYTE* compressed = NULL;
+	BYTE* src = calloc(height, stride);
+	BYTE* dst = calloc(height, stride);
+	BITMAP_PLANAR_CONTEXT* planar =
+	    freerdp_bitmap_planar_context_new(PLANAR_FORMAT_HEADER_RLE, width, height);
+
+	if (!src || !dst || !planar)
+		goto fail;
+
+	freerdp_planar_topdown_image(planar, TRUE);
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < width; x++)
+		{
+			BYTE* pixel = &src[y * stride + 4ull * x];
+			UINT32 color = FreeRDPGetColor(format, 0xF0, 0xF0, 0xF0, 0xFF);
+
+			if ((y / 64) % 4 == 1)
+				color = FreeRDPGetColor(format, (BYTE)x, (BYTE)y, (BYTE)(x + y), 0xFF);
+			else if ((y / 64) % 4 == 3)
+				color = FreeRDPGetColor(format, (BYTE)rand(), (BYTE)rand(), (BYTE)rand(), 0xFF);
+
+			FreeRDPWriteColor(pixel, format, color);
+		}
+	}
+
+	UINT64 start = winpr_GetTickCount64NS();
+	for (size_t x = 0; x < iterations; x++)
+	{
+		free(compressed);
+		compressedSize = 0;
+		compressed = freerdp_bitmap_compress_planar(planar, src, format, width, height, 0, NULL,
+		                                            &compressedSize);
+		if (!compressed)
+			goto fail;
+	}
+	test_print_speed("encode", winpr_GetTickCount64NS() - start, iterations * width * height);
+
+	start = winpr_GetTickCount64NS();
+	for (size_t x = 0; x < iterations; x++)
+	{
+		if (!planar_decompress(planar, compressed, compressedSize, width, height, dst, format, 0,
+		                       0, 0, width, height, FALSE))
+			goto fail;
+	}
+	test_print_speed("decode", winpr_GetTickCount64NS() - start, iterations * width * height);
+
+	printf("%" PRIu32 " bytes for %" PRIuz " bytes of pixels\n", compressedSize, stride * height);
+	rc = memcmp(src, dst, stride * height) == 0;
+fail:
+	free(compressed);
+	free(src);
+	free(dst);
+	freerdp_bitmap_planar_context_free(planar);
+	return rc;
+}
+
 int TestFreeRDPCodecPlanar(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -5783,5 +5865,8 @@ int TestFreeRDPCodecPlanar(int argc, char* argv[])
 			return -1;
 	}
 
+	if (!TestPlanarSpeed())
+		return -3;
+
 	return 0;
 }
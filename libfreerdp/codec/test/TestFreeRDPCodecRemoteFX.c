@@ -1,5 +1,7 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/rfx.h>
@@ -842,6 +844,88 @@ static BOOL fuzzyCompareImage(const UINT32* crefImage, const BYTE* img, size_t n
 	return TRUE;
 }
 
+static BOOL decode_frame(RFX_CONTEXT* context, wStream* s, BYTE* dest, UINT32 width,
+                         UINT32 height, size_t count, UINT64* elapsed)
+{
+	BOOL rc = FALSE;
+	REGION16 region = { 0 };
+	const UINT64 start = winpr_GetTickCount64NS();
+
+	region16_init(&region);
+	for (size_t x = 0; x < count; x++)
+	{
+		region16_clear(&region);
+		if (!rfx_process_message(context, Stream_Buffer(s),
+		                         (UINT32)Stream_GetPosition(s), 0, 0, dest, FORMAT,
+		                         width * FORMAT_SIZE, height, &region))
+			goto fail;
+	}
+
+	*elapsed = winpr_GetTickCount64NS() - start;
+	rc = TRUE;
+fail:
+	region16_uninit(&region);
+	return rc;
+}
+
+/* Decode a full frame with the tiles dispatched to the thread pool and single threaded,
+ * check both produce the same image and print the decode rate. */
+static BOOL test_rfx_decode_speed(UINT32 width, UINT32 height, size_t count)
+{
+	BOOL rc = FALSE;
+	UINT64 threaded = 0;
+	UINT64 single = 0;
+	const RFX_RECT rect = { 0, 0, (UINT16)width, (UINT16)height };
+	const size_t size = 1ull * width * height * FORMAT_SIZE;
+	RFX_CONTEXT* encoder = rfx_context_new_ex(TRUE, THREADING_FLAGS_DISABLE_THREADS);
+	RFX_CONTEXT* decoder1 = rfx_context_new(FALSE);
+	RFX_CONTEXT* decoder2 = rfx_context_new_ex(FALSE, THREADING_FLAGS_DISABLE_THREADS);
+	wStream* s = Stream_New(NULL, 1024);
+	BYTE* src = calloc(size, 1);
+	BYTE* dest1 = calloc(size, 1);
+	BYTE* dest2 = calloc(size, 1);
+
+	if (!encoder || !decoder1 || !decoder2 || !s || !src || !dest1 || !dest2)
+		goto fail;
+
+	/* Smooth content with some noise, compresses like a desktop with photos */
+	winpr_RAND(src, size);
+	for (size_t x = 0; x < size; x++)
+		src[x] = (BYTE)(((x / FORMAT_SIZE) % width) + src[x] % 16);
+
+	if (!rfx_context_reset(encoder, width, height))
+		goto fail;
+	rfx_context_set_pixel_format(encoder, FORMAT);
+	if (!rfx_compose_message(encoder, s, &rect, 1, src, width, height, width * FORMAT_SIZE))
+		goto fail;
+
+	if (!decode_frame(decoder1, s, dest1, width, height, count, &threaded))
+		goto fail;
+	if (!decode_frame(decoder2, s, dest2, width, height, count, &single))
+		goto fail;
+
+	if (memcmp(dest1, dest2, size) != 0)
+	{
+		printf("rfx decode %" PRIu32 "x%" PRIu32 ": threaded and single threaded differ\n",
+		       width, height);
+		goto fail;
+	}
+
+	printf("rfx decode %" PRIu32 "x%" PRIu32 ": threaded %.1f fps, single threaded %.1f fps\n",
+	       width, height, 1000000000.0 * (double)count / (double)(threaded ? threaded : 1),
+	       1000000000.0 * (double)count / (double)(single ? single : 1));
+	rc = TRUE;
+fail:
+	rfx_context_free(encoder);
+	rfx_context_free(decoder1);
+	rfx_context_free(decoder2);
+	Stream_Free(s, TRUE);
+	free(src);
+	free(dest1);
+	free(dest2);
+	return rc;
+}
+
 int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
 {
 	int rc = -1;
@@ -885,6 +969,12 @@ int TestFreeRDPCodecRemoteFX(int argc, char* argv[])
 	if (!fuzzyCompareImage(srefImage, dest, IMG_WIDTH * IMG_HEIGHT))
 		goto fail;
 
+	if (!test_rfx_decode_speed(1920, 1080, 4))
+		goto fail;
+
+	if (!test_rfx_decode_speed(3840, 2160, 2))
+		goto fail;
+
 	rc = 0;
 fail:
 	region16_uninit(&region);
@@ -0,0 +1,254 @@
+#include <stdio.h>
+
+#include <winpr/sysinfo.h>
+
+#include <freerdp/codec/rfx.h>
+
+#include "../rfx_rlgr.h"
+
+#define TEST_COEFFS 4096
+#define TEST_BUFFER_SIZE (TEST_COEFFS * 4)
+#define TEST_BENCH_ITERATIONS 2000
+
+static UINT32 test_seed = 0x12345678;
+
+/* Deterministic, so a failure can be reproduced */
+static UINT32 test_rand(void)
+{
+	test_seed = test_seed * 1103515245u + 12345u;
+	return test_seed >> 8;
+}
+
+/* Coefficients as they come out of quantization: mostly zero, small magnitudes */
+static void test_fill(INT16* data, size_t count, UINT32 zeroPercent, UINT32 maxMag)
+{
+	for (size_t x = 0; x < count; x++)
+	{
+		if ((test_rand() % 100) < zeroPercent)
+			data[x] = 0;
+		else
+		{
+			const INT32 mag = (INT32)(1 + (test_rand() % maxMag) / (1 + test_rand() % 8));
+			data[x] = (INT16)((test_rand() & 1) ? -mag : mag);
+		}
+	}
+}
+
+static const char* test_mode(RLGR_MODE mode)
+{
+	return (mode == RLGR1) ? "RLGR1" : "RLGR3";
+}
+
+static BOOL test_encode(RLGR_MODE mode, const INT16* data, UINT32 count, UINT32 bufferSize)
+{
+	BYTE expected[TEST_BUFFER_SIZE] = { 0 };
+	BYTE actual[TEST_BUFFER_SIZE] = { 0 };
+
+	const int rc1 = rfx_rlgr_encode(mode, data, count, expected, bufferSize);
+	const int rc2 = rfx_rlgr_encode_fast(mode, data, count, actual, bufferSize);
+
+	if ((rc1 != rc2) || (memcmp(expected, actual, sizeof(actual)) != 0))
+	{
+		printf("%s encode of %" PRIu32 " coefficients into %" PRIu32 " bytes differs: %d / %d\n",
+		       test_mode(mode), count, bufferSize, rc1, rc2);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL test_decode(RLGR_MODE mode, const BYTE* src, UINT32 srcSize, UINT32 count)
+{
+	INT16 expected[TEST_COEFFS] = { 0 };
+	INT16 actual[TEST_COEFFS] = { 0 };
+
+	const int rc1 = rfx_rlgr_decode(mode, src, srcSize, expected, count);
+	const int rc2 = rfx_rlgr_decode_fast(mode, src, srcSize, actual, count);
+
+	if ((rc1 != rc2) || (memcmp(expected, actual, sizeof(actual)) != 0))
+	{
+		printf("%s decode of %" PRIu32 " bytes into %" PRIu32 " coefficients differs: %d / %d\n",
+		       test_mode(mode), srcSize, count, rc1, rc2);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL test_roundtrip(RLGR_MODE mode, UINT32 zeroPercent, UINT32 maxMag)
+{
+	INT16 data[TEST_COEFFS] = { 0 };
+	INT16 decoded[TEST_COEFFS] = { 0 };
+	BYTE buffer[TEST_BUFFER_SIZE] = { 0 };
+
+	test_fill(data, ARRAYSIZE(data), zeroPercent, maxMag);
+
+	/* The last coefficients of a component are often zero. A run of zeros at the end of the
+	 * input is terminated by a zero coded as magnitude 1, keep the last one for the roundtrip */
+	if (zeroPercent > 50)
+		memset(&data[TEST_COEFFS - 100], 0, 99 * sizeof(INT16));
+	if (data[TEST_COEFFS - 1] == 0)
+		data[TEST_COEFFS - 1] = 1;
+
+	const int size = rfx_rlgr_encode_fast(mode, data, TEST_COEFFS, buffer, sizeof(buffer));
+	if (size <= 0)
+		return FALSE;
+
+	if (!test_encode(mode, data, TEST_COEFFS, sizeof(buffer)))
+		return FALSE;
+
+	/* output that does not fit the buffer is cut off */
+	if (!test_encode(mode, data, TEST_COEFFS, (UINT32)size / 2))
+		return FALSE;
+
+	for (UINT32 count = 1; count < 64; count++)
+	{
+		if (!test_encode(mode, data, count, sizeof(buffer)))
+			return FALSE;
+	}
+
+	if (rfx_rlgr_decode_fast(mode, buffer, (UINT32)size, decoded, TEST_COEFFS) < 0)
+		return FALSE;
+
+	if (memcmp(data, decoded, sizeof(data)) != 0)
+	{
+		printf("%s roundtrip failed\n", test_mode(mode));
+		return FALSE;
+	}
+
+	if (!test_decode(mode, buffer, (UINT32)size, TEST_COEFFS))
+		return FALSE;
+
+	/* truncated input and short output */
+	if (!test_decode(mode, buffer, (UINT32)size / 3, TEST_COEFFS))
+		return FALSE;
+	if (!test_decode(mode, buffer, (UINT32)size, TEST_COEFFS / 3))
+		return FALSE;
+
+	return TRUE;
+}
+
+static BOOL test_bit_exact(void)
+{
+	const UINT32 zeros[] = { 0, 30, 70, 95, 100 };
+	const UINT32 mags[] = { 1, 16, 2047 };
+	const RLGR_MODE modes[] = { RLGR1, RLGR3 };
+
+	for (size_t m = 0; m < ARRAYSIZE(modes); m++)
+	{
+		for (size_t z = 0; z < ARRAYSIZE(zeros); z++)
+		{
+			for (size_t x = 0; x < ARRAYSIZE(mags); x++)
+			{
+				if (!test_roundtrip(modes[m], zeros[z], mags[x]))
+					return FALSE;
+			}
+		}
+	}
+
+	/* the full range of coefficients, encode only as the decoder only has 16 bit codes */
+	for (size_t m = 0; m < ARRAYSIZE(modes); m++)
+	{
+		INT16 data[TEST_COEFFS] = { 0 };
+
+		for (size_t x = 0; x < ARRAYSIZE(data); x++)
+			data[x] = (INT16)test_rand();
+		data[0] = INT16_MIN;
+		data[1] = INT16_MAX;
+
+		if (!test_encode(modes[m], data, TEST_COEFFS, TEST_BUFFER_SIZE))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* RLGR1 streams that were not created by an encoder */
+static BOOL test_bit_exact_garbage(void)
+{
+	for (size_t x = 0; x < 200; x++)
+	{
+		BYTE src[512] = { 0 };
+		const UINT32 size = 1 + test_rand() % ARRAYSIZE(src);
+
+		for (size_t y = 0; y < size; y++)
+			src[y] = (BYTE)test_rand();
+
+		/* long runs of zero bits */
+		if (x % 4 == 0)
+			memset(src, 0, size / 2);
+
+		if (!test_decode(RLGR1, src, size, TEST_COEFFS))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+typedef int (*test_decode_fn)(RLGR_MODE mode, const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
+                              INT16* WINPR_RESTRICT pDstData, UINT32 DstSize);
+typedef int (*test_encode_fn)(RLGR_MODE mode, const INT16* WINPR_RESTRICT data, UINT32 data_size,
+                              BYTE* WINPR_RESTRICT buffer, UINT32 buffer_size);
+
+static void test_print_speed(const char* what, const char* name, UINT64 diff, size_t coeffs)
+{
+	const double seconds = (diff > 0) ? (double)diff / 1000000000.0 : 1e-9;
+
+	printf("%-6s %-9s: %" PRIu64 "ms, %.1f Mcoefficients/sec\n", what, name, diff / 1000000ull,
+	       (double)coeffs / seconds / 1000000.0);
+}
+
+static BOOL test_benchmark(RLGR_MODE mode)
+{
+	INT16 data[TEST_COEFFS] = { 0 };
+	INT16 decoded[TEST_COEFFS] = { 0 };
+	BYTE buffer[TEST_BUFFER_SIZE] = { 0 };
+	const test_encode_fn encoders[] = { rfx_rlgr_encode, rfx_rlgr_encode_fast };
+	const test_decode_fn decoders[] = { rfx_rlgr_decode, rfx_rlgr_decode_fast };
+	const char* names[] = { "reference", "fast" };
+
+	/* a typical luma component, about two thirds of the coefficients are zero */
+	test_fill(data, ARRAYSIZE(data), 65, 64);
+	const int size = rfx_rlgr_encode(mode, data, TEST_COEFFS, buffer, sizeof(buffer));
+	if (size <= 0)
+		return FALSE;
+
+	printf("%s: %d bytes per component\n", test_mode(mode), size);
+
+	for (size_t x = 0; x < ARRAYSIZE(decoders); x++)
+	{
+		UINT64 start = winpr_GetTickCount64NS();
+		for (size_t y = 0; y < TEST_BENCH_ITERATIONS; y++)
+			(void)decoders[x](mode, buffer, (UINT32)size, decoded, TEST_COEFFS);
+		test_print_speed("decode", names[x], winpr_GetTickCount64NS() - start,
+		                 1ull * TEST_BENCH_ITERATIONS * TEST_COEFFS);
+
+		start = winpr_GetTickCount64NS();
+		for (size_t y = 0; y < TEST_BENCH_ITERATIONS; y++)
+		{
+			BYTE out[TEST_BUFFER_SIZE] = { 0 };
+			(void)encoders[x](mode, data, TEST_COEFFS, out, sizeof(out));
+		}
+		test_print_speed("encode", names[x], winpr_GetTickCount64NS() - start,
+		                 1ull * TEST_BENCH_ITERATIONS * TEST_COEFFS);
+	}
+
+	return memcmp(data, decoded, sizeof(data)) == 0;
+}
+
+int TestFreeRDPCodecRlgr(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_bit_exact())
+		return -1;
+
+	if (!test_bit_exact_garbage())
+		return -1;
+
+	if (!test_benchmark(RLGR1))
+		return -1;
+
+	if (!test_benchmark(RLGR3))
+		return -1;
+
+	return 0;
+}
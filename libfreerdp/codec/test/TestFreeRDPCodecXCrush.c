@@ -1,5 +1,7 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
 
 #include "../xcrush.h"
 
@@ -111,6 +113,117 @@ static const struct test_argument tests[] = {
 #endif
 };
 
+/* Fill a buffer the way fastpath updates look: a few opcodes and coordinates followed by
+ * bitmap rows that repeat, mostly unchanged, from one update to the next. */
+static void test_fill_update(BYTE* data, UINT32 size, const BYTE* rows, size_t rows_size,
+                             UINT32 frame)
+{
+	UINT32 offset = 0;
+
+	while (offset < size)
+	{
+		BYTE header[12] = { 0 };
+		winpr_RAND(header, sizeof(header));
+
+		const UINT32 hlen = MIN(size - offset, (UINT32)sizeof(header));
+		memcpy(&data[offset], header, hlen);
+		offset += hlen;
+
+		/* a run is at most 64 + 255 * 2 bytes long, it has to stay inside rows */
+		const UINT32 rlen = MIN(size - offset, 64u + header[0] * 2u);
+		const size_t row = (offset * 7 + frame * 64) % (rows_size - (64 + UINT8_MAX * 2));
+		memcpy(&data[offset], &rows[row], rlen);
+		offset += rlen;
+	}
+}
+
+static BOOL test_level(UINT32 level, const BYTE* rows, size_t rows_size)
+{
+	BOOL rc = FALSE;
+	UINT64 total = 0;
+	UINT64 compressed = 0;
+	UINT64 elapsed = 0;
+	BYTE src[16384] = { 0 };
+	BYTE dst[16384 + 64] = { 0 };
+	XCRUSH_CONTEXT* encoder = xcrush_context_new(TRUE);
+	XCRUSH_CONTEXT* decoder = xcrush_context_new(FALSE);
+
+	if (!encoder || !decoder || !xcrush_set_compression_level(encoder, level))
+		goto fail;
+
+	for (UINT32 frame = 0; frame < 256; frame++)
+	{
+		UINT32 Flags = 0;
+		const BYTE* pDstData = NULL;
+		const BYTE* pOutData = NULL;
+		UINT32 OutSize = 0;
+		UINT32 DstSize = sizeof(dst);
+		const UINT32 SrcSize = 1024 + (frame * 523) % (sizeof(src) - 1024);
+
+		test_fill_update(src, SrcSize, rows, rows_size, frame);
+
+		const UINT64 start = winpr_GetTickCount64NS();
+		const int status = xcrush_compress(encoder, src, SrcSize, dst, &pDstData, &DstSize, &Flags);
+		elapsed += winpr_GetTickCount64NS() - start;
+
+		if (status < 0)
+		{
+			printf("[XCrushLevel%" PRIu32 "] compress failed: %d\n", level, status);
+			goto fail;
+		}
+
+		total += SrcSize;
+		compressed += DstSize;
+
+		if (!(Flags & PACKET_COMPRESSED))
+		{
+			/* the encoder dropped its history, so does the peer */
+			xcrush_context_reset(decoder, FALSE);
+			continue;
+		}
+
+		if ((xcrush_decompress(decoder, pDstData, DstSize, &pOutData, &OutSize, Flags) < 0) ||
+		    (OutSize != SrcSize) || (memcmp(pOutData, src, SrcSize) != 0))
+		{
+			printf("[XCrushLevel%" PRIu32 "] roundtrip failed at frame %" PRIu32 "\n", level,
+			       frame);
+			goto fail;
+		}
+	}
+
+	printf("[XCrushLevel%" PRIu32 "] %" PRIu64 " -> %" PRIu64 " bytes in %" PRIu64 " us\n", level,
+	       total, compressed, elapsed / 1000);
+	rc = TRUE;
+fail:
+	xcrush_context_free(encoder);
+	xcrush_context_free(decoder);
+	return rc;
+}
+
+static BOOL test_levels(void)
+{
+	BYTE rows[8192] = { 0 };
+
+	/* a palette of 16 colours makes the rows compressible without being trivial */
+	winpr_RAND(rows, sizeof(rows));
+	for (size_t x = 0; x < sizeof(rows); x++)
+		rows[x] &= 0x0F;
+
+	for (UINT32 level = XCRUSH_LEVEL_FAST; level <= XCRUSH_LEVEL_BEST; level++)
+	{
+		if (!test_level(level, rows, sizeof(rows)))
+			return FALSE;
+	}
+
+	XCRUSH_CONTEXT* xcrush = xcrush_context_new(TRUE);
+	if (!xcrush)
+		return FALSE;
+
+	const BOOL rc = !xcrush_set_compression_level(xcrush, XCRUSH_LEVEL_BEST + 1);
+	xcrush_context_free(xcrush);
+	return rc;
+}
+
 int TestFreeRDPCodecXCrush(int argc, char* argv[])
 {
 	int rc = 0;
@@ -126,5 +239,8 @@ int TestFreeRDPCodecXCrush(int argc, char* argv[])
 			rc = -1;
 	}
 
+	if (!test_levels())
+		rc = -1;
+
 	return rc;
 }
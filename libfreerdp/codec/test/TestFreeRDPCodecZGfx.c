@@ -1,6 +1,7 @@
 #include <winpr/crt.h>
 #include <winpr/print.h>
 #include <winpr/bitstream.h>
+#include <winpr/crypto.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/codec/zgfx.h>
@@ -253,6 +254,122 @@ fail:
 	return rc;
 }
 
+static void test_fill_pdu(BYTE* data, size_t size, size_t kind)
+{
+	static const char* words[] = { "surface ", "frame ", "cache ", "tile ", "solid ", "fill " };
+	size_t x = 0;
+
+	while (x < size)
+	{
+		UINT32 value = 0;
+		winpr_RAND(&value, sizeof(value));
+
+		switch (kind % 4)
+		{
+			case 0: /* noise */
+				data[x++] = (BYTE)value;
+				break;
+			case 1: /* text */
+			{
+				const char* word = words[value % ARRAYSIZE(words)];
+				for (size_t y = 0; (word[y] != '\0') && (x < size); y++)
+					data[x++] = (BYTE)word[y];
+			}
+			break;
+			case 2: /* runs */
+				for (size_t y = 0; (y < (value >> 8) % 512) && (x < size); y++)
+					data[x++] = (BYTE)value;
+				break;
+			default: /* 32bpp pixels */
+				for (size_t y = 0; (y < 64) && (x < size); y++)
+					data[x++] = (BYTE)(value >> ((y % 4) * 8));
+				break;
+		}
+	}
+}
+
+static int test_ZGfxCompressRoundtrip(void)
+{
+	int rc = -1;
+	size_t totalIn = 0;
+	size_t totalOut = 0;
+	BYTE* previous = NULL;
+	size_t previousSize = 0;
+	ZGFX_CONTEXT* compressor = zgfx_context_new(TRUE);
+	ZGFX_CONTEXT* decompressor = zgfx_context_new(FALSE);
+
+	if (!compressor || !decompressor)
+		goto fail;
+
+	/* more data than the encoder window holds, with PDUs that repeat earlier ones */
+	for (size_t x = 0; x < 96; x++)
+	{
+		UINT32 Flags = 0;
+		UINT32 DstSize = 0;
+		BYTE* pDstData = NULL;
+		UINT32 SrcSize = 0;
+		BYTE* pSrcData = NULL;
+		UINT32 size = 0;
+		BYTE* pData = NULL;
+
+		winpr_RAND(&size, sizeof(size));
+		size = (x % 5 == 0) ? 150000 + size % 150000 : 1 + size % 30000;
+		if ((x % 7 == 6) && previous)
+			size = (UINT32)previousSize;
+
+		pData = malloc(size);
+		if (!pData)
+			goto fail;
+
+		if ((x % 7 == 6) && previous)
+		{
+			memcpy(pData, previous, size);
+			pData[size / 2] ^= 0x01;
+		}
+		else
+			test_fill_pdu(pData, size, x);
+
+		if (zgfx_compress(compressor, pData, size, &pSrcData, &SrcSize, &Flags) < 0)
+		{
+			free(pData);
+			goto fail;
+		}
+
+		const int status = zgfx_decompress(decompressor, pSrcData, SrcSize, &pDstData, &DstSize, 0);
+		const BOOL match =
+		    (status >= 0) && (DstSize == size) && (memcmp(pDstData, pData, size) == 0);
+		free(pSrcData);
+		free(pDstData);
+
+		if (!match)
+		{
+			printf("test_ZGfxCompressRoundtrip: PDU %" PRIuz " of %" PRIu32 " bytes mismatch\n", x,
+			       size);
+			free(pData);
+			goto fail;
+		}
+
+		totalIn += size;
+		totalOut += SrcSize;
+		free(previous);
+		previous = pData;
+		previousSize = size;
+	}
+
+	printf("Roundtrip: %" PRIuz " bytes compressed to %" PRIuz "\n", totalIn, totalOut);
+
+	/* three quarters of the input is redundant */
+	if (totalOut > totalIn / 2)
+		goto fail;
+
+	rc = 0;
+fail:
+	free(previous);
+	zgfx_context_free(compressor);
+	zgfx_context_free(decompressor);
+	return rc;
+}
+
 int TestFreeRDPCodecZGfx(int argc, char* argv[])
 {
 	WINPR_UNUSED(argc);
@@ -270,5 +387,8 @@ int TestFreeRDPCodecZGfx(int argc, char* argv[])
 	if (test_ZGfxCompressConsistent() < 0)
 		return -1;
 
+	if (test_ZGfxCompressRoundtrip() < 0)
+		return -1;
+
 	return 0;
 }
@@ -30,6 +30,7 @@
 
 #include <freerdp/log.h>
 #include "xcrush.h"
+#include "sse/xcrush_sse2.h"
 
 #pragma pack(push, 1)
 
@@ -91,6 +92,12 @@ struct s_XCRUSH_CONTEXT
 	ALIGN64 UINT32 OptimizedMatchCount;
 	ALIGN64 XCRUSH_MATCH_INFO OriginalMatches[1000];
 	ALIGN64 XCRUSH_MATCH_INFO OptimizedMatches[1000];
+	ALIGN64 UINT32 Boundaries[16384];
+	ALIGN64 UINT32 ChainLength;
+	ALIGN64 UINT32 GoodMatchLength;
+	ALIGN64 BOOL InnerCompression;
+	ALIGN64 pXCrushFindBoundaries FindBoundaries;
+	ALIGN64 pXCrushMatchLength MatchLength;
 };
 
 //#define DEBUG_XCRUSH 1
@@ -216,23 +223,15 @@ static int xcrush_append_chunk(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush,
 	return 1;
 }
 
-static int xcrush_compute_chunks(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush,
-                                 const BYTE* WINPR_RESTRICT data, UINT32 size,
-                                 UINT32* WINPR_RESTRICT pIndex)
+static UINT32 xcrush_find_boundaries(const BYTE* WINPR_RESTRICT data, UINT32 count,
+                                     UINT32* WINPR_RESTRICT boundaries)
 {
-	UINT32 offset = 0;
+	UINT32 found = 0;
 	UINT32 rotation = 0;
 	UINT32 accumulator = 0;
 
-	WINPR_ASSERT(xcrush);
 	WINPR_ASSERT(data);
-	WINPR_ASSERT(pIndex);
-
-	*pIndex = 0;
-	xcrush->SignatureIndex = 0;
-
-	if (size < 128)
-		return 0;
+	WINPR_ASSERT(boundaries);
 
 	for (UINT32 i = 0; i < 32; i++)
 	{
@@ -240,46 +239,72 @@ static int xcrush_compute_chunks(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush,
 		accumulator = data[i] ^ rotation;
 	}
 
-	for (UINT32 i = 0; i < size - 64; i++)
+	for (UINT32 i = 0; i < count; i++)
 	{
 		rotation = _rotl(accumulator, 1);
 		accumulator = data[i + 32] ^ data[i] ^ rotation;
 
 		if (!(accumulator & 0x7F))
-		{
-			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
-				return 0;
-		}
+			boundaries[found++] = i + 32;
+	}
 
-		i++;
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i + 32] ^ data[i] ^ rotation;
+	return found;
+}
 
-		if (!(accumulator & 0x7F))
-		{
-			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
-				return 0;
-		}
+static UINT32 xcrush_match_length(const BYTE* a, const BYTE* b, UINT32 limit)
+{
+	UINT32 length = 0;
 
-		i++;
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i + 32] ^ data[i] ^ rotation;
+	WINPR_ASSERT(a);
+	WINPR_ASSERT(b);
 
-		if (!(accumulator & 0x7F))
-		{
-			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
-				return 0;
-		}
+	while (length + 8 <= limit)
+	{
+		UINT64 va = 0;
+		UINT64 vb = 0;
 
-		i++;
-		rotation = _rotl(accumulator, 1);
-		accumulator = data[i + 32] ^ data[i] ^ rotation;
+		memcpy(&va, &a[length], sizeof(va));
+		memcpy(&vb, &b[length], sizeof(vb));
 
-		if (!(accumulator & 0x7F))
-		{
-			if (!xcrush_append_chunk(xcrush, data, &offset, i + 32))
-				return 0;
-		}
+		if (va != vb)
+			break;
+
+		length += 8;
+	}
+
+	while ((length < limit) && (a[length] == b[length]))
+		length++;
+
+	return length;
+}
+
+static int xcrush_compute_chunks(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush,
+                                 const BYTE* WINPR_RESTRICT data, UINT32 size,
+                                 UINT32* WINPR_RESTRICT pIndex)
+{
+	UINT32 offset = 0;
+
+	WINPR_ASSERT(xcrush);
+	WINPR_ASSERT(data);
+	WINPR_ASSERT(pIndex);
+
+	*pIndex = 0;
+	xcrush->SignatureIndex = 0;
+
+	if (size < 128)
+		return 0;
+
+	if (size > ARRAYSIZE(xcrush->Boundaries))
+		return 0;
+
+	/* the rolling hash was always evaluated in groups of 4 positions */
+	const UINT32 count = (size - 64 + 3) & ~3u;
+	const UINT32 found = xcrush->FindBoundaries(data, count, xcrush->Boundaries);
+
+	for (UINT32 i = 0; i < found; i++)
+	{
+		if (!xcrush_append_chunk(xcrush, data, &offset, xcrush->Boundaries[i]))
+			return 0;
 	}
 
 	if ((size == offset) || xcrush_append_chunk(xcrush, data, &offset, size))
@@ -411,19 +436,14 @@ static int xcrush_find_match_length(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush, UINT3
                                     UINT32 MaxMatchLength,
                                     XCRUSH_MATCH_INFO* WINPR_RESTRICT MatchInfo)
 {
-	UINT32 MatchSymbol = 0;
-	UINT32 ChunkSymbol = 0;
 	BYTE* ChunkBuffer = NULL;
 	BYTE* MatchBuffer = NULL;
-	BYTE* MatchStartPtr = NULL;
-	BYTE* ForwardChunkPtr = NULL;
-	BYTE* ReverseChunkPtr = NULL;
-	BYTE* ForwardMatchPtr = NULL;
-	BYTE* ReverseMatchPtr = NULL;
 	BYTE* HistoryBufferEnd = NULL;
 	UINT32 ReverseMatchLength = 0;
 	UINT32 ForwardMatchLength = 0;
 	UINT32 TotalMatchLength = 0;
+	UINT32 ForwardLimit = 0;
+	UINT32 ReverseLimit = 0;
 	BYTE* HistoryBuffer = NULL;
 	UINT32 HistoryBufferSize = 0;
 
@@ -453,8 +473,8 @@ static int xcrush_find_match_length(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush, UINT3
 	if (ChunkBuffer < HistoryBuffer)
 		return -2005; /* error */
 
-	ForwardMatchPtr = &HistoryBuffer[MatchOffset];
-	ForwardChunkPtr = &HistoryBuffer[ChunkOffset];
+	if (MatchBuffer >= HistoryBufferEnd)
+		return 0;
 
 	if ((&MatchBuffer[MaxMatchLength + 1] < HistoryBufferEnd) &&
 	    (MatchBuffer[MaxMatchLength + 1] != ChunkBuffer[MaxMatchLength + 1]))
@@ -462,46 +482,36 @@ static int xcrush_find_match_length(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush, UINT3
 		return 0;
 	}
 
-	while (1)
-	{
-		MatchSymbol = *ForwardMatchPtr++;
-		ChunkSymbol = *ForwardChunkPtr++;
+	/**
+	 * The match must end within the current packet and the chunk copy must end before the end
+	 * of the history buffer, the decoder rejects anything else.
+	 */
+	ForwardLimit = HistoryOffset + SrcSize - MatchOffset;
 
-		if (MatchSymbol != ChunkSymbol)
-			break;
+	if (ChunkOffset + ForwardLimit >= HistoryBufferSize)
+		ForwardLimit = (ChunkOffset < HistoryBufferSize) ? HistoryBufferSize - 1 - ChunkOffset : 0;
 
-		if (ForwardMatchPtr > HistoryBufferEnd)
-			break;
+	ForwardMatchLength = xcrush->MatchLength(MatchBuffer, ChunkBuffer, ForwardLimit);
 
-		ForwardMatchLength++;
-	}
+	if (MatchOffset > HistoryOffset + 1)
+		ReverseLimit = MatchOffset - HistoryOffset - 1;
 
-	ReverseMatchPtr = MatchBuffer - 1;
-	ReverseChunkPtr = ChunkBuffer - 1;
+	if (ChunkOffset < 1)
+		ReverseLimit = 0;
+	else if (ReverseLimit > ChunkOffset - 1)
+		ReverseLimit = ChunkOffset - 1;
 
-	while ((ReverseMatchPtr > &HistoryBuffer[HistoryOffset]) && (ReverseChunkPtr > HistoryBuffer) &&
-	       (*ReverseMatchPtr == *ReverseChunkPtr))
-	{
+	while ((ReverseMatchLength < ReverseLimit) &&
+	       (*(MatchBuffer - ReverseMatchLength - 1) == *(ChunkBuffer - ReverseMatchLength - 1)))
 		ReverseMatchLength++;
-		ReverseMatchPtr--;
-		ReverseChunkPtr--;
-	}
 
-	MatchStartPtr = MatchBuffer - ReverseMatchLength;
 	TotalMatchLength = ReverseMatchLength + ForwardMatchLength;
 
 	if (TotalMatchLength < 11)
 		return 0;
 
-	if (MatchStartPtr < HistoryBuffer)
-		return -2006; /* error */
-
-	const intptr_t diff = MatchStartPtr - HistoryBuffer;
-	const intptr_t cdiff = ChunkBuffer - ReverseMatchLength - HistoryBuffer;
-	if ((diff > UINT32_MAX) || (diff < 0) || (cdiff < 0) || (cdiff > UINT32_MAX))
-		return -1;
-	MatchInfo->MatchOffset = (UINT32)diff;
-	MatchInfo->ChunkOffset = (UINT32)cdiff;
+	MatchInfo->MatchOffset = MatchOffset - ReverseMatchLength;
+	MatchInfo->ChunkOffset = ChunkOffset - ReverseMatchLength;
 	MatchInfo->MatchLength = TotalMatchLength;
 	return (int)TotalMatchLength;
 }
@@ -511,7 +521,6 @@ static int xcrush_find_all_matches(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush, UINT32
 {
 	UINT32 j = 0;
 	int status = 0;
-	UINT32 ChunkIndex = 0;
 	UINT32 ChunkCount = 0;
 	XCRUSH_CHUNK* chunk = NULL;
 	UINT32 MatchLength = 0;
@@ -562,14 +571,12 @@ static int xcrush_find_all_matches(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush, UINT32
 						MaxMatchInfo.ChunkOffset = MatchInfo.ChunkOffset;
 						MaxMatchInfo.MatchLength = MatchInfo.MatchLength;
 
-						if (MatchLength > 256)
+						if (MatchLength > xcrush->GoodMatchLength)
 							break;
 					}
 				}
 
-				ChunkIndex = ChunkCount++;
-
-				if (ChunkIndex > 4)
+				if (++ChunkCount >= xcrush->ChainLength)
 					break;
 
 				status = xcrush_find_next_matching_chunk(xcrush, chunk, &chunk);
@@ -1109,7 +1116,7 @@ int xcrush_compress(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush, const BYTE* WINPR_RES
 	pDstData = &OriginalData[2];
 	DstSize = OriginalDataSize - 2;
 
-	if (CompressedDataSize > 50)
+	if (xcrush->InnerCompression && (CompressedDataSize > 50))
 	{
 		const BYTE* pUnusedDstData = NULL;
 		status = mppc_compress(xcrush->mppc, CompressedData, CompressedDataSize, pDstData,
@@ -1183,6 +1190,34 @@ void xcrush_context_reset(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush, BOOL flush)
 	mppc_context_reset(xcrush->mppc, flush);
 }
 
+BOOL xcrush_set_compression_level(XCRUSH_CONTEXT* WINPR_RESTRICT xcrush, UINT32 level)
+{
+	WINPR_ASSERT(xcrush);
+
+	switch (level)
+	{
+		case XCRUSH_LEVEL_FAST:
+			xcrush->ChainLength = 1;
+			xcrush->GoodMatchLength = 64;
+			xcrush->InnerCompression = FALSE;
+			break;
+		case XCRUSH_LEVEL_DEFAULT:
+			xcrush->ChainLength = 6;
+			xcrush->GoodMatchLength = 256;
+			xcrush->InnerCompression = TRUE;
+			break;
+		case XCRUSH_LEVEL_BEST:
+			xcrush->ChainLength = 32;
+			xcrush->GoodMatchLength = 2048;
+			xcrush->InnerCompression = TRUE;
+			break;
+		default:
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 XCRUSH_CONTEXT* xcrush_context_new(BOOL Compressor)
 {
 	XCRUSH_CONTEXT* xcrush = (XCRUSH_CONTEXT*)calloc(1, sizeof(XCRUSH_CONTEXT));
@@ -1195,6 +1230,11 @@ XCRUSH_CONTEXT* xcrush_context_new(BOOL Compressor)
 	if (!xcrush->mppc)
 		goto fail;
 	xcrush->HistoryBufferSize = 2000000;
+	xcrush->FindBoundaries = xcrush_find_boundaries;
+	xcrush->MatchLength = xcrush_match_length;
+	xcrush_init_sse2(&xcrush->FindBoundaries, &xcrush->MatchLength);
+	if (!xcrush_set_compression_level(xcrush, XCRUSH_LEVEL_DEFAULT))
+		goto fail;
 	xcrush_context_reset(xcrush, FALSE);
 
 	return xcrush;
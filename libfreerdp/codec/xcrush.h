@@ -22,11 +22,20 @@
 
 #include <freerdp/api.h>
 #include <freerdp/types.h>
+#include <freerdp/settings_types.h>
 
 #include "mppc.h"
 
 typedef struct s_XCRUSH_CONTEXT XCRUSH_CONTEXT;
 
+/* Writes the offsets of all chunk boundary candidates of the first count + 32 bytes of data,
+ * returns the number of offsets written */
+typedef UINT32 (*pXCrushFindBoundaries)(const BYTE* WINPR_RESTRICT data, UINT32 count,
+                                        UINT32* WINPR_RESTRICT boundaries);
+
+/* Returns the length of the common prefix of a and b, at most limit */
+typedef UINT32 (*pXCrushMatchLength)(const BYTE* a, const BYTE* b, UINT32 limit);
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -41,6 +50,8 @@ extern "C"
 
 	FREERDP_LOCAL void xcrush_context_reset(XCRUSH_CONTEXT* xcrush, BOOL flush);
 
+	FREERDP_LOCAL BOOL xcrush_set_compression_level(XCRUSH_CONTEXT* xcrush, UINT32 level);
+
 	FREERDP_LOCAL XCRUSH_CONTEXT* xcrush_context_new(BOOL Compressor);
 	FREERDP_LOCAL void xcrush_context_free(XCRUSH_CONTEXT* xcrush);
 
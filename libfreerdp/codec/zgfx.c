@@ -25,6 +25,8 @@
 #include <winpr/cast.h>
 #include <winpr/crt.h>
 #include <winpr/print.h>
+#include <winpr/intrin.h>
+#include <winpr/endian.h>
 #include <winpr/bitstream.h>
 
 #include <freerdp/log.h>
@@ -42,6 +44,19 @@
  * Minimum match length: 3 bytes
  */
 
+#define ZGFX_HISTORY_SIZE 2500000
+
+/* The longest token prefix is 9 bits, peeking that many identifies every token */
+#define ZGFX_TOKEN_PEEK_BITS 9
+#define ZGFX_TOKEN_INVALID 0xFF
+
+#define ZGFX_ENCODER_WINDOW_SIZE (2 * ZGFX_HISTORY_SIZE)
+#define ZGFX_HASH_BITS 16
+#define ZGFX_HASH_SIZE (1 << ZGFX_HASH_BITS)
+#define ZGFX_CHAIN_SIZE 65536
+#define ZGFX_MAX_CHAIN 16
+#define ZGFX_MIN_MATCH 3
+
 typedef struct
 {
 	UINT32 prefixLength;
@@ -51,22 +66,30 @@ typedef struct
 	UINT32 valueBase;
 } ZGFX_TOKEN;
 
+/* Encoder side history, kept apart from the decoder ring so one context can do both */
+typedef struct
+{
+	BYTE* Window;
+	UINT32 WindowSize;
+	UINT32* HashHead;
+	UINT32* HashPrev;
+	BYTE* Bits;
+	size_t BitsSize;
+	UINT32 LiteralCode[256];
+	BYTE LiteralLength[256];
+} ZGFX_ENCODER;
+
 struct S_ZGFX_CONTEXT
 {
 	BOOL Compressor;
 
-	const BYTE* pbInputCurrent;
-	const BYTE* pbInputEnd;
-
-	UINT32 bits;
-	UINT32 cBitsRemaining;
-	UINT32 BitsCurrent;
-	UINT32 cBitsCurrent;
+	BYTE TokenLUT[1 << ZGFX_TOKEN_PEEK_BITS];
+	ZGFX_ENCODER* Encoder;
 
 	BYTE OutputBuffer[65536];
 	UINT32 OutputCount;
 
-	BYTE HistoryBuffer[2500000];
+	BYTE HistoryBuffer[ZGFX_HISTORY_SIZE];
 	UINT32 HistoryIndex;
 	UINT32 HistoryBufferSize;
 };
@@ -116,28 +139,98 @@ static const ZGFX_TOKEN ZGFX_TOKEN_TABLE[] = {
 	{ 0 }
 };
 
-static INLINE BOOL zgfx_GetBits(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 nbits)
+typedef struct
 {
-	if (!zgfx)
-		return FALSE;
+	const BYTE* ptr;
+	const BYTE* end;
+	UINT64 window;
+	UINT32 avail;
+	UINT32 remaining;
+} ZGFX_BIT_READER;
+
+/* The window holds the next bits MSB first, missing input past the end reads as zero */
+static INLINE void zgfx_reader_refill(ZGFX_BIT_READER* WINPR_RESTRICT reader)
+{
+	WINPR_ASSERT(reader->avail < 32);
 
-	while (zgfx->cBitsCurrent < nbits)
+	if ((reader->end - reader->ptr) >= 8)
+	{
+		const UINT32 count = (63 - reader->avail) / 8;
+		const UINT64 value = winpr_Data_Get_UINT64_BE(reader->ptr);
+		reader->window |= (value & ~(UINT64_MAX >> (8 * count))) >> reader->avail;
+		reader->ptr += count;
+		reader->avail += 8 * count;
+	}
+	else
 	{
-		zgfx->BitsCurrent <<= 8;
+		while ((reader->avail <= 56) && (reader->ptr < reader->end))
+		{
+			reader->window |= (UINT64)*reader->ptr++ << (56 - reader->avail);
+			reader->avail += 8;
+		}
+	}
+}
+
+static INLINE UINT32 zgfx_reader_peek(ZGFX_BIT_READER* WINPR_RESTRICT reader, UINT32 nbits)
+{
+	WINPR_ASSERT((nbits > 0) && (nbits <= 32));
+
+	if (reader->avail < nbits)
+		zgfx_reader_refill(reader);
+	return (UINT32)(reader->window >> (64 - nbits));
+}
 
-		if (zgfx->pbInputCurrent < zgfx->pbInputEnd)
-			zgfx->BitsCurrent += *(zgfx->pbInputCurrent)++;
+static INLINE BOOL zgfx_reader_skip(ZGFX_BIT_READER* WINPR_RESTRICT reader, UINT32 nbits)
+{
+	if (nbits > reader->remaining)
+		return FALSE;
 
-		zgfx->cBitsCurrent += 8;
+	reader->remaining -= nbits;
+	reader->window <<= nbits;
+	reader->avail = (reader->avail > nbits) ? reader->avail - nbits : 0;
+	return TRUE;
+}
+
+static INLINE BOOL zgfx_reader_read(ZGFX_BIT_READER* WINPR_RESTRICT reader, UINT32 nbits,
+                                    UINT32* WINPR_RESTRICT value)
+{
+	if (nbits == 0)
+	{
+		*value = 0;
+		return TRUE;
 	}
 
-	zgfx->cBitsRemaining -= nbits;
-	zgfx->cBitsCurrent -= nbits;
-	zgfx->bits = zgfx->BitsCurrent >> zgfx->cBitsCurrent;
-	zgfx->BitsCurrent &= ((1 << zgfx->cBitsCurrent) - 1);
+	*value = zgfx_reader_peek(reader, nbits);
+	return zgfx_reader_skip(reader, nbits);
+}
+
+/* Drop the rest of the current byte and hand the read position back for raw data */
+static INLINE BOOL zgfx_reader_align(ZGFX_BIT_READER* WINPR_RESTRICT reader)
+{
+	if (!zgfx_reader_skip(reader, reader->avail % 8))
+		return FALSE;
+
+	reader->ptr -= reader->avail / 8;
+	reader->window = 0;
+	reader->avail = 0;
 	return TRUE;
 }
 
+static void zgfx_init_token_lut(ZGFX_CONTEXT* WINPR_RESTRICT zgfx)
+{
+	memset(zgfx->TokenLUT, ZGFX_TOKEN_INVALID, sizeof(zgfx->TokenLUT));
+
+	for (size_t index = 0; ZGFX_TOKEN_TABLE[index].prefixLength != 0; index++)
+	{
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[index];
+		const UINT32 spare = ZGFX_TOKEN_PEEK_BITS - token->prefixLength;
+		const UINT32 first = token->prefixCode << spare;
+
+		for (UINT32 x = 0; x < (1u << spare); x++)
+			zgfx->TokenLUT[first + x] = (BYTE)index;
+	}
+}
+
 static INLINE void zgfx_history_buffer_ring_write(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
                                                   const BYTE* WINPR_RESTRICT src, size_t count)
 {
@@ -168,69 +261,87 @@ static INLINE void zgfx_history_buffer_ring_write(ZGFX_CONTEXT* WINPR_RESTRICT z
 	}
 }
 
-static INLINE void zgfx_history_buffer_ring_read(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, int offset,
+/* Reads count bytes ending offset bytes before the ring write position, count <= offset */
+static INLINE void zgfx_history_buffer_ring_read(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 offset,
                                                  BYTE* WINPR_RESTRICT dst, UINT32 count)
 {
-	UINT32 front = 0;
-	UINT32 index = 0;
-	INT32 bytes = 0;
-	UINT32 valid = 0;
-	INT32 bytesLeft = 0;
-	BYTE* dptr = dst;
-	BYTE* origDst = dst;
+	WINPR_ASSERT(offset <= zgfx->HistoryBufferSize);
+	WINPR_ASSERT(count <= offset);
 
-	if ((count <= 0) || (count > INT32_MAX))
-		return;
-
-	bytesLeft = (INT32)count;
-	index = (zgfx->HistoryIndex + zgfx->HistoryBufferSize -
-	         WINPR_ASSERTING_INT_CAST(uint32_t, offset)) %
-	        zgfx->HistoryBufferSize;
-	bytes = MIN(bytesLeft, offset);
+	const UINT32 index =
+	    (zgfx->HistoryIndex + zgfx->HistoryBufferSize - offset) % zgfx->HistoryBufferSize;
 
-	if ((index + WINPR_ASSERTING_INT_CAST(uint32_t, bytes)) <= zgfx->HistoryBufferSize)
+	if (index + count <= zgfx->HistoryBufferSize)
+		CopyMemory(dst, &(zgfx->HistoryBuffer[index]), count);
+	else
 	{
-		CopyMemory(dptr, &(zgfx->HistoryBuffer[index]), WINPR_ASSERTING_INT_CAST(size_t, bytes));
+		const UINT32 front = zgfx->HistoryBufferSize - index;
+		CopyMemory(dst, &(zgfx->HistoryBuffer[index]), front);
+		CopyMemory(&dst[front], zgfx->HistoryBuffer, count - front);
 	}
-	else
+}
+
+/* Same result as a forward byte by byte copy from distance bytes back, overlaps repeat */
+static INLINE void zgfx_copy_match(BYTE* WINPR_RESTRICT dst, UINT32 distance, UINT32 count)
+{
+	const BYTE* src = dst - distance;
+	UINT32 stride = distance;
+	UINT32 x = 0;
+
+	WINPR_ASSERT(distance > 0);
+
+	/* a pattern shorter than a word also repeats at a multiple of its length */
+	while (stride < 8)
+		stride += distance;
+
+	for (; (x < count) && (x + distance < stride); x++)
+		dst[x] = src[x];
+
+	for (; x + 8 <= count; x += 8)
 	{
-		front = zgfx->HistoryBufferSize - index;
-		CopyMemory(dptr, &(zgfx->HistoryBuffer[index]), front);
-		CopyMemory(&dptr[front], zgfx->HistoryBuffer,
-		           WINPR_ASSERTING_INT_CAST(uint32_t, bytes) - front);
+		UINT64 word = 0;
+		memcpy(&word, &dst[x] - stride, sizeof(word));
+		memcpy(&dst[x], &word, sizeof(word));
 	}
 
-	if ((bytesLeft -= bytes) == 0)
-		return;
+	for (; x < count; x++)
+		dst[x] = src[x];
+}
 
-	dptr += bytes;
-	valid = WINPR_ASSERTING_INT_CAST(uint32_t, bytes);
+static INLINE BOOL zgfx_decode_match(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, UINT32 distance,
+                                     UINT32 count)
+{
+	BYTE* dst = &(zgfx->OutputBuffer[zgfx->OutputCount]);
 
-	do
+	if (count > sizeof(zgfx->OutputBuffer) - zgfx->OutputCount)
+		return FALSE;
+
+	if (distance > zgfx->OutputCount)
 	{
-		bytes = WINPR_ASSERTING_INT_CAST(int32_t, valid);
+		/* The history ring holds everything up to the start of this segment */
+		const UINT32 offset = distance - zgfx->OutputCount;
+		const UINT32 front = MIN(count, offset);
 
-		if (bytes > bytesLeft)
-			bytes = bytesLeft;
+		if (offset > zgfx->HistoryBufferSize)
+			return FALSE;
 
-		CopyMemory(dptr, origDst, WINPR_ASSERTING_INT_CAST(size_t, bytes));
-		dptr += bytes;
-		valid <<= 1;
-	} while ((bytesLeft -= bytes) > 0);
+		zgfx_history_buffer_ring_read(zgfx, offset, dst, front);
+		zgfx_copy_match(&dst[front], distance, count - front);
+	}
+	else
+		zgfx_copy_match(dst, distance, count);
+
+	zgfx->OutputCount += count;
+	return TRUE;
 }
 
 static INLINE BOOL zgfx_decompress_segment(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
                                            wStream* WINPR_RESTRICT stream, size_t segmentSize)
 {
-	BYTE c = 0;
 	BYTE flags = 0;
-	UINT32 extra = 0;
-	int opIndex = 0;
-	UINT32 haveBits = 0;
-	UINT32 inPrefix = 0;
-	UINT32 count = 0;
-	UINT32 distance = 0;
+	UINT32 value = 0;
 	BYTE* pbSegment = NULL;
+	ZGFX_BIT_READER reader = { 0 };
 
 	WINPR_ASSERT(zgfx);
 	WINPR_ASSERT(stream);
@@ -261,121 +372,93 @@ static INLINE BOOL zgfx_decompress_segment(ZGFX_CONTEXT* WINPR_RESTRICT zgfx,
 		return TRUE;
 	}
 
-	zgfx->pbInputCurrent = pbSegment;
-	zgfx->pbInputEnd = &pbSegment[cbSegment - 1];
+	reader.ptr = pbSegment;
+	reader.end = &pbSegment[cbSegment - 1];
 	/* NumberOfBitsToDecode = ((NumberOfBytesToDecode - 1) * 8) - ValueOfLastByte */
 	const size_t bits = 8u * (cbSegment - 1u);
 	if (bits > UINT32_MAX)
 		return FALSE;
-	if (bits < *zgfx->pbInputEnd)
+	if (bits < *reader.end)
 		return FALSE;
 
-	zgfx->cBitsRemaining = (UINT32)(bits - *zgfx->pbInputEnd);
-	zgfx->cBitsCurrent = 0;
-	zgfx->BitsCurrent = 0;
+	reader.remaining = (UINT32)(bits - *reader.end);
 
-	while (zgfx->cBitsRemaining)
+	while (reader.remaining)
 	{
-		haveBits = 0;
-		inPrefix = 0;
+		const BYTE index = zgfx->TokenLUT[zgfx_reader_peek(&reader, ZGFX_TOKEN_PEEK_BITS)];
 
-		for (opIndex = 0; ZGFX_TOKEN_TABLE[opIndex].prefixLength != 0; opIndex++)
+		if (index == ZGFX_TOKEN_INVALID)
 		{
-			while (haveBits < ZGFX_TOKEN_TABLE[opIndex].prefixLength)
-			{
-				zgfx_GetBits(zgfx, 1);
-				inPrefix = (inPrefix << 1) + zgfx->bits;
-				haveBits++;
-			}
+			/* not a valid prefix, skipped like the bit by bit table walk did */
+			if (!zgfx_reader_skip(&reader, ZGFX_TOKEN_PEEK_BITS))
+				return FALSE;
+			continue;
+		}
 
-			if (inPrefix == ZGFX_TOKEN_TABLE[opIndex].prefixCode)
-			{
-				if (ZGFX_TOKEN_TABLE[opIndex].tokenType == 0)
-				{
-					/* Literal */
-					zgfx_GetBits(zgfx, ZGFX_TOKEN_TABLE[opIndex].valueBits);
-					c = (BYTE)(ZGFX_TOKEN_TABLE[opIndex].valueBase + zgfx->bits);
-					zgfx->HistoryBuffer[zgfx->HistoryIndex] = c;
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[index];
 
-					if (++zgfx->HistoryIndex == zgfx->HistoryBufferSize)
-						zgfx->HistoryIndex = 0;
+		if (!zgfx_reader_skip(&reader, token->prefixLength) ||
+		    !zgfx_reader_read(&reader, token->valueBits, &value))
+			return FALSE;
 
-					if (zgfx->OutputCount >= sizeof(zgfx->OutputBuffer))
-						return FALSE;
+		if (token->tokenType == 0)
+		{
+			/* Literal */
+			if (zgfx->OutputCount >= sizeof(zgfx->OutputBuffer))
+				return FALSE;
 
-					zgfx->OutputBuffer[zgfx->OutputCount++] = c;
-				}
-				else
+			zgfx->OutputBuffer[zgfx->OutputCount++] = (BYTE)(token->valueBase + value);
+		}
+		else
+		{
+			const UINT32 distance = token->valueBase + value;
+
+			if (distance != 0)
+			{
+				/* Match */
+				/* count 3 is a 0 bit, otherwise k-1 one bits and a 0 give 2^k + k bits */
+				const UINT32 ones = __lzcnt(~(zgfx_reader_peek(&reader, 16) << 16));
+				UINT32 count = 3;
+
+				if (ones >= 16)
+					return FALSE;
+				if (!zgfx_reader_skip(&reader, ones + 1))
+					return FALSE;
+
+				if (ones > 0)
 				{
-					zgfx_GetBits(zgfx, ZGFX_TOKEN_TABLE[opIndex].valueBits);
-					distance = ZGFX_TOKEN_TABLE[opIndex].valueBase + zgfx->bits;
-
-					if (distance != 0)
-					{
-						/* Match */
-						zgfx_GetBits(zgfx, 1);
-
-						if (zgfx->bits == 0)
-						{
-							count = 3;
-						}
-						else
-						{
-							count = 4;
-							extra = 2;
-							zgfx_GetBits(zgfx, 1);
-
-							while (zgfx->bits == 1)
-							{
-								count *= 2;
-								extra++;
-								zgfx_GetBits(zgfx, 1);
-							}
-
-							zgfx_GetBits(zgfx, extra);
-							count += zgfx->bits;
-						}
-
-						if (count > sizeof(zgfx->OutputBuffer) - zgfx->OutputCount)
-							return FALSE;
-
-						zgfx_history_buffer_ring_read(zgfx, WINPR_ASSERTING_INT_CAST(int, distance),
-						                              &(zgfx->OutputBuffer[zgfx->OutputCount]),
-						                              count);
-						zgfx_history_buffer_ring_write(
-						    zgfx, &(zgfx->OutputBuffer[zgfx->OutputCount]), count);
-						zgfx->OutputCount += count;
-					}
-					else
-					{
-						/* Unencoded */
-						zgfx_GetBits(zgfx, 15);
-						count = zgfx->bits;
-						zgfx->cBitsRemaining -= zgfx->cBitsCurrent;
-						zgfx->cBitsCurrent = 0;
-						zgfx->BitsCurrent = 0;
-
-						if (count > sizeof(zgfx->OutputBuffer) - zgfx->OutputCount)
-							return FALSE;
-						else if (count > zgfx->cBitsRemaining / 8)
-							return FALSE;
-						else if (zgfx->pbInputCurrent + count > zgfx->pbInputEnd)
-							return FALSE;
-
-						CopyMemory(&(zgfx->OutputBuffer[zgfx->OutputCount]), zgfx->pbInputCurrent,
-						           count);
-						zgfx_history_buffer_ring_write(zgfx, zgfx->pbInputCurrent, count);
-						zgfx->pbInputCurrent += count;
-						zgfx->cBitsRemaining -= (8 * count);
-						zgfx->OutputCount += count;
-					}
+					if (!zgfx_reader_read(&reader, ones + 1, &value))
+						return FALSE;
+					count = (1u << (ones + 1)) + value;
 				}
 
-				break;
+				if (!zgfx_decode_match(zgfx, distance, count))
+					return FALSE;
+			}
+			else
+			{
+				/* Unencoded */
+				if (!zgfx_reader_read(&reader, 15, &value) || !zgfx_reader_align(&reader))
+					return FALSE;
+
+				const UINT32 count = value;
+
+				if (count > sizeof(zgfx->OutputBuffer) - zgfx->OutputCount)
+					return FALSE;
+				else if (count > reader.remaining / 8)
+					return FALSE;
+				else if (reader.ptr + count > reader.end)
+					return FALSE;
+
+				CopyMemory(&(zgfx->OutputBuffer[zgfx->OutputCount]), reader.ptr, count);
+				reader.ptr += count;
+				reader.remaining -= (8 * count);
+				zgfx->OutputCount += count;
 			}
 		}
 	}
 
+	zgfx_history_buffer_ring_write(zgfx, zgfx->OutputBuffer, zgfx->OutputCount);
 	return TRUE;
 }
 
@@ -498,18 +581,330 @@ fail:
 	return status;
 }
 
+typedef struct
+{
+	BYTE* data;
+	size_t length;
+	UINT64 acc;
+	UINT32 nbits;
+} ZGFX_BIT_WRITER;
+
+static INLINE void zgfx_writer_write(ZGFX_BIT_WRITER* WINPR_RESTRICT writer, UINT32 value,
+                                     UINT32 nbits)
+{
+	WINPR_ASSERT(nbits <= 32);
+
+	writer->acc = (writer->acc << nbits) | value;
+	writer->nbits += nbits;
+
+	while (writer->nbits >= 8)
+	{
+		writer->nbits -= 8;
+		writer->data[writer->length++] = (BYTE)(writer->acc >> writer->nbits);
+	}
+}
+
+/* Returns the number of padding bits in the last byte */
+static INLINE BYTE zgfx_writer_finish(ZGFX_BIT_WRITER* WINPR_RESTRICT writer)
+{
+	if (writer->nbits == 0)
+		return 0;
+
+	const BYTE padding = (BYTE)(8 - writer->nbits);
+	zgfx_writer_write(writer, 0, padding);
+	return padding;
+}
+
+static INLINE const ZGFX_TOKEN* zgfx_distance_token(UINT32 distance)
+{
+	const ZGFX_TOKEN* found = NULL;
+
+	for (size_t index = 0; ZGFX_TOKEN_TABLE[index].prefixLength != 0; index++)
+	{
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[index];
+
+		if ((token->tokenType == 1) && (token->valueBase <= distance) &&
+		    (!found || (token->valueBase > found->valueBase)))
+			found = token;
+	}
+
+	return found;
+}
+
+/* count 3 is a single 0 bit, 2^k <= count < 2^(k+1) is k-1 one bits, a zero and k bits */
+static INLINE UINT32 zgfx_count_bits(UINT32 count)
+{
+	if (count == 3)
+		return 1;
+	return 2 * (31 - __lzcnt(count));
+}
+
+static INLINE void zgfx_write_match(ZGFX_BIT_WRITER* WINPR_RESTRICT writer, UINT32 distance,
+                                    UINT32 count)
+{
+	const ZGFX_TOKEN* token = zgfx_distance_token(distance);
+
+	WINPR_ASSERT(token);
+	zgfx_writer_write(writer, token->prefixCode, token->prefixLength);
+	zgfx_writer_write(writer, distance - token->valueBase, token->valueBits);
+
+	if (count == 3)
+		zgfx_writer_write(writer, 0, 1);
+	else
+	{
+		const UINT32 k = 31 - __lzcnt(count);
+		zgfx_writer_write(writer, (1u << k) - 2u, k);
+		zgfx_writer_write(writer, count - (1u << k), k);
+	}
+}
+
+static INLINE UINT32 zgfx_hash(const BYTE* WINPR_RESTRICT data)
+{
+	const UINT32 value = ((UINT32)data[0] << 16) | ((UINT32)data[1] << 8) | data[2];
+	return (value * 2654435761u) >> (32 - ZGFX_HASH_BITS);
+}
+
+static INLINE void zgfx_encoder_insert(ZGFX_ENCODER* WINPR_RESTRICT encoder, UINT32 position)
+{
+	const UINT32 hash = zgfx_hash(&encoder->Window[position]);
+	encoder->HashPrev[position % ZGFX_CHAIN_SIZE] = encoder->HashHead[hash];
+	encoder->HashHead[hash] = position + 1;
+}
+
+static INLINE UINT32 zgfx_match_length(const BYTE* WINPR_RESTRICT a, const BYTE* WINPR_RESTRICT b,
+                                       UINT32 limit)
+{
+	UINT32 length = 0;
+
+	for (; length + 8 <= limit; length += 8)
+	{
+		UINT64 wa = 0;
+		UINT64 wb = 0;
+		memcpy(&wa, &a[length], sizeof(wa));
+		memcpy(&wb, &b[length], sizeof(wb));
+		if (wa != wb)
+			break;
+	}
+
+	while ((length < limit) && (a[length] == b[length]))
+		length++;
+
+	return length;
+}
+
+static UINT32 zgfx_encoder_find_match(const ZGFX_ENCODER* WINPR_RESTRICT encoder,
+                                      UINT32 position, UINT32 limit,
+                                      UINT32* WINPR_RESTRICT pDistance)
+{
+	const BYTE* current = &encoder->Window[position];
+	UINT32 best = 0;
+	UINT32 candidate = encoder->HashHead[zgfx_hash(current)];
+
+	for (size_t chain = 0; (chain < ZGFX_MAX_CHAIN) && (candidate != 0); chain++)
+	{
+		const UINT32 match = candidate - 1;
+		const UINT32 distance = position - match;
+
+		if (distance > ZGFX_HISTORY_SIZE)
+			break;
+
+		if (current[best] == encoder->Window[match + best])
+		{
+			const UINT32 length = zgfx_match_length(current, &encoder->Window[match], limit);
+
+			if (length > best)
+			{
+				best = length;
+				*pDistance = distance;
+
+				if (length == limit)
+					break;
+			}
+		}
+
+		/* older chain entries have been reused by newer positions */
+		if (distance >= ZGFX_CHAIN_SIZE)
+			break;
+
+		candidate = encoder->HashPrev[match % ZGFX_CHAIN_SIZE];
+		if (candidate > match)
+			break;
+	}
+
+	return best;
+}
+
+static BOOL zgfx_encoder_accept(const ZGFX_ENCODER* WINPR_RESTRICT encoder, const BYTE* data,
+                                UINT32 distance, UINT32 count)
+{
+	const ZGFX_TOKEN* token = zgfx_distance_token(distance);
+	UINT32 literalBits = 0;
+
+	if (count >= 8)
+		return TRUE;
+
+	for (UINT32 x = 0; x < count; x++)
+		literalBits += encoder->LiteralLength[data[x]];
+
+	return token->prefixLength + token->valueBits + zgfx_count_bits(count) < literalBits;
+}
+
+static void zgfx_encoder_slide(ZGFX_ENCODER* WINPR_RESTRICT encoder)
+{
+	/* whole chain blocks keep the chain slots of the remaining positions in place */
+	const UINT32 excess = encoder->WindowSize - ZGFX_HISTORY_SIZE;
+	const UINT32 shift = (excess + ZGFX_CHAIN_SIZE - 1) / ZGFX_CHAIN_SIZE * ZGFX_CHAIN_SIZE;
+
+	MoveMemory(encoder->Window, &encoder->Window[shift], encoder->WindowSize - shift);
+	encoder->WindowSize -= shift;
+
+	for (size_t x = 0; x < ZGFX_HASH_SIZE; x++)
+		encoder->HashHead[x] = (encoder->HashHead[x] > shift) ? encoder->HashHead[x] - shift : 0;
+	for (size_t x = 0; x < ZGFX_CHAIN_SIZE; x++)
+		encoder->HashPrev[x] = (encoder->HashPrev[x] > shift) ? encoder->HashPrev[x] - shift : 0;
+}
+
+/* Encodes the segment into the scratch buffer, returns the encoded size including the
+ * trailing padding byte */
+static size_t zgfx_encoder_compress(ZGFX_ENCODER* WINPR_RESTRICT encoder,
+                                    const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize)
+{
+	ZGFX_BIT_WRITER writer = { 0 };
+
+	if (encoder->WindowSize + SrcSize > ZGFX_ENCODER_WINDOW_SIZE)
+		zgfx_encoder_slide(encoder);
+
+	const UINT32 start = encoder->WindowSize;
+	const UINT32 end = start + SrcSize;
+	CopyMemory(&encoder->Window[start], pSrcData, SrcSize);
+	encoder->WindowSize = end;
+	writer.data = encoder->Bits;
+
+	for (UINT32 position = start; position < end;)
+	{
+		const UINT32 limit = end - position;
+		UINT32 distance = 0;
+		UINT32 count = 0;
+
+		if (limit >= ZGFX_MIN_MATCH)
+		{
+			count = zgfx_encoder_find_match(encoder, position, limit, &distance);
+			zgfx_encoder_insert(encoder, position);
+		}
+
+		if ((count >= ZGFX_MIN_MATCH) &&
+		    zgfx_encoder_accept(encoder, &encoder->Window[position], distance, count))
+		{
+			zgfx_write_match(&writer, distance, count);
+
+			for (UINT32 x = 1; x < count; x++)
+			{
+				if (position + x + ZGFX_MIN_MATCH <= end)
+					zgfx_encoder_insert(encoder, position + x);
+			}
+			position += count;
+		}
+		else
+		{
+			const BYTE c = encoder->Window[position++];
+			zgfx_writer_write(&writer, encoder->LiteralCode[c], encoder->LiteralLength[c]);
+		}
+	}
+
+	const BYTE padding = zgfx_writer_finish(&writer);
+	writer.data[writer.length++] = padding;
+	WINPR_ASSERT(writer.length <= encoder->BitsSize);
+	return writer.length;
+}
+
+static void zgfx_encoder_reset(ZGFX_ENCODER* WINPR_RESTRICT encoder)
+{
+	if (!encoder)
+		return;
+
+	encoder->WindowSize = 0;
+	memset(encoder->HashHead, 0, ZGFX_HASH_SIZE * sizeof(UINT32));
+	memset(encoder->HashPrev, 0, ZGFX_CHAIN_SIZE * sizeof(UINT32));
+}
+
+static void zgfx_encoder_free(ZGFX_ENCODER* encoder)
+{
+	if (!encoder)
+		return;
+
+	free(encoder->Window);
+	free(encoder->HashHead);
+	free(encoder->HashPrev);
+	free(encoder->Bits);
+	free(encoder);
+}
+
+static ZGFX_ENCODER* zgfx_encoder_new(void)
+{
+	ZGFX_ENCODER* encoder = calloc(1, sizeof(ZGFX_ENCODER));
+
+	if (!encoder)
+		return NULL;
+
+	/* a literal takes at most 9 bits and a match is only taken when it is shorter */
+	encoder->BitsSize = (ZGFX_SEGMENTED_MAXSIZE * 9ull) / 8ull + 2ull;
+	encoder->Window = malloc(ZGFX_ENCODER_WINDOW_SIZE);
+	encoder->HashHead = calloc(ZGFX_HASH_SIZE, sizeof(UINT32));
+	encoder->HashPrev = calloc(ZGFX_CHAIN_SIZE, sizeof(UINT32));
+	encoder->Bits = malloc(encoder->BitsSize);
+
+	if (!encoder->Window || !encoder->HashHead || !encoder->HashPrev || !encoder->Bits)
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(encoder->LiteralCode); x++)
+	{
+		encoder->LiteralCode[x] = (UINT32)x;
+		encoder->LiteralLength[x] = 9;
+	}
+
+	for (size_t index = 0; ZGFX_TOKEN_TABLE[index].prefixLength != 0; index++)
+	{
+		const ZGFX_TOKEN* token = &ZGFX_TOKEN_TABLE[index];
+
+		if ((token->tokenType == 0) && (token->valueBits == 0))
+		{
+			encoder->LiteralCode[token->valueBase] = token->prefixCode;
+			encoder->LiteralLength[token->valueBase] = (BYTE)token->prefixLength;
+		}
+	}
+
+	return encoder;
+fail:
+	zgfx_encoder_free(encoder);
+	return NULL;
+}
+
 static BOOL zgfx_compress_segment(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, wStream* WINPR_RESTRICT s,
                                   const BYTE* WINPR_RESTRICT pSrcData, UINT32 SrcSize,
                                   UINT32* WINPR_RESTRICT pFlags)
 {
-	/* FIXME: Currently compression not implemented. Just copy the raw source */
+	size_t compressedSize = 0;
+
 	if (!Stream_EnsureRemainingCapacity(s, SrcSize + 1))
 	{
 		WLog_ERR(TAG, "Stream_EnsureRemainingCapacity failed!");
 		return FALSE;
 	}
 
+	/* The history grows with every segment, sent compressed or not */
+	if (zgfx->Encoder)
+		compressedSize = zgfx_encoder_compress(zgfx->Encoder, pSrcData, SrcSize);
+
 	(*pFlags) |= ZGFX_PACKET_COMPR_TYPE_RDP8; /* RDP 8.0 compression format */
+
+	if ((compressedSize > 0) && (compressedSize < SrcSize))
+	{
+		const UINT32 header = *pFlags | PACKET_COMPRESSED;
+		Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(uint8_t, header)); /* header (1 byte) */
+		Stream_Write(s, zgfx->Encoder->Bits, compressedSize);
+		return TRUE;
+	}
+
 	Stream_Write_UINT8(s, WINPR_ASSERTING_INT_CAST(uint8_t, *pFlags)); /* header (1 byte) */
 	Stream_Write(s, pSrcData, SrcSize);
 	return TRUE;
@@ -621,6 +1016,7 @@ int zgfx_compress(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, const BYTE* WINPR_RESTRICT
 void zgfx_context_reset(ZGFX_CONTEXT* WINPR_RESTRICT zgfx, BOOL flush)
 {
 	zgfx->HistoryIndex = 0;
+	zgfx_encoder_reset(zgfx->Encoder);
 }
 
 ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
@@ -632,6 +1028,19 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 	{
 		zgfx->Compressor = Compressor;
 		zgfx->HistoryBufferSize = sizeof(zgfx->HistoryBuffer);
+		zgfx_init_token_lut(zgfx);
+
+		if (Compressor)
+		{
+			zgfx->Encoder = zgfx_encoder_new();
+
+			if (!zgfx->Encoder)
+			{
+				zgfx_context_free(zgfx);
+				return NULL;
+			}
+		}
+
 		zgfx_context_reset(zgfx, FALSE);
 	}
 
@@ -640,5 +1049,9 @@ ZGFX_CONTEXT* zgfx_context_new(BOOL Compressor)
 
 void zgfx_context_free(ZGFX_CONTEXT* zgfx)
 {
+	if (!zgfx)
+		return;
+
+	zgfx_encoder_free(zgfx->Encoder);
 	free(zgfx);
 }
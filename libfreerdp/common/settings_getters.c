@@ -2001,6 +2001,9 @@ UINT32 freerdp_settings_get_uint32(const rdpSettings* settings, FreeRDP_Settings
 		case FreeRDP_VCFlags:
 			return settings->VCFlags;
 
+		case FreeRDP_XCrushCompressionLevel:
+			return settings->XCrushCompressionLevel;
+
 		default:
 			WLog_ERR(TAG, "Invalid key index %" PRIuz " [%s|%s]", id,
 			         freerdp_settings_get_name_for_key(id),
@@ -2529,6 +2532,10 @@ BOOL freerdp_settings_set_uint32(rdpSettings* settings, FreeRDP_Settings_Keys_UI
 			settings->VCFlags = cnv.c;
 			break;
 
+		case FreeRDP_XCrushCompressionLevel:
+			settings->XCrushCompressionLevel = cnv.c;
+			break;
+
 		default:
 			WLog_ERR(TAG, "Invalid key index %" PRIuz " [%s|%s]", id,
 			         freerdp_settings_get_name_for_key(id),
@@ -374,11 +374,16 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 
 	const BOOL defaultReturn =
 	    freerdp_settings_get_bool(context->settings, FreeRDP_DeactivateClientDecoding);
+	const UINT64 begin = metrics_stage_begin(context->metrics);
 	switch (updateCode)
 	{
 		case FASTPATH_UPDATETYPE_ORDERS:
+		{
+			const UINT64 ordersBegin = metrics_stage_begin(context->metrics);
 			rc = fastpath_recv_orders(fastpath, s);
-			break;
+			metrics_stage_end(context->metrics, FREERDP_METRICS_ORDERS, ordersBegin);
+		}
+		break;
 
 		case FASTPATH_UPDATETYPE_BITMAP:
 		case FASTPATH_UPDATETYPE_PALETTE:
@@ -477,6 +482,7 @@ static int fastpath_recv_update(rdpFastPath* fastpath, BYTE updateCode, wStream*
 		default:
 			break;
 	}
+	metrics_stage_end(context->metrics, FREERDP_METRICS_FASTPATH_UPDATE, begin);
 
 	Stream_SetPosition(s, 0);
 	if (!rc)
@@ -36,6 +36,7 @@
 #include "message.h"
 #include <freerdp/buildflags.h>
 #include "gateway/rpc_fault.h"
+#include "../crypto/tls.h"
 
 #include <winpr/assert.h>
 
@@ -1185,6 +1186,39 @@ ULONG freerdp_get_transport_sent(rdpContext* context, BOOL resetCount)
 	return transport_get_bytes_sent(context->rdp->transport, resetCount);
 }
 
+BOOL freerdp_set_write_queue_limit(rdpContext* context, size_t limit)
+{
+	if (!context || !context->rdp)
+		return FALSE;
+	return transport_set_write_queue_limit(context->rdp->transport, limit);
+}
+
+BOOL freerdp_get_write_queue_stats(rdpContext* context, FreeRDP_WriteQueueStats* stats)
+{
+	if (!context || !context->rdp || !stats)
+		return FALSE;
+	return transport_get_write_queue_stats(context->rdp->transport, stats);
+}
+
+BOOL freerdp_is_write_queue_full(rdpContext* context)
+{
+	if (!context || !context->rdp)
+		return FALSE;
+	return transport_is_write_queue_full(context->rdp->transport);
+}
+
+BOOL freerdp_set_tls_session_cache(rdpContext* context, rdpTlsSessionCache* cache)
+{
+	if (!context || !context->rdp)
+		return FALSE;
+
+	rdpRdp* rdp = context->rdp;
+	freerdp_tls_session_cache_ref(cache);
+	freerdp_tls_session_cache_free(rdp->tlsCache);
+	rdp->tlsCache = cache;
+	return TRUE;
+}
+
 BOOL freerdp_nla_impersonate(rdpContext* context)
 {
 	rdpNla* nla = NULL;
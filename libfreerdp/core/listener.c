@@ -49,6 +49,7 @@
 
 #include "listener.h"
 #include "utils.h"
+#include "../crypto/tls.h"
 
 #define TAG FREERDP_TAG("core.listener")
 
@@ -458,6 +459,9 @@ static BOOL freerdp_check_and_create_client(freerdp_listener* instance, int peer
 		return FALSE;
 	}
 
+	rdpListener* listener = (rdpListener*)instance->listener;
+	client->TlsSessionCache = freerdp_tls_session_cache_ref(listener->tlsCache);
+
 	const BOOL peer_accepted = IFCALLRESULT(FALSE, instance->PeerAccepted, instance, client);
 	if (!peer_accepted)
 	{
@@ -538,6 +542,14 @@ freerdp_listener* freerdp_listener_new(void)
 	}
 
 	listener->instance = instance;
+	listener->tlsCache = freerdp_tls_session_cache_new(TRUE);
+	if (!listener->tlsCache)
+	{
+		free(listener);
+		free(instance);
+		return NULL;
+	}
+
 	instance->listener = (void*)listener;
 	return instance;
 }
@@ -546,7 +558,10 @@ void freerdp_listener_free(freerdp_listener* instance)
 {
 	if (instance)
 	{
-		free(instance->listener);
+		rdpListener* listener = (rdpListener*)instance->listener;
+		if (listener)
+			freerdp_tls_session_cache_free(listener->tlsCache);
+		free(listener);
 		free(instance);
 	}
 }
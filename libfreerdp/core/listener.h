@@ -38,6 +38,9 @@ struct rdp_listener
 	int num_sockfds;
 	int sockfds[MAX_LISTENER_HANDLES];
 	HANDLE events[MAX_LISTENER_HANDLES];
+
+	/* shared by all accepted peers */
+	rdpTlsSessionCache* tlsCache;
 };
 
 #endif /* FREERDP_LIB_CORE_LISTENER_H */
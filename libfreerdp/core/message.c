@@ -43,6 +43,363 @@
 
 #define TAG FREERDP_TAG("core.message")
 
+/**
+ * Order copies
+ *
+ * Orders are copied before they are posted to the update thread. Instead of one or more heap
+ * allocations per order the copies of a frame are taken from an arena: a list of blocks that
+ * is filled linearly. The arena of a frame is handed back at EndPaint and recycled as soon as
+ * the update thread released the last order of that frame, so a steady stream of frames
+ * reuses the same blocks.
+ *
+ * Every copy starts with a header. For arena copies it references the arena, copies on the
+ * heap (arenas disabled or out of memory) chain all buffers of the order to free them at once.
+ */
+
+#define UPDATE_MESSAGE_BLOCK_SIZE (64ull * 1024ull)
+#define UPDATE_MESSAGE_ARENA_LIMIT (4ull * 1024ull * 1024ull)
+#define UPDATE_MESSAGE_ARENAS_CACHED 4
+
+typedef struct update_message_arena UPDATE_MESSAGE_ARENA;
+
+typedef union update_message_block
+{
+	struct
+	{
+		union update_message_block* next;
+		size_t size;
+		size_t used;
+	} s;
+	UINT64 align[3];
+} UPDATE_MESSAGE_BLOCK;
+
+struct update_message_arena
+{
+	UPDATE_MESSAGE_ARENA* next;
+	rdpUpdateMessageArenas* arenas;
+	UPDATE_MESSAGE_BLOCK* blocks;
+	UPDATE_MESSAGE_BLOCK* current;
+	size_t used;
+	LONG volatile refs;
+};
+
+typedef union
+{
+	struct
+	{
+		UPDATE_MESSAGE_ARENA* arena; /* NULL for copies on the heap */
+		rdpUpdateMessageArenas* arenas;
+		void* next; /* heap copies: the next buffer of the same order */
+	} s;
+	UINT64 align[3];
+} UPDATE_MESSAGE_HEADER;
+
+struct rdp_update_message_arenas
+{
+	CRITICAL_SECTION lock;
+	UPDATE_MESSAGE_ARENA* free;
+	size_t freeCount;
+	UPDATE_MESSAGE_ARENA* current; /* only accessed by the thread posting orders */
+	BOOL disabled;
+	LONG volatile allocations;
+};
+
+static void* update_message_heap_alloc(rdpUpdateMessageArenas* arenas, size_t size)
+{
+	WINPR_ASSERT(arenas);
+	(void)InterlockedIncrement(&arenas->allocations);
+	return malloc(size);
+}
+
+static UPDATE_MESSAGE_ARENA* update_message_arena_get(rdpUpdateMessageArenas* arenas)
+{
+	UPDATE_MESSAGE_ARENA* arena = NULL;
+
+	EnterCriticalSection(&arenas->lock);
+	arena = arenas->free;
+	if (arena)
+	{
+		arenas->free = arena->next;
+		arenas->freeCount--;
+	}
+	LeaveCriticalSection(&arenas->lock);
+
+	if (!arena)
+	{
+		arena = update_message_heap_alloc(arenas, sizeof(UPDATE_MESSAGE_ARENA));
+		if (!arena)
+			return NULL;
+
+		const UPDATE_MESSAGE_ARENA empty = { 0 };
+		*arena = empty;
+		arena->arenas = arenas;
+	}
+
+	arena->next = NULL;
+	arena->current = arena->blocks;
+	arena->refs = 1; /* held by the posting thread until EndPaint */
+	return arena;
+}
+
+static void update_message_arena_free(UPDATE_MESSAGE_ARENA* arena)
+{
+	if (!arena)
+		return;
+
+	UPDATE_MESSAGE_BLOCK* block = arena->blocks;
+	while (block)
+	{
+		UPDATE_MESSAGE_BLOCK* next = block->s.next;
+		free(block);
+		block = next;
+	}
+
+	free(arena);
+}
+
+static void update_message_arena_release(UPDATE_MESSAGE_ARENA* arena)
+{
+	if (!arena || (InterlockedDecrement(&arena->refs) != 0))
+		return;
+
+	rdpUpdateMessageArenas* arenas = arena->arenas;
+
+	/* Keep the regular blocks for the next frame, drop the ones sized for a single copy */
+	UPDATE_MESSAGE_BLOCK** pblock = &arena->blocks;
+	while (*pblock)
+	{
+		UPDATE_MESSAGE_BLOCK* block = *pblock;
+		if (block->s.size > UPDATE_MESSAGE_BLOCK_SIZE)
+		{
+			*pblock = block->s.next;
+			free(block);
+		}
+		else
+		{
+			block->s.used = 0;
+			pblock = &block->s.next;
+		}
+	}
+	arena->used = 0;
+
+	EnterCriticalSection(&arenas->lock);
+	if (arenas->freeCount < UPDATE_MESSAGE_ARENAS_CACHED)
+	{
+		arena->next = arenas->free;
+		arenas->free = arena;
+		arenas->freeCount++;
+		arena = NULL;
+	}
+	LeaveCriticalSection(&arenas->lock);
+
+	update_message_arena_free(arena);
+}
+
+static void* update_message_arena_alloc(UPDATE_MESSAGE_ARENA* arena, size_t size)
+{
+	WINPR_ASSERT(arena);
+
+	size = (size + sizeof(UINT64) - 1) & ~(sizeof(UINT64) - 1);
+
+	while (arena->current && (arena->current->s.size - arena->current->s.used < size))
+		arena->current = arena->current->s.next;
+
+	UPDATE_MESSAGE_BLOCK* block = arena->current;
+	if (!block)
+	{
+		const size_t blocksize =
+		    (size > UPDATE_MESSAGE_BLOCK_SIZE) ? size : UPDATE_MESSAGE_BLOCK_SIZE;
+		block = update_message_heap_alloc(arena->arenas, sizeof(UPDATE_MESSAGE_BLOCK) + blocksize);
+		if (!block)
+			return NULL;
+
+		block->s.size = blocksize;
+		block->s.used = 0;
+
+		/* Oversized blocks go to the front, they only hold this copy */
+		if (blocksize > UPDATE_MESSAGE_BLOCK_SIZE)
+		{
+			block->s.next = arena->blocks;
+			arena->blocks = block;
+		}
+		else
+		{
+			UPDATE_MESSAGE_BLOCK** pblock = &arena->blocks;
+			while (*pblock)
+				pblock = &(*pblock)->s.next;
+			block->s.next = NULL;
+			*pblock = block;
+			arena->current = block;
+		}
+	}
+
+	BYTE* data = (BYTE*)&block[1] + block->s.used;
+	block->s.used += size;
+	arena->used += size;
+	return data;
+}
+
+/** @brief copy an order for posting, released with update_message_order_free */
+static void* update_message_order_new(rdpContext* context, const void* order, size_t size)
+{
+	UPDATE_MESSAGE_HEADER* header = NULL;
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(order);
+
+	rdp_update_internal* up = update_cast(context->update);
+	rdpUpdateMessageArenas* arenas = up->arenas;
+	WINPR_ASSERT(arenas);
+
+	if (!arenas->disabled)
+	{
+		if (arenas->current && (arenas->current->used > UPDATE_MESSAGE_ARENA_LIMIT))
+		{
+			/* No EndPaint for a long time, do not let a single arena grow without limit */
+			update_message_arena_release(arenas->current);
+			arenas->current = NULL;
+		}
+
+		if (!arenas->current)
+			arenas->current = update_message_arena_get(arenas);
+	}
+
+	UPDATE_MESSAGE_ARENA* arena = arenas->disabled ? NULL : arenas->current;
+	if (arena)
+		header = update_message_arena_alloc(arena, sizeof(UPDATE_MESSAGE_HEADER) + size);
+	else
+		header = update_message_heap_alloc(arenas, sizeof(UPDATE_MESSAGE_HEADER) + size);
+
+	if (!header)
+		return NULL;
+
+	if (arena)
+		(void)InterlockedIncrement(&arena->refs);
+
+	header->s.arena = arena;
+	header->s.arenas = arenas;
+	header->s.next = NULL;
+	CopyMemory(&header[1], order, size);
+	return &header[1];
+}
+
+/** @brief copy \b size bytes of \b data referenced by \b copy into the same allocation */
+static void* update_message_order_dup(void* copy, const void* data, size_t size)
+{
+	WINPR_ASSERT(copy);
+
+	UPDATE_MESSAGE_HEADER* header = &((UPDATE_MESSAGE_HEADER*)copy)[-1];
+	void* dst = NULL;
+
+	if (size == 0)
+		return NULL;
+
+	if (header->s.arena)
+		dst = update_message_arena_alloc(header->s.arena, size);
+	else
+	{
+		UPDATE_MESSAGE_HEADER* buffer =
+		    update_message_heap_alloc(header->s.arenas, sizeof(UPDATE_MESSAGE_HEADER) + size);
+		if (buffer)
+		{
+			buffer->s.arena = NULL;
+			buffer->s.arenas = header->s.arenas;
+			buffer->s.next = header->s.next;
+			header->s.next = buffer;
+			dst = &buffer[1];
+		}
+	}
+
+	if (dst && data)
+		CopyMemory(dst, data, size);
+	return dst;
+}
+
+static void update_message_order_free(void* copy)
+{
+	if (!copy)
+		return;
+
+	UPDATE_MESSAGE_HEADER* header = &((UPDATE_MESSAGE_HEADER*)copy)[-1];
+	if (header->s.arena)
+	{
+		update_message_arena_release(header->s.arena);
+		return;
+	}
+
+	while (header)
+	{
+		UPDATE_MESSAGE_HEADER* next = header->s.next;
+		free(header);
+		header = next;
+	}
+}
+
+rdpUpdateMessageArenas* update_message_arenas_new(void)
+{
+	rdpUpdateMessageArenas* arenas =
+	    (rdpUpdateMessageArenas*)calloc(1, sizeof(rdpUpdateMessageArenas));
+
+	if (!arenas)
+		return NULL;
+
+	InitializeCriticalSection(&arenas->lock);
+	return arenas;
+}
+
+void update_message_arenas_free(rdpUpdateMessageArenas* arenas)
+{
+	if (!arenas)
+		return;
+
+	update_message_arena_release(arenas->current);
+
+	UPDATE_MESSAGE_ARENA* arena = arenas->free;
+	while (arena)
+	{
+		UPDATE_MESSAGE_ARENA* next = arena->next;
+		update_message_arena_free(arena);
+		arena = next;
+	}
+
+	DeleteCriticalSection(&arenas->lock);
+	free(arenas);
+}
+
+void update_message_arenas_end_frame(rdpUpdateMessageArenas* arenas)
+{
+	WINPR_ASSERT(arenas);
+
+	update_message_arena_release(arenas->current);
+	arenas->current = NULL;
+}
+
+void update_message_arenas_enable(rdpUpdateMessageArenas* arenas, BOOL enable)
+{
+	WINPR_ASSERT(arenas);
+
+	update_message_arenas_end_frame(arenas);
+	arenas->disabled = !enable;
+}
+
+size_t update_message_arenas_allocations(const rdpUpdateMessageArenas* arenas)
+{
+	WINPR_ASSERT(arenas);
+	return (size_t)arenas->allocations;
+}
+
+static BOOL update_message_post_order(rdpContext* context, UINT32 id, void* wParam)
+{
+	WINPR_ASSERT(context);
+
+	rdp_update_internal* up = update_cast(context->update);
+	if (MessageQueue_Post(up->queue, (void*)context, id, wParam, NULL))
+		return TRUE;
+
+	update_message_order_free(wParam);
+	return FALSE;
+}
+
 /* Update */
 
 static BOOL update_message_BeginPaint(rdpContext* context)
@@ -65,8 +422,12 @@ static BOOL update_message_EndPaint(rdpContext* context)
 		return FALSE;
 
 	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, EndPaint), NULL,
-	                         NULL);
+	const BOOL rc = MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, EndPaint),
+	                                  NULL, NULL);
+
+	/* The orders of this frame are posted, the next frame starts a new arena */
+	update_message_arenas_end_frame(up->arenas);
+	return rc;
 }
 
 static BOOL update_message_SetBounds(rdpContext* context, const rdpBounds* bounds)
@@ -79,17 +440,20 @@ static BOOL update_message_SetBounds(rdpContext* context, const rdpBounds* bound
 
 	if (bounds)
 	{
-		wParam = (rdpBounds*)malloc(sizeof(rdpBounds));
+		wParam = (rdpBounds*)update_message_order_new(context, bounds, sizeof(rdpBounds));
 
 		if (!wParam)
 			return FALSE;
-
-		CopyMemory(wParam, bounds, sizeof(rdpBounds));
 	}
 
 	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, SetBounds),
-	                         (void*)wParam, NULL);
+	if (!MessageQueue_Post(up->queue, (void*)context, MakeMessageId(Update, SetBounds),
+	                       (void*)wParam, NULL))
+	{
+		update_message_order_free(wParam);
+		return FALSE;
+	}
+	return TRUE;
 }
 
 static BOOL update_message_Synchronize(rdpContext* context)
@@ -321,495 +685,401 @@ static BOOL update_message_SurfaceFrameAcknowledge(rdpContext* context, UINT32 f
 static BOOL update_message_DstBlt(rdpContext* context, const DSTBLT_ORDER* dstBlt)
 {
 	DSTBLT_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !dstBlt)
 		return FALSE;
 
-	wParam = (DSTBLT_ORDER*)malloc(sizeof(DSTBLT_ORDER));
+	wParam = (DSTBLT_ORDER*)update_message_order_new(context, dstBlt, sizeof(DSTBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, dstBlt, sizeof(DSTBLT_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, DstBlt),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, DstBlt), wParam);
 }
 
 static BOOL update_message_PatBlt(rdpContext* context, PATBLT_ORDER* patBlt)
 {
 	PATBLT_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !patBlt)
 		return FALSE;
 
-	wParam = (PATBLT_ORDER*)malloc(sizeof(PATBLT_ORDER));
+	wParam = (PATBLT_ORDER*)update_message_order_new(context, patBlt, sizeof(PATBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
-
-	CopyMemory(wParam, patBlt, sizeof(PATBLT_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, PatBlt),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, PatBlt), wParam);
 }
 
 static BOOL update_message_ScrBlt(rdpContext* context, const SCRBLT_ORDER* scrBlt)
 {
 	SCRBLT_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !scrBlt)
 		return FALSE;
 
-	wParam = (SCRBLT_ORDER*)malloc(sizeof(SCRBLT_ORDER));
+	wParam = (SCRBLT_ORDER*)update_message_order_new(context, scrBlt, sizeof(SCRBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, scrBlt, sizeof(SCRBLT_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, ScrBlt),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, ScrBlt), wParam);
 }
 
 static BOOL update_message_OpaqueRect(rdpContext* context, const OPAQUE_RECT_ORDER* opaqueRect)
 {
 	OPAQUE_RECT_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !opaqueRect)
 		return FALSE;
 
-	wParam = (OPAQUE_RECT_ORDER*)malloc(sizeof(OPAQUE_RECT_ORDER));
+	wParam = (OPAQUE_RECT_ORDER*)update_message_order_new(context, opaqueRect,
+	                                                      sizeof(OPAQUE_RECT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, opaqueRect, sizeof(OPAQUE_RECT_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, OpaqueRect),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, OpaqueRect), wParam);
 }
 
 static BOOL update_message_DrawNineGrid(rdpContext* context,
                                         const DRAW_NINE_GRID_ORDER* drawNineGrid)
 {
 	DRAW_NINE_GRID_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !drawNineGrid)
 		return FALSE;
 
-	wParam = (DRAW_NINE_GRID_ORDER*)malloc(sizeof(DRAW_NINE_GRID_ORDER));
+	wParam = (DRAW_NINE_GRID_ORDER*)update_message_order_new(context, drawNineGrid,
+	                                                         sizeof(DRAW_NINE_GRID_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, drawNineGrid, sizeof(DRAW_NINE_GRID_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, DrawNineGrid),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, DrawNineGrid), wParam);
 }
 
 static BOOL update_message_MultiDstBlt(rdpContext* context, const MULTI_DSTBLT_ORDER* multiDstBlt)
 {
 	MULTI_DSTBLT_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !multiDstBlt)
 		return FALSE;
 
-	wParam = (MULTI_DSTBLT_ORDER*)malloc(sizeof(MULTI_DSTBLT_ORDER));
+	wParam = (MULTI_DSTBLT_ORDER*)update_message_order_new(context, multiDstBlt,
+	                                                       sizeof(MULTI_DSTBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, multiDstBlt, sizeof(MULTI_DSTBLT_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, MultiDstBlt),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, MultiDstBlt), wParam);
 }
 
 static BOOL update_message_MultiPatBlt(rdpContext* context, const MULTI_PATBLT_ORDER* multiPatBlt)
 {
 	MULTI_PATBLT_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !multiPatBlt)
 		return FALSE;
 
-	wParam = (MULTI_PATBLT_ORDER*)malloc(sizeof(MULTI_PATBLT_ORDER));
+	wParam = (MULTI_PATBLT_ORDER*)update_message_order_new(context, multiPatBlt,
+	                                                       sizeof(MULTI_PATBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
-
-	CopyMemory(wParam, multiPatBlt, sizeof(MULTI_PATBLT_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, MultiPatBlt),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, MultiPatBlt), wParam);
 }
 
 static BOOL update_message_MultiScrBlt(rdpContext* context, const MULTI_SCRBLT_ORDER* multiScrBlt)
 {
 	MULTI_SCRBLT_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !multiScrBlt)
 		return FALSE;
 
-	wParam = (MULTI_SCRBLT_ORDER*)malloc(sizeof(MULTI_SCRBLT_ORDER));
+	wParam = (MULTI_SCRBLT_ORDER*)update_message_order_new(context, multiScrBlt,
+	                                                       sizeof(MULTI_SCRBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, multiScrBlt, sizeof(MULTI_SCRBLT_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, MultiScrBlt),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, MultiScrBlt), wParam);
 }
 
 static BOOL update_message_MultiOpaqueRect(rdpContext* context,
                                            const MULTI_OPAQUE_RECT_ORDER* multiOpaqueRect)
 {
 	MULTI_OPAQUE_RECT_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !multiOpaqueRect)
 		return FALSE;
 
-	wParam = (MULTI_OPAQUE_RECT_ORDER*)malloc(sizeof(MULTI_OPAQUE_RECT_ORDER));
+	wParam = (MULTI_OPAQUE_RECT_ORDER*)update_message_order_new(context, multiOpaqueRect,
+	                                                            sizeof(MULTI_OPAQUE_RECT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, multiOpaqueRect, sizeof(MULTI_OPAQUE_RECT_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, MultiOpaqueRect), (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, MultiOpaqueRect),
+	                                 wParam);
 }
 
 static BOOL update_message_MultiDrawNineGrid(rdpContext* context,
                                              const MULTI_DRAW_NINE_GRID_ORDER* multiDrawNineGrid)
 {
 	MULTI_DRAW_NINE_GRID_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !multiDrawNineGrid)
 		return FALSE;
 
-	wParam = (MULTI_DRAW_NINE_GRID_ORDER*)malloc(sizeof(MULTI_DRAW_NINE_GRID_ORDER));
+	wParam = (MULTI_DRAW_NINE_GRID_ORDER*)update_message_order_new(
+	    context, multiDrawNineGrid, sizeof(MULTI_DRAW_NINE_GRID_ORDER));
 
 	if (!wParam)
 		return FALSE;
-
-	CopyMemory(wParam, multiDrawNineGrid, sizeof(MULTI_DRAW_NINE_GRID_ORDER));
 	/* TODO: complete copy */
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context,
-	                         MakeMessageId(PrimaryUpdate, MultiDrawNineGrid), (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, MultiDrawNineGrid),
+	                                 wParam);
 }
 
 static BOOL update_message_LineTo(rdpContext* context, const LINE_TO_ORDER* lineTo)
 {
 	LINE_TO_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !lineTo)
 		return FALSE;
 
-	wParam = (LINE_TO_ORDER*)malloc(sizeof(LINE_TO_ORDER));
+	wParam = (LINE_TO_ORDER*)update_message_order_new(context, lineTo, sizeof(LINE_TO_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, lineTo, sizeof(LINE_TO_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, LineTo),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, LineTo), wParam);
 }
 
 static BOOL update_message_Polyline(rdpContext* context, const POLYLINE_ORDER* polyline)
 {
 	POLYLINE_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !polyline)
 		return FALSE;
 
-	wParam = (POLYLINE_ORDER*)malloc(sizeof(POLYLINE_ORDER));
+	wParam = (POLYLINE_ORDER*)update_message_order_new(context, polyline, sizeof(POLYLINE_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, polyline, sizeof(POLYLINE_ORDER));
-	wParam->points = (DELTA_POINT*)calloc(wParam->numDeltaEntries, sizeof(DELTA_POINT));
+	wParam->points = (DELTA_POINT*)update_message_order_dup(
+	    wParam, polyline->points, sizeof(DELTA_POINT) * wParam->numDeltaEntries);
 
-	if (!wParam->points)
+	if (!wParam->points && (wParam->numDeltaEntries > 0))
 	{
-		free(wParam);
+		update_message_order_free(wParam);
 		return FALSE;
 	}
 
-	CopyMemory(wParam->points, polyline->points, sizeof(DELTA_POINT) * wParam->numDeltaEntries);
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, Polyline),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, Polyline), wParam);
 }
 
 static BOOL update_message_MemBlt(rdpContext* context, MEMBLT_ORDER* memBlt)
 {
 	MEMBLT_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !memBlt)
 		return FALSE;
 
-	wParam = (MEMBLT_ORDER*)malloc(sizeof(MEMBLT_ORDER));
+	wParam = (MEMBLT_ORDER*)update_message_order_new(context, memBlt, sizeof(MEMBLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, memBlt, sizeof(MEMBLT_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, MemBlt),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, MemBlt), wParam);
 }
 
 static BOOL update_message_Mem3Blt(rdpContext* context, MEM3BLT_ORDER* mem3Blt)
 {
 	MEM3BLT_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !mem3Blt)
 		return FALSE;
 
-	wParam = (MEM3BLT_ORDER*)malloc(sizeof(MEM3BLT_ORDER));
+	wParam = (MEM3BLT_ORDER*)update_message_order_new(context, mem3Blt, sizeof(MEM3BLT_ORDER));
 
 	if (!wParam)
 		return FALSE;
-
-	CopyMemory(wParam, mem3Blt, sizeof(MEM3BLT_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, Mem3Blt),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, Mem3Blt), wParam);
 }
 
 static BOOL update_message_SaveBitmap(rdpContext* context, const SAVE_BITMAP_ORDER* saveBitmap)
 {
 	SAVE_BITMAP_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !saveBitmap)
 		return FALSE;
 
-	wParam = (SAVE_BITMAP_ORDER*)malloc(sizeof(SAVE_BITMAP_ORDER));
+	wParam = (SAVE_BITMAP_ORDER*)update_message_order_new(context, saveBitmap,
+	                                                      sizeof(SAVE_BITMAP_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, saveBitmap, sizeof(SAVE_BITMAP_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, SaveBitmap),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, SaveBitmap), wParam);
 }
 
 static BOOL update_message_GlyphIndex(rdpContext* context, GLYPH_INDEX_ORDER* glyphIndex)
 {
 	GLYPH_INDEX_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !glyphIndex)
 		return FALSE;
 
-	wParam = (GLYPH_INDEX_ORDER*)malloc(sizeof(GLYPH_INDEX_ORDER));
+	wParam = (GLYPH_INDEX_ORDER*)update_message_order_new(context, glyphIndex,
+	                                                      sizeof(GLYPH_INDEX_ORDER));
 
 	if (!wParam)
 		return FALSE;
-
-	CopyMemory(wParam, glyphIndex, sizeof(GLYPH_INDEX_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, GlyphIndex),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, GlyphIndex), wParam);
 }
 
 static BOOL update_message_FastIndex(rdpContext* context, const FAST_INDEX_ORDER* fastIndex)
 {
 	FAST_INDEX_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !fastIndex)
 		return FALSE;
 
-	wParam = (FAST_INDEX_ORDER*)malloc(sizeof(FAST_INDEX_ORDER));
+	wParam = (FAST_INDEX_ORDER*)update_message_order_new(context, fastIndex,
+	                                                     sizeof(FAST_INDEX_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, fastIndex, sizeof(FAST_INDEX_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, FastIndex),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, FastIndex), wParam);
 }
 
 static BOOL update_message_FastGlyph(rdpContext* context, const FAST_GLYPH_ORDER* fastGlyph)
 {
 	FAST_GLYPH_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !fastGlyph)
 		return FALSE;
 
-	wParam = (FAST_GLYPH_ORDER*)malloc(sizeof(FAST_GLYPH_ORDER));
+	wParam = (FAST_GLYPH_ORDER*)update_message_order_new(context, fastGlyph,
+	                                                     sizeof(FAST_GLYPH_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, fastGlyph, sizeof(FAST_GLYPH_ORDER));
-
 	if (wParam->cbData > 1)
 	{
-		wParam->glyphData.aj = (BYTE*)malloc(fastGlyph->glyphData.cb);
+		wParam->glyphData.aj = (BYTE*)update_message_order_dup(wParam, fastGlyph->glyphData.aj,
+		                                                        fastGlyph->glyphData.cb);
 
-		if (!wParam->glyphData.aj)
+		if (!wParam->glyphData.aj && (fastGlyph->glyphData.cb > 0))
 		{
-			free(wParam);
+			update_message_order_free(wParam);
 			return FALSE;
 		}
-
-		CopyMemory(wParam->glyphData.aj, fastGlyph->glyphData.aj, fastGlyph->glyphData.cb);
 	}
 	else
 	{
 		wParam->glyphData.aj = NULL;
 	}
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, FastGlyph),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, FastGlyph), wParam);
 }
 
 static BOOL update_message_PolygonSC(rdpContext* context, const POLYGON_SC_ORDER* polygonSC)
 {
 	POLYGON_SC_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !polygonSC)
 		return FALSE;
 
-	wParam = (POLYGON_SC_ORDER*)malloc(sizeof(POLYGON_SC_ORDER));
+	wParam = (POLYGON_SC_ORDER*)update_message_order_new(context, polygonSC,
+	                                                     sizeof(POLYGON_SC_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, polygonSC, sizeof(POLYGON_SC_ORDER));
-	wParam->points = (DELTA_POINT*)calloc(wParam->numPoints, sizeof(DELTA_POINT));
+	wParam->points = (DELTA_POINT*)update_message_order_dup(
+	    wParam, polygonSC->points, sizeof(DELTA_POINT) * wParam->numPoints);
 
-	if (!wParam->points)
+	if (!wParam->points && (wParam->numPoints > 0))
 	{
-		free(wParam);
+		update_message_order_free(wParam);
 		return FALSE;
 	}
 
-	CopyMemory(wParam->points, polygonSC, sizeof(DELTA_POINT) * wParam->numPoints);
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, PolygonSC),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, PolygonSC), wParam);
 }
 
 static BOOL update_message_PolygonCB(rdpContext* context, POLYGON_CB_ORDER* polygonCB)
 {
 	POLYGON_CB_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !polygonCB)
 		return FALSE;
 
-	wParam = (POLYGON_CB_ORDER*)malloc(sizeof(POLYGON_CB_ORDER));
+	wParam = (POLYGON_CB_ORDER*)update_message_order_new(context, polygonCB,
+	                                                     sizeof(POLYGON_CB_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, polygonCB, sizeof(POLYGON_CB_ORDER));
-	wParam->points = (DELTA_POINT*)calloc(wParam->numPoints, sizeof(DELTA_POINT));
+	wParam->points = (DELTA_POINT*)update_message_order_dup(
+	    wParam, polygonCB->points, sizeof(DELTA_POINT) * wParam->numPoints);
 
-	if (!wParam->points)
+	if (!wParam->points && (wParam->numPoints > 0))
 	{
-		free(wParam);
+		update_message_order_free(wParam);
 		return FALSE;
 	}
-
-	CopyMemory(wParam->points, polygonCB, sizeof(DELTA_POINT) * wParam->numPoints);
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, PolygonCB),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, PolygonCB), wParam);
 }
 
 static BOOL update_message_EllipseSC(rdpContext* context, const ELLIPSE_SC_ORDER* ellipseSC)
 {
 	ELLIPSE_SC_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !ellipseSC)
 		return FALSE;
 
-	wParam = (ELLIPSE_SC_ORDER*)malloc(sizeof(ELLIPSE_SC_ORDER));
+	wParam = (ELLIPSE_SC_ORDER*)update_message_order_new(context, ellipseSC,
+	                                                     sizeof(ELLIPSE_SC_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	CopyMemory(wParam, ellipseSC, sizeof(ELLIPSE_SC_ORDER));
-
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, EllipseSC),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, EllipseSC), wParam);
 }
 
 static BOOL update_message_EllipseCB(rdpContext* context, const ELLIPSE_CB_ORDER* ellipseCB)
 {
 	ELLIPSE_CB_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !ellipseCB)
 		return FALSE;
 
-	wParam = (ELLIPSE_CB_ORDER*)malloc(sizeof(ELLIPSE_CB_ORDER));
+	wParam = (ELLIPSE_CB_ORDER*)update_message_order_new(context, ellipseCB,
+	                                                     sizeof(ELLIPSE_CB_ORDER));
 
 	if (!wParam)
 		return FALSE;
-
-	CopyMemory(wParam, ellipseCB, sizeof(ELLIPSE_CB_ORDER));
 	wParam->brush.data = (BYTE*)wParam->brush.p8x8;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(PrimaryUpdate, EllipseCB),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(PrimaryUpdate, EllipseCB), wParam);
 }
 
 /* Secondary Update */
@@ -818,131 +1088,204 @@ static BOOL update_message_CacheBitmap(rdpContext* context,
                                        const CACHE_BITMAP_ORDER* cacheBitmapOrder)
 {
 	CACHE_BITMAP_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !cacheBitmapOrder)
 		return FALSE;
 
-	wParam = copy_cache_bitmap_order(context, cacheBitmapOrder);
+	wParam = (CACHE_BITMAP_ORDER*)update_message_order_new(context, cacheBitmapOrder,
+	                                                       sizeof(CACHE_BITMAP_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(SecondaryUpdate, CacheBitmap),
-	                         (void*)wParam, NULL);
+	wParam->bitmapDataStream = (BYTE*)update_message_order_dup(
+	    wParam, cacheBitmapOrder->bitmapDataStream, cacheBitmapOrder->bitmapLength);
+
+	if (!wParam->bitmapDataStream && (cacheBitmapOrder->bitmapLength > 0))
+	{
+		update_message_order_free(wParam);
+		return FALSE;
+	}
+
+	return update_message_post_order(context, MakeMessageId(SecondaryUpdate, CacheBitmap),
+	                                 wParam);
 }
 
 static BOOL update_message_CacheBitmapV2(rdpContext* context,
                                          CACHE_BITMAP_V2_ORDER* cacheBitmapV2Order)
 {
 	CACHE_BITMAP_V2_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !cacheBitmapV2Order)
 		return FALSE;
 
-	wParam = copy_cache_bitmap_v2_order(context, cacheBitmapV2Order);
+	wParam = (CACHE_BITMAP_V2_ORDER*)update_message_order_new(context, cacheBitmapV2Order,
+	                                                          sizeof(CACHE_BITMAP_V2_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context,
-	                         MakeMessageId(SecondaryUpdate, CacheBitmapV2), (void*)wParam, NULL);
+	wParam->bitmapDataStream = (BYTE*)update_message_order_dup(
+	    wParam, cacheBitmapV2Order->bitmapDataStream, cacheBitmapV2Order->bitmapLength);
+
+	if (!wParam->bitmapDataStream && (cacheBitmapV2Order->bitmapLength > 0))
+	{
+		update_message_order_free(wParam);
+		return FALSE;
+	}
+
+	return update_message_post_order(context, MakeMessageId(SecondaryUpdate, CacheBitmapV2),
+	                                 wParam);
 }
 
 static BOOL update_message_CacheBitmapV3(rdpContext* context,
                                          CACHE_BITMAP_V3_ORDER* cacheBitmapV3Order)
 {
 	CACHE_BITMAP_V3_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !cacheBitmapV3Order)
 		return FALSE;
 
-	wParam = copy_cache_bitmap_v3_order(context, cacheBitmapV3Order);
+	wParam = (CACHE_BITMAP_V3_ORDER*)update_message_order_new(context, cacheBitmapV3Order,
+	                                                          sizeof(CACHE_BITMAP_V3_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context,
-	                         MakeMessageId(SecondaryUpdate, CacheBitmapV3), (void*)wParam, NULL);
+	wParam->bitmapData.data = (BYTE*)update_message_order_dup(
+	    wParam, cacheBitmapV3Order->bitmapData.data, cacheBitmapV3Order->bitmapData.length);
+
+	if (!wParam->bitmapData.data && (cacheBitmapV3Order->bitmapData.length > 0))
+	{
+		update_message_order_free(wParam);
+		return FALSE;
+	}
+
+	return update_message_post_order(context, MakeMessageId(SecondaryUpdate, CacheBitmapV3),
+	                                 wParam);
 }
 
 static BOOL update_message_CacheColorTable(rdpContext* context,
                                            const CACHE_COLOR_TABLE_ORDER* cacheColorTableOrder)
 {
 	CACHE_COLOR_TABLE_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !cacheColorTableOrder)
 		return FALSE;
 
-	wParam = copy_cache_color_table_order(context, cacheColorTableOrder);
+	wParam = (CACHE_COLOR_TABLE_ORDER*)update_message_order_new(context, cacheColorTableOrder,
+	                                                            sizeof(CACHE_COLOR_TABLE_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context,
-	                         MakeMessageId(SecondaryUpdate, CacheColorTable), (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(SecondaryUpdate, CacheColorTable),
+	                                 wParam);
 }
 
 static BOOL update_message_CacheGlyph(rdpContext* context, const CACHE_GLYPH_ORDER* cacheGlyphOrder)
 {
 	CACHE_GLYPH_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !cacheGlyphOrder)
 		return FALSE;
 
-	wParam = copy_cache_glyph_order(context, cacheGlyphOrder);
+	wParam = (CACHE_GLYPH_ORDER*)update_message_order_new(context, cacheGlyphOrder,
+	                                                      sizeof(CACHE_GLYPH_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(SecondaryUpdate, CacheGlyph),
-	                         (void*)wParam, NULL);
+	for (size_t x = 0; x < ARRAYSIZE(wParam->glyphData); x++)
+	{
+		const GLYPH_DATA* src = &cacheGlyphOrder->glyphData[x];
+		GLYPH_DATA* data = &wParam->glyphData[x];
+
+		data->aj = NULL;
+		if ((x >= cacheGlyphOrder->cGlyphs) || !src->aj)
+			continue;
+
+		data->aj = (BYTE*)update_message_order_dup(wParam, src->aj, src->cb);
+		if (!data->aj && (src->cb > 0))
+			goto fail;
+	}
+
+	wParam->unicodeCharacters = NULL;
+	if (cacheGlyphOrder->unicodeCharacters && (cacheGlyphOrder->cGlyphs > 0))
+	{
+		wParam->unicodeCharacters = (WCHAR*)update_message_order_dup(
+		    wParam, cacheGlyphOrder->unicodeCharacters, sizeof(WCHAR) * cacheGlyphOrder->cGlyphs);
+		if (!wParam->unicodeCharacters)
+			goto fail;
+	}
+
+	return update_message_post_order(context, MakeMessageId(SecondaryUpdate, CacheGlyph), wParam);
+
+fail:
+	update_message_order_free(wParam);
+	return FALSE;
 }
 
 static BOOL update_message_CacheGlyphV2(rdpContext* context,
                                         const CACHE_GLYPH_V2_ORDER* cacheGlyphV2Order)
 {
 	CACHE_GLYPH_V2_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !cacheGlyphV2Order)
 		return FALSE;
 
-	wParam = copy_cache_glyph_v2_order(context, cacheGlyphV2Order);
+	wParam = (CACHE_GLYPH_V2_ORDER*)update_message_order_new(context, cacheGlyphV2Order,
+	                                                         sizeof(CACHE_GLYPH_V2_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context,
-	                         MakeMessageId(SecondaryUpdate, CacheGlyphV2), (void*)wParam, NULL);
+	for (size_t x = 0; x < ARRAYSIZE(wParam->glyphData); x++)
+	{
+		const GLYPH_DATA_V2* src = &cacheGlyphV2Order->glyphData[x];
+		GLYPH_DATA_V2* data = &wParam->glyphData[x];
+
+		data->aj = NULL;
+		if ((x >= cacheGlyphV2Order->cGlyphs) || !src->aj)
+			continue;
+
+		data->aj = (BYTE*)update_message_order_dup(wParam, src->aj, src->cb);
+		if (!data->aj && (src->cb > 0))
+			goto fail;
+	}
+
+	wParam->unicodeCharacters = NULL;
+	if (cacheGlyphV2Order->unicodeCharacters && (cacheGlyphV2Order->cGlyphs > 0))
+	{
+		wParam->unicodeCharacters =
+		    (WCHAR*)update_message_order_dup(wParam, cacheGlyphV2Order->unicodeCharacters,
+		                                     sizeof(WCHAR) * cacheGlyphV2Order->cGlyphs);
+		if (!wParam->unicodeCharacters)
+			goto fail;
+	}
+
+	return update_message_post_order(context, MakeMessageId(SecondaryUpdate, CacheGlyphV2),
+	                                 wParam);
+
+fail:
+	update_message_order_free(wParam);
+	return FALSE;
 }
 
 static BOOL update_message_CacheBrush(rdpContext* context, const CACHE_BRUSH_ORDER* cacheBrushOrder)
 {
 	CACHE_BRUSH_ORDER* wParam = NULL;
-	rdp_update_internal* up = NULL;
 
 	if (!context || !context->update || !cacheBrushOrder)
 		return FALSE;
 
-	wParam = copy_cache_brush_order(context, cacheBrushOrder);
+	wParam = (CACHE_BRUSH_ORDER*)update_message_order_new(context, cacheBrushOrder,
+	                                                      sizeof(CACHE_BRUSH_ORDER));
 
 	if (!wParam)
 		return FALSE;
 
-	up = update_cast(context->update);
-	return MessageQueue_Post(up->queue, (void*)context, MakeMessageId(SecondaryUpdate, CacheBrush),
-	                         (void*)wParam, NULL);
+	return update_message_post_order(context, MakeMessageId(SecondaryUpdate, CacheBrush), wParam);
 }
 
 /* Alternate Secondary Update */
@@ -1699,7 +2042,7 @@ static BOOL update_message_free_update_class(wMessage* msg, int type)
 			break;
 
 		case Update_SetBounds:
-			free(msg->wParam);
+			update_message_order_free(msg->wParam);
 			break;
 
 		case Update_Synchronize:
@@ -1865,107 +2208,29 @@ static BOOL update_message_free_primary_update_class(wMessage* msg, int type)
 	switch (type)
 	{
 		case PrimaryUpdate_DstBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_PatBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_ScrBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_OpaqueRect:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_DrawNineGrid:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_MultiDstBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_MultiPatBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_MultiScrBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_MultiOpaqueRect:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_MultiDrawNineGrid:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_LineTo:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_Polyline:
-		{
-			POLYLINE_ORDER* wParam = (POLYLINE_ORDER*)msg->wParam;
-			free(wParam->points);
-			free(wParam);
-		}
-		break;
-
 		case PrimaryUpdate_MemBlt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_Mem3Blt:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_SaveBitmap:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_GlyphIndex:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_FastIndex:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_FastGlyph:
-		{
-			FAST_GLYPH_ORDER* wParam = (FAST_GLYPH_ORDER*)msg->wParam;
-			free(wParam->glyphData.aj);
-			free(wParam);
-		}
-		break;
-
 		case PrimaryUpdate_PolygonSC:
-		{
-			POLYGON_SC_ORDER* wParam = (POLYGON_SC_ORDER*)msg->wParam;
-			free(wParam->points);
-			free(wParam);
-		}
-		break;
-
 		case PrimaryUpdate_PolygonCB:
-		{
-			POLYGON_CB_ORDER* wParam = (POLYGON_CB_ORDER*)msg->wParam;
-			free(wParam->points);
-			free(wParam);
-		}
-		break;
-
 		case PrimaryUpdate_EllipseSC:
-			free(msg->wParam);
-			break;
-
 		case PrimaryUpdate_EllipseCB:
-			free(msg->wParam);
+			/* the order and all data it references is a single copy */
+			update_message_order_free(msg->wParam);
 			break;
 
 		default:
@@ -2071,63 +2336,20 @@ static BOOL update_message_process_primary_update_class(rdpUpdateProxy* proxy, w
 
 static BOOL update_message_free_secondary_update_class(wMessage* msg, int type)
 {
-	rdpContext* context = NULL;
-
 	if (!msg)
 		return FALSE;
 
-	context = msg->context;
-
 	switch (type)
 	{
 		case SecondaryUpdate_CacheBitmap:
-		{
-			CACHE_BITMAP_ORDER* wParam = (CACHE_BITMAP_ORDER*)msg->wParam;
-			free_cache_bitmap_order(context, wParam);
-		}
-		break;
-
 		case SecondaryUpdate_CacheBitmapV2:
-		{
-			CACHE_BITMAP_V2_ORDER* wParam = (CACHE_BITMAP_V2_ORDER*)msg->wParam;
-			free_cache_bitmap_v2_order(context, wParam);
-		}
-		break;
-
 		case SecondaryUpdate_CacheBitmapV3:
-		{
-			CACHE_BITMAP_V3_ORDER* wParam = (CACHE_BITMAP_V3_ORDER*)msg->wParam;
-			free_cache_bitmap_v3_order(context, wParam);
-		}
-		break;
-
 		case SecondaryUpdate_CacheColorTable:
-		{
-			CACHE_COLOR_TABLE_ORDER* wParam = (CACHE_COLOR_TABLE_ORDER*)msg->wParam;
-			free_cache_color_table_order(context, wParam);
-		}
-		break;
-
 		case SecondaryUpdate_CacheGlyph:
-		{
-			CACHE_GLYPH_ORDER* wParam = (CACHE_GLYPH_ORDER*)msg->wParam;
-			free_cache_glyph_order(context, wParam);
-		}
-		break;
-
 		case SecondaryUpdate_CacheGlyphV2:
-		{
-			CACHE_GLYPH_V2_ORDER* wParam = (CACHE_GLYPH_V2_ORDER*)msg->wParam;
-			free_cache_glyph_v2_order(context, wParam);
-		}
-		break;
-
 		case SecondaryUpdate_CacheBrush:
-		{
-			CACHE_BRUSH_ORDER* wParam = (CACHE_BRUSH_ORDER*)msg->wParam;
-			free_cache_brush_order(context, wParam);
-		}
-		break;
+			update_message_order_free(msg->wParam);
+			break;
 
 		default:
 			return FALSE;
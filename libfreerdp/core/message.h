@@ -138,6 +138,22 @@ FREERDP_LOCAL void update_message_proxy_free(rdpUpdateProxy* message);
 WINPR_ATTR_MALLOC(update_message_proxy_free, 1)
 FREERDP_LOCAL rdpUpdateProxy* update_message_proxy_new(rdpUpdate* update);
 
+typedef struct rdp_update_message_arenas rdpUpdateMessageArenas;
+
+FREERDP_LOCAL void update_message_arenas_free(rdpUpdateMessageArenas* arenas);
+
+WINPR_ATTR_MALLOC(update_message_arenas_free, 1)
+FREERDP_LOCAL rdpUpdateMessageArenas* update_message_arenas_new(void);
+
+/** @brief hand back the arena of the current frame, called after EndPaint was posted */
+FREERDP_LOCAL void update_message_arenas_end_frame(rdpUpdateMessageArenas* arenas);
+
+/** @brief copy orders to individual heap allocations instead of arenas if \b enable is FALSE */
+FREERDP_LOCAL void update_message_arenas_enable(rdpUpdateMessageArenas* arenas, BOOL enable);
+
+/** @brief the number of heap allocations done for order copies so far */
+FREERDP_LOCAL size_t update_message_arenas_allocations(const rdpUpdateMessageArenas* arenas);
+
 /**
  * Input Message Queue
  */
@@ -19,8 +19,315 @@
 
 #include <freerdp/config.h>
 
+#include <stdarg.h>
+
+#include <winpr/assert.h>
+#include <winpr/interlocked.h>
+#include <winpr/stream.h>
+#include <winpr/sysinfo.h>
+
 #include "rdp.h"
 
+/* Log-linear buckets: values below 8 ns get a bucket each, every power of two above is split in
+ * 8 equal buckets. That keeps the relative error of a percentile below 1/8th with 496 buckets
+ * covering the whole UINT64 range. */
+#define METRICS_SUB_BITS 3
+#define METRICS_SUB_BUCKETS (1u << METRICS_SUB_BITS)
+#define METRICS_BUCKETS ((64 - METRICS_SUB_BITS + 1) * METRICS_SUB_BUCKETS)
+
+typedef struct
+{
+	volatile LONG buckets[METRICS_BUCKETS];
+	volatile LONGLONG total;
+	volatile LONGLONG max;
+} rdpMetricsHistogram;
+
+typedef struct
+{
+	rdpMetrics common;
+	rdpMetricsHistogram stages[FREERDP_METRICS_STAGE_COUNT];
+} rdpMetricsInternal;
+
+static rdpMetricsInternal* metrics_cast(rdpMetrics* metrics)
+{
+	WINPR_ASSERT(metrics);
+	return (rdpMetricsInternal*)metrics;
+}
+
+static const rdpMetricsInternal* metrics_cast_const(const rdpMetrics* metrics)
+{
+	WINPR_ASSERT(metrics);
+	return (const rdpMetricsInternal*)metrics;
+}
+
+static size_t metrics_bucket_index(UINT64 value)
+{
+	if (value < METRICS_SUB_BUCKETS)
+		return (size_t)value;
+
+	size_t msb = 63;
+	while ((value & (1ull << msb)) == 0)
+		msb--;
+
+	const size_t shift = msb - METRICS_SUB_BITS;
+	const size_t sub = (size_t)(value >> shift) & (METRICS_SUB_BUCKETS - 1);
+	return (shift + 1) * METRICS_SUB_BUCKETS + sub;
+}
+
+static UINT64 metrics_bucket_upper(size_t index)
+{
+	WINPR_ASSERT(index < METRICS_BUCKETS);
+
+	if (index < METRICS_SUB_BUCKETS)
+		return index;
+
+	const size_t shift = index / METRICS_SUB_BUCKETS - 1;
+	const UINT64 sub = index % METRICS_SUB_BUCKETS;
+	const UINT64 lower = (METRICS_SUB_BUCKETS + sub) << shift;
+	return lower + ((1ull << shift) - 1);
+}
+
+static void metrics_add64(volatile LONGLONG* target, UINT64 value)
+{
+	LONGLONG current = *target;
+	for (;;)
+	{
+		const LONGLONG next = (LONGLONG)((UINT64)current + value);
+		const LONGLONG prev = InterlockedCompareExchange64(target, next, current);
+		if (prev == current)
+			break;
+		current = prev;
+	}
+}
+
+static void metrics_max64(volatile LONGLONG* target, UINT64 value)
+{
+	LONGLONG current = *target;
+	while ((UINT64)current < value)
+	{
+		const LONGLONG prev = InterlockedCompareExchange64(target, (LONGLONG)value, current);
+		if (prev == current)
+			break;
+		current = prev;
+	}
+}
+
+static void metrics_store64(volatile LONGLONG* target, LONGLONG value)
+{
+	LONGLONG current = *target;
+	for (;;)
+	{
+		const LONGLONG prev = InterlockedCompareExchange64(target, value, current);
+		if (prev == current)
+			break;
+		current = prev;
+	}
+}
+
+static UINT64 metrics_load64(const volatile LONGLONG* target)
+{
+	return (UINT64)InterlockedCompareExchange64((volatile LONGLONG*)target, 0, 0);
+}
+
+const char* metrics_stage_name(FreeRDP_MetricsStage stage)
+{
+	switch (stage)
+	{
+		case FREERDP_METRICS_TRANSPORT_READ:
+			return "transport_read";
+		case FREERDP_METRICS_PDU_PROCESS:
+			return "pdu_process";
+		case FREERDP_METRICS_BULK_DECOMPRESS:
+			return "bulk_decompress";
+		case FREERDP_METRICS_FASTPATH_UPDATE:
+			return "fastpath_update";
+		case FREERDP_METRICS_ORDERS:
+			return "orders";
+		case FREERDP_METRICS_DECODE_INTERLEAVED:
+			return "decode_interleaved";
+		case FREERDP_METRICS_DECODE_PLANAR:
+			return "decode_planar";
+		case FREERDP_METRICS_DECODE_REMOTEFX:
+			return "decode_remotefx";
+		case FREERDP_METRICS_DECODE_NSCODEC:
+			return "decode_nscodec";
+		case FREERDP_METRICS_DECODE_CLEARCODEC:
+			return "decode_clearcodec";
+		case FREERDP_METRICS_DECODE_PROGRESSIVE:
+			return "decode_progressive";
+		case FREERDP_METRICS_DECODE_AVC:
+			return "decode_avc";
+		case FREERDP_METRICS_DECODE_UNCOMPRESSED:
+			return "decode_uncompressed";
+		case FREERDP_METRICS_GDI_OUTPUT:
+			return "gdi_output";
+		case FREERDP_METRICS_END_PAINT:
+			return "end_paint";
+		case FREERDP_METRICS_STAGE_COUNT:
+		default:
+			return "unknown";
+	}
+}
+
+UINT64 metrics_stage_begin(const rdpMetrics* metrics)
+{
+	if (!metrics)
+		return 0;
+	return winpr_GetTickCount64NS();
+}
+
+void metrics_stage_end(rdpMetrics* metrics, FreeRDP_MetricsStage stage, UINT64 begin)
+{
+	if (!metrics || (begin == 0))
+		return;
+
+	const UINT64 now = winpr_GetTickCount64NS();
+	(void)metrics_record(metrics, stage, (now > begin) ? now - begin : 0);
+}
+
+BOOL metrics_record(rdpMetrics* metrics, FreeRDP_MetricsStage stage, UINT64 ns)
+{
+	if (!metrics || (stage >= FREERDP_METRICS_STAGE_COUNT))
+		return FALSE;
+
+	rdpMetricsHistogram* hist = &metrics_cast(metrics)->stages[stage];
+	(void)InterlockedIncrement(&hist->buckets[metrics_bucket_index(ns)]);
+	metrics_add64(&hist->total, ns);
+	metrics_max64(&hist->max, ns);
+	return TRUE;
+}
+
+static UINT64 metrics_percentile(const UINT32* counts, UINT64 count, UINT64 max, UINT64 percent)
+{
+	if (count == 0)
+		return 0;
+
+	/* rank of the sample at the percentile, rounded up */
+	const UINT64 rank = (count * percent + 99) / 100;
+	UINT64 seen = 0;
+	for (size_t x = 0; x < METRICS_BUCKETS; x++)
+	{
+		seen += counts[x];
+		if (seen >= rank)
+			return MIN(metrics_bucket_upper(x), max);
+	}
+	return max;
+}
+
+BOOL metrics_get_summary(const rdpMetrics* metrics, FreeRDP_MetricsStage stage,
+                         FreeRDP_MetricsSummary* summary)
+{
+	if (!metrics || !summary || (stage >= FREERDP_METRICS_STAGE_COUNT))
+		return FALSE;
+
+	const rdpMetricsHistogram* hist = &metrics_cast_const(metrics)->stages[stage];
+	UINT32 counts[METRICS_BUCKETS] = { 0 };
+	UINT64 count = 0;
+
+	/* Recording continues while the snapshot is taken, count and percentiles are consistent
+	 * as they are derived from the same copy of the buckets. */
+	for (size_t x = 0; x < METRICS_BUCKETS; x++)
+	{
+		counts[x] = (UINT32)hist->buckets[x];
+		count += counts[x];
+	}
+
+	summary->count = count;
+	summary->total = metrics_load64(&hist->total);
+	summary->max = metrics_load64(&hist->max);
+	summary->p50 = metrics_percentile(counts, count, summary->max, 50);
+	summary->p90 = metrics_percentile(counts, count, summary->max, 90);
+	summary->p99 = metrics_percentile(counts, count, summary->max, 99);
+	return TRUE;
+}
+
+void metrics_reset(rdpMetrics* metrics)
+{
+	if (!metrics)
+		return;
+
+	rdpMetricsInternal* internal = metrics_cast(metrics);
+	for (size_t stage = 0; stage < FREERDP_METRICS_STAGE_COUNT; stage++)
+	{
+		rdpMetricsHistogram* hist = &internal->stages[stage];
+		for (size_t x = 0; x < METRICS_BUCKETS; x++)
+			(void)InterlockedExchange(&hist->buckets[x], 0);
+		metrics_store64(&hist->total, 0);
+		metrics_store64(&hist->max, 0);
+	}
+}
+
+WINPR_ATTR_FORMAT_ARG(2, 3)
+static BOOL metrics_json_printf(wStream* s, WINPR_FORMAT_ARG const char* fmt, ...)
+{
+	va_list ap = { 0 };
+	va_start(ap, fmt);
+	const int rc = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+
+	if (rc < 0)
+		return FALSE;
+
+	if (!Stream_EnsureRemainingCapacity(s, (size_t)rc + 1))
+		return FALSE;
+
+	char* ptr = Stream_PointerAs(s, char);
+	va_start(ap, fmt);
+	const int rc2 = vsnprintf(ptr, WINPR_ASSERTING_INT_CAST(size_t, rc) + 1, fmt, ap);
+	va_end(ap);
+	if (rc != rc2)
+		return FALSE;
+	return Stream_SafeSeek(s, (size_t)rc2);
+}
+
+char* metrics_to_json(const rdpMetrics* metrics, size_t* plength)
+{
+	char* json = NULL;
+
+	if (!metrics)
+		return NULL;
+
+	/* Written directly, the JSON backend of WinPR is optional */
+	wStream* s = Stream_New(NULL, 4096);
+	if (!s)
+		return NULL;
+
+	if (!metrics_json_printf(s,
+	                         "{\"compression\":{\"compressed_bytes\":%" PRIu64
+	                         ",\"uncompressed_bytes\":%" PRIu64 "},\"stages\":{",
+	                         metrics->TotalCompressedBytes, metrics->TotalUncompressedBytes))
+		goto fail;
+
+	for (size_t stage = 0; stage < FREERDP_METRICS_STAGE_COUNT; stage++)
+	{
+		FreeRDP_MetricsSummary summary = { 0 };
+		if (!metrics_get_summary(metrics, (FreeRDP_MetricsStage)stage, &summary))
+			goto fail;
+
+		if (!metrics_json_printf(s,
+		                         "%s\"%s\":{\"count\":%" PRIu64 ",\"total_ns\":%" PRIu64
+		                         ",\"max_ns\":%" PRIu64 ",\"p50_ns\":%" PRIu64
+		                         ",\"p90_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 "}",
+		                         (stage == 0) ? "" : ",",
+		                         metrics_stage_name((FreeRDP_MetricsStage)stage), summary.count,
+		                         summary.total, summary.max, summary.p50, summary.p90, summary.p99))
+			goto fail;
+	}
+
+	if (!metrics_json_printf(s, "}}"))
+		goto fail;
+
+	if (plength)
+		*plength = Stream_GetPosition(s);
+	json = Stream_BufferAs(s, char);
+	Stream_Free(s, FALSE);
+	return json;
+
+fail:
+	Stream_Free(s, TRUE);
+	return NULL;
+}
+
 double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes, UINT32 CompressedBytes)
 {
 	double CompressionRatio = 0.0;
@@ -39,16 +346,13 @@ double metrics_write_bytes(rdpMetrics* metrics, UINT32 UncompressedBytes, UINT32
 
 rdpMetrics* metrics_new(rdpContext* context)
 {
-	rdpMetrics* metrics = NULL;
+	rdpMetricsInternal* metrics = (rdpMetricsInternal*)calloc(1, sizeof(rdpMetricsInternal));
 
-	metrics = (rdpMetrics*)calloc(1, sizeof(rdpMetrics));
-
-	if (metrics)
-	{
-		metrics->context = context;
-	}
+	if (!metrics)
+		return NULL;
 
-	return metrics;
+	metrics->common.context = context;
+	return &metrics->common;
 }
 
 void metrics_free(rdpMetrics* metrics)
@@ -37,6 +37,7 @@
 #include <freerdp/redirection.h>
 #include <freerdp/crypto/certificate.h>
 
+#include "../crypto/tls.h"
 #include "rdp.h"
 #include "peer.h"
 #include "multitransport.h"
@@ -1490,6 +1491,7 @@ void freerdp_peer_free(freerdp_peer* client)
 		return;
 
 	sspi_FreeAuthIdentity(&client->identity);
+	freerdp_tls_session_cache_free(client->TlsSessionCache);
 	if (client->sockfd >= 0)
 		closesocket((SOCKET)client->sockfd);
 	free(client);
@@ -1555,6 +1557,7 @@ BOOL freerdp_peer_context_new_ex(freerdp_peer* client, const rdpSettings* settin
 		goto fail;
 
 	rdp_log_build_warnings(rdp);
+	rdp->tlsCache = freerdp_tls_session_cache_ref(client->TlsSessionCache);
 
 #if defined(WITH_FREERDP_DEPRECATED)
 	client->update = rdp->update;
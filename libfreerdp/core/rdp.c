@@ -2522,6 +2522,7 @@ void rdp_free(rdpRdp* rdp)
 		autodetect_free(rdp->autodetect);
 		heartbeat_free(rdp->heartbeat);
 		multitransport_free(rdp->multitransport);
+		freerdp_tls_session_cache_free(rdp->tlsCache);
 		bulk_free(rdp->bulk);
 		free(rdp->io);
 		PubSub_Free(rdp->pubSub);
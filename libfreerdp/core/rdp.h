@@ -50,6 +50,7 @@
 #include <freerdp/settings.h>
 #include <freerdp/log.h>
 #include <freerdp/api.h>
+#include <freerdp/crypto/tls_cache.h>
 
 #include <winpr/stream.h>
 #include <winpr/crypto.h>
@@ -164,6 +165,7 @@ struct rdp_rdp
 	rdpAutoDetect* autodetect;
 	rdpHeartbeat* heartbeat;
 	rdpMultitransport* multitransport;
+	rdpTlsSessionCache* tlsCache;
 	WINPR_RC4_CTX* rc4_decrypt_key;
 	UINT32 decrypt_use_count;
 	UINT32 decrypt_checksum_use_count;
@@ -947,6 +947,8 @@ rdpSettings* freerdp_settings_new(DWORD flags)
 	    !freerdp_settings_set_bool(settings, FreeRDP_LogonNotify, TRUE) ||
 	    !freerdp_settings_set_uint32(settings, FreeRDP_BrushSupportLevel, BRUSH_COLOR_FULL) ||
 	    !freerdp_settings_set_uint32(settings, FreeRDP_CompressionLevel, PACKET_COMPR_TYPE_RDP61) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_XCrushCompressionLevel,
+	                                 XCRUSH_LEVEL_DEFAULT) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_Authentication, TRUE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_AuthenticationOnly, FALSE) ||
 	    !freerdp_settings_set_bool(settings, FreeRDP_CredentialsFromStdin, FALSE) ||
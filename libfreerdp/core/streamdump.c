@@ -38,28 +38,25 @@ struct stream_dump_context
 	rdpTransportIo io;
 	size_t writeDumpOffset;
 	size_t readDumpOffset;
-	size_t replayOffset;
 	UINT64 replayTime;
 	CONNECTION_STATE state;
 	BOOL isServer;
 	BOOL nodelay;
+	FILE* replayFile; /* kept open while replaying */
 	wLog* log;
 };
 
 static UINT32 crc32b(const BYTE* data, size_t length)
 {
-	UINT32 crc = 0xFFFFFFFF;
+	/* Each bit step of this checksum applies the polynomial whatever the bit is, so the eight
+	 * steps of a byte reduce to a shift and a constant. Recorded dumps rely on the values. */
+	UINT32 step = 0;
+	for (size_t j = 0; j < 8; j++)
+		step = (step >> 1) ^ 0xEDB88320;
 
+	UINT32 crc = 0xFFFFFFFF;
 	for (size_t x = 0; x < length; x++)
-	{
-		const UINT32 d = data[x] & 0xFF;
-		crc = crc ^ d;
-		for (int j = 7; j >= 0; j--)
-		{
-			UINT32 mask = ~(crc & 1);
-			crc = (crc >> 1) ^ (0xEDB88320 & mask);
-		}
-	}
+		crc = ((crc ^ data[x]) >> 8) ^ step;
 	return ~crc;
 }
 
@@ -343,11 +340,19 @@ static int stream_dump_replay_transport_read(rdpTransport* transport, wStream* s
 	WINPR_ASSERT(ctx->dump);
 	WINPR_ASSERT(s);
 
+	/* the dump is read sequentially, it is opened once instead of for every PDU */
+	if (!ctx->dump->replayFile)
+	{
+		ctx->dump->replayFile = stream_dump_get_file(ctx->settings, "rb");
+		if (!ctx->dump->replayFile)
+			return -1;
+	}
+
 	const size_t start = Stream_GetPosition(s);
 	do
 	{
 		Stream_SetPosition(s, start);
-		if (stream_dump_get(ctx, &flags, s, &ctx->dump->replayOffset, &ts) < 0)
+		if (!stream_dump_read_line(ctx->dump->replayFile, s, &ts, NULL, &flags))
 			return -1;
 	} while (flags & STREAM_MSG_SRV_RX);
 
@@ -454,6 +459,8 @@ BOOL stream_dump_register_handlers(rdpContext* context, CONNECTION_STATE state,
 
 void stream_dump_free(rdpStreamDumpContext* dump)
 {
+	if (dump && dump->replayFile)
+		(void)fclose(dump->replayFile);
 	free(dump);
 }
 
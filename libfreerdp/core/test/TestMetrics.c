@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <winpr/thread.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/metrics.h>
+
+#define THREAD_COUNT 4
+#define THREAD_SAMPLES 10000
+
+static BOOL test_percentiles(void)
+{
+	BOOL rc = FALSE;
+	FreeRDP_MetricsSummary summary = { 0 };
+	rdpMetrics* metrics = metrics_new(NULL);
+
+	if (!metrics)
+		return FALSE;
+
+	/* 1..1000 us, the percentiles are exact up to the bucket width of 1/8th */
+	for (UINT64 x = 1; x <= 1000; x++)
+	{
+		if (!metrics_record(metrics, FREERDP_METRICS_DECODE_PLANAR, x * 1000))
+			goto fail;
+	}
+
+	if (!metrics_get_summary(metrics, FREERDP_METRICS_DECODE_PLANAR, &summary))
+		goto fail;
+
+	if ((summary.count != 1000) || (summary.total != 500500000) || (summary.max != 1000000))
+	{
+		(void)fprintf(stderr, "unexpected count %" PRIu64 ", total %" PRIu64 ", max %" PRIu64 "\n",
+		              summary.count, summary.total, summary.max);
+		goto fail;
+	}
+
+	if ((summary.p50 < 500000) || (summary.p50 > 500000 + 500000 / 8) || (summary.p90 < 900000) ||
+	    (summary.p90 > 900000 + 900000 / 8) || (summary.p99 < 990000) ||
+	    (summary.p99 > summary.max))
+	{
+		(void)fprintf(stderr, "unexpected p50 %" PRIu64 ", p90 %" PRIu64 ", p99 %" PRIu64 "\n",
+		              summary.p50, summary.p90, summary.p99);
+		goto fail;
+	}
+
+	/* other stages are untouched */
+	if (!metrics_get_summary(metrics, FREERDP_METRICS_DECODE_AVC, &summary) ||
+	    (summary.count != 0) || (summary.p99 != 0))
+		goto fail;
+
+	if (metrics_record(metrics, FREERDP_METRICS_STAGE_COUNT, 1))
+		goto fail;
+
+	metrics_reset(metrics);
+	if (!metrics_get_summary(metrics, FREERDP_METRICS_DECODE_PLANAR, &summary) ||
+	    (summary.count != 0) || (summary.total != 0) || (summary.max != 0))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	metrics_free(metrics);
+	return rc;
+}
+
+static DWORD WINAPI test_record_thread(LPVOID arg)
+{
+	rdpMetrics* metrics = arg;
+
+	for (UINT64 x = 0; x < THREAD_SAMPLES; x++)
+		(void)metrics_record(metrics, FREERDP_METRICS_TRANSPORT_READ, x);
+	return 0;
+}
+
+static BOOL test_concurrent(void)
+{
+	BOOL rc = FALSE;
+	HANDLE threads[THREAD_COUNT] = { 0 };
+	FreeRDP_MetricsSummary summary = { 0 };
+	rdpMetrics* metrics = metrics_new(NULL);
+
+	if (!metrics)
+		return FALSE;
+
+	for (size_t x = 0; x < THREAD_COUNT; x++)
+	{
+		threads[x] = CreateThread(NULL, 0, test_record_thread, metrics, 0, NULL);
+		if (!threads[x])
+			goto fail;
+	}
+
+	for (size_t x = 0; x < THREAD_COUNT; x++)
+		(void)WaitForSingleObject(threads[x], INFINITE);
+
+	if (!metrics_get_summary(metrics, FREERDP_METRICS_TRANSPORT_READ, &summary))
+		goto fail;
+
+	if ((summary.count != THREAD_COUNT * THREAD_SAMPLES) ||
+	    (summary.total != THREAD_COUNT * (THREAD_SAMPLES * (THREAD_SAMPLES - 1ull) / 2)) ||
+	    (summary.max != THREAD_SAMPLES - 1))
+	{
+		(void)fprintf(stderr, "lost samples: count %" PRIu64 ", total %" PRIu64 "\n",
+		              summary.count, summary.total);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	for (size_t x = 0; x < THREAD_COUNT; x++)
+	{
+		if (threads[x])
+			(void)CloseHandle(threads[x]);
+	}
+	metrics_free(metrics);
+	return rc;
+}
+
+static BOOL test_json(void)
+{
+	BOOL rc = FALSE;
+	size_t length = 0;
+	char* json = NULL;
+	rdpMetrics* metrics = metrics_new(NULL);
+
+	if (!metrics)
+		return FALSE;
+
+	const UINT64 begin = metrics_stage_begin(metrics);
+	if (begin == 0)
+		goto fail;
+	metrics_stage_end(metrics, FREERDP_METRICS_GDI_OUTPUT, begin);
+	(void)metrics_write_bytes(metrics, 200, 100);
+
+	json = metrics_to_json(metrics, &length);
+	if (!json || (strlen(json) != length))
+		goto fail;
+
+	if ((json[0] != '{') || (json[length - 1] != '}') ||
+	    !strstr(json, "\"compression\":{\"compressed_bytes\":100,\"uncompressed_bytes\":200}") ||
+	    !strstr(json, "\"gdi_output\":{\"count\":1,") ||
+	    !strstr(json, "\"transport_read\":{\"count\":0,\"total_ns\":0,"))
+	{
+		(void)fprintf(stderr, "unexpected JSON %s\n", json);
+		goto fail;
+	}
+
+	for (size_t x = 0; x < FREERDP_METRICS_STAGE_COUNT; x++)
+	{
+		const char* name = metrics_stage_name((FreeRDP_MetricsStage)x);
+		if (!name || (strcmp(name, "unknown") == 0) || !strstr(json, name))
+			goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(json);
+	metrics_free(metrics);
+	return rc;
+}
+
+int TestMetrics(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_percentiles())
+		return -1;
+	if (!test_concurrent())
+		return -1;
+	if (!test_json())
+		return -1;
+	return 0;
+}
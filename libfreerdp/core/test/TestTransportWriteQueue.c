@@ -0,0 +1,215 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/thread.h>
+#include <winpr/crypto.h>
+#include <winpr/winsock.h>
+
+#include <freerdp/freerdp.h>
+
+#include "../rdp.h"
+#include "../transport.h"
+
+#define QUEUE_LIMIT (256 * 1024)
+#define PDU_COUNT 2000
+
+typedef struct
+{
+	SOCKET sock;
+	size_t expected;
+	size_t received;
+	BOOL valid;
+} test_reader;
+
+static BYTE test_pattern(size_t offset)
+{
+	return (BYTE)((offset * 7) ^ (offset >> 9));
+}
+
+static DWORD WINAPI test_reader_thread(LPVOID arg)
+{
+	test_reader* reader = arg;
+	BYTE buffer[65536] = { 0 };
+
+	reader->valid = TRUE;
+
+	while (reader->received < reader->expected)
+	{
+		const int rc = recv(reader->sock, (char*)buffer, sizeof(buffer), 0);
+		if (rc <= 0)
+			break;
+
+		for (int x = 0; x < rc; x++)
+		{
+			if (buffer[x] != test_pattern(reader->received + (size_t)x))
+				reader->valid = FALSE;
+		}
+		reader->received += (size_t)rc;
+
+		/* a slow client, keeps the queue busy */
+		Sleep(1);
+	}
+
+	return 0;
+}
+
+static BOOL test_socket_pair(SOCKET* client, SOCKET* server)
+{
+	BOOL rc = FALSE;
+	struct sockaddr_in addr = { 0 };
+	socklen_t length = sizeof(addr);
+	SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+	if (listener == INVALID_SOCKET)
+		return FALSE;
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0) ||
+	    (getsockname(listener, (struct sockaddr*)&addr, &length) != 0) ||
+	    (listen(listener, 1) != 0))
+		goto fail;
+
+	*client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (*client == INVALID_SOCKET)
+		goto fail;
+
+	/* small kernel buffers, so the transport has to queue */
+	const int size = 16 * 1024;
+	if (setsockopt(*client, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof(size)) != 0)
+		goto fail;
+	if (connect(*client, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+		goto fail;
+
+	*server = accept(listener, NULL, NULL);
+	if (*server == INVALID_SOCKET)
+		goto fail;
+	rc = (setsockopt(*server, SOL_SOCKET, SO_SNDBUF, (const char*)&size, sizeof(size)) == 0);
+fail:
+	closesocket(listener);
+	return rc;
+}
+
+/* With disconnect set the transport is closed right after the last write, which still has
+ * to hand everything queued to the peer. */
+static BOOL test_write_queue(BOOL disconnect)
+{
+	BOOL rc = FALSE;
+	HANDLE thread = NULL;
+	SOCKET client = INVALID_SOCKET;
+	SOCKET server = INVALID_SOCKET;
+	size_t offset = 0;
+	size_t maxPdu = 0;
+	test_reader reader = { 0 };
+	FreeRDP_WriteQueueStats stats = { 0 };
+	freerdp* instance = freerdp_new();
+
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	rdpTransport* transport = instance->context->rdp->transport;
+
+	if (!test_socket_pair(&client, &server))
+		goto fail;
+	if (!transport_attach(transport, (int)server))
+		goto fail;
+	server = INVALID_SOCKET;
+
+	if (!transport_set_blocking_mode(transport, FALSE) ||
+	    !freerdp_set_write_queue_limit(instance->context, QUEUE_LIMIT))
+		goto fail;
+
+	UINT32 sizes[PDU_COUNT] = { 0 };
+	winpr_RAND(sizes, sizeof(sizes));
+	for (size_t x = 0; x < PDU_COUNT; x++)
+	{
+		sizes[x] = (x % 100 == 99) ? 100000 : 1 + sizes[x] % 3000;
+		reader.expected += sizes[x];
+		maxPdu = MAX(maxPdu, sizes[x]);
+	}
+
+	reader.sock = client;
+	thread = CreateThread(NULL, 0, test_reader_thread, &reader, 0, NULL);
+	if (!thread)
+		goto fail;
+
+	for (size_t x = 0; x < PDU_COUNT; x++)
+	{
+		wStream* s = Stream_New(NULL, sizes[x]);
+		if (!s)
+			goto fail;
+
+		for (size_t y = 0; y < sizes[x]; y++)
+		{
+			const BYTE value = test_pattern(offset++);
+			Stream_Write_UINT8(s, value);
+		}
+
+		/* the queue copies, the stream is gone before it is sent */
+		const int status = transport_write(transport, s);
+		Stream_Free(s, TRUE);
+		if (status < 0)
+			goto fail;
+	}
+
+	if (disconnect)
+	{
+		if (!transport_disconnect(transport))
+			goto fail;
+	}
+	else
+	{
+		while (transport_is_write_blocked(transport))
+		{
+			if (transport_drain_output_buffer(transport) < 0)
+				goto fail;
+			Sleep(1);
+		}
+	}
+
+	(void)WaitForSingleObject(thread, INFINITE);
+
+	if (!freerdp_get_write_queue_stats(instance->context, &stats))
+		goto fail;
+
+	printf("queued %" PRIu64 " writes %" PRIu64 " stalls %" PRIu64 " max depth %" PRIuz "\n",
+	       stats.queued, stats.writes, stats.stalls, stats.maxDepth);
+
+	if (!reader.valid || (reader.received != reader.expected))
+		goto fail;
+
+	if ((stats.queued != PDU_COUNT) || (stats.writes >= PDU_COUNT) || (stats.depth != 0) ||
+	    (stats.maxDepth > QUEUE_LIMIT + maxPdu) || freerdp_is_write_queue_full(instance->context))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	if (thread)
+	{
+		if (!rc)
+			shutdown(client, SD_BOTH);
+		(void)WaitForSingleObject(thread, INFINITE);
+		(void)CloseHandle(thread);
+	}
+	if (client != INVALID_SOCKET)
+		closesocket(client);
+	if (server != INVALID_SOCKET)
+		closesocket(server);
+	if (instance)
+		freerdp_context_free(instance);
+	freerdp_free(instance);
+	return rc;
+}
+
+int TestTransportWriteQueue(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_write_queue(FALSE))
+		return -1;
+	if (!test_write_queue(TRUE))
+		return -2;
+	return 0;
+}
@@ -0,0 +1,290 @@
+#include <stdio.h>
+
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/freerdp.h>
+
+#include "../update.h"
+#include "../message.h"
+
+#define TEST_FRAME_ORDERS 250
+
+typedef struct
+{
+	LONG volatile orders;
+	LONG volatile frames;
+	LONG volatile errors;
+} test_counters;
+
+static test_counters counters = { 0 };
+
+static BOOL test_count_order(rdpContext* context)
+{
+	WINPR_UNUSED(context);
+	(void)InterlockedIncrement(&counters.orders);
+	return TRUE;
+}
+
+static BOOL test_BeginPaint(rdpContext* context)
+{
+	WINPR_UNUSED(context);
+	return TRUE;
+}
+
+static BOOL test_EndPaint(rdpContext* context)
+{
+	WINPR_UNUSED(context);
+	(void)InterlockedIncrement(&counters.frames);
+	return TRUE;
+}
+
+static BOOL test_OpaqueRect(rdpContext* context, const OPAQUE_RECT_ORDER* order)
+{
+	if (!order || (order->nWidth == 0))
+		(void)InterlockedIncrement(&counters.errors);
+	return test_count_order(context);
+}
+
+static BOOL test_MemBlt(rdpContext* context, MEMBLT_ORDER* order)
+{
+	if (!order || (order->cacheIndex == 0))
+		(void)InterlockedIncrement(&counters.errors);
+	return test_count_order(context);
+}
+
+static BOOL test_GlyphIndex(rdpContext* context, GLYPH_INDEX_ORDER* order)
+{
+	if (!order || (order->cbData == 0) || (order->data[0] != 0x42))
+		(void)InterlockedIncrement(&counters.errors);
+	return test_count_order(context);
+}
+
+static BOOL test_Polyline(rdpContext* context, const POLYLINE_ORDER* order)
+{
+	if (!order || !order->points)
+		(void)InterlockedIncrement(&counters.errors);
+	else
+	{
+		for (UINT32 x = 0; x < order->numDeltaEntries; x++)
+		{
+			if ((order->points[x].x != (INT32)x) || (order->points[x].y != -(INT32)x))
+				(void)InterlockedIncrement(&counters.errors);
+		}
+	}
+	return test_count_order(context);
+}
+
+static BOOL test_FastGlyph(rdpContext* context, const FAST_GLYPH_ORDER* order)
+{
+	if (!order || !order->glyphData.aj)
+		(void)InterlockedIncrement(&counters.errors);
+	else
+	{
+		for (UINT32 x = 0; x < order->glyphData.cb; x++)
+		{
+			if (order->glyphData.aj[x] != (BYTE)x)
+				(void)InterlockedIncrement(&counters.errors);
+		}
+	}
+	return test_count_order(context);
+}
+
+static BOOL test_CacheBitmapV2(rdpContext* context, CACHE_BITMAP_V2_ORDER* order)
+{
+	if (!order || !order->bitmapDataStream || (order->bitmapLength == 0) ||
+	    (order->bitmapDataStream[order->bitmapLength - 1] != 0x23))
+		(void)InterlockedIncrement(&counters.errors);
+	return test_count_order(context);
+}
+
+static void test_register_callbacks(rdpUpdate* update)
+{
+	update->BeginPaint = test_BeginPaint;
+	update->EndPaint = test_EndPaint;
+	update->primary->OpaqueRect = test_OpaqueRect;
+	update->primary->MemBlt = test_MemBlt;
+	update->primary->GlyphIndex = test_GlyphIndex;
+	update->primary->Polyline = test_Polyline;
+	update->primary->FastGlyph = test_FastGlyph;
+	update->secondary->CacheBitmapV2 = test_CacheBitmapV2;
+}
+
+/* Replay a frame of a typical order mix through the update callbacks */
+static BOOL test_replay_frame(rdpContext* context, UINT32 frame)
+{
+	rdpUpdate* update = context->update;
+	BYTE glyph[128] = { 0 };
+	BYTE bitmap[4096] = { 0 };
+	DELTA_POINT points[32] = { 0 };
+
+	for (size_t x = 0; x < ARRAYSIZE(glyph); x++)
+		glyph[x] = (BYTE)x;
+	for (size_t x = 0; x < ARRAYSIZE(points); x++)
+	{
+		points[x].x = (INT32)x;
+		points[x].y = -(INT32)x;
+	}
+	bitmap[ARRAYSIZE(bitmap) - 1] = 0x23;
+
+	if (!update->BeginPaint(context))
+		return FALSE;
+
+	for (UINT32 x = 0; x < TEST_FRAME_ORDERS; x++)
+	{
+		BOOL rc = FALSE;
+
+		switch ((x + frame) % 10)
+		{
+			case 0:
+			{
+				CACHE_BITMAP_V2_ORDER order = { 0 };
+				order.cacheIndex = x;
+				order.bitmapDataStream = bitmap;
+				order.bitmapLength = (x % 2) ? sizeof(bitmap) : 512;
+				order.bitmapDataStream[order.bitmapLength - 1] = 0x23;
+				rc = update->secondary->CacheBitmapV2(context, &order);
+			}
+			break;
+
+			case 1:
+			case 2:
+			{
+				MEMBLT_ORDER order = { 0 };
+				order.cacheIndex = x + 1;
+				order.nWidth = 64;
+				order.nHeight = 64;
+				rc = update->primary->MemBlt(context, &order);
+			}
+			break;
+
+			case 3:
+			case 4:
+			case 5:
+			{
+				GLYPH_INDEX_ORDER order = { 0 };
+				order.cbData = 16;
+				order.data[0] = 0x42;
+				rc = update->primary->GlyphIndex(context, &order);
+			}
+			break;
+
+			case 6:
+			{
+				POLYLINE_ORDER order = { 0 };
+				order.numDeltaEntries = (x % ARRAYSIZE(points)) + 1;
+				order.points = points;
+				rc = update->primary->Polyline(context, &order);
+			}
+			break;
+
+			case 7:
+			{
+				FAST_GLYPH_ORDER order = { 0 };
+				order.cbData = 2 + sizeof(glyph);
+				order.glyphData.cb = sizeof(glyph);
+				order.glyphData.aj = glyph;
+				rc = update->primary->FastGlyph(context, &order);
+			}
+			break;
+
+			default:
+			{
+				OPAQUE_RECT_ORDER order = { 0 };
+				order.nWidth = 32;
+				order.nHeight = 32;
+				rc = update->primary->OpaqueRect(context, &order);
+			}
+			break;
+		}
+
+		if (!rc)
+			return FALSE;
+	}
+
+	return update->EndPaint(context);
+}
+
+static BOOL test_replay_context(rdpContext* context, BOOL arenas, UINT32 frames)
+{
+	rdpUpdate* update = context->update;
+	rdp_update_internal* up = update_cast(update);
+
+	test_register_callbacks(update);
+	update_message_arenas_enable(up->arenas, arenas);
+	const size_t allocations = update_message_arenas_allocations(up->arenas);
+	counters.orders = 0;
+	counters.frames = 0;
+	counters.errors = 0;
+
+	up->proxy = update_message_proxy_new(update);
+	if (!up->proxy)
+		return FALSE;
+
+	const UINT64 start = winpr_GetTickCount64NS();
+	BOOL rc = TRUE;
+	for (UINT32 x = 0; x < frames; x++)
+	{
+		if (!test_replay_frame(context, x))
+		{
+			rc = FALSE;
+			break;
+		}
+	}
+
+	/* Waits until the update thread processed all posted orders, the queue is closed after */
+	update_message_proxy_free(up->proxy);
+	up->proxy = NULL;
+
+	const UINT64 diff = winpr_GetTickCount64NS() - start;
+	const size_t allocs = update_message_arenas_allocations(up->arenas) - allocations;
+	const double seconds = (diff > 0) ? (double)diff / 1000000000.0 : 1e-9;
+
+	printf("[%s] arenas %-8s: %" PRIu32 " frames, %" PRId32 " orders in %" PRIu64
+	       "ms: %.0f orders/sec, %" PRIuz " allocations, %.0f allocations/sec\n",
+	       __func__, arenas ? "enabled" : "disabled", frames, counters.orders, diff / 1000000ull,
+	       counters.orders / seconds, allocs, allocs / seconds);
+
+	if (!rc || (counters.errors != 0) || (counters.frames != (LONG)frames) ||
+	    (counters.orders != (LONG)(frames * TEST_FRAME_ORDERS)))
+	{
+		printf("[%s] failed: %" PRId32 " errors, %" PRId32 " frames, %" PRId32 " orders\n",
+		       __func__, counters.errors, counters.frames, counters.orders);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* A message queue can not be reused after the proxy posted WMQ_QUIT, use a fresh instance */
+static BOOL test_replay(BOOL arenas, UINT32 frames)
+{
+	BOOL rc = FALSE;
+	freerdp* instance = freerdp_new();
+
+	if (!instance || !freerdp_context_new(instance))
+		goto fail;
+
+	rc = test_replay_context(instance->context, arenas, frames);
+fail:
+	if (instance)
+		freerdp_context_free(instance);
+	freerdp_free(instance);
+	return rc;
+}
+
+int TestUpdateMessage(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	/* before: every order copy is one or more heap allocations */
+	if (!test_replay(FALSE, 400))
+		return -1;
+
+	/* after: order copies are taken from per frame arenas */
+	if (!test_replay(TRUE, 400))
+		return -1;
+
+	return 0;
+}
@@ -344,6 +344,7 @@ static const size_t uint32_list_indices[] = {
 	FreeRDP_TlsSecLevel,
 	FreeRDP_VCChunkSize,
 	FreeRDP_VCFlags,
+	FreeRDP_XCrushCompressionLevel,
 };
 
 #define have_int32_list_indices
@@ -29,6 +29,8 @@
 #include <winpr/stream.h>
 #include <winpr/winsock.h>
 #include <winpr/crypto.h>
+#include <winpr/sysinfo.h>
+#include <winpr/collections.h>
 
 #include <freerdp/log.h>
 #include <freerdp/error.h>
@@ -65,6 +67,12 @@
 
 #define BUFFER_SIZE 16384
 
+/* PDUs queued back to back are merged into socket writes of up to this size */
+#define WRITE_QUEUE_BATCH_SIZE 65536
+
+/* How long a disconnect waits for the peer to take the PDUs still queued, in ms */
+#define WRITE_QUEUE_DISCONNECT_TIMEOUT 1000
+
 struct rdp_transport
 {
 	TRANSPORT_LAYER layer;
@@ -88,6 +96,11 @@ struct rdp_transport
 	CRITICAL_SECTION ReadLock;
 	CRITICAL_SECTION WriteLock;
 	ULONG written;
+	CRITICAL_SECTION WriteQueueLock;
+	wLinkedList* WriteQueue;
+	wStreamPool* WritePool;
+	wStream* WriteCurrent;
+	FreeRDP_WriteQueueStats WriteQueueStats;
 	HANDLE rereadEvent;
 	BOOL haveMoreBytesToRead;
 	wLog* log;
@@ -97,6 +110,8 @@ struct rdp_transport
 	BOOL earlyUserAuth;
 };
 
+static int transport_write_queue_flush(rdpTransport* transport, DWORD timeout);
+
 static void transport_ssl_cb(const SSL* ssl, int where, int ret)
 {
 	if (where & SSL_CB_ALERT)
@@ -281,6 +296,18 @@ BOOL transport_connect_tls(rdpTransport* transport)
 	return IFCALLRESULT(FALSE, transport->io.TLSConnect, transport);
 }
 
+/* TLS handshakes write to the BIO directly, PDUs still queued have to go out first */
+static BOOL transport_write_queue_sync(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteLock));
+	const int status =
+	    transport->frontBio ? transport_write_queue_flush(transport, INFINITE) : 1;
+	LeaveCriticalSection(&(transport->WriteLock));
+	return status >= 0;
+}
+
 static BOOL transport_default_connect_tls(rdpTransport* transport)
 {
 	int tlsStatus = 0;
@@ -296,9 +323,14 @@ static BOOL transport_default_connect_tls(rdpTransport* transport)
 	settings = context->settings;
 	WINPR_ASSERT(settings);
 
+	if (!transport_write_queue_sync(transport))
+		return FALSE;
+
 	if (!(tls = freerdp_tls_new(context)))
 		return FALSE;
 
+	freerdp_tls_set_session_cache(tls, context->rdp->tlsCache);
+
 	transport->tls = tls;
 
 	if (transport->GatewayEnabled)
@@ -648,9 +680,15 @@ static BOOL transport_default_accept_tls(rdpTransport* transport)
 	settings = context->settings;
 	WINPR_ASSERT(settings);
 
+	if (!transport_write_queue_sync(transport))
+		return FALSE;
+
 	if (!transport->tls)
 		transport->tls = freerdp_tls_new(context);
+	if (!transport->tls)
+		return FALSE;
 
+	freerdp_tls_set_session_cache(transport->tls, context->rdp->tlsCache);
 	transport->layer = TRANSPORT_LAYER_TLS;
 
 	if (!freerdp_tls_accept(transport->tls, transport->frontBio, settings))
@@ -1140,6 +1178,292 @@ static int transport_default_read_pdu(rdpTransport* transport, wStream* s)
 	return (int)len;
 }
 
+static BOOL transport_write_queue_enabled(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteQueueLock));
+	const BOOL enabled = !transport->blocking && (transport->WriteQueueStats.limit > 0);
+	LeaveCriticalSection(&(transport->WriteQueueLock));
+	return enabled;
+}
+
+static BOOL transport_write_queue_pending(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteQueueLock));
+	const BOOL pending = (transport->WriteQueueStats.depth > 0);
+	LeaveCriticalSection(&(transport->WriteQueueLock));
+	return pending;
+}
+
+/* Called with WriteQueueLock held, small PDUs are appended to the last queued batch */
+static BOOL transport_write_queue_append(rdpTransport* transport, const BYTE* data, size_t length)
+{
+	wStream* tail = LinkedList_Last(transport->WriteQueue);
+
+	if (tail && (Stream_GetPosition(tail) + length <= WRITE_QUEUE_BATCH_SIZE) &&
+	    Stream_CheckAndLogRequiredCapacity(TAG, tail, length))
+	{
+		Stream_Write(tail, data, length);
+		return TRUE;
+	}
+
+	wStream* s = StreamPool_Take(transport->WritePool, MAX(length, WRITE_QUEUE_BATCH_SIZE));
+	if (!s)
+		return FALSE;
+
+	Stream_Write(s, data, length);
+
+	if (!LinkedList_AddLast(transport->WriteQueue, s))
+	{
+		Stream_Release(s);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Called with WriteLock held
+ *
+ * @return 1 if the queue is empty, 0 if the socket would block and -1 on error
+ */
+static int transport_write_queue_drain(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	if (!transport->frontBio)
+		return -1;
+
+	while (1)
+	{
+		/* Only hand over more data once the buffered socket BIO below has sent its own */
+		if (BIO_write_blocked(transport->frontBio))
+		{
+			if (BIO_flush(transport->frontBio) < 1)
+				return -1;
+			if (BIO_write_blocked(transport->frontBio))
+				return 0;
+		}
+
+		if (!transport->WriteCurrent)
+		{
+			EnterCriticalSection(&(transport->WriteQueueLock));
+			wStream* s = LinkedList_First(transport->WriteQueue);
+
+			if (s)
+			{
+				LinkedList_RemoveFirst(transport->WriteQueue);
+				Stream_SealLength(s);
+				Stream_SetPosition(s, 0);
+			}
+
+			transport->WriteCurrent = s;
+			LeaveCriticalSection(&(transport->WriteQueueLock));
+
+			if (!s)
+				return 1;
+		}
+
+		wStream* s = transport->WriteCurrent;
+		const size_t length = Stream_GetRemainingLength(s);
+
+		ERR_clear_error();
+		const int status = BIO_write(transport->frontBio, Stream_ConstPointer(s),
+		                             (length > INT32_MAX) ? INT32_MAX : (int)length);
+
+		if (status <= 0)
+		{
+			if (!BIO_should_retry(transport->frontBio))
+			{
+				WLog_ERR_BIO(transport, "BIO_write", transport->frontBio);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		Stream_Seek(s, (size_t)status);
+
+		EnterCriticalSection(&(transport->WriteQueueLock));
+		transport->WriteQueueStats.depth -= (size_t)status;
+		transport->WriteQueueStats.writes++;
+		LeaveCriticalSection(&(transport->WriteQueueLock));
+
+		if (Stream_GetRemainingLength(s) == 0)
+		{
+			Stream_Release(s);
+			transport->WriteCurrent = NULL;
+		}
+	}
+}
+
+/* Called with WriteLock held, waits until everything queued is handed to the socket
+ *
+ * @return 1 if the queue is empty, 0 if the timeout expired first and -1 on error
+ */
+static int transport_write_queue_flush(rdpTransport* transport, DWORD timeout)
+{
+	const UINT64 start = GetTickCount64();
+
+	/* the buffered socket BIO may still hold the tail of the last batch */
+	while (transport_write_queue_pending(transport) || BIO_write_blocked(transport->frontBio))
+	{
+		const int status = transport_write_queue_drain(transport);
+
+		if (status < 0)
+			return -1;
+
+		if (status == 0)
+		{
+			if ((timeout != INFINITE) && (GetTickCount64() - start >= timeout))
+				return 0;
+
+			if (BIO_wait_write(transport->frontBio, 100) < 0)
+			{
+				WLog_ERR_BIO(transport, "BIO_wait_write", transport->frontBio);
+				return -1;
+			}
+		}
+	}
+
+	return 1;
+}
+
+/* Called with WriteLock held */
+static void transport_write_queue_clear(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteQueueLock));
+	wStream* s = NULL;
+	while ((s = LinkedList_First(transport->WriteQueue)))
+	{
+		LinkedList_RemoveFirst(transport->WriteQueue);
+		Stream_Release(s);
+	}
+
+	if (transport->WriteCurrent)
+		Stream_Release(transport->WriteCurrent);
+	transport->WriteCurrent = NULL;
+	transport->WriteQueueStats.depth = 0;
+	LeaveCriticalSection(&(transport->WriteQueueLock));
+}
+
+/* Releases a WriteLock taken to drain the queue. A writer queueing a PDU meanwhile failed
+ * TryEnterCriticalSection and left its PDU to us, so look again once the lock is dropped.
+ */
+static int transport_write_queue_unlock(rdpTransport* transport, int status)
+{
+	LeaveCriticalSection(&(transport->WriteLock));
+
+	while ((status > 0) && transport_write_queue_pending(transport) &&
+	       TryEnterCriticalSection(&(transport->WriteLock)))
+	{
+		status = transport_write_queue_drain(transport);
+		LeaveCriticalSection(&(transport->WriteLock));
+	}
+
+	return status;
+}
+
+/* Waits for space in the queue, driving the socket while it does */
+static int transport_write_queue_wait(rdpTransport* transport)
+{
+	int status = -1;
+
+	EnterCriticalSection(&(transport->WriteLock));
+	if (transport->frontBio && (transport->layer != TRANSPORT_LAYER_CLOSED))
+	{
+		status = transport_write_queue_drain(transport);
+
+		if ((status == 0) && (BIO_wait_write(transport->frontBio, 100) < 0))
+		{
+			WLog_ERR_BIO(transport, "BIO_wait_write", transport->frontBio);
+			status = -1;
+		}
+	}
+	return transport_write_queue_unlock(transport, status);
+}
+
+static void transport_write_failed(rdpTransport* transport)
+{
+	/* A write error indicates that the peer has dropped the connection */
+	transport->layer = TRANSPORT_LAYER_CLOSED;
+	freerdp_set_last_error_if_not(transport_get_context(transport),
+	                              FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
+}
+
+static int transport_write_queued(rdpTransport* transport, wStream* s)
+{
+	int status = 1;
+	UINT64 stallBegin = 0;
+	rdpContext* context = transport_get_context(transport);
+
+	WINPR_ASSERT(context);
+	WINPR_ASSERT(context->rdp);
+
+	const size_t length = Stream_GetPosition(s);
+	if (length > INT32_MAX)
+		return -1;
+
+	EnterCriticalSection(&(transport->WriteQueueLock));
+	FreeRDP_WriteQueueStats* stats = &transport->WriteQueueStats;
+
+	/* backpressure, a PDU larger than the limit is still accepted into an empty queue */
+	while ((stats->depth > 0) && (stats->depth + length > stats->limit))
+	{
+		if (stallBegin == 0)
+		{
+			stallBegin = winpr_GetTickCount64NS();
+			stats->stalls++;
+		}
+
+		LeaveCriticalSection(&(transport->WriteQueueLock));
+		status = transport_write_queue_wait(transport);
+		EnterCriticalSection(&(transport->WriteQueueLock));
+
+		if (status < 0)
+			break;
+	}
+
+	if (stallBegin != 0)
+		stats->stallTime += winpr_GetTickCount64NS() - stallBegin;
+
+	if ((status >= 0) && (length > 0))
+	{
+		if (transport_write_queue_append(transport, Stream_Buffer(s), length))
+		{
+			stats->depth += length;
+			stats->maxDepth = MAX(stats->maxDepth, stats->depth);
+			stats->queued++;
+			context->rdp->outBytes += length;
+			transport->written += length;
+			WLog_Packet(transport->log, WLOG_TRACE, Stream_Buffer(s), length,
+			            WLOG_PACKET_OUTBOUND);
+		}
+		else
+			status = -1;
+	}
+	LeaveCriticalSection(&(transport->WriteQueueLock));
+
+	/* whoever holds the write lock is draining already */
+	if ((status >= 0) && TryEnterCriticalSection(&(transport->WriteLock)))
+	{
+		status = transport_write_queue_drain(transport);
+		status = transport_write_queue_unlock(transport, status);
+	}
+
+	if (status < 0)
+	{
+		transport_write_failed(transport);
+		return -1;
+	}
+
+	return (int)length;
+}
+
 int transport_write(rdpTransport* transport, wStream* s)
 {
 	if (!transport)
@@ -1163,11 +1487,30 @@ static int transport_default_write(rdpTransport* transport, wStream* s)
 
 	rdpRdp* rdp = context->rdp;
 	if (!rdp)
-		goto fail;
+	{
+		status = -1;
+		goto out;
+	}
+
+	if (transport_write_queue_enabled(transport))
+	{
+		status = transport_write_queued(transport, s);
+		goto out;
+	}
 
 	EnterCriticalSection(&(transport->WriteLock));
 	if (!transport->frontBio)
+	{
+		status = -1;
 		goto out_cleanup;
+	}
+
+	/* PDUs still queued from non-blocking mode go first */
+	if (transport_write_queue_flush(transport, INFINITE) < 0)
+	{
+		status = -1;
+		goto out_cleanup;
+	}
 
 	size_t length = Stream_GetPosition(s);
 	size_t writtenlength = length;
@@ -1243,14 +1586,10 @@ static int transport_default_write(rdpTransport* transport, wStream* s)
 out_cleanup:
 
 	if (status < 0)
-	{
-		/* A write error indicates that the peer has dropped the connection */
-		transport->layer = TRANSPORT_LAYER_CLOSED;
-		freerdp_set_last_error_if_not(context, FREERDP_ERROR_CONNECT_TRANSPORT_FAILED);
-	}
+		transport_write_failed(transport);
 
 	LeaveCriticalSection(&(transport->WriteLock));
-fail:
+out:
 	Stream_Release(s);
 	return status;
 }
@@ -1386,7 +1725,9 @@ BOOL transport_is_write_blocked(rdpTransport* transport)
 {
 	WINPR_ASSERT(transport);
 	WINPR_ASSERT(transport->frontBio);
-	return BIO_write_blocked(transport->frontBio) != 0;
+	if (BIO_write_blocked(transport->frontBio) != 0)
+		return TRUE;
+	return transport_write_queue_pending(transport);
 }
 
 int transport_drain_output_buffer(rdpTransport* transport)
@@ -1395,6 +1736,20 @@ int transport_drain_output_buffer(rdpTransport* transport)
 
 	WINPR_ASSERT(transport);
 	WINPR_ASSERT(transport->frontBio);
+	if (transport_write_queue_pending(transport))
+	{
+		EnterCriticalSection(&(transport->WriteLock));
+		int rc = transport_write_queue_drain(transport);
+		rc = transport_write_queue_unlock(transport, rc);
+
+		if (rc < 0)
+		{
+			transport_write_failed(transport);
+			return -1;
+		}
+		return (rc == 0);
+	}
+
 	if (BIO_write_blocked(transport->frontBio))
 	{
 		if (BIO_flush(transport->frontBio) < 1)
@@ -1423,6 +1778,20 @@ int transport_check_fds(rdpTransport* transport)
 		return -1;
 	}
 
+	/* Hand queued PDUs to the socket unless a writer is busy doing that */
+	if (transport_write_queue_pending(transport) &&
+	    TryEnterCriticalSection(&(transport->WriteLock)))
+	{
+		status = transport_write_queue_drain(transport);
+		status = transport_write_queue_unlock(transport, status);
+
+		if (status < 0)
+		{
+			transport_write_failed(transport);
+			return -1;
+		}
+	}
+
 	/**
 	 * Note: transport_read_pdu tries to read one PDU from
 	 * the transport layer.
@@ -1432,6 +1801,7 @@ int transport_check_fds(rdpTransport* transport)
 	 * Note that transport->ReceiveBuffer is replaced after each iteration
 	 * of this loop with a fresh stream instance from a pool.
 	 */
+	const UINT64 readBegin = metrics_stage_begin(context->metrics);
 	if ((status = transport_read_pdu(transport, transport->ReceiveBuffer)) <= 0)
 	{
 		if (status < 0)
@@ -1445,6 +1815,7 @@ int transport_check_fds(rdpTransport* transport)
 		return status;
 	}
 
+	metrics_stage_end(context->metrics, FREERDP_METRICS_TRANSPORT_READ, readBegin);
 	received = transport->ReceiveBuffer;
 
 	if (!(transport->ReceiveBuffer = StreamPool_Take(transport->ReceivePool, 0)))
@@ -1457,7 +1828,9 @@ int transport_check_fds(rdpTransport* transport)
 	 * 	 1: redirection
 	 */
 	WINPR_ASSERT(transport->ReceiveCallback);
+	const UINT64 processBegin = metrics_stage_begin(context->metrics);
 	recv_status = transport->ReceiveCallback(transport, received, transport->ReceiveExtra);
+	metrics_stage_end(context->metrics, FREERDP_METRICS_PDU_PROCESS, processBegin);
 	Stream_Release(received);
 
 	if (state_run_failed(recv_status))
@@ -1596,6 +1969,14 @@ static BOOL transport_default_disconnect(rdpTransport* transport)
 
 	EnterCriticalSection(&(transport->ReadLock));
 	EnterCriticalSection(&(transport->WriteLock));
+
+	/* PDUs sent right before disconnecting (Set Error Info, Deactivate All) are still queued */
+	if (transport->frontBio && (transport->layer != TRANSPORT_LAYER_CLOSED) &&
+	    (transport_write_queue_flush(transport, WRITE_QUEUE_DISCONNECT_TIMEOUT) == 0))
+		WLog_Print(transport->log, WLOG_WARN,
+		           "disconnect: dropping queued PDUs, the peer did not read them in time");
+	transport_write_queue_clear(transport);
+
 	if (transport->tls)
 	{
 		freerdp_tls_free(transport->tls);
@@ -1698,6 +2079,17 @@ rdpTransport* transport_new(rdpContext* context)
 	if (!InitializeCriticalSectionAndSpinCount(&(transport->WriteLock), 4000))
 		goto fail;
 
+	if (!InitializeCriticalSectionAndSpinCount(&(transport->WriteQueueLock), 4000))
+		goto fail;
+
+	transport->WriteQueue = LinkedList_New();
+	if (!transport->WriteQueue)
+		goto fail;
+
+	transport->WritePool = StreamPool_New(TRUE, WRITE_QUEUE_BATCH_SIZE);
+	if (!transport->WritePool)
+		goto fail;
+
 	return transport;
 fail:
 	WINPR_PRAGMA_DIAG_PUSH
@@ -1735,6 +2127,10 @@ void transport_free(rdpTransport* transport)
 
 	LeaveCriticalSection(&(transport->WriteLock));
 	DeleteCriticalSection(&(transport->WriteLock));
+
+	LinkedList_Free(transport->WriteQueue);
+	StreamPool_Free(transport->WritePool);
+	DeleteCriticalSection(&(transport->WriteQueueLock));
 	free(transport);
 }
 
@@ -1817,6 +2213,38 @@ wStream* transport_take_from_pool(rdpTransport* transport, size_t size)
 	return StreamPool_Take(transport->ReceivePool, size);
 }
 
+BOOL transport_set_write_queue_limit(rdpTransport* transport, size_t limit)
+{
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteQueueLock));
+	transport->WriteQueueStats.limit = limit;
+	LeaveCriticalSection(&(transport->WriteQueueLock));
+	return TRUE;
+}
+
+BOOL transport_get_write_queue_stats(rdpTransport* transport, FreeRDP_WriteQueueStats* stats)
+{
+	WINPR_ASSERT(transport);
+	WINPR_ASSERT(stats);
+
+	EnterCriticalSection(&(transport->WriteQueueLock));
+	*stats = transport->WriteQueueStats;
+	LeaveCriticalSection(&(transport->WriteQueueLock));
+	return TRUE;
+}
+
+BOOL transport_is_write_queue_full(rdpTransport* transport)
+{
+	WINPR_ASSERT(transport);
+
+	EnterCriticalSection(&(transport->WriteQueueLock));
+	const FreeRDP_WriteQueueStats* stats = &transport->WriteQueueStats;
+	const BOOL full = (stats->limit > 0) && (stats->depth >= stats->limit);
+	LeaveCriticalSection(&(transport->WriteQueueLock));
+	return full;
+}
+
 ULONG transport_get_bytes_sent(rdpTransport* transport, BOOL resetCount)
 {
 	ULONG rc = 0;
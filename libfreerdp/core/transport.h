@@ -125,6 +125,11 @@ FREERDP_LOCAL void transport_set_aad_mode(rdpTransport* transport, BOOL AadMode)
 FREERDP_LOCAL BOOL transport_is_write_blocked(rdpTransport* transport);
 FREERDP_LOCAL int transport_drain_output_buffer(rdpTransport* transport);
 
+FREERDP_LOCAL BOOL transport_set_write_queue_limit(rdpTransport* transport, size_t limit);
+FREERDP_LOCAL BOOL transport_get_write_queue_stats(rdpTransport* transport,
+                                                   FreeRDP_WriteQueueStats* stats);
+FREERDP_LOCAL BOOL transport_is_write_queue_full(rdpTransport* transport);
+
 FREERDP_LOCAL BOOL transport_io_callback_set_event(rdpTransport* transport, BOOL set);
 
 FREERDP_LOCAL const rdpTransportIo* transport_get_io_callbacks(rdpTransport* transport);
@@ -842,8 +842,12 @@ BOOL update_recv(rdpUpdate* update, wStream* s)
 	switch (updateType)
 	{
 		case UPDATE_TYPE_ORDERS:
+		{
+			const UINT64 begin = metrics_stage_begin(context->metrics);
 			rc = update_recv_orders(update, s);
-			break;
+			metrics_stage_end(context->metrics, FREERDP_METRICS_ORDERS, begin);
+		}
+		break;
 
 		case UPDATE_TYPE_BITMAP:
 		{
@@ -3302,6 +3306,11 @@ rdpUpdate* update_new(rdpRdp* rdp)
 	if (!update->queue)
 		goto fail;
 
+	update->arenas = update_message_arenas_new();
+
+	if (!update->arenas)
+		goto fail;
+
 	return &update->common;
 fail:
 	WINPR_PRAGMA_DIAG_PUSH
@@ -3342,6 +3351,7 @@ void update_free(rdpUpdate* update)
 			free(update->window);
 
 		MessageQueue_Free(up->queue);
+		update_message_arenas_free(up->arenas);
 		DeleteCriticalSection(&up->mux);
 
 		if (up->us)
@@ -3399,7 +3409,9 @@ BOOL update_end_paint(rdpUpdate* update)
 	BOOL rc = TRUE;
 
 	WINPR_ASSERT(update);
+	const UINT64 begin = metrics_stage_begin(update->context->metrics);
 	IFCALLRET(update->EndPaint, rc, update->context);
+	metrics_stage_end(update->context->metrics, FREERDP_METRICS_END_PAINT, begin);
 	if (!rc)
 		WLog_WARN(TAG, "EndPaint call failed");
 
@@ -22,6 +22,7 @@
 
 #include "rdp.h"
 #include "orders.h"
+#include "message.h"
 
 #include <freerdp/types.h>
 #include <freerdp/update.h>
@@ -56,6 +57,7 @@ typedef struct
 	BOOL asynchronous;
 	rdpUpdateProxy* proxy;
 	wMessageQueue* queue;
+	rdpUpdateMessageArenas* arenas;
 
 	wStream* us;
 	UINT16 numberOrders;
@@ -0,0 +1,234 @@
+#include <stdio.h>
+
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/settings.h>
+#include <freerdp/crypto/certificate.h>
+#include <freerdp/crypto/privatekey.h>
+
+#include "../tls.h"
+
+#define TEST_CONNECTIONS 3
+
+static char* test_bio_string(BIO* bio)
+{
+	BUF_MEM* mem = NULL;
+
+	BIO_get_mem_ptr(bio, &mem);
+	if (!mem)
+		return NULL;
+	char* str = calloc(mem->length + 1, sizeof(char));
+	if (str)
+		memcpy(str, mem->data, mem->length);
+	return str;
+}
+
+/* a self signed certificate and its key */
+static BOOL test_prepare_server(rdpSettings* settings)
+{
+	BOOL rc = FALSE;
+	char* keyPem = NULL;
+	char* certPem = NULL;
+	BIO* keyBio = BIO_new(BIO_s_mem());
+	BIO* certBio = BIO_new(BIO_s_mem());
+	EVP_PKEY* pkey = EVP_RSA_gen(2048);
+	X509* x509 = X509_new();
+
+	if (!keyBio || !certBio || !pkey || !x509)
+		goto fail;
+
+	ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+	X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+	X509_gmtime_adj(X509_getm_notAfter(x509), 3600);
+	X509_set_pubkey(x509, pkey);
+	X509_NAME* name = X509_get_subject_name(x509);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1,
+	                           -1, 0);
+	X509_set_issuer_name(x509, name);
+	if (X509_sign(x509, pkey, EVP_sha256()) <= 0)
+		goto fail;
+
+	if (!PEM_write_bio_PrivateKey(keyBio, pkey, NULL, NULL, 0, NULL, NULL) ||
+	    !PEM_write_bio_X509(certBio, x509))
+		goto fail;
+
+	keyPem = test_bio_string(keyBio);
+	certPem = test_bio_string(certBio);
+	if (!keyPem || !certPem)
+		goto fail;
+
+	rdpPrivateKey* key = freerdp_key_new_from_pem(keyPem);
+	if (!freerdp_settings_set_pointer_len(settings, FreeRDP_RdpServerRsaKey, key, 1))
+		goto fail;
+	rdpCertificate* cert = freerdp_certificate_new_from_pem(certPem);
+	if (!freerdp_settings_set_pointer_len(settings, FreeRDP_RdpServerCertificate, cert, 1))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	free(keyPem);
+	free(certPem);
+	X509_free(x509);
+	EVP_PKEY_free(pkey);
+	BIO_free(keyBio);
+	BIO_free(certBio);
+	return rc;
+}
+
+/* Runs both sides of a handshake over a memory BIO pair */
+static BOOL test_connect(rdpContext* server, rdpContext* client, rdpTlsSessionCache* serverCache,
+                         rdpTlsSessionCache* clientCache, SSL_CTX** serverCtx, BOOL* resumed)
+{
+	BOOL rc = FALSE;
+	BIO* sbio = NULL;
+	BIO* cbio = NULL;
+	rdpTls* stls = freerdp_tls_new(server);
+	rdpTls* ctls = freerdp_tls_new(client);
+
+	if (!stls || !ctls || !BIO_new_bio_pair(&sbio, 0, &cbio, 0))
+		goto fail;
+
+	freerdp_tls_set_session_cache(stls, serverCache);
+	freerdp_tls_set_session_cache(ctls, clientCache);
+	ctls->hostname = "localhost";
+	ctls->port = 3389;
+
+	TlsHandshakeResult cres =
+	    freerdp_tls_connect_ex(ctls, cbio, freerdp_tls_get_ssl_method(FALSE, TRUE));
+	TlsHandshakeResult sres = freerdp_tls_accept_ex(stls, sbio, server->settings,
+	                                                freerdp_tls_get_ssl_method(FALSE, FALSE));
+	cbio = NULL;
+	sbio = NULL;
+
+	for (size_t x = 0; x < 100; x++)
+	{
+		if ((cres == TLS_HANDSHAKE_SUCCESS) && (sres == TLS_HANDSHAKE_SUCCESS))
+			break;
+		if ((cres != TLS_HANDSHAKE_SUCCESS) && (cres != TLS_HANDSHAKE_CONTINUE))
+			goto fail;
+		if ((sres != TLS_HANDSHAKE_SUCCESS) && (sres != TLS_HANDSHAKE_CONTINUE))
+			goto fail;
+
+		if (cres == TLS_HANDSHAKE_CONTINUE)
+			cres = freerdp_tls_handshake(ctls);
+		if (sres == TLS_HANDSHAKE_CONTINUE)
+			sres = freerdp_tls_handshake(stls);
+	}
+
+	if ((cres != TLS_HANDSHAKE_SUCCESS) || (sres != TLS_HANDSHAKE_SUCCESS))
+		goto fail;
+
+	/* TLS 1.3 session tickets are sent after the handshake, along with the first data */
+	const char data[] = "ping";
+	char buffer[sizeof(data)] = { 0 };
+	if (freerdp_tls_write_all(stls, (const BYTE*)data, sizeof(data)) != sizeof(data))
+		goto fail;
+	if (BIO_read(ctls->bio, buffer, sizeof(buffer)) != sizeof(buffer))
+		goto fail;
+	if (memcmp(data, buffer, sizeof(data)) != 0)
+		goto fail;
+
+	*resumed = SSL_session_reused(ctls->ssl) == 1;
+	*serverCtx = SSL_get_SSL_CTX(stls->ssl);
+	rc = TRUE;
+fail:
+	BIO_free(sbio);
+	BIO_free(cbio);
+	freerdp_tls_free(stls);
+	freerdp_tls_free(ctls);
+	return rc;
+}
+
+static BOOL test_resume(rdpContext* server, rdpContext* client)
+{
+	BOOL rc = FALSE;
+	BOOL resumed = FALSE;
+	SSL_CTX* first = NULL;
+	SSL_CTX* ctx = NULL;
+	rdpTlsSessionCache* serverCache = freerdp_tls_session_cache_new(TRUE);
+	rdpTlsSessionCache* clientCache = freerdp_tls_session_cache_new(FALSE);
+
+	if (!serverCache || !clientCache)
+		goto fail;
+
+	for (size_t x = 0; x < TEST_CONNECTIONS; x++)
+	{
+		if (!test_connect(server, client, serverCache, clientCache, &ctx, &resumed))
+		{
+			printf("connection %" PRIuz " failed\n", x);
+			goto fail;
+		}
+
+		/* the first connection does a full handshake, all others resume it */
+		if (resumed != (x > 0))
+		{
+			printf("connection %" PRIuz ": unexpected resumption state %d\n", x, resumed);
+			goto fail;
+		}
+
+		if (!first)
+			first = ctx;
+		else if (first != ctx)
+		{
+			printf("connection %" PRIuz " did not use the shared SSL_CTX\n", x);
+			goto fail;
+		}
+	}
+
+	/* no client cache, no resumption */
+	if (!test_connect(server, client, serverCache, NULL, &ctx, &resumed) || resumed)
+		goto fail;
+
+	/* a new server context does not know the sessions */
+	freerdp_tls_session_cache_free(serverCache);
+	serverCache = freerdp_tls_session_cache_new(TRUE);
+	if (!serverCache || !test_connect(server, client, serverCache, clientCache, &ctx, &resumed) ||
+	    resumed)
+		goto fail;
+
+	/* a cache can be used without a shared server context */
+	if (!test_connect(server, client, NULL, clientCache, &ctx, &resumed) || resumed)
+		goto fail;
+
+	rc = TRUE;
+fail:
+	freerdp_tls_session_cache_free(serverCache);
+	freerdp_tls_session_cache_free(clientCache);
+	return rc;
+}
+
+int TestTlsSessionCache(int argc, char* argv[])
+{
+	int rc = -1;
+	rdpContext server = { 0 };
+	rdpContext client = { 0 };
+	freerdp instance = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	server.settings = freerdp_settings_new(FREERDP_SETTINGS_SERVER_MODE);
+	client.settings = freerdp_settings_new(0);
+	if (!server.settings || !client.settings)
+		goto fail;
+
+	/* certificate verification needs an instance, the certificate is self signed */
+	if (!freerdp_settings_set_pointer(client.settings, FreeRDP_instance, &instance) ||
+	    !freerdp_settings_set_bool(client.settings, FreeRDP_IgnoreCertificate, TRUE))
+		goto fail;
+
+	if (!test_prepare_server(server.settings))
+		goto fail;
+
+	if (test_resume(&server, &client))
+		rc = 0;
+
+fail:
+	freerdp_settings_free(server.settings);
+	freerdp_settings_free(client.settings);
+	return rc;
+}
@@ -33,6 +33,8 @@
 #include <winpr/sspi.h>
 #include <winpr/ssl.h>
 #include <winpr/json.h>
+#include <winpr/collections.h>
+#include <winpr/interlocked.h>
 
 #include <winpr/stream.h>
 #include <freerdp/utils/ringbuffer.h>
@@ -759,82 +761,388 @@ static void tls_reset(rdpTls* tls)
 }
 
 #if OPENSSL_VERSION_NUMBER >= 0x010000000L
-static BOOL tls_prepare(rdpTls* tls, BIO* underlying, const SSL_METHOD* method, int options,
-                        BOOL clientMode)
+static SSL_CTX* tls_ctx_new(const rdpSettings* settings, const SSL_METHOD* method, int options)
 #else
-static BOOL tls_prepare(rdpTls* tls, BIO* underlying, SSL_METHOD* method, int options,
-                        BOOL clientMode)
+static SSL_CTX* tls_ctx_new(const rdpSettings* settings, SSL_METHOD* method, int options)
 #endif
 {
-	WINPR_ASSERT(tls);
-
-	rdpSettings* settings = tls->context->settings;
 	WINPR_ASSERT(settings);
 
-	tls_reset(tls);
-	tls->ctx = SSL_CTX_new(method);
-
-	tls->underlying = underlying;
+	SSL_CTX* ctx = SSL_CTX_new(method);
 
-	if (!tls->ctx)
+	if (!ctx)
 	{
 		WLog_ERR(TAG, "SSL_CTX_new failed");
-		return FALSE;
+		return NULL;
 	}
 
-	SSL_CTX_set_mode(tls->ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_ENABLE_PARTIAL_WRITE);
-	SSL_CTX_set_options(tls->ctx, WINPR_ASSERTING_INT_CAST(uint64_t, options));
-	SSL_CTX_set_read_ahead(tls->ctx, 1);
+	SSL_CTX_set_mode(ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_ENABLE_PARTIAL_WRITE);
+	SSL_CTX_set_options(ctx, WINPR_ASSERTING_INT_CAST(uint64_t, options));
+	SSL_CTX_set_read_ahead(ctx, 1);
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L || defined(LIBRESSL_VERSION_NUMBER)
 	UINT16 version = freerdp_settings_get_uint16(settings, FreeRDP_TLSMinVersion);
-	if (!SSL_CTX_set_min_proto_version(tls->ctx, version))
+	if (!SSL_CTX_set_min_proto_version(ctx, version))
 	{
 		WLog_ERR(TAG, "SSL_CTX_set_min_proto_version %s failed", version);
-		return FALSE;
+		goto fail;
 	}
 	version = freerdp_settings_get_uint16(settings, FreeRDP_TLSMaxVersion);
-	if (!SSL_CTX_set_max_proto_version(tls->ctx, version))
+	if (!SSL_CTX_set_max_proto_version(ctx, version))
 	{
 		WLog_ERR(TAG, "SSL_CTX_set_max_proto_version %s failed", version);
-		return FALSE;
+		goto fail;
 	}
 #endif
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L && !defined(LIBRESSL_VERSION_NUMBER)
-	SSL_CTX_set_security_level(tls->ctx, WINPR_ASSERTING_INT_CAST(int, settings->TlsSecLevel));
+	SSL_CTX_set_security_level(ctx, WINPR_ASSERTING_INT_CAST(int, settings->TlsSecLevel));
 #endif
 
 	if (settings->AllowedTlsCiphers)
 	{
-		if (!SSL_CTX_set_cipher_list(tls->ctx, settings->AllowedTlsCiphers))
+		if (!SSL_CTX_set_cipher_list(ctx, settings->AllowedTlsCiphers))
 		{
 			WLog_ERR(TAG, "SSL_CTX_set_cipher_list %s failed", settings->AllowedTlsCiphers);
-			return FALSE;
+			goto fail;
 		}
 	}
 
-	tls->bio = BIO_new_rdp_tls(tls->ctx, clientMode);
+	if (settings->TlsSecretsFile)
+	{
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+		InitOnceExecuteOnce(&secrets_file_idx_once, secrets_file_init_cb, NULL, NULL);
 
-	if (BIO_get_ssl(tls->bio, &tls->ssl) < 0)
+		if (secrets_file_idx != -1)
+			SSL_CTX_set_keylog_callback(ctx, SSLCTX_keylog_cb);
+#else
+		WLog_WARN(TAG, "Key-Logging not available - requires OpenSSL 1.1.1 or higher");
+#endif
+	}
+
+	return ctx;
+
+fail:
+	SSL_CTX_free(ctx);
+	return NULL;
+}
+
+#define TLS_SESSION_CACHE_MAX_HOSTS 1024
+
+struct rdp_tls_session_cache
+{
+	BOOL server;
+	volatile LONG refcount;
+	CRITICAL_SECTION lock;
+
+	/* shared by all connections, recreated if the settings of a connection differ */
+	SSL_CTX* ctx;
+	char* config;
+
+	/* client only: "host:port" -> SSL_SESSION of the last connection */
+	wHashTable* sessions;
+};
+
+static INIT_ONCE tls_idx_once = INIT_ONCE_STATIC_INIT;
+static int tls_idx = -1;
+
+static BOOL CALLBACK tls_idx_init_cb(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	tls_idx = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+
+	return (tls_idx != -1);
+}
+
+static void tls_session_free(void* obj)
+{
+	SSL_SESSION_free((SSL_SESSION*)obj);
+}
+
+/* Everything the SSL_CTX is created from */
+static char* tls_session_cache_config(const rdpTlsSessionCache* cache,
+                                      const rdpSettings* settings, const void* method,
+                                      int options)
+{
+	size_t len = 0;
+	char* config = NULL;
+	char* fingerprint = NULL;
+
+	if (cache->server)
 	{
-		WLog_ERR(TAG, "unable to retrieve the SSL of the connection");
+		const rdpCertificate* cert =
+		    freerdp_settings_get_pointer(settings, FreeRDP_RdpServerCertificate);
+		if (!cert)
+		{
+			WLog_ERR(TAG, "invalid certificate");
+			return NULL;
+		}
+
+		fingerprint = freerdp_certificate_get_fingerprint_by_hash(cert, "sha256");
+		if (!fingerprint)
+			return NULL;
+	}
+
+	(void)winpr_asprintf(&config, &len, "%p;%d;%" PRIu16 ";%" PRIu16 ";%" PRIu32 ";%s;%d;%s",
+	                     method, options,
+	                     freerdp_settings_get_uint16(settings, FreeRDP_TLSMinVersion),
+	                     freerdp_settings_get_uint16(settings, FreeRDP_TLSMaxVersion),
+	                     settings->TlsSecLevel,
+	                     settings->AllowedTlsCiphers ? settings->AllowedTlsCiphers : "",
+	                     settings->TlsSecretsFile ? 1 : 0, fingerprint ? fingerprint : "");
+	free(fingerprint);
+	return config;
+}
+
+static int tls_session_cache_new_session_cb(SSL* ssl, SSL_SESSION* session)
+{
+	int rc = 0;
+
+	if (tls_idx == -1)
+		return 0;
+
+	const rdpTls* tls = SSL_get_ex_data(ssl, tls_idx);
+	if (!tls || !tls->cache || !tls->sessionKey)
+		return 0;
+
+	rdpTlsSessionCache* cache = tls->cache;
+	EnterCriticalSection(&cache->lock);
+	if (HashTable_Count(cache->sessions) >= TLS_SESSION_CACHE_MAX_HOSTS)
+		HashTable_Clear(cache->sessions);
+
+	/* the cache takes over the reference to the session */
+	if (HashTable_Insert(cache->sessions, tls->sessionKey, session))
+		rc = 1;
+	LeaveCriticalSection(&cache->lock);
+	return rc;
+}
+
+static BOOL tls_session_cache_setup(rdpTlsSessionCache* cache, SSL_CTX* ctx,
+                                    rdpSettings* settings)
+{
+	if (!cache->server)
+	{
+		/* sessions are kept per host, not in the OpenSSL internal cache */
+		SSL_CTX_set_session_cache_mode(ctx,
+		                               SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_sess_set_new_cb(ctx, tls_session_cache_new_session_cb);
+		return TRUE;
+	}
+
+	rdpCertificate* cert =
+	    freerdp_settings_get_pointer_writable(settings, FreeRDP_RdpServerCertificate);
+	if (!cert || (SSL_CTX_use_certificate(ctx, freerdp_certificate_get_x509(cert)) <= 0))
+	{
+		WLog_ERR(TAG, "SSL_CTX_use_certificate failed");
 		return FALSE;
 	}
 
-	if (settings->TlsSecretsFile)
+	const rdpPrivateKey* key = freerdp_settings_get_pointer(settings, FreeRDP_RdpServerRsaKey);
+	EVP_PKEY* privkey = key ? freerdp_key_get_evp_pkey(key) : NULL;
+	if (!privkey)
 	{
-#if OPENSSL_VERSION_NUMBER >= 0x10101000L
-		InitOnceExecuteOnce(&secrets_file_idx_once, secrets_file_init_cb, NULL, NULL);
+		WLog_ERR(TAG, "invalid private key");
+		return FALSE;
+	}
 
-		if (secrets_file_idx != -1)
+	const int status = SSL_CTX_use_PrivateKey(ctx, privkey);
+	EVP_PKEY_free(privkey);
+	if (status <= 0)
+	{
+		WLog_ERR(TAG, "SSL_CTX_use_PrivateKey failed");
+		return FALSE;
+	}
+
+	/* session IDs and tickets (the default) are both accepted, the ticket keys are per
+	 * SSL_CTX and thereby valid for all peers of the cache */
+	const unsigned char sid[] = "FreeRDP";
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+	return SSL_CTX_set_session_id_context(ctx, sid, sizeof(sid) - 1) == 1;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x010000000L
+static SSL_CTX* tls_session_cache_get_ctx(rdpTlsSessionCache* cache, rdpSettings* settings,
+                                          const SSL_METHOD* method, int options)
+#else
+static SSL_CTX* tls_session_cache_get_ctx(rdpTlsSessionCache* cache, rdpSettings* settings,
+                                          SSL_METHOD* method, int options)
+#endif
+{
+	SSL_CTX* ctx = NULL;
+	char* config = tls_session_cache_config(cache, settings, method, options);
+
+	if (!config)
+		return NULL;
+
+	EnterCriticalSection(&cache->lock);
+	if (!cache->ctx || (strcmp(cache->config, config) != 0))
+	{
+		SSL_CTX* created = tls_ctx_new(settings, method, options);
+
+		if (!created || !tls_session_cache_setup(cache, created, settings))
 		{
-			SSL_set_ex_data(tls->ssl, secrets_file_idx, settings->TlsSecretsFile);
-			SSL_CTX_set_keylog_callback(tls->ctx, SSLCTX_keylog_cb);
+			SSL_CTX_free(created);
+			goto out;
 		}
+
+		/* connections still using the old context keep their own reference */
+		SSL_CTX_free(cache->ctx);
+		free(cache->config);
+		cache->ctx = created;
+		cache->config = config;
+		config = NULL;
+
+		if (cache->sessions)
+			HashTable_Clear(cache->sessions);
+	}
+
+	if (SSL_CTX_up_ref(cache->ctx) == 1)
+		ctx = cache->ctx;
+out:
+	LeaveCriticalSection(&cache->lock);
+	free(config);
+	return ctx;
+}
+
+/* Offer the session of the last connection to the same host */
+static BOOL tls_session_cache_resume(rdpTls* tls)
+{
+	size_t len = 0;
+
+	WINPR_ASSERT(tls);
+	WINPR_ASSERT(tls->cache);
+
+	if (!InitOnceExecuteOnce(&tls_idx_once, tls_idx_init_cb, NULL, NULL) || (tls_idx == -1))
+		return FALSE;
+
+	free(tls->sessionKey);
+	tls->sessionKey = NULL;
+	if (winpr_asprintf(&tls->sessionKey, &len, "%s:%d", tls_get_server_name(tls), tls->port) < 0)
+		return FALSE;
+
+	if (SSL_set_ex_data(tls->ssl, tls_idx, tls) != 1)
+		return FALSE;
+
+	rdpTlsSessionCache* cache = tls->cache;
+	EnterCriticalSection(&cache->lock);
+	SSL_SESSION* session = HashTable_GetItemValue(cache->sessions, tls->sessionKey);
+	if (session)
+		(void)SSL_set_session(tls->ssl, session);
+	LeaveCriticalSection(&cache->lock);
+	return TRUE;
+}
+
+static void tls_session_cache_forget(rdpTls* tls)
+{
+	WINPR_ASSERT(tls);
+
+	if (!tls->cache || !tls->cache->sessions || !tls->sessionKey)
+		return;
+
+	EnterCriticalSection(&tls->cache->lock);
+	HashTable_Remove(tls->cache->sessions, tls->sessionKey);
+	LeaveCriticalSection(&tls->cache->lock);
+}
+
+rdpTlsSessionCache* freerdp_tls_session_cache_new(BOOL server)
+{
+	rdpTlsSessionCache* cache = calloc(1, sizeof(rdpTlsSessionCache));
+
+	if (!cache)
+		return NULL;
+
+	cache->server = server;
+	cache->refcount = 1;
+	if (!InitializeCriticalSectionAndSpinCount(&cache->lock, 4000))
+	{
+		free(cache);
+		return NULL;
+	}
+
+	if (!server)
+	{
+		cache->sessions = HashTable_New(FALSE);
+		if (!cache->sessions || !HashTable_SetupForStringData(cache->sessions, FALSE))
+			goto fail;
+
+		wObject* obj = HashTable_ValueObject(cache->sessions);
+		WINPR_ASSERT(obj);
+		obj->fnObjectFree = tls_session_free;
+	}
+
+	return cache;
+
+fail:
+	WINPR_PRAGMA_DIAG_PUSH
+	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
+	freerdp_tls_session_cache_free(cache);
+	WINPR_PRAGMA_DIAG_POP
+	return NULL;
+}
+
+rdpTlsSessionCache* freerdp_tls_session_cache_ref(rdpTlsSessionCache* cache)
+{
+	if (cache)
+		(void)InterlockedIncrement(&cache->refcount);
+	return cache;
+}
+
+void freerdp_tls_session_cache_free(rdpTlsSessionCache* cache)
+{
+	if (!cache)
+		return;
+
+	if (InterlockedDecrement(&cache->refcount) > 0)
+		return;
+
+	HashTable_Free(cache->sessions);
+	SSL_CTX_free(cache->ctx);
+	free(cache->config);
+	DeleteCriticalSection(&cache->lock);
+	free(cache);
+}
+
+void freerdp_tls_set_session_cache(rdpTls* tls, rdpTlsSessionCache* cache)
+{
+	WINPR_ASSERT(tls);
+
+	freerdp_tls_session_cache_ref(cache);
+	freerdp_tls_session_cache_free(tls->cache);
+	tls->cache = cache;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x010000000L
+static BOOL tls_prepare(rdpTls* tls, BIO* underlying, const SSL_METHOD* method, int options,
+                        BOOL clientMode)
 #else
-		WLog_WARN(TAG, "Key-Logging not available - requires OpenSSL 1.1.1 or higher");
+static BOOL tls_prepare(rdpTls* tls, BIO* underlying, SSL_METHOD* method, int options,
+                        BOOL clientMode)
 #endif
+{
+	WINPR_ASSERT(tls);
+
+	rdpSettings* settings = tls->context->settings;
+	WINPR_ASSERT(settings);
+
+	tls_reset(tls);
+	if (tls->cache && (tls->cache->server == !clientMode))
+		tls->ctx = tls_session_cache_get_ctx(tls->cache, settings, method, options);
+	else
+		tls->ctx = tls_ctx_new(settings, method, options);
+
+	tls->underlying = underlying;
+
+	if (!tls->ctx)
+		return FALSE;
+
+	tls->bio = BIO_new_rdp_tls(tls->ctx, clientMode);
+
+	if (BIO_get_ssl(tls->bio, &tls->ssl) < 0)
+	{
+		WLog_ERR(TAG, "unable to retrieve the SSL of the connection");
+		return FALSE;
 	}
 
+	if (settings->TlsSecretsFile && (secrets_file_idx != -1))
+		SSL_set_ex_data(tls->ssl, secrets_file_idx, settings->TlsSecretsFile);
+
 	BIO_push(tls->bio, underlying);
 	return TRUE;
 }
@@ -915,6 +1223,9 @@ TlsHandshakeResult freerdp_tls_connect_ex(rdpTls* tls, BIO* underlying, const SS
 	SSL_set_tlsext_host_name(tls->ssl, ptr);
 #endif
 
+	if (tls->cache && !tls->cache->server && !tls_session_cache_resume(tls))
+		return TLS_HANDSHAKE_ERROR;
+
 	return freerdp_tls_handshake(tls);
 }
 
@@ -938,6 +1249,7 @@ TlsHandshakeResult freerdp_tls_handshake(rdpTls* tls)
 			wLog* log = WLog_Get(TAG);
 			WLog_Print(log, WLOG_ERROR, "BIO_do_handshake failed");
 			ERR_print_errors_cb(bio_err_print, log);
+			tls_session_cache_forget(tls);
 			return TLS_HANDSHAKE_ERROR;
 		}
 
@@ -983,6 +1295,7 @@ TlsHandshakeResult freerdp_tls_handshake(rdpTls* tls)
 			if (verify_status < 1)
 			{
 				WLog_ERR(TAG, "certificate not trusted, aborting.");
+				tls_session_cache_forget(tls);
 				freerdp_tls_send_alert(tls);
 				ret = TLS_HANDSHAKE_VERIFY_ERROR;
 			}
@@ -1076,6 +1389,54 @@ static void tls_openssl_tlsext_debug_callback(SSL* s, int client_server, int typ
 }
 #endif
 
+static BOOL tls_use_certificate(rdpTls* tls, rdpSettings* settings)
+{
+	const rdpPrivateKey* key = freerdp_settings_get_pointer(settings, FreeRDP_RdpServerRsaKey);
+	if (!key)
+	{
+		WLog_ERR(TAG, "invalid private key");
+		return FALSE;
+	}
+
+	EVP_PKEY* privkey = freerdp_key_get_evp_pkey(key);
+	if (!privkey)
+	{
+		WLog_ERR(TAG, "invalid private key");
+		return FALSE;
+	}
+
+	int status = SSL_use_PrivateKey(tls->ssl, privkey);
+	/* The local reference to the private key will anyway go out of
+	 * scope; so the reference count should be decremented weither
+	 * SSL_use_PrivateKey succeeds or fails.
+	 */
+	EVP_PKEY_free(privkey);
+
+	if (status <= 0)
+	{
+		WLog_ERR(TAG, "SSL_CTX_use_PrivateKey_file failed");
+		return FALSE;
+	}
+
+	rdpCertificate* cert =
+	    freerdp_settings_get_pointer_writable(settings, FreeRDP_RdpServerCertificate);
+	if (!cert)
+	{
+		WLog_ERR(TAG, "invalid certificate");
+		return FALSE;
+	}
+
+	status = SSL_use_certificate(tls->ssl, freerdp_certificate_get_x509(cert));
+
+	if (status <= 0)
+	{
+		WLog_ERR(TAG, "SSL_use_certificate_file failed");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 BOOL freerdp_tls_accept(rdpTls* tls, BIO* underlying, rdpSettings* settings)
 {
 	WINPR_ASSERT(tls);
@@ -1102,7 +1463,6 @@ TlsHandshakeResult freerdp_tls_accept_ex(rdpTls* tls, BIO* underlying, rdpSettin
 	WINPR_ASSERT(tls);
 
 	int options = 0;
-	int status = 0;
 
 	/**
 	 * SSL_OP_NO_SSLv2:
@@ -1152,48 +1512,9 @@ TlsHandshakeResult freerdp_tls_accept_ex(rdpTls* tls, BIO* underlying, rdpSettin
 	if (!tls_prepare(tls, underlying, methods, options, FALSE))
 		return TLS_HANDSHAKE_ERROR;
 
-	const rdpPrivateKey* key = freerdp_settings_get_pointer(settings, FreeRDP_RdpServerRsaKey);
-	if (!key)
-	{
-		WLog_ERR(TAG, "invalid private key");
-		return TLS_HANDSHAKE_ERROR;
-	}
-
-	EVP_PKEY* privkey = freerdp_key_get_evp_pkey(key);
-	if (!privkey)
-	{
-		WLog_ERR(TAG, "invalid private key");
-		return TLS_HANDSHAKE_ERROR;
-	}
-
-	status = SSL_use_PrivateKey(tls->ssl, privkey);
-	/* The local reference to the private key will anyway go out of
-	 * scope; so the reference count should be decremented weither
-	 * SSL_use_PrivateKey succeeds or fails.
-	 */
-	EVP_PKEY_free(privkey);
-
-	if (status <= 0)
-	{
-		WLog_ERR(TAG, "SSL_CTX_use_PrivateKey_file failed");
+	/* a shared context already has the certificate and key */
+	if (!(tls->cache && tls->cache->server) && !tls_use_certificate(tls, settings))
 		return TLS_HANDSHAKE_ERROR;
-	}
-
-	rdpCertificate* cert =
-	    freerdp_settings_get_pointer_writable(settings, FreeRDP_RdpServerCertificate);
-	if (!cert)
-	{
-		WLog_ERR(TAG, "invalid certificate");
-		return TLS_HANDSHAKE_ERROR;
-	}
-
-	status = SSL_use_certificate(tls->ssl, freerdp_certificate_get_x509(cert));
-
-	if (status <= 0)
-	{
-		WLog_ERR(TAG, "SSL_use_certificate_file failed");
-		return TLS_HANDSHAKE_ERROR;
-	}
 
 #if defined(MICROSOFT_IOS_SNI_BUG) && !defined(OPENSSL_NO_TLSEXT) && \
     !defined(LIBRESSL_VERSION_NUMBER)
@@ -2095,6 +2416,8 @@ void freerdp_tls_free(rdpTls* tls)
 		return;
 
 	tls_reset(tls);
+	freerdp_tls_session_cache_free(tls->cache);
+	free(tls->sessionKey);
 
 	if (tls->certificate_store)
 	{
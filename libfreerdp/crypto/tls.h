@@ -29,6 +29,7 @@
 #include <freerdp/api.h>
 #include <freerdp/types.h>
 #include <freerdp/crypto/certificate_store.h>
+#include <freerdp/crypto/tls_cache.h>
 
 #include <winpr/stream.h>
 
@@ -82,6 +83,8 @@ struct rdp_tls
 	int alertDescription;
 	BOOL isGatewayTransport;
 	BOOL isClientMode;
+	rdpTlsSessionCache* cache;
+	char* sessionKey;
 };
 
 /** @brief result of a handshake operation */
@@ -119,6 +122,10 @@ extern "C"
 
 	FREERDP_LOCAL int freerdp_tls_set_alert_code(rdpTls* tls, int level, int description);
 
+	FREERDP_LOCAL void freerdp_tls_set_session_cache(rdpTls* tls, rdpTlsSessionCache* cache);
+
+	FREERDP_LOCAL rdpTlsSessionCache* freerdp_tls_session_cache_ref(rdpTlsSessionCache* cache);
+
 	FREERDP_LOCAL void freerdp_tls_free(rdpTls* tls);
 
 	WINPR_ATTR_MALLOC(freerdp_tls_free, 1)
@@ -37,6 +37,7 @@
 
 #include "brush.h"
 #include "clipping.h"
+#include "rop3.h"
 #include "../gdi/gdi.h"
 
 #define TAG FREERDP_TAG("gdi.bitmap")
@@ -283,73 +284,113 @@ static UINT32 process_rop(UINT32 src, UINT32 dst, UINT32 pat, const char* rop, U
 	return stack[0];
 }
 
-static INLINE BOOL BitBlt_write(HGDI_DC hdcDest, HGDI_DC hdcSrc, INT32 nXDest, INT32 nYDest,
-                                INT32 nXSrc, INT32 nYSrc, INT32 x, INT32 y, BOOL useSrc,
-                                BOOL usePat, UINT32 style, const char* rop,
-                                const gdiPalette* palette)
+/* Repeats the first filled bytes of a scanline until size bytes are set */
+static void BitBlt_repeat_row(BYTE* row, size_t filled, size_t size)
 {
-	UINT32 dstColor = 0;
-	UINT32 colorA = 0;
-	UINT32 colorB = 0;
-	UINT32 colorC = 0;
-	const INT32 dstX = nXDest + x;
-	const INT32 dstY = nYDest + y;
-	BYTE* dstp = gdi_get_bitmap_pointer(hdcDest, dstX, dstY);
-
-	if (!dstp)
+	WINPR_ASSERT(row);
+	WINPR_ASSERT(filled > 0);
+
+	while (filled < size)
 	{
-		WLog_ERR(TAG, "dstp=%p", (const void*)dstp);
-		return FALSE;
+		const size_t chunk = MIN(filled, size - filled);
+		memcpy(&row[filled], row, chunk);
+		filled += chunk;
 	}
+}
 
-	colorA = FreeRDPReadColor(dstp, hdcDest->format);
+static BOOL BitBlt_fill_row(BYTE* row, UINT32 format, UINT32 color, size_t size)
+{
+	if (!FreeRDPWriteColor(row, format, color))
+		return FALSE;
 
-	if (useSrc)
+	BitBlt_repeat_row(row, FreeRDPGetBytesPerPixel(format), size);
+	return TRUE;
+}
+
+/* Converts a scanline of the brush selected into hdcDest, the brush tiles the destination */
+static BOOL BitBlt_pattern_row(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nWidth,
+                               BYTE* row)
+{
+	WINPR_ASSERT(hdcDest);
+	WINPR_ASSERT(hdcDest->brush);
+	WINPR_ASSERT(hdcDest->brush->pattern);
+
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(hdcDest->format);
+	const INT32 period = MIN(nWidth, hdcDest->brush->pattern->width);
+
+	if (period <= 0)
+		return FALSE;
+
+	for (INT32 x = 0; x < period; x++)
 	{
-		const BYTE* srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc + x, nYSrc + y);
+		const BYTE* patp =
+		    gdi_get_brush_pointer(hdcDest, WINPR_ASSERTING_INT_CAST(uint32_t, nXDest + x),
+		                          WINPR_ASSERTING_INT_CAST(uint32_t, nYDest));
 
-		if (!srcp)
+		if (!patp)
 		{
-			WLog_ERR(TAG, "srcp=%p", (const void*)srcp);
+			WLog_ERR(TAG, "patp=%p", (const void*)patp);
 			return FALSE;
 		}
 
-		colorC = FreeRDPReadColor(srcp, hdcSrc->format);
-		colorC = FreeRDPConvertColor(colorC, hdcSrc->format, hdcDest->format, palette);
+		const UINT32 color = FreeRDPReadColor(patp, hdcDest->format);
+		if (!FreeRDPWriteColor(&row[1ull * bpp * WINPR_ASSERTING_INT_CAST(size_t, x)],
+		                       hdcDest->format, color))
+			return FALSE;
 	}
 
-	if (usePat)
+	BitBlt_repeat_row(row, 1ull * bpp * WINPR_ASSERTING_INT_CAST(size_t, period),
+	                  1ull * bpp * WINPR_ASSERTING_INT_CAST(size_t, nWidth));
+	return TRUE;
+}
+
+/* Reads a scanline of the source in the destination format */
+static BOOL BitBlt_source_row(HGDI_DC hdcDest, HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc,
+                              INT32 nWidth, BYTE* row, const gdiPalette* palette)
+{
+	WINPR_ASSERT(hdcDest);
+	WINPR_ASSERT(hdcSrc);
+
+	const BYTE* srcp = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc);
+
+	if (!srcp)
 	{
-		switch (style)
-		{
-			case GDI_BS_SOLID:
-				colorB = hdcDest->brush->color;
-				break;
+		WLog_ERR(TAG, "srcp=%p", (const void*)srcp);
+		return FALSE;
+	}
 
-			case GDI_BS_HATCHED:
-			case GDI_BS_PATTERN:
-			{
-				const BYTE* patp =
-				    gdi_get_brush_pointer(hdcDest, WINPR_ASSERTING_INT_CAST(uint32_t, nXDest + x),
-				                          WINPR_ASSERTING_INT_CAST(uint32_t, nYDest + y));
+	const size_t size = FreeRDPGetBytesPerPixel(hdcDest->format) * (size_t)nWidth;
 
-				if (!patp)
-				{
-					WLog_ERR(TAG, "patp=%p", (const void*)patp);
-					return FALSE;
-				}
+	if (hdcSrc->format == hdcDest->format)
+	{
+		memcpy(row, srcp, size);
+		return TRUE;
+	}
 
-				colorB = FreeRDPReadColor(patp, hdcDest->format);
-			}
-			break;
+	const UINT32 srcBpp = FreeRDPGetBytesPerPixel(hdcSrc->format);
+	const UINT32 dstBpp = FreeRDPGetBytesPerPixel(hdcDest->format);
 
-			default:
-				break;
-		}
+	for (INT32 x = 0; x < nWidth; x++)
+	{
+		const UINT32 color = FreeRDPReadColor(&srcp[1ull * srcBpp * (size_t)x], hdcSrc->format);
+		const UINT32 converted =
+		    FreeRDPConvertColor(color, hdcSrc->format, hdcDest->format, palette);
+
+		if (!FreeRDPWriteColor(&row[1ull * dstBpp * (size_t)x], hdcDest->format, converted))
+			return FALSE;
 	}
 
-	dstColor = process_rop(colorC, colorA, colorB, rop, hdcDest->format);
-	return FreeRDPWriteColor(dstp, hdcDest->format, dstColor);
+	return TRUE;
+}
+
+/* Formats without alpha ignore the top bit of 15bpp pixels, keep it cleared */
+static void BitBlt_mask_row(BYTE* row, UINT32 format, size_t width)
+{
+	if ((FreeRDPGetBitsPerPixel(format) != 15) || FreeRDPColorHasAlpha(format))
+		return;
+
+	for (size_t x = 0; x < width; x++)
+		row[2 * x + 1] &= 0x7F;
 }
 
 static BOOL adjust_src_coordinates(HGDI_DC hdcSrc, INT32 nWidth, INT32 nHeight, INT32* px,
@@ -467,15 +508,26 @@ static BOOL BitBlt_process(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nW
                            HGDI_DC hdcSrc, INT32 nXSrc, INT32 nYSrc, const char* rop,
                            const gdiPalette* palette)
 {
+	BOOL rc = FALSE;
 	UINT32 style = 0;
+	BOOL useDst = FALSE;
 	BOOL useSrc = FALSE;
 	BOOL usePat = FALSE;
+	BYTE* srcRow = NULL;
+	BYTE* patRow = NULL;
 	const char* iter = rop;
 
+	if (!hdcDest)
+		return FALSE;
+
 	while (*iter != '\0')
 	{
 		switch (*iter++)
 		{
+			case 'D':
+				useDst = TRUE;
+				break;
+
 			case 'P':
 				usePat = TRUE;
 				break;
@@ -489,8 +541,12 @@ static BOOL BitBlt_process(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nW
 		}
 	}
 
-	if (!hdcDest)
-		return FALSE;
+	/* Evaluated on the operand bytes 0xF0 (P), 0xCC (S) and 0xAA (D) the ROP is its own code.
+	 * Operations without operands fill with a constant color, that is a PATCOPY of it. */
+	const BOOL constant = !useDst && !useSrc && !usePat;
+	const BYTE code =
+	    constant ? 0xF0 : (BYTE)process_rop(0xCC, 0xAA, 0xF0, rop, hdcDest->format);
+	const pGdiRop3Row kernel = gdi_get_rop3_row(code);
 
 	if (!adjust_src_dst_coordinates(hdcDest, &nXSrc, &nYSrc, &nXDest, &nYDest, &nWidth, &nHeight))
 		return FALSE;
@@ -521,56 +577,89 @@ static BOOL BitBlt_process(HGDI_DC hdcDest, INT32 nXDest, INT32 nYDest, INT32 nW
 		}
 	}
 
-	if ((nXDest > nXSrc) && (nYDest > nYSrc))
+	if ((nWidth == 0) || (nHeight == 0))
+		return TRUE;
+
+	const size_t width = WINPR_ASSERTING_INT_CAST(size_t, nWidth);
+	const size_t size = width * FreeRDPGetBytesPerPixel(hdcDest->format);
+
+	/* A source in the destination format is used in place, unless it might overlap */
+	const BOOL bufferSrc =
+	    useSrc && ((hdcSrc->format != hdcDest->format) ||
+	               (hdcSrc->selectedObject == hdcDest->selectedObject));
+
+	if (bufferSrc)
 	{
-		for (INT32 y = nHeight - 1; y >= 0; y--)
-		{
-			for (INT32 x = nWidth - 1; x >= 0; x--)
-			{
-				if (!BitBlt_write(hdcDest, hdcSrc, nXDest, nYDest, nXSrc, nYSrc, x, y, useSrc,
-				                  usePat, style, rop, palette))
-					return FALSE;
-			}
-		}
+		srcRow = winpr_aligned_malloc(size, 16);
+		if (!srcRow)
+			goto fail;
 	}
-	else if (nXDest > nXSrc)
+
+	if (usePat || constant)
 	{
-		for (INT32 y = 0; y < nHeight; y++)
+		patRow = winpr_aligned_malloc(size, 16);
+		if (!patRow)
+			goto fail;
+
+		if (constant)
 		{
-			for (INT32 x = nWidth - 1; x >= 0; x--)
-			{
-				if (!BitBlt_write(hdcDest, hdcSrc, nXDest, nYDest, nXSrc, nYSrc, x, y, useSrc,
-				                  usePat, style, rop, palette))
-					return FALSE;
-			}
+			const UINT32 color = process_rop(0, 0, 0, rop, hdcDest->format);
+			if (!BitBlt_fill_row(patRow, hdcDest->format, color, size))
+				goto fail;
 		}
-	}
-	else if (nYDest > nYSrc)
-	{
-		for (INT32 y = nHeight - 1; y >= 0; y--)
+		else if (style == GDI_BS_SOLID)
 		{
-			for (INT32 x = 0; x < nWidth; x++)
-			{
-				if (!BitBlt_write(hdcDest, hdcSrc, nXDest, nYDest, nXSrc, nYSrc, x, y, useSrc,
-				                  usePat, style, rop, palette))
-					return FALSE;
-			}
+			if (!BitBlt_fill_row(patRow, hdcDest->format, hdcDest->brush->color, size))
+				goto fail;
 		}
 	}
-	else
+
+	/* Rows are processed in an order that reads overlapping source rows before they change */
+	for (INT32 i = 0; i < nHeight; i++)
 	{
-		for (INT32 y = 0; y < nHeight; y++)
+		const INT32 y = (nYDest > nYSrc) ? nHeight - 1 - i : i;
+		const BYTE* pSrc = NULL;
+		BYTE* pDst = gdi_get_bitmap_pointer(hdcDest, nXDest, nYDest + y);
+
+		if (!pDst)
 		{
-			for (INT32 x = 0; x < nWidth; x++)
+			WLog_ERR(TAG, "dstp=%p", (const void*)pDst);
+			goto fail;
+		}
+
+		if (bufferSrc)
+		{
+			if (!BitBlt_source_row(hdcDest, hdcSrc, nXSrc, nYSrc + y, nWidth, srcRow, palette))
+				goto fail;
+
+			pSrc = srcRow;
+		}
+		else if (useSrc)
+		{
+			pSrc = gdi_get_bitmap_pointer(hdcSrc, nXSrc, nYSrc + y);
+
+			if (!pSrc)
 			{
-				if (!BitBlt_write(hdcDest, hdcSrc, nXDest, nYDest, nXSrc, nYSrc, x, y, useSrc,
-				                  usePat, style, rop, palette))
-					return FALSE;
+				WLog_ERR(TAG, "srcp=%p", (const void*)pSrc);
+				goto fail;
 			}
 		}
+
+		if (usePat && (style != GDI_BS_SOLID))
+		{
+			if (!BitBlt_pattern_row(hdcDest, nXDest, nYDest + y, nWidth, patRow))
+				goto fail;
+		}
+
+		kernel(pDst, pSrc, patRow, size);
+		BitBlt_mask_row(pDst, hdcDest->format, width);
 	}
 
-	return TRUE;
+	rc = TRUE;
+fail:
+	winpr_aligned_free(srcRow);
+	winpr_aligned_free(patRow);
+	return rc;
 }
 
 /**
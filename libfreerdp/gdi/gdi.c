@@ -44,6 +44,7 @@
 #include "brush.h"
 #include "line.h"
 #include "gdi.h"
+#include "glyph_atlas.h"
 #include "../core/graphics.h"
 #include "../core/update.h"
 #include "../cache/cache.h"
@@ -1081,6 +1082,7 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 	if (!intersect_rect(gdi, cmd, &cmdRect))
 		goto out;
 
+	const UINT64 begin = metrics_stage_begin(context->metrics);
 	switch (cmd->bmp.codecID)
 	{
 		case RDP_CODEC_ID_REMOTEFX:
@@ -1094,6 +1096,7 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 				goto out;
 			}
 
+			metrics_stage_end(context->metrics, FREERDP_METRICS_DECODE_REMOTEFX, begin);
 			break;
 
 		case RDP_CODEC_ID_NSCODEC:
@@ -1109,6 +1112,7 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 				goto out;
 			}
 
+			metrics_stage_end(context->metrics, FREERDP_METRICS_DECODE_NSCODEC, begin);
 			region16_union_rect(&region, &region, &cmdRect);
 			break;
 
@@ -1131,6 +1135,7 @@ static BOOL gdi_surface_bits(rdpContext* context, const SURFACE_BITS_COMMAND* cm
 				goto out;
 			}
 
+			metrics_stage_end(context->metrics, FREERDP_METRICS_DECODE_UNCOMPRESSED, begin);
 			region16_union_rect(&region, &region, &cmdRect);
 			break;
 
@@ -1400,6 +1405,9 @@ BOOL gdi_init_ex(freerdp* instance, UINT32 format, UINT32 stride, BYTE* buffer,
 	if (!gdi_init_primary(gdi, stride, gdi->dstFormat, buffer, pfree, FALSE))
 		goto fail;
 
+	if (!(gdi->glyphAtlas = gdi_glyph_atlas_new()))
+		goto fail;
+
 	if (!(context->cache = cache_new(context)))
 		goto fail;
 
@@ -1434,6 +1442,8 @@ void gdi_free(freerdp* instance)
 	{
 		gdi_bitmap_free_ex(gdi->primary);
 		gdi_DeleteDC(gdi->hdc);
+		/* cached glyphs still hold the atlas until the cache is freed below */
+		gdi_glyph_atlas_free(gdi->glyphAtlas);
 		free(gdi);
 	}
 
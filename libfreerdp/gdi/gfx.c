@@ -33,6 +33,8 @@
 #include <freerdp/utils/gfx.h>
 #include <math.h>
 
+#include "gfx_cache.h"
+
 #define TAG FREERDP_TAG("gdi")
 
 static BOOL is_rect_valid(const RECTANGLE_16* rect, size_t width, size_t height)
@@ -274,7 +276,11 @@ static UINT gdi_UpdateSurfaces(RdpgfxClientContext* context)
 		}
 
 		if (surface->outputMapped)
+		{
+			const UINT64 begin = metrics_stage_begin(gdi->context->metrics);
 			status = gdi_OutputUpdate(gdi, surface);
+			metrics_stage_end(gdi->context->metrics, FREERDP_METRICS_GDI_OUTPUT, begin);
+		}
 		else if (surface->windowMapped)
 			status = gdi_WindowUpdate(context, surface);
 
@@ -1051,38 +1057,48 @@ static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFAC
 	dump_cmd(cmd, gdi->frameId);
 #endif
 
+	FreeRDP_MetricsStage stage = FREERDP_METRICS_STAGE_COUNT;
+	const UINT64 begin = metrics_stage_begin(gdi->context->metrics);
 	switch (codecId)
 	{
 		case RDPGFX_CODECID_UNCOMPRESSED:
+			stage = FREERDP_METRICS_DECODE_UNCOMPRESSED;
 			status = gdi_SurfaceCommand_Uncompressed(gdi, context, cmd);
 			break;
 
 		case RDPGFX_CODECID_CAVIDEO:
+			stage = FREERDP_METRICS_DECODE_REMOTEFX;
 			status = gdi_SurfaceCommand_RemoteFX(gdi, context, cmd);
 			break;
 
 		case RDPGFX_CODECID_CLEARCODEC:
+			stage = FREERDP_METRICS_DECODE_CLEARCODEC;
 			status = gdi_SurfaceCommand_ClearCodec(gdi, context, cmd);
 			break;
 
 		case RDPGFX_CODECID_PLANAR:
+			stage = FREERDP_METRICS_DECODE_PLANAR;
 			status = gdi_SurfaceCommand_Planar(gdi, context, cmd);
 			break;
 
 		case RDPGFX_CODECID_AVC420:
+			stage = FREERDP_METRICS_DECODE_AVC;
 			status = gdi_SurfaceCommand_AVC420(gdi, context, cmd);
 			break;
 
 		case RDPGFX_CODECID_AVC444v2:
 		case RDPGFX_CODECID_AVC444:
+			stage = FREERDP_METRICS_DECODE_AVC;
 			status = gdi_SurfaceCommand_AVC444(gdi, context, cmd);
 			break;
 
 		case RDPGFX_CODECID_ALPHA:
+			stage = FREERDP_METRICS_DECODE_UNCOMPRESSED;
 			status = gdi_SurfaceCommand_Alpha(gdi, context, cmd);
 			break;
 
 		case RDPGFX_CODECID_CAPROGRESSIVE:
+			stage = FREERDP_METRICS_DECODE_PROGRESSIVE;
 			status = gdi_SurfaceCommand_Progressive(gdi, context, cmd);
 			break;
 
@@ -1097,6 +1113,9 @@ static UINT gdi_SurfaceCommand(RdpgfxClientContext* context, const RDPGFX_SURFAC
 			break;
 	}
 
+	if ((status == CHANNEL_RC_OK) && (stage != FREERDP_METRICS_STAGE_COUNT))
+		metrics_stage_end(gdi->context->metrics, stage, begin);
+
 	LeaveCriticalSection(&context->mux);
 	return status;
 }
@@ -1399,40 +1418,6 @@ fail:
 	return status;
 }
 
-static void gdi_GfxCacheEntryFree(gdiGfxCacheEntry* entry)
-{
-	if (!entry)
-		return;
-	free(entry->data);
-	free(entry);
-}
-
-static gdiGfxCacheEntry* gdi_GfxCacheEntryNew(UINT64 cacheKey, UINT32 width, UINT32 height,
-                                              UINT32 format)
-{
-	gdiGfxCacheEntry* cacheEntry = (gdiGfxCacheEntry*)calloc(1, sizeof(gdiGfxCacheEntry));
-	if (!cacheEntry)
-		goto fail;
-
-	cacheEntry->cacheKey = cacheKey;
-	cacheEntry->width = width;
-	cacheEntry->height = height;
-	cacheEntry->format = format;
-	cacheEntry->scanline = gfx_align_scanline(cacheEntry->width * 4, 16);
-
-	if ((cacheEntry->width > 0) && (cacheEntry->height > 0))
-	{
-		cacheEntry->data = (BYTE*)calloc(cacheEntry->height, cacheEntry->scanline);
-
-		if (!cacheEntry->data)
-			goto fail;
-	}
-	return cacheEntry;
-fail:
-	gdi_GfxCacheEntryFree(cacheEntry);
-	return NULL;
-}
-
 /**
  * Function description
  *
@@ -1445,6 +1430,7 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 	gdiGfxSurface* surface = NULL;
 	gdiGfxCacheEntry* cacheEntry = NULL;
 	UINT rc = ERROR_INTERNAL_ERROR;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
 	EnterCriticalSection(&context->mux);
 	rect = &(surfaceToCache->rectSrc);
 
@@ -1457,20 +1443,36 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 	if (!is_rect_valid(rect, surface->width, surface->height))
 		goto fail;
 
-	cacheEntry = gdi_GfxCacheEntryNew(surfaceToCache->cacheKey, (UINT32)(rect->right - rect->left),
-	                                  (UINT32)(rect->bottom - rect->top), surface->format);
+	{
+		const UINT32 width = (UINT32)(rect->right - rect->left);
+		const UINT32 height = (UINT32)(rect->bottom - rect->top);
+		const size_t bpp = FreeRDPGetBytesPerPixel(surface->format);
+		const BYTE* src =
+		    &surface->data[1ull * rect->top * surface->scanline + 1ull * rect->left * bpp];
+
+		/* Unchanged content cached again (or imported from the persistent cache) is shared */
+		cacheEntry = gdi_gfx_cache_entry_share(gdi->gfxCachePool, surfaceToCache->cacheKey, width,
+		                                       height, surface->format, src, surface->scanline);
+		if (!cacheEntry)
+		{
+			cacheEntry = gdi_gfx_cache_entry_new(gdi->gfxCachePool, surfaceToCache->cacheKey,
+			                                     width, height, surface->format);
 
-	if (!cacheEntry)
-		goto fail;
+			if (!cacheEntry)
+				goto fail;
 
-	if (!cacheEntry->data)
-		goto fail;
+			if (!cacheEntry->data)
+				goto fail;
 
-	if (!freerdp_image_copy_no_overlap(cacheEntry->data, cacheEntry->format, cacheEntry->scanline,
-	                                   0, 0, cacheEntry->width, cacheEntry->height, surface->data,
-	                                   surface->format, surface->scanline, rect->left, rect->top,
-	                                   NULL, FREERDP_FLIP_NONE))
-		goto fail;
+			if (!freerdp_image_copy_no_overlap(
+			        cacheEntry->data, cacheEntry->format, cacheEntry->scanline, 0, 0,
+			        cacheEntry->width, cacheEntry->height, surface->data, surface->format,
+			        surface->scanline, rect->left, rect->top, NULL, FREERDP_FLIP_NONE))
+				goto fail;
+
+			(void)gdi_gfx_cache_entry_publish(cacheEntry);
+		}
+	}
 
 	RDPGFX_EVICT_CACHE_ENTRY_PDU evict = { surfaceToCache->cacheSlot };
 	WINPR_ASSERT(context->EvictCacheEntry);
@@ -1480,7 +1482,7 @@ static UINT gdi_SurfaceToCache(RdpgfxClientContext* context,
 	rc = context->SetCacheSlotData(context, surfaceToCache->cacheSlot, (void*)cacheEntry);
 fail:
 	if (rc != CHANNEL_RC_OK)
-		gdi_GfxCacheEntryFree(cacheEntry);
+		gdi_gfx_cache_entry_free(cacheEntry);
 	LeaveCriticalSection(&context->mux);
 	return rc;
 }
@@ -1558,6 +1560,7 @@ static UINT gdi_CacheImportReply(RdpgfxClientContext* context,
 	UINT16 count = 0;
 	const UINT16* slots = NULL;
 	UINT error = CHANNEL_RC_OK;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
 
 	slots = cacheImportReply->cacheSlots;
 	count = cacheImportReply->importedEntriesCount;
@@ -1576,7 +1579,8 @@ static UINT gdi_CacheImportReply(RdpgfxClientContext* context,
 		if (cacheEntry)
 			continue;
 
-		cacheEntry = gdi_GfxCacheEntryNew(cacheSlot, 0, 0, PIXEL_FORMAT_BGRX32);
+		cacheEntry = gdi_gfx_cache_entry_new(gdi->gfxCachePool, cacheSlot, 0, 0,
+		                                     PIXEL_FORMAT_BGRX32);
 
 		if (!cacheEntry)
 			return ERROR_INTERNAL_ERROR;
@@ -1588,7 +1592,7 @@ static UINT gdi_CacheImportReply(RdpgfxClientContext* context,
 		{
 			WLog_ERR(TAG, "CacheImportReply: SetCacheSlotData failed with error %" PRIu32 "",
 			         error);
-			gdi_GfxCacheEntryFree(cacheEntry);
+			gdi_gfx_cache_entry_free(cacheEntry);
 			break;
 		}
 	}
@@ -1601,21 +1605,33 @@ static UINT gdi_ImportCacheEntry(RdpgfxClientContext* context, UINT16 cacheSlot,
 {
 	UINT error = ERROR_INTERNAL_ERROR;
 	gdiGfxCacheEntry* cacheEntry = NULL;
+	rdpGdi* gdi = (rdpGdi*)context->custom;
 
 	if (cacheSlot == 0)
 		return CHANNEL_RC_OK;
 
-	cacheEntry = gdi_GfxCacheEntryNew(importCacheEntry->key64, importCacheEntry->width,
-	                                  importCacheEntry->height, PIXEL_FORMAT_BGRX32);
-
+	/* Entries with equal keys and content share their pixels */
+	cacheEntry = gdi_gfx_cache_entry_share(gdi->gfxCachePool, importCacheEntry->key64,
+	                                       importCacheEntry->width, importCacheEntry->height,
+	                                       PIXEL_FORMAT_BGRX32, importCacheEntry->data,
+	                                       importCacheEntry->width * 4u);
 	if (!cacheEntry)
-		goto fail;
+	{
+		cacheEntry = gdi_gfx_cache_entry_new(gdi->gfxCachePool, importCacheEntry->key64,
+		                                     importCacheEntry->width, importCacheEntry->height,
+		                                     PIXEL_FORMAT_BGRX32);
 
-	if (!freerdp_image_copy_no_overlap(cacheEntry->data, cacheEntry->format, cacheEntry->scanline,
-	                                   0, 0, cacheEntry->width, cacheEntry->height,
-	                                   importCacheEntry->data, PIXEL_FORMAT_BGRX32, 0, 0, 0, NULL,
-	                                   FREERDP_FLIP_NONE))
-		goto fail;
+		if (!cacheEntry)
+			goto fail;
+
+		if (!freerdp_image_copy_no_overlap(cacheEntry->data, cacheEntry->format,
+		                                   cacheEntry->scanline, 0, 0, cacheEntry->width,
+		                                   cacheEntry->height, importCacheEntry->data,
+		                                   PIXEL_FORMAT_BGRX32, 0, 0, 0, NULL, FREERDP_FLIP_NONE))
+			goto fail;
+
+		(void)gdi_gfx_cache_entry_publish(cacheEntry);
+	}
 
 	RDPGFX_EVICT_CACHE_ENTRY_PDU evict = { cacheSlot };
 	WINPR_ASSERT(context->EvictCacheEntry);
@@ -1629,7 +1645,7 @@ static UINT gdi_ImportCacheEntry(RdpgfxClientContext* context, UINT16 cacheSlot,
 fail:
 	if (error)
 	{
-		gdi_GfxCacheEntryFree(cacheEntry);
+		gdi_gfx_cache_entry_free(cacheEntry);
 		WLog_ERR(TAG, "ImportCacheEntry: SetCacheSlotData failed with error %" PRIu32 "", error);
 	}
 
@@ -1677,7 +1693,7 @@ static UINT gdi_EvictCacheEntry(RdpgfxClientContext* context,
 	WINPR_ASSERT(context->GetCacheSlotData);
 	cacheEntry = (gdiGfxCacheEntry*)context->GetCacheSlotData(context, evictCacheEntry->cacheSlot);
 
-	gdi_GfxCacheEntryFree(cacheEntry);
+	gdi_gfx_cache_entry_free(cacheEntry);
 
 	WINPR_ASSERT(context->SetCacheSlotData);
 	rc = context->SetCacheSlotData(context, evictCacheEntry->cacheSlot, NULL);
@@ -1859,6 +1875,11 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 	rdpContext* context = gdi->context;
 	rdpSettings* settings = context->settings;
 
+	gdi_gfx_cache_pool_free(gdi->gfxCachePool);
+	gdi->gfxCachePool = gdi_gfx_cache_pool_new();
+	if (!gdi->gfxCachePool)
+		return FALSE;
+
 	gdi->gfx = gfx;
 	gfx->custom = (void*)gdi;
 	gfx->ResetGraphics = gdi_ResetGraphics;
@@ -1920,7 +1941,12 @@ BOOL gdi_graphics_pipeline_init_ex(rdpGdi* gdi, RdpgfxClientContext* gfx,
 void gdi_graphics_pipeline_uninit(rdpGdi* gdi, RdpgfxClientContext* gfx)
 {
 	if (gdi)
+	{
+		/* cache entries still in the slots keep their buffers until they are evicted */
+		gdi_gfx_cache_pool_free(gdi->gfxCachePool);
+		gdi->gfxCachePool = NULL;
 		gdi->gfx = NULL;
+	}
 
 	if (!gfx)
 		return;
@@ -0,0 +1,421 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Graphics Pipeline Cache Entries
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/synch.h>
+#include <winpr/collections.h>
+
+#include <freerdp/codec/color.h>
+
+#include "gfx_cache.h"
+
+/* Size classes are powers of two from 4KiB (a 32x32 tile) to 4MiB, larger ones are not pooled */
+#define GFX_CACHE_MIN_CLASS_SHIFT 12
+#define GFX_CACHE_CLASSES 11
+#define GFX_CACHE_NO_CLASS GFX_CACHE_CLASSES
+
+/* Upper limit of memory kept in the free lists */
+#define GFX_CACHE_MAX_CACHED (32ull * 1024ull * 1024ull)
+
+#define GFX_CACHE_DATA_ALIGNMENT 16
+
+typedef struct gdi_gfx_cache_buffer gdiGfxCacheBuffer;
+
+struct gdi_gfx_cache_buffer
+{
+	gdiGfxCachePool* pool;
+	gdiGfxCacheBuffer* next; /* free list */
+	size_t refs;
+	size_t cls;
+	size_t size;
+	UINT64 key;
+	BOOL published;
+	UINT32 width;
+	UINT32 height;
+	UINT32 format;
+	UINT32 scanline;
+	BYTE* data;
+};
+
+struct gdi_gfx_cache_pool
+{
+	CRITICAL_SECTION lock;
+	size_t refs; /* the owner and every live buffer */
+	BOOL closed;
+	gdiGfxCacheBuffer* free[GFX_CACHE_CLASSES];
+	wHashTable* published;
+	gdiGfxCachePoolStats stats;
+};
+
+typedef struct
+{
+	gdiGfxCacheEntry common;
+	gdiGfxCacheBuffer* buffer;
+} gdiGfxCacheEntryInternal;
+
+static INLINE gdiGfxCacheEntryInternal* cache_entry_cast(gdiGfxCacheEntry* entry)
+{
+	union
+	{
+		gdiGfxCacheEntry* pub;
+		gdiGfxCacheEntryInternal* internal;
+	} cnv;
+
+	cnv.pub = entry;
+	return cnv.internal;
+}
+
+static UINT32 gfx_cache_key_hash(const void* key)
+{
+	const UINT64* v = (const UINT64*)key;
+	return (UINT32)(*v ^ (*v >> 32));
+}
+
+static BOOL gfx_cache_key_equals(const void* a, const void* b)
+{
+	const UINT64* ka = (const UINT64*)a;
+	const UINT64* kb = (const UINT64*)b;
+	return *ka == *kb;
+}
+
+/* Cache entries are always 32bpp, rows are 16 byte aligned */
+static UINT32 gfx_cache_scanline(UINT32 width)
+{
+	return ((width * 4u) + 15u) & ~15u;
+}
+
+static size_t gfx_cache_class(size_t size)
+{
+	for (size_t cls = 0; cls < GFX_CACHE_CLASSES; cls++)
+	{
+		if (size <= (1ull << (cls + GFX_CACHE_MIN_CLASS_SHIFT)))
+			return cls;
+	}
+
+	return GFX_CACHE_NO_CLASS;
+}
+
+static void gfx_cache_pool_release(gdiGfxCachePool* pool)
+{
+	size_t refs = 0;
+
+	WINPR_ASSERT(pool);
+
+	EnterCriticalSection(&pool->lock);
+	refs = --pool->refs;
+	LeaveCriticalSection(&pool->lock);
+
+	if (refs > 0)
+		return;
+
+	/* The free lists were drained when the owner released the pool */
+	HashTable_Free(pool->published);
+	DeleteCriticalSection(&pool->lock);
+	free(pool);
+}
+
+static gdiGfxCacheBuffer* gfx_cache_buffer_new(gdiGfxCachePool* pool, size_t size)
+{
+	const size_t header = (sizeof(gdiGfxCacheBuffer) + GFX_CACHE_DATA_ALIGNMENT - 1) &
+	                      ~(size_t)(GFX_CACHE_DATA_ALIGNMENT - 1);
+	const size_t cls = gfx_cache_class(size);
+	gdiGfxCacheBuffer* buffer = NULL;
+
+	WINPR_ASSERT(pool);
+
+	EnterCriticalSection(&pool->lock);
+	if (cls != GFX_CACHE_NO_CLASS)
+	{
+		buffer = pool->free[cls];
+		if (buffer)
+		{
+			pool->free[cls] = buffer->next;
+			pool->stats.cached -= buffer->size;
+			pool->stats.recycled++;
+		}
+	}
+
+	if (!buffer)
+	{
+		const size_t capacity =
+		    (cls != GFX_CACHE_NO_CLASS) ? (1ull << (cls + GFX_CACHE_MIN_CLASS_SHIFT)) : size;
+		buffer = winpr_aligned_malloc(header + capacity, GFX_CACHE_DATA_ALIGNMENT);
+		if (buffer)
+		{
+			buffer->size = capacity;
+			buffer->data = &((BYTE*)buffer)[header];
+			pool->stats.allocations++;
+		}
+	}
+
+	if (buffer)
+		pool->refs++;
+	LeaveCriticalSection(&pool->lock);
+
+	if (!buffer)
+		return NULL;
+
+	buffer->pool = pool;
+	buffer->next = NULL;
+	buffer->refs = 1;
+	buffer->cls = cls;
+	buffer->key = 0;
+	buffer->published = FALSE;
+	return buffer;
+}
+
+static void gfx_cache_buffer_release(gdiGfxCacheBuffer* buffer)
+{
+	if (!buffer)
+		return;
+
+	gdiGfxCachePool* pool = buffer->pool;
+	WINPR_ASSERT(pool);
+
+	EnterCriticalSection(&pool->lock);
+	WINPR_ASSERT(buffer->refs > 0);
+	if (--buffer->refs > 0)
+	{
+		LeaveCriticalSection(&pool->lock);
+		return;
+	}
+
+	if (buffer->published && (HashTable_GetItemValue(pool->published, &buffer->key) == buffer))
+		HashTable_Remove(pool->published, &buffer->key);
+
+	if (!pool->closed && (buffer->cls != GFX_CACHE_NO_CLASS) &&
+	    (pool->stats.cached + buffer->size <= GFX_CACHE_MAX_CACHED))
+	{
+		buffer->next = pool->free[buffer->cls];
+		pool->free[buffer->cls] = buffer;
+		pool->stats.cached += buffer->size;
+		buffer = NULL;
+	}
+	LeaveCriticalSection(&pool->lock);
+
+	winpr_aligned_free(buffer);
+	gfx_cache_pool_release(pool);
+}
+
+static gdiGfxCacheEntry* gfx_cache_entry_new(UINT64 cacheKey, gdiGfxCacheBuffer* buffer)
+{
+	gdiGfxCacheEntryInternal* entry =
+	    (gdiGfxCacheEntryInternal*)calloc(1, sizeof(gdiGfxCacheEntryInternal));
+	if (!entry)
+		return NULL;
+
+	entry->common.cacheKey = cacheKey;
+	entry->buffer = buffer;
+	if (buffer)
+	{
+		entry->common.width = buffer->width;
+		entry->common.height = buffer->height;
+		entry->common.format = buffer->format;
+		entry->common.scanline = buffer->scanline;
+		entry->common.data = buffer->data;
+	}
+
+	return &entry->common;
+}
+
+gdiGfxCachePool* gdi_gfx_cache_pool_new(void)
+{
+	gdiGfxCachePool* pool = (gdiGfxCachePool*)calloc(1, sizeof(gdiGfxCachePool));
+	if (!pool)
+		return NULL;
+
+	InitializeCriticalSection(&pool->lock);
+	pool->refs = 1;
+	pool->published = HashTable_New(FALSE);
+	if (!pool->published)
+		goto fail;
+
+	if (!HashTable_SetHashFunction(pool->published, gfx_cache_key_hash))
+		goto fail;
+
+	wObject* obj = HashTable_KeyObject(pool->published);
+	WINPR_ASSERT(obj);
+	obj->fnObjectEquals = gfx_cache_key_equals;
+	return pool;
+
+fail:
+	WINPR_PRAGMA_DIAG_PUSH
+	WINPR_PRAGMA_DIAG_IGNORED_MISMATCHED_DEALLOC
+	gdi_gfx_cache_pool_free(pool);
+	WINPR_PRAGMA_DIAG_POP
+	return NULL;
+}
+
+void gdi_gfx_cache_pool_free(gdiGfxCachePool* pool)
+{
+	if (!pool)
+		return;
+
+	/* Entries may outlive the graphics pipeline, the buffers they hold keep the pool alive
+	 * but are no longer recycled */
+	gdiGfxCacheBuffer* unused[GFX_CACHE_CLASSES] = { 0 };
+
+	EnterCriticalSection(&pool->lock);
+	pool->closed = TRUE;
+	for (size_t cls = 0; cls < GFX_CACHE_CLASSES; cls++)
+	{
+		unused[cls] = pool->free[cls];
+		pool->free[cls] = NULL;
+	}
+	pool->stats.cached = 0;
+	LeaveCriticalSection(&pool->lock);
+
+	for (size_t cls = 0; cls < GFX_CACHE_CLASSES; cls++)
+	{
+		gdiGfxCacheBuffer* buffer = unused[cls];
+		while (buffer)
+		{
+			gdiGfxCacheBuffer* next = buffer->next;
+			winpr_aligned_free(buffer);
+			buffer = next;
+		}
+	}
+
+	gfx_cache_pool_release(pool);
+}
+
+void gdi_gfx_cache_pool_stats(gdiGfxCachePool* pool, gdiGfxCachePoolStats* stats)
+{
+	WINPR_ASSERT(pool);
+	WINPR_ASSERT(stats);
+
+	EnterCriticalSection(&pool->lock);
+	*stats = pool->stats;
+	LeaveCriticalSection(&pool->lock);
+}
+
+void gdi_gfx_cache_entry_free(gdiGfxCacheEntry* entry)
+{
+	if (!entry)
+		return;
+
+	gdiGfxCacheEntryInternal* internal = cache_entry_cast(entry);
+	gfx_cache_buffer_release(internal->buffer);
+	free(internal);
+}
+
+gdiGfxCacheEntry* gdi_gfx_cache_entry_new(gdiGfxCachePool* pool, UINT64 cacheKey, UINT32 width,
+                                          UINT32 height, UINT32 format)
+{
+	gdiGfxCacheBuffer* buffer = NULL;
+
+	WINPR_ASSERT(pool);
+
+	if ((width > 0) && (height > 0))
+	{
+		const UINT32 scanline = gfx_cache_scanline(width);
+		buffer = gfx_cache_buffer_new(pool, 1ull * scanline * height);
+		if (!buffer)
+			return NULL;
+
+		buffer->key = cacheKey;
+		buffer->width = width;
+		buffer->height = height;
+		buffer->format = format;
+		buffer->scanline = scanline;
+	}
+
+	gdiGfxCacheEntry* entry = gfx_cache_entry_new(cacheKey, buffer);
+	if (!entry)
+	{
+		gfx_cache_buffer_release(buffer);
+		return NULL;
+	}
+
+	if (!buffer)
+	{
+		entry->width = width;
+		entry->height = height;
+		entry->format = format;
+		entry->scanline = gfx_cache_scanline(width);
+	}
+
+	return entry;
+}
+
+gdiGfxCacheEntry* gdi_gfx_cache_entry_share(gdiGfxCachePool* pool, UINT64 cacheKey, UINT32 width,
+                                            UINT32 height, UINT32 format, const BYTE* pSrcData,
+                                            UINT32 nSrcStep)
+{
+	gdiGfxCacheBuffer* buffer = NULL;
+
+	WINPR_ASSERT(pool);
+
+	if (!pSrcData || (width == 0) || (height == 0))
+		return NULL;
+
+	EnterCriticalSection(&pool->lock);
+	buffer = HashTable_GetItemValue(pool->published, &cacheKey);
+	if (buffer && ((buffer->width != width) || (buffer->height != height) ||
+	               (buffer->format != format)))
+		buffer = NULL;
+
+	/* The cache key is chosen by the server, only trust it if the content matches */
+	if (buffer)
+	{
+		const size_t bytes = 1ull * width * FreeRDPGetBytesPerPixel(format);
+		for (UINT32 y = 0; y < height; y++)
+		{
+			if (memcmp(&buffer->data[1ull * y * buffer->scanline], &pSrcData[1ull * y * nSrcStep],
+			           bytes) != 0)
+			{
+				buffer = NULL;
+				break;
+			}
+		}
+	}
+
+	if (buffer)
+	{
+		buffer->refs++;
+		pool->stats.shared++;
+	}
+	LeaveCriticalSection(&pool->lock);
+
+	if (!buffer)
+		return NULL;
+
+	gdiGfxCacheEntry* entry = gfx_cache_entry_new(cacheKey, buffer);
+	if (!entry)
+		gfx_cache_buffer_release(buffer);
+	return entry;
+}
+
+BOOL gdi_gfx_cache_entry_publish(gdiGfxCacheEntry* entry)
+{
+	WINPR_ASSERT(entry);
+
+	gdiGfxCacheBuffer* buffer = cache_entry_cast(entry)->buffer;
+	if (!buffer)
+		return TRUE;
+
+	gdiGfxCachePool* pool = buffer->pool;
+	WINPR_ASSERT(pool);
+
+	EnterCriticalSection(&pool->lock);
+	buffer->published = HashTable_Insert(pool->published, &buffer->key, buffer);
+	const BOOL rc = buffer->published;
+	LeaveCriticalSection(&pool->lock);
+	return rc;
+}
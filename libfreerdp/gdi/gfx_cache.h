@@ -0,0 +1,85 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Graphics Pipeline Cache Entries
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_GDI_GFX_CACHE_H
+#define FREERDP_LIB_GDI_GFX_CACHE_H
+
+#include <freerdp/api.h>
+#include <freerdp/gdi/gfx.h>
+
+/*
+ * The pixels of cache entries live in reference counted buffers taken from per size class
+ * free lists, so evicting and refilling cache slots with tiles of the same dimensions does
+ * not go through the heap.
+ *
+ * A buffer is never written after it was filled. Entries with the same cache key and the same
+ * content share a buffer instead of holding a copy each; a slot that needs different pixels
+ * always gets a buffer of its own.
+ */
+
+typedef struct
+{
+	size_t allocations; /* buffers allocated from the heap */
+	size_t recycled;    /* buffers taken from a free list */
+	size_t shared;      /* entries created as a reference to an existing buffer */
+	size_t cached;      /* bytes currently held in the free lists */
+} gdiGfxCachePoolStats;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** @brief release the owner reference, the pool is freed with the last entry */
+	FREERDP_LOCAL void gdi_gfx_cache_pool_free(gdiGfxCachePool* pool);
+
+	WINPR_ATTR_MALLOC(gdi_gfx_cache_pool_free, 1)
+	FREERDP_LOCAL gdiGfxCachePool* gdi_gfx_cache_pool_new(void);
+
+	FREERDP_LOCAL void gdi_gfx_cache_pool_stats(gdiGfxCachePool* pool,
+	                                            gdiGfxCachePoolStats* stats);
+
+	FREERDP_LOCAL void gdi_gfx_cache_entry_free(gdiGfxCacheEntry* entry);
+
+	/** @brief create an entry with a writable buffer of its own
+	 *
+	 *  Entries of size 0x0 have no buffer. Once the pixels are written the entry
+	 *  should be published with gdi_gfx_cache_entry_publish.
+	 */
+	WINPR_ATTR_MALLOC(gdi_gfx_cache_entry_free, 1)
+	FREERDP_LOCAL gdiGfxCacheEntry* gdi_gfx_cache_entry_new(gdiGfxCachePool* pool,
+	                                                        UINT64 cacheKey, UINT32 width,
+	                                                        UINT32 height, UINT32 format);
+
+	/** @brief create an entry referencing a published buffer with equal key and content
+	 *
+	 *  @param pSrcData The pixels the entry should contain, in the given format
+	 *  @return A new entry sharing an existing buffer or \b NULL if there is none
+	 */
+	WINPR_ATTR_MALLOC(gdi_gfx_cache_entry_free, 1)
+	FREERDP_LOCAL gdiGfxCacheEntry*
+	gdi_gfx_cache_entry_share(gdiGfxCachePool* pool, UINT64 cacheKey, UINT32 width, UINT32 height,
+	                          UINT32 format, const BYTE* pSrcData, UINT32 nSrcStep);
+
+	/** @brief make the content of \b entry available for sharing by its cache key */
+	FREERDP_LOCAL BOOL gdi_gfx_cache_entry_publish(gdiGfxCacheEntry* entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_LIB_GDI_GFX_CACHE_H */
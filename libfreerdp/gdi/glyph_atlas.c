@@ -0,0 +1,496 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Glyph Atlas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+#include <freerdp/log.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/gdi/dc.h>
+#include <freerdp/gdi/region.h>
+#include <freerdp/gdi/shape.h>
+
+#include "brush.h"
+#include "clipping.h"
+#include "drawing.h"
+#include "gdi.h"
+#include "glyph_atlas.h"
+#include "sse/glyph_sse2.h"
+
+#define TAG FREERDP_TAG("gdi.glyph")
+
+/* Cells are powers of two from 64 bytes to 16KiB carved from 64KiB pages, larger masks are
+ * allocated on their own */
+#define GLYPH_ATLAS_MIN_CLASS_SHIFT 6
+#define GLYPH_ATLAS_CLASSES 9
+#define GLYPH_ATLAS_NO_CLASS GLYPH_ATLAS_CLASSES
+#define GLYPH_ATLAS_PAGE_SIZE (64ull * 1024ull)
+#define GLYPH_ATLAS_ALIGNMENT 16
+
+typedef struct gdi_glyph_atlas_page gdiGlyphAtlasPage;
+
+struct gdi_glyph_atlas_page
+{
+	gdiGlyphAtlasPage* next;
+	size_t used;
+	BYTE* data;
+};
+
+typedef struct
+{
+	const BYTE* mask; /* the top left mask byte of the visible part */
+	UINT32 maskStep;
+	INT32 x;
+	INT32 y;
+	INT32 width;
+	INT32 height;
+	BOOL fill;
+	GDI_RECT fillRect;
+} gdiGlyphRunEntry;
+
+struct gdi_glyph_atlas
+{
+	CRITICAL_SECTION lock;
+	size_t refs; /* the owner and every stored glyph */
+
+	/* free cells, the first bytes of a cell point to the next one */
+	void* free[GLYPH_ATLAS_CLASSES];
+	gdiGlyphAtlasPage* current[GLYPH_ATLAS_CLASSES];
+	gdiGlyphAtlasPage* pages;
+
+	BOOL active;
+	HGDI_DC hdc;
+	gdiGlyphRunEntry* entries;
+	size_t count;
+	size_t capacity;
+};
+
+static size_t glyph_atlas_class(size_t size)
+{
+	for (size_t cls = 0; cls < GLYPH_ATLAS_CLASSES; cls++)
+	{
+		if (size <= (1ull << (cls + GLYPH_ATLAS_MIN_CLASS_SHIFT)))
+			return cls;
+	}
+
+	return GLYPH_ATLAS_NO_CLASS;
+}
+
+static void glyph_atlas_release(gdiGlyphAtlas* atlas)
+{
+	size_t refs = 0;
+
+	WINPR_ASSERT(atlas);
+
+	EnterCriticalSection(&atlas->lock);
+	refs = --atlas->refs;
+	LeaveCriticalSection(&atlas->lock);
+
+	if (refs > 0)
+		return;
+
+	while (atlas->pages)
+	{
+		gdiGlyphAtlasPage* page = atlas->pages;
+		atlas->pages = page->next;
+		winpr_aligned_free(page->data);
+		free(page);
+	}
+
+	free(atlas->entries);
+	DeleteCriticalSection(&atlas->lock);
+	free(atlas);
+}
+
+static BYTE* glyph_atlas_alloc(gdiGlyphAtlas* atlas, size_t size)
+{
+	BYTE* cell = NULL;
+	const size_t cls = glyph_atlas_class(size);
+
+	WINPR_ASSERT(atlas);
+
+	if (cls == GLYPH_ATLAS_NO_CLASS)
+		cell = winpr_aligned_malloc(size, GLYPH_ATLAS_ALIGNMENT);
+	else
+	{
+		const size_t cellSize = 1ull << (cls + GLYPH_ATLAS_MIN_CLASS_SHIFT);
+
+		EnterCriticalSection(&atlas->lock);
+		if (atlas->free[cls])
+		{
+			cell = atlas->free[cls];
+			memcpy(&atlas->free[cls], cell, sizeof(void*));
+		}
+		else
+		{
+			gdiGlyphAtlasPage* page = atlas->current[cls];
+
+			if (!page || (page->used + cellSize > GLYPH_ATLAS_PAGE_SIZE))
+			{
+				page = calloc(1, sizeof(gdiGlyphAtlasPage));
+				if (page)
+					page->data = winpr_aligned_malloc(GLYPH_ATLAS_PAGE_SIZE, GLYPH_ATLAS_ALIGNMENT);
+
+				if (page && page->data)
+				{
+					page->next = atlas->pages;
+					atlas->pages = page;
+					atlas->current[cls] = page;
+				}
+				else
+				{
+					free(page);
+					page = NULL;
+				}
+			}
+
+			if (page)
+			{
+				cell = &page->data[page->used];
+				page->used += cellSize;
+			}
+		}
+		LeaveCriticalSection(&atlas->lock);
+	}
+
+	if (!cell)
+		return NULL;
+
+	EnterCriticalSection(&atlas->lock);
+	atlas->refs++;
+	LeaveCriticalSection(&atlas->lock);
+	return cell;
+}
+
+gdiGlyphAtlas* gdi_glyph_atlas_new(void)
+{
+	gdiGlyphAtlas* atlas = calloc(1, sizeof(gdiGlyphAtlas));
+
+	if (!atlas)
+		return NULL;
+
+	if (!InitializeCriticalSectionAndSpinCount(&atlas->lock, 4000))
+	{
+		free(atlas);
+		return NULL;
+	}
+
+	atlas->refs = 1;
+	return atlas;
+}
+
+void gdi_glyph_atlas_free(gdiGlyphAtlas* atlas)
+{
+	if (!atlas)
+		return;
+
+	/* a run still referencing glyphs must not outlive them */
+	atlas->active = FALSE;
+	atlas->count = 0;
+	glyph_atlas_release(atlas);
+}
+
+BYTE* gdi_glyph_atlas_store(gdiGlyphAtlas* atlas, UINT32 cx, UINT32 cy, const BYTE* aj, size_t cb)
+{
+	const size_t scanline = (cx + 7) / 8;
+	const size_t size = 1ull * cx * cy;
+
+	WINPR_ASSERT(atlas);
+
+	if (scanline * cy > cb)
+	{
+		WLog_ERR(TAG, "glyph %" PRIu32 "x%" PRIu32 " with only %" PRIuz " bytes", cx, cy, cb);
+		return NULL;
+	}
+
+	/* empty glyphs still get a cell, the caller tells them apart by the pointer */
+	BYTE* mask = glyph_atlas_alloc(atlas, MAX(size, 1));
+	if (!mask)
+		return NULL;
+
+	BYTE* dst = mask;
+	for (size_t y = 0; y < cy; y++)
+	{
+		const BYTE* src = &aj[y * scanline];
+
+		for (size_t x = 0; x < cx; x++)
+			*dst++ = (src[x / 8] & (0x80 >> (x % 8))) ? 0xFF : 0x00;
+	}
+
+	return mask;
+}
+
+void gdi_glyph_atlas_release(gdiGlyphAtlas* atlas, BYTE* mask, UINT32 cx, UINT32 cy)
+{
+	if (!atlas || !mask)
+		return;
+
+	const size_t cls = glyph_atlas_class(MAX(1ull * cx * cy, 1));
+
+	if (cls == GLYPH_ATLAS_NO_CLASS)
+		winpr_aligned_free(mask);
+	else
+	{
+		EnterCriticalSection(&atlas->lock);
+		memcpy(mask, &atlas->free[cls], sizeof(void*));
+		atlas->free[cls] = mask;
+		LeaveCriticalSection(&atlas->lock);
+	}
+
+	glyph_atlas_release(atlas);
+}
+
+void gdi_glyph_atlas_begin_run(gdiGlyphAtlas* atlas)
+{
+	WINPR_ASSERT(atlas);
+
+	/* an order that failed half way never ended its run, its glyphs might be gone by now */
+	atlas->count = 0;
+	atlas->hdc = NULL;
+	atlas->active = TRUE;
+}
+
+static BOOL glyph_atlas_flush(gdiGlyphAtlas* atlas)
+{
+	BOOL rc = FALSE;
+	BYTE color[4] = { 0 };
+	HGDI_BRUSH brush = NULL;
+	GDI_RECT bounds = { 0 };
+	BOOL drawn = FALSE;
+
+	WINPR_ASSERT(atlas);
+
+	if (atlas->count == 0)
+		return TRUE;
+
+	HGDI_DC hdc = atlas->hdc;
+	WINPR_ASSERT(hdc);
+
+	const HGDI_BITMAP hBmp = (HGDI_BITMAP)hdc->selectedObject;
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(hdc->format);
+	const pGdiGlyphRow kernel = gdi_get_glyph_row(bpp);
+
+	if (!hBmp || !kernel || !FreeRDPWriteColor(color, hdc->format, hdc->textColor))
+		goto fail;
+
+	for (size_t x = 0; x < atlas->count; x++)
+	{
+		const gdiGlyphRunEntry* entry = &atlas->entries[x];
+
+		/* the background of a glyph is filled right before it, it may cover its neighbours */
+		if (entry->fill)
+		{
+			if (!brush)
+			{
+				brush = gdi_CreateSolidBrush(hdc->bkColor);
+				if (!brush)
+					goto fail;
+			}
+
+			GDI_RECT fillRect = entry->fillRect;
+			if (!gdi_FillRect(hdc, &fillRect, brush))
+				goto fail;
+		}
+
+		if ((entry->width <= 0) || (entry->height <= 0))
+			continue;
+
+		for (INT32 y = 0; y < entry->height; y++)
+		{
+			BYTE* pDst = gdi_get_bitmap_pointer(hdc, entry->x, entry->y + y);
+			if (!pDst)
+				goto fail;
+
+			kernel(pDst, &entry->mask[1ull * entry->maskStep * (size_t)y], color,
+			       (size_t)entry->width);
+		}
+
+		const INT32 right = entry->x + entry->width - 1;
+		const INT32 bottom = entry->y + entry->height - 1;
+
+		if (!drawn)
+		{
+			bounds.left = entry->x;
+			bounds.top = entry->y;
+			bounds.right = right;
+			bounds.bottom = bottom;
+			drawn = TRUE;
+		}
+		else
+		{
+			bounds.left = MIN(bounds.left, entry->x);
+			bounds.top = MIN(bounds.top, entry->y);
+			bounds.right = MAX(bounds.right, right);
+			bounds.bottom = MAX(bounds.bottom, bottom);
+		}
+	}
+
+	if (drawn && !gdi_InvalidateRegion(hdc, bounds.left, bounds.top,
+	                                   bounds.right - bounds.left + 1,
+	                                   bounds.bottom - bounds.top + 1))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	gdi_DeleteObject((HGDIOBJECT)brush);
+	atlas->count = 0;
+	atlas->hdc = NULL;
+	return rc;
+}
+
+BOOL gdi_glyph_atlas_draw(gdiGlyphAtlas* atlas, HGDI_DC hdc, const BYTE* mask, UINT32 cx,
+                          UINT32 cy, INT32 x, INT32 y, INT32 w, INT32 h, INT32 sx, INT32 sy,
+                          const GDI_RECT* fill)
+{
+	gdiGlyphRunEntry entry = { 0 };
+
+	WINPR_ASSERT(atlas);
+	WINPR_ASSERT(hdc);
+	WINPR_ASSERT(mask);
+
+	if (atlas->hdc && (atlas->hdc != hdc) && !glyph_atlas_flush(atlas))
+		return FALSE;
+
+	if (fill)
+	{
+		entry.fill = TRUE;
+		entry.fillRect = *fill;
+	}
+
+	/* the clipping of gdi_BitBlt, the source is moved back into the glyph if it sticks out */
+	if (gdi_ClipCoords(hdc, &x, &y, &w, &h, &sx, &sy))
+	{
+		const HGDI_BITMAP hBmp = (HGDI_BITMAP)hdc->selectedObject;
+
+		if (!hBmp)
+			return FALSE;
+
+		if (x < 0)
+		{
+			sx -= x;
+			w += x;
+			x = 0;
+		}
+
+		if (y < 0)
+		{
+			sy -= y;
+			h += y;
+			y = 0;
+		}
+
+		w = MIN(w, hBmp->width - x);
+		h = MIN(h, hBmp->height - y);
+		if ((w < 0) || (h < 0))
+			w = h = x = y = 0;
+
+		sx = MAX(sx, 0);
+		sy = MAX(sy, 0);
+
+		if ((INT64)sx + w > (INT64)cx)
+			sx = WINPR_ASSERTING_INT_CAST(INT32, cx) - w;
+
+		if ((INT64)sy + h > (INT64)cy)
+			sy = WINPR_ASSERTING_INT_CAST(INT32, cy) - h;
+
+		if ((sx < 0) || (sy < 0))
+			return FALSE;
+
+		entry.mask = &mask[1ull * cx * (size_t)sy + (size_t)sx];
+		entry.maskStep = cx;
+		entry.x = x;
+		entry.y = y;
+		entry.width = w;
+		entry.height = h;
+	}
+	else if (!entry.fill)
+		return TRUE;
+
+	if (atlas->count == atlas->capacity)
+	{
+		const size_t capacity = MAX(64, atlas->capacity * 2);
+		gdiGlyphRunEntry* entries = realloc(atlas->entries, capacity * sizeof(gdiGlyphRunEntry));
+
+		if (!entries)
+			return FALSE;
+
+		atlas->entries = entries;
+		atlas->capacity = capacity;
+	}
+
+	atlas->entries[atlas->count++] = entry;
+	atlas->hdc = hdc;
+
+	if (!atlas->active)
+		return glyph_atlas_flush(atlas);
+
+	return TRUE;
+}
+
+BOOL gdi_glyph_atlas_end_run(gdiGlyphAtlas* atlas)
+{
+	WINPR_ASSERT(atlas);
+
+	atlas->active = FALSE;
+	return glyph_atlas_flush(atlas);
+}
+
+#define GDI_GLYPH_ROW(bpp)                                                                     \
+	static void gdi_glyph_row_##bpp(BYTE* WINPR_RESTRICT pDst, const BYTE* WINPR_RESTRICT pMask, \
+	                                const BYTE* WINPR_RESTRICT pColor, size_t width)             \
+	{                                                                                          \
+		for (size_t x = 0; x < width; x++)                                                     \
+		{                                                                                      \
+			if (pMask[x])                                                                      \
+				memcpy(&pDst[x * (bpp)], pColor, (bpp));                                       \
+		}                                                                                      \
+	}
+
+GDI_GLYPH_ROW(2)
+GDI_GLYPH_ROW(3)
+GDI_GLYPH_ROW(4)
+
+/* 8bpp glyphs go through the palette in gdi_BitBlt, they have no kernel */
+static pGdiGlyphRow gdi_glyph_rows[5] = { NULL, NULL, gdi_glyph_row_2, gdi_glyph_row_3,
+	                                      gdi_glyph_row_4 };
+
+static INIT_ONCE gdi_glyph_InitOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK gdi_glyph_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	gdi_glyph_init_sse2(gdi_glyph_rows);
+	return TRUE;
+}
+
+pGdiGlyphRow gdi_get_glyph_row(UINT32 bpp)
+{
+	if ((bpp == 0) || (bpp >= ARRAYSIZE(gdi_glyph_rows)))
+		return NULL;
+
+	/* the generic kernels stay in place if the initialization fails */
+	(void)InitOnceExecuteOnce(&gdi_glyph_InitOnce, gdi_glyph_init, NULL, NULL);
+	return gdi_glyph_rows[bpp];
+}
@@ -0,0 +1,92 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Glyph Atlas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_GDI_GLYPH_ATLAS_H
+#define FREERDP_LIB_GDI_GLYPH_ATLAS_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+#include <freerdp/gdi/gdi.h>
+
+/*
+ * Glyphs are kept as masks of one byte per pixel (0x00 or 0xFF) with a stride of the glyph
+ * width. The masks are carved from shared pages in power of two size classes, so the glyphs of
+ * a font sit next to each other instead of being scattered over the heap.
+ *
+ * The glyphs of a text order are not blitted one by one; they are collected into a run between
+ * gdi_glyph_atlas_begin_run and gdi_glyph_atlas_end_run and composited in one pass, with the
+ * color conversion, brush setup and invalidation done once per order.
+ */
+
+/**
+ * Sets the pixels of a scanline whose mask byte is set to the color, others are left alone.
+ *
+ * @param pDst the destination pixels
+ * @param pMask the mask bytes, one per pixel
+ * @param pColor the color in the destination format
+ * @param width the number of pixels
+ */
+typedef void (*pGdiGlyphRow)(BYTE* WINPR_RESTRICT pDst, const BYTE* WINPR_RESTRICT pMask,
+                             const BYTE* WINPR_RESTRICT pColor, size_t width);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** @brief release the owner reference, the atlas is freed with the last glyph */
+	FREERDP_LOCAL void gdi_glyph_atlas_free(gdiGlyphAtlas* atlas);
+
+	WINPR_ATTR_MALLOC(gdi_glyph_atlas_free, 1)
+	FREERDP_LOCAL gdiGlyphAtlas* gdi_glyph_atlas_new(void);
+
+	/** @brief expand a 1bpp glyph (rows padded to bytes) into a mask stored in the atlas
+	 *
+	 *  @return the mask of \b cx * \b cy bytes or \b NULL if \b cb is too short
+	 */
+	FREERDP_LOCAL BYTE* gdi_glyph_atlas_store(gdiGlyphAtlas* atlas, UINT32 cx, UINT32 cy,
+	                                          const BYTE* aj, size_t cb);
+
+	/** @brief return the mask of a glyph to the atlas */
+	FREERDP_LOCAL void gdi_glyph_atlas_release(gdiGlyphAtlas* atlas, BYTE* mask, UINT32 cx,
+	                                           UINT32 cy);
+
+	/** @brief start collecting the glyphs of a text order, a run left over is dropped */
+	FREERDP_LOCAL void gdi_glyph_atlas_begin_run(gdiGlyphAtlas* atlas);
+
+	/** @brief add a glyph to the run, drawn right away if there is none
+	 *
+	 *  The arguments are those of a GDI_GLYPH_ORDER gdi_BitBlt of the glyph in the text color of
+	 *  \b hdc, preceded by a gdi_FillRect of \b fill in the background color if it is set.
+	 */
+	FREERDP_LOCAL BOOL gdi_glyph_atlas_draw(gdiGlyphAtlas* atlas, HGDI_DC hdc, const BYTE* mask,
+	                                        UINT32 cx, UINT32 cy, INT32 x, INT32 y, INT32 w,
+	                                        INT32 h, INT32 sx, INT32 sy, const GDI_RECT* fill);
+
+	/** @brief composite the glyphs collected since gdi_glyph_atlas_begin_run */
+	FREERDP_LOCAL BOOL gdi_glyph_atlas_end_run(gdiGlyphAtlas* atlas);
+
+	/** @brief the scanline kernel for a format of \b bpp bytes per pixel, \b NULL if there is
+	 * none */
+	FREERDP_LOCAL pGdiGlyphRow gdi_get_glyph_row(UINT32 bpp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_LIB_GDI_GLYPH_ATLAS_H */
@@ -34,6 +34,7 @@
 #include "drawing.h"
 #include "brush.h"
 #include "graphics.h"
+#include "glyph_atlas.h"
 
 #define TAG FREERDP_TAG("gdi")
 /* Bitmap Class */
@@ -189,6 +190,7 @@ static BOOL gdi_Bitmap_Decompress(rdpContext* context, rdpBitmap* bitmap, const
 		}
 		else if (bpp < 32)
 		{
+			const UINT64 begin = metrics_stage_begin(context->metrics);
 			if (!interleaved_decompress(context->codecs->interleaved, pSrcData, SrcSize, DstWidth,
 			                            DstHeight, bpp, bitmap->data, bitmap->format, 0, 0, 0,
 			                            DstWidth, DstHeight, &gdi->palette))
@@ -196,12 +198,14 @@ static BOOL gdi_Bitmap_Decompress(rdpContext* context, rdpBitmap* bitmap, const
 				WLog_ERR(TAG, "interleaved_decompress failed");
 				return FALSE;
 			}
+			metrics_stage_end(context->metrics, FREERDP_METRICS_DECODE_INTERLEAVED, begin);
 		}
 		else
 		{
 			const BOOL fidelity =
 			    freerdp_settings_get_bool(context->settings, FreeRDP_DrawAllowDynamicColorFidelity);
 			freerdp_planar_switch_bgr(context->codecs->planar, fidelity);
+			const UINT64 begin = metrics_stage_begin(context->metrics);
 			if (!planar_decompress(context->codecs->planar, pSrcData, SrcSize, DstWidth, DstHeight,
 			                       bitmap->data, bitmap->format, 0, 0, 0, DstWidth, DstHeight,
 			                       TRUE))
@@ -209,6 +213,7 @@ static BOOL gdi_Bitmap_Decompress(rdpContext* context, rdpBitmap* bitmap, const
 				WLog_ERR(TAG, "planar_decompress failed");
 				return FALSE;
 			}
+			metrics_stage_end(context->metrics, FREERDP_METRICS_DECODE_PLANAR, begin);
 		}
 	}
 	else
@@ -269,36 +274,38 @@ static BOOL gdi_Glyph_New(rdpContext* context, rdpGlyph* glyph)
 	BYTE* data = NULL;
 	gdiGlyph* gdi_glyph = NULL;
 
-	if (!context || !glyph)
+	if (!context || !context->gdi || !glyph)
 		return FALSE;
 
 	gdi_glyph = (gdiGlyph*)glyph;
+	gdi_glyph->atlas = context->gdi->glyphAtlas;
 	gdi_glyph->hdc = gdi_GetDC();
 
-	if (!gdi_glyph->hdc)
-		return FALSE;
+	if (!gdi_glyph->hdc || !gdi_glyph->atlas)
+		goto fail;
 
 	gdi_glyph->hdc->format = PIXEL_FORMAT_MONO;
-	data = freerdp_glyph_convert(glyph->cx, glyph->cy, glyph->aj);
+	data = gdi_glyph_atlas_store(gdi_glyph->atlas, glyph->cx, glyph->cy, glyph->aj, glyph->cb);
 
 	if (!data)
-	{
-		gdi_DeleteDC(gdi_glyph->hdc);
-		return FALSE;
-	}
+		goto fail;
 
-	gdi_glyph->bitmap = gdi_CreateBitmap(glyph->cx, glyph->cy, PIXEL_FORMAT_MONO, data);
+	/* the mask belongs to the atlas, the bitmap must not free it */
+	gdi_glyph->bitmap = gdi_CreateBitmapEx(glyph->cx, glyph->cy, PIXEL_FORMAT_MONO, 0, data, NULL);
 
 	if (!gdi_glyph->bitmap)
-	{
-		gdi_DeleteDC(gdi_glyph->hdc);
-		winpr_aligned_free(data);
-		return FALSE;
-	}
+		goto fail;
 
 	gdi_SelectObject(gdi_glyph->hdc, (HGDIOBJECT)gdi_glyph->bitmap);
 	gdi_glyph->org_bitmap = NULL;
 	return TRUE;
+
+fail:
+	gdi_glyph_atlas_release(gdi_glyph->atlas, data, glyph->cx, glyph->cy);
+	gdi_DeleteDC(gdi_glyph->hdc);
+	gdi_glyph->hdc = NULL;
+	gdi_glyph->atlas = NULL;
+	return FALSE;
 }
 
 static void gdi_Glyph_Free(rdpContext* context, rdpGlyph* glyph)
@@ -308,20 +315,41 @@ static void gdi_Glyph_Free(rdpContext* context, rdpGlyph* glyph)
 
 	if (gdi_glyph)
 	{
+		BYTE* data = gdi_glyph->bitmap ? gdi_glyph->bitmap->data : NULL;
+
 		gdi_SelectObject(gdi_glyph->hdc, (HGDIOBJECT)gdi_glyph->org_bitmap);
 		gdi_DeleteObject((HGDIOBJECT)gdi_glyph->bitmap);
 		gdi_DeleteDC(gdi_glyph->hdc);
+		gdi_glyph_atlas_release(gdi_glyph->atlas, data, glyph->cx, glyph->cy);
 		free(glyph->aj);
 		free(glyph);
 	}
 }
 
+/* 8bpp has no glyph kernel and formats without alpha keep the top bit of 15bpp pixels cleared,
+ * gdi_BitBlt takes care of those */
+static BOOL gdi_Glyph_UseAtlas(const gdiGlyph* gdi_glyph, HGDI_DC hdc)
+{
+	WINPR_ASSERT(gdi_glyph);
+	WINPR_ASSERT(hdc);
+
+	if (!gdi_glyph->atlas)
+		return FALSE;
+
+	if ((FreeRDPGetBitsPerPixel(hdc->format) == 15) && !FreeRDPColorHasAlpha(hdc->format))
+		return FALSE;
+
+	return gdi_get_glyph_row(FreeRDPGetBytesPerPixel(hdc->format)) != NULL;
+}
+
 static BOOL gdi_Glyph_Draw(rdpContext* context, const rdpGlyph* glyph, INT32 x, INT32 y, INT32 w,
                            INT32 h, INT32 sx, INT32 sy, BOOL fOpRedundant)
 {
 	const gdiGlyph* gdi_glyph = NULL;
 	rdpGdi* gdi = NULL;
 	HGDI_BRUSH brush = NULL;
+	GDI_RECT rect = { 0 };
+	BOOL fill = FALSE;
 	BOOL rc = FALSE;
 
 	if (!context || !glyph)
@@ -332,8 +360,6 @@ static BOOL gdi_Glyph_Draw(rdpContext* context, const rdpGlyph* glyph, INT32 x,
 
 	if (!fOpRedundant)
 	{
-		GDI_RECT rect = { 0 };
-
 		if (x > 0)
 			rect.left = x;
 
@@ -346,16 +372,23 @@ static BOOL gdi_Glyph_Draw(rdpContext* context, const rdpGlyph* glyph, INT32 x,
 		if (y + h > 0)
 			rect.bottom = y + h - 1;
 
-		if ((rect.left < rect.right) && (rect.top < rect.bottom))
-		{
-			brush = gdi_CreateSolidBrush(gdi->drawing->hdc->bkColor);
+		fill = (rect.left < rect.right) && (rect.top < rect.bottom);
+	}
 
-			if (!brush)
-				return FALSE;
+	if (gdi_Glyph_UseAtlas(gdi_glyph, gdi->drawing->hdc))
+		return gdi_glyph_atlas_draw(gdi_glyph->atlas, gdi->drawing->hdc,
+		                            gdi_glyph->bitmap->data, glyph->cx, glyph->cy, x, y, w, h, sx,
+		                            sy, fill ? &rect : NULL);
 
-			gdi_FillRect(gdi->drawing->hdc, &rect, brush);
-			gdi_DeleteObject((HGDIOBJECT)brush);
-		}
+	if (fill)
+	{
+		brush = gdi_CreateSolidBrush(gdi->drawing->hdc->bkColor);
+
+		if (!brush)
+			return FALSE;
+
+		gdi_FillRect(gdi->drawing->hdc, &rect, brush);
+		gdi_DeleteObject((HGDIOBJECT)brush);
 	}
 
 	brush = gdi_CreateSolidBrush(gdi->drawing->hdc->textColor);
@@ -383,6 +416,9 @@ static BOOL gdi_Glyph_BeginDraw(rdpContext* context, INT32 x, INT32 y, INT32 wid
 	if (!gdi->drawing || !gdi->drawing->hdc)
 		return FALSE;
 
+	if (gdi->glyphAtlas)
+		gdi_glyph_atlas_begin_run(gdi->glyphAtlas);
+
 	if (!fOpRedundant)
 	{
 		if (!gdi_decode_color(gdi, bgcolor, &bgcolor, NULL))
@@ -437,6 +473,9 @@ static BOOL gdi_Glyph_EndDraw(rdpContext* context, INT32 x, INT32 y, INT32 width
 	if (!gdi->drawing || !gdi->drawing->hdc)
 		return FALSE;
 
+	if (gdi->glyphAtlas && !gdi_glyph_atlas_end_run(gdi->glyphAtlas))
+		return FALSE;
+
 	gdi_SetNullClipRgn(gdi->drawing->hdc);
 	return TRUE;
 }
@@ -0,0 +1,89 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Ternary Raster Operation Kernels
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+
+#include <winpr/synch.h>
+
+#include "rop3.h"
+#include "sse/rop3_sse2.h"
+
+#define GDI_ROP3_AND(a, b) ((a) & (b))
+#define GDI_ROP3_OR(a, b) ((a) | (b))
+#define GDI_ROP3_XOR(a, b) ((a) ^ (b))
+#define GDI_ROP3_NOT(a) (~(a))
+
+/* eight bytes at a time, unaligned rows are fine as the loads go through memcpy */
+#define GDI_ROP3_ROW(code)                                                                      \
+	static void gdi_rop3_row_##code(BYTE* WINPR_RESTRICT pDst, const BYTE* WINPR_RESTRICT pSrc, \
+	                                const BYTE* WINPR_RESTRICT pPat, size_t size)               \
+	{                                                                                           \
+		size_t x = 0;                                                                           \
+                                                                                                \
+		for (; x + sizeof(UINT64) <= size; x += sizeof(UINT64))                                 \
+		{                                                                                       \
+			UINT64 d = 0;                                                                       \
+			UINT64 s = 0;                                                                       \
+			UINT64 p = 0;                                                                       \
+                                                                                                \
+			memcpy(&d, &pDst[x], sizeof(d));                                                    \
+			if (GDI_ROP3_USES_SRC(code))                                                        \
+				memcpy(&s, &pSrc[x], sizeof(s));                                                \
+			if (GDI_ROP3_USES_PAT(code))                                                        \
+				memcpy(&p, &pPat[x], sizeof(p));                                                \
+                                                                                                \
+			d = GDI_ROP3(code, p, s, d, GDI_ROP3_AND, GDI_ROP3_OR, GDI_ROP3_XOR, GDI_ROP3_NOT); \
+			memcpy(&pDst[x], &d, sizeof(d));                                                    \
+		}                                                                                       \
+                                                                                                \
+		for (; x < size; x++)                                                                   \
+		{                                                                                       \
+			const UINT32 d = pDst[x];                                                           \
+			const UINT32 s = GDI_ROP3_USES_SRC(code) ? pSrc[x] : 0;                             \
+			const UINT32 p = GDI_ROP3_USES_PAT(code) ? pPat[x] : 0;                             \
+                                                                                                \
+			pDst[x] = (BYTE)GDI_ROP3(code, p, s, d, GDI_ROP3_AND, GDI_ROP3_OR, GDI_ROP3_XOR,    \
+			                         GDI_ROP3_NOT);                                             \
+		}                                                                                       \
+	}
+
+GDI_ROP3_EXPAND256(GDI_ROP3_ROW)
+
+#define GDI_ROP3_ENTRY(code) gdi_rop3_row_##code,
+
+static pGdiRop3Row gdi_rop3_rows[256] = { GDI_ROP3_EXPAND256(GDI_ROP3_ENTRY) };
+
+static INIT_ONCE gdi_rop3_InitOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK gdi_rop3_init(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	gdi_rop3_init_sse2(gdi_rop3_rows);
+	return TRUE;
+}
+
+pGdiRop3Row gdi_get_rop3_row(BYTE code)
+{
+	/* the generic kernels stay in place if the initialization fails */
+	(void)InitOnceExecuteOnce(&gdi_rop3_InitOnce, gdi_rop3_init, NULL, NULL);
+	return gdi_rop3_rows[code];
+}
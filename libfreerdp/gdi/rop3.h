@@ -0,0 +1,125 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Ternary Raster Operation Kernels
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_GDI_ROP3_H
+#define FREERDP_LIB_GDI_ROP3_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/api.h>
+
+/**
+ * A ROP3 code is the truth table of the operation, bit (P << 2) | (S << 1) | D of the code is
+ * the result for that combination of pattern, source and destination bits. As all operations
+ * are bitwise a whole scanline is processed as a byte string, whatever the pixel format.
+ *
+ * The macros below pick an expression for a constant code at compile time, the operators are
+ * passed in so the same expression works on integer and vector types.
+ */
+
+/* the truth table differs between the operand bit being 0 and 1 */
+#define GDI_ROP3_USES_PAT(code) ((((code) >> 4) & 0x0F) != ((code)&0x0F))
+#define GDI_ROP3_USES_SRC(code) ((((code) >> 2) & 0x33) != ((code)&0x33))
+
+/* the 16 functions of source and destination, t is the truth table (S << 1) | D */
+#define GDI_ROP2(t, s, d, AND, OR, XOR, NOT) \
+	(((t) == 0x0)   ? XOR(d, d)              \
+	 : ((t) == 0x1) ? NOT(OR(s, d))          \
+	 : ((t) == 0x2) ? AND(NOT(s), d)         \
+	 : ((t) == 0x3) ? NOT(s)                 \
+	 : ((t) == 0x4) ? AND(s, NOT(d))         \
+	 : ((t) == 0x5) ? NOT(d)                 \
+	 : ((t) == 0x6) ? XOR(s, d)              \
+	 : ((t) == 0x7) ? NOT(AND(s, d))         \
+	 : ((t) == 0x8) ? AND(s, d)              \
+	 : ((t) == 0x9) ? NOT(XOR(s, d))         \
+	 : ((t) == 0xA) ? (d)                    \
+	 : ((t) == 0xB) ? OR(NOT(s), d)          \
+	 : ((t) == 0xC) ? (s)                    \
+	 : ((t) == 0xD) ? OR(s, NOT(d))          \
+	 : ((t) == 0xE) ? OR(s, d)               \
+	                : NOT(XOR(d, d)))
+
+#define GDI_ROP3_LO(code, s, d, AND, OR, XOR, NOT) GDI_ROP2((code)&0x0F, s, d, AND, OR, XOR, NOT)
+#define GDI_ROP3_HI(code, s, d, AND, OR, XOR, NOT) GDI_ROP2((code) >> 4, s, d, AND, OR, XOR, NOT)
+
+/* Shannon expansion on the pattern, the low nibble is the result for P = 0 */
+#define GDI_ROP3(code, p, s, d, AND, OR, XOR, NOT)                                             \
+	((((code)&0x0F) == ((code) >> 4)) ? GDI_ROP3_LO(code, s, d, AND, OR, XOR, NOT)             \
+	 : (((code)&0x0F) == ((~(code) >> 4) & 0x0F))                                              \
+	     ? XOR(p, GDI_ROP3_LO(code, s, d, AND, OR, XOR, NOT))                                  \
+	 : (((code)&0x0F) == 0x00) ? AND(p, GDI_ROP3_HI(code, s, d, AND, OR, XOR, NOT))            \
+	 : (((code) >> 4) == 0x00) ? AND(NOT(p), GDI_ROP3_LO(code, s, d, AND, OR, XOR, NOT))       \
+	 : (((code)&0x0F) == 0x0F) ? OR(NOT(p), GDI_ROP3_HI(code, s, d, AND, OR, XOR, NOT))        \
+	 : (((code) >> 4) == 0x0F) ? OR(p, GDI_ROP3_LO(code, s, d, AND, OR, XOR, NOT))             \
+	                           : XOR(GDI_ROP3_LO(code, s, d, AND, OR, XOR, NOT),               \
+	                                 AND(p, XOR(GDI_ROP3_LO(code, s, d, AND, OR, XOR, NOT),    \
+	                                            GDI_ROP3_HI(code, s, d, AND, OR, XOR, NOT)))))
+
+/* instantiates a macro for the 16 codes starting with the high nibble h, e.g. 0x4 */
+#define GDI_ROP3_EXPAND16(M, h)                                                             \
+	M(h##0) M(h##1) M(h##2) M(h##3) M(h##4) M(h##5) M(h##6) M(h##7) M(h##8) M(h##9) M(h##A) \
+	M(h##B) M(h##C) M(h##D) M(h##E) M(h##F)
+
+#define GDI_ROP3_EXPAND256(M) \
+	GDI_ROP3_EXPAND16(M, 0x0) \
+	GDI_ROP3_EXPAND16(M, 0x1) \
+	GDI_ROP3_EXPAND16(M, 0x2) \
+	GDI_ROP3_EXPAND16(M, 0x3) \
+	GDI_ROP3_EXPAND16(M, 0x4) \
+	GDI_ROP3_EXPAND16(M, 0x5) \
+	GDI_ROP3_EXPAND16(M, 0x6) \
+	GDI_ROP3_EXPAND16(M, 0x7) \
+	GDI_ROP3_EXPAND16(M, 0x8) \
+	GDI_ROP3_EXPAND16(M, 0x9) \
+	GDI_ROP3_EXPAND16(M, 0xA) \
+	GDI_ROP3_EXPAND16(M, 0xB) \
+	GDI_ROP3_EXPAND16(M, 0xC) \
+	GDI_ROP3_EXPAND16(M, 0xD) \
+	GDI_ROP3_EXPAND16(M, 0xE) \
+	GDI_ROP3_EXPAND16(M, 0xF)
+
+/**
+ * Applies a ternary raster operation to a scanline, pDst = rop(pPat, pSrc, pDst).
+ *
+ * @param pDst the destination bytes, read and written
+ * @param pSrc the source bytes in the destination format, only read if the code uses them
+ * @param pPat the pattern bytes in the destination format, only read if the code uses them
+ * @param size the number of bytes to process
+ */
+typedef void (*pGdiRop3Row)(BYTE* WINPR_RESTRICT pDst, const BYTE* WINPR_RESTRICT pSrc,
+                            const BYTE* WINPR_RESTRICT pPat, size_t size);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/**
+	 * @brief Get the scanline kernel of a ROP3 code
+	 *
+	 * @param code the ROP3 index, bits 16 to 23 of the raster operation
+	 *
+	 * @return the kernel, never \b NULL
+	 */
+	FREERDP_LOCAL pGdiRop3Row gdi_get_rop3_row(BYTE code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_LIB_GDI_ROP3_H */
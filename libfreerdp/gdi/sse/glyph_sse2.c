@@ -0,0 +1,115 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Glyph Atlas - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "glyph_sse2.h"
+
+#include "../../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <winpr/sysinfo.h>
+
+#include <emmintrin.h>
+
+/* the mask bytes are 0x00 or 0xFF, widened they select whole pixels */
+static INLINE void glyph_blend_sse2(BYTE* WINPR_RESTRICT pDst, __m128i mask, __m128i color)
+{
+	const __m128i d = _mm_loadu_si128((const __m128i*)pDst);
+	const __m128i r = _mm_or_si128(_mm_and_si128(mask, color), _mm_andnot_si128(mask, d));
+	_mm_storeu_si128((__m128i*)pDst, r);
+}
+
+static void gdi_glyph_row_sse2_2(BYTE* WINPR_RESTRICT pDst, const BYTE* WINPR_RESTRICT pMask,
+                                 const BYTE* WINPR_RESTRICT pColor, size_t width)
+{
+	UINT16 value = 0;
+	size_t x = 0;
+
+	memcpy(&value, pColor, sizeof(value));
+	const __m128i color = _mm_set1_epi16((short)value);
+
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i m = _mm_loadu_si128((const __m128i*)&pMask[x]);
+
+		/* most of a glyph box is empty */
+		if (_mm_movemask_epi8(m) == 0)
+			continue;
+
+		glyph_blend_sse2(&pDst[2 * x], _mm_unpacklo_epi8(m, m), color);
+		glyph_blend_sse2(&pDst[2 * x + 16], _mm_unpackhi_epi8(m, m), color);
+	}
+
+	for (; x < width; x++)
+	{
+		if (pMask[x])
+			memcpy(&pDst[2 * x], pColor, 2);
+	}
+}
+
+static void gdi_glyph_row_sse2_4(BYTE* WINPR_RESTRICT pDst, const BYTE* WINPR_RESTRICT pMask,
+                                 const BYTE* WINPR_RESTRICT pColor, size_t width)
+{
+	UINT32 value = 0;
+	size_t x = 0;
+
+	memcpy(&value, pColor, sizeof(value));
+	const __m128i color = _mm_set1_epi32((int)value);
+
+	for (; x + 16 <= width; x += 16)
+	{
+		const __m128i m = _mm_loadu_si128((const __m128i*)&pMask[x]);
+
+		if (_mm_movemask_epi8(m) == 0)
+			continue;
+
+		const __m128i lo = _mm_unpacklo_epi8(m, m);
+		const __m128i hi = _mm_unpackhi_epi8(m, m);
+		glyph_blend_sse2(&pDst[4 * x], _mm_unpacklo_epi16(lo, lo), color);
+		glyph_blend_sse2(&pDst[4 * x + 16], _mm_unpackhi_epi16(lo, lo), color);
+		glyph_blend_sse2(&pDst[4 * x + 32], _mm_unpacklo_epi16(hi, hi), color);
+		glyph_blend_sse2(&pDst[4 * x + 48], _mm_unpackhi_epi16(hi, hi), color);
+	}
+
+	for (; x < width; x++)
+	{
+		if (pMask[x])
+			memcpy(&pDst[4 * x], pColor, 4);
+	}
+}
+#endif
+
+void gdi_glyph_init_sse2(pGdiGlyphRow rows[5])
+{
+	WINPR_ASSERT(rows);
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	if (!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	/* 24bpp keeps the generic kernel */
+	rows[2] = gdi_glyph_row_sse2_2;
+	rows[4] = gdi_glyph_row_sse2_4;
+#else
+	WINPR_UNUSED(rows);
+#endif
+}
@@ -0,0 +1,115 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * GDI Ternary Raster Operation Kernels - SSE2 Optimizations
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/assert.h>
+#include <winpr/platform.h>
+#include <freerdp/config.h>
+
+#include "rop3_sse2.h"
+
+#include "../../core/simd.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <winpr/sysinfo.h>
+
+#include <emmintrin.h>
+
+#define GDI_ROP3_AND_SSE2(a, b) _mm_and_si128((a), (b))
+#define GDI_ROP3_OR_SSE2(a, b) _mm_or_si128((a), (b))
+#define GDI_ROP3_XOR_SSE2(a, b) _mm_xor_si128((a), (b))
+#define GDI_ROP3_NOT_SSE2(a) _mm_xor_si128((a), _mm_set1_epi32(-1))
+
+#define GDI_ROP3_AND(a, b) ((a) & (b))
+#define GDI_ROP3_OR(a, b) ((a) | (b))
+#define GDI_ROP3_XOR(a, b) ((a) ^ (b))
+#define GDI_ROP3_NOT(a) (~(a))
+
+/* 64 bytes per iteration, the tail is done bytewise */
+#define GDI_ROP3_ROW_SSE2(code)                                                               \
+	static void gdi_rop3_row_sse2_##code(BYTE* WINPR_RESTRICT pDst,                           \
+	                                     const BYTE* WINPR_RESTRICT pSrc,                     \
+	                                     const BYTE* WINPR_RESTRICT pPat, size_t size)        \
+	{                                                                                         \
+		size_t x = 0;                                                                         \
+                                                                                              \
+		for (; x + 64 <= size; x += 64)                                                       \
+		{                                                                                     \
+			for (size_t y = 0; y < 64; y += 16)                                               \
+			{                                                                                 \
+				const __m128i d = _mm_loadu_si128((const __m128i*)&pDst[x + y]);              \
+				__m128i s = _mm_setzero_si128();                                              \
+				__m128i p = _mm_setzero_si128();                                              \
+                                                                                              \
+				if (GDI_ROP3_USES_SRC(code))                                                  \
+					s = _mm_loadu_si128((const __m128i*)&pSrc[x + y]);                        \
+				if (GDI_ROP3_USES_PAT(code))                                                  \
+					p = _mm_loadu_si128((const __m128i*)&pPat[x + y]);                        \
+                                                                                              \
+				_mm_storeu_si128((__m128i*)&pDst[x + y],                                      \
+				                 GDI_ROP3(code, p, s, d, GDI_ROP3_AND_SSE2, GDI_ROP3_OR_SSE2, \
+				                          GDI_ROP3_XOR_SSE2, GDI_ROP3_NOT_SSE2));             \
+			}                                                                                 \
+		}                                                                                     \
+                                                                                              \
+		for (; x + 16 <= size; x += 16)                                                       \
+		{                                                                                     \
+			const __m128i d = _mm_loadu_si128((const __m128i*)&pDst[x]);                      \
+			__m128i s = _mm_setzero_si128();                                                  \
+			__m128i p = _mm_setzero_si128();                                                  \
+                                                                                              \
+			if (GDI_ROP3_USES_SRC(code))                                                      \
+				s = _mm_loadu_si128((const __m128i*)&pSrc[x]);                                \
+			if (GDI_ROP3_USES_PAT(code))                                                      \
+				p = _mm_loadu_si128((const __m128i*)&pPat[x]);                                \
+                                                                                              \
+			_mm_storeu_si128((__m128i*)&pDst[x],                                              \
+			                 GDI_ROP3(code, p, s, d, GDI_ROP3_AND_SSE2, GDI_ROP3_OR_SSE2,     \
+			                          GDI_ROP3_XOR_SSE2, GDI_ROP3_NOT_SSE2));                 \
+		}                                                                                     \
+                                                                                              \
+		for (; x < size; x++)                                                                 \
+		{                                                                                     \
+			const UINT32 d = pDst[x];                                                         \
+			const UINT32 s = GDI_ROP3_USES_SRC(code) ? pSrc[x] : 0;                           \
+			const UINT32 p = GDI_ROP3_USES_PAT(code) ? pPat[x] : 0;                           \
+                                                                                              \
+			pDst[x] = (BYTE)GDI_ROP3(code, p, s, d, GDI_ROP3_AND, GDI_ROP3_OR, GDI_ROP3_XOR,  \
+			                         GDI_ROP3_NOT);                                           \
+		}                                                                                     \
+	}
+
+GDI_ROP3_EXPAND256(GDI_ROP3_ROW_SSE2)
+
+#define GDI_ROP3_ENTRY_SSE2(code) gdi_rop3_row_sse2_##code,
+
+static const pGdiRop3Row gdi_rop3_rows_sse2[256] = { GDI_ROP3_EXPAND256(GDI_ROP3_ENTRY_SSE2) };
+#endif
+
+void gdi_rop3_init_sse2(pGdiRop3Row rows[256])
+{
+	WINPR_ASSERT(rows);
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	if (!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+		return;
+
+	for (size_t x = 0; x < 256; x++)
+		rows[x] = gdi_rop3_rows_sse2[x];
+#else
+	WINPR_UNUSED(rows);
+#endif
+}
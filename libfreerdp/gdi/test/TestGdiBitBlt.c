@@ -7,6 +7,7 @@
 #include <freerdp/gdi/bitmap.h>
 
 #include <winpr/crt.h>
+#include <winpr/crypto.h>
 
 #include "line.h"
 #include "brush.h"
@@ -546,6 +547,123 @@ fail:
 	return rc;
 }
 
+/* Evaluates a ROP3 code as a truth table, bit (P << 2) | (S << 1) | D of the code */
+static UINT32 test_rop3_reference(BYTE code, UINT32 pat, UINT32 src, UINT32 dst)
+{
+	UINT32 result = 0;
+
+	for (UINT32 x = 0; x < 8; x++)
+	{
+		if ((code & (1u << x)) == 0)
+			continue;
+
+		result |= ((x & 4) ? pat : ~pat) & ((x & 2) ? src : ~src) & ((x & 1) ? dst : ~dst);
+	}
+
+	return result;
+}
+
+static BOOL test_gdi_BitBlt_rop3(UINT32 format, BOOL patternBrush)
+{
+	BOOL rc = FALSE;
+	const INT32 width = 45;
+	const INT32 height = 13;
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(format);
+	const size_t size = 1ull * bpp * (size_t)width * (size_t)height;
+	HGDI_DC hdcSrc = gdi_GetDC();
+	HGDI_DC hdcDst = gdi_GetDC();
+	HGDI_BITMAP hBmpSrc = gdi_CreateBitmap(width, height, format, winpr_aligned_malloc(size, 16));
+	HGDI_BITMAP hBmpDst = gdi_CreateBitmap(width, height, format, winpr_aligned_malloc(size, 16));
+	HGDI_BITMAP hBmpPat = gdi_CreateBitmap(8, 8, format, winpr_aligned_malloc(64ull * bpp, 16));
+	HGDI_BRUSH brush = NULL;
+	BYTE* original = malloc(size);
+
+	if (!hdcSrc || !hdcDst || !hBmpSrc || !hBmpDst || !hBmpPat || !original)
+		goto fail;
+
+	if (!hBmpSrc->data || !hBmpDst->data || !hBmpPat->data)
+		goto fail;
+
+	hdcSrc->format = format;
+	hdcDst->format = format;
+	winpr_RAND(hBmpSrc->data, size);
+	winpr_RAND(original, size);
+	winpr_RAND(hBmpPat->data, 64ull * bpp);
+
+	brush = patternBrush ? gdi_CreatePatternBrush(hBmpPat) : gdi_CreateSolidBrush(0x5AC3A53C);
+	if (!brush)
+		goto fail;
+
+	gdi_SelectObject(hdcSrc, (HGDIOBJECT)hBmpSrc);
+	gdi_SelectObject(hdcDst, (HGDIOBJECT)hBmpDst);
+	gdi_SelectObject(hdcDst, (HGDIOBJECT)brush);
+
+	/* BLACKNESS and WHITENESS write opaque colors, SRCCOPY and DSTCOPY are plain image copies,
+	 * these are covered above */
+	for (UINT32 code = 0x01; code < 0xFF; code++)
+	{
+		const DWORD rop = gdi_rop3_code((BYTE)code);
+
+		if ((rop == GDI_SRCCOPY) || (rop == GDI_DSTCOPY))
+			continue;
+
+		memcpy(hBmpDst->data, original, size);
+
+		if (!gdi_BitBlt(hdcDst, 3, 2, width - 5, height - 3, hdcSrc, 1, 0, rop, NULL))
+			goto fail;
+
+		for (INT32 y = 0; y < height; y++)
+		{
+			for (INT32 x = 0; x < width; x++)
+			{
+				const size_t offset = 1ull * bpp * (size_t)(y * width + x);
+				BYTE pixel[4] = { 0 };
+
+				memcpy(pixel, &original[offset], bpp);
+
+				if ((x >= 3) && (x < width - 2) && (y >= 2) && (y < height - 1))
+				{
+					const UINT32 dst = FreeRDPReadColor(&original[offset], format);
+					const UINT32 src =
+					    FreeRDPReadColor(&hBmpSrc->data[offset - 2ull * bpp * width - 2ull * bpp],
+					                     format);
+					UINT32 pat = brush->color;
+
+					if (patternBrush)
+						pat = FreeRDPReadColor(
+						    &hBmpPat->data[1ull * bpp * (size_t)((y % 8) * 8 + (x % 8))], format);
+
+					if (!FreeRDPWriteColor(pixel, format,
+					                       test_rop3_reference((BYTE)code, pat, src, dst)))
+						goto fail;
+				}
+
+				if (memcmp(pixel, &hBmpDst->data[offset], bpp) != 0)
+				{
+					(void)fprintf(stderr,
+					              "[%s] %s %s brush ROP=%s mismatch at %" PRId32 "x%" PRId32 "\n",
+					              __func__, FreeRDPGetColorFormatName(format),
+					              patternBrush ? "pattern" : "solid",
+					              gdi_rop3_code_string((BYTE)code), x, y);
+					goto fail;
+				}
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	gdi_SelectObject(hdcDst, NULL);
+	gdi_DeleteObject((HGDIOBJECT)brush);
+	gdi_DeleteObject((HGDIOBJECT)hBmpPat);
+	gdi_DeleteObject((HGDIOBJECT)hBmpSrc);
+	gdi_DeleteObject((HGDIOBJECT)hBmpDst);
+	gdi_DeleteDC(hdcSrc);
+	gdi_DeleteDC(hdcDst);
+	free(original);
+	return rc;
+}
+
 int TestGdiBitBlt(int argc, char* argv[])
 {
 	int rc = 0;
@@ -573,5 +691,13 @@ int TestGdiBitBlt(int argc, char* argv[])
 		}
 	}
 
+	/* All ternary raster operations against a per pixel evaluation of their truth table */
+	for (size_t x = 1; x < ARRAYSIZE(formatList); x++)
+	{
+		if (!test_gdi_BitBlt_rop3(formatList[x], FALSE) ||
+		    !test_gdi_BitBlt_rop3(formatList[x], TRUE))
+			rc = -1;
+	}
+
 	return rc;
 }
@@ -0,0 +1,159 @@
+#include <stdio.h>
+
+#include <winpr/crypto.h>
+
+#include <freerdp/codec/color.h>
+
+#include "../gfx_cache.h"
+
+static gdiGfxCacheEntry* test_entry_fill(gdiGfxCachePool* pool, UINT64 key, UINT32 width,
+                                         UINT32 height, const BYTE* src)
+{
+	gdiGfxCacheEntry* entry =
+	    gdi_gfx_cache_entry_new(pool, key, width, height, PIXEL_FORMAT_BGRX32);
+	if (!entry || !entry->data)
+		goto fail;
+
+	if (!freerdp_image_copy_no_overlap(entry->data, entry->format, entry->scanline, 0, 0, width,
+	                                   height, src, PIXEL_FORMAT_BGRX32, width * 4, 0, 0, NULL,
+	                                   FREERDP_FLIP_NONE))
+		goto fail;
+
+	if (!gdi_gfx_cache_entry_publish(entry))
+		goto fail;
+	return entry;
+
+fail:
+	gdi_gfx_cache_entry_free(entry);
+	return NULL;
+}
+
+static BOOL test_share(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 width = 64;
+	const UINT32 height = 64;
+	BYTE tile[64 * 64 * 4] = { 0 };
+	BYTE other[64 * 64 * 4] = { 0 };
+	gdiGfxCacheEntry* a = NULL;
+	gdiGfxCacheEntry* b = NULL;
+	gdiGfxCacheEntry* c = NULL;
+	gdiGfxCacheEntry* d = NULL;
+	gdiGfxCachePoolStats stats = { 0 };
+	gdiGfxCachePool* pool = gdi_gfx_cache_pool_new();
+
+	if (!pool)
+		goto fail;
+
+	winpr_RAND(tile, sizeof(tile));
+	memcpy(other, tile, sizeof(other));
+	other[sizeof(other) - 1] ^= 0x01;
+
+	a = test_entry_fill(pool, 0x1234, width, height, tile);
+	if (!a)
+		goto fail;
+
+	/* equal key and content: the buffer is shared */
+	b = gdi_gfx_cache_entry_share(pool, 0x1234, width, height, PIXEL_FORMAT_BGRX32, tile,
+	                              width * 4);
+	if (!b || (b->data != a->data) || (b->width != width) || (b->height != height))
+		goto fail;
+
+	/* equal key but different content or size: no sharing */
+	if (gdi_gfx_cache_entry_share(pool, 0x1234, width, height, PIXEL_FORMAT_BGRX32, other,
+	                              width * 4))
+		goto fail;
+	if (gdi_gfx_cache_entry_share(pool, 0x1234, width, height - 1, PIXEL_FORMAT_BGRX32, tile,
+	                              width * 4))
+		goto fail;
+	if (gdi_gfx_cache_entry_share(pool, 0x4321, width, height, PIXEL_FORMAT_BGRX32, tile,
+	                              width * 4))
+		goto fail;
+
+	/* a shared buffer outlives the entry it was created for */
+	gdi_gfx_cache_entry_free(a);
+	a = NULL;
+	if (memcmp(b->data, tile, width * 4) != 0)
+		goto fail;
+
+	c = gdi_gfx_cache_entry_share(pool, 0x1234, width, height, PIXEL_FORMAT_BGRX32, tile,
+	                              width * 4);
+	if (!c || (c->data != b->data))
+		goto fail;
+
+	gdi_gfx_cache_entry_free(b);
+	gdi_gfx_cache_entry_free(c);
+	b = NULL;
+	c = NULL;
+
+	/* the last reference is gone, the key is no longer known and the buffer is recycled */
+	if (gdi_gfx_cache_entry_share(pool, 0x1234, width, height, PIXEL_FORMAT_BGRX32, tile,
+	                              width * 4))
+		goto fail;
+
+	d = test_entry_fill(pool, 0x5678, width, height, other);
+	if (!d)
+		goto fail;
+
+	gdi_gfx_cache_pool_stats(pool, &stats);
+	if ((stats.allocations != 1) || (stats.recycled != 1) || (stats.shared != 2))
+	{
+		printf("unexpected stats: %" PRIuz " allocations, %" PRIuz " recycled, %" PRIuz
+		       " shared\n",
+		       stats.allocations, stats.recycled, stats.shared);
+		goto fail;
+	}
+
+	/* entries may be released after the pool */
+	gdi_gfx_cache_pool_free(pool);
+	pool = NULL;
+	gdi_gfx_cache_entry_free(d);
+	d = NULL;
+
+	rc = TRUE;
+fail:
+	gdi_gfx_cache_entry_free(a);
+	gdi_gfx_cache_entry_free(b);
+	gdi_gfx_cache_entry_free(c);
+	gdi_gfx_cache_entry_free(d);
+	gdi_gfx_cache_pool_free(pool);
+	return rc;
+}
+
+static BOOL test_empty(void)
+{
+	BOOL rc = FALSE;
+	gdiGfxCachePool* pool = gdi_gfx_cache_pool_new();
+	gdiGfxCacheEntry* entry = NULL;
+
+	if (!pool)
+		goto fail;
+
+	/* CacheImportReply placeholders have no pixels */
+	entry = gdi_gfx_cache_entry_new(pool, 23, 0, 0, PIXEL_FORMAT_BGRX32);
+	if (!entry || entry->data || (entry->cacheKey != 23))
+		goto fail;
+
+	if (!gdi_gfx_cache_entry_publish(entry))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	gdi_gfx_cache_entry_free(entry);
+	gdi_gfx_cache_pool_free(pool);
+	return rc;
+}
+
+int TestGdiGfxCache(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_share())
+		return -1;
+
+	if (!test_empty())
+		return -1;
+
+	return 0;
+}
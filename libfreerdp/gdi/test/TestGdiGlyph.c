@@ -0,0 +1,323 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/crypto.h>
+
+#include <freerdp/codec/color.h>
+#include <freerdp/gdi/gdi.h>
+#include <freerdp/gdi/dc.h>
+#include <freerdp/gdi/shape.h>
+#include <freerdp/gdi/bitmap.h>
+
+#include "../brush.h"
+#include "../drawing.h"
+#include "../glyph_atlas.h"
+
+#define TEST_WIDTH 67
+#define TEST_HEIGHT 29
+#define TEST_GLYPHS 24
+
+typedef struct
+{
+	UINT32 cx;
+	UINT32 cy;
+	BYTE aj[2560];
+	size_t cb;
+	BYTE* mask;
+	HGDI_DC hdc;
+} TestGlyph;
+
+typedef struct
+{
+	size_t glyph;
+	INT32 x;
+	INT32 y;
+	INT32 w;
+	INT32 h;
+	INT32 sx;
+	INT32 sy;
+	BOOL fill;
+} TestGlyphDraw;
+
+static HGDI_DC test_dc_new(UINT32 format, BYTE* data, UINT32 width, UINT32 height)
+{
+	HGDI_DC hdc = gdi_GetDC();
+	if (!hdc)
+		return NULL;
+
+	hdc->format = format;
+	HGDI_BITMAP bmp = gdi_CreateBitmapEx(width, height, format, 0, data, NULL);
+	if (!bmp)
+	{
+		gdi_DeleteDC(hdc);
+		return NULL;
+	}
+
+	gdi_SelectObject(hdc, (HGDIOBJECT)bmp);
+	return hdc;
+}
+
+static void test_dc_free(HGDI_DC hdc)
+{
+	if (!hdc)
+		return;
+
+	gdi_DeleteObject(hdc->selectedObject);
+	gdi_DeleteDC(hdc);
+}
+
+static INT32 test_rand(INT32 min, INT32 max)
+{
+	UINT32 value = 0;
+	winpr_RAND(&value, sizeof(value));
+	return min + (INT32)(value % (UINT32)(max - min + 1));
+}
+
+static GDI_RECT test_fill_rect(const TestGlyphDraw* draw)
+{
+	GDI_RECT rect = { 0 };
+
+	/* the background rectangle of gdi_Glyph_Draw */
+	if (draw->x > 0)
+		rect.left = draw->x;
+	if (draw->y > 0)
+		rect.top = draw->y;
+	if (draw->x + draw->w > 0)
+		rect.right = draw->x + draw->w - 1;
+	if (draw->y + draw->h > 0)
+		rect.bottom = draw->y + draw->h - 1;
+	return rect;
+}
+
+static BOOL test_reference(HGDI_DC hdc, const TestGlyph* glyphs, const TestGlyphDraw* draws,
+                           size_t count)
+{
+	for (size_t x = 0; x < count; x++)
+	{
+		const TestGlyphDraw* draw = &draws[x];
+		GDI_RECT rect = test_fill_rect(draw);
+
+		if (draw->fill && (rect.left < rect.right) && (rect.top < rect.bottom))
+		{
+			HGDI_BRUSH brush = gdi_CreateSolidBrush(hdc->bkColor);
+			if (!brush)
+				return FALSE;
+			gdi_FillRect(hdc, &rect, brush);
+			gdi_DeleteObject((HGDIOBJECT)brush);
+		}
+
+		HGDI_BRUSH brush = gdi_CreateSolidBrush(hdc->textColor);
+		if (!brush)
+			return FALSE;
+
+		gdi_SelectObject(hdc, (HGDIOBJECT)brush);
+		const BOOL rc = gdi_BitBlt(hdc, draw->x, draw->y, draw->w, draw->h,
+		                           glyphs[draw->glyph].hdc, draw->sx, draw->sy, GDI_GLYPH_ORDER,
+		                           NULL);
+		hdc->brush = NULL;
+		gdi_DeleteObject((HGDIOBJECT)brush);
+		if (!rc)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL test_atlas(gdiGlyphAtlas* atlas, HGDI_DC hdc, const TestGlyph* glyphs,
+                       const TestGlyphDraw* draws, size_t count)
+{
+	gdi_glyph_atlas_begin_run(atlas);
+
+	for (size_t x = 0; x < count; x++)
+	{
+		const TestGlyphDraw* draw = &draws[x];
+		const TestGlyph* glyph = &glyphs[draw->glyph];
+		GDI_RECT rect = test_fill_rect(draw);
+		const BOOL fill = draw->fill && (rect.left < rect.right) && (rect.top < rect.bottom);
+
+		if (!gdi_glyph_atlas_draw(atlas, hdc, glyph->mask, glyph->cx, glyph->cy, draw->x, draw->y,
+		                          draw->w, draw->h, draw->sx, draw->sy, fill ? &rect : NULL))
+			return FALSE;
+	}
+
+	return gdi_glyph_atlas_end_run(atlas);
+}
+
+static BOOL test_format(gdiGlyphAtlas* atlas, const TestGlyph* glyphs, size_t glyphCount,
+                        UINT32 format)
+{
+	BOOL rc = FALSE;
+	const size_t size = 1ull * TEST_WIDTH * TEST_HEIGHT * FreeRDPGetBytesPerPixel(format);
+	BYTE* expected = calloc(1, size);
+	BYTE* actual = calloc(1, size);
+	HGDI_DC hdcExpected = NULL;
+	HGDI_DC hdcActual = NULL;
+	TestGlyphDraw draws[64] = { 0 };
+
+	if (!expected || !actual)
+		goto fail;
+
+	winpr_RAND(expected, size);
+	memcpy(actual, expected, size);
+
+	hdcExpected = test_dc_new(format, expected, TEST_WIDTH, TEST_HEIGHT);
+	hdcActual = test_dc_new(format, actual, TEST_WIDTH, TEST_HEIGHT);
+	if (!hdcExpected || !hdcActual)
+		goto fail;
+
+	const UINT32 textColor = FreeRDPGetColor(format, 0x12, 0xA5, 0x7E, 0xFF);
+	const UINT32 bkColor = FreeRDPGetColor(format, 0xC3, 0x31, 0x90, 0xFF);
+	gdi_SetTextColor(hdcExpected, textColor);
+	gdi_SetTextColor(hdcActual, textColor);
+	gdi_SetBkColor(hdcExpected, bkColor);
+	gdi_SetBkColor(hdcActual, bkColor);
+
+	/* glyphs overlapping each other and the edges, some with a source offset */
+	for (size_t x = 0; x < ARRAYSIZE(draws); x++)
+	{
+		TestGlyphDraw* draw = &draws[x];
+		const TestGlyph* glyph = NULL;
+
+		draw->glyph = (size_t)test_rand(0, (INT32)glyphCount - 1);
+		glyph = &glyphs[draw->glyph];
+		draw->x = test_rand(-20, TEST_WIDTH - 1);
+		draw->y = test_rand(-20, TEST_HEIGHT - 1);
+		draw->sx = test_rand(-2, 3);
+		draw->sy = test_rand(-2, 3);
+		draw->w = (INT32)glyph->cx - MAX(draw->sx, 0);
+		draw->h = (INT32)glyph->cy - MAX(draw->sy, 0);
+		draw->fill = (x % 3) == 0;
+	}
+
+	if (!test_reference(hdcExpected, glyphs, draws, ARRAYSIZE(draws)) ||
+	    !test_atlas(atlas, hdcActual, glyphs, draws, ARRAYSIZE(draws)))
+	{
+		printf("%s: drawing failed\n", FreeRDPGetColorFormatName(format));
+		goto fail;
+	}
+
+	if (memcmp(expected, actual, size) != 0)
+	{
+		printf("%s: atlas output differs from gdi_BitBlt\n", FreeRDPGetColorFormatName(format));
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	test_dc_free(hdcExpected);
+	test_dc_free(hdcActual);
+	free(expected);
+	free(actual);
+	return rc;
+}
+
+static BOOL test_kernels(void)
+{
+	BYTE mask[77] = { 0 };
+	BYTE expected[77 * 4] = { 0 };
+	BYTE actual[77 * 4] = { 0 };
+	const BYTE color[4] = { 0x11, 0x22, 0x33, 0x44 };
+
+	for (UINT32 bpp = 2; bpp <= 4; bpp++)
+	{
+		const pGdiGlyphRow kernel = gdi_get_glyph_row(bpp);
+		if (!kernel)
+			return FALSE;
+
+		for (size_t x = 0; x < ARRAYSIZE(mask); x++)
+			mask[x] = (x % 5 == 0) || (x > 40 && x < 60) ? 0xFF : 0x00;
+		memset(&mask[16], 0, 16); /* an empty block */
+
+		winpr_RAND(expected, sizeof(expected));
+		memcpy(actual, expected, sizeof(actual));
+		for (size_t x = 0; x < ARRAYSIZE(mask); x++)
+		{
+			if (mask[x])
+				memcpy(&expected[x * bpp], color, bpp);
+		}
+
+		kernel(actual, mask, color, ARRAYSIZE(mask));
+		if (memcmp(expected, actual, sizeof(actual)) != 0)
+		{
+			printf("glyph kernel for %" PRIu32 " bytes per pixel differs\n", bpp);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+int TestGdiGlyph(int argc, char* argv[])
+{
+	int rc = -1;
+	TestGlyph glyphs[TEST_GLYPHS] = { 0 };
+	const UINT32 formats[] = { PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRX32, PIXEL_FORMAT_RGBA32,
+		                       PIXEL_FORMAT_BGR24,  PIXEL_FORMAT_RGB16,  PIXEL_FORMAT_ARGB15 };
+	gdiGlyphAtlas* atlas = gdi_glyph_atlas_new();
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!atlas || !test_kernels())
+		goto fail;
+
+	for (size_t x = 0; x < ARRAYSIZE(glyphs); x++)
+	{
+		TestGlyph* glyph = &glyphs[x];
+
+		/* the last glyph is too big for the pages */
+		glyph->cx = (x + 1 == ARRAYSIZE(glyphs)) ? 200 : (UINT32)test_rand(1, 64);
+		glyph->cy = (x + 1 == ARRAYSIZE(glyphs)) ? 100 : (UINT32)test_rand(1, 40);
+		glyph->cb = ((glyph->cx + 7) / 8) * glyph->cy;
+		winpr_RAND(glyph->aj, glyph->cb);
+
+		glyph->mask = gdi_glyph_atlas_store(atlas, glyph->cx, glyph->cy, glyph->aj, glyph->cb);
+		glyph->hdc = gdi_GetDC();
+		if (!glyph->mask || !glyph->hdc)
+			goto fail;
+
+		glyph->hdc->format = PIXEL_FORMAT_MONO;
+		BYTE* data = freerdp_glyph_convert(glyph->cx, glyph->cy, glyph->aj);
+		HGDI_BITMAP bmp = gdi_CreateBitmap(glyph->cx, glyph->cy, PIXEL_FORMAT_MONO, data);
+		if (!bmp)
+		{
+			winpr_aligned_free(data);
+			goto fail;
+		}
+		gdi_SelectObject(glyph->hdc, (HGDIOBJECT)bmp);
+
+		if (memcmp(glyph->mask, data, 1ull * glyph->cx * glyph->cy) != 0)
+		{
+			printf("glyph %" PRIuz " mask differs from freerdp_glyph_convert\n", x);
+			goto fail;
+		}
+	}
+
+	if (gdi_glyph_atlas_store(atlas, 9, 2, glyphs[0].aj, 3))
+	{
+		printf("a short glyph was accepted\n");
+		goto fail;
+	}
+
+	if (gdi_get_glyph_row(1))
+	{
+		printf("8bpp must use gdi_BitBlt\n");
+		goto fail;
+	}
+
+	for (size_t x = 0; x < ARRAYSIZE(formats); x++)
+	{
+		if (!test_format(atlas, glyphs, ARRAYSIZE(glyphs), formats[x]))
+			goto fail;
+	}
+
+	rc = 0;
+fail:
+	for (size_t x = 0; x < ARRAYSIZE(glyphs); x++)
+	{
+		gdi_glyph_atlas_release(atlas, glyphs[x].mask, glyphs[x].cx, glyphs[x].cy);
+		test_dc_free(glyphs[x].hdc);
+	}
+	gdi_glyph_atlas_free(atlas);
+	return rc;
+}
@@ -0,0 +1,72 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Optimized compare operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#include "prim_internal.h"
+#include "prim_compare.h"
+
+#if defined(NEON_INTRINSICS_ENABLED)
+#include <arm_neon.h>
+
+/* ------------------------------------------------------------------------- */
+static BOOL neon_bytes_equal(const BYTE* WINPR_RESTRICT pSrc1, const BYTE* WINPR_RESTRICT pSrc2,
+                             size_t len)
+{
+	uint8x16_t diff = vdupq_n_u8(0);
+	size_t x = 0;
+
+	for (; x + 16 <= len; x += 16)
+	{
+		const uint8x16_t a = vld1q_u8(&pSrc1[x]);
+		const uint8x16_t b = vld1q_u8(&pSrc2[x]);
+		diff = vorrq_u8(diff, veorq_u8(a, b));
+	}
+
+	const uint64x2_t diff64 = vreinterpretq_u64_u8(diff);
+	if ((vgetq_lane_u64(diff64, 0) | vgetq_lane_u64(diff64, 1)) != 0)
+		return FALSE;
+
+	return memcmp(&pSrc1[x], &pSrc2[x], len - x) == 0;
+}
+
+static pstatus_t neon_compare_tiles(const BYTE* WINPR_RESTRICT pSrc1, UINT32 src1Step,
+                                    const BYTE* WINPR_RESTRICT pSrc2, UINT32 src2Step,
+                                    UINT32 width, UINT32 height, UINT32 bpp, UINT32 tileSize,
+                                    BYTE* WINPR_RESTRICT pMask, UINT32 maskStep)
+{
+	return prim_compare_tiles(pSrc1, src1Step, pSrc2, src2Step, width, height, bpp, tileSize,
+	                          pMask, maskStep, neon_bytes_equal);
+}
+#endif /* NEON_INTRINSICS_ENABLED */
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_compare_neon(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(NEON_INTRINSICS_ENABLED)
+	if (IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+	{
+		WLog_VRB(PRIM_TAG, "NEON optimizations");
+		prims->compare_tiles = neon_compare_tiles;
+	}
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or neon intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
@@ -0,0 +1,242 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Optimized planar codec operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#include "prim_internal.h"
+#include "prim_planar.h"
+
+#if defined(NEON_INTRINSICS_ENABLED)
+#include <arm_neon.h>
+
+static primitives_t* generic = NULL;
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t neon_planar_split(const BYTE* WINPR_RESTRICT pSrc, UINT32 SrcFormat,
+                                   INT32 srcStep, BYTE* WINPR_RESTRICT pDst[4], UINT32 dstStep,
+                                   UINT32 width, UINT32 height)
+{
+	prim_planar_layout layout = { 0 };
+
+	if (!pSrc || !pDst || !prim_planar_get_layout(SrcFormat, &layout))
+		return generic->planar_split(pSrc, SrcFormat, srcStep, pDst, dstStep, width, height);
+
+	const size_t first = layout.readAlpha ? 0 : 1;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* src = &pSrc[1ll * y * srcStep];
+		BYTE* dst[4] = { &pDst[0][1ull * y * dstStep], &pDst[1][1ull * y * dstStep],
+			             &pDst[2][1ull * y * dstStep], &pDst[3][1ull * y * dstStep] };
+		UINT32 x = 0;
+
+		for (; x + 16 <= width; x += 16)
+		{
+			const uint8x16x4_t px = vld4q_u8(&src[4ull * x]);
+
+			for (size_t c = first; c < 4; c++)
+				vst1q_u8(&dst[c][x], px.val[layout.offsets[c]]);
+		}
+
+		for (; x < width; x++)
+		{
+			for (size_t c = first; c < 4; c++)
+				dst[c][x] = src[4ull * x + layout.offsets[c]];
+		}
+
+		if (!layout.readAlpha)
+			memset(dst[0], 0xFF, width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t neon_planar_merge(const BYTE* WINPR_RESTRICT pSrc[4], UINT32 srcStep,
+                                   BYTE* WINPR_RESTRICT pDst, UINT32 DstFormat, INT32 dstStep,
+                                   UINT32 width, UINT32 height)
+{
+	prim_planar_layout layout = { 0 };
+
+	if (!pSrc || !pDst || !prim_planar_get_layout(DstFormat, &layout))
+		return generic->planar_merge(pSrc, srcStep, pDst, DstFormat, dstStep, width, height);
+
+	const BYTE fill = layout.writeAlpha ? 0xFF : 0x00;
+	const BOOL withAlpha = layout.writeAlpha && pSrc[0];
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* src[4] = { withAlpha ? &pSrc[0][1ull * y * srcStep] : NULL,
+			                   &pSrc[1][1ull * y * srcStep], &pSrc[2][1ull * y * srcStep],
+			                   &pSrc[3][1ull * y * srcStep] };
+		BYTE* dst = &pDst[1ll * y * dstStep];
+		UINT32 x = 0;
+
+		for (; x + 16 <= width; x += 16)
+		{
+			uint8x16x4_t px;
+
+			for (size_t c = 0; c < 4; c++)
+				px.val[layout.offsets[c]] = src[c] ? vld1q_u8(&src[c][x]) : vdupq_n_u8(fill);
+
+			vst4q_u8(&dst[4ull * x], px);
+		}
+
+		for (; x < width; x++)
+		{
+			for (size_t c = 0; c < 4; c++)
+				dst[4ull * x + layout.offsets[c]] = src[c] ? src[c][x] : fill;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t neon_planar_delta_encode(const BYTE* WINPR_RESTRICT pSrc,
+                                          const BYTE* WINPR_RESTRICT pPrev,
+                                          BYTE* WINPR_RESTRICT pDst, UINT32 len)
+{
+	UINT32 x = 0;
+
+	for (; x + 16 <= len; x += 16)
+	{
+		const uint8x16_t delta = vsubq_u8(vld1q_u8(&pSrc[x]), vld1q_u8(&pPrev[x]));
+		const uint8x16_t sign = vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(delta), 7));
+		vst1q_u8(&pDst[x], veorq_u8(vshlq_n_u8(delta, 1), sign));
+	}
+
+	for (; x < len; x++)
+		pDst[x] = prim_planar_delta_encode_byte(pSrc[x], pPrev[x]);
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t neon_planar_delta_decode(const BYTE* WINPR_RESTRICT pPrev,
+                                          BYTE* WINPR_RESTRICT pSrcDst, UINT32 len)
+{
+	const uint8x16_t one = vdupq_n_u8(1);
+	UINT32 x = 0;
+
+	for (; x + 16 <= len; x += 16)
+	{
+		const uint8x16_t code = vld1q_u8(&pSrcDst[x]);
+		const int8x16_t odd = vreinterpretq_s8_u8(vandq_u8(code, one));
+		const uint8x16_t sign = vreinterpretq_u8_s8(vnegq_s8(odd));
+		const uint8x16_t delta = veorq_u8(vshrq_n_u8(code, 1), sign);
+		vst1q_u8(&pSrcDst[x], vaddq_u8(vld1q_u8(&pPrev[x]), delta));
+	}
+
+	for (; x < len; x++)
+		pSrcDst[x] = prim_planar_delta_decode_byte(pSrcDst[x], pPrev[x]);
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* a comparison result as 4 bits per lane, NEON has no movemask */
+static INLINE UINT64 neon_planar_mask(uint8x16_t eq)
+{
+	const uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+	return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+}
+
+static INLINE UINT32 neon_planar_first_lane(UINT64 mask)
+{
+	const UINT32 lo = (UINT32)mask;
+
+	if (lo)
+		return prim_planar_ctz(lo) / 4;
+	return 8 + prim_planar_ctz((UINT32)(mask >> 32)) / 4;
+}
+
+static void neon_planar_rle_scan(const BYTE* WINPR_RESTRICT pSrc, UINT32 len, BYTE symbol,
+                                 UINT32* WINPR_RESTRICT pRaw, UINT32* WINPR_RESTRICT pRun)
+{
+	UINT32 start = len;
+	UINT32 x = 1;
+
+	if ((len >= 3) && (pSrc[0] == symbol) && (pSrc[1] == symbol) && (pSrc[2] == symbol))
+		start = 0;
+	else
+	{
+		/* lane k is set if pSrc[x + k] equals its predecessor, a run starts where three
+		 * consecutive lanes are set. 16 lanes give 14 candidate positions. */
+		for (; x + 16 <= len; x += 14)
+		{
+			const uint8x16_t eq = vceqq_u8(vld1q_u8(&pSrc[x - 1]), vld1q_u8(&pSrc[x]));
+			const UINT64 m = neon_planar_mask(eq);
+			const UINT64 t = m & (m >> 4) & (m >> 8) & 0x00FFFFFFFFFFFFFFull;
+
+			if (t)
+			{
+				start = x + neon_planar_first_lane(t);
+				break;
+			}
+		}
+
+		if (start == len)
+			start = prim_planar_find_run(pSrc, x, len, symbol);
+	}
+
+	*pRaw = start;
+	*pRun = 0;
+
+	if (start == len)
+		return;
+
+	const BYTE value = (start > 0) ? pSrc[start - 1] : symbol;
+	const uint8x16_t v = vdupq_n_u8(value);
+	UINT32 end = start;
+
+	for (; end + 16 <= len; end += 16)
+	{
+		const UINT64 m = neon_planar_mask(vceqq_u8(vld1q_u8(&pSrc[end]), v));
+
+		if (m != UINT64_MAX)
+		{
+			*pRun = end + neon_planar_first_lane(~m) - start;
+			return;
+		}
+	}
+
+	*pRun = end + prim_planar_run_length(pSrc, end, len, value) - start;
+}
+#endif /* NEON_INTRINSICS_ENABLED */
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_planar_neon(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(NEON_INTRINSICS_ENABLED)
+	generic = primitives_get_generic();
+
+	if (IsProcessorFeaturePresent(PF_ARM_NEON_INSTRUCTIONS_AVAILABLE))
+	{
+		WLog_VRB(PRIM_TAG, "NEON optimizations");
+		prims->planar_split = neon_planar_split;
+		prims->planar_merge = neon_planar_merge;
+		prims->planar_delta_encode = neon_planar_delta_encode;
+		prims->planar_delta_decode = neon_planar_delta_decode;
+		prims->planar_rle_scan = neon_planar_rle_scan;
+	}
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or neon intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
@@ -0,0 +1,53 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Compare operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+
+#include "prim_internal.h"
+#include "prim_compare.h"
+
+/* ------------------------------------------------------------------------- */
+static BOOL general_bytes_equal(const BYTE* WINPR_RESTRICT pSrc1, const BYTE* WINPR_RESTRICT pSrc2,
+                                size_t len)
+{
+	return memcmp(pSrc1, pSrc2, len) == 0;
+}
+
+static pstatus_t general_compare_tiles(const BYTE* WINPR_RESTRICT pSrc1, UINT32 src1Step,
+                                       const BYTE* WINPR_RESTRICT pSrc2, UINT32 src2Step,
+                                       UINT32 width, UINT32 height, UINT32 bpp, UINT32 tileSize,
+                                       BYTE* WINPR_RESTRICT pMask, UINT32 maskStep)
+{
+	return prim_compare_tiles(pSrc1, src1Step, pSrc2, src2Step, width, height, bpp, tileSize,
+	                          pMask, maskStep, general_bytes_equal);
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_compare(primitives_t* WINPR_RESTRICT prims)
+{
+	prims->compare_tiles = general_compare_tiles;
+}
+
+void primitives_init_compare_opt(primitives_t* WINPR_RESTRICT prims)
+{
+	primitives_init_compare_sse2(prims);
+#if defined(WITH_AVX2)
+	primitives_init_compare_avx2(prims);
+#endif
+	primitives_init_compare_neon(prims);
+}
@@ -0,0 +1,91 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Primitives compare
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_PRIM_COMPARE_H
+#define FREERDP_LIB_PRIM_COMPARE_H
+
+#include <string.h>
+
+#include <winpr/wtypes.h>
+#include <freerdp/config.h>
+#include <freerdp/primitives.h>
+
+typedef BOOL (*prim_bytes_equal_t)(const BYTE* WINPR_RESTRICT pSrc1,
+                                   const BYTE* WINPR_RESTRICT pSrc2, size_t len);
+
+/* The images are walked scanline by scanline so both inputs are read sequentially.
+ * Tiles already known to differ are skipped for the remaining lines of a tile row. */
+static INLINE pstatus_t prim_compare_tiles(const BYTE* WINPR_RESTRICT pSrc1, UINT32 src1Step,
+                                           const BYTE* WINPR_RESTRICT pSrc2, UINT32 src2Step,
+                                           UINT32 width, UINT32 height, UINT32 bpp,
+                                           UINT32 tileSize, BYTE* WINPR_RESTRICT pMask,
+                                           UINT32 maskStep, prim_bytes_equal_t equal)
+{
+	if (!pSrc1 || !pSrc2 || !pMask || (bpp == 0) || (tileSize == 0))
+		return -1;
+
+	const size_t ncol = (1ull * width + tileSize - 1) / tileSize;
+	const size_t nrow = (1ull * height + tileSize - 1) / tileSize;
+	const size_t maskBytes = (ncol + 7) / 8;
+	const size_t tileBytes = 1ull * tileSize * bpp;
+	const size_t lineBytes = 1ull * width * bpp;
+
+	if (maskStep < maskBytes)
+		return -1;
+
+	for (size_t ty = 0; ty < nrow; ty++)
+	{
+		BYTE* mask = &pMask[ty * maskStep];
+		const size_t top = ty * tileSize;
+		const size_t bottom = MIN(top + tileSize, height);
+		size_t changed = 0;
+
+		memset(mask, 0, maskBytes);
+
+		for (size_t y = top; (y < bottom) && (changed < ncol); y++)
+		{
+			const BYTE* line1 = &pSrc1[y * src1Step];
+			const BYTE* line2 = &pSrc2[y * src2Step];
+
+			for (size_t tx = 0; tx < ncol; tx++)
+			{
+				const BYTE bit = (BYTE)(1u << (tx % 8));
+				const size_t offset = tx * tileBytes;
+
+				if (mask[tx / 8] & bit)
+					continue;
+
+				if (!equal(&line1[offset], &line2[offset], MIN(tileBytes, lineBytes - offset)))
+				{
+					mask[tx / 8] |= bit;
+					changed++;
+				}
+			}
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+void primitives_init_compare_sse2(primitives_t* WINPR_RESTRICT prims);
+void primitives_init_compare_neon(primitives_t* WINPR_RESTRICT prims);
+
+#if defined(WITH_AVX2)
+void primitives_init_compare_avx2(primitives_t* WINPR_RESTRICT prims);
+#endif
+
+#endif
@@ -295,6 +295,8 @@ FREERDP_LOCAL void primitives_init_shift(primitives_t* WINPR_RESTRICT prims);
 FREERDP_LOCAL void primitives_init_sign(primitives_t* WINPR_RESTRICT prims);
 FREERDP_LOCAL void primitives_init_alphaComp(primitives_t* WINPR_RESTRICT prims);
 FREERDP_LOCAL void primitives_init_colors(primitives_t* WINPR_RESTRICT prims);
+FREERDP_LOCAL void primitives_init_compare(primitives_t* WINPR_RESTRICT prims);
+FREERDP_LOCAL void primitives_init_planar(primitives_t* WINPR_RESTRICT prims);
 FREERDP_LOCAL void primitives_init_YCoCg(primitives_t* WINPR_RESTRICT prims);
 FREERDP_LOCAL void primitives_init_YUV(primitives_t* WINPR_RESTRICT prims);
 
@@ -306,6 +308,8 @@ FREERDP_LOCAL void primitives_init_shift_opt(primitives_t* WINPR_RESTRICT prims)
 FREERDP_LOCAL void primitives_init_sign_opt(primitives_t* WINPR_RESTRICT prims);
 FREERDP_LOCAL void primitives_init_alphaComp_opt(primitives_t* WINPR_RESTRICT prims);
 FREERDP_LOCAL void primitives_init_colors_opt(primitives_t* WINPR_RESTRICT prims);
+FREERDP_LOCAL void primitives_init_compare_opt(primitives_t* WINPR_RESTRICT prims);
+FREERDP_LOCAL void primitives_init_planar_opt(primitives_t* WINPR_RESTRICT prims);
 FREERDP_LOCAL void primitives_init_YCoCg_opt(primitives_t* WINPR_RESTRICT prims);
 FREERDP_LOCAL void primitives_init_YUV_opt(primitives_t* WINPR_RESTRICT prims);
 
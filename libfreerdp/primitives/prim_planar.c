@@ -0,0 +1,127 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Planar codec operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <freerdp/codec/color.h>
+
+#include "prim_internal.h"
+#include "prim_planar.h"
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t general_planar_split(const BYTE* WINPR_RESTRICT pSrc, UINT32 SrcFormat,
+                                      INT32 srcStep, BYTE* WINPR_RESTRICT pDst[4], UINT32 dstStep,
+                                      UINT32 width, UINT32 height)
+{
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(SrcFormat);
+
+	if (!pSrc || !pDst || (bpp == 0))
+		return -1;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* src = &pSrc[1ll * y * srcStep];
+		BYTE* a = &pDst[0][1ull * y * dstStep];
+		BYTE* r = &pDst[1][1ull * y * dstStep];
+		BYTE* g = &pDst[2][1ull * y * dstStep];
+		BYTE* b = &pDst[3][1ull * y * dstStep];
+
+		for (UINT32 x = 0; x < width; x++)
+		{
+			const UINT32 color = FreeRDPReadColor(&src[1ull * x * bpp], SrcFormat);
+			FreeRDPSplitColor(color, SrcFormat, &r[x], &g[x], &b[x], &a[x], NULL);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t general_planar_merge(const BYTE* WINPR_RESTRICT pSrc[4], UINT32 srcStep,
+                                      BYTE* WINPR_RESTRICT pDst, UINT32 DstFormat, INT32 dstStep,
+                                      UINT32 width, UINT32 height)
+{
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(DstFormat);
+
+	if (!pSrc || !pDst || (bpp == 0))
+		return -1;
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* a = pSrc[0] ? &pSrc[0][1ull * y * srcStep] : NULL;
+		const BYTE* r = &pSrc[1][1ull * y * srcStep];
+		const BYTE* g = &pSrc[2][1ull * y * srcStep];
+		const BYTE* b = &pSrc[3][1ull * y * srcStep];
+		BYTE* dst = &pDst[1ll * y * dstStep];
+
+		for (UINT32 x = 0; x < width; x++)
+		{
+			const UINT32 color = FreeRDPGetColor(DstFormat, r[x], g[x], b[x], a ? a[x] : 0xFF);
+			FreeRDPWriteColor(&dst[1ull * x * bpp], DstFormat, color);
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t general_planar_delta_encode(const BYTE* WINPR_RESTRICT pSrc,
+                                             const BYTE* WINPR_RESTRICT pPrev,
+                                             BYTE* WINPR_RESTRICT pDst, UINT32 len)
+{
+	for (UINT32 x = 0; x < len; x++)
+		pDst[x] = prim_planar_delta_encode_byte(pSrc[x], pPrev[x]);
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t general_planar_delta_decode(const BYTE* WINPR_RESTRICT pPrev,
+                                             BYTE* WINPR_RESTRICT pSrcDst, UINT32 len)
+{
+	for (UINT32 x = 0; x < len; x++)
+		pSrcDst[x] = prim_planar_delta_decode_byte(pSrcDst[x], pPrev[x]);
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static void general_planar_rle_scan(const BYTE* WINPR_RESTRICT pSrc, UINT32 len, BYTE symbol,
+                                    UINT32* WINPR_RESTRICT pRaw, UINT32* WINPR_RESTRICT pRun)
+{
+	const UINT32 start = prim_planar_find_run(pSrc, 0, len, symbol);
+
+	*pRaw = start;
+	*pRun = 0;
+
+	if (start < len)
+		*pRun = prim_planar_run_length(pSrc, start, len, (start > 0) ? pSrc[start - 1] : symbol);
+}
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_planar(primitives_t* WINPR_RESTRICT prims)
+{
+	prims->planar_split = general_planar_split;
+	prims->planar_merge = general_planar_merge;
+	prims->planar_delta_encode = general_planar_delta_encode;
+	prims->planar_delta_decode = general_planar_delta_decode;
+	prims->planar_rle_scan = general_planar_rle_scan;
+}
+
+void primitives_init_planar_opt(primitives_t* WINPR_RESTRICT prims)
+{
+	primitives_init_planar_sse2(prims);
+#if defined(WITH_AVX2)
+	primitives_init_planar_avx2(prims);
+#endif
+	primitives_init_planar_neon(prims);
+}
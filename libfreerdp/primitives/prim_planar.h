@@ -0,0 +1,127 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Primitives planar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_LIB_PRIM_PLANAR_H
+#define FREERDP_LIB_PRIM_PLANAR_H
+
+#include <winpr/wtypes.h>
+#include <winpr/assert.h>
+#include <freerdp/config.h>
+#include <freerdp/primitives.h>
+#include <freerdp/codec/color.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+/* index of the lowest set bit */
+static INLINE UINT32 prim_planar_ctz(UINT32 value)
+{
+	WINPR_ASSERT(value != 0);
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index = 0;
+	_BitScanForward(&index, value);
+	return (UINT32)index;
+#else
+	return (UINT32)__builtin_ctz(value);
+#endif
+}
+
+typedef struct
+{
+	size_t offsets[4]; /* byte offsets of alpha, red, green and blue in a pixel */
+	BOOL readAlpha;    /* split takes alpha from the pixel, otherwise it is 0xFF */
+	BOOL writeAlpha;   /* merge stores alpha in the pixel, otherwise the byte is cleared */
+} prim_planar_layout;
+
+/* The layout of a 32bpp format with 8 bit channels, as FreeRDPGetColor and FreeRDPWriteColor
+ * store it. Returns FALSE for all other formats. */
+static INLINE BOOL prim_planar_get_layout(UINT32 format, prim_planar_layout* layout)
+{
+	BYTE pixel[4] = { 0 };
+	BOOL found[5] = { FALSE };
+
+	WINPR_ASSERT(layout);
+
+	if (FreeRDPGetBitsPerPixel(format) != 32)
+		return FALSE;
+
+	if (!FreeRDPWriteColor(pixel, format, FreeRDPGetColor(format, 1, 2, 3, 4)))
+		return FALSE;
+
+	for (size_t x = 0; x < 4; x++)
+	{
+		const BYTE channel = (pixel[x] == 4) ? 0 : pixel[x];
+
+		if ((pixel[x] > 4) || found[channel])
+			return FALSE;
+
+		found[channel] = TRUE;
+		layout->offsets[channel] = x;
+	}
+
+	layout->readAlpha = FreeRDPColorHasAlpha(format);
+	layout->writeAlpha = pixel[layout->offsets[0]] == 4;
+	return TRUE;
+}
+
+static INLINE BYTE prim_planar_delta_encode_byte(BYTE cur, BYTE prev)
+{
+	const INT32 delta = (INT8)(BYTE)(cur - prev);
+	return (BYTE)((delta >= 0) ? 2 * delta : -2 * delta - 1);
+}
+
+static INLINE BYTE prim_planar_delta_decode_byte(BYTE code, BYTE prev)
+{
+	const INT32 delta = (code & 1) ? -((code >> 1) + 1) : (code >> 1);
+	return (BYTE)(prev + delta);
+}
+
+/* The first index >= from where three bytes equal to their predecessor start, len if none. */
+static INLINE UINT32 prim_planar_find_run(const BYTE* WINPR_RESTRICT pSrc, UINT32 from,
+                                          UINT32 len, BYTE symbol)
+{
+	for (UINT32 x = from; x + 3 <= len; x++)
+	{
+		const BYTE prev = (x > 0) ? pSrc[x - 1] : symbol;
+
+		if ((pSrc[x] == prev) && (pSrc[x + 1] == prev) && (pSrc[x + 2] == prev))
+			return x;
+	}
+
+	return len;
+}
+
+static INLINE UINT32 prim_planar_run_length(const BYTE* WINPR_RESTRICT pSrc, UINT32 from,
+                                            UINT32 len, BYTE value)
+{
+	UINT32 x = from;
+
+	while ((x < len) && (pSrc[x] == value))
+		x++;
+
+	return x - from;
+}
+
+void primitives_init_planar_sse2(primitives_t* WINPR_RESTRICT prims);
+void primitives_init_planar_neon(primitives_t* WINPR_RESTRICT prims);
+
+#if defined(WITH_AVX2)
+void primitives_init_planar_avx2(primitives_t* WINPR_RESTRICT prims);
+#endif
+
+#endif
@@ -75,6 +75,8 @@ static BOOL primitives_init_generic(primitives_t* prims)
 	primitives_init_shift(prims);
 	primitives_init_sign(prims);
 	primitives_init_colors(prims);
+	primitives_init_compare(prims);
+	primitives_init_planar(prims);
 	primitives_init_YCoCg(prims);
 	primitives_init_YUV(prims);
 	prims->uninit = NULL;
@@ -102,6 +104,8 @@ static BOOL primitives_init_optimized(primitives_t* prims)
 	primitives_init_shift_opt(prims);
 	primitives_init_sign_opt(prims);
 	primitives_init_colors_opt(prims);
+	primitives_init_compare_opt(prims);
+	primitives_init_planar_opt(prims);
 	primitives_init_YCoCg_opt(prims);
 	primitives_init_YUV_opt(prims);
 	prims->flags |= PRIM_FLAGS_HAVE_EXTCPU;
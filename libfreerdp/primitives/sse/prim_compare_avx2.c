@@ -0,0 +1,72 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Optimized compare operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#include "prim_compare.h"
+
+#include "prim_internal.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+/* ------------------------------------------------------------------------- */
+static BOOL avx2_bytes_equal(const BYTE* WINPR_RESTRICT pSrc1, const BYTE* WINPR_RESTRICT pSrc2,
+                             size_t len)
+{
+	__m256i diff = _mm256_setzero_si256();
+	size_t x = 0;
+
+	for (; x + 32 <= len; x += 32)
+	{
+		const __m256i a = _mm256_loadu_si256((const __m256i*)&pSrc1[x]);
+		const __m256i b = _mm256_loadu_si256((const __m256i*)&pSrc2[x]);
+		diff = _mm256_or_si256(diff, _mm256_xor_si256(a, b));
+	}
+
+	if (!_mm256_testz_si256(diff, diff))
+		return FALSE;
+
+	return memcmp(&pSrc1[x], &pSrc2[x], len - x) == 0;
+}
+
+static pstatus_t avx2_compare_tiles(const BYTE* WINPR_RESTRICT pSrc1, UINT32 src1Step,
+                                    const BYTE* WINPR_RESTRICT pSrc2, UINT32 src2Step,
+                                    UINT32 width, UINT32 height, UINT32 bpp, UINT32 tileSize,
+                                    BYTE* WINPR_RESTRICT pMask, UINT32 maskStep)
+{
+	return prim_compare_tiles(pSrc1, src1Step, pSrc2, src2Step, width, height, bpp, tileSize,
+	                          pMask, maskStep, avx2_bytes_equal);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_compare_avx2(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	if (IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE))
+	{
+		WLog_VRB(PRIM_TAG, "AVX2 optimizations");
+		prims->compare_tiles = avx2_compare_tiles;
+	}
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or WITH_AVX2 or AVX2 intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
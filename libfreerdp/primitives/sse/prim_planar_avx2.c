@@ -0,0 +1,147 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Optimized planar codec operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#include "prim_planar.h"
+
+#include "prim_internal.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <immintrin.h>
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t avx2_planar_delta_encode(const BYTE* WINPR_RESTRICT pSrc,
+                                          const BYTE* WINPR_RESTRICT pPrev,
+                                          BYTE* WINPR_RESTRICT pDst, UINT32 len)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	UINT32 x = 0;
+
+	for (; x + 32 <= len; x += 32)
+	{
+		const __m256i cur = _mm256_loadu_si256((const __m256i*)&pSrc[x]);
+		const __m256i prev = _mm256_loadu_si256((const __m256i*)&pPrev[x]);
+		const __m256i delta = _mm256_sub_epi8(cur, prev);
+		const __m256i sign = _mm256_cmpgt_epi8(zero, delta);
+		_mm256_storeu_si256((__m256i*)&pDst[x],
+		                    _mm256_xor_si256(_mm256_add_epi8(delta, delta), sign));
+	}
+
+	for (; x < len; x++)
+		pDst[x] = prim_planar_delta_encode_byte(pSrc[x], pPrev[x]);
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t avx2_planar_delta_decode(const BYTE* WINPR_RESTRICT pPrev,
+                                          BYTE* WINPR_RESTRICT pSrcDst, UINT32 len)
+{
+	const __m256i one = _mm256_set1_epi8(1);
+	const __m256i low = _mm256_set1_epi8(0x7F);
+	UINT32 x = 0;
+
+	for (; x + 32 <= len; x += 32)
+	{
+		const __m256i code = _mm256_loadu_si256((const __m256i*)&pSrcDst[x]);
+		const __m256i prev = _mm256_loadu_si256((const __m256i*)&pPrev[x]);
+		const __m256i half = _mm256_and_si256(_mm256_srli_epi16(code, 1), low);
+		const __m256i sign = _mm256_cmpeq_epi8(_mm256_and_si256(code, one), one);
+		const __m256i delta = _mm256_xor_si256(half, sign);
+		_mm256_storeu_si256((__m256i*)&pSrcDst[x], _mm256_add_epi8(prev, delta));
+	}
+
+	for (; x < len; x++)
+		pSrcDst[x] = prim_planar_delta_decode_byte(pSrcDst[x], pPrev[x]);
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static void avx2_planar_rle_scan(const BYTE* WINPR_RESTRICT pSrc, UINT32 len, BYTE symbol,
+                                 UINT32* WINPR_RESTRICT pRaw, UINT32* WINPR_RESTRICT pRun)
+{
+	UINT32 start = len;
+	UINT32 x = 1;
+
+	if ((len >= 3) && (pSrc[0] == symbol) && (pSrc[1] == symbol) && (pSrc[2] == symbol))
+		start = 0;
+	else
+	{
+		/* see sse2_planar_rle_scan */
+		for (; x + 32 <= len; x += 30)
+		{
+			const __m256i a = _mm256_loadu_si256((const __m256i*)&pSrc[x - 1]);
+			const __m256i b = _mm256_loadu_si256((const __m256i*)&pSrc[x]);
+			const UINT32 m = (UINT32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+			const UINT32 t = m & (m >> 1) & (m >> 2) & 0x3FFFFFFF;
+
+			if (t)
+			{
+				start = x + prim_planar_ctz(t);
+				break;
+			}
+		}
+
+		if (start == len)
+			start = prim_planar_find_run(pSrc, x, len, symbol);
+	}
+
+	*pRaw = start;
+	*pRun = 0;
+
+	if (start == len)
+		return;
+
+	const BYTE value = (start > 0) ? pSrc[start - 1] : symbol;
+	const __m256i v = _mm256_set1_epi8((char)value);
+	UINT32 end = start;
+
+	for (; end + 32 <= len; end += 32)
+	{
+		const __m256i b = _mm256_loadu_si256((const __m256i*)&pSrc[end]);
+		const UINT32 m = (UINT32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, v));
+
+		if (m != UINT32_MAX)
+		{
+			*pRun = end + prim_planar_ctz(~m) - start;
+			return;
+		}
+	}
+
+	*pRun = end + prim_planar_run_length(pSrc, end, len, value) - start;
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_planar_avx2(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	if (IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE))
+	{
+		WLog_VRB(PRIM_TAG, "AVX2 optimizations");
+		/* the split and merge shuffles cross 128 bit lanes, they keep the SSE2 versions */
+		prims->planar_delta_encode = avx2_planar_delta_encode;
+		prims->planar_delta_decode = avx2_planar_delta_decode;
+		prims->planar_rle_scan = avx2_planar_rle_scan;
+	}
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or WITH_AVX2 or AVX2 intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
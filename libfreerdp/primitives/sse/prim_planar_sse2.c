@@ -0,0 +1,268 @@
+/* FreeRDP: A Remote Desktop Protocol Client
+ * Optimized planar codec operations.
+ * vi:ts=4 sw=4:
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <string.h>
+#include <freerdp/types.h>
+#include <freerdp/primitives.h>
+#include <winpr/sysinfo.h>
+
+#include "prim_planar.h"
+
+#include "prim_internal.h"
+
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+#include <emmintrin.h>
+
+static primitives_t* generic = NULL;
+
+/* ------------------------------------------------------------------------- */
+/* one channel of 16 pixels, the channel values fit in 16 bit so signed saturation is lossless */
+static INLINE __m128i sse2_planar_channel(const __m128i px[4], __m128i shift)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i c0 = _mm_and_si128(_mm_srl_epi32(px[0], shift), mask);
+	const __m128i c1 = _mm_and_si128(_mm_srl_epi32(px[1], shift), mask);
+	const __m128i c2 = _mm_and_si128(_mm_srl_epi32(px[2], shift), mask);
+	const __m128i c3 = _mm_and_si128(_mm_srl_epi32(px[3], shift), mask);
+	return _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+}
+
+static pstatus_t sse2_planar_split(const BYTE* WINPR_RESTRICT pSrc, UINT32 SrcFormat,
+                                   INT32 srcStep, BYTE* WINPR_RESTRICT pDst[4], UINT32 dstStep,
+                                   UINT32 width, UINT32 height)
+{
+	prim_planar_layout layout = { 0 };
+
+	if (!pSrc || !pDst || !prim_planar_get_layout(SrcFormat, &layout))
+		return generic->planar_split(pSrc, SrcFormat, srcStep, pDst, dstStep, width, height);
+
+	const size_t first = layout.readAlpha ? 0 : 1;
+	__m128i shifts[4] = { 0 };
+
+	for (size_t c = 0; c < 4; c++)
+		shifts[c] = _mm_cvtsi32_si128((int)(8 * layout.offsets[c]));
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* src = &pSrc[1ll * y * srcStep];
+		BYTE* dst[4] = { &pDst[0][1ull * y * dstStep], &pDst[1][1ull * y * dstStep],
+			             &pDst[2][1ull * y * dstStep], &pDst[3][1ull * y * dstStep] };
+		UINT32 x = 0;
+
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i px[4] = { _mm_loadu_si128((const __m128i*)&src[4ull * x]),
+				                    _mm_loadu_si128((const __m128i*)&src[4ull * x + 16]),
+				                    _mm_loadu_si128((const __m128i*)&src[4ull * x + 32]),
+				                    _mm_loadu_si128((const __m128i*)&src[4ull * x + 48]) };
+
+			for (size_t c = first; c < 4; c++)
+				_mm_storeu_si128((__m128i*)&dst[c][x], sse2_planar_channel(px, shifts[c]));
+		}
+
+		for (; x < width; x++)
+		{
+			for (size_t c = first; c < 4; c++)
+				dst[c][x] = src[4ull * x + layout.offsets[c]];
+		}
+
+		if (!layout.readAlpha)
+			memset(dst[0], 0xFF, width);
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t sse2_planar_merge(const BYTE* WINPR_RESTRICT pSrc[4], UINT32 srcStep,
+                                   BYTE* WINPR_RESTRICT pDst, UINT32 DstFormat, INT32 dstStep,
+                                   UINT32 width, UINT32 height)
+{
+	prim_planar_layout layout = { 0 };
+
+	if (!pSrc || !pDst || !prim_planar_get_layout(DstFormat, &layout))
+		return generic->planar_merge(pSrc, srcStep, pDst, DstFormat, dstStep, width, height);
+
+	const BYTE fill = layout.writeAlpha ? 0xFF : 0x00;
+	const BOOL withAlpha = layout.writeAlpha && pSrc[0];
+
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* src[4] = { withAlpha ? &pSrc[0][1ull * y * srcStep] : NULL,
+			                   &pSrc[1][1ull * y * srcStep], &pSrc[2][1ull * y * srcStep],
+			                   &pSrc[3][1ull * y * srcStep] };
+		BYTE* dst = &pDst[1ll * y * dstStep];
+		UINT32 x = 0;
+
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i v[4] = { 0 };
+
+			for (size_t c = 0; c < 4; c++)
+			{
+				v[layout.offsets[c]] = src[c] ? _mm_loadu_si128((const __m128i*)&src[c][x])
+				                              : _mm_set1_epi8((char)fill);
+			}
+
+			const __m128i lo01 = _mm_unpacklo_epi8(v[0], v[1]);
+			const __m128i hi01 = _mm_unpackhi_epi8(v[0], v[1]);
+			const __m128i lo23 = _mm_unpacklo_epi8(v[2], v[3]);
+			const __m128i hi23 = _mm_unpackhi_epi8(v[2], v[3]);
+			_mm_storeu_si128((__m128i*)&dst[4ull * x], _mm_unpacklo_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i*)&dst[4ull * x + 16], _mm_unpackhi_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i*)&dst[4ull * x + 32], _mm_unpacklo_epi16(hi01, hi23));
+			_mm_storeu_si128((__m128i*)&dst[4ull * x + 48], _mm_unpackhi_epi16(hi01, hi23));
+		}
+
+		for (; x < width; x++)
+		{
+			for (size_t c = 0; c < 4; c++)
+				dst[4ull * x + layout.offsets[c]] = src[c] ? src[c][x] : fill;
+		}
+	}
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static pstatus_t sse2_planar_delta_encode(const BYTE* WINPR_RESTRICT pSrc,
+                                          const BYTE* WINPR_RESTRICT pPrev,
+                                          BYTE* WINPR_RESTRICT pDst, UINT32 len)
+{
+	const __m128i zero = _mm_setzero_si128();
+	UINT32 x = 0;
+
+	for (; x + 16 <= len; x += 16)
+	{
+		const __m128i cur = _mm_loadu_si128((const __m128i*)&pSrc[x]);
+		const __m128i prev = _mm_loadu_si128((const __m128i*)&pPrev[x]);
+		const __m128i delta = _mm_sub_epi8(cur, prev);
+		/* (d << 1) ^ (d >> 7) */
+		const __m128i sign = _mm_cmpgt_epi8(zero, delta);
+		_mm_storeu_si128((__m128i*)&pDst[x], _mm_xor_si128(_mm_add_epi8(delta, delta), sign));
+	}
+
+	for (; x < len; x++)
+		pDst[x] = prim_planar_delta_encode_byte(pSrc[x], pPrev[x]);
+
+	return PRIMITIVES_SUCCESS;
+}
+
+static pstatus_t sse2_planar_delta_decode(const BYTE* WINPR_RESTRICT pPrev,
+                                          BYTE* WINPR_RESTRICT pSrcDst, UINT32 len)
+{
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i low = _mm_set1_epi8(0x7F);
+	UINT32 x = 0;
+
+	for (; x + 16 <= len; x += 16)
+	{
+		const __m128i code = _mm_loadu_si128((const __m128i*)&pSrcDst[x]);
+		const __m128i prev = _mm_loadu_si128((const __m128i*)&pPrev[x]);
+		/* (c >> 1) ^ -(c & 1) */
+		const __m128i half = _mm_and_si128(_mm_srli_epi16(code, 1), low);
+		const __m128i sign = _mm_cmpeq_epi8(_mm_and_si128(code, one), one);
+		const __m128i delta = _mm_xor_si128(half, sign);
+		_mm_storeu_si128((__m128i*)&pSrcDst[x], _mm_add_epi8(prev, delta));
+	}
+
+	for (; x < len; x++)
+		pSrcDst[x] = prim_planar_delta_decode_byte(pSrcDst[x], pPrev[x]);
+
+	return PRIMITIVES_SUCCESS;
+}
+
+/* ------------------------------------------------------------------------- */
+static void sse2_planar_rle_scan(const BYTE* WINPR_RESTRICT pSrc, UINT32 len, BYTE symbol,
+                                 UINT32* WINPR_RESTRICT pRaw, UINT32* WINPR_RESTRICT pRun)
+{
+	UINT32 start = len;
+	UINT32 x = 1;
+
+	if ((len >= 3) && (pSrc[0] == symbol) && (pSrc[1] == symbol) && (pSrc[2] == symbol))
+		start = 0;
+	else
+	{
+		/* bit k of the mask is set if pSrc[x + k] equals its predecessor, a run starts where
+		 * three consecutive bits are set. 32 bits give 30 candidate positions. */
+		for (; x + 32 <= len; x += 30)
+		{
+			const __m128i a0 = _mm_loadu_si128((const __m128i*)&pSrc[x - 1]);
+			const __m128i b0 = _mm_loadu_si128((const __m128i*)&pSrc[x]);
+			const __m128i a1 = _mm_loadu_si128((const __m128i*)&pSrc[x + 15]);
+			const __m128i b1 = _mm_loadu_si128((const __m128i*)&pSrc[x + 16]);
+			const UINT32 lo = (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi8(a0, b0));
+			const UINT32 hi = (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi8(a1, b1));
+			const UINT32 m = lo | (hi << 16);
+			const UINT32 t = m & (m >> 1) & (m >> 2) & 0x3FFFFFFF;
+
+			if (t)
+			{
+				start = x + prim_planar_ctz(t);
+				break;
+			}
+		}
+
+		if (start == len)
+			start = prim_planar_find_run(pSrc, x, len, symbol);
+	}
+
+	*pRaw = start;
+	*pRun = 0;
+
+	if (start == len)
+		return;
+
+	const BYTE value = (start > 0) ? pSrc[start - 1] : symbol;
+	const __m128i v = _mm_set1_epi8((char)value);
+	UINT32 end = start;
+
+	for (; end + 16 <= len; end += 16)
+	{
+		const __m128i b = _mm_loadu_si128((const __m128i*)&pSrc[end]);
+		const UINT32 m = (UINT32)_mm_movemask_epi8(_mm_cmpeq_epi8(b, v));
+
+		if (m != 0xFFFF)
+		{
+			*pRun = end + prim_planar_ctz(~m) - start;
+			return;
+		}
+	}
+
+	*pRun = end + prim_planar_run_length(pSrc, end, len, value) - start;
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+void primitives_init_planar_sse2(primitives_t* WINPR_RESTRICT prims)
+{
+#if defined(SSE_AVX_INTRINSICS_ENABLED)
+	generic = primitives_get_generic();
+
+	if (IsProcessorFeaturePresent(PF_SSE2_INSTRUCTIONS_AVAILABLE))
+	{
+		WLog_VRB(PRIM_TAG, "SSE2 optimizations");
+		prims->planar_split = sse2_planar_split;
+		prims->planar_merge = sse2_planar_merge;
+		prims->planar_delta_encode = sse2_planar_delta_encode;
+		prims->planar_delta_decode = sse2_planar_delta_decode;
+		prims->planar_rle_scan = sse2_planar_rle_scan;
+	}
+#else
+	WLog_VRB(PRIM_TAG, "undefined WITH_SIMD or SSE2 intrinsics not available");
+	WINPR_UNUSED(prims);
+#endif
+}
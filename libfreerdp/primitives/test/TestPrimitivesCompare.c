@@ -0,0 +1,203 @@
+/* test_compare.c
+ * vi:ts=4 sw=4
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <freerdp/config.h>
+#include <freerdp/utils/profiler.h>
+#include <winpr/crypto.h>
+
+#include <winpr/sysinfo.h>
+#include "prim_test.h"
+
+static BOOL mask_bit(const BYTE* mask, UINT32 maskStep, size_t tx, size_t ty)
+{
+	return (mask[ty * maskStep + tx / 8] & (1u << (tx % 8))) != 0;
+}
+
+/* Reference result: a tile differs if any byte inside the (clipped) tile differs */
+static BOOL tile_differs(const BYTE* a, const BYTE* b, UINT32 step, UINT32 width, UINT32 height,
+                         UINT32 bpp, UINT32 tileSize, size_t tx, size_t ty)
+{
+	const size_t right = MIN((tx + 1) * tileSize, width);
+	const size_t bottom = MIN((ty + 1) * tileSize, height);
+
+	for (size_t y = ty * tileSize; y < bottom; y++)
+	{
+		const size_t offset = y * step + tx * tileSize * bpp;
+		if (memcmp(&a[offset], &b[offset], (right - tx * tileSize) * bpp) != 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static BOOL test_compare_tiles_func(UINT32 width, UINT32 height, UINT32 bpp, UINT32 tileSize,
+                                    UINT32 changes)
+{
+	BOOL rc = FALSE;
+	const UINT32 step = width * bpp + 7;
+	const size_t ncol = (width + tileSize - 1) / tileSize;
+	const size_t nrow = (height + tileSize - 1) / tileSize;
+	const UINT32 maskStep = (UINT32)((ncol + 7) / 8);
+	BYTE* a = calloc(step, height);
+	BYTE* b = calloc(step, height);
+	BYTE* mask1 = calloc(maskStep, nrow);
+	BYTE* mask2 = calloc(maskStep, nrow);
+
+	if (!a || !b || !mask1 || !mask2)
+		goto fail;
+
+	winpr_RAND(a, 1ull * step * height);
+	memcpy(b, a, 1ull * step * height);
+
+	for (UINT32 x = 0; x < changes; x++)
+	{
+		UINT32 pos = 0;
+		winpr_RAND(&pos, sizeof(pos));
+		const UINT32 y = (pos / 7) % height;
+		const UINT32 col = pos % (width * bpp);
+		b[1ull * y * step + col] ^= 0x01;
+	}
+
+	/* Changes in the padding after the image must not be reported */
+	for (UINT32 y = 0; y < height; y++)
+		b[1ull * y * step + width * bpp] ^= 0xFF;
+
+	if (generic->compare_tiles(a, step, b, step, width, height, bpp, tileSize, mask1, maskStep) !=
+	    PRIMITIVES_SUCCESS)
+		goto fail;
+
+	if (optimized->compare_tiles(a, step, b, step, width, height, bpp, tileSize, mask2,
+	                             maskStep) != PRIMITIVES_SUCCESS)
+		goto fail;
+
+	for (size_t ty = 0; ty < nrow; ty++)
+	{
+		for (size_t tx = 0; tx < ncol; tx++)
+		{
+			const BOOL expect = tile_differs(a, b, step, width, height, bpp, tileSize, tx, ty);
+			if ((mask_bit(mask1, maskStep, tx, ty) != expect) ||
+			    (mask_bit(mask2, maskStep, tx, ty) != expect))
+			{
+				printf("compare_tiles FAIL: %" PRIu32 "x%" PRIu32 " bpp=%" PRIu32
+				       " tile=%" PRIu32 " at %" PRIuz "x%" PRIuz "\n",
+				       width, height, bpp, tileSize, tx, ty);
+				goto fail;
+			}
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(a);
+	free(b);
+	free(mask1);
+	free(mask2);
+	return rc;
+}
+
+/* ------------------------------------------------------------------------- */
+static BOOL test_compare_tiles_speed(UINT32 width, UINT32 height, UINT32 tileSize)
+{
+	BOOL rc = FALSE;
+	const UINT32 bpp = 4;
+	const UINT32 step = width * bpp;
+	const size_t ncol = (width + tileSize - 1) / tileSize;
+	const size_t nrow = (height + tileSize - 1) / tileSize;
+	const UINT32 maskStep = (UINT32)((ncol + 7) / 8);
+	BYTE* a = winpr_aligned_calloc(step, height, 32);
+	BYTE* b = winpr_aligned_calloc(step, height, 32);
+	BYTE* mask = calloc(maskStep, nrow);
+	PROFILER_DEFINE(genericProf)
+	PROFILER_DEFINE(optProf)
+	PROFILER_CREATE(genericProf, "compare_tiles-GENERIC")
+	PROFILER_CREATE(optProf, "compare_tiles-OPTIMIZED")
+
+	if (!a || !b || !mask)
+		goto fail;
+
+	/* A typical desktop frame: mostly unchanged with a few updated spots */
+	winpr_RAND(a, 1ull * step * height);
+	memcpy(b, a, 1ull * step * height);
+	for (UINT32 y = 0; y < height; y += 97)
+		b[1ull * y * step + (y * 13) % step] ^= 0x01;
+
+	PROFILER_ENTER(genericProf)
+	for (UINT32 x = 0; x < 10; x++)
+	{
+		if (generic->compare_tiles(a, step, b, step, width, height, bpp, tileSize, mask,
+		                           maskStep) != PRIMITIVES_SUCCESS)
+			goto fail;
+	}
+	PROFILER_EXIT(genericProf)
+
+	PROFILER_ENTER(optProf)
+	for (UINT32 x = 0; x < 10; x++)
+	{
+		if (optimized->compare_tiles(a, step, b, step, width, height, bpp, tileSize, mask,
+		                             maskStep) != PRIMITIVES_SUCCESS)
+			goto fail;
+	}
+	PROFILER_EXIT(optProf)
+
+	printf("Results for %" PRIu32 "x%" PRIu32 " [tile %" PRIu32 "]", width, height, tileSize);
+	PROFILER_PRINT_HEADER
+	PROFILER_PRINT(genericProf)
+	PROFILER_PRINT(optProf)
+	PROFILER_PRINT_FOOTER
+
+	rc = TRUE;
+fail:
+	PROFILER_FREE(genericProf)
+	PROFILER_FREE(optProf)
+	winpr_aligned_free(a);
+	winpr_aligned_free(b);
+	free(mask);
+	return rc;
+}
+
+int TestPrimitivesCompare(int argc, char* argv[])
+{
+	const UINT32 sizes[][2] = { { 1, 1 }, { 16, 16 }, { 17, 33 }, { 64, 64 }, { 257, 131 } };
+	const UINT32 bpps[] = { 2, 3, 4 };
+	const UINT32 tiles[] = { 16, 64 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+	prim_test_setup(FALSE);
+
+	for (size_t x = 0; x < ARRAYSIZE(sizes); x++)
+	{
+		for (size_t y = 0; y < ARRAYSIZE(bpps); y++)
+		{
+			for (size_t z = 0; z < ARRAYSIZE(tiles); z++)
+			{
+				for (UINT32 changes = 0; changes < 32; changes += 7)
+				{
+					if (!test_compare_tiles_func(sizes[x][0], sizes[x][1], bpps[y], tiles[z],
+					                             changes))
+						return 1;
+				}
+			}
+		}
+	}
+
+	if (!test_compare_tiles_speed(1920, 1080, 16))
+		return 1;
+
+	if (!test_compare_tiles_speed(1920, 1080, 64))
+		return 1;
+
+	return 0;
+}
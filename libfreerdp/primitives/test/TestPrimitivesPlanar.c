@@ -0,0 +1,402 @@
+/* test_planar.c
+ * vi:ts=4 sw=4
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0.
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express
+ * or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <freerdp/config.h>
+#include <freerdp/utils/profiler.h>
+#include <freerdp/codec/color.h>
+#include <winpr/crypto.h>
+
+#include <winpr/sysinfo.h>
+#include "prim_test.h"
+
+static const UINT32 formats[] = { PIXEL_FORMAT_ARGB32, PIXEL_FORMAT_XRGB32, PIXEL_FORMAT_ABGR32,
+	                              PIXEL_FORMAT_XBGR32, PIXEL_FORMAT_BGRA32, PIXEL_FORMAT_BGRX32,
+	                              PIXEL_FORMAT_RGBA32, PIXEL_FORMAT_RGBX32, PIXEL_FORMAT_RGB24,
+	                              PIXEL_FORMAT_RGB16 };
+
+static UINT32 test_rand(UINT32 max)
+{
+	UINT32 value = 0;
+	winpr_RAND(&value, sizeof(value));
+	return value % max;
+}
+
+/* ------------------------------------------------------------------------- */
+static BOOL test_split_merge_func(UINT32 format, UINT32 width, UINT32 height)
+{
+	BOOL rc = FALSE;
+	const UINT32 bpp = FreeRDPGetBytesPerPixel(format);
+	const UINT32 srcStep = width * bpp + 5;
+	const UINT32 planeStep = width + 3;
+	const size_t planeSize = 1ull * planeStep * height;
+	BYTE* src = calloc(srcStep, height);
+	BYTE* dst1 = calloc(srcStep, height);
+	BYTE* dst2 = calloc(srcStep, height);
+	BYTE* planes1 = calloc(planeSize, 4);
+	BYTE* planes2 = calloc(planeSize, 4);
+
+	if (!src || !dst1 || !dst2 || !planes1 || !planes2)
+		goto fail;
+
+	winpr_RAND(src, 1ull * srcStep * height);
+
+	BYTE* p1[4] = { planes1, planes1 + planeSize, planes1 + 2 * planeSize,
+		            planes1 + 3 * planeSize };
+	BYTE* p2[4] = { planes2, planes2 + planeSize, planes2 + 2 * planeSize,
+		            planes2 + 3 * planeSize };
+
+	/* top down and bottom up */
+	for (size_t flip = 0; flip < 2; flip++)
+	{
+		const BYTE* first = flip ? &src[1ull * (height - 1) * srcStep] : src;
+		const INT32 step = flip ? -(INT32)srcStep : (INT32)srcStep;
+
+		memset(planes1, 0, planeSize * 4);
+		memset(planes2, 0, planeSize * 4);
+		if ((generic->planar_split(first, format, step, p1, planeStep, width, height) !=
+		     PRIMITIVES_SUCCESS) ||
+		    (optimized->planar_split(first, format, step, p2, planeStep, width, height) !=
+		     PRIMITIVES_SUCCESS))
+			goto fail;
+
+		if (memcmp(planes1, planes2, planeSize * 4) != 0)
+		{
+			printf("planar_split FAIL: %s %" PRIu32 "x%" PRIu32 " flip=%" PRIuz "\n",
+			       FreeRDPGetColorFormatName(format), width, height, flip);
+			goto fail;
+		}
+	}
+
+	/* with and without an alpha plane */
+	for (size_t alpha = 0; alpha < 2; alpha++)
+	{
+		const BYTE* planes[4] = { alpha ? p1[0] : NULL, p1[1], p1[2], p1[3] };
+
+		winpr_RAND(planes1, planeSize * 4);
+		winpr_RAND(dst1, 1ull * srcStep * height);
+		memcpy(dst2, dst1, 1ull * srcStep * height);
+		if ((generic->planar_merge(planes, planeStep, dst1, format, (INT32)srcStep, width,
+		                           height) != PRIMITIVES_SUCCESS) ||
+		    (optimized->planar_merge(planes, planeStep, dst2, format, (INT32)srcStep, width,
+		                             height) != PRIMITIVES_SUCCESS))
+			goto fail;
+
+		if (memcmp(dst1, dst2, 1ull * srcStep * height) != 0)
+		{
+			printf("planar_merge FAIL: %s %" PRIu32 "x%" PRIu32 " alpha=%" PRIuz "\n",
+			       FreeRDPGetColorFormatName(format), width, height, alpha);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(src);
+	free(dst1);
+	free(dst2);
+	free(planes1);
+	free(planes2);
+	return rc;
+}
+
+/* ------------------------------------------------------------------------- */
+static BOOL test_delta_func(UINT32 len)
+{
+	BOOL rc = FALSE;
+	BYTE* cur = calloc(len + 1, 1);
+	BYTE* prev = calloc(len + 1, 1);
+	BYTE* code1 = calloc(len + 1, 1);
+	BYTE* code2 = calloc(len + 1, 1);
+
+	if (!cur || !prev || !code1 || !code2)
+		goto fail;
+
+	winpr_RAND(cur, len);
+	winpr_RAND(prev, len);
+	/* some small differences as found in images */
+	for (UINT32 x = 0; x < len; x += 3)
+		cur[x] = (BYTE)(prev[x] + (x % 7) - 3);
+
+	if ((generic->planar_delta_encode(cur, prev, code1, len) != PRIMITIVES_SUCCESS) ||
+	    (optimized->planar_delta_encode(cur, prev, code2, len) != PRIMITIVES_SUCCESS))
+		goto fail;
+
+	if (memcmp(code1, code2, len) != 0)
+	{
+		printf("planar_delta_encode FAIL: len=%" PRIu32 "\n", len);
+		goto fail;
+	}
+
+	/* the decoding as specified in [MS-RDPEGDI] 3.1.9.2.3 */
+	for (UINT32 x = 0; x < len; x++)
+	{
+		const INT32 delta = (code1[x] & 1) ? -((code1[x] >> 1) + 1) : (code1[x] >> 1);
+		if ((BYTE)(prev[x] + delta) != cur[x])
+		{
+			printf("planar_delta_encode FAIL: len=%" PRIu32 " at %" PRIu32 "\n", len, x);
+			goto fail;
+		}
+	}
+
+	if ((generic->planar_delta_decode(prev, code1, len) != PRIMITIVES_SUCCESS) ||
+	    (optimized->planar_delta_decode(prev, code2, len) != PRIMITIVES_SUCCESS))
+		goto fail;
+
+	if ((memcmp(code1, cur, len) != 0) || (memcmp(code2, cur, len) != 0))
+	{
+		printf("planar_delta_decode FAIL: len=%" PRIu32 "\n", len);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	free(cur);
+	free(prev);
+	free(code1);
+	free(code2);
+	return rc;
+}
+
+/* ------------------------------------------------------------------------- */
+/* The segmentation of the scalar encoder the scan replaces: runs shorter than three bytes are
+ * merged into the raw bytes. */
+static void reference_rle_scan(const BYTE* pSrc, UINT32 len, BYTE symbol, UINT32* pRaw,
+                               UINT32* pRun)
+{
+	UINT32 raw = 0;
+	UINT32 run = 0;
+
+	for (UINT32 x = 0; x < len; x++)
+	{
+		const BOOL match = (pSrc[x] == symbol);
+		symbol = pSrc[x];
+
+		if (run && !match)
+		{
+			if (run >= 3)
+				break;
+			raw += run;
+			run = 0;
+		}
+
+		run += match ? 1 : 0;
+		raw += match ? 0 : 1;
+	}
+
+	if (run < 3)
+	{
+		raw += run;
+		run = 0;
+	}
+
+	*pRaw = raw;
+	*pRun = run;
+}
+
+static BOOL test_rle_scan_func(UINT32 len, UINT32 alphabet)
+{
+	BOOL rc = FALSE;
+	BYTE* line = calloc(len + 1, 1);
+
+	if (!line)
+		goto fail;
+
+	/* runs of random length from a small alphabet */
+	for (UINT32 x = 0; x < len;)
+	{
+		const BYTE value = (BYTE)test_rand(alphabet);
+		const UINT32 length = 1 + test_rand(test_rand(4) ? 4 : 80);
+		const UINT32 count = MIN(len - x, length);
+
+		memset(&line[x], value, count);
+		x += count;
+	}
+
+	for (UINT32 offset = 0; offset < len; offset++)
+	{
+		const BYTE symbol = offset ? line[offset - 1] : (BYTE)test_rand(alphabet);
+		UINT32 raw[3] = { 0 };
+		UINT32 run[3] = { 0 };
+
+		reference_rle_scan(&line[offset], len - offset, symbol, &raw[0], &run[0]);
+		generic->planar_rle_scan(&line[offset], len - offset, symbol, &raw[1], &run[1]);
+		optimized->planar_rle_scan(&line[offset], len - offset, symbol, &raw[2], &run[2]);
+
+		if ((raw[0] != raw[1]) || (raw[0] != raw[2]) || (run[0] != run[1]) || (run[0] != run[2]))
+		{
+			printf("planar_rle_scan FAIL: len=%" PRIu32 " offset=%" PRIu32 " raw=%" PRIu32
+			       "/%" PRIu32 "/%" PRIu32 " run=%" PRIu32 "/%" PRIu32 "/%" PRIu32 "\n",
+			       len, offset, raw[0], raw[1], raw[2], run[0], run[1], run[2]);
+			goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	free(line);
+	return rc;
+}
+
+/* ------------------------------------------------------------------------- */
+static void test_scan_lines(const primitives_t* prims, const BYTE* codes, UINT32 width,
+                            UINT32 height)
+{
+	for (UINT32 y = 0; y < height; y++)
+	{
+		const BYTE* line = &codes[1ull * y * width];
+		BYTE symbol = 0;
+
+		for (UINT32 x = 0; x < width;)
+		{
+			UINT32 raw = 0;
+			UINT32 run = 0;
+			prims->planar_rle_scan(&line[x], width - x, symbol, &raw, &run);
+			x += raw + run;
+			symbol = line[x - 1];
+		}
+	}
+}
+
+static BOOL test_planar_speed(UINT32 width, UINT32 height)
+{
+	BOOL rc = FALSE;
+	const UINT32 step = width * 4;
+	const size_t planeSize = 1ull * width * height;
+	BYTE* src = winpr_aligned_calloc(step, height, 32);
+	BYTE* planes = winpr_aligned_calloc(planeSize, 4, 32);
+	BYTE* codes = winpr_aligned_calloc(planeSize, 1, 32);
+	PROFILER_DEFINE(genericSplit)
+	PROFILER_DEFINE(optSplit)
+	PROFILER_DEFINE(genericDelta)
+	PROFILER_DEFINE(optDelta)
+	PROFILER_DEFINE(genericScan)
+	PROFILER_DEFINE(optScan)
+	PROFILER_CREATE(genericSplit, "planar_split-GENERIC")
+	PROFILER_CREATE(optSplit, "planar_split-OPTIMIZED")
+	PROFILER_CREATE(genericDelta, "planar_delta_encode-GENERIC")
+	PROFILER_CREATE(optDelta, "planar_delta_encode-OPTIMIZED")
+	PROFILER_CREATE(genericScan, "planar_rle_scan-GENERIC")
+	PROFILER_CREATE(optScan, "planar_rle_scan-OPTIMIZED")
+
+	if (!src || !planes || !codes)
+		goto fail;
+
+	/* flat areas with some noise, as on a desktop */
+	for (UINT32 y = 0; y < height; y++)
+	{
+		for (UINT32 x = 0; x < width; x++)
+		{
+			const UINT32 color = ((x / 64) * 0x1F3D5B + (y / 32) * 0x0A0B0C) | 0xFF000000;
+			memcpy(&src[1ull * y * step + 4ull * x], &color, sizeof(color));
+		}
+	}
+	for (UINT32 x = 0; x < 4096; x++)
+		src[test_rand(step * height)] ^= 0x10;
+
+	BYTE* p[4] = { planes, planes + planeSize, planes + 2 * planeSize, planes + 3 * planeSize };
+
+	PROFILER_ENTER(genericSplit)
+	if (generic->planar_split(src, PIXEL_FORMAT_BGRA32, (INT32)step, p, width, width, height) !=
+	    PRIMITIVES_SUCCESS)
+		goto fail;
+	PROFILER_EXIT(genericSplit)
+
+	PROFILER_ENTER(optSplit)
+	if (optimized->planar_split(src, PIXEL_FORMAT_BGRA32, (INT32)step, p, width, width, height) !=
+	    PRIMITIVES_SUCCESS)
+		goto fail;
+	PROFILER_EXIT(optSplit)
+
+	PROFILER_ENTER(genericDelta)
+	for (UINT32 y = 1; y < height; y++)
+		generic->planar_delta_encode(&p[1][1ull * y * width], &p[1][1ull * (y - 1) * width],
+		                             &codes[1ull * y * width], width);
+	PROFILER_EXIT(genericDelta)
+
+	PROFILER_ENTER(optDelta)
+	for (UINT32 y = 1; y < height; y++)
+		optimized->planar_delta_encode(&p[1][1ull * y * width], &p[1][1ull * (y - 1) * width],
+		                               &codes[1ull * y * width], width);
+	PROFILER_EXIT(optDelta)
+
+	PROFILER_ENTER(genericScan)
+	test_scan_lines(generic, codes, width, height);
+	PROFILER_EXIT(genericScan)
+
+	PROFILER_ENTER(optScan)
+	test_scan_lines(optimized, codes, width, height);
+	PROFILER_EXIT(optScan)
+
+	printf("Results for %" PRIu32 "x%" PRIu32, width, height);
+	PROFILER_PRINT_HEADER
+	PROFILER_PRINT(genericSplit)
+	PROFILER_PRINT(optSplit)
+	PROFILER_PRINT(genericDelta)
+	PROFILER_PRINT(optDelta)
+	PROFILER_PRINT(genericScan)
+	PROFILER_PRINT(optScan)
+	PROFILER_PRINT_FOOTER
+
+	rc = TRUE;
+fail:
+	PROFILER_FREE(genericSplit)
+	PROFILER_FREE(optSplit)
+	PROFILER_FREE(genericDelta)
+	PROFILER_FREE(optDelta)
+	PROFILER_FREE(genericScan)
+	PROFILER_FREE(optScan)
+	winpr_aligned_free(src);
+	winpr_aligned_free(planes);
+	winpr_aligned_free(codes);
+	return rc;
+}
+
+int TestPrimitivesPlanar(int argc, char* argv[])
+{
+	const UINT32 widths[] = { 1, 15, 16, 17, 64, 67 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+	prim_test_setup(FALSE);
+
+	for (size_t x = 0; x < ARRAYSIZE(formats); x++)
+	{
+		for (size_t y = 0; y < ARRAYSIZE(widths); y++)
+		{
+			if (!test_split_merge_func(formats[x], widths[y], 5))
+				return 1;
+		}
+	}
+
+	for (UINT32 len = 0; len < 100; len++)
+	{
+		if (!test_delta_func(len))
+			return 1;
+	}
+
+	for (UINT32 len = 1; len < 200; len += 13)
+	{
+		for (UINT32 alphabet = 1; alphabet <= 4; alphabet++)
+		{
+			if (!test_rle_scan_func(len, alphabet))
+				return 1;
+		}
+	}
+
+	if (!test_planar_speed(1920, 1080))
+		return 1;
+
+	return 0;
+}
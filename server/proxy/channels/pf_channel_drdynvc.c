@@ -113,6 +113,9 @@ static PfChannelResult data_cb(pServerContext* ps, pServerDynamicChannelContext*
 	WINPR_ASSERT(ps->pdata);
 
 	wStream* currentPacket = channelTracker_getCurrentPacket(tracker);
+	if (!currentPacket)
+		return PF_CHANNEL_RESULT_ERROR;
+
 	proxyDynChannelInterceptData dyn = { .name = channel->channelName,
 		                                 .channelId = channel->channelId,
 		                                 .data = currentPacket,
@@ -258,9 +261,10 @@ static PfChannelResult DynvcTrackerPeekFn(ChannelStateTracker* tracker, BOOL fir
 	const char* direction = isBackData ? "B->F" : "F->B";
 
 	{
-		wStream* currentPacket = channelTracker_getCurrentPacket(tracker);
-		s = Stream_StaticConstInit(&sbuffer, Stream_Buffer(currentPacket),
-		                           Stream_GetPosition(currentPacket));
+		/* passed through packets are parsed without copying them */
+		size_t length = 0;
+		const BYTE* data = channelTracker_getCurrentPacketData(tracker, &length);
+		s = Stream_StaticConstInit(&sbuffer, data, length);
 	}
 
 	if (!Stream_CheckAndLogRequiredLengthWLog(dynChannelContext->log, s, 1))
@@ -366,13 +370,12 @@ static PfChannelResult DynvcTrackerPeekFn(ChannelStateTracker* tracker, BOOL fir
 				if ((len == 0) || (len == nameLen) || (dynChannelId > UINT16_MAX))
 					return PF_CHANNEL_RESULT_ERROR;
 
-				wStream* currentPacket = channelTracker_getCurrentPacket(tracker);
 				dev.channel_id = (UINT16)dynChannelId;
 				dev.channel_name = name;
 				dev.data = Stream_Buffer(s);
-				dev.data_len = Stream_GetPosition(currentPacket);
+				dev.data_len = Stream_Length(s);
 				dev.flags = flags;
-				dev.total_size = Stream_GetPosition(currentPacket);
+				dev.total_size = Stream_Length(s);
 
 				if (dynChannel)
 				{
@@ -32,6 +32,8 @@ struct _ChannelStateTracker
 	pServerStaticChannelContext* channel;
 	ChannelTrackerMode mode;
 	wStream* currentPacket;
+	const BYTE* inboundData; /* a packet peeked at in place, see channelTracker_update */
+	size_t inboundLength;
 	size_t currentPacketReceived;
 	size_t currentPacketSize;
 	size_t currentPacketFragments;
@@ -125,14 +127,26 @@ PfChannelResult channelTracker_update(ChannelStateTracker* tracker, const BYTE*
 	{
 		case CHANNEL_TRACKER_PEEK:
 		{
-			wStream* currentPacket = channelTracker_getCurrentPacket(tracker);
-			if (!Stream_EnsureRemainingCapacity(currentPacket, xsize))
-				return PF_CHANNEL_RESULT_ERROR;
-
-			Stream_Write(currentPacket, xdata, xsize);
+			/* A packet in a single chunk is parsed in the inbound buffer, it is only copied if
+			 * the peek function asks for the current packet */
+			if (firstPacket && lastPacket)
+			{
+				tracker->inboundData = xdata;
+				tracker->inboundLength = xsize;
+			}
+			else
+			{
+				wStream* currentPacket = channelTracker_getCurrentPacket(tracker);
+				if (!currentPacket || !Stream_EnsureRemainingCapacity(currentPacket, xsize))
+					return PF_CHANNEL_RESULT_ERROR;
+
+				Stream_Write(currentPacket, xdata, xsize);
+			}
 
 			WINPR_ASSERT(tracker->peekFn);
 			result = tracker->peekFn(tracker, firstPacket, lastPacket);
+			tracker->inboundData = NULL;
+			tracker->inboundLength = 0;
 		}
 		break;
 		case CHANNEL_TRACKER_PASS:
@@ -181,18 +195,24 @@ PfChannelResult channelTracker_flushCurrent(ChannelStateTracker* t, BOOL first,
 	pServerStaticChannelContext* channel = NULL;
 	UINT32 flags = CHANNEL_FLAG_FIRST;
 	BOOL r = 0;
+	size_t length = 0;
 	const char* direction = toBack ? "F->B" : "B->F";
 	const size_t currentPacketSize = channelTracker_getCurrentPacketSize(t);
-	wStream* currentPacket = channelTracker_getCurrentPacket(t);
 
 	WINPR_ASSERT(t);
 
+	(void)channelTracker_getCurrentPacketData(t, &length);
 	WLog_VRB(TAG, "channelTracker_flushCurrent(%s): %s sz=%" PRIuz " first=%d last=%d",
-	         t->channel->channel_name, direction, Stream_GetPosition(currentPacket), first, last);
+	         t->channel->channel_name, direction, length, first, last);
 
+	/* the inbound chunk is forwarded as is */
 	if (first)
 		return PF_CHANNEL_RESULT_PASS;
 
+	wStream* currentPacket = channelTracker_getCurrentPacket(t);
+	if (!currentPacket)
+		return PF_CHANNEL_RESULT_ERROR;
+
 	pdata = t->pdata;
 	channel = t->channel;
 	if (last)
@@ -329,9 +349,34 @@ proxyData* channelTracker_getPData(ChannelStateTracker* tracker)
 wStream* channelTracker_getCurrentPacket(ChannelStateTracker* tracker)
 {
 	WINPR_ASSERT(tracker);
+
+	if (tracker->inboundData)
+	{
+		if (!Stream_EnsureRemainingCapacity(tracker->currentPacket, tracker->inboundLength))
+			return NULL;
+
+		Stream_Write(tracker->currentPacket, tracker->inboundData, tracker->inboundLength);
+		tracker->inboundData = NULL;
+		tracker->inboundLength = 0;
+	}
 	return tracker->currentPacket;
 }
 
+const BYTE* channelTracker_getCurrentPacketData(ChannelStateTracker* tracker, size_t* length)
+{
+	WINPR_ASSERT(tracker);
+	WINPR_ASSERT(length);
+
+	if (tracker->inboundData)
+	{
+		*length = tracker->inboundLength;
+		return tracker->inboundData;
+	}
+
+	*length = Stream_GetPosition(tracker->currentPacket);
+	return Stream_Buffer(tracker->currentPacket);
+}
+
 BOOL channelTracker_setCustomData(ChannelStateTracker* tracker, void* data)
 {
 	WINPR_ASSERT(tracker);
@@ -48,7 +48,10 @@ proxyData* channelTracker_getPData(ChannelStateTracker* tracker);
 BOOL channelTracker_setCustomData(ChannelStateTracker* tracker, void* data);
 void* channelTracker_getCustomData(ChannelStateTracker* tracker);
 
+/* Copies a packet peeked at in the inbound buffer, use it to modify or keep the packet */
 wStream* channelTracker_getCurrentPacket(ChannelStateTracker* tracker);
+/* The current packet, without copying it */
+const BYTE* channelTracker_getCurrentPacketData(ChannelStateTracker* tracker, size_t* length);
 
 size_t channelTracker_getCurrentPacketSize(ChannelStateTracker* tracker);
 BOOL channelTracker_setCurrentPacketSize(ChannelStateTracker* tracker, size_t size);
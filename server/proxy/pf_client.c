@@ -39,6 +39,7 @@
 #include <freerdp/channels/channels.h>
 
 #include "pf_client.h"
+#include "pf_reactor.h"
 #include "pf_channel.h"
 #include <freerdp/server/proxy/proxy_context.h>
 #include "pf_update.h"
@@ -515,11 +516,34 @@ static BOOL pf_client_on_server_heartbeat(freerdp* instance, BYTE period, BYTE c
 	return freerdp_heartbeat_send_heartbeat_pdu(ps->context.peer, period, count1, count2);
 }
 
+static BOOL pf_client_send_channel_packet(pClientContext* pc, const proxyChannelDataEventInfo* ev)
+{
+	WINPR_ASSERT(pc);
+	WINPR_ASSERT(ev);
+	WINPR_ASSERT(pc->context.instance);
+
+	const UINT16 channelId =
+	    freerdp_channels_get_id_by_name(pc->context.instance, ev->channel_name);
+	/* Ignore unmappable channels */
+	if ((channelId == 0) || (channelId == UINT16_MAX))
+		return TRUE;
+
+	WINPR_ASSERT(pc->context.instance->SendChannelPacket);
+	return pc->context.instance->SendChannelPacket(pc->context.instance, channelId, ev->total_size,
+	                                               ev->flags, ev->data, ev->data_len);
+}
+
 static BOOL pf_client_send_channel_data(pClientContext* pc, const proxyChannelDataEventInfo* ev)
 {
 	WINPR_ASSERT(pc);
 	WINPR_ASSERT(ev);
 
+	/* An I/O thread processes both legs of the session, the chunk is sent from the inbound
+	 * buffer unless older chunks are still queued */
+	if (pc->connected && pf_reactor_owns_client(pc) &&
+	    (Queue_Count(pc->cached_server_channel_data) == 0))
+		return pf_client_send_channel_packet(pc, ev);
+
 	return Queue_Enqueue(pc->cached_server_channel_data, ev);
 }
 
@@ -536,20 +560,7 @@ static BOOL sendQueuedChannelData(pClientContext* pc)
 		Queue_Lock(pc->cached_server_channel_data);
 		while (rc && (ev = Queue_Dequeue(pc->cached_server_channel_data)))
 		{
-			UINT16 channelId = 0;
-			WINPR_ASSERT(pc->context.instance);
-
-			channelId = freerdp_channels_get_id_by_name(pc->context.instance, ev->channel_name);
-			/* Ignore unmappable channels */
-			if ((channelId == 0) || (channelId == UINT16_MAX))
-				rc = TRUE;
-			else
-			{
-				WINPR_ASSERT(pc->context.instance->SendChannelPacket);
-				rc = pc->context.instance->SendChannelPacket(pc->context.instance, channelId,
-				                                             ev->total_size, ev->flags, ev->data,
-				                                             ev->data_len);
-			}
+			rc = pf_client_send_channel_packet(pc, ev);
 			channel_data_free(ev);
 		}
 
@@ -816,26 +827,46 @@ out:
 	return rc;
 }
 
-/**
- * RDP main loop.
- * Connects RDP, loops while running and handles event and dispatch, cleans up
- * after the connection ends.
- */
-static DWORD WINAPI pf_client_thread_proc(pClientContext* pc)
+BOOL pf_client_open(pClientContext* pc)
 {
-	freerdp* instance = NULL;
-	proxyData* pdata = NULL;
-	DWORD nCount = 0;
-	DWORD status = 0;
-	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
-
 	WINPR_ASSERT(pc);
 
-	instance = pc->context.instance;
+	freerdp* instance = pc->context.instance;
 	WINPR_ASSERT(instance);
 
-	pdata = pc->pdata;
+	proxyData* pdata = pc->pdata;
 	WINPR_ASSERT(pdata);
+
+	if (freerdp_client_start(&pc->context) != 0)
+		goto fail_stop;
+
+	if (!pf_modules_run_hook(pdata->module, HOOK_TYPE_CLIENT_INIT_CONNECT, pdata, pc))
+		goto fail;
+
+	if (!pf_client_connect(instance))
+		goto fail;
+
+	return TRUE;
+
+fail:
+	proxy_data_abort_connect(pdata);
+	pf_modules_run_hook(pdata->module, HOOK_TYPE_CLIENT_UNINIT_CONNECT, pdata, pc);
+fail_stop:
+	freerdp_client_stop(&pc->context);
+	return FALSE;
+}
+
+DWORD pf_client_get_event_handles(pClientContext* pc, HANDLE* events, DWORD count)
+{
+	DWORD nCount = 0;
+
+	WINPR_ASSERT(pc);
+	WINPR_ASSERT(pc->pdata);
+	WINPR_ASSERT(events);
+
+	if (count < 2)
+		return 0;
+
 	/*
 	 * during redirection, freerdp's abort event might be overridden (reset) by the library, after
 	 * the server set it in order to shutdown the connection. it means that the server might signal
@@ -843,33 +874,70 @@ static DWORD WINAPI pf_client_thread_proc(pClientContext* pc)
 	 * continue its work instead of exiting. That's why the client must wait on `pdata->abort_event`
 	 * too, which will never be modified by the library.
 	 */
-	handles[nCount++] = pdata->abort_event;
+	events[nCount++] = pc->pdata->abort_event;
+	events[nCount++] = Queue_Event(pc->cached_server_channel_data);
 
-	if (!pf_modules_run_hook(pdata->module, HOOK_TYPE_CLIENT_INIT_CONNECT, pdata, pc))
+	const DWORD tmp = freerdp_get_event_handles(&pc->context, &events[nCount], count - nCount);
+	if (tmp == 0)
 	{
-		proxy_data_abort_connect(pdata);
-		goto end;
+		PROXY_LOG_ERR(TAG, pc, "freerdp_get_event_handles failed!");
+		return 0;
 	}
 
-	if (!pf_client_connect(instance))
+	return nCount + tmp;
+}
+
+BOOL pf_client_check_event_handles(pClientContext* pc)
+{
+	WINPR_ASSERT(pc);
+
+	if (freerdp_shall_disconnect_context(&pc->context))
+		return FALSE;
+
+	if (proxy_data_shall_disconnect(pc->pdata))
+		return FALSE;
+
+	if (!freerdp_check_event_handles(&pc->context))
 	{
-		proxy_data_abort_connect(pdata);
-		goto end;
+		if (freerdp_get_last_error(&pc->context) == FREERDP_ERROR_SUCCESS)
+			WLog_ERR(TAG, "Failed to check FreeRDP event handles");
+
+		return FALSE;
 	}
-	handles[nCount++] = Queue_Event(pc->cached_server_channel_data);
 
-	while (!freerdp_shall_disconnect_context(instance->context))
-	{
-		UINT32 tmp = freerdp_get_event_handles(instance->context, &handles[nCount],
-		                                       ARRAYSIZE(handles) - nCount);
+	sendQueuedChannelData(pc);
+	return TRUE;
+}
 
-		if (tmp == 0)
-		{
-			PROXY_LOG_ERR(TAG, pc, "freerdp_get_event_handles failed!");
+void pf_client_close(pClientContext* pc)
+{
+	WINPR_ASSERT(pc);
+
+	proxyData* pdata = pc->pdata;
+	WINPR_ASSERT(pdata);
+
+	freerdp_disconnect(pc->context.instance);
+	pf_modules_run_hook(pdata->module, HOOK_TYPE_CLIENT_UNINIT_CONNECT, pdata, pc);
+	freerdp_client_stop(&pc->context);
+}
+
+/**
+ * RDP main loop.
+ * Loops while running and handles event and dispatch, cleans up after the connection ends.
+ */
+static void pf_client_thread_proc(pClientContext* pc)
+{
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+
+	WINPR_ASSERT(pc);
+
+	while (!freerdp_shall_disconnect_context(&pc->context))
+	{
+		const DWORD nCount = pf_client_get_event_handles(pc, handles, ARRAYSIZE(handles));
+		if (nCount == 0)
 			break;
-		}
 
-		status = WaitForMultipleObjects(nCount + tmp, handles, FALSE, INFINITE);
+		const DWORD status = WaitForMultipleObjects(nCount, handles, FALSE, INFINITE);
 
 		if (status == WAIT_FAILED)
 		{
@@ -881,28 +949,11 @@ static DWORD WINAPI pf_client_thread_proc(pClientContext* pc)
 		if (status == WAIT_OBJECT_0)
 			break;
 
-		if (freerdp_shall_disconnect_context(instance->context))
-			break;
-
-		if (proxy_data_shall_disconnect(pdata))
-			break;
-
-		if (!freerdp_check_event_handles(instance->context))
-		{
-			if (freerdp_get_last_error(instance->context) == FREERDP_ERROR_SUCCESS)
-				WLog_ERR(TAG, "Failed to check FreeRDP event handles");
-
+		if (!pf_client_check_event_handles(pc))
 			break;
-		}
-		sendQueuedChannelData(pc);
 	}
 
-	freerdp_disconnect(instance);
-
-end:
-	pf_modules_run_hook(pdata->module, HOOK_TYPE_CLIENT_UNINIT_CONNECT, pdata, pc);
-
-	return 0;
+	pf_client_close(pc);
 }
 
 static int pf_logon_error_info(freerdp* instance, UINT32 data, UINT32 type)
@@ -969,57 +1020,34 @@ static int pf_client_verify_X509_certificate(freerdp* instance, const BYTE* data
 
 void channel_data_free(void* obj)
 {
-	union
-	{
-		const void* cpv;
-		void* pv;
-	} cnv;
-	proxyChannelDataEventInfo* dst = obj;
-	if (dst)
-	{
-		cnv.cpv = dst->data;
-		free(cnv.pv);
-
-		cnv.cpv = dst->channel_name;
-		free(cnv.pv);
-		free(dst);
-	}
+	free(obj);
 }
 
+/* The event, its data and the channel name are copied to a single allocation */
 static void* channel_data_copy(const void* obj)
 {
-	union
-	{
-		const void* cpv;
-		void* pv;
-	} cnv;
 	const proxyChannelDataEventInfo* src = obj;
-	proxyChannelDataEventInfo* dst = NULL;
 
 	WINPR_ASSERT(src);
 
-	dst = calloc(1, sizeof(proxyChannelDataEventInfo));
-	if (!dst)
-		goto fail;
+	const size_t nameLen = src->channel_name ? strlen(src->channel_name) + 1 : 0;
+	BYTE* buffer = malloc(sizeof(proxyChannelDataEventInfo) + src->data_len + nameLen);
+	if (!buffer)
+		return NULL;
+
+	proxyChannelDataEventInfo* dst = (proxyChannelDataEventInfo*)buffer;
+	BYTE* data = &buffer[sizeof(proxyChannelDataEventInfo)];
 
 	*dst = *src;
+	memcpy(data, src->data, src->data_len);
+	dst->data = data;
 	if (src->channel_name)
 	{
-		dst->channel_name = _strdup(src->channel_name);
-		if (!dst->channel_name)
-			goto fail;
+		char* name = (char*)&data[src->data_len];
+		memcpy(name, src->channel_name, nameLen);
+		dst->channel_name = name;
 	}
-	dst->data = malloc(src->data_len);
-	if (!dst->data)
-		goto fail;
-
-	cnv.cpv = dst->data;
-	memcpy(cnv.pv, src->data, src->data_len);
 	return dst;
-
-fail:
-	channel_data_free(dst);
-	return NULL;
 }
 
 static BOOL pf_client_client_new(freerdp* instance, rdpContext* context)
@@ -1101,12 +1129,12 @@ int RdpClientEntry(RDP_CLIENT_ENTRY_POINTS* pEntryPoints)
  */
 DWORD WINAPI pf_client_start(LPVOID arg)
 {
-	DWORD rc = 1;
 	pClientContext* pc = (pClientContext*)arg;
 
 	WINPR_ASSERT(pc);
-	if (freerdp_client_start(&pc->context) == 0)
-		rc = pf_client_thread_proc(pc);
-	freerdp_client_stop(&pc->context);
-	return rc;
+	if (!pf_client_open(pc))
+		return 1;
+
+	pf_client_thread_proc(pc);
+	return 0;
 }
@@ -25,7 +25,20 @@
 #include <freerdp/freerdp.h>
 #include <winpr/wtypes.h>
 
+#include <freerdp/server/proxy/proxy_context.h>
+
 int RdpClientEntry(RDP_CLIENT_ENTRY_POINTS* pEntryPoints);
+
+/* Runs the whole client connection, the thread function of the thread per peer mode */
 DWORD WINAPI pf_client_start(LPVOID arg);
 
+/* Starts the client and connects to the target. Blocks until the connection sequence is done.
+ * On failure the connection is aborted and cleaned up, pf_client_close must not be called */
+BOOL pf_client_open(pClientContext* pc);
+DWORD pf_client_get_event_handles(pClientContext* pc, HANDLE* events, DWORD count);
+
+/* Processes pending data without blocking, returns FALSE when the connection ended */
+BOOL pf_client_check_event_handles(pClientContext* pc);
+void pf_client_close(pClientContext* pc);
+
 #endif /* FREERDP_SERVER_PROXY_PFCLIENT_H */
@@ -28,6 +28,7 @@
 #include <winpr/cmdline.h>
 
 #include "pf_server.h"
+#include "pf_reactor.h"
 #include <freerdp/server/proxy/proxy_config.h>
 
 #include <freerdp/server/proxy/proxy_log.h>
@@ -67,6 +68,8 @@ static const char* boolstr(BOOL rc)
 static const char* section_server = "Server";
 static const char* key_host = "Host";
 static const char* key_port = "Port";
+static const char* key_server_io_threads = "IOThreads";
+static const char* key_server_xcrush_level = "XCrushCompressionLevel";
 
 static const char* section_target = "Target";
 static const char* key_target_fixed = "FixedTarget";
@@ -225,6 +228,26 @@ static BOOL pf_config_load_server(wIniFile* ini, proxyConfig* config)
 	const char* host = NULL;
 
 	WINPR_ASSERT(config);
+	if (!pf_config_get_uint32(ini, section_server, key_server_io_threads, &config->IOThreads,
+	                          FALSE))
+		return FALSE;
+	if (config->IOThreads > PF_REACTOR_MAX_THREADS)
+	{
+		WLog_WARN(TAG, "%s.%s=%" PRIu32 " is too large, using %d", section_server,
+		          key_server_io_threads, config->IOThreads, PF_REACTOR_MAX_THREADS);
+		config->IOThreads = PF_REACTOR_MAX_THREADS;
+	}
+
+	if (!pf_config_get_uint32(ini, section_server, key_server_xcrush_level,
+	                          &config->XCrushCompressionLevel, FALSE))
+		return FALSE;
+	if (config->XCrushCompressionLevel > XCRUSH_LEVEL_BEST)
+	{
+		WLog_ERR(TAG, "invalid value %" PRIu32 " for key '%s.%s'.", config->XCrushCompressionLevel,
+		         section_server, key_server_xcrush_level);
+		return FALSE;
+	}
+
 	host = pf_config_get_str(ini, section_server, key_host, FALSE);
 
 	if (!host)
@@ -555,6 +578,7 @@ proxyConfig* server_config_load_ini(wIniFile* ini)
 	{
 		/* Set default values != 0 */
 		config->TargetTlsSecLevel = 1;
+		config->XCrushCompressionLevel = XCRUSH_LEVEL_DEFAULT;
 
 		/* Load from ini */
 		if (!pf_config_load_server(ini, config))
@@ -603,6 +627,11 @@ BOOL pf_server_config_dump(const char* file)
 		goto fail;
 	if (IniFile_SetKeyValueInt(ini, section_server, key_port, 3389) < 0)
 		goto fail;
+	if (IniFile_SetKeyValueInt(ini, section_server, key_server_io_threads, 0) < 0)
+		goto fail;
+	if (IniFile_SetKeyValueInt(ini, section_server, key_server_xcrush_level,
+	                           XCRUSH_LEVEL_DEFAULT) < 0)
+		goto fail;
 
 	/* Target configuration */
 	if (IniFile_SetKeyValueString(ini, section_target, key_host, "somehost.example.com") < 0)
@@ -770,6 +799,8 @@ void pf_server_config_print(const proxyConfig* config)
 	CONFIG_PRINT_SECTION(section_server);
 	CONFIG_PRINT_STR(config, Host);
 	CONFIG_PRINT_UINT16(config, Port);
+	CONFIG_PRINT_UINT32(config, IOThreads);
+	CONFIG_PRINT_UINT32(config, XCrushCompressionLevel);
 
 	if (config->FixedTarget)
 	{
@@ -0,0 +1,690 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <errno.h>
+
+#include <winpr/assert.h>
+#include <winpr/collections.h>
+#include <winpr/interlocked.h>
+#include <winpr/pool.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+#include <winpr/thread.h>
+
+#include <freerdp/server/proxy/proxy_log.h>
+
+#include "pf_client.h"
+#include "pf_reactor.h"
+#include "pf_server.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/epoll.h>
+#endif
+
+#define TAG PROXY_TAG("reactor")
+
+#if defined(__linux__)
+
+/* Sessions without events are still polled, like the thread per peer mode does */
+#define PF_REACTOR_POLL_INTERVAL 1000
+#define PF_REACTOR_MAX_EVENTS 128
+
+/* Connecting blocks on the network for most of the time, allow a few in parallel */
+#define PF_REACTOR_CONNECTS_PER_THREAD 8
+
+enum
+{
+	PF_REACTOR_ADD_PEER = 1,
+	PF_REACTOR_CLIENT_CONNECTED
+};
+
+typedef struct s_pf_reactor_thread pfReactorThread;
+
+typedef struct
+{
+	pfReactorThread* owner;
+	freerdp_peer* peer;
+	pClientContext* pc;
+
+	PTP_WORK connect; /* connecting to the target, on a worker thread */
+	BOOL connected;   /* result of the connect, written by the worker */
+	BOOL peerOpen;
+	BOOL clientOpen;
+
+	UINT64 generation;
+
+	/* file descriptors registered with the epoll instance of the owner */
+	int fds[2 * MAXIMUM_WAIT_OBJECTS];
+	size_t fdCount;
+} pfReactorSession;
+
+struct s_pf_reactor_thread
+{
+	proxyReactor* reactor;
+	HANDLE thread;
+	int epfd;
+	wMessageQueue* queue;
+	wArrayList* sessions;
+	volatile LONG load;
+	UINT64 generation;
+};
+
+struct proxy_reactor
+{
+	proxyServer* server;
+
+	PTP_POOL pool;
+	TP_CALLBACK_ENVIRON env;
+
+	pfReactorThread* threads;
+	size_t count;
+};
+
+/* The session a I/O thread is processing, pf_server_post_connect runs inside of it */
+static WINPR_TLS pfReactorSession* pf_reactor_current = NULL;
+
+static BOOL pf_reactor_epoll_ctl(pfReactorThread* thread, int op, int fd, void* ptr)
+{
+	struct epoll_event event = { 0 };
+
+	WINPR_ASSERT(thread);
+
+	event.events = EPOLLIN;
+	event.data.ptr = ptr;
+	if (epoll_ctl(thread->epfd, op, fd, &event) == 0)
+		return TRUE;
+
+	/* a file descriptor closed by the session is removed from the epoll instance already */
+	if ((op == EPOLL_CTL_DEL) && ((errno == EBADF) || (errno == ENOENT)))
+		return TRUE;
+
+	WLog_ERR(TAG, "epoll_ctl(%d, %d) failed with %s [%d]", op, fd, strerror(errno), errno);
+	return FALSE;
+}
+
+static size_t pf_reactor_session_collect(pfReactorSession* session, int* fds, size_t size)
+{
+	HANDLE events[MAXIMUM_WAIT_OBJECTS] = { 0 };
+	size_t count = 0;
+
+	WINPR_ASSERT(session);
+	WINPR_ASSERT(fds);
+
+	for (size_t leg = 0; leg < 2; leg++)
+	{
+		DWORD nCount = 0;
+
+		if ((leg == 0) && session->peerOpen)
+			nCount = pf_server_peer_get_event_handles(session->peer, events, ARRAYSIZE(events));
+		else if ((leg == 1) && session->clientOpen)
+			nCount = pf_client_get_event_handles(session->pc, events, ARRAYSIZE(events));
+		else
+			continue;
+
+		if (nCount == 0)
+			return 0;
+
+		for (DWORD x = 0; x < nCount; x++)
+		{
+			BOOL known = FALSE;
+			const int fd = GetEventFileDescriptor(events[x]);
+			if (fd < 0)
+				return 0;
+
+			/* both legs wait for the abort event */
+			for (size_t y = 0; y < count; y++)
+				known |= (fds[y] == fd);
+
+			if (!known && (count < size))
+				fds[count++] = fd;
+		}
+	}
+
+	return count;
+}
+
+/* The event handles of a connection change, e.g. after TLS or a redirection */
+static BOOL pf_reactor_session_register(pfReactorSession* session)
+{
+	int fds[ARRAYSIZE(session->fds)] = { 0 };
+
+	WINPR_ASSERT(session);
+
+	const size_t count = pf_reactor_session_collect(session, fds, ARRAYSIZE(fds));
+	if ((count == 0) && (session->peerOpen || session->clientOpen))
+		return FALSE;
+
+	for (size_t x = 0; x < session->fdCount; x++)
+	{
+		BOOL keep = FALSE;
+		for (size_t y = 0; y < count; y++)
+			keep |= (session->fds[x] == fds[y]);
+
+		if (!keep)
+			(void)pf_reactor_epoll_ctl(session->owner, EPOLL_CTL_DEL, session->fds[x], NULL);
+	}
+
+	for (size_t y = 0; y < count; y++)
+	{
+		BOOL known = FALSE;
+		for (size_t x = 0; x < session->fdCount; x++)
+			known |= (session->fds[x] == fds[y]);
+
+		if (!known && !pf_reactor_epoll_ctl(session->owner, EPOLL_CTL_ADD, fds[y], session))
+		{
+			/* keep track of what is registered, so the session can clean up */
+			memcpy(session->fds, fds, y * sizeof(int));
+			session->fdCount = y;
+			return FALSE;
+		}
+	}
+
+	memcpy(session->fds, fds, count * sizeof(int));
+	session->fdCount = count;
+	return TRUE;
+}
+
+static void pf_reactor_session_close(pfReactorSession* session)
+{
+	WINPR_ASSERT(session);
+
+	if (session->peerOpen)
+	{
+		session->peerOpen = FALSE;
+		pf_server_peer_close(session->peer);
+	}
+
+	if (session->clientOpen)
+	{
+		session->clientOpen = FALSE;
+		pf_client_close(session->pc);
+	}
+}
+
+static BOOL pf_reactor_session_done(const pfReactorSession* session)
+{
+	WINPR_ASSERT(session);
+	return !session->peerOpen && !session->clientOpen && !session->connect;
+}
+
+static void pf_reactor_session_free(pfReactorSession* session)
+{
+	if (!session)
+		return;
+
+	pfReactorThread* thread = session->owner;
+	WINPR_ASSERT(thread);
+
+	for (size_t x = 0; x < session->fdCount; x++)
+		(void)pf_reactor_epoll_ctl(thread, EPOLL_CTL_DEL, session->fds[x], NULL);
+
+	pf_server_peer_free(session->peer);
+	(void)InterlockedDecrement(&thread->load);
+	free(session);
+}
+
+/* Processes both legs of a session without blocking */
+static void pf_reactor_session_step(pfReactorSession* session)
+{
+	WINPR_ASSERT(session);
+
+	pf_reactor_current = session;
+	if (session->peerOpen && !pf_server_peer_check_event_handles(session->peer))
+	{
+		session->peerOpen = FALSE;
+		pf_server_peer_close(session->peer);
+	}
+
+	if (session->clientOpen && !pf_client_check_event_handles(session->pc))
+	{
+		session->clientOpen = FALSE;
+		pf_client_close(session->pc);
+	}
+	pf_reactor_current = NULL;
+
+	/* the client connection is useless without the peer */
+	if (!session->peerOpen)
+		pf_reactor_session_close(session);
+
+	if (!pf_reactor_session_register(session))
+		pf_reactor_session_close(session);
+}
+
+static VOID CALLBACK pf_reactor_connect_work(PTP_CALLBACK_INSTANCE instance, PVOID context,
+                                             PTP_WORK work)
+{
+	pfReactorSession* session = context;
+
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+	WINPR_ASSERT(session);
+
+	session->connected = pf_client_open(session->pc);
+	if (!MessageQueue_Post(session->owner->queue, session, PF_REACTOR_CLIENT_CONNECTED, NULL,
+	                       NULL))
+		WLog_ERR(TAG, "failed to notify I/O thread");
+}
+
+static void pf_reactor_client_connected(pfReactorSession* session)
+{
+	WINPR_ASSERT(session);
+	WINPR_ASSERT(session->connect);
+
+	WaitForThreadpoolWorkCallbacks(session->connect, FALSE);
+	CloseThreadpoolWork(session->connect);
+	session->connect = NULL;
+
+	if (!session->connected)
+		return;
+
+	session->clientOpen = TRUE;
+	if (!session->peerOpen || !pf_reactor_session_register(session))
+		pf_reactor_session_close(session);
+}
+
+static pfReactorSession* pf_reactor_session_new(pfReactorThread* thread, freerdp_peer* client)
+{
+	WINPR_ASSERT(thread);
+	WINPR_ASSERT(client);
+
+	pfReactorSession* session = calloc(1, sizeof(pfReactorSession));
+	if (!session)
+	{
+		freerdp_peer_free(client);
+		(void)InterlockedDecrement(&thread->load);
+		return NULL;
+	}
+
+	session->owner = thread;
+	session->peer = client;
+
+	/* Opening the peer might start connecting to the target, the connect work then posts
+	 * PF_REACTOR_CLIENT_CONNECTED for this session. From here on the session is only freed by
+	 * the sweep, which waits for that. */
+	if (!ArrayList_Append(thread->sessions, session))
+	{
+		pf_reactor_session_free(session);
+		return NULL;
+	}
+
+	pf_reactor_current = session;
+	session->peerOpen = pf_server_peer_open(client);
+	pf_reactor_current = NULL;
+
+	if (!session->peerOpen || !pf_reactor_session_register(session))
+		pf_reactor_session_close(session);
+
+	return session;
+}
+
+/* Returns FALSE when the thread was asked to quit */
+static BOOL pf_reactor_thread_dispatch(pfReactorThread* thread)
+{
+	WINPR_ASSERT(thread);
+
+	while (TRUE)
+	{
+		wMessage message = { 0 };
+
+		if (MessageQueue_Peek(thread->queue, &message, TRUE) <= 0)
+			return message.id != WMQ_QUIT;
+
+		switch (message.id)
+		{
+			case PF_REACTOR_ADD_PEER:
+				(void)pf_reactor_session_new(thread, message.context);
+				break;
+			case PF_REACTOR_CLIENT_CONNECTED:
+				pf_reactor_client_connected(message.context);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+/* Peers queued but never opened, the I/O thread is gone */
+static void pf_reactor_thread_drain(pfReactorThread* thread)
+{
+	WINPR_ASSERT(thread);
+
+	while (MessageQueue_Size(thread->queue) > 0)
+	{
+		wMessage message = { 0 };
+
+		(void)MessageQueue_Peek(thread->queue, &message, TRUE);
+		if (message.id == PF_REACTOR_ADD_PEER)
+		{
+			freerdp_peer_free(message.context);
+			(void)InterlockedDecrement(&thread->load);
+		}
+	}
+}
+
+static void pf_reactor_thread_sweep(pfReactorThread* thread)
+{
+	WINPR_ASSERT(thread);
+
+	for (size_t x = ArrayList_Count(thread->sessions); x > 0; x--)
+	{
+		pfReactorSession* session = ArrayList_GetItem(thread->sessions, x - 1);
+		if (pf_reactor_session_done(session))
+		{
+			ArrayList_RemoveAt(thread->sessions, x - 1);
+			pf_reactor_session_free(session);
+		}
+	}
+}
+
+static void pf_reactor_thread_shutdown(pfReactorThread* thread)
+{
+	WINPR_ASSERT(thread);
+
+	for (size_t x = 0; x < ArrayList_Count(thread->sessions); x++)
+	{
+		pfReactorSession* session = ArrayList_GetItem(thread->sessions, x);
+		const pServerContext* ps = (const pServerContext*)session->peer->context;
+
+		PROXY_LOG_INFO(TAG, ps, "Server shutting down, terminating peer");
+		pf_reactor_session_close(session);
+		if (session->connect)
+			pf_reactor_client_connected(session);
+	}
+
+	pf_reactor_thread_sweep(thread);
+	pf_reactor_thread_drain(thread);
+}
+
+static DWORD WINAPI pf_reactor_thread_proc(LPVOID arg)
+{
+	struct epoll_event events[PF_REACTOR_MAX_EVENTS] = { 0 };
+	pfReactorThread* thread = arg;
+	BOOL running = TRUE;
+	UINT64 lastPoll = GetTickCount64();
+
+	WINPR_ASSERT(thread);
+
+	while (running)
+	{
+		const int status = epoll_wait(thread->epfd, events, ARRAYSIZE(events),
+		                              PF_REACTOR_POLL_INTERVAL);
+		if (status < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			WLog_ERR(TAG, "epoll_wait failed with %s [%d]", strerror(errno), errno);
+			break;
+		}
+
+		/* sessions with several ready descriptors are processed once per wakeup */
+		thread->generation++;
+
+		for (int x = 0; x < status; x++)
+		{
+			void* ptr = events[x].data.ptr;
+
+			if (!ptr)
+				running = FALSE;
+			else if (ptr == thread)
+				running &= pf_reactor_thread_dispatch(thread);
+			else
+			{
+				pfReactorSession* session = ptr;
+				if (session->generation == thread->generation)
+					continue;
+
+				session->generation = thread->generation;
+				pf_reactor_session_step(session);
+			}
+		}
+
+		const UINT64 now = GetTickCount64();
+		if (now - lastPoll >= PF_REACTOR_POLL_INTERVAL)
+		{
+			lastPoll = now;
+			for (size_t x = 0; x < ArrayList_Count(thread->sessions); x++)
+			{
+				pfReactorSession* session = ArrayList_GetItem(thread->sessions, x);
+				if (session->generation != thread->generation)
+					pf_reactor_session_step(session);
+			}
+		}
+
+		/* sessions are only freed here, no event of the batch refers to them anymore */
+		pf_reactor_thread_sweep(thread);
+	}
+
+	pf_reactor_thread_shutdown(thread);
+	return 0;
+}
+
+static void pf_reactor_thread_uninit(pfReactorThread* thread)
+{
+	WINPR_ASSERT(thread);
+
+	if (thread->thread)
+	{
+		(void)MessageQueue_PostQuit(thread->queue, 0);
+		(void)WaitForSingleObject(thread->thread, INFINITE);
+		(void)CloseHandle(thread->thread);
+	}
+
+	if (thread->queue)
+		pf_reactor_thread_drain(thread);
+
+	ArrayList_Free(thread->sessions);
+	MessageQueue_Free(thread->queue);
+	if (thread->epfd >= 0)
+		close(thread->epfd);
+}
+
+static BOOL pf_reactor_thread_init(proxyReactor* reactor, pfReactorThread* thread)
+{
+	WINPR_ASSERT(reactor);
+	WINPR_ASSERT(thread);
+
+	thread->reactor = reactor;
+	thread->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (thread->epfd < 0)
+		return FALSE;
+
+	thread->queue = MessageQueue_New(NULL);
+	thread->sessions = ArrayList_New(FALSE);
+	if (!thread->queue || !thread->sessions)
+		return FALSE;
+
+	/* the stop event is shared, data.ptr distinguishes it from the queue and the sessions */
+	const int stopFd = GetEventFileDescriptor(reactor->server->stopEvent);
+	const int queueFd = GetEventFileDescriptor(MessageQueue_Event(thread->queue));
+	if ((stopFd < 0) || (queueFd < 0))
+		return FALSE;
+
+	if (!pf_reactor_epoll_ctl(thread, EPOLL_CTL_ADD, stopFd, NULL) ||
+	    !pf_reactor_epoll_ctl(thread, EPOLL_CTL_ADD, queueFd, thread))
+		return FALSE;
+
+	thread->thread = CreateThread(NULL, 0, pf_reactor_thread_proc, thread, 0, NULL);
+	return thread->thread != NULL;
+}
+
+proxyReactor* pf_reactor_new(proxyServer* server, UINT32 threads)
+{
+	WINPR_ASSERT(server);
+	WINPR_ASSERT(server->stopEvent);
+
+	if (threads == 0)
+		return NULL;
+
+	if (threads > PF_REACTOR_MAX_THREADS)
+	{
+		WLog_WARN(TAG, "%" PRIu32 " I/O threads requested, using %d", threads,
+		          PF_REACTOR_MAX_THREADS);
+		threads = PF_REACTOR_MAX_THREADS;
+	}
+
+	proxyReactor* reactor = calloc(1, sizeof(proxyReactor));
+	if (!reactor)
+		return NULL;
+
+	reactor->server = server;
+	reactor->pool = CreateThreadpool(NULL);
+	if (!reactor->pool)
+		goto fail;
+	/* the pool does not grow on demand */
+	SetThreadpoolThreadMaximum(reactor->pool, threads * PF_REACTOR_CONNECTS_PER_THREAD);
+	if (!SetThreadpoolThreadMinimum(reactor->pool, threads * PF_REACTOR_CONNECTS_PER_THREAD))
+		goto fail;
+	InitializeThreadpoolEnvironment(&reactor->env);
+	SetThreadpoolCallbackPool(&reactor->env, reactor->pool);
+
+	reactor->threads = calloc(threads, sizeof(pfReactorThread));
+	if (!reactor->threads)
+		goto fail;
+
+	for (size_t x = 0; x < threads; x++)
+	{
+		reactor->threads[x].epfd = -1;
+		reactor->count++;
+		if (!pf_reactor_thread_init(reactor, &reactor->threads[x]))
+			goto fail;
+	}
+
+	WLog_INFO(TAG, "using %" PRIu32 " I/O threads", threads);
+	return reactor;
+
+fail:
+	WLog_ERR(TAG, "failed to create I/O threads, using a thread per peer");
+	pf_reactor_free(reactor);
+	return NULL;
+}
+
+void pf_reactor_free(proxyReactor* reactor)
+{
+	if (!reactor)
+		return;
+
+	/* the I/O threads run until the server stops, or until they are told to quit */
+	for (size_t x = 0; x < reactor->count; x++)
+		pf_reactor_thread_uninit(&reactor->threads[x]);
+	free(reactor->threads);
+
+	if (reactor->pool)
+	{
+		CloseThreadpool(reactor->pool);
+		DestroyThreadpoolEnvironment(&reactor->env);
+	}
+	free(reactor);
+}
+
+BOOL pf_reactor_add_peer(proxyReactor* reactor, freerdp_peer* client)
+{
+	WINPR_ASSERT(reactor);
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(reactor->count > 0);
+
+	if (WaitForSingleObject(reactor->server->stopEvent, 0) == WAIT_OBJECT_0)
+		return FALSE;
+
+	pfReactorThread* thread = &reactor->threads[0];
+	for (size_t x = 1; x < reactor->count; x++)
+	{
+		if (reactor->threads[x].load < thread->load)
+			thread = &reactor->threads[x];
+	}
+
+	(void)InterlockedIncrement(&thread->load);
+	if (!MessageQueue_Post(thread->queue, client, PF_REACTOR_ADD_PEER, NULL, NULL))
+	{
+		(void)InterlockedDecrement(&thread->load);
+		return FALSE;
+	}
+
+	WLog_DBG(TAG, "Added peer, %" PRId32 " sessions on I/O thread %" PRIuz, thread->load,
+	         (size_t)(thread - reactor->threads));
+	return TRUE;
+}
+
+BOOL pf_reactor_start_client(proxyReactor* reactor, pClientContext* pc)
+{
+	WINPR_ASSERT(reactor);
+	WINPR_ASSERT(pc);
+
+	pfReactorSession* session = pf_reactor_current;
+	if (!session || session->connect || session->pc)
+	{
+		WLog_ERR(TAG, "no session to connect to the target");
+		return FALSE;
+	}
+
+	session->pc = pc;
+	session->connect = CreateThreadpoolWork(pf_reactor_connect_work, session, &reactor->env);
+	if (!session->connect)
+		return FALSE;
+
+	SubmitThreadpoolWork(session->connect);
+	return TRUE;
+}
+
+BOOL pf_reactor_owns_client(const pClientContext* pc)
+{
+	const pfReactorSession* session = pf_reactor_current;
+
+	WINPR_ASSERT(pc);
+	return session && (session->pc == pc) && session->clientOpen;
+}
+
+#else
+
+proxyReactor* pf_reactor_new(proxyServer* server, UINT32 threads)
+{
+	WINPR_UNUSED(server);
+
+	if (threads > 0)
+		WLog_WARN(TAG, "I/O threads are not supported on this platform, using a thread per peer");
+	return NULL;
+}
+
+void pf_reactor_free(proxyReactor* reactor)
+{
+	WINPR_ASSERT(!reactor);
+}
+
+BOOL pf_reactor_add_peer(proxyReactor* reactor, freerdp_peer* client)
+{
+	WINPR_UNUSED(reactor);
+	WINPR_UNUSED(client);
+	return FALSE;
+}
+
+BOOL pf_reactor_start_client(proxyReactor* reactor, pClientContext* pc)
+{
+	WINPR_UNUSED(reactor);
+	WINPR_UNUSED(pc);
+	return FALSE;
+}
+
+BOOL pf_reactor_owns_client(const pClientContext* pc)
+{
+	WINPR_UNUSED(pc);
+	return FALSE;
+}
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * FreeRDP Proxy Server
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INT_FREERDP_SERVER_PROXY_REACTOR_H
+#define INT_FREERDP_SERVER_PROXY_REACTOR_H
+
+#include <winpr/wtypes.h>
+
+#include <freerdp/peer.h>
+#include <freerdp/server/proxy/proxy_context.h>
+#include <freerdp/server/proxy/proxy_server.h>
+
+/* A fixed pool of I/O threads, each multiplexing many proxied sessions.
+ *
+ * Both legs of a session (the accepted peer and the connection to the target) are
+ * processed by the same I/O thread, so channel data is forwarded between them without
+ * locking or a thread switch. Only connecting to the target, which blocks, runs on a
+ * worker thread. */
+typedef struct proxy_reactor proxyReactor;
+
+/* More I/O threads than that only add context switches, each of them serves many sessions */
+#define PF_REACTOR_MAX_THREADS 64
+
+void pf_reactor_free(proxyReactor* reactor);
+
+/* Returns NULL if the platform has no epoll, the server falls back to a thread per peer */
+WINPR_ATTR_MALLOC(pf_reactor_free, 1)
+proxyReactor* pf_reactor_new(proxyServer* server, UINT32 threads);
+
+/* Hands an accepted peer to the least loaded I/O thread. The reactor owns the peer on success */
+BOOL pf_reactor_add_peer(proxyReactor* reactor, freerdp_peer* client);
+
+/* Connects to the target of the session currently processed by the calling I/O thread */
+BOOL pf_reactor_start_client(proxyReactor* reactor, pClientContext* pc);
+
+/* TRUE if the calling I/O thread processes the connected client leg pc, so data can be sent
+ * on it directly */
+BOOL pf_reactor_owns_client(const pClientContext* pc);
+
+#endif /* INT_FREERDP_SERVER_PROXY_REACTOR_H */
@@ -317,6 +317,14 @@ static BOOL pf_server_post_connect(freerdp_peer* peer)
 		return FALSE;
 	}
 
+	proxyServer* server = (proxyServer*)peer->ContextExtra;
+	WINPR_ASSERT(server);
+	if (!freerdp_set_tls_session_cache(&pc->context, server->clientTlsCache))
+	{
+		freerdp_client_context_free(&pc->context);
+		return FALSE;
+	}
+
 	client_settings = pc->context.settings;
 
 	/* keep both sides of the connection in pdata */
@@ -335,8 +343,16 @@ static BOOL pf_server_post_connect(freerdp_peer* peer)
 	if (!pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_POST_CONNECT, pdata, peer))
 		return FALSE;
 
+	if (server->reactor)
+	{
+		if (!pf_reactor_start_client(server->reactor, pc))
+		{
+			PROXY_LOG_ERR(TAG, ps, "failed to connect to the target");
+			return FALSE;
+		}
+	}
 	/* Start a proxy's client in it's own thread */
-	if (!(pdata->client_thread = CreateThread(NULL, 0, pf_client_start, pc, 0, NULL)))
+	else if (!(pdata->client_thread = CreateThread(NULL, 0, pf_client_start, pc, 0, NULL)))
 	{
 		PROXY_LOG_ERR(TAG, ps, "failed to create client thread");
 		return FALSE;
@@ -363,6 +379,9 @@ static BOOL pf_server_activate(freerdp_peer* peer)
 
 	if (!freerdp_settings_set_uint32(settings, FreeRDP_CompressionLevel, PACKET_COMPR_TYPE_RDP8))
 		return FALSE;
+	if (!freerdp_settings_set_uint32(settings, FreeRDP_XCrushCompressionLevel,
+	                                 pdata->config->XCrushCompressionLevel))
+		return FALSE;
 	if (!pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_ACTIVATE, pdata, peer))
 		return FALSE;
 
@@ -570,43 +589,24 @@ static BOOL pf_server_initialize_peer_connection(freerdp_peer* peer)
 	return TRUE;
 }
 
-/**
- * Handles an incoming client connection, to be run in it's own thread.
- *
- * arg is a pointer to a freerdp_peer representing the client.
- */
-static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
+BOOL pf_server_peer_open(freerdp_peer* client)
 {
-	HANDLE eventHandles[MAXIMUM_WAIT_OBJECTS] = { 0 };
-	pServerContext* ps = NULL;
-	proxyData* pdata = NULL;
-	peer_thread_args* args = arg;
-
-	WINPR_ASSERT(args);
-
-	freerdp_peer* client = args->client;
 	WINPR_ASSERT(client);
 
-	proxyServer* server = (proxyServer*)client->ContextExtra;
-	WINPR_ASSERT(server);
-
-	size_t count = ArrayList_Count(server->peer_list);
-
 	if (!pf_context_init_server_context(client))
-		goto out_free_peer;
+		return FALSE;
 
 	if (!pf_server_initialize_peer_connection(client))
-		goto out_free_peer;
+		return FALSE;
 
-	ps = (pServerContext*)client->context;
+	pServerContext* ps = (pServerContext*)client->context;
 	WINPR_ASSERT(ps);
-	PROXY_LOG_DBG(TAG, ps, "Added peer, %" PRIuz " connected", count);
 
-	pdata = ps->pdata;
+	proxyData* pdata = ps->pdata;
 	WINPR_ASSERT(pdata);
 
 	if (!pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_INITIALIZE, pdata, client))
-		goto out_free_peer;
+		return FALSE;
 
 	WINPR_ASSERT(client->Initialize);
 	client->Initialize(client);
@@ -614,99 +614,111 @@ static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
 	PROXY_LOG_INFO(TAG, ps, "new connection: proxy address: %s, client address: %s",
 	               pdata->config->Host, client->hostname);
 
-	if (!pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_STARTED, pdata, client))
-		goto out_free_peer;
+	return pf_modules_run_hook(pdata->module, HOOK_TYPE_SERVER_SESSION_STARTED, pdata, client);
+}
 
-	while (1)
+DWORD pf_server_peer_get_event_handles(freerdp_peer* client, HANDLE* events, DWORD count)
+{
+	DWORD eventCount = 0;
+
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(events);
+
+	pServerContext* ps = (pServerContext*)client->context;
+	WINPR_ASSERT(ps);
+
+	proxyData* pdata = ps->pdata;
+	WINPR_ASSERT(pdata);
+
+	WINPR_ASSERT(client->GetEventHandles);
+	if (count > 2)
+		eventCount = client->GetEventHandles(client, events, count - 2);
+
+	if (eventCount == 0)
 	{
-		HANDLE ChannelEvent = INVALID_HANDLE_VALUE;
-		DWORD eventCount = 0;
-		{
-			WINPR_ASSERT(client->GetEventHandles);
-			const DWORD tmp = client->GetEventHandles(client, &eventHandles[eventCount],
-			                                          ARRAYSIZE(eventHandles) - eventCount);
+		PROXY_LOG_ERR(TAG, ps, "Failed to get FreeRDP transport event handles");
+		return 0;
+	}
 
-			if (tmp == 0)
-			{
-				PROXY_LOG_ERR(TAG, ps, "Failed to get FreeRDP transport event handles");
-				break;
-			}
+	HANDLE ChannelEvent = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
 
-			eventCount += tmp;
-		}
-		/* Main client event handling loop */
-		ChannelEvent = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
+	WINPR_ASSERT(ChannelEvent && (ChannelEvent != INVALID_HANDLE_VALUE));
+	WINPR_ASSERT(pdata->abort_event && (pdata->abort_event != INVALID_HANDLE_VALUE));
+	events[eventCount++] = ChannelEvent;
+	events[eventCount++] = pdata->abort_event;
+	return eventCount;
+}
 
-		WINPR_ASSERT(ChannelEvent && (ChannelEvent != INVALID_HANDLE_VALUE));
-		WINPR_ASSERT(pdata->abort_event && (pdata->abort_event != INVALID_HANDLE_VALUE));
-		eventHandles[eventCount++] = ChannelEvent;
-		eventHandles[eventCount++] = pdata->abort_event;
-		eventHandles[eventCount++] = server->stopEvent;
+BOOL pf_server_peer_check_event_handles(freerdp_peer* client)
+{
+	WINPR_ASSERT(client);
 
-		const DWORD status = WaitForMultipleObjects(
-		    eventCount, eventHandles, FALSE, 1000); /* Do periodic polling to avoid client hang */
+	pServerContext* ps = (pServerContext*)client->context;
+	WINPR_ASSERT(ps);
 
-		if (status == WAIT_FAILED)
+	proxyData* pdata = ps->pdata;
+	WINPR_ASSERT(pdata);
+
+	WINPR_ASSERT(client->CheckFileDescriptor);
+	if (client->CheckFileDescriptor(client) != TRUE)
+		return FALSE;
+
+	HANDLE ChannelEvent = WTSVirtualChannelManagerGetEventHandle(ps->vcm);
+	if (WaitForSingleObject(ChannelEvent, 0) == WAIT_OBJECT_0)
+	{
+		if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
 		{
-			PROXY_LOG_ERR(TAG, ps, "WaitForMultipleObjects failed (status: %" PRIu32 ")", status);
-			break;
+			PROXY_LOG_ERR(TAG, ps, "WTSVirtualChannelManagerCheckFileDescriptor failure");
+			return FALSE;
 		}
+	}
 
-		WINPR_ASSERT(client->CheckFileDescriptor);
-		if (client->CheckFileDescriptor(client) != TRUE)
-			break;
+	/* only disconnect after checking client's and vcm's file descriptors  */
+	if (proxy_data_shall_disconnect(pdata))
+	{
+		PROXY_LOG_INFO(TAG, ps, "abort event is set, closing connection with peer %s",
+		               client->hostname);
+		return FALSE;
+	}
 
-		if (WaitForSingleObject(ChannelEvent, 0) == WAIT_OBJECT_0)
-		{
+	switch (WTSVirtualChannelManagerGetDrdynvcState(ps->vcm))
+	{
+		/* Dynamic channel status may have been changed after processing */
+		case DRDYNVC_STATE_NONE:
+
+			/* Initialize drdynvc channel */
 			if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
 			{
-				PROXY_LOG_ERR(TAG, ps, "WTSVirtualChannelManagerCheckFileDescriptor failure");
-				goto fail;
+				PROXY_LOG_ERR(TAG, ps, "Failed to initialize drdynvc channel");
+				return FALSE;
 			}
-		}
 
-		/* only disconnect after checking client's and vcm's file descriptors  */
-		if (proxy_data_shall_disconnect(pdata))
-		{
-			PROXY_LOG_INFO(TAG, ps, "abort event is set, closing connection with peer %s",
-			               client->hostname);
 			break;
-		}
 
-		if (WaitForSingleObject(server->stopEvent, 0) == WAIT_OBJECT_0)
-		{
-			PROXY_LOG_INFO(TAG, ps, "Server shutting down, terminating peer");
-			break;
-		}
-
-		switch (WTSVirtualChannelManagerGetDrdynvcState(ps->vcm))
-		{
-			/* Dynamic channel status may have been changed after processing */
-			case DRDYNVC_STATE_NONE:
+		case DRDYNVC_STATE_READY:
+			if (WaitForSingleObject(ps->dynvcReady, 0) == WAIT_TIMEOUT)
+			{
+				(void)SetEvent(ps->dynvcReady);
+			}
 
-				/* Initialize drdynvc channel */
-				if (!WTSVirtualChannelManagerCheckFileDescriptor(ps->vcm))
-				{
-					PROXY_LOG_ERR(TAG, ps, "Failed to initialize drdynvc channel");
-					goto fail;
-				}
+			break;
 
-				break;
+		default:
+			break;
+	}
 
-			case DRDYNVC_STATE_READY:
-				if (WaitForSingleObject(ps->dynvcReady, 0) == WAIT_TIMEOUT)
-				{
-					(void)SetEvent(ps->dynvcReady);
-				}
+	return TRUE;
+}
 
-				break;
+void pf_server_peer_close(freerdp_peer* client)
+{
+	WINPR_ASSERT(client);
 
-			default:
-				break;
-		}
-	}
+	pServerContext* ps = (pServerContext*)client->context;
+	WINPR_ASSERT(ps);
 
-fail:
+	proxyData* pdata = ps->pdata;
+	WINPR_ASSERT(pdata);
 
 	PROXY_LOG_INFO(TAG, ps, "starting shutdown of connection");
 	PROXY_LOG_INFO(TAG, ps, "stopping proxy's client");
@@ -723,14 +735,94 @@ fail:
 
 	WINPR_ASSERT(client->Disconnect);
 	client->Disconnect(client);
+}
+
+void pf_server_peer_free(freerdp_peer* client)
+{
+	proxyData* pdata = NULL;
+
+	if (!client)
+		return;
+
+	pServerContext* ps = (pServerContext*)client->context;
+	if (ps)
+		pdata = ps->pdata;
 
-out_free_peer:
 	PROXY_LOG_INFO(TAG, ps, "freeing proxy data");
 
-	if (pdata && pdata->client_thread)
+	freerdp_peer_context_free(client);
+	freerdp_peer_free(client);
+	proxy_data_free(pdata);
+
+#if defined(WITH_DEBUG_EVENTS)
+	DumpEventHandles();
+#endif
+}
+
+/**
+ * Handles an incoming client connection, to be run in it's own thread.
+ *
+ * arg is a pointer to a freerdp_peer representing the client.
+ */
+static DWORD WINAPI pf_server_handle_peer(LPVOID arg)
+{
+	HANDLE eventHandles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+	const pServerContext* ps = NULL;
+	peer_thread_args* args = arg;
+
+	WINPR_ASSERT(args);
+
+	freerdp_peer* client = args->client;
+	WINPR_ASSERT(client);
+
+	proxyServer* server = (proxyServer*)client->ContextExtra;
+	WINPR_ASSERT(server);
+
+	size_t count = ArrayList_Count(server->peer_list);
+	WLog_DBG(TAG, "Added peer, %" PRIuz " connected", count);
+
+	if (!pf_server_peer_open(client))
+		goto out_free_peer;
+
+	ps = (const pServerContext*)client->context;
+	while (1)
+	{
+		DWORD eventCount = pf_server_peer_get_event_handles(client, eventHandles,
+		                                                    ARRAYSIZE(eventHandles) - 1);
+		if (eventCount == 0)
+			break;
+
+		eventHandles[eventCount++] = server->stopEvent;
+
+		const DWORD status = WaitForMultipleObjects(
+		    eventCount, eventHandles, FALSE, 1000); /* Do periodic polling to avoid client hang */
+
+		if (status == WAIT_FAILED)
+		{
+			PROXY_LOG_ERR(TAG, ps, "WaitForMultipleObjects failed (status: %" PRIu32 ")", status);
+			break;
+		}
+
+		if (!pf_server_peer_check_event_handles(client))
+			break;
+
+		if (WaitForSingleObject(server->stopEvent, 0) == WAIT_OBJECT_0)
+		{
+			PROXY_LOG_INFO(TAG, ps, "Server shutting down, terminating peer");
+			break;
+		}
+	}
+
+	pf_server_peer_close(client);
+
+out_free_peer:
 	{
-		proxy_data_abort_connect(pdata);
-		(void)WaitForSingleObject(pdata->client_thread, INFINITE);
+		const pServerContext* context = (const pServerContext*)client->context;
+		if (context && context->pdata && context->pdata->client_thread)
+		{
+			proxy_data_abort_connect(context->pdata);
+			(void)WaitForSingleObject(context->pdata->client_thread, INFINITE);
+		}
 	}
 
 	{
@@ -739,14 +831,8 @@ out_free_peer:
 		count = ArrayList_Count(server->peer_list);
 		ArrayList_Unlock(server->peer_list);
 	}
-	PROXY_LOG_DBG(TAG, ps, "Removed peer, %" PRIuz " connected", count);
-	freerdp_peer_context_free(client);
-	freerdp_peer_free(client);
-	proxy_data_free(pdata);
-
-#if defined(WITH_DEBUG_EVENTS)
-	DumpEventHandles();
-#endif
+	WLog_DBG(TAG, "Removed peer, %" PRIuz " connected", count);
+	pf_server_peer_free(client);
 	free(args);
 	ExitThread(0);
 	return 0;
@@ -756,16 +842,20 @@ static BOOL pf_server_start_peer(freerdp_peer* client)
 {
 	HANDLE hThread = NULL;
 	proxyServer* server = NULL;
+
+	WINPR_ASSERT(client);
+	server = (proxyServer*)client->ContextExtra;
+	WINPR_ASSERT(server);
+
+	if (server->reactor)
+		return pf_reactor_add_peer(server->reactor, client);
+
 	peer_thread_args* args = calloc(1, sizeof(peer_thread_args));
 	if (!args)
 		return FALSE;
 
-	WINPR_ASSERT(client);
 	args->client = client;
 
-	server = (proxyServer*)client->ContextExtra;
-	WINPR_ASSERT(server);
-
 	hThread = CreateThread(NULL, 0, pf_server_handle_peer, args, CREATE_SUSPENDED, NULL);
 	if (!hThread)
 		return FALSE;
@@ -959,10 +1049,17 @@ proxyServer* pf_server_new(const proxyConfig* config)
 	if (!server->listener)
 		goto out;
 
+	server->clientTlsCache = freerdp_tls_session_cache_new(FALSE);
+	if (!server->clientTlsCache)
+		goto out;
+
 	server->peer_list = ArrayList_New(FALSE);
 	if (!server->peer_list)
 		goto out;
 
+	if (server->config->IOThreads > 0)
+		server->reactor = pf_reactor_new(server, server->config->IOThreads);
+
 	obj = ArrayList_Object(server->peer_list);
 	WINPR_ASSERT(obj);
 
@@ -1070,8 +1167,10 @@ void pf_server_free(proxyServer* server)
 			Sleep(100);
 		}
 	}
+	pf_reactor_free(server->reactor);
 	ArrayList_Free(server->peer_list);
 	freerdp_listener_free(server->listener);
+	freerdp_tls_session_cache_free(server->clientTlsCache);
 
 	if (server->stopEvent)
 		(void)CloseHandle(server->stopEvent);
@@ -26,9 +26,11 @@
 
 #include <winpr/collections.h>
 #include <freerdp/listener.h>
+#include <freerdp/crypto/tls_cache.h>
 
 #include <freerdp/server/proxy/proxy_config.h>
 #include "proxy_modules.h"
+#include "pf_reactor.h"
 
 struct proxy_server
 {
@@ -38,6 +40,19 @@ struct proxy_server
 	freerdp_listener* listener;
 	HANDLE stopEvent; /* an event used to signal the main thread to stop */
 	wArrayList* peer_list;
+
+	/* TLS sessions of the connections to the targets, resumed on reconnect */
+	rdpTlsSessionCache* clientTlsCache;
+
+	/* I/O threads multiplexing the sessions, NULL when every peer has its own thread */
+	proxyReactor* reactor;
 };
 
+/* The steps of a proxied peer connection, driven by a peer thread or by the reactor */
+BOOL pf_server_peer_open(freerdp_peer* client);
+DWORD pf_server_peer_get_event_handles(freerdp_peer* client, HANDLE* events, DWORD count);
+BOOL pf_server_peer_check_event_handles(freerdp_peer* client);
+void pf_server_peer_close(freerdp_peer* client);
+void pf_server_peer_free(freerdp_peer* client);
+
 #endif /* INT_FREERDP_SERVER_PROXY_SERVER_H */
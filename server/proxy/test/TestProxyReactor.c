@@ -0,0 +1,485 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/path.h>
+#include <winpr/file.h>
+#include <winpr/synch.h>
+#include <winpr/thread.h>
+#include <winpr/sysinfo.h>
+#include <winpr/crypto.h>
+#include <winpr/interlocked.h>
+#include <winpr/tools/makecert.h>
+
+#include <freerdp/freerdp.h>
+#include <freerdp/client.h>
+#include <freerdp/listener.h>
+#include <freerdp/peer.h>
+#include <freerdp/crypto/certificate.h>
+#include <freerdp/crypto/privatekey.h>
+#include <freerdp/server/proxy/proxy_config.h>
+#include <freerdp/server/proxy/proxy_server.h>
+
+#define TEST_CLIENTS 4
+#define TEST_TIMEOUT 20000
+
+typedef struct
+{
+	char* path;
+	char* cert;
+	char* key;
+
+	UINT16 proxyPort;
+	UINT16 targetPort;
+
+	/* the target, an RDP server accepting any session */
+	freerdp_listener* listener;
+	HANDLE listenerThread;
+	HANDLE stop;
+	volatile LONG peers;
+	volatile LONG activated;
+	volatile LONG closed;
+
+	proxyServer* proxy;
+	HANDLE proxyThread;
+
+	/* clients wait until this many sessions reached the target */
+	LONG expected;
+} test_env;
+
+static UINT16 test_port(void)
+{
+	UINT16 port = 0;
+	winpr_RAND(&port, sizeof(port));
+	return (UINT16)(20000 + port % 40000);
+}
+
+static BOOL test_wait_for(volatile LONG* value, LONG expected)
+{
+	const UINT64 end = GetTickCount64() + TEST_TIMEOUT;
+
+	while (*value < expected)
+	{
+		if (GetTickCount64() > end)
+			return FALSE;
+		Sleep(10);
+	}
+	return TRUE;
+}
+
+static BOOL test_create_certificate(test_env* env)
+{
+	BOOL rc = FALSE;
+	char* argv[] = { "makecert", "-rdp", "-live", "-silent", "-y", "1" };
+	MAKECERT_CONTEXT* makecert = makecert_context_new();
+
+	if (!makecert)
+		goto fail;
+
+	if ((makecert_context_process(makecert, ARRAYSIZE(argv), argv) < 0) ||
+	    (makecert_context_set_output_file_name(makecert, "proxy") != 1))
+		goto fail;
+
+	if ((makecert_context_output_certificate_file(makecert, env->path) != 1) ||
+	    (makecert_context_output_private_key_file(makecert, env->path) != 1))
+		goto fail;
+
+	env->cert = GetCombinedPath(env->path, "proxy.crt");
+	env->key = GetCombinedPath(env->path, "proxy.key");
+	rc = env->cert && env->key;
+fail:
+	makecert_context_free(makecert);
+	return rc;
+}
+
+static BOOL test_target_post_connect(freerdp_peer* peer)
+{
+	WINPR_UNUSED(peer);
+	return TRUE;
+}
+
+static BOOL test_target_activate(freerdp_peer* peer)
+{
+	test_env* env = peer->ContextExtra;
+	(void)InterlockedIncrement(&env->activated);
+	return TRUE;
+}
+
+static DWORD WINAPI test_target_peer(LPVOID arg)
+{
+	freerdp_peer* peer = arg;
+	test_env* env = peer->ContextExtra;
+
+	if (!freerdp_peer_context_new(peer))
+		goto fail;
+
+	rdpSettings* settings = peer->context->settings;
+	rdpPrivateKey* key = freerdp_key_new_from_file(env->key);
+	if (!key || !freerdp_settings_set_pointer_len(settings, FreeRDP_RdpServerRsaKey, key, 1))
+		goto fail;
+	rdpCertificate* cert = freerdp_certificate_new_from_file(env->cert);
+	if (!cert || !freerdp_settings_set_pointer_len(settings, FreeRDP_RdpServerCertificate, cert, 1))
+		goto fail;
+	if (!freerdp_settings_set_bool(settings, FreeRDP_RdpSecurity, FALSE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_TlsSecurity, TRUE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_NlaSecurity, FALSE) ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_ColorDepth, 32))
+		goto fail;
+
+	peer->PostConnect = test_target_post_connect;
+	peer->Activate = test_target_activate;
+	if (!peer->Initialize(peer))
+		goto fail;
+
+	while (WaitForSingleObject(env->stop, 0) != WAIT_OBJECT_0)
+	{
+		HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+		DWORD count = peer->GetEventHandles(peer, handles, ARRAYSIZE(handles) - 1);
+		if (count == 0)
+			break;
+
+		handles[count++] = env->stop;
+		if (WaitForMultipleObjects(count, handles, FALSE, 100) == WAIT_FAILED)
+			break;
+
+		if (!peer->CheckFileDescriptor(peer))
+			break;
+	}
+
+	peer->Disconnect(peer);
+fail:
+	freerdp_peer_context_free(peer);
+	freerdp_peer_free(peer);
+	(void)InterlockedIncrement(&env->closed);
+	return 0;
+}
+
+static BOOL test_target_accepted(freerdp_listener* listener, freerdp_peer* peer)
+{
+	test_env* env = listener->info;
+
+	peer->ContextExtra = env;
+	HANDLE thread = CreateThread(NULL, 0, test_target_peer, peer, 0, NULL);
+	if (!thread)
+		return FALSE;
+
+	(void)InterlockedIncrement(&env->peers);
+	(void)CloseHandle(thread);
+	return TRUE;
+}
+
+static DWORD WINAPI test_target_listen(LPVOID arg)
+{
+	test_env* env = arg;
+	freerdp_listener* listener = env->listener;
+
+	while (WaitForSingleObject(env->stop, 0) != WAIT_OBJECT_0)
+	{
+		HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+		DWORD count = listener->GetEventHandles(listener, handles, ARRAYSIZE(handles) - 1);
+		if (count == 0)
+			break;
+
+		handles[count++] = env->stop;
+		if (WaitForMultipleObjects(count, handles, FALSE, 100) == WAIT_FAILED)
+			break;
+
+		if (!listener->CheckFileDescriptor(listener))
+			break;
+	}
+
+	listener->Close(listener);
+	return 0;
+}
+
+static BOOL test_target_start(test_env* env)
+{
+	env->listener = freerdp_listener_new();
+	if (!env->listener)
+		return FALSE;
+
+	env->listener->info = env;
+	env->listener->PeerAccepted = test_target_accepted;
+
+	for (size_t x = 0; x < 10; x++)
+	{
+		env->targetPort = test_port();
+		if (env->listener->Open(env->listener, "127.0.0.1", env->targetPort))
+		{
+			env->listenerThread = CreateThread(NULL, 0, test_target_listen, env, 0, NULL);
+			return env->listenerThread != NULL;
+		}
+	}
+	return FALSE;
+}
+
+static void test_target_stop(test_env* env)
+{
+	(void)SetEvent(env->stop);
+	if (env->listenerThread)
+	{
+		(void)WaitForSingleObject(env->listenerThread, INFINITE);
+		(void)CloseHandle(env->listenerThread);
+	}
+
+	/* the peer threads are detached */
+	(void)test_wait_for(&env->closed, env->peers);
+	freerdp_listener_free(env->listener);
+}
+
+static DWORD WINAPI test_proxy_run(LPVOID arg)
+{
+	proxyServer* proxy = arg;
+	return pf_server_run(proxy) ? 0 : 1;
+}
+
+static BOOL test_proxy_start(test_env* env, UINT16 targetPort)
+{
+	static const char fmt[] = "[Server]\n"
+	                          "Host=127.0.0.1\n"
+	                          "Port=%" PRIu16 "\n"
+	                          "IOThreads=2\n"
+	                          "[Target]\n"
+	                          "Host=127.0.0.1\n"
+	                          "Port=%" PRIu16 "\n"
+	                          "FixedTarget=true\n"
+	                          "[Input]\n"
+	                          "Keyboard=true\n"
+	                          "Mouse=true\n"
+	                          "[Security]\n"
+	                          "ServerTlsSecurity=true\n"
+	                          "ServerNlaSecurity=false\n"
+	                          "ServerRdpSecurity=false\n"
+	                          "ClientTlsSecurity=true\n"
+	                          "ClientNlaSecurity=false\n"
+	                          "ClientRdpSecurity=false\n"
+	                          "[Certificates]\n"
+	                          "CertificateFile=%s\n"
+	                          "PrivateKeyFile=%s\n";
+
+	for (size_t x = 0; x < 10; x++)
+	{
+		char buffer[4096] = { 0 };
+
+		env->proxyPort = test_port();
+		(void)_snprintf(buffer, sizeof(buffer), fmt, env->proxyPort, targetPort, env->cert,
+		                env->key);
+
+		proxyConfig* config = pf_server_config_load_buffer(buffer);
+		if (!config)
+			return FALSE;
+
+		env->proxy = pf_server_new(config);
+		pf_server_config_free(config);
+		if (!env->proxy)
+			return FALSE;
+
+		if (pf_server_start(env->proxy))
+		{
+			env->proxyThread = CreateThread(NULL, 0, test_proxy_run, env->proxy, 0, NULL);
+			return env->proxyThread != NULL;
+		}
+
+		pf_server_free(env->proxy);
+		env->proxy = NULL;
+	}
+	return FALSE;
+}
+
+static void test_proxy_stop(test_env* env)
+{
+	pf_server_stop(env->proxy);
+	if (env->proxyThread)
+	{
+		(void)WaitForSingleObject(env->proxyThread, INFINITE);
+		(void)CloseHandle(env->proxyThread);
+		env->proxyThread = NULL;
+	}
+	pf_server_free(env->proxy);
+	env->proxy = NULL;
+}
+
+/* Connects through the proxy. With a target the client stays until all sessions reached it,
+ * so they are served by the I/O threads at the same time. Without one the proxy has to drop
+ * the client. */
+static DWORD WINAPI test_client(LPVOID arg)
+{
+	DWORD rc = 1;
+	test_env* env = arg;
+	RDP_CLIENT_ENTRY_POINTS entry = { 0 };
+
+	entry.Size = sizeof(RDP_CLIENT_ENTRY_POINTS);
+	entry.Version = RDP_CLIENT_INTERFACE_VERSION;
+	entry.ContextSize = sizeof(rdpContext);
+
+	rdpContext* context = freerdp_client_context_new(&entry);
+	if (!context)
+		return 1;
+
+	rdpSettings* settings = context->settings;
+	if (!freerdp_settings_set_string(settings, FreeRDP_ServerHostname, "127.0.0.1") ||
+	    !freerdp_settings_set_uint32(settings, FreeRDP_ServerPort, env->proxyPort) ||
+	    !freerdp_settings_set_string(settings, FreeRDP_Username, "test") ||
+	    !freerdp_settings_set_string(settings, FreeRDP_Password, "test") ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_IgnoreCertificate, TRUE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_RdpSecurity, FALSE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_TlsSecurity, TRUE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_NlaSecurity, FALSE) ||
+	    !freerdp_settings_set_bool(settings, FreeRDP_DeactivateClientDecoding, TRUE))
+		goto fail;
+
+	if (!freerdp_connect(context->instance))
+	{
+		/* the proxy might drop a session without target before it is fully connected */
+		rc = (env->expected == 0) ? 0 : 1;
+		goto fail;
+	}
+
+	const UINT64 end = GetTickCount64() + TEST_TIMEOUT;
+	while (GetTickCount64() < end)
+	{
+		HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+
+		if ((env->expected > 0) && (env->activated >= env->expected))
+		{
+			rc = 0;
+			break;
+		}
+
+		const DWORD count = freerdp_get_event_handles(context, handles, ARRAYSIZE(handles));
+		if ((count == 0) || (WaitForMultipleObjects(count, handles, FALSE, 100) == WAIT_FAILED))
+			break;
+
+		if (!freerdp_check_event_handles(context))
+		{
+			if (env->expected == 0)
+				rc = 0;
+			break;
+		}
+	}
+
+	(void)freerdp_disconnect(context->instance);
+fail:
+	freerdp_client_context_free(context);
+	return rc;
+}
+
+static BOOL test_clients(test_env* env, size_t count)
+{
+	BOOL rc = TRUE;
+	HANDLE threads[TEST_CLIENTS] = { 0 };
+
+	WINPR_ASSERT(count <= ARRAYSIZE(threads));
+	for (size_t x = 0; x < count; x++)
+	{
+		threads[x] = CreateThread(NULL, 0, test_client, env, 0, NULL);
+		rc &= threads[x] != NULL;
+	}
+
+	for (size_t x = 0; x < count; x++)
+	{
+		DWORD status = 1;
+
+		if (!threads[x])
+			continue;
+		(void)WaitForSingleObject(threads[x], INFINITE);
+		rc &= GetExitCodeThread(threads[x], &status) && (status == 0);
+		(void)CloseHandle(threads[x]);
+	}
+	return rc;
+}
+
+/* Sessions through the reactor reach the target and are torn down with the clients */
+static BOOL test_proxy_session(test_env* env)
+{
+	BOOL rc = FALSE;
+
+	env->expected = TEST_CLIENTS;
+	if (!test_target_start(env) || !test_proxy_start(env, env->targetPort))
+		goto fail;
+
+	if (!test_clients(env, TEST_CLIENTS))
+	{
+		printf("%s: %" PRId32 " of %" PRId32 " sessions reached the target\n", __func__,
+		       env->activated, env->expected);
+		goto fail;
+	}
+
+	/* the proxy closes the connections to the target once the clients are gone */
+	if (!test_wait_for(&env->closed, TEST_CLIENTS))
+	{
+		printf("%s: %" PRId32 " of %d target connections closed\n", __func__, env->closed,
+		       TEST_CLIENTS);
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	test_proxy_stop(env);
+	test_target_stop(env);
+	return rc;
+}
+
+/* Connecting to the target fails on the worker threads, the sessions must be dropped */
+static BOOL test_proxy_no_target(test_env* env)
+{
+	BOOL rc = FALSE;
+
+	env->expected = 0;
+	if (!test_proxy_start(env, test_port()))
+		goto fail;
+
+	rc = test_clients(env, TEST_CLIENTS);
+fail:
+	test_proxy_stop(env);
+	return rc;
+}
+
+int TestProxyReactor(int argc, char* argv[])
+{
+	int rc = -1;
+	BYTE tmp[8] = { 0 };
+	char name[32] = { 0 };
+	test_env env = { 0 };
+
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	winpr_RAND(tmp, sizeof(tmp));
+	for (size_t x = 0; x < sizeof(tmp); x++)
+		(void)_snprintf(&name[x * 2], sizeof(name) - 2 * x, "%02" PRIx8, tmp[x]);
+
+	env.path = GetKnownSubPath(KNOWN_PATH_TEMP, name);
+	env.stop = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!env.path || !env.stop || !winpr_PathMakePath(env.path, NULL))
+		goto fail;
+
+	if (!test_create_certificate(&env))
+		goto fail;
+
+	if (!test_proxy_no_target(&env))
+	{
+		rc = -2;
+		goto fail;
+	}
+
+	if (!test_proxy_session(&env))
+	{
+		rc = -3;
+		goto fail;
+	}
+
+	rc = 0;
+fail:
+	if (env.cert)
+		(void)winpr_DeleteFile(env.cert);
+	if (env.key)
+		(void)winpr_DeleteFile(env.key);
+	if (env.path)
+		(void)winpr_RemoveDirectory(env.path);
+	free(env.cert);
+	free(env.key);
+	free(env.path);
+	if (env.stop)
+		(void)CloseHandle(env.stop);
+	return rc;
+}
@@ -765,16 +765,11 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	int rc = 0;
 	size_t count = 0;
 	int status = -1;
-	int x = 0;
-	int y = 0;
-	int width = 0;
-	int height = 0;
 	XImage* image = NULL;
 	rdpShadowServer* server = NULL;
 	rdpShadowSurface* surface = NULL;
-	RECTANGLE_16 invalidRect;
+	REGION16 invalidRegion;
 	RECTANGLE_16 surfaceRect;
-	const RECTANGLE_16* extents = NULL;
 	server = subsystem->common.server;
 	surface = server->surface;
 	count = ArrayList_Count(server->clients);
@@ -782,6 +777,8 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	if (count < 1)
 		return 1;
 
+	region16_init(&invalidRegion);
+
 	EnterCriticalSection(&surface->lock);
 	surfaceRect.left = 0;
 	surfaceRect.top = 0;
@@ -804,10 +801,10 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 		          subsystem->xshm_gc, 0, 0, subsystem->width, subsystem->height, 0, 0);
 
 		EnterCriticalSection(&surface->lock);
-		status = shadow_capture_compare_with_format(
+		status = shadow_capture_compare_region(
 		    surface->data, surface->format, surface->scanline, surface->width, surface->height,
 		    (BYTE*)&(image->data[surface->width * 4ull]), subsystem->format,
-		    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), &invalidRect);
+		    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), &invalidRegion);
 		LeaveCriticalSection(&surface->lock);
 	}
 	else
@@ -819,10 +816,10 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 
 		if (image)
 		{
-			status = shadow_capture_compare_with_format(
+			status = shadow_capture_compare_region(
 			    surface->data, surface->format, surface->scanline, surface->width, surface->height,
 			    (BYTE*)image->data, subsystem->format,
-			    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), &invalidRect);
+			    WINPR_ASSERTING_INT_CAST(UINT32, image->bytes_per_line), &invalidRegion);
 		}
 		LeaveCriticalSection(&surface->lock);
 		if (!image)
@@ -840,36 +837,38 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 	XSync(subsystem->display, False);
 	XUnlockDisplay(subsystem->display);
 
-	if (status)
+	if (status > 0)
 	{
 		BOOL empty = 0;
+		UINT32 numRects = 0;
+		const RECTANGLE_16* rects = region16_rects(&invalidRegion, &numRects);
+
 		EnterCriticalSection(&surface->lock);
-		region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion), &invalidRect);
+		for (UINT32 index = 0; index < numRects; index++)
+			region16_union_rect(&(surface->invalidRegion), &(surface->invalidRegion),
+			                    &rects[index]);
 		region16_intersect_rect(&(surface->invalidRegion), &(surface->invalidRegion), &surfaceRect);
 		empty = region16_is_empty(&(surface->invalidRegion));
 		LeaveCriticalSection(&surface->lock);
 
 		if (!empty)
 		{
-			BOOL success = 0;
+			BOOL success = TRUE;
 			EnterCriticalSection(&surface->lock);
-			extents = region16_extents(&(surface->invalidRegion));
-			x = extents->left;
-			y = extents->top;
-			width = extents->right - extents->left;
-			height = extents->bottom - extents->top;
+			rects = region16_rects(&(surface->invalidRegion), &numRects);
 			WINPR_ASSERT(image);
 			WINPR_ASSERT(image->bytes_per_line >= 0);
-			WINPR_ASSERT(width >= 0);
-			WINPR_ASSERT(height >= 0);
-			success = freerdp_image_copy_no_overlap(
-			    surface->data, surface->format, surface->scanline,
-			    WINPR_ASSERTING_INT_CAST(uint32_t, x), WINPR_ASSERTING_INT_CAST(uint32_t, y),
-			    WINPR_ASSERTING_INT_CAST(uint32_t, width),
-			    WINPR_ASSERTING_INT_CAST(uint32_t, height), (BYTE*)image->data, subsystem->format,
-			    WINPR_ASSERTING_INT_CAST(uint32_t, image->bytes_per_line),
-			    WINPR_ASSERTING_INT_CAST(UINT32, x), WINPR_ASSERTING_INT_CAST(UINT32, y), NULL,
-			    FREERDP_FLIP_NONE);
+
+			/* Only copy the changed tiles, not their bounding rectangle */
+			for (UINT32 index = 0; success && (index < numRects); index++)
+			{
+				const RECTANGLE_16* rect = &rects[index];
+				success = freerdp_image_copy_no_overlap(
+				    surface->data, surface->format, surface->scanline, rect->left, rect->top,
+				    rect->right - rect->left, rect->bottom - rect->top, (BYTE*)image->data,
+				    subsystem->format, WINPR_ASSERTING_INT_CAST(uint32_t, image->bytes_per_line),
+				    rect->left, rect->top, NULL, FREERDP_FLIP_NONE);
+			}
 			LeaveCriticalSection(&surface->lock);
 			if (!success)
 				goto fail_capture;
@@ -896,6 +895,7 @@ static int x11_shadow_screen_grab(x11ShadowSubsystem* subsystem)
 
 	rc = 1;
 fail_capture:
+	region16_uninit(&invalidRegion);
 	if (!subsystem->use_xshm && image)
 		XDestroyImage(image);
 
@@ -22,6 +22,7 @@
 #include <winpr/print.h>
 
 #include <freerdp/log.h>
+#include <freerdp/primitives.h>
 
 #include "shadow_surface.h"
 
@@ -162,24 +163,11 @@ static BOOL pixel_equal_no_alpha(const BYTE* WINPR_RESTRICT a, UINT32 formatA,
 	return TRUE;
 }
 
-static BOOL pixel_equal_same_format(const BYTE* WINPR_RESTRICT a, UINT32 formatA,
-                                    const BYTE* WINPR_RESTRICT b, UINT32 formatB, size_t count)
-{
-	if (formatA != formatB)
-		return FALSE;
-	const size_t bppA = FreeRDPGetBytesPerPixel(formatA);
-	return memcmp(a, b, count * bppA) == 0;
-}
-
 typedef BOOL (*pixel_equal_fn_t)(const BYTE* WINPR_RESTRICT a, UINT32 formatA,
                                  const BYTE* WINPR_RESTRICT b, UINT32 formatB, size_t count);
 
 static pixel_equal_fn_t get_comparison_fn(DWORD format1, DWORD format2)
 {
-
-	if (format1 == format2)
-		return pixel_equal_same_format;
-
 	const UINT32 bpp1 = FreeRDPGetBitsPerPixel(format1);
 
 	if (!FreeRDPColorHasAlpha(format1) || !FreeRDPColorHasAlpha(format2))
@@ -210,43 +198,49 @@ static pixel_equal_fn_t get_comparison_fn(DWORD format1, DWORD format2)
 		return pixel_equal_no_alpha;
 }
 
-int shadow_capture_compare_with_format(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
-                                       UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
-                                       const BYTE* WINPR_RESTRICT pData2, UINT32 format2,
-                                       UINT32 nStep2, RECTANGLE_16* WINPR_RESTRICT rect)
+static INLINE BOOL shadow_capture_add_tiles(REGION16* WINPR_RESTRICT region, size_t first,
+                                            size_t last, size_t ty, UINT32 nWidth,
+                                            UINT32 nHeight)
+{
+	RECTANGLE_16 tiles = { 0 };
+
+	WINPR_ASSERT(first * 16 <= UINT16_MAX);
+	WINPR_ASSERT(ty * 16 <= UINT16_MAX);
+	tiles.left = (UINT16)(first * 16);
+	tiles.top = (UINT16)(ty * 16);
+	tiles.right = (UINT16)MIN(last * 16, nWidth);
+	tiles.bottom = (UINT16)MIN((ty + 1) * 16, nHeight);
+	return region16_union_rect(region, region, &tiles);
+}
+
+static BOOL shadow_capture_diff_tiles(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
+                                      UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
+                                      const BYTE* WINPR_RESTRICT pData2, UINT32 format2,
+                                      UINT32 nStep2, BYTE* WINPR_RESTRICT mask, UINT32 maskStep)
 {
-	pixel_equal_fn_t pixel_equal_fn = get_comparison_fn(format1, format2);
-	BOOL allEqual = TRUE;
-	UINT32 tw = 0;
 	const UINT32 nrow = (nHeight + 15) / 16;
 	const UINT32 ncol = (nWidth + 15) / 16;
-	UINT32 l = ncol + 1;
-	UINT32 t = nrow + 1;
-	UINT32 r = 0;
-	UINT32 b = 0;
 	const size_t bppA = FreeRDPGetBytesPerPixel(format1);
 	const size_t bppB = FreeRDPGetBytesPerPixel(format2);
-	const RECTANGLE_16 empty = { 0 };
-	WINPR_ASSERT(rect);
 
-	*rect = empty;
+	if (format1 == format2)
+	{
+		const primitives_t* prims = primitives_get();
+		WINPR_ASSERT(prims);
+		return prims->compare_tiles(pData1, nStep1, pData2, nStep2, nWidth, nHeight,
+		                            (UINT32)bppA, 16, mask, maskStep) == PRIMITIVES_SUCCESS;
+	}
+
+	/* Different formats need a per pixel color conversion */
+	pixel_equal_fn_t pixel_equal_fn = get_comparison_fn(format1, format2);
 
 	for (size_t ty = 0; ty < nrow; ty++)
 	{
-		BOOL rowEqual = TRUE;
-		size_t th = ((ty + 1) == nrow) ? (nHeight % 16) : 16;
-
-		if (!th)
-			th = 16;
+		const size_t th = MIN(16, nHeight - ty * 16);
 
 		for (size_t tx = 0; tx < ncol; tx++)
 		{
-			BOOL equal = TRUE;
-			tw = ((tx + 1) == ncol) ? (nWidth % 16) : 16;
-
-			if (!tw)
-				tw = 16;
-
+			const size_t tw = MIN(16, nWidth - tx * 16);
 			const BYTE* p1 = &pData1[(ty * 16ULL * nStep1) + (tx * 16ull * bppA)];
 			const BYTE* p2 = &pData2[(ty * 16ULL * nStep2) + (tx * 16ull * bppB)];
 
@@ -254,13 +248,60 @@ int shadow_capture_compare_with_format(const BYTE* WINPR_RESTRICT pData1, UINT32
 			{
 				if (!pixel_equal_fn(p1, format1, p2, format2, tw))
 				{
-					equal = FALSE;
+					mask[ty * maskStep + tx / 8] |= (BYTE)(1u << (tx % 8));
 					break;
 				}
 
 				p1 += nStep1;
 				p2 += nStep2;
 			}
+		}
+	}
+
+	return TRUE;
+}
+
+static int shadow_capture_compare_tiles(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
+                                        UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
+                                        const BYTE* WINPR_RESTRICT pData2, UINT32 format2,
+                                        UINT32 nStep2, REGION16* WINPR_RESTRICT region,
+                                        RECTANGLE_16* WINPR_RESTRICT rect)
+{
+	int rc = -1;
+	BOOL allEqual = TRUE;
+	const UINT32 nrow = (nHeight + 15) / 16;
+	const UINT32 ncol = (nWidth + 15) / 16;
+	const UINT32 maskStep = (ncol + 7) / 8;
+	UINT32 l = ncol + 1;
+	UINT32 t = nrow + 1;
+	UINT32 r = 0;
+	UINT32 b = 0;
+	BYTE* mask = NULL;
+
+	if ((nWidth > UINT16_MAX) || (nHeight > UINT16_MAX))
+		return -1;
+
+	if ((nWidth == 0) || (nHeight == 0))
+		return 0;
+
+	mask = calloc(nrow, maskStep);
+	if (!mask)
+		return -1;
+
+	if (!shadow_capture_diff_tiles(pData1, format1, nStep1, nWidth, nHeight, pData2, format2,
+	                               nStep2, mask, maskStep))
+		goto out;
+
+	for (size_t ty = 0; ty < nrow; ty++)
+	{
+		BOOL rowEqual = TRUE;
+		size_t runStart = 0;
+		BOOL inRun = FALSE;
+		const BYTE* rowMask = &mask[ty * maskStep];
+
+		for (size_t tx = 0; tx < ncol; tx++)
+		{
+			const BOOL equal = (rowMask[tx / 8] & (1u << (tx % 8))) == 0;
 
 			if (!equal)
 			{
@@ -270,9 +311,26 @@ int shadow_capture_compare_with_format(const BYTE* WINPR_RESTRICT pData1, UINT32
 
 				if (r < tx)
 					r = (UINT32)tx;
+
+				if (!inRun)
+				{
+					runStart = tx;
+					inRun = TRUE;
+				}
+			}
+			else if (inRun)
+			{
+				/* Adjacent changed tiles of a row are reported as one rectangle */
+				inRun = FALSE;
+				if (region && !shadow_capture_add_tiles(region, runStart, tx, ty, nWidth, nHeight))
+					goto out;
 			}
 		}
 
+		if (inRun && region &&
+		    !shadow_capture_add_tiles(region, runStart, ncol, ty, nWidth, nHeight))
+			goto out;
+
 		if (!rowEqual)
 		{
 			allEqual = FALSE;
@@ -286,26 +344,57 @@ int shadow_capture_compare_with_format(const BYTE* WINPR_RESTRICT pData1, UINT32
 	}
 
 	if (allEqual)
-		return 0;
+	{
+		rc = 0;
+		goto out;
+	}
 
-	WINPR_ASSERT(l * 16 <= UINT16_MAX);
-	WINPR_ASSERT(t * 16 <= UINT16_MAX);
-	WINPR_ASSERT((r + 1) * 16 <= UINT16_MAX);
-	WINPR_ASSERT((b + 1) * 16 <= UINT16_MAX);
-	rect->left = (UINT16)l * 16;
-	rect->top = (UINT16)t * 16;
-	rect->right = (UINT16)(r + 1) * 16;
-	rect->bottom = (UINT16)(b + 1) * 16;
+	if (rect)
+	{
+		WINPR_ASSERT(l * 16 <= UINT16_MAX);
+		WINPR_ASSERT(t * 16 <= UINT16_MAX);
+		WINPR_ASSERT((r + 1) * 16 <= UINT16_MAX);
+		WINPR_ASSERT((b + 1) * 16 <= UINT16_MAX);
+		rect->left = (UINT16)l * 16;
+		rect->top = (UINT16)t * 16;
+		rect->right = (UINT16)(r + 1) * 16;
+		rect->bottom = (UINT16)(b + 1) * 16;
+
+		if (rect->right > nWidth)
+			rect->right = (UINT16)nWidth;
+
+		if (rect->bottom > nHeight)
+			rect->bottom = (UINT16)nHeight;
+	}
 
-	WINPR_ASSERT(nWidth <= UINT16_MAX);
-	if (rect->right > nWidth)
-		rect->right = (UINT16)nWidth;
+	rc = 1;
+out:
+	free(mask);
+	return rc;
+}
 
-	WINPR_ASSERT(nHeight <= UINT16_MAX);
-	if (rect->bottom > nHeight)
-		rect->bottom = (UINT16)nHeight;
+int shadow_capture_compare_with_format(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
+                                       UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
+                                       const BYTE* WINPR_RESTRICT pData2, UINT32 format2,
+                                       UINT32 nStep2, RECTANGLE_16* WINPR_RESTRICT rect)
+{
+	const RECTANGLE_16 empty = { 0 };
+	WINPR_ASSERT(rect);
 
-	return 1;
+	*rect = empty;
+	return shadow_capture_compare_tiles(pData1, format1, nStep1, nWidth, nHeight, pData2, format2,
+	                                    nStep2, NULL, rect);
+}
+
+int shadow_capture_compare_region(const BYTE* WINPR_RESTRICT pData1, UINT32 format1,
+                                  UINT32 nStep1, UINT32 nWidth, UINT32 nHeight,
+                                  const BYTE* WINPR_RESTRICT pData2, UINT32 format2, UINT32 nStep2,
+                                  REGION16* WINPR_RESTRICT region)
+{
+	WINPR_ASSERT(region);
+
+	return shadow_capture_compare_tiles(pData1, format1, nStep1, nWidth, nHeight, pData2, format2,
+	                                    nStep2, region, NULL);
 }
 
 rdpShadowCapture* shadow_capture_new(rdpShadowServer* server)
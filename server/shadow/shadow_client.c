@@ -37,6 +37,9 @@
 
 #define TAG CLIENT_TAG("shadow")
 
+/* Outgoing data a slow client may have pending before encoders wait for it */
+#define SHADOW_CLIENT_WRITE_QUEUE_LIMIT (4ull * 1024ull * 1024ull)
+
 typedef struct
 {
 	BOOL gfxOpened;
@@ -281,6 +284,10 @@ static BOOL shadow_client_context_new(freerdp_peer* peer, rdpContext* context)
 		return FALSE;
 	if (!freerdp_settings_set_uint32(settings, FreeRDP_CompressionLevel, PACKET_COMPR_TYPE_RDP8))
 		return FALSE;
+	if (!freerdp_settings_set_uint32(
+	        settings, FreeRDP_XCrushCompressionLevel,
+	        freerdp_settings_get_uint32(srvSettings, FreeRDP_XCrushCompressionLevel)))
+		return FALSE;
 
 	if (server->ipcSocket && (strncmp(bind_address, server->ipcSocket,
 	                                  strnlen(bind_address, sizeof(bind_address))) != 0))
@@ -852,6 +859,10 @@ static UINT shadow_client_send_caps_confirm(RdpgfxServerContext* context, rdpSha
 	WINPR_ASSERT(context->CapsConfirm);
 	UINT rc = context->CapsConfirm(context, pdu);
 	client->areGfxCapsReady = (rc == CHANNEL_RC_OK);
+
+	WINPR_ASSERT(client->encoder);
+	WINPR_ASSERT(pdu->capsSet);
+	client->encoder->gfxCapsVersion = pdu->capsSet->version;
 	return rc;
 }
 
@@ -1121,14 +1132,164 @@ static INLINE UINT32 rdpgfx_estimate_h264_avc420(RDPGFX_AVC420_BITMAP_STREAM* ha
 	       havc420->length;
 }
 
+/**
+ * Function description
+ * Select the shared encoder parameters for a GFX update
+ *
+ * @return TRUE if the update can be served from the shared encoder
+ */
+static BOOL shadow_client_get_shared_encoder_key(rdpShadowClient* client, UINT16 nWidth,
+                                                 UINT16 nHeight, SHADOW_SHARED_ENCODER_KEY* key)
+{
+	WINPR_ASSERT(client);
+	WINPR_ASSERT(client->server);
+	WINPR_ASSERT(client->encoder);
+	WINPR_ASSERT(key);
+
+	const rdpSettings* settings = client->context.settings;
+	WINPR_ASSERT(settings);
+
+	/* Only updates of the primary surface are the same for all clients */
+	if (!client->server->sharedEncoder || client->inLobby)
+		return FALSE;
+
+#ifdef WITH_GFX_H264
+	/* H.264 references previous frames of the client stream, can not be shared */
+	if (freerdp_settings_get_bool(settings, FreeRDP_GfxH264) ||
+	    freerdp_settings_get_bool(settings, FreeRDP_GfxAVC444) ||
+	    freerdp_settings_get_bool(settings, FreeRDP_GfxAVC444v2))
+		return FALSE;
+#endif
+
+	key->capsVersion = client->encoder->gfxCapsVersion;
+	key->width = nWidth;
+	key->height = nHeight;
+	key->quality = 0;
+
+	if (freerdp_settings_get_bool(settings, FreeRDP_RemoteFxCodec) &&
+	    (freerdp_settings_get_uint32(settings, FreeRDP_RemoteFxCodecId) != 0))
+	{
+		key->codecId = RDPGFX_CODECID_CAVIDEO;
+		key->quality =
+		    freerdp_settings_get_uint32(client->server->settings, FreeRDP_RemoteFxRlgrMode);
+	}
+	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxProgressive))
+		key->codecId = RDPGFX_CODECID_CAPROGRESSIVE;
+	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxPlanar))
+	{
+		key->codecId = RDPGFX_CODECID_PLANAR;
+		key->quality = PLANAR_FORMAT_HEADER_RLE;
+		if (freerdp_settings_get_bool(settings, FreeRDP_DrawAllowSkipAlpha))
+			key->quality |= PLANAR_FORMAT_HEADER_NA;
+	}
+	else
+		key->codecId = RDPGFX_CODECID_UNCOMPRESSED;
+
+	return TRUE;
+}
+
+/**
+ * Function description
+ * Send a GFX update encoded by the shared encoder
+ *
+ * @return TRUE on success
+ */
+static BOOL shadow_client_send_surface_gfx_shared(rdpShadowClient* client,
+                                                  const SHADOW_SHARED_ENCODER_KEY* key,
+                                                  const REGION16* region, const BYTE* pSrcData,
+                                                  UINT32 nSrcStep, UINT32 SrcFormat,
+                                                  RDPGFX_SURFACE_COMMAND* cmd,
+                                                  const RDPGFX_START_FRAME_PDU* cmdstart,
+                                                  const RDPGFX_END_FRAME_PDU* cmdend)
+{
+	BOOL ret = FALSE;
+	UINT error = CHANNEL_RC_OK;
+	wStream* s = NULL;
+	rdpShadowEncoder* encoder = client->encoder;
+
+	WINPR_ASSERT(encoder);
+	WINPR_ASSERT(key);
+	WINPR_ASSERT(cmd);
+
+	rdpShadowSharedFrame* frame = shadow_shared_encoder_get_frame(
+	    client->server->sharedEncoder, key, region, pSrcData, SrcFormat, nSrcStep);
+
+	if (!frame)
+	{
+		WLog_ERR(TAG, "Failed to get shared frame for codec 0x%04" PRIx32, key->codecId);
+		return FALSE;
+	}
+
+	cmd->codecId = WINPR_ASSERTING_INT_CAST(UINT16, key->codecId);
+
+	if (frame->rfxMessage)
+	{
+		/* The tiles are shared, the message headers depend on the client context */
+		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_REMOTEFX) < 0)
+		{
+			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_REMOTEFX");
+			goto out;
+		}
+
+		s = Stream_New(NULL, 1024);
+
+		if (!s || !rfx_write_message(encoder->rfx, s, frame->rfxMessage))
+		{
+			WLog_ERR(TAG, "rfx_write_message failed");
+			goto out;
+		}
+
+		const size_t pos = Stream_GetPosition(s);
+		WINPR_ASSERT(pos <= UINT32_MAX);
+		cmd->data = Stream_Buffer(s);
+		cmd->length = (UINT32)pos;
+
+		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, cmd, cmdstart,
+		          cmdend);
+	}
+	else
+	{
+		/* Multiple parts are sent as consecutive commands of the same frame */
+		for (UINT32 x = 0; (x < frame->numParts) && (error == CHANNEL_RC_OK); x++)
+		{
+			const SHADOW_SHARED_FRAME_PART* part = &frame->parts[x];
+			const BYTE* data = part->data;
+
+			cmd->left = part->rect.left;
+			cmd->top = part->rect.top;
+			cmd->right = part->rect.right;
+			cmd->bottom = part->rect.bottom;
+			cmd->width = cmd->right - cmd->left;
+			cmd->height = cmd->bottom - cmd->top;
+			cmd->data = WINPR_CAST_CONST_PTR_AWAY(data, BYTE*);
+			cmd->length = part->length;
+
+			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, cmd,
+			          (x == 0) ? cmdstart : NULL, ((x + 1) == frame->numParts) ? cmdend : NULL);
+		}
+	}
+
+	if (error)
+	{
+		WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+		goto out;
+	}
+
+	ret = TRUE;
+out:
+	Stream_Free(s, TRUE);
+	shadow_shared_frame_release(frame);
+	return ret;
+}
+
 /**
  * Function description
  *
  * @return TRUE on success
  */
 static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE* pSrcData,
-                                           UINT32 nSrcStep, UINT32 SrcFormat, UINT16 nXSrc,
-                                           UINT16 nYSrc, UINT16 nWidth, UINT16 nHeight)
+                                           UINT32 nSrcStep, UINT32 SrcFormat, UINT16 nWidth,
+                                           UINT16 nHeight, const REGION16* region)
 {
 	UINT32 id = 0;
 	UINT error = CHANNEL_RC_OK;
@@ -1138,11 +1299,19 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	RDPGFX_SURFACE_COMMAND cmd = { 0 };
 	RDPGFX_START_FRAME_PDU cmdstart = { 0 };
 	RDPGFX_END_FRAME_PDU cmdend = { 0 };
+	SHADOW_SHARED_ENCODER_KEY key = { 0 };
 	SYSTEMTIME sTime = { 0 };
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects = NULL;
 
-	if (!context || !pSrcData)
+	if (!context || !pSrcData || !region)
 		return FALSE;
 
+	rects = region16_rects(region, &numRects);
+
+	if (numRects == 0)
+		return TRUE;
+
 	settings = context->settings;
 	encoder = client->encoder;
 
@@ -1162,13 +1331,17 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	cmdend.frameId = cmdstart.frameId;
 	cmd.surfaceId = client->surfaceId;
 	cmd.format = PIXEL_FORMAT_BGRX32;
-	cmd.left = nXSrc;
-	cmd.top = nYSrc;
-	cmd.right = cmd.left + nWidth;
-	cmd.bottom = cmd.top + nHeight;
+	cmd.left = 0;
+	cmd.top = 0;
+	cmd.right = nWidth;
+	cmd.bottom = nHeight;
 	cmd.width = nWidth;
 	cmd.height = nHeight;
 
+	if (shadow_client_get_shared_encoder_key(client, nWidth, nHeight, &key))
+		return shadow_client_send_surface_gfx_shared(client, &key, region, pSrcData, nSrcStep,
+		                                             SrcFormat, &cmd, &cmdstart, &cmdend);
+
 	id = freerdp_settings_get_uint32(settings, FreeRDP_RemoteFxCodecId);
 #ifdef WITH_GFX_H264
 	const BOOL GfxH264 = freerdp_settings_get_bool(settings, FreeRDP_GfxH264);
@@ -1275,7 +1448,7 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	{
 		BOOL rc = 0;
 		wStream* s = NULL;
-		RFX_RECT rect;
+		RFX_RECT* rfxRects = NULL;
 
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_REMOTEFX) < 0)
 		{
@@ -1286,16 +1459,24 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 		s = Stream_New(NULL, 1024);
 		WINPR_ASSERT(s);
 
-		WINPR_ASSERT(cmd.left <= UINT16_MAX);
-		WINPR_ASSERT(cmd.top <= UINT16_MAX);
-		WINPR_ASSERT(cmd.right <= UINT16_MAX);
-		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
-		rect.x = (UINT16)cmd.left;
-		rect.y = (UINT16)cmd.top;
-		rect.width = WINPR_ASSERTING_INT_CAST(UINT16, cmd.right - cmd.left);
-		rect.height = WINPR_ASSERTING_INT_CAST(UINT16, cmd.bottom - cmd.top);
+		rfxRects = calloc(numRects, sizeof(RFX_RECT));
+		if (!rfxRects)
+		{
+			Stream_Free(s, TRUE);
+			return FALSE;
+		}
 
-		rc = rfx_compose_message(encoder->rfx, s, &rect, 1, pSrcData, nWidth, nHeight, nSrcStep);
+		for (UINT32 x = 0; x < numRects; x++)
+		{
+			rfxRects[x].x = rects[x].left;
+			rfxRects[x].y = rects[x].top;
+			rfxRects[x].width = rects[x].right - rects[x].left;
+			rfxRects[x].height = rects[x].bottom - rects[x].top;
+		}
+
+		rc = rfx_compose_message(encoder->rfx, s, rfxRects, numRects, pSrcData, nWidth, nHeight,
+		                         nSrcStep);
+		free(rfxRects);
 
 		if (!rc)
 		{
@@ -1328,8 +1509,6 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxProgressive))
 	{
 		INT32 rc = 0;
-		REGION16 region;
-		RECTANGLE_16 regionRect;
 
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PROGRESSIVE) < 0)
 		{
@@ -1337,19 +1516,8 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 			return FALSE;
 		}
 
-		WINPR_ASSERT(cmd.left <= UINT16_MAX);
-		WINPR_ASSERT(cmd.top <= UINT16_MAX);
-		WINPR_ASSERT(cmd.right <= UINT16_MAX);
-		WINPR_ASSERT(cmd.bottom <= UINT16_MAX);
-		regionRect.left = (UINT16)cmd.left;
-		regionRect.top = (UINT16)cmd.top;
-		regionRect.right = (UINT16)cmd.right;
-		regionRect.bottom = (UINT16)cmd.bottom;
-		region16_init(&region);
-		region16_union_rect(&region, &region, &regionRect);
 		rc = progressive_compress(encoder->progressive, pSrcData, nSrcStep * nHeight, cmd.format,
-		                          nWidth, nHeight, nSrcStep, &region, &cmd.data, &cmd.length);
-		region16_uninit(&region);
+		                          nWidth, nHeight, nSrcStep, region, &cmd.data, &cmd.length);
 		if (rc < 0)
 		{
 			WLog_ERR(TAG, "progressive_compress failed");
@@ -1373,61 +1541,86 @@ static BOOL shadow_client_send_surface_gfx(rdpShadowClient* client, const BYTE*
 	}
 	else if (freerdp_settings_get_bool(settings, FreeRDP_GfxPlanar))
 	{
-		BOOL rc = 0;
-		const UINT32 w = cmd.right - cmd.left;
-		const UINT32 h = cmd.bottom - cmd.top;
-		const BYTE* src =
-		    &pSrcData[cmd.top * nSrcStep + cmd.left * FreeRDPGetBytesPerPixel(SrcFormat)];
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_PLANAR) < 0)
 		{
 			WLog_ERR(TAG, "Failed to prepare encoder FREERDP_CODEC_PLANAR");
 			return FALSE;
 		}
 
-		rc = freerdp_bitmap_planar_context_reset(encoder->planar, w, h);
-		WINPR_ASSERT(rc);
-		freerdp_planar_topdown_image(encoder->planar, TRUE);
-
-		cmd.data = freerdp_bitmap_compress_planar(encoder->planar, src, SrcFormat, w, h, nSrcStep,
-		                                          NULL, &cmd.length);
-		WINPR_ASSERT(cmd.data || (cmd.length == 0));
-
 		cmd.codecId = RDPGFX_CODECID_PLANAR;
 
-		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-		          &cmdend);
-		free(cmd.data);
-		if (error)
+		/* One command per rectangle, all in the same frame */
+		for (UINT32 x = 0; x < numRects; x++)
 		{
-			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
-			return FALSE;
+			BOOL rc = 0;
+			const RECTANGLE_16* rect = &rects[x];
+
+			cmd.left = rect->left;
+			cmd.top = rect->top;
+			cmd.right = rect->right;
+			cmd.bottom = rect->bottom;
+			cmd.width = cmd.right - cmd.left;
+			cmd.height = cmd.bottom - cmd.top;
+
+			const BYTE* src =
+			    &pSrcData[cmd.top * nSrcStep + cmd.left * FreeRDPGetBytesPerPixel(SrcFormat)];
+
+			rc = freerdp_bitmap_planar_context_reset(encoder->planar, cmd.width, cmd.height);
+			WINPR_ASSERT(rc);
+			freerdp_planar_topdown_image(encoder->planar, TRUE);
+
+			cmd.data = freerdp_bitmap_compress_planar(encoder->planar, src, SrcFormat, cmd.width,
+			                                          cmd.height, nSrcStep, NULL, &cmd.length);
+			WINPR_ASSERT(cmd.data || (cmd.length == 0));
+
+			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd,
+			          (x == 0) ? &cmdstart : NULL, ((x + 1) == numRects) ? &cmdend : NULL);
+			free(cmd.data);
+			if (error)
+			{
+				WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+				return FALSE;
+			}
 		}
 	}
 	else
 	{
-		BOOL rc = 0;
-		const UINT32 w = cmd.right - cmd.left;
-		const UINT32 h = cmd.bottom - cmd.top;
-		const UINT32 length = w * 4 * h;
-		BYTE* data = malloc(length);
+		cmd.codecId = RDPGFX_CODECID_UNCOMPRESSED;
 
-		WINPR_ASSERT(data);
+		/* One command per rectangle, all in the same frame */
+		for (UINT32 x = 0; x < numRects; x++)
+		{
+			BOOL rc = 0;
+			const RECTANGLE_16* rect = &rects[x];
 
-		rc = freerdp_image_copy_no_overlap(data, PIXEL_FORMAT_BGRA32, 0, 0, 0, w, h, pSrcData,
-		                                   SrcFormat, nSrcStep, cmd.left, cmd.top, NULL, 0);
-		WINPR_ASSERT(rc);
+			cmd.left = rect->left;
+			cmd.top = rect->top;
+			cmd.right = rect->right;
+			cmd.bottom = rect->bottom;
+			cmd.width = cmd.right - cmd.left;
+			cmd.height = cmd.bottom - cmd.top;
 
-		cmd.data = data;
-		cmd.length = length;
-		cmd.codecId = RDPGFX_CODECID_UNCOMPRESSED;
+			const UINT32 length = cmd.width * 4 * cmd.height;
+			BYTE* data = malloc(length);
 
-		IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd, &cmdstart,
-		          &cmdend);
-		free(data);
-		if (error)
-		{
-			WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
-			return FALSE;
+			WINPR_ASSERT(data);
+
+			rc = freerdp_image_copy_no_overlap(data, PIXEL_FORMAT_BGRA32, 0, 0, 0, cmd.width,
+			                                   cmd.height, pSrcData, SrcFormat, nSrcStep, cmd.left,
+			                                   cmd.top, NULL, 0);
+			WINPR_ASSERT(rc);
+
+			cmd.data = data;
+			cmd.length = length;
+
+			IFCALLRET(client->rdpgfx->SurfaceFrameCommand, error, client->rdpgfx, &cmd,
+			          (x == 0) ? &cmdstart : NULL, ((x + 1) == numRects) ? &cmdend : NULL);
+			free(data);
+			if (error)
+			{
+				WLog_ERR(TAG, "SurfaceFrameCommand failed with error %" PRIu32 "", error);
+				return FALSE;
+			}
 		}
 	}
 	return TRUE;
@@ -1472,8 +1665,7 @@ static BOOL is_surface_command_supported(const rdpSettings* settings)
  * @return TRUE on success
  */
 static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcData,
-                                            UINT32 nSrcStep, UINT16 nXSrc, UINT16 nYSrc,
-                                            UINT16 nWidth, UINT16 nHeight)
+                                            UINT32 nSrcStep, const REGION16* region)
 {
 	BOOL ret = TRUE;
 	BOOL first = 0;
@@ -1486,10 +1678,17 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 	rdpSettings* settings = NULL;
 	rdpShadowEncoder* encoder = NULL;
 	SURFACE_BITS_COMMAND cmd = { 0 };
+	UINT32 numRects = 0;
+	const RECTANGLE_16* rects = NULL;
 
-	if (!context || !pSrcData)
+	if (!context || !pSrcData || !region)
 		return FALSE;
 
+	rects = region16_rects(region, &numRects);
+
+	if (numRects == 0)
+		return TRUE;
+
 	update = context->update;
 	settings = context->settings;
 	encoder = client->encoder;
@@ -1506,7 +1705,7 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 	if (stream_surface_bits_supported(settings) &&
 	    freerdp_settings_get_bool(settings, FreeRDP_RemoteFxCodec) && (rfxID != 0))
 	{
-		RFX_RECT rect = { 0 };
+		RFX_RECT* rfxRects = NULL;
 
 		if (shadow_encoder_prepare(encoder, FREERDP_CODEC_REMOTEFX) < 0)
 		{
@@ -1514,19 +1713,28 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 			return FALSE;
 		}
 
+		rfxRects = calloc(numRects, sizeof(RFX_RECT));
+		if (!rfxRects)
+			return FALSE;
+
+		for (UINT32 x = 0; x < numRects; x++)
+		{
+			rfxRects[x].x = rects[x].left;
+			rfxRects[x].y = rects[x].top;
+			rfxRects[x].width = rects[x].right - rects[x].left;
+			rfxRects[x].height = rects[x].bottom - rects[x].top;
+		}
+
 		s = encoder->bs;
-		rect.x = nXSrc;
-		rect.y = nYSrc;
-		rect.width = nWidth;
-		rect.height = nHeight;
 
 		const UINT32 MultifragMaxRequestSize =
 		    freerdp_settings_get_uint32(settings, FreeRDP_MultifragMaxRequestSize);
 		RFX_MESSAGE_LIST* messages =
-		    rfx_encode_messages(encoder->rfx, &rect, 1, pSrcData,
+		    rfx_encode_messages(encoder->rfx, rfxRects, numRects, pSrcData,
 		                        freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth),
 		                        freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight),
 		                        nSrcStep, &numMessages, MultifragMaxRequestSize);
+		free(rfxRects);
 		if (!messages)
 		{
 			WLog_ERR(TAG, "rfx_encode_messages failed");
@@ -1591,33 +1799,45 @@ static BOOL shadow_client_send_surface_bits(rdpShadowClient* client, BYTE* pSrcD
 		}
 
 		s = encoder->bs;
-		Stream_SetPosition(s, 0);
-		pSrcData = &pSrcData[(nYSrc * nSrcStep) + (nXSrc * 4)];
-		nsc_compose_message(encoder->nsc, s, pSrcData, nWidth, nHeight, nSrcStep);
 		cmd.cmdType = CMDTYPE_SET_SURFACE_BITS;
 		cmd.bmp.bpp = 32;
 		WINPR_ASSERT(nsID <= UINT16_MAX);
 		cmd.bmp.codecID = (UINT16)nsID;
-		cmd.destLeft = nXSrc;
-		cmd.destTop = nYSrc;
-		cmd.destRight = cmd.destLeft + nWidth;
-		cmd.destBottom = cmd.destTop + nHeight;
-		cmd.bmp.width = nWidth;
-		cmd.bmp.height = nHeight;
-		WINPR_ASSERT(Stream_GetPosition(s) <= UINT32_MAX);
-		cmd.bmp.bitmapDataLength = (UINT32)Stream_GetPosition(s);
-		cmd.bmp.bitmapData = Stream_Buffer(s);
-		first = TRUE;
-		last = TRUE;
-
-		if (!encoder->frameAck)
-			IFCALLRET(update->SurfaceBits, ret, update->context, &cmd);
-		else
-			IFCALLRET(update->SurfaceFrameBits, ret, update->context, &cmd, first, last, frameId);
 
-		if (!ret)
+		/* One command per rectangle, all in the same frame */
+		for (UINT32 x = 0; x < numRects; x++)
 		{
-			WLog_ERR(TAG, "Send surface bits(NSCodec) failed");
+			const RECTANGLE_16* rect = &rects[x];
+			const UINT16 nWidth = rect->right - rect->left;
+			const UINT16 nHeight = rect->bottom - rect->top;
+
+			Stream_SetPosition(s, 0);
+			nsc_compose_message(encoder->nsc, s,
+			                    &pSrcData[(1ull * rect->top * nSrcStep) + (rect->left * 4ull)],
+			                    nWidth, nHeight, nSrcStep);
+			cmd.destLeft = rect->left;
+			cmd.destTop = rect->top;
+			cmd.destRight = rect->right;
+			cmd.destBottom = rect->bottom;
+			cmd.bmp.width = nWidth;
+			cmd.bmp.height = nHeight;
+			WINPR_ASSERT(Stream_GetPosition(s) <= UINT32_MAX);
+			cmd.bmp.bitmapDataLength = (UINT32)Stream_GetPosition(s);
+			cmd.bmp.bitmapData = Stream_Buffer(s);
+			first = (x == 0) ? TRUE : FALSE;
+			last = ((x + 1) == numRects) ? TRUE : FALSE;
+
+			if (!encoder->frameAck)
+				IFCALLRET(update->SurfaceBits, ret, update->context, &cmd);
+			else
+				IFCALLRET(update->SurfaceFrameBits, ret, update->context, &cmd, first, last,
+				          frameId);
+
+			if (!ret)
+			{
+				WLog_ERR(TAG, "Send surface bits(NSCodec) failed");
+				break;
+			}
 		}
 	}
 
@@ -1843,17 +2063,13 @@ out:
 static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GFX_STATUS* pStatus)
 {
 	BOOL ret = TRUE;
-	INT64 nXSrc = 0;
-	INT64 nYSrc = 0;
-	INT64 nWidth = 0;
-	INT64 nHeight = 0;
 	rdpContext* context = (rdpContext*)client;
 	rdpSettings* settings = NULL;
 	rdpShadowServer* server = NULL;
 	rdpShadowSurface* surface = NULL;
 	REGION16 invalidRegion;
+	REGION16 updateRegion;
 	RECTANGLE_16 surfaceRect;
-	const RECTANGLE_16* extents = NULL;
 	BYTE* pSrcData = NULL;
 	UINT32 nSrcStep = 0;
 	UINT32 SrcFormat = 0;
@@ -1876,6 +2092,7 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 
 	EnterCriticalSection(&(client->lock));
 	region16_init(&invalidRegion);
+	region16_init(&updateRegion);
 	region16_copy(&invalidRegion, &(client->invalidRegion));
 	region16_clear(&(client->invalidRegion));
 	LeaveCriticalSection(&(client->lock));
@@ -1905,46 +2122,51 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 		goto out;
 	}
 
-	extents = region16_extents(&invalidRegion);
-	nXSrc = extents->left;
-	nYSrc = extents->top;
-	nWidth = extents->right - extents->left;
-	nHeight = extents->bottom - extents->top;
 	pSrcData = surface->data;
 	nSrcStep = surface->scanline;
 	SrcFormat = surface->format;
 
-	/* Move to new pSrcData / nXSrc / nYSrc according to sub rect */
+	/* Move to new pSrcData and region origin according to sub rect */
 	if (server->shareSubRect)
 	{
-		INT32 subX = 0;
-		INT32 subY = 0;
-		subX = server->subRect.left;
-		subY = server->subRect.top;
-		nXSrc -= subX;
-		nYSrc -= subY;
-		WINPR_ASSERT(nXSrc >= 0);
-		WINPR_ASSERT(nXSrc <= UINT16_MAX);
-		WINPR_ASSERT(nYSrc >= 0);
-		WINPR_ASSERT(nYSrc <= UINT16_MAX);
-		pSrcData = &pSrcData[((UINT16)subY * nSrcStep) + ((UINT16)subX * 4U)];
-	}
+		const UINT16 subX = server->subRect.left;
+		const UINT16 subY = server->subRect.top;
 
-	// WLog_INFO(TAG, "shadow_client_send_surface_update: x: %" PRId64 " y: %" PRId64 " width: %"
-	// PRId64 " height: %" PRId64 " right: %" PRId64 " bottom: %" PRId64, 	nXSrc, nYSrc, nWidth,
-	// nHeight, nXSrc + nWidth, nYSrc + nHeight);
+		rects = region16_rects(&invalidRegion, &numRects);
+
+		for (UINT32 index = 0; index < numRects; index++)
+		{
+			RECTANGLE_16 rect = rects[index];
+			WINPR_ASSERT(rect.left >= subX);
+			WINPR_ASSERT(rect.top >= subY);
+			rect.left -= subX;
+			rect.right -= subX;
+			rect.top -= subY;
+			rect.bottom -= subY;
+			region16_union_rect(&updateRegion, &updateRegion, &rect);
+		}
+
+		pSrcData = &pSrcData[(subY * nSrcStep) + (subX * 4U)];
+	}
+	else
+		region16_copy(&updateRegion, &invalidRegion);
 
 	if (freerdp_settings_get_bool(settings, FreeRDP_SupportGraphicsPipeline))
 	{
 		if (pStatus->gfxOpened && client->areGfxCapsReady)
 		{
-			/* GFX/h264 always full screen encoded */
-			nWidth = freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth);
-			nHeight = freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight);
+			/* GFX surface always covers the whole desktop */
+			const UINT32 nWidth = freerdp_settings_get_uint32(settings, FreeRDP_DesktopWidth);
+			const UINT32 nHeight = freerdp_settings_get_uint32(settings, FreeRDP_DesktopHeight);
+
+			WINPR_ASSERT(nWidth <= UINT16_MAX);
+			WINPR_ASSERT(nHeight <= UINT16_MAX);
 
 			/* Create primary surface if have not */
 			if (!pStatus->gfxSurfaceCreated)
 			{
+				const RECTANGLE_16 desktopRect = { 0, 0, (UINT16)nWidth, (UINT16)nHeight };
+
 				/* Only init surface when we have h264 supported */
 				if (!(ret = shadow_client_rdpgfx_reset_graphic(client)))
 					goto out;
@@ -1953,14 +2175,13 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 					goto out;
 
 				pStatus->gfxSurfaceCreated = TRUE;
+
+				/* A new surface has no content, send all of it */
+				region16_union_rect(&updateRegion, &updateRegion, &desktopRect);
 			}
 
-			WINPR_ASSERT(nWidth >= 0);
-			WINPR_ASSERT(nWidth <= UINT16_MAX);
-			WINPR_ASSERT(nHeight >= 0);
-			WINPR_ASSERT(nHeight <= UINT16_MAX);
-			ret = shadow_client_send_surface_gfx(client, pSrcData, nSrcStep, SrcFormat, 0, 0,
-			                                     (UINT16)nWidth, (UINT16)nHeight);
+			ret = shadow_client_send_surface_gfx(client, pSrcData, nSrcStep, SrcFormat,
+			                                     (UINT16)nWidth, (UINT16)nHeight, &updateRegion);
 		}
 		else
 		{
@@ -1969,33 +2190,24 @@ static BOOL shadow_client_send_surface_update(rdpShadowClient* client, SHADOW_GF
 	}
 	else if (is_surface_command_supported(settings))
 	{
-		WINPR_ASSERT(nXSrc >= 0);
-		WINPR_ASSERT(nXSrc <= UINT16_MAX);
-		WINPR_ASSERT(nYSrc >= 0);
-		WINPR_ASSERT(nYSrc <= UINT16_MAX);
-		WINPR_ASSERT(nWidth >= 0);
-		WINPR_ASSERT(nWidth <= UINT16_MAX);
-		WINPR_ASSERT(nHeight >= 0);
-		WINPR_ASSERT(nHeight <= UINT16_MAX);
-		ret = shadow_client_send_surface_bits(client, pSrcData, nSrcStep, (UINT16)nXSrc,
-		                                      (UINT16)nYSrc, (UINT16)nWidth, (UINT16)nHeight);
+		ret = shadow_client_send_surface_bits(client, pSrcData, nSrcStep, &updateRegion);
 	}
 	else
 	{
-		WINPR_ASSERT(nXSrc >= 0);
-		WINPR_ASSERT(nXSrc <= UINT16_MAX);
-		WINPR_ASSERT(nYSrc >= 0);
-		WINPR_ASSERT(nYSrc <= UINT16_MAX);
-		WINPR_ASSERT(nWidth >= 0);
-		WINPR_ASSERT(nWidth <= UINT16_MAX);
-		WINPR_ASSERT(nHeight >= 0);
-		WINPR_ASSERT(nHeight <= UINT16_MAX);
-		ret = shadow_client_send_bitmap_update(client, pSrcData, nSrcStep, (UINT16)nXSrc,
-		                                       (UINT16)nYSrc, (UINT16)nWidth, (UINT16)nHeight);
+		rects = region16_rects(&updateRegion, &numRects);
+
+		for (UINT32 index = 0; ret && (index < numRects); index++)
+		{
+			const RECTANGLE_16* rect = &rects[index];
+			ret = shadow_client_send_bitmap_update(client, pSrcData, nSrcStep, rect->left,
+			                                       rect->top, rect->right - rect->left,
+			                                       rect->bottom - rect->top);
+		}
 	}
 
 out:
 	LeaveCriticalSection(&surface->lock);
+	region16_uninit(&updateRegion);
 	region16_uninit(&invalidRegion);
 	return ret;
 }
@@ -2218,6 +2430,7 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	rdpShadowServer* server = NULL;
 	rdpShadowSubsystem* subsystem = NULL;
 	wMessageQueue* MsgQueue = NULL;
+	WINPR_WAIT_SET* waitSet = NULL;
 	/* This should only be visited in client thread */
 	SHADOW_GFX_STATUS gfxstatus = { 0 };
 	rdpUpdate* update = NULL;
@@ -2248,6 +2461,9 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	if (!rc)
 		goto out;
 
+	if (!freerdp_set_write_queue_limit(peer->context, SHADOW_CLIENT_WRITE_QUEUE_LIMIT))
+		goto out;
+
 	update = peer->context->update;
 	WINPR_ASSERT(update);
 
@@ -2277,6 +2493,11 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 	WINPR_ASSERT(rc);
 	rc = freerdp_settings_set_bool(settings, FreeRDP_SupportMonitorLayoutPdu, TRUE);
 	WINPR_ASSERT(rc);
+
+	waitSet = winpr_WaitSet_New();
+	if (!waitSet)
+		goto fail;
+
 	while (1)
 	{
 		HANDLE events[MAXIMUM_WAIT_OBJECTS] = { 0 };
@@ -2303,11 +2524,27 @@ static DWORD WINAPI shadow_client_thread(LPVOID arg)
 			events[nCount++] = gfxevent;
 #endif
 
-		status = WaitForMultipleObjects(nCount, events, FALSE, INFINITE);
+		/* the socket is not signaled while it can not take more data, poll it instead */
+		WINPR_ASSERT(peer->IsWriteBlocked);
+		const BOOL writeBlocked = peer->IsWriteBlocked(peer);
+		if (!winpr_WaitSet_Update(waitSet, nCount, events))
+			goto fail;
+
+		status = winpr_WaitSet_Wait(waitSet, writeBlocked ? 10 : INFINITE);
 
 		if (status == WAIT_FAILED)
 			goto fail;
 
+		if (writeBlocked)
+		{
+			WINPR_ASSERT(peer->DrainOutputBuffer);
+			if (peer->DrainOutputBuffer(peer) < 0)
+			{
+				WLog_ERR(TAG, "Failed to drain output buffer");
+				goto fail;
+			}
+		}
+
 		if (WaitForSingleObject(UpdateEvent, 0) == WAIT_OBJECT_0)
 		{
 			/* The UpdateEvent means to start sending current frame. It is
@@ -2554,6 +2791,7 @@ fail:
 	}
 
 out:
+	winpr_WaitSet_Free(waitSet);
 	WINPR_ASSERT(peer->Disconnect);
 	peer->Disconnect(peer);
 	freerdp_peer_context_free(peer);
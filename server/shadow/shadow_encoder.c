@@ -178,6 +178,10 @@ static int shadow_encoder_init_nsc(rdpShadowEncoder* encoder)
 		goto fail;
 	if (!nsc_context_set_parameters(encoder->nsc, NSC_COLOR_FORMAT, PIXEL_FORMAT_BGRX32))
 		goto fail;
+	if (!nsc_context_set_parameters(
+	        encoder->nsc, NSC_THREADING_FLAGS,
+	        freerdp_settings_get_uint32(encoder->server->settings, FreeRDP_ThreadingFlags)))
+		goto fail;
 	encoder->codecs |= FREERDP_CODEC_NSCODEC;
 	return 1;
 fail:
@@ -58,6 +58,8 @@ struct rdp_shadow_encoder
 	UINT32 frameId;
 	UINT32 lastAckframeId;
 	UINT32 queueDepth;
+
+	UINT32 gfxCapsVersion;
 };
 
 #ifdef __cplusplus
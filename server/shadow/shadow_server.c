@@ -480,6 +480,17 @@ int shadow_server_parse_command_line(rdpShadowServer* server, int argc, char** a
 			if (!freerdp_settings_set_bool(settings, FreeRDP_GfxAVC444, arg->Value ? TRUE : FALSE))
 				return fail_at(arg, COMMAND_LINE_ERROR);
 		}
+		CommandLineSwitchCase(arg, "xcrush-level")
+		{
+			errno = 0;
+			unsigned long val = strtoul(arg->Value, NULL, 0);
+
+			if ((errno != 0) || (val > XCRUSH_LEVEL_BEST))
+				return fail_at(arg, COMMAND_LINE_ERROR);
+			if (!freerdp_settings_set_uint32(settings, FreeRDP_XCrushCompressionLevel,
+			                                 (UINT32)val))
+				return fail_at(arg, COMMAND_LINE_ERROR);
+		}
 		CommandLineSwitchCase(arg, "keytab")
 		{
 			if (!freerdp_settings_set_string(settings, FreeRDP_KerberosKeytab, arg->Value))
@@ -943,6 +954,11 @@ int shadow_server_init(rdpShadowServer* server)
 	if (!shadow_server_init_certificate(server))
 		goto fail;
 
+	server->sharedEncoder = shadow_shared_encoder_new(server);
+
+	if (!server->sharedEncoder)
+		goto fail;
+
 	server->listener = freerdp_listener_new();
 
 	if (!server->listener)
@@ -979,6 +995,8 @@ int shadow_server_uninit(rdpShadowServer* server)
 	server->subsystem = NULL;
 	freerdp_listener_free(server->listener);
 	server->listener = NULL;
+	shadow_shared_encoder_free(server->sharedEncoder);
+	server->sharedEncoder = NULL;
 	free(server->CertificateFile);
 	server->CertificateFile = NULL;
 	free(server->PrivateKeyFile);
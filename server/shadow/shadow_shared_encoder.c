@@ -0,0 +1,509 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shared Encoder Tier
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <freerdp/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/cast.h>
+#include <winpr/collections.h>
+#include <winpr/interlocked.h>
+
+#include <freerdp/channels/rdpgfx.h>
+#include <freerdp/log.h>
+
+#include "shadow.h"
+
+#include "shadow_shared_encoder.h"
+
+#define TAG SERVER_TAG("shadow.encoder")
+
+/* Drop encoders nobody asked for during this many frames */
+#define SHADOW_SHARED_ENCODER_MAX_IDLE 256
+
+typedef struct
+{
+	SHADOW_SHARED_ENCODER_KEY key;
+	volatile LONG refCount;
+	CRITICAL_SECTION lock;
+	UINT32 lastUsed;
+
+	RFX_CONTEXT* rfx;
+	PROGRESSIVE_CONTEXT* progressive;
+	BITMAP_PLANAR_CONTEXT* planar;
+
+	struct shadow_shared_frame* current;
+} SHADOW_SHARED_ENCODER_ENTRY;
+
+struct shadow_shared_frame
+{
+	rdpShadowSharedFrame common;
+
+	volatile LONG refCount;
+	SHADOW_SHARED_ENCODER_ENTRY* entry;
+	REGION16 region;
+	RFX_MESSAGE* rfxMessage;
+	SHADOW_SHARED_FRAME_PART* parts;
+};
+
+struct rdp_shadow_shared_encoder
+{
+	rdpShadowServer* server;
+	wArrayList* entries;
+	volatile LONG generation;
+
+	volatile LONG encoded;
+	volatile LONG shared;
+};
+
+static void shadow_shared_encoder_entry_release(SHADOW_SHARED_ENCODER_ENTRY* entry)
+{
+	if (!entry)
+		return;
+
+	if (InterlockedDecrement(&entry->refCount) > 0)
+		return;
+
+	WINPR_ASSERT(!entry->current);
+	rfx_context_free(entry->rfx);
+	progressive_context_free(entry->progressive);
+	freerdp_bitmap_planar_context_free(entry->planar);
+	DeleteCriticalSection(&entry->lock);
+	free(entry);
+}
+
+static void shadow_shared_encoder_entry_free(void* obj)
+{
+	SHADOW_SHARED_ENCODER_ENTRY* entry = obj;
+
+	if (!entry)
+		return;
+
+	/* Drop the reference the entry holds on its current frame, clients may still use it */
+	EnterCriticalSection(&entry->lock);
+	struct shadow_shared_frame* current = entry->current;
+	entry->current = NULL;
+	LeaveCriticalSection(&entry->lock);
+
+	if (current)
+		shadow_shared_frame_release(&current->common);
+
+	shadow_shared_encoder_entry_release(entry);
+}
+
+static SHADOW_SHARED_ENCODER_ENTRY*
+shadow_shared_encoder_entry_new(rdpShadowSharedEncoder* encoder,
+                                const SHADOW_SHARED_ENCODER_KEY* key)
+{
+	WINPR_ASSERT(encoder);
+	WINPR_ASSERT(key);
+
+	SHADOW_SHARED_ENCODER_ENTRY* entry = calloc(1, sizeof(SHADOW_SHARED_ENCODER_ENTRY));
+	if (!entry)
+		return NULL;
+
+	entry->key = *key;
+	entry->refCount = 1;
+	if (!InitializeCriticalSectionAndSpinCount(&entry->lock, 4000))
+	{
+		free(entry);
+		return NULL;
+	}
+
+	const UINT32 ThreadingFlags =
+	    freerdp_settings_get_uint32(encoder->server->settings, FreeRDP_ThreadingFlags);
+
+	switch (key->codecId)
+	{
+		case RDPGFX_CODECID_CAVIDEO:
+			entry->rfx = rfx_context_new_ex(TRUE, ThreadingFlags);
+			if (!entry->rfx)
+				goto fail;
+			if (!rfx_context_reset(entry->rfx, key->width, key->height))
+				goto fail;
+			rfx_context_set_mode(entry->rfx, (RLGR_MODE)key->quality);
+			rfx_context_set_pixel_format(entry->rfx, PIXEL_FORMAT_BGRX32);
+			break;
+
+		case RDPGFX_CODECID_CAPROGRESSIVE:
+			entry->progressive = progressive_context_new_ex(TRUE, ThreadingFlags);
+			if (!entry->progressive)
+				goto fail;
+			break;
+
+		case RDPGFX_CODECID_PLANAR:
+			entry->planar =
+			    freerdp_bitmap_planar_context_new(key->quality, key->width, key->height);
+			if (!entry->planar)
+				goto fail;
+			freerdp_planar_topdown_image(entry->planar, TRUE);
+			break;
+
+		case RDPGFX_CODECID_UNCOMPRESSED:
+			break;
+
+		default:
+			WLog_ERR(TAG, "codec 0x%04" PRIx32 " can not be shared", key->codecId);
+			goto fail;
+	}
+
+	return entry;
+fail:
+	shadow_shared_encoder_entry_release(entry);
+	return NULL;
+}
+
+static BOOL shadow_shared_encoder_key_equal(const SHADOW_SHARED_ENCODER_KEY* a,
+                                            const SHADOW_SHARED_ENCODER_KEY* b)
+{
+	return (a->codecId == b->codecId) && (a->capsVersion == b->capsVersion) &&
+	       (a->quality == b->quality) && (a->width == b->width) && (a->height == b->height);
+}
+
+/* Find (or create) the entry for key and return it with an additional reference */
+static SHADOW_SHARED_ENCODER_ENTRY*
+shadow_shared_encoder_acquire_entry(rdpShadowSharedEncoder* encoder,
+                                    const SHADOW_SHARED_ENCODER_KEY* key, UINT32 generation)
+{
+	SHADOW_SHARED_ENCODER_ENTRY* found = NULL;
+
+	ArrayList_Lock(encoder->entries);
+	for (size_t x = ArrayList_Count(encoder->entries); x > 0; x--)
+	{
+		SHADOW_SHARED_ENCODER_ENTRY* entry = ArrayList_GetItem(encoder->entries, x - 1);
+		WINPR_ASSERT(entry);
+
+		if (shadow_shared_encoder_key_equal(&entry->key, key))
+			found = entry;
+		else if (generation - entry->lastUsed > SHADOW_SHARED_ENCODER_MAX_IDLE)
+			ArrayList_RemoveAt(encoder->entries, x - 1);
+	}
+
+	if (!found)
+	{
+		found = shadow_shared_encoder_entry_new(encoder, key);
+		if (found && !ArrayList_Append(encoder->entries, found))
+		{
+			shadow_shared_encoder_entry_release(found);
+			found = NULL;
+		}
+	}
+
+	if (found)
+	{
+		found->lastUsed = generation;
+		InterlockedIncrement(&found->refCount);
+	}
+	ArrayList_Unlock(encoder->entries);
+	return found;
+}
+
+static BOOL shadow_shared_encoder_region_equal(const REGION16* a, const REGION16* b)
+{
+	UINT32 na = 0;
+	UINT32 nb = 0;
+	const RECTANGLE_16* ra = region16_rects(a, &na);
+	const RECTANGLE_16* rb = region16_rects(b, &nb);
+
+	if (na != nb)
+		return FALSE;
+
+	for (UINT32 x = 0; x < na; x++)
+	{
+		if (!rectangles_equal(&ra[x], &rb[x]))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL shadow_shared_encoder_encode_part(SHADOW_SHARED_ENCODER_ENTRY* entry,
+                                              SHADOW_SHARED_FRAME_PART* part, const BYTE* pSrcData,
+                                              UINT32 SrcFormat, UINT32 nSrcStep)
+{
+	BYTE* data = NULL;
+	const UINT32 w = part->rect.right - part->rect.left;
+	const UINT32 h = part->rect.bottom - part->rect.top;
+	const BYTE* src =
+	    &pSrcData[1ull * part->rect.top * nSrcStep +
+	              1ull * part->rect.left * FreeRDPGetBytesPerPixel(SrcFormat)];
+
+	switch (entry->key.codecId)
+	{
+		case RDPGFX_CODECID_PLANAR:
+			if (!freerdp_bitmap_planar_context_reset(entry->planar, w, h))
+				return FALSE;
+			data = freerdp_bitmap_compress_planar(entry->planar, src, SrcFormat, w, h, nSrcStep,
+			                                      NULL, &part->length);
+			break;
+
+		case RDPGFX_CODECID_UNCOMPRESSED:
+			part->length = w * 4 * h;
+			data = malloc(part->length);
+			if (data && !freerdp_image_copy_no_overlap(data, PIXEL_FORMAT_BGRA32, 0, 0, 0, w, h,
+			                                           src, SrcFormat, nSrcStep, 0, 0, NULL, 0))
+			{
+				free(data);
+				data = NULL;
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	part->data = data;
+	return data != NULL;
+}
+
+static BOOL shadow_shared_encoder_encode(SHADOW_SHARED_ENCODER_ENTRY* entry,
+                                         struct shadow_shared_frame* frame, const BYTE* pSrcData,
+                                         UINT32 SrcFormat, UINT32 nSrcStep)
+{
+	UINT32 numRects = 0;
+	const SHADOW_SHARED_ENCODER_KEY* key = &entry->key;
+	const RECTANGLE_16* rects = region16_rects(&frame->region, &numRects);
+
+	switch (key->codecId)
+	{
+		case RDPGFX_CODECID_CAVIDEO:
+		{
+			RFX_RECT* rfxRects = calloc(numRects, sizeof(RFX_RECT));
+			if (!rfxRects)
+				return FALSE;
+
+			for (UINT32 x = 0; x < numRects; x++)
+			{
+				rfxRects[x].x = rects[x].left;
+				rfxRects[x].y = rects[x].top;
+				rfxRects[x].width = rects[x].right - rects[x].left;
+				rfxRects[x].height = rects[x].bottom - rects[x].top;
+			}
+
+			frame->rfxMessage = rfx_encode_message(entry->rfx, rfxRects, numRects, pSrcData,
+			                                       key->width, key->height, nSrcStep);
+			free(rfxRects);
+			if (!frame->rfxMessage)
+			{
+				WLog_ERR(TAG, "rfx_encode_message failed");
+				return FALSE;
+			}
+			frame->common.rfxMessage = frame->rfxMessage;
+			return TRUE;
+		}
+
+		case RDPGFX_CODECID_CAPROGRESSIVE:
+		{
+			BYTE* data = NULL;
+			UINT32 length = 0;
+
+			const int rc =
+			    progressive_compress(entry->progressive, pSrcData, nSrcStep * key->height,
+			                         PIXEL_FORMAT_BGRX32, key->width, key->height, nSrcStep,
+			                         &frame->region, &data, &length);
+			if (rc < 0)
+			{
+				WLog_ERR(TAG, "progressive_compress failed");
+				return FALSE;
+			}
+
+			/* rc == 0 means no new data */
+			if ((rc == 0) || (length == 0))
+				return TRUE;
+
+			frame->parts = calloc(1, sizeof(SHADOW_SHARED_FRAME_PART));
+			if (!frame->parts)
+				return FALSE;
+
+			/* The result points into the context, which is reused for the next frame */
+			BYTE* copy = malloc(length);
+			if (!copy)
+				return FALSE;
+			memcpy(copy, data, length);
+
+			frame->parts[0].rect.right = WINPR_ASSERTING_INT_CAST(UINT16, key->width);
+			frame->parts[0].rect.bottom = WINPR_ASSERTING_INT_CAST(UINT16, key->height);
+			frame->parts[0].data = copy;
+			frame->parts[0].length = length;
+			frame->common.numParts = 1;
+			break;
+		}
+
+		case RDPGFX_CODECID_PLANAR:
+		case RDPGFX_CODECID_UNCOMPRESSED:
+		{
+			if (numRects == 0)
+				return TRUE;
+
+			frame->parts = calloc(numRects, sizeof(SHADOW_SHARED_FRAME_PART));
+			if (!frame->parts)
+				return FALSE;
+
+			for (UINT32 x = 0; x < numRects; x++)
+			{
+				SHADOW_SHARED_FRAME_PART* part = &frame->parts[x];
+				part->rect = rects[x];
+
+				if (!shadow_shared_encoder_encode_part(entry, part, pSrcData, SrcFormat, nSrcStep))
+					return FALSE;
+				frame->common.numParts = x + 1;
+			}
+			break;
+		}
+
+		default:
+			return FALSE;
+	}
+
+	frame->common.parts = frame->parts;
+	return TRUE;
+}
+
+rdpShadowSharedFrame* shadow_shared_encoder_get_frame(rdpShadowSharedEncoder* encoder,
+                                                      const SHADOW_SHARED_ENCODER_KEY* key,
+                                                      const REGION16* region,
+                                                      const BYTE* pSrcData, UINT32 SrcFormat,
+                                                      UINT32 nSrcStep)
+{
+	struct shadow_shared_frame* frame = NULL;
+
+	if (!encoder || !key || !region || !pSrcData)
+		return NULL;
+
+	const UINT32 generation = (UINT32)InterlockedCompareExchange(&encoder->generation, 0, 0);
+	SHADOW_SHARED_ENCODER_ENTRY* entry =
+	    shadow_shared_encoder_acquire_entry(encoder, key, generation);
+	if (!entry)
+		return NULL;
+
+	EnterCriticalSection(&entry->lock);
+	if (entry->current && (entry->current->common.generation == generation) &&
+	    shadow_shared_encoder_region_equal(&entry->current->region, region))
+	{
+		frame = entry->current;
+		InterlockedIncrement(&frame->refCount);
+		InterlockedIncrement(&encoder->shared);
+	}
+	else
+	{
+		frame = calloc(1, sizeof(struct shadow_shared_frame));
+		if (frame)
+		{
+			/* One reference for the entry, one for the caller */
+			frame->refCount = 2;
+			frame->entry = entry;
+			frame->common.generation = generation;
+			region16_init(&frame->region);
+			InterlockedIncrement(&entry->refCount);
+
+			if (!region16_copy(&frame->region, region) ||
+			    !shadow_shared_encoder_encode(entry, frame, pSrcData, SrcFormat, nSrcStep))
+			{
+				frame->refCount = 1;
+				shadow_shared_frame_release(&frame->common);
+				frame = NULL;
+			}
+			else
+			{
+				struct shadow_shared_frame* previous = entry->current;
+				entry->current = frame;
+				if (previous)
+					shadow_shared_frame_release(&previous->common);
+				InterlockedIncrement(&encoder->encoded);
+			}
+		}
+	}
+	LeaveCriticalSection(&entry->lock);
+
+	shadow_shared_encoder_entry_release(entry);
+	return frame ? &frame->common : NULL;
+}
+
+void shadow_shared_frame_release(rdpShadowSharedFrame* common)
+{
+	struct shadow_shared_frame* frame = (struct shadow_shared_frame*)common;
+
+	if (!frame)
+		return;
+
+	if (InterlockedDecrement(&frame->refCount) > 0)
+		return;
+
+	SHADOW_SHARED_ENCODER_ENTRY* entry = frame->entry;
+	WINPR_ASSERT(entry);
+
+	if (frame->rfxMessage)
+	{
+		/* The tiles belong to the pools of the encoding context */
+		EnterCriticalSection(&entry->lock);
+		rfx_message_free(entry->rfx, frame->rfxMessage);
+		LeaveCriticalSection(&entry->lock);
+	}
+
+	if (frame->parts)
+	{
+		for (UINT32 x = 0; x < frame->common.numParts; x++)
+			free(WINPR_CAST_CONST_PTR_AWAY(frame->parts[x].data, BYTE*));
+	}
+	free(frame->parts);
+	region16_uninit(&frame->region);
+	free(frame);
+	shadow_shared_encoder_entry_release(entry);
+}
+
+void shadow_shared_encoder_next_frame(rdpShadowSharedEncoder* encoder)
+{
+	if (!encoder)
+		return;
+
+	InterlockedIncrement(&encoder->generation);
+}
+
+rdpShadowSharedEncoder* shadow_shared_encoder_new(rdpShadowServer* server)
+{
+	WINPR_ASSERT(server);
+
+	rdpShadowSharedEncoder* encoder = calloc(1, sizeof(rdpShadowSharedEncoder));
+	if (!encoder)
+		return NULL;
+
+	encoder->server = server;
+	encoder->entries = ArrayList_New(TRUE);
+	if (!encoder->entries)
+		goto fail;
+
+	{
+		wObject* obj = ArrayList_Object(encoder->entries);
+		WINPR_ASSERT(obj);
+		obj->fnObjectFree = shadow_shared_encoder_entry_free;
+	}
+
+	return encoder;
+fail:
+	shadow_shared_encoder_free(encoder);
+	return NULL;
+}
+
+void shadow_shared_encoder_free(rdpShadowSharedEncoder* encoder)
+{
+	if (!encoder)
+		return;
+
+	WLog_DBG(TAG, "shared encoder: %" PRId32 " frames encoded, %" PRId32 " frames shared",
+	         encoder->encoded, encoder->shared);
+	ArrayList_Free(encoder->entries);
+	free(encoder);
+}
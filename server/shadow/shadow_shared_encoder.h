@@ -0,0 +1,104 @@
+/**
+ * FreeRDP: A Remote Desktop Protocol Implementation
+ * Shared Encoder Tier
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FREERDP_SERVER_SHADOW_SHARED_ENCODER_H
+#define FREERDP_SERVER_SHADOW_SHARED_ENCODER_H
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+
+#include <freerdp/codecs.h>
+#include <freerdp/server/shadow.h>
+
+/*
+ * The shared encoder encodes the full primary surface once per captured
+ * frame and per distinct set of encoding parameters. Every client that
+ * negotiated compatible parameters consumes the same (reference counted)
+ * payload instead of running its own encoder on identical input.
+ *
+ * Only codecs that do not carry inter-frame state are shared. H.264 streams
+ * depend on the per client reference frames and are still encoded per client.
+ */
+
+typedef struct
+{
+	UINT32 codecId;     /* RDPGFX_CODECID_* */
+	UINT32 capsVersion; /* RDPGFX_CAPVERSION_* confirmed to the client */
+	UINT32 quality;     /* codec specific: RLGR mode, planar flags, ... */
+	UINT32 width;
+	UINT32 height;
+} SHADOW_SHARED_ENCODER_KEY;
+
+typedef struct rdp_shadow_shared_frame rdpShadowSharedFrame;
+
+typedef struct
+{
+	RECTANGLE_16 rect;
+	const BYTE* data;
+	UINT32 length;
+} SHADOW_SHARED_FRAME_PART;
+
+struct rdp_shadow_shared_frame
+{
+	UINT32 generation;
+
+	/* RDPGFX_CODECID_CAVIDEO: the encoded tiles, serialized per client */
+	const RFX_MESSAGE* rfxMessage;
+
+	/* all other codecs: the ready to send bitmap data. Progressive has a single part
+	 * covering the surface, planar and uncompressed one part per updated rectangle */
+	UINT32 numParts;
+	const SHADOW_SHARED_FRAME_PART* parts;
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	void shadow_shared_encoder_free(rdpShadowSharedEncoder* encoder);
+
+	WINPR_ATTR_MALLOC(shadow_shared_encoder_free, 1)
+	rdpShadowSharedEncoder* shadow_shared_encoder_new(rdpShadowServer* server);
+
+	/** @brief Mark the content of the primary surface as changed.
+	 *
+	 *  Must be called by the capture side before clients are notified of a new frame.
+	 */
+	void shadow_shared_encoder_next_frame(rdpShadowSharedEncoder* encoder);
+
+	/** @brief Get the encoded payload of the current frame for the given parameters
+	 *
+	 *  The first caller of a frame generation encodes the rectangles of \b region, all other
+	 *  callers with an equal key and region receive a reference to the same payload.
+	 *
+	 *  @return A referenced frame to be released with shadow_shared_frame_release or
+	 *          \b NULL on failure.
+	 */
+	rdpShadowSharedFrame* shadow_shared_encoder_get_frame(rdpShadowSharedEncoder* encoder,
+	                                                      const SHADOW_SHARED_ENCODER_KEY* key,
+	                                                      const REGION16* region,
+	                                                      const BYTE* pSrcData, UINT32 SrcFormat,
+	                                                      UINT32 nSrcStep);
+
+	void shadow_shared_frame_release(rdpShadowSharedFrame* frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERDP_SERVER_SHADOW_SHARED_ENCODER_H */
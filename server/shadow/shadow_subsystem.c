@@ -288,5 +288,11 @@ int shadow_subsystem_pointer_convert_alpha_pointer_data_to_format(
 
 void shadow_subsystem_frame_update(rdpShadowSubsystem* subsystem)
 {
+	WINPR_ASSERT(subsystem);
+
+	/* The surface content changed, previously shared encodings are stale */
+	if (subsystem->server)
+		shadow_shared_encoder_next_frame(subsystem->server->sharedEncoder);
+
 	shadow_multiclient_publish_and_wait(subsystem->updateEvent);
 }
@@ -275,6 +275,88 @@ extern "C"
 	}
 #endif
 
+	/* Batch (WinPR extension) */
+
+	/** @brief A batch runs one callback for a set of indexed jobs on a thread pool.
+	 *
+	 *  A batch is created once and can be submitted any number of times. Submitting does
+	 *  not allocate, so it is suitable for per frame or per tile work.
+	 *  @since version 3.11.0
+	 */
+	typedef struct S_TP_BATCH TP_BATCH, *PTP_BATCH;
+
+	/** @brief Batch job callback. \b Instance is \b NULL for jobs run by the waiting thread
+	 *  @since version 3.11.0
+	 */
+	typedef VOID (*PTP_BATCH_CALLBACK)(PTP_CALLBACK_INSTANCE Instance, PVOID Context,
+	                                   UINT32 Index);
+
+	/** @brief Create a batch running \b pfnbt with context \b pv
+	 *
+	 *  @param pfnbt The callback called once per job index
+	 *  @param pv The context passed to every callback
+	 *  @param pcbe The callback environment or \b NULL for the default pool
+	 *
+	 *  @return A new batch or \b NULL in case of failure
+	 *  @since version 3.11.0
+	 */
+	WINPR_API PTP_BATCH winpr_CreateThreadpoolBatch(PTP_BATCH_CALLBACK pfnbt, PVOID pv,
+	                                                PTP_CALLBACK_ENVIRON pcbe);
+
+	/** @brief Wait for all callbacks of \b ptpb and free it
+	 *  @since version 3.11.0
+	 */
+	WINPR_API VOID winpr_CloseThreadpoolBatch(PTP_BATCH ptpb);
+
+	/** @brief Queue the jobs 0 to \b count - 1 of \b ptpb
+	 *
+	 *  A batch must be waited for with winpr_WaitForThreadpoolBatchCallbacks before it is
+	 *  submitted again.
+	 *
+	 *  @return \b TRUE for success, \b FALSE otherwise
+	 *  @since version 3.11.0
+	 */
+	WINPR_API BOOL winpr_SubmitThreadpoolBatch(PTP_BATCH ptpb, UINT32 count);
+
+	/** @brief Wait until all jobs of the last submission of \b ptpb have completed
+	 *
+	 *  The calling thread runs jobs not yet picked up by the pool while waiting.
+	 *  @since version 3.11.0
+	 */
+	WINPR_API VOID winpr_WaitForThreadpoolBatchCallbacks(PTP_BATCH ptpb);
+
+	/* Scheduling (WinPR extension) */
+
+	/** @brief Scheduling policies of a thread pool created with winpr_CreateThreadpoolEx
+	 *  @since version 3.11.0
+	 */
+	typedef enum
+	{
+		WINPR_TP_POLICY_DEFAULT = 0, /**< The default policy, currently work stealing */
+		WINPR_TP_POLICY_SHARED_QUEUE,  /**< All workers take work from one shared queue */
+		WINPR_TP_POLICY_WORK_STEALING, /**< Every worker has its own queue and steals work from
+		                                    the queues of other workers when idle */
+	} WINPR_TP_POLICY;
+
+/** @brief Pin every worker thread of the pool to a single processor
+ *  @since version 3.11.0
+ */
+#define WINPR_TP_FLAG_AFFINITY 0x00000001
+
+	/** @brief Create a thread pool using the scheduling policy \b policy
+	 *
+	 *  The pool is used and freed like one returned by CreateThreadpool. CreateThreadpool
+	 *  itself uses WINPR_TP_POLICY_DEFAULT. When the native Windows thread pool is used
+	 *  \b policy and \b flags are ignored.
+	 *
+	 *  @param policy The scheduling policy
+	 *  @param flags A combination of WINPR_TP_FLAG_* values
+	 *
+	 *  @return A new pool or \b NULL in case of failure
+	 *  @since version 3.11.0
+	 */
+	WINPR_API PTP_POOL winpr_CreateThreadpoolEx(WINPR_TP_POLICY policy, DWORD flags);
+
 #ifdef __cplusplus
 }
 #endif
@@ -455,6 +455,94 @@ extern "C"
 
 	WINPR_API void* GetEventWaitObject(HANDLE hEvent);
 
+	/* Wait sets */
+
+	/**
+	 * A wait set keeps the handles of an event loop registered between waits, so waiting on the
+	 * same handles over and over does not set up a poll set for every call. On linux it is backed
+	 * by epoll, elsewhere it falls back to WaitForMultipleObjects.
+	 *
+	 * The handles must stay valid while they are part of the set, a wait set is not thread safe.
+	 *
+	 * @since version 3.11.0
+	 */
+	typedef struct winpr_wait_set WINPR_WAIT_SET;
+
+	/**
+	 * @brief Free a wait set, the handles in it are not touched
+	 *
+	 * @param set the wait set to free, may be \b NULL
+	 *
+	 * @since version 3.11.0
+	 */
+	WINPR_API void winpr_WaitSet_Free(WINPR_WAIT_SET* set);
+
+	/**
+	 * @brief Create an empty wait set
+	 *
+	 * @return the new wait set or \b NULL in case of failure
+	 *
+	 * @since version 3.11.0
+	 */
+	WINPR_ATTR_MALLOC(winpr_WaitSet_Free, 1)
+	WINPR_API WINPR_WAIT_SET* winpr_WaitSet_New(void);
+
+	/**
+	 * @brief Make the set wait for exactly the given handles, in the given order
+	 *
+	 * Handles already registered are kept, so calling this with an unchanged list on every loop
+	 * iteration is cheap.
+	 *
+	 * @param set the wait set
+	 * @param nCount the number of handles, at most \b MAXIMUM_WAIT_OBJECTS
+	 * @param lpHandles the handles, the index of a handle is reported by \b winpr_WaitSet_Wait
+	 *
+	 * @return \b TRUE for success, \b FALSE if a handle is invalid (the set is left unchanged) or
+	 * the registration failed (the set is emptied)
+	 *
+	 * @since version 3.11.0
+	 */
+	WINPR_API BOOL winpr_WaitSet_Update(WINPR_WAIT_SET* set, DWORD nCount, const HANDLE* lpHandles);
+
+	/**
+	 * @brief Append a handle to a wait set
+	 *
+	 * @param set the wait set
+	 * @param handle the handle to wait for
+	 *
+	 * @return \b TRUE for success, \b FALSE otherwise
+	 *
+	 * @since version 3.11.0
+	 */
+	WINPR_API BOOL winpr_WaitSet_Add(WINPR_WAIT_SET* set, HANDLE handle);
+
+	/**
+	 * @brief Remove a handle from a wait set, must be called before the handle is closed
+	 *
+	 * @param set the wait set
+	 * @param handle the handle to remove, all its occurrences are removed
+	 *
+	 * @return \b TRUE for success, \b FALSE if the handle is not part of the set or the update
+	 * failed
+	 *
+	 * @since version 3.11.0
+	 */
+	WINPR_API BOOL winpr_WaitSet_Remove(WINPR_WAIT_SET* set, HANDLE handle);
+
+	/**
+	 * @brief Wait until one handle of the set is signaled, like \b WaitForMultipleObjects with
+	 * \b bWaitAll set to \b FALSE. The wait is not alertable.
+	 *
+	 * @param set the wait set, must not be empty
+	 * @param dwMilliseconds the timeout or \b INFINITE
+	 *
+	 * @return \b WAIT_OBJECT_0 plus the lowest index of the signaled handles, \b WAIT_TIMEOUT or
+	 * \b WAIT_FAILED
+	 *
+	 * @since version 3.11.0
+	 */
+	WINPR_API DWORD winpr_WaitSet_Wait(WINPR_WAIT_SET* set, DWORD dwMilliseconds);
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,9 +37,24 @@
 #endif
 
 #include <winpr/assert.h>
+#include <winpr/interlocked.h>
 
 #include "../handle/handle.h"
 
+ULONG winpr_Handle_NewSerial(void)
+{
+	static LONG serial = 0;
+	ULONG next = 0;
+
+	/* 0 is never handed out, a wrap around just skips it */
+	do
+	{
+		next = (ULONG)InterlockedIncrement(&serial);
+	} while (next == 0);
+
+	return next;
+}
+
 BOOL CloseHandle(HANDLE hObject)
 {
 	ULONG Type = 0;
@@ -110,9 +110,12 @@ typedef struct
 {
 	ULONG Type;
 	ULONG Mode;
+	ULONG Serial; /* tells apart handles reusing the address or file descriptor of a closed one */
 	HANDLE_OPS* ops;
 } WINPR_HANDLE;
 
+ULONG winpr_Handle_NewSerial(void);
+
 static INLINE BOOL WINPR_HANDLE_IS_HANDLED(HANDLE handle, ULONG type, BOOL invalidValue)
 {
 	WINPR_HANDLE* pWinprHandle = (WINPR_HANDLE*)handle;
@@ -139,6 +142,7 @@ static INLINE void WINPR_HANDLE_SET_TYPE_AND_MODE(void* _handle, ULONG _type, UL
 
 	hdl->Type = _type;
 	hdl->Mode = _mode;
+	hdl->Serial = winpr_Handle_NewSerial();
 }
 
 static INLINE BOOL winpr_Handle_GetInfo(HANDLE handle, ULONG* pType, WINPR_HANDLE** pObject)
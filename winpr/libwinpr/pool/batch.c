@@ -0,0 +1,182 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Thread Pool API (Batch)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/interlocked.h>
+#include <winpr/sysinfo.h>
+#include <winpr/pool.h>
+
+#include "pool.h"
+#include "../log.h"
+#define TAG WINPR_TAG("pool")
+
+/*
+ * A batch is backed by a single work object that is submitted once per worker thread.
+ * Every invocation claims job indices until none are left, so the number of jobs does
+ * not influence the number of submissions and no per job state has to be allocated.
+ *
+ * The job count and the next index to claim share one 64bit value (count in the upper,
+ * next index in the lower 32 bits). A late invocation of a previous submission either
+ * sees a finished batch or claims a job of the current one, which is equally valid.
+ */
+struct S_TP_BATCH
+{
+	PTP_WORK Work;
+	PTP_BATCH_CALLBACK Callback;
+	PVOID Context;
+	DWORD Workers;
+
+	LONGLONG volatile State;
+	LONG volatile Pending;
+	HANDLE Done;
+};
+
+static BOOL batch_run_next(PTP_BATCH batch, PTP_CALLBACK_INSTANCE instance)
+{
+	WINPR_ASSERT(batch);
+
+	for (;;)
+	{
+		const LONGLONG state = batch->State;
+		const UINT32 count = (UINT32)(((ULONGLONG)state) >> 32);
+		const UINT32 next = (UINT32)(((ULONGLONG)state) & UINT32_MAX);
+
+		if (next >= count)
+			return FALSE;
+
+		if (InterlockedCompareExchange64(&batch->State, state + 1, state) != state)
+			continue;
+
+		batch->Callback(instance, batch->Context, next);
+
+		if (InterlockedDecrement(&batch->Pending) == 0)
+			(void)SetEvent(batch->Done);
+		return TRUE;
+	}
+}
+
+static VOID CALLBACK batch_work_callback(PTP_CALLBACK_INSTANCE instance, PVOID context,
+                                         PTP_WORK work)
+{
+	PTP_BATCH batch = (PTP_BATCH)context;
+
+	WINPR_UNUSED(work);
+
+	while (batch_run_next(batch, instance))
+	{
+	}
+}
+
+PTP_BATCH winpr_CreateThreadpoolBatch(PTP_BATCH_CALLBACK pfnbt, PVOID pv, PTP_CALLBACK_ENVIRON pcbe)
+{
+	SYSTEM_INFO info = { 0 };
+	PTP_BATCH batch = NULL;
+
+	if (!pfnbt)
+		return NULL;
+
+	batch = (PTP_BATCH)calloc(1, sizeof(TP_BATCH));
+	if (!batch)
+		return NULL;
+
+	batch->Callback = pfnbt;
+	batch->Context = pv;
+
+	GetNativeSystemInfo(&info);
+	batch->Workers = (info.dwNumberOfProcessors > 0) ? info.dwNumberOfProcessors : 1;
+
+	batch->Done = CreateEvent(NULL, TRUE, TRUE, NULL);
+	if (!batch->Done)
+		goto fail;
+
+	batch->Work = CreateThreadpoolWork(batch_work_callback, batch, pcbe);
+	if (!batch->Work)
+		goto fail;
+
+	return batch;
+
+fail:
+	winpr_CloseThreadpoolBatch(batch);
+	return NULL;
+}
+
+VOID winpr_CloseThreadpoolBatch(PTP_BATCH ptpb)
+{
+	if (!ptpb)
+		return;
+
+	if (ptpb->Work)
+	{
+		/* Late invocations still reference the batch */
+		winpr_WaitForThreadpoolBatchCallbacks(ptpb);
+		WaitForThreadpoolWorkCallbacks(ptpb->Work, FALSE);
+		CloseThreadpoolWork(ptpb->Work);
+	}
+
+	if (ptpb->Done)
+		(void)CloseHandle(ptpb->Done);
+	free(ptpb);
+}
+
+BOOL winpr_SubmitThreadpoolBatch(PTP_BATCH ptpb, UINT32 count)
+{
+	WINPR_ASSERT(ptpb);
+
+	if (count == 0)
+		return TRUE;
+
+	if (ptpb->Pending != 0)
+	{
+		WLog_ERR(TAG, "batch submitted while the previous submission is still running");
+		return FALSE;
+	}
+
+	(void)InterlockedExchange(&ptpb->Pending, (LONG)count);
+	(void)ResetEvent(ptpb->Done);
+
+	/* Publish count and reset the index in one step */
+	for (;;)
+	{
+		const LONGLONG state = ptpb->State;
+		const LONGLONG next = (LONGLONG)(((ULONGLONG)count) << 32);
+
+		if (InterlockedCompareExchange64(&ptpb->State, next, state) == state)
+			break;
+	}
+
+	/* The thread waiting for the batch runs jobs as well, one submission less is needed */
+	const DWORD workers = (ptpb->Workers < count) ? ptpb->Workers : count;
+	for (DWORD x = 1; x < workers; x++)
+		SubmitThreadpoolWork(ptpb->Work);
+
+	return TRUE;
+}
+
+VOID winpr_WaitForThreadpoolBatchCallbacks(PTP_BATCH ptpb)
+{
+	WINPR_ASSERT(ptpb);
+
+	while (batch_run_next(ptpb, NULL))
+	{
+	}
+
+	if (WaitForSingleObject(ptpb->Done, INFINITE) != WAIT_OBJECT_0)
+		WLog_ERR(TAG, "error waiting on batch completion");
+}
@@ -17,14 +17,27 @@
  * limitations under the License.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // NOLINT(bugprone-reserved-identifier,cert-dcl37-c,cert-dcl51-cpp)
+#endif
+
 #include <winpr/config.h>
 
+#include <winpr/assert.h>
 #include <winpr/crt.h>
 #include <winpr/sysinfo.h>
 #include <winpr/pool.h>
 #include <winpr/library.h>
+#include <winpr/interlocked.h>
+
+#if defined(WINPR_HAVE_PTHREAD_SETAFFINITY_NP)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include "pool.h"
+#include "../log.h"
+#define TAG WINPR_TAG("pool")
 
 #ifdef WINPR_THREAD_POOL
 
@@ -52,52 +65,342 @@ static BOOL CALLBACK init_module(PINIT_ONCE once, PVOID param, PVOID* context)
 #endif
 
 static TP_POOL DEFAULT_POOL = {
-	0,    /* DWORD Minimum */
-	500,  /* DWORD Maximum */
-	NULL, /* wArrayList* Threads */
-	NULL, /* wQueue* PendingQueue */
-	NULL, /* HANDLE TerminateEvent */
-	NULL, /* wCountdownEvent* WorkComplete */
+	0,                       /* DWORD Minimum */
+	500,                     /* DWORD Maximum */
+	NULL,                    /* wArrayList* Threads */
+	NULL,                    /* wQueue* PendingQueue */
+	NULL,                    /* HANDLE TerminateEvent */
+	NULL,                    /* wCountdownEvent* WorkComplete */
+	WINPR_TP_POLICY_DEFAULT, /* WINPR_TP_POLICY Policy */
+	0,                       /* DWORD Flags */
+	NULL,                    /* const TP_SCHEDULER* Scheduler */
+	NULL,                    /* HANDLE WorkAvailable */
+	0,                       /* LONG Queued */
+	0,                       /* LONG Terminating */
+	0,                       /* LONG NextWorker */
+	0,                       /* LONG NextQueue */
+	0,                       /* DWORD NumQueues */
+	NULL,                    /* TP_WORK_QUEUE* Queues */
 };
 
-static DWORD WINAPI thread_pool_work_func(LPVOID arg)
+/**
+ * The scheduler decides where submitted work is queued and where an idle worker looks for
+ * work. Waking workers is common to all schedulers: pool->Queued counts the submitted but
+ * not yet started work, pool->WorkAvailable is set while it is not zero.
+ */
+struct S_TP_SCHEDULER
+{
+	BOOL (*Init)(PTP_POOL pool);
+	void (*Uninit)(PTP_POOL pool);
+	void (*AttachWorker)(PTP_POOL pool, DWORD worker);
+	BOOL (*Push)(PTP_POOL pool, PTP_WORK work);
+	PTP_WORK (*Pop)(PTP_POOL pool, DWORD worker);
+};
+
+/* Shared queue: a single locked FIFO all workers take work from */
+
+static BOOL shared_queue_init(PTP_POOL pool)
+{
+	pool->PendingQueue = Queue_New(TRUE, -1, -1);
+	return pool->PendingQueue != NULL;
+}
+
+static void shared_queue_uninit(PTP_POOL pool)
+{
+	Queue_Free(pool->PendingQueue);
+	pool->PendingQueue = NULL;
+}
+
+static BOOL shared_queue_push(PTP_POOL pool, PTP_WORK work)
+{
+	return Queue_Enqueue(pool->PendingQueue, work);
+}
+
+static PTP_WORK shared_queue_pop(PTP_POOL pool, DWORD worker)
+{
+	WINPR_UNUSED(worker);
+	return (PTP_WORK)Queue_Dequeue(pool->PendingQueue);
+}
+
+static const TP_SCHEDULER SHARED_QUEUE_SCHEDULER = { shared_queue_init, shared_queue_uninit, NULL,
+	                                                 shared_queue_push, shared_queue_pop };
+
+/**
+ * Work stealing: there is one queue per processor, each worker thread is attached to one
+ * of them. Work submitted from a worker thread goes to the queue of that worker and is taken
+ * back last in first out, while it is still hot in the cache. Work submitted from other
+ * threads is spread round robin over all queues. An idle worker steals the oldest work of
+ * the other queues. A queue lock is only contended when a worker steals from it.
+ */
+struct S_TP_WORK_QUEUE
+{
+	CRITICAL_SECTION Lock;
+	PTP_POOL Pool;
+	PTP_WORK* Items;
+	size_t Capacity; /* power of 2 */
+	size_t Head;     /* steal end */
+	size_t Tail;     /* owner end */
+	LONG volatile Count;
+};
+
+static INIT_ONCE init_once_tls = INIT_ONCE_STATIC_INIT;
+static DWORD work_queue_tls = TLS_OUT_OF_INDEXES;
+
+static BOOL CALLBACK init_tls(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+	WINPR_UNUSED(once);
+	WINPR_UNUSED(param);
+	WINPR_UNUSED(context);
+
+	work_queue_tls = TlsAlloc();
+	return work_queue_tls != TLS_OUT_OF_INDEXES;
+}
+
+static BOOL work_queue_push(TP_WORK_QUEUE* queue, PTP_WORK work)
+{
+	BOOL rc = FALSE;
+
+	EnterCriticalSection(&queue->Lock);
+	if (queue->Tail - queue->Head == queue->Capacity)
+	{
+		const size_t capacity = queue->Capacity ? queue->Capacity * 2 : 64;
+		PTP_WORK* items = (PTP_WORK*)calloc(capacity, sizeof(PTP_WORK));
+		if (!items)
+			goto fail;
+
+		for (size_t x = queue->Head; x != queue->Tail; x++)
+			items[x - queue->Head] = queue->Items[x & (queue->Capacity - 1)];
+
+		free((void*)queue->Items);
+		queue->Items = items;
+		queue->Tail -= queue->Head;
+		queue->Head = 0;
+		queue->Capacity = capacity;
+	}
+
+	queue->Items[queue->Tail++ & (queue->Capacity - 1)] = work;
+	queue->Count++;
+	rc = TRUE;
+fail:
+	LeaveCriticalSection(&queue->Lock);
+	return rc;
+}
+
+static PTP_WORK work_queue_pop(TP_WORK_QUEUE* queue, BOOL owner)
 {
-	DWORD status = 0;
-	PTP_POOL pool = NULL;
 	PTP_WORK work = NULL;
-	HANDLE events[2];
-	PTP_CALLBACK_INSTANCE callbackInstance = NULL;
 
-	pool = (PTP_POOL)arg;
+	/* Unlocked peek, a stale value only delays the work to the next round */
+	if (queue->Count == 0)
+		return NULL;
 
-	events[0] = pool->TerminateEvent;
-	events[1] = Queue_Event(pool->PendingQueue);
+	EnterCriticalSection(&queue->Lock);
+	if (queue->Head != queue->Tail)
+	{
+		if (owner)
+			work = queue->Items[--queue->Tail & (queue->Capacity - 1)];
+		else
+			work = queue->Items[queue->Head++ & (queue->Capacity - 1)];
+		queue->Count--;
+	}
+	LeaveCriticalSection(&queue->Lock);
+	return work;
+}
+
+static BOOL work_stealing_init(PTP_POOL pool)
+{
+	SYSTEM_INFO info = { 0 };
+
+	if (!InitOnceExecuteOnce(&init_once_tls, init_tls, NULL, NULL))
+		return FALSE;
 
-	while (1)
+	GetSystemInfo(&info);
+	pool->NumQueues = (info.dwNumberOfProcessors > 0) ? info.dwNumberOfProcessors : 1;
+	pool->Queues = (TP_WORK_QUEUE*)calloc(pool->NumQueues, sizeof(TP_WORK_QUEUE));
+	if (!pool->Queues)
 	{
-		status = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+		pool->NumQueues = 0;
+		return FALSE;
+	}
 
-		if (status == WAIT_OBJECT_0)
-			break;
+	for (DWORD x = 0; x < pool->NumQueues; x++)
+	{
+		TP_WORK_QUEUE* queue = &pool->Queues[x];
+		queue->Pool = pool;
+		if (!InitializeCriticalSectionAndSpinCount(&queue->Lock, 4000))
+		{
+			pool->NumQueues = x;
+			return FALSE;
+		}
+	}
 
-		if (status != (WAIT_OBJECT_0 + 1))
-			break;
+	return TRUE;
+}
+
+static void work_stealing_uninit(PTP_POOL pool)
+{
+	for (DWORD x = 0; x < pool->NumQueues; x++)
+	{
+		TP_WORK_QUEUE* queue = &pool->Queues[x];
+		DeleteCriticalSection(&queue->Lock);
+		free((void*)queue->Items);
+	}
+
+	free(pool->Queues);
+	pool->Queues = NULL;
+	pool->NumQueues = 0;
+}
+
+static void work_stealing_attach_worker(PTP_POOL pool, DWORD worker)
+{
+	WINPR_ASSERT(pool->NumQueues > 0);
+	(void)TlsSetValue(work_queue_tls, &pool->Queues[worker % pool->NumQueues]);
+}
+
+static BOOL work_stealing_push(PTP_POOL pool, PTP_WORK work)
+{
+	TP_WORK_QUEUE* queue = (TP_WORK_QUEUE*)TlsGetValue(work_queue_tls);
+
+	if (!queue || (queue->Pool != pool))
+	{
+		const DWORD next = (DWORD)InterlockedIncrement(&pool->NextQueue);
+		queue = &pool->Queues[next % pool->NumQueues];
+	}
+
+	return work_queue_push(queue, work);
+}
+
+static PTP_WORK work_stealing_pop(PTP_POOL pool, DWORD worker)
+{
+	const DWORD home = worker % pool->NumQueues;
+	PTP_WORK work = work_queue_pop(&pool->Queues[home], TRUE);
+
+	for (DWORD x = 1; !work && (x < pool->NumQueues); x++)
+		work = work_queue_pop(&pool->Queues[(home + x) % pool->NumQueues], FALSE);
 
-		callbackInstance = (PTP_CALLBACK_INSTANCE)Queue_Dequeue(pool->PendingQueue);
+	return work;
+}
+
+static const TP_SCHEDULER WORK_STEALING_SCHEDULER = { work_stealing_init, work_stealing_uninit,
+	                                                  work_stealing_attach_worker,
+	                                                  work_stealing_push, work_stealing_pop };
+
+static const TP_SCHEDULER* thread_pool_scheduler(WINPR_TP_POLICY policy)
+{
+	switch (policy)
+	{
+		case WINPR_TP_POLICY_SHARED_QUEUE:
+			return &SHARED_QUEUE_SCHEDULER;
+		case WINPR_TP_POLICY_DEFAULT:
+		case WINPR_TP_POLICY_WORK_STEALING:
+			return &WORK_STEALING_SCHEDULER;
+		default:
+			return NULL;
+	}
+}
+
+static void thread_pool_set_affinity(DWORD worker)
+{
+	SYSTEM_INFO info = { 0 };
 
-		if (callbackInstance)
+	GetSystemInfo(&info);
+	if (info.dwNumberOfProcessors < 1)
+		return;
+
+	const DWORD cpu = worker % info.dwNumberOfProcessors;
+#if defined(_WIN32)
+	if (cpu < sizeof(DWORD_PTR) * 8)
+		(void)SetThreadAffinityMask(GetCurrentThread(), ((DWORD_PTR)1) << cpu);
+#elif defined(WINPR_HAVE_PTHREAD_SETAFFINITY_NP)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	const int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (rc != 0)
+		WLog_WARN(TAG, "failed to pin worker %" PRIu32 " to processor %" PRIu32 ": %d", worker,
+		          cpu, rc);
+#else
+	WLog_DBG(TAG, "thread affinity not supported on this platform");
+#endif
+}
+
+BOOL PushThreadpoolWork(PTP_POOL pool, PTP_WORK work)
+{
+	WINPR_ASSERT(pool);
+	WINPR_ASSERT(pool->Scheduler);
+
+	/* Count first, an early woken worker retries until the work is visible */
+	if (InterlockedIncrement(&pool->Queued) == 1)
+		(void)SetEvent(pool->WorkAvailable);
+
+	if (!pool->Scheduler->Push(pool, work))
+	{
+		(void)InterlockedDecrement(&pool->Queued);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static DWORD WINAPI thread_pool_work_func(LPVOID arg)
+{
+	PTP_POOL pool = (PTP_POOL)arg;
+	const DWORD worker = (DWORD)InterlockedIncrement(&pool->NextWorker) - 1;
+	HANDLE events[2];
+
+	events[0] = pool->TerminateEvent;
+	events[1] = pool->WorkAvailable;
+
+	if (pool->Flags & WINPR_TP_FLAG_AFFINITY)
+		thread_pool_set_affinity(worker);
+
+	if (pool->Scheduler->AttachWorker)
+		pool->Scheduler->AttachWorker(pool, worker);
+
+	while (!pool->Terminating)
+	{
+		PTP_WORK work = pool->Scheduler->Pop(pool, worker);
+
+		if (work)
 		{
-			work = callbackInstance->Work;
-			work->WorkCallback(callbackInstance, work->CallbackParameter, work);
+			TP_CALLBACK_INSTANCE callbackInstance = { 0 };
+
+			(void)InterlockedDecrement(&pool->Queued);
+			callbackInstance.Work = work;
+			work->WorkCallback(&callbackInstance, work->CallbackParameter, work);
 			CountdownEvent_Signal(pool->WorkComplete, 1);
-			free(callbackInstance);
+			continue;
+		}
+
+		/* Out of work, a submission racing with the reset sets the event again */
+		if (InterlockedCompareExchange(&pool->Queued, 0, 0) == 0)
+		{
+			(void)ResetEvent(pool->WorkAvailable);
+			if (InterlockedCompareExchange(&pool->Queued, 0, 0) != 0)
+				(void)SetEvent(pool->WorkAvailable);
 		}
+
+		const DWORD status = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+		if (status != (WAIT_OBJECT_0 + 1))
+			break;
 	}
 
 	ExitThread(0);
 	return 0;
 }
 
+static void thread_pool_terminate_threads(PTP_POOL pool, BOOL restart)
+{
+	(void)InterlockedExchange(&pool->Terminating, 1);
+	(void)SetEvent(pool->TerminateEvent);
+	ArrayList_Clear(pool->Threads);
+	if (restart)
+	{
+		(void)ResetEvent(pool->TerminateEvent);
+		(void)InterlockedExchange(&pool->NextWorker, 0);
+		(void)InterlockedExchange(&pool->Terminating, 0);
+	}
+}
+
 static void threads_close(void* thread)
 {
 	(void)WaitForSingleObject(thread, INFINITE);
@@ -112,7 +415,13 @@ static BOOL InitializeThreadpool(PTP_POOL pool)
 	if (pool->Threads)
 		return TRUE;
 
-	if (!(pool->PendingQueue = Queue_New(TRUE, -1, -1)))
+	if (!(pool->Scheduler = thread_pool_scheduler(pool->Policy)))
+		goto fail;
+
+	if (!pool->Scheduler->Init(pool))
+		goto fail;
+
+	if (!(pool->WorkAvailable = CreateEvent(NULL, TRUE, FALSE, NULL)))
 		goto fail;
 
 	if (!(pool->WorkComplete = CountdownEvent_New(0)))
@@ -153,19 +462,16 @@ PTP_POOL GetDefaultThreadpool(void)
 	return pool;
 }
 
-PTP_POOL winpr_CreateThreadpool(PVOID reserved)
+static PTP_POOL thread_pool_new(WINPR_TP_POLICY policy, DWORD flags)
 {
 	PTP_POOL pool = NULL;
-#ifdef _WIN32
-	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
-	if (pCreateThreadpool)
-		return pCreateThreadpool(reserved);
-#else
-	WINPR_UNUSED(reserved);
-#endif
+
 	if (!(pool = (PTP_POOL)calloc(1, sizeof(TP_POOL))))
 		return NULL;
 
+	pool->Policy = policy;
+	pool->Flags = flags;
+
 	if (!InitializeThreadpool(pool))
 	{
 		winpr_CloseThreadpool(pool);
@@ -175,6 +481,28 @@ PTP_POOL winpr_CreateThreadpool(PVOID reserved)
 	return pool;
 }
 
+PTP_POOL winpr_CreateThreadpool(PVOID reserved)
+{
+#ifdef _WIN32
+	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
+	if (pCreateThreadpool)
+		return pCreateThreadpool(reserved);
+#else
+	WINPR_UNUSED(reserved);
+#endif
+	return thread_pool_new(WINPR_TP_POLICY_DEFAULT, 0);
+}
+
+PTP_POOL winpr_CreateThreadpoolEx(WINPR_TP_POLICY policy, DWORD flags)
+{
+#ifdef _WIN32
+	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
+	if (pCreateThreadpool)
+		return pCreateThreadpool(NULL);
+#endif
+	return thread_pool_new(policy, flags);
+}
+
 VOID winpr_CloseThreadpool(PTP_POOL ptpp)
 {
 #ifdef _WIN32
@@ -185,12 +513,19 @@ VOID winpr_CloseThreadpool(PTP_POOL ptpp)
 		return;
 	}
 #endif
-	(void)SetEvent(ptpp->TerminateEvent);
+	if (ptpp->Threads)
+	{
+		thread_pool_terminate_threads(ptpp, FALSE);
+		ArrayList_Free(ptpp->Threads);
+	}
 
-	ArrayList_Free(ptpp->Threads);
-	Queue_Free(ptpp->PendingQueue);
+	if (ptpp->Scheduler)
+		ptpp->Scheduler->Uninit(ptpp);
 	CountdownEvent_Free(ptpp->WorkComplete);
-	(void)CloseHandle(ptpp->TerminateEvent);
+	if (ptpp->TerminateEvent)
+		(void)CloseHandle(ptpp->TerminateEvent);
+	if (ptpp->WorkAvailable)
+		(void)CloseHandle(ptpp->WorkAvailable);
 
 	{
 		TP_POOL empty = { 0 };
@@ -246,13 +581,18 @@ VOID winpr_SetThreadpoolThreadMaximum(PTP_POOL ptpp, DWORD cthrdMost)
 
 	ArrayList_Lock(ptpp->Threads);
 	if (ArrayList_Count(ptpp->Threads) > ptpp->Maximum)
-	{
-		(void)SetEvent(ptpp->TerminateEvent);
-		ArrayList_Clear(ptpp->Threads);
-		(void)ResetEvent(ptpp->TerminateEvent);
-	}
+		thread_pool_terminate_threads(ptpp, TRUE);
 	ArrayList_Unlock(ptpp->Threads);
 	winpr_SetThreadpoolThreadMinimum(ptpp, ptpp->Minimum);
 }
 
+#else
+
+PTP_POOL winpr_CreateThreadpoolEx(WINPR_TP_POLICY policy, DWORD flags)
+{
+	WINPR_UNUSED(policy);
+	WINPR_UNUSED(flags);
+	return CreateThreadpool(NULL);
+}
+
 #endif /* WINPR_THREAD_POOL defined */
@@ -26,6 +26,9 @@
 #include <winpr/thread.h>
 #include <winpr/collections.h>
 
+typedef struct S_TP_SCHEDULER TP_SCHEDULER;
+typedef struct S_TP_WORK_QUEUE TP_WORK_QUEUE;
+
 #if defined(_WIN32)
 #if (_WIN32_WINNT < _WIN32_WINNT_WIN6) || defined(__MINGW32__)
 struct S_TP_CALLBACK_INSTANCE
@@ -41,6 +44,17 @@ struct S_TP_POOL
 	wQueue* PendingQueue;
 	HANDLE TerminateEvent;
 	wCountdownEvent* WorkComplete;
+
+	WINPR_TP_POLICY Policy;
+	DWORD Flags;
+	const TP_SCHEDULER* Scheduler;
+	HANDLE WorkAvailable;
+	LONG volatile Queued;
+	LONG volatile Terminating;
+	LONG volatile NextWorker;
+	LONG volatile NextQueue;
+	DWORD NumQueues;
+	TP_WORK_QUEUE* Queues;
 };
 
 struct S_TP_WORK
@@ -85,6 +99,17 @@ struct S_TP_POOL
 	wQueue* PendingQueue;
 	HANDLE TerminateEvent;
 	wCountdownEvent* WorkComplete;
+
+	WINPR_TP_POLICY Policy;
+	DWORD Flags;
+	const TP_SCHEDULER* Scheduler;
+	HANDLE WorkAvailable;
+	LONG volatile Queued;
+	LONG volatile Terminating;
+	LONG volatile NextWorker;
+	LONG volatile NextQueue;
+	DWORD NumQueues;
+	TP_WORK_QUEUE* Queues;
 };
 
 struct S_TP_WORK
@@ -118,5 +143,6 @@ struct S_TP_CLEANUP_GROUP
 #endif
 
 PTP_POOL GetDefaultThreadpool(void);
+BOOL PushThreadpoolWork(PTP_POOL pool, PTP_WORK work);
 
 #endif /* WINPR_POOL_PRIVATE_H */
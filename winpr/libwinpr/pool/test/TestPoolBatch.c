@@ -0,0 +1,166 @@
+
+#include <winpr/wtypes.h>
+#include <winpr/crt.h>
+#include <winpr/pool.h>
+#include <winpr/sysinfo.h>
+#include <winpr/interlocked.h>
+
+#define MAX_JOBS 2040
+
+static LONG runs[MAX_JOBS] = { 0 };
+
+static void CALLBACK test_BatchCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                        UINT32 index)
+{
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(context);
+
+	if (index < ARRAYSIZE(runs))
+		InterlockedIncrement(&runs[index]);
+}
+
+static void CALLBACK test_WorkCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                       PTP_WORK work)
+{
+	WINPR_UNUSED(instance);
+	WINPR_UNUSED(work);
+
+	test_BatchCallback(NULL, NULL, (UINT32)(size_t)context);
+}
+
+static BOOL check_runs(UINT32 count, LONG expect)
+{
+	for (UINT32 x = 0; x < ARRAYSIZE(runs); x++)
+	{
+		const LONG want = (x < count) ? expect : 0;
+		if (runs[x] != want)
+		{
+			printf("job %" PRIu32 " ran %" PRId32 " times, expected %" PRId32 "\n", x, runs[x],
+			       want);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static BOOL test_batch(void)
+{
+	BOOL rc = FALSE;
+	const UINT32 counts[] = { 0, 1, 2, 7, 510, MAX_JOBS };
+	PTP_BATCH batch = winpr_CreateThreadpoolBatch(test_BatchCallback, NULL, NULL);
+
+	if (!batch)
+	{
+		printf("winpr_CreateThreadpoolBatch failure\n");
+		return FALSE;
+	}
+
+	for (size_t x = 0; x < ARRAYSIZE(counts); x++)
+	{
+		ZeroMemory(runs, sizeof(runs));
+
+		/* A batch can be reused once all callbacks of the previous submission finished */
+		for (LONG y = 1; y <= 3; y++)
+		{
+			if (!winpr_SubmitThreadpoolBatch(batch, counts[x]))
+			{
+				printf("winpr_SubmitThreadpoolBatch failure\n");
+				goto fail;
+			}
+			winpr_WaitForThreadpoolBatchCallbacks(batch);
+
+			if (!check_runs(counts[x], y))
+				goto fail;
+		}
+	}
+
+	rc = TRUE;
+fail:
+	winpr_CloseThreadpoolBatch(batch);
+	return rc;
+}
+
+/* Dispatch cost of one job per work object (the way the codecs dispatched their tiles)
+ * compared to a single batch of the same size. */
+static BOOL test_batch_speed(UINT32 count, UINT32 frames)
+{
+	BOOL rc = FALSE;
+	UINT64 works = 0;
+	UINT64 batches = 0;
+	PTP_WORK* work = calloc(count, sizeof(PTP_WORK));
+	PTP_BATCH batch = winpr_CreateThreadpoolBatch(test_BatchCallback, NULL, NULL);
+
+	if (!work || !batch)
+		goto fail;
+
+	ZeroMemory(runs, sizeof(runs));
+
+	UINT64 start = winpr_GetTickCount64NS();
+	for (UINT32 frame = 0; frame < frames; frame++)
+	{
+		for (UINT32 x = 0; x < count; x++)
+		{
+			work[x] = CreateThreadpoolWork(test_WorkCallback, (void*)(size_t)x, NULL);
+			if (!work[x])
+				goto fail;
+			SubmitThreadpoolWork(work[x]);
+		}
+
+		for (UINT32 x = 0; x < count; x++)
+		{
+			WaitForThreadpoolWorkCallbacks(work[x], FALSE);
+			CloseThreadpoolWork(work[x]);
+			work[x] = NULL;
+		}
+	}
+	works = winpr_GetTickCount64NS() - start;
+
+	start = winpr_GetTickCount64NS();
+	for (UINT32 frame = 0; frame < frames; frame++)
+	{
+		if (!winpr_SubmitThreadpoolBatch(batch, count))
+			goto fail;
+		winpr_WaitForThreadpoolBatchCallbacks(batch);
+	}
+	batches = winpr_GetTickCount64NS() - start;
+
+	if (!check_runs(count, 2 * (LONG)frames))
+		goto fail;
+
+	printf("%" PRIu32 " jobs: work objects %" PRIu64 "us/frame, batch %" PRIu64 "us/frame\n",
+	       count, works / frames / 1000, batches / frames / 1000);
+	rc = TRUE;
+fail:
+	if (work)
+	{
+		for (UINT32 x = 0; x < count; x++)
+		{
+			if (work[x])
+			{
+				WaitForThreadpoolWorkCallbacks(work[x], TRUE);
+				CloseThreadpoolWork(work[x]);
+			}
+		}
+	}
+	free(work);
+	winpr_CloseThreadpoolBatch(batch);
+	return rc;
+}
+
+int TestPoolBatch(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_batch())
+		return -1;
+
+	/* 64x64 tiles of a 1080p and a 2160p frame */
+	if (!test_batch_speed(510, 20))
+		return -1;
+
+	if (!test_batch_speed(MAX_JOBS, 10))
+		return -1;
+
+	return 0;
+}
@@ -3,6 +3,7 @@
 #include <winpr/crt.h>
 #include <winpr/pool.h>
 #include <winpr/interlocked.h>
+#include <winpr/sysinfo.h>
 
 static LONG count = 0;
 
@@ -120,6 +121,79 @@ fail:
 	return rc;
 }
 
+#define POLICY_WORK_ITEMS 20000
+
+static LONG policyCount = 0;
+static LONG nestedCount = 0;
+
+static void CALLBACK test_PolicyCallback(PTP_CALLBACK_INSTANCE instance, void* context,
+                                         PTP_WORK work)
+{
+	PTP_WORK* nested = (PTP_WORK*)context;
+
+	WINPR_UNUSED(instance);
+
+	/* Work submitted from a worker thread goes to the queue of that worker */
+	if ((work == nested[0]) && (InterlockedIncrement(&policyCount) % 4 == 0))
+		SubmitThreadpoolWork(nested[1]);
+	else if (work == nested[1])
+		(void)InterlockedIncrement(&nestedCount);
+}
+
+static BOOL test_policy(WINPR_TP_POLICY policy, DWORD flags)
+{
+	BOOL rc = FALSE;
+	PTP_WORK work[2] = { 0 };
+	TP_CALLBACK_ENVIRON environment;
+	PTP_POOL pool = winpr_CreateThreadpoolEx(policy, flags);
+
+	if (!pool)
+	{
+		printf("winpr_CreateThreadpoolEx failure\n");
+		return FALSE;
+	}
+
+	InitializeThreadpoolEnvironment(&environment);
+	SetThreadpoolCallbackPool(&environment, pool);
+
+	work[0] = CreateThreadpoolWork(test_PolicyCallback, work, &environment);
+	work[1] = CreateThreadpoolWork(test_PolicyCallback, work, &environment);
+	if (!work[0] || !work[1])
+	{
+		printf("CreateThreadpoolWork failure\n");
+		goto fail;
+	}
+
+	policyCount = 0;
+	nestedCount = 0;
+	const UINT64 start = winpr_GetTickCount64NS();
+	for (int index = 0; index < POLICY_WORK_ITEMS; index++)
+		SubmitThreadpoolWork(work[0]);
+
+	/* Both work objects share the pool, one wait covers the nested submissions as well */
+	WaitForThreadpoolWorkCallbacks(work[0], FALSE);
+	const UINT64 end = winpr_GetTickCount64NS();
+
+	if ((policyCount != POLICY_WORK_ITEMS) || (nestedCount != POLICY_WORK_ITEMS / 4))
+	{
+		printf("policy %d: %" PRId32 "/%" PRId32 " callbacks, expected %d/%d\n", policy,
+		       policyCount, nestedCount, POLICY_WORK_ITEMS, POLICY_WORK_ITEMS / 4);
+		goto fail;
+	}
+
+	printf("policy %d flags 0x%08" PRIx32 ": %" PRIu64 "ns per work item\n", policy, flags,
+	       (end - start) / POLICY_WORK_ITEMS);
+	rc = TRUE;
+fail:
+	if (work[0])
+		CloseThreadpoolWork(work[0]);
+	if (work[1])
+		CloseThreadpoolWork(work[1]);
+	DestroyThreadpoolEnvironment(&environment);
+	CloseThreadpool(pool);
+	return rc;
+}
+
 int TestPoolWork(int argc, char* argv[])
 {
 
@@ -132,5 +206,14 @@ int TestPoolWork(int argc, char* argv[])
 	if (!test2())
 		return -1;
 
+	if (!test_policy(WINPR_TP_POLICY_SHARED_QUEUE, 0))
+		return -1;
+
+	if (!test_policy(WINPR_TP_POLICY_WORK_STEALING, 0))
+		return -1;
+
+	if (!test_policy(WINPR_TP_POLICY_DEFAULT, WINPR_TP_FLAG_AFFINITY))
+		return -1;
+
 	return 0;
 }
@@ -128,7 +128,6 @@ VOID winpr_CloseThreadpoolWork(PTP_WORK pwk)
 VOID winpr_SubmitThreadpoolWork(PTP_WORK pwk)
 {
 	PTP_POOL pool = NULL;
-	PTP_CALLBACK_INSTANCE callbackInstance = NULL;
 #ifdef _WIN32
 	InitOnceExecuteOnce(&init_once_module, init_module, NULL, NULL);
 
@@ -143,16 +142,11 @@ VOID winpr_SubmitThreadpoolWork(PTP_WORK pwk)
 	WINPR_ASSERT(pwk);
 	WINPR_ASSERT(pwk->CallbackEnvironment);
 	pool = pwk->CallbackEnvironment->Pool;
-	callbackInstance = (PTP_CALLBACK_INSTANCE)calloc(1, sizeof(TP_CALLBACK_INSTANCE));
 
-	if (callbackInstance)
-	{
-		callbackInstance->Work = pwk;
-		CountdownEvent_AddCount(pool->WorkComplete, 1);
-		if (!Queue_Enqueue(pool->PendingQueue, callbackInstance))
-			free(callbackInstance);
-	}
-	// NOLINTNEXTLINE(clang-analyzer-unix.Malloc): Queue_Enqueue takes ownership of callbackInstance
+	/* The callback instance lives on the stack of the worker, queue the work itself */
+	CountdownEvent_AddCount(pool->WorkComplete, 1);
+	if (!PushThreadpoolWork(pool, pwk))
+		CountdownEvent_Signal(pool->WorkComplete, 1);
 }
 
 BOOL winpr_TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK pfns, PVOID pv,
@@ -513,6 +513,7 @@ int SetEventFileDescriptor(HANDLE hEvent, int FileDescriptor, ULONG mode)
 
 	event->bAttached = TRUE;
 	event->common.Mode = mode;
+	event->common.Serial = winpr_Handle_NewSerial();
 	event->impl.fds[0] = FileDescriptor;
 	return 0;
 #else
@@ -0,0 +1,180 @@
+#include <stdio.h>
+
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define EVENT_COUNT 3
+
+static BOOL test_expect(WINPR_WAIT_SET* set, DWORD timeout, DWORD expected, const char* what)
+{
+	const DWORD rc = winpr_WaitSet_Wait(set, timeout);
+	if (rc != expected)
+	{
+		printf("%s: winpr_WaitSet_Wait returned 0x%08" PRIx32 ", expected 0x%08" PRIx32 "\n",
+		       what, rc, expected);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL test_wait_set_events(void)
+{
+	BOOL rc = FALSE;
+	HANDLE events[EVENT_COUNT] = { 0 };
+	WINPR_WAIT_SET* set = winpr_WaitSet_New();
+
+	if (!set)
+		goto fail;
+
+	if (winpr_WaitSet_Wait(set, 0) != WAIT_FAILED)
+	{
+		printf("waiting on an empty set unexpectedly succeeded\n");
+		goto fail;
+	}
+
+	events[0] = CreateEvent(NULL, TRUE, FALSE, NULL);
+	events[1] = CreateEvent(NULL, TRUE, FALSE, NULL);
+	events[2] = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!events[0] || !events[1] || !events[2])
+		goto fail;
+
+	if (!winpr_WaitSet_Update(set, EVENT_COUNT, events))
+		goto fail;
+
+	const UINT64 start = GetTickCount64();
+	if (!test_expect(set, 50, WAIT_TIMEOUT, "timeout"))
+		goto fail;
+	if (GetTickCount64() - start < 40)
+	{
+		printf("timeout returned early\n");
+		goto fail;
+	}
+
+	/* the lowest signaled index wins, the events stay signaled */
+	(void)SetEvent(events[1]);
+	if (!test_expect(set, INFINITE, WAIT_OBJECT_0 + 1, "manual reset"))
+		goto fail;
+	(void)SetEvent(events[0]);
+	if (!test_expect(set, 0, WAIT_OBJECT_0, "lowest index"))
+		goto fail;
+	(void)ResetEvent(events[0]);
+
+	/* an unchanged update keeps the registrations */
+	if (!winpr_WaitSet_Update(set, EVENT_COUNT, events) ||
+	    !test_expect(set, 0, WAIT_OBJECT_0 + 1, "unchanged update"))
+		goto fail;
+
+	if (!winpr_WaitSet_Remove(set, events[1]) || winpr_WaitSet_Remove(set, events[1]) ||
+	    !test_expect(set, 0, WAIT_TIMEOUT, "removed"))
+		goto fail;
+
+	(void)SetEvent(events[2]);
+	if (!test_expect(set, 0, WAIT_OBJECT_0 + 1, "set") || !ResetEvent(events[2]) ||
+	    !test_expect(set, 0, WAIT_TIMEOUT, "reset"))
+		goto fail;
+
+	/* a replaced handle may reuse the address and descriptor of the closed one */
+	(void)CloseHandle(events[2]);
+	events[2] = CreateEvent(NULL, TRUE, TRUE, NULL);
+	if (!events[2])
+		goto fail;
+	if (!winpr_WaitSet_Update(set, EVENT_COUNT, events) ||
+	    !test_expect(set, 0, WAIT_OBJECT_0 + 1, "replaced handle"))
+		goto fail;
+
+	if (!winpr_WaitSet_Update(set, 0, NULL) || !winpr_WaitSet_Add(set, events[2]) ||
+	    !test_expect(set, 0, WAIT_OBJECT_0, "replaced handle re-added"))
+		goto fail;
+
+	if (winpr_WaitSet_Update(set, MAXIMUM_WAIT_OBJECTS + 1, events))
+	{
+		printf("oversized update unexpectedly succeeded\n");
+		goto fail;
+	}
+
+	rc = TRUE;
+fail:
+	for (size_t x = 0; x < ARRAYSIZE(events); x++)
+	{
+		if (events[x])
+			(void)CloseHandle(events[x]);
+	}
+	winpr_WaitSet_Free(set);
+	return rc;
+}
+
+#ifndef _WIN32
+static BOOL test_wait_set_shared_fd(void)
+{
+	BOOL rc = FALSE;
+	int fds[2] = { -1, -1 };
+	HANDLE handles[3] = { 0 };
+	WINPR_WAIT_SET* set = winpr_WaitSet_New();
+
+	if (!set || (pipe(fds) != 0))
+		goto fail;
+
+	/* two readers of the same pipe and a writer that is always signaled */
+	handles[0] = CreateFileDescriptorEvent(NULL, FALSE, FALSE, fds[0], WINPR_FD_READ);
+	handles[1] = CreateFileDescriptorEvent(NULL, FALSE, FALSE, fds[0], WINPR_FD_READ);
+	handles[2] = CreateFileDescriptorEvent(NULL, FALSE, FALSE, fds[1], WINPR_FD_WRITE);
+	if (!handles[0] || !handles[1] || !handles[2])
+		goto fail;
+
+	if (!winpr_WaitSet_Update(set, 2, handles) || !test_expect(set, 0, WAIT_TIMEOUT, "empty pipe"))
+		goto fail;
+
+	if (write(fds[1], "x", 1) != 1)
+		goto fail;
+	if (!test_expect(set, INFINITE, WAIT_OBJECT_0, "shared fd"))
+		goto fail;
+
+	/* the remaining reader still sees the data */
+	if (!winpr_WaitSet_Remove(set, handles[0]) ||
+	    !test_expect(set, 0, WAIT_OBJECT_0, "shared fd after remove"))
+		goto fail;
+
+	char c = 0;
+	if ((read(fds[0], &c, 1) != 1) || !test_expect(set, 0, WAIT_TIMEOUT, "drained pipe"))
+		goto fail;
+
+	if (!winpr_WaitSet_Add(set, handles[2]) ||
+	    !test_expect(set, INFINITE, WAIT_OBJECT_0 + 1, "writable pipe"))
+		goto fail;
+
+	rc = TRUE;
+fail:
+	for (size_t x = 0; x < ARRAYSIZE(handles); x++)
+	{
+		if (handles[x])
+			(void)CloseHandle(handles[x]);
+	}
+	winpr_WaitSet_Free(set);
+	if (fds[0] >= 0)
+		close(fds[0]);
+	if (fds[1] >= 0)
+		close(fds[1]);
+	return rc;
+}
+#endif
+
+int TestSynchWaitSet(int argc, char* argv[])
+{
+	WINPR_UNUSED(argc);
+	WINPR_UNUSED(argv);
+
+	if (!test_wait_set_events())
+		return -1;
+
+#ifndef _WIN32
+	if (!test_wait_set_shared_fd())
+		return -1;
+#endif
+
+	return 0;
+}
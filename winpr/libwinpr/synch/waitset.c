@@ -0,0 +1,454 @@
+/**
+ * WinPR: Windows Portable Runtime
+ * Synchronization Functions
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <winpr/config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <winpr/assert.h>
+#include <winpr/crt.h>
+#include <winpr/synch.h>
+#include <winpr/sysinfo.h>
+
+#include "../log.h"
+#define TAG WINPR_TAG("synch.waitset")
+
+#if defined(__linux__)
+#define WINPR_WAIT_SET_EPOLL
+#endif
+
+#if defined(WINPR_WAIT_SET_EPOLL)
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "../handle/handle.h"
+
+/**
+ * Handles sharing a file descriptor share one epoll registration, identified by a tag that is
+ * stored in the event data. The tag is 0 for descriptors epoll refuses (regular files), those
+ * are always signaled just like poll() reports them.
+ */
+typedef struct
+{
+	HANDLE handle;
+	ULONG serial;
+	int fd;
+	ULONG mode;
+	UINT32 tag;
+} WINPR_WAIT_SET_ENTRY;
+#endif
+
+struct winpr_wait_set
+{
+	DWORD count;
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+#if defined(WINPR_WAIT_SET_EPOLL)
+	int epfd;
+	UINT32 nextTag;
+	WINPR_WAIT_SET_ENTRY entries[MAXIMUM_WAIT_OBJECTS];
+	struct epoll_event events[MAXIMUM_WAIT_OBJECTS];
+#endif
+};
+
+#if defined(WINPR_WAIT_SET_EPOLL)
+static BOOL waitset_entry_init(WINPR_WAIT_SET_ENTRY* entry, HANDLE handle)
+{
+	ULONG Type = 0;
+	WINPR_HANDLE* Object = NULL;
+
+	WINPR_ASSERT(entry);
+
+	if (!winpr_Handle_GetInfo(handle, &Type, &Object))
+		return FALSE;
+
+	entry->fd = winpr_Handle_getFd(Object);
+	if (entry->fd == -1)
+		return FALSE;
+
+	entry->handle = handle;
+	entry->serial = Object->Serial;
+	entry->mode = Object->Mode;
+	return TRUE;
+}
+
+static BOOL waitset_entry_equal(const WINPR_WAIT_SET_ENTRY* a, const WINPR_WAIT_SET_ENTRY* b)
+{
+	return (a->handle == b->handle) && (a->serial == b->serial) && (a->fd == b->fd) &&
+	       (a->mode == b->mode);
+}
+
+static const WINPR_WAIT_SET_ENTRY* waitset_find(const WINPR_WAIT_SET_ENTRY* entries, DWORD count,
+                                                const WINPR_WAIT_SET_ENTRY* entry)
+{
+	for (DWORD x = 0; x < count; x++)
+	{
+		if (waitset_entry_equal(&entries[x], entry))
+			return &entries[x];
+	}
+	return NULL;
+}
+
+/* the first of the entries before index using the same file descriptor */
+static const WINPR_WAIT_SET_ENTRY* waitset_find_fd(const WINPR_WAIT_SET_ENTRY* entries,
+                                                   DWORD index, int fd)
+{
+	for (DWORD x = 0; x < index; x++)
+	{
+		if (entries[x].fd == fd)
+			return &entries[x];
+	}
+	return NULL;
+}
+
+/**
+ * The registration of a file descriptor is kept if exactly the same handles use it before and
+ * after the update, returns an old entry carrying the tag in that case.
+ */
+static const WINPR_WAIT_SET_ENTRY* waitset_keep(const WINPR_WAIT_SET_ENTRY* old, DWORD oldCount,
+                                                const WINPR_WAIT_SET_ENTRY* entries, DWORD count,
+                                                int fd)
+{
+	const WINPR_WAIT_SET_ENTRY* match = NULL;
+
+	for (DWORD x = 0; x < count; x++)
+	{
+		if (entries[x].fd != fd)
+			continue;
+
+		match = waitset_find(old, oldCount, &entries[x]);
+		if (!match)
+			return NULL;
+	}
+
+	for (DWORD x = 0; x < oldCount; x++)
+	{
+		if ((old[x].fd == fd) && !waitset_find(entries, count, &old[x]))
+			return NULL;
+	}
+
+	return match;
+}
+
+static BOOL waitset_register(WINPR_WAIT_SET* set, const WINPR_WAIT_SET_ENTRY* entries,
+                             DWORD count, WINPR_WAIT_SET_ENTRY* entry)
+{
+	ULONG mode = 0;
+	struct epoll_event event = { 0 };
+
+	WINPR_ASSERT(set);
+	WINPR_ASSERT(entry);
+
+	for (DWORD x = 0; x < count; x++)
+	{
+		if (entries[x].fd == entry->fd)
+			mode |= entries[x].mode;
+	}
+
+	if (mode & WINPR_FD_READ)
+		event.events |= EPOLLIN;
+	if (mode & WINPR_FD_WRITE)
+		event.events |= EPOLLOUT;
+
+	if (++set->nextTag == 0)
+		set->nextTag = 1;
+	event.data.u64 = set->nextTag;
+
+	int rc = epoll_ctl(set->epfd, EPOLL_CTL_ADD, entry->fd, &event);
+	if ((rc < 0) && (errno == EEXIST))
+		rc = epoll_ctl(set->epfd, EPOLL_CTL_MOD, entry->fd, &event);
+
+	if (rc == 0)
+		entry->tag = set->nextTag;
+	else if (errno == EPERM)
+		entry->tag = 0;
+	else
+	{
+		char ebuffer[256] = { 0 };
+		WLog_ERR(TAG, "epoll_ctl(%d) failure [%d] %s", entry->fd, errno,
+		         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL waitset_reset(WINPR_WAIT_SET* set)
+{
+	WINPR_ASSERT(set);
+
+	set->count = 0;
+	close(set->epfd);
+	set->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (set->epfd < 0)
+	{
+		char ebuffer[256] = { 0 };
+		WLog_ERR(TAG, "epoll_create1 failure [%d] %s", errno,
+		         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL waitset_is_signaled(const WINPR_WAIT_SET_ENTRY* entry, uint32_t events)
+{
+	/* a hang up or error is reported to readers and writers, the next call on the fd sees it */
+	if (events & (EPOLLHUP | EPOLLERR))
+		return TRUE;
+	if ((entry->mode & WINPR_FD_READ) && (events & EPOLLIN))
+		return TRUE;
+	if ((entry->mode & WINPR_FD_WRITE) && (events & EPOLLOUT))
+		return TRUE;
+	return FALSE;
+}
+
+static int waitset_timeout(DWORD dwMilliseconds)
+{
+	if (dwMilliseconds == INFINITE)
+		return -1;
+	if (dwMilliseconds > INT32_MAX)
+		return INT32_MAX;
+	return (int)dwMilliseconds;
+}
+#endif
+
+WINPR_WAIT_SET* winpr_WaitSet_New(void)
+{
+	WINPR_WAIT_SET* set = calloc(1, sizeof(WINPR_WAIT_SET));
+	if (!set)
+		return NULL;
+
+#if defined(WINPR_WAIT_SET_EPOLL)
+	set->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (set->epfd < 0)
+	{
+		char ebuffer[256] = { 0 };
+		WLog_ERR(TAG, "epoll_create1 failure [%d] %s", errno,
+		         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+		free(set);
+		return NULL;
+	}
+#endif
+	return set;
+}
+
+void winpr_WaitSet_Free(WINPR_WAIT_SET* set)
+{
+	if (!set)
+		return;
+
+#if defined(WINPR_WAIT_SET_EPOLL)
+	if (set->epfd >= 0)
+		close(set->epfd);
+#endif
+	free(set);
+}
+
+BOOL winpr_WaitSet_Update(WINPR_WAIT_SET* set, DWORD nCount, const HANDLE* lpHandles)
+{
+	WINPR_ASSERT(set);
+	WINPR_ASSERT(lpHandles || (nCount == 0));
+
+	if (nCount > MAXIMUM_WAIT_OBJECTS)
+	{
+		WLog_ERR(TAG, "invalid handles count(%" PRIu32 ")", nCount);
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+#if defined(WINPR_WAIT_SET_EPOLL)
+	WINPR_WAIT_SET_ENTRY entries[MAXIMUM_WAIT_OBJECTS] = { 0 };
+	BOOL changed = (nCount != set->count);
+
+	for (DWORD x = 0; x < nCount; x++)
+	{
+		if (!waitset_entry_init(&entries[x], lpHandles[x]))
+		{
+			WLog_ERR(TAG, "invalid handle at %" PRIu32, x);
+			SetLastError(ERROR_INVALID_HANDLE);
+			return FALSE;
+		}
+
+		if (!changed && !waitset_entry_equal(&entries[x], &set->entries[x]))
+			changed = TRUE;
+	}
+
+	/* the common case of an event loop, nothing to do */
+	if (!changed)
+		return TRUE;
+
+	for (DWORD x = 0; x < set->count; x++)
+	{
+		const WINPR_WAIT_SET_ENTRY* cur = &set->entries[x];
+
+		if ((cur->tag == 0) || waitset_find_fd(set->entries, x, cur->fd) ||
+		    waitset_keep(set->entries, set->count, entries, nCount, cur->fd))
+			continue;
+
+		/* fails if the descriptor was closed in the meantime, epoll dropped it already */
+		(void)epoll_ctl(set->epfd, EPOLL_CTL_DEL, cur->fd, NULL);
+	}
+
+	for (DWORD x = 0; x < nCount; x++)
+	{
+		WINPR_WAIT_SET_ENTRY* entry = &entries[x];
+		const WINPR_WAIT_SET_ENTRY* same = waitset_find_fd(entries, x, entry->fd);
+
+		if (!same)
+			same = waitset_keep(set->entries, set->count, entries, nCount, entry->fd);
+
+		if (same)
+			entry->tag = same->tag;
+		else if (!waitset_register(set, entries, nCount, entry))
+		{
+			(void)waitset_reset(set);
+			SetLastError(ERROR_INTERNAL_ERROR);
+			return FALSE;
+		}
+	}
+
+	memcpy(set->entries, entries, nCount * sizeof(WINPR_WAIT_SET_ENTRY));
+#endif
+
+	if (nCount > 0)
+		memcpy(set->handles, lpHandles, nCount * sizeof(HANDLE));
+	set->count = nCount;
+	return TRUE;
+}
+
+BOOL winpr_WaitSet_Add(WINPR_WAIT_SET* set, HANDLE handle)
+{
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+
+	WINPR_ASSERT(set);
+
+	if (set->count >= MAXIMUM_WAIT_OBJECTS)
+	{
+		WLog_ERR(TAG, "wait set is full");
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+	memcpy(handles, set->handles, set->count * sizeof(HANDLE));
+	handles[set->count] = handle;
+	return winpr_WaitSet_Update(set, set->count + 1, handles);
+}
+
+BOOL winpr_WaitSet_Remove(WINPR_WAIT_SET* set, HANDLE handle)
+{
+	DWORD count = 0;
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS] = { 0 };
+
+	WINPR_ASSERT(set);
+
+	for (DWORD x = 0; x < set->count; x++)
+	{
+		if (set->handles[x] != handle)
+			handles[count++] = set->handles[x];
+	}
+
+	if (count == set->count)
+	{
+		SetLastError(ERROR_INVALID_HANDLE);
+		return FALSE;
+	}
+
+	return winpr_WaitSet_Update(set, count, handles);
+}
+
+DWORD winpr_WaitSet_Wait(WINPR_WAIT_SET* set, DWORD dwMilliseconds)
+{
+	WINPR_ASSERT(set);
+
+	if (set->count == 0)
+	{
+		WLog_ERR(TAG, "waiting on an empty wait set");
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return WAIT_FAILED;
+	}
+
+#if defined(WINPR_WAIT_SET_EPOLL)
+	const UINT64 dueTime = GetTickCount64() + dwMilliseconds;
+	DWORD timeout = dwMilliseconds;
+
+	for (;;)
+	{
+		DWORD index = set->count;
+
+		for (DWORD x = 0; x < set->count; x++)
+		{
+			if (set->entries[x].tag == 0)
+			{
+				index = x;
+				break;
+			}
+		}
+
+		/* with an always signaled handle only the lower indices need a look */
+		const int status =
+		    epoll_wait(set->epfd, set->events, ARRAYSIZE(set->events),
+		               (index < set->count) ? 0 : waitset_timeout(timeout));
+		if ((status < 0) && (errno != EINTR))
+		{
+			char ebuffer[256] = { 0 };
+			WLog_ERR(TAG, "epoll_wait() failure [%d] %s", errno,
+			         winpr_strerror(errno, ebuffer, sizeof(ebuffer)));
+			SetLastError(ERROR_INTERNAL_ERROR);
+			return WAIT_FAILED;
+		}
+
+		for (int x = 0; x < status; x++)
+		{
+			const struct epoll_event* event = &set->events[x];
+
+			for (DWORD y = 0; y < index; y++)
+			{
+				const WINPR_WAIT_SET_ENTRY* entry = &set->entries[y];
+
+				if ((entry->tag == event->data.u64) && waitset_is_signaled(entry, event->events))
+				{
+					index = y;
+					break;
+				}
+			}
+		}
+
+		if (index < set->count)
+		{
+			const DWORD rc = winpr_Handle_cleanup(set->handles[index]);
+			if (rc != WAIT_OBJECT_0)
+			{
+				WLog_ERR(TAG, "error in cleanup function for handle at index=%" PRIu32, index);
+				return rc;
+			}
+			return WAIT_OBJECT_0 + index;
+		}
+
+		/* interrupted, or only events of an entry not asking for them */
+		if (dwMilliseconds != INFINITE)
+		{
+			const UINT64 now = GetTickCount64();
+			if (now >= dueTime)
+				return WAIT_TIMEOUT;
+			timeout = (DWORD)(dueTime - now);
+		}
+	}
+#else
+	return WaitForMultipleObjects(set->count, set->handles, FALSE, dwMilliseconds);
+#endif
+}
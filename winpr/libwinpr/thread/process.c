@@ -595,6 +595,7 @@ HANDLE CreateProcessHandle(pid_t pid)
 
 	process->pid = pid;
 	process->common.Type = HANDLE_TYPE_PROCESS;
+	process->common.Serial = winpr_Handle_NewSerial();
 	process->common.ops = &ops;
 	process->fd = pidfd_open(pid);
 	if (process->fd >= 0)